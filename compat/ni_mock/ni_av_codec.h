@@ -0,0 +1,48 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/*
+ * Software stand-in for the libxcoder headers, see ni_device_api.h.
+ */
+
+#ifndef COMPAT_NI_MOCK_NI_AV_CODEC_H
+#define COMPAT_NI_MOCK_NI_AV_CODEC_H
+
+#include "ni_device_api.h"
+
+int ni_should_send_sei_with_frame(ni_session_context_t *p_enc_ctx,
+                                  ni_pic_type_t pic_type,
+                                  ni_xcoder_params_t *p_param);
+int ni_enc_prep_reconf_demo_data(ni_session_context_t *p_enc_ctx,
+                                 ni_frame_t *p_dec_frame);
+void ni_enc_prep_aux_data(ni_session_context_t *p_enc_ctx,
+                          ni_frame_t *p_enc_frame, ni_frame_t *p_dec_frame,
+                          ni_codec_format_t codec_format, int should_send_sei_with_frame,
+                          uint8_t *mdcv_data, uint8_t *cll_data,
+                          uint8_t *cc_data, uint8_t *udu_data, uint8_t *hdrp_data);
+void ni_enc_copy_aux_data(ni_session_context_t *p_enc_ctx,
+                          ni_frame_t *p_enc_frame, ni_frame_t *p_dec_frame,
+                          ni_codec_format_t codec_format,
+                          const uint8_t *mdcv_data, const uint8_t *cll_data,
+                          const uint8_t *cc_data, const uint8_t *udu_data,
+                          const uint8_t *hdrp_data, int is_hwframe,
+                          int is_semiplanar);
+int ni_set_demo_roi_map(ni_session_context_t *p_enc_ctx);
+
+#endif /* COMPAT_NI_MOCK_NI_AV_CODEC_H */
@@ -0,0 +1,84 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Software stand-in for the libxcoder headers, see ni_device_api.h.
+ */
+
+#ifndef COMPAT_NI_MOCK_NI_DEFS_H
+#define COMPAT_NI_MOCK_NI_DEFS_H
+
+#include <stdint.h>
+
+#define LIBXCODER_API_VERSION_MAJOR 2
+#define LIBXCODER_API_VERSION_MINOR 70
+
+#define NI_XCODER_REVISION          "mock"
+
+#define QUADRA                      1
+
+#define NI_MAX_DEVICE_CNT           128
+#define NI_MAX_DEVICE_NAME_LEN      32
+#define MAX_CHAR_IN_DEVICE_NAME     32
+#define NI_BEST_MODEL_LOAD_STR      "bestmodelload"
+#define NI_BEST_REAL_LOAD_STR       "bestload"
+
+#define NI_MAX_NUM_DATA_POINTERS    4
+#define NI_MAX_TX_SZ                0xA00000
+#define NI_FIFO_SZ                  1024
+#define NI_MAX_FIFO_CAPACITY        120
+#define MAX_NUM_FRAMEPOOL_HWAVFRAME 128
+#define MAX_AV1_ENCODER_GOP_NUM     8
+
+#define NI_MIN_WIDTH                144
+#define NI_MIN_HEIGHT               144
+#define NI_2PASS_ENCODE_MIN_WIDTH   272
+#define NI_2PASS_ENCODE_MIN_HEIGHT  256
+#define NI_PARAM_MAX_WIDTH          8192
+#define NI_PARAM_MAX_HEIGHT         8192
+#define NI_MAX_RESOLUTION_AREA      (8192 * 5120)
+#define NI_PARAM_AV1_MAX_WIDTH      4096
+#define NI_PARAM_AV1_MAX_HEIGHT     2304
+#define NI_PARAM_AV1_MAX_AREA       (4096 * 2304)
+#define NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT 8
+
+#define NI_DEFAULT_KEEP_ALIVE_TIMEOUT 3
+#define NI_MIN_KEEP_ALIVE_TIMEOUT   1
+#define NI_MAX_KEEP_ALIVE_TIMEOUT   100
+
+/* metadata the device puts in front of each bitstream packet */
+#define NI_FW_ENC_BITSTREAM_META_DATA_SIZE 32
+/* metadata the host puts in front of the auxiliary data of each frame */
+#define NI_APP_ENC_FRAME_META_DATA_SIZE    64
+
+#define NI_MAX_SEI_DATA             4096
+#define NI_ENC_MAX_SEI_BUF_SIZE     NI_MAX_SEI_DATA
+#define NI_MAX_CUSTOM_SEI_CNT       10
+#define NI_MAX_CUSTOM_SEI_DATA      8192
+
+#define NI_ENABLE_AUD_FOR_GLOBAL_HEADER 2
+
+#define MASTERING_DISP_CHROMA_DEN   50000
+#define MASTERING_DISP_LUMA_DEN     10000
+
+#define MOTION_CONSTRAINED_QUALITY_MODE 2
+
+/* hw frame indices the encoder can hand back for recycling */
+#define NI_GET_MAX_HWDESC_P2P_BUF_ID(ddr_config) 0x1000
+
+#endif /* COMPAT_NI_MOCK_NI_DEFS_H */
@@ -0,0 +1,523 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Software stand-in for the part of the libxcoder session API the NETINT
+ * encoder uses, so that nienc.c can be built and run without a Quadra card.
+ * Names and types follow libxcoder; only the fields FFmpeg touches exist.
+ * The encoder session is emulated in ni_mock.c: it takes frames up to a
+ * fixed device capacity, returns one packet per frame after the lookahead
+ * delay, and signals write buffer full and end of stream like the device.
+ */
+
+#ifndef COMPAT_NI_MOCK_NI_DEVICE_API_H
+#define COMPAT_NI_MOCK_NI_DEVICE_API_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ni_defs.h"
+
+typedef int32_t ni_device_handle_t;
+#define NI_INVALID_DEVICE_HANDLE (-1)
+
+typedef enum _ni_retcode {
+    NI_RETCODE_SUCCESS                      =  0,
+    NI_RETCODE_FAILURE                      = -1,
+    NI_RETCODE_INVALID_PARAM                = -2,
+    NI_RETCODE_ERROR_MEM_ALOC               = -3,
+    NI_RETCODE_ERROR_INVALID_SESSION        = -9,
+    NI_RETCODE_PARAM_INVALID_NAME           = -10,
+    NI_RETCODE_PARAM_INVALID_VALUE          = -11,
+    NI_RETCODE_PARAM_ERROR_TOO_BIG          = -12,
+    NI_RETCODE_PARAM_ERROR_TOO_SMALL        = -13,
+    NI_RETCODE_PARAM_ERROR_OOR              = -14,
+    NI_RETCODE_PARAM_ERROR_ZERO             = -15,
+    NI_RETCODE_PARAM_ERROR_PIC_WIDTH        = -16,
+    NI_RETCODE_PARAM_ERROR_PIC_HEIGHT       = -17,
+    NI_RETCODE_PARAM_ERROR_WIDTH_TOO_BIG    = -18,
+    NI_RETCODE_PARAM_ERROR_WIDTH_TOO_SMALL  = -19,
+    NI_RETCODE_PARAM_ERROR_HEIGHT_TOO_BIG   = -20,
+    NI_RETCODE_PARAM_ERROR_HEIGHT_TOO_SMALL = -21,
+    NI_RETCODE_PARAM_ERROR_AREA_TOO_BIG     = -22,
+    NI_RETCODE_PARAM_WARNING_DEPRECATED     = 0x200,
+    NI_RETCODE_ERROR_VPU_RECOVERY           = -1500,
+    NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL    = 0x3E9,
+} ni_retcode_t;
+
+typedef enum {
+    NI_DEVICE_TYPE_DECODER = 0,
+    NI_DEVICE_TYPE_ENCODER = 1,
+    NI_DEVICE_TYPE_SCALER  = 2,
+    NI_DEVICE_TYPE_AI      = 3,
+} ni_device_type_t;
+
+typedef enum {
+    NI_CODEC_FORMAT_H264 = 0,
+    NI_CODEC_FORMAT_H265 = 1,
+    NI_CODEC_FORMAT_VP9  = 2,
+    NI_CODEC_FORMAT_JPEG = 3,
+    NI_CODEC_FORMAT_AV1  = 4,
+} ni_codec_format_t;
+
+typedef enum {
+    NI_PIX_FMT_YUV420P     = 0,
+    NI_PIX_FMT_YUV420P10LE = 1,
+    NI_PIX_FMT_NV12        = 2,
+    NI_PIX_FMT_P010LE      = 3,
+    NI_PIX_FMT_RGBA        = 4,
+    NI_PIX_FMT_BGRA        = 5,
+    NI_PIX_FMT_ARGB        = 6,
+    NI_PIX_FMT_ABGR        = 7,
+    NI_PIX_FMT_BGR0        = 8,
+    NI_PIX_FMT_BGRP        = 9,
+    NI_PIX_FMT_NV16        = 10,
+    NI_PIX_FMT_YUYV422     = 11,
+    NI_PIX_FMT_UYVY422     = 12,
+    NI_PIX_FMT_8_TILED4X4  = 13,
+    NI_PIX_FMT_10_TILED4X4 = 14,
+    NI_PIX_FMT_NONE        = 15,
+} ni_pix_fmt_t;
+
+typedef enum {
+    NI_PIXEL_PLANAR_FORMAT_SEMIPLANAR = 0,
+    NI_PIXEL_PLANAR_FORMAT_PLANAR     = 1,
+    NI_PIXEL_PLANAR_FORMAT_TILED4X4   = 2,
+} ni_pixel_planar_format;
+
+typedef enum {
+    NI_FRAME_LITTLE_ENDIAN = 0,
+    NI_FRAME_BIG_ENDIAN    = 1,
+} ni_frame_endianness_t;
+
+typedef enum {
+    SESSION_RUN_STATE_NORMAL              = 0,
+    SESSION_RUN_STATE_SEQ_CHANGE_DRAINING = 1,
+    SESSION_RUN_STATE_RESETTING           = 2,
+    SESSION_RUN_STATE_SEQ_CHANGE_OPENING  = 3,
+} ni_session_run_state_t;
+
+typedef enum {
+    PIC_TYPE_I   = 0,
+    PIC_TYPE_P   = 1,
+    PIC_TYPE_B   = 2,
+    PIC_TYPE_IDR = 3,
+} ni_pic_type_t;
+
+#define NI_CODEC_HW_ENABLE (1 << 0)
+
+typedef enum {
+    NI_FRAME_AUX_DATA_NONE = 0,
+    NI_FRAME_AUX_DATA_A53_CC,
+    NI_FRAME_AUX_DATA_MASTERING_DISPLAY_METADATA,
+    NI_FRAME_AUX_DATA_CONTENT_LIGHT_LEVEL,
+    NI_FRAME_AUX_DATA_HDR_PLUS,
+    NI_FRAME_AUX_DATA_UDU_SEI,
+    NI_FRAME_AUX_DATA_REGIONS_OF_INTEREST,
+    NI_FRAME_AUX_DATA_BITRATE,
+    NI_FRAME_AUX_DATA_LONG_TERM_REF,
+    NI_FRAME_AUX_DATA_FRAMERATE,
+    NI_FRAME_AUX_DATA_CRF,
+    NI_FRAME_AUX_DATA_CRF_FLOAT,
+    NI_FRAME_AUX_DATA_VBV_MAX_RATE,
+    NI_FRAME_AUX_DATA_VBV_BUFFER_SIZE,
+} ni_aux_data_type_t;
+
+#define NI_MAX_NUM_AUX_DATA_PER_FRAME 16
+
+typedef struct _ni_aux_data {
+    ni_aux_data_type_t type;
+    uint8_t *data;
+    int size;
+} ni_aux_data_t;
+
+typedef struct _ni_rational {
+    int num;
+    int den;
+} ni_rational_t;
+
+typedef struct _ni_mastering_display_metadata {
+    ni_rational_t display_primaries[3][2];
+    ni_rational_t white_point[2];
+    ni_rational_t min_luminance;
+    ni_rational_t max_luminance;
+    int has_primaries;
+    int has_luminance;
+} ni_mastering_display_metadata_t;
+
+typedef struct _ni_content_light_level {
+    unsigned max_cll;
+    unsigned max_fall;
+} ni_content_light_level_t;
+
+/* opaque here, only its size is used */
+typedef struct _ni_dynamic_hdr_plus {
+    uint8_t data[4096];
+} ni_dynamic_hdr_plus_t;
+
+typedef struct _ni_long_term_ref {
+    uint8_t use_cur_src_as_long_term_pic;
+    uint8_t use_long_term_ref;
+} ni_long_term_ref_t;
+
+typedef struct _ni_framerate {
+    int32_t framerate_num;
+    int32_t framerate_denom;
+} ni_framerate_t;
+
+typedef struct _ni_encoder_change_params {
+    uint32_t enable_option;
+    int32_t  bitRate;
+    int32_t  reserved[30];
+} ni_encoder_change_params_t;
+
+typedef enum {
+    NI_CUSTOM_SEI_LOC_BEFORE_VCL = 0,
+    NI_CUSTOM_SEI_LOC_AFTER_VCL  = 1,
+} ni_custom_sei_location_t;
+
+typedef struct _ni_custom_sei {
+    uint8_t type;
+    ni_custom_sei_location_t location;
+    uint32_t size;
+    uint8_t data[NI_MAX_CUSTOM_SEI_DATA];
+} ni_custom_sei_t;
+
+typedef struct _ni_custom_sei_set {
+    ni_custom_sei_t custom_sei[NI_MAX_CUSTOM_SEI_CNT];
+    int count;
+} ni_custom_sei_set_t;
+
+typedef struct _ni_pkt_info {
+    double psnr_y, psnr_u, psnr_v, average_psnr;
+    double ssim_y, ssim_u, ssim_v;
+} ni_pkt_info;
+
+/* hw frame descriptor carried in AVFrame.data[3] */
+typedef struct _niFrameSurface1 {
+    uint16_t ui16FrameIdx;
+    uint16_t ui16session_ID;
+    uint16_t ui16width;
+    uint16_t ui16height;
+    uint32_t ui32nodeAddress;
+    int32_t  device_handle;
+    int8_t   bit_depth;
+    int8_t   encoding_type;
+    int8_t   output_idx;
+    int8_t   src_cpu;
+    int32_t  dma_buf_fd;
+} niFrameSurface1_t;
+
+typedef struct _ni_frame {
+    long long pts;
+    long long dts;
+
+    uint32_t video_width;
+    uint32_t video_height;
+    uint32_t crop_top, crop_bottom, crop_left, crop_right;
+
+    uint8_t *p_data[NI_MAX_NUM_DATA_POINTERS];
+    uint32_t data_len[NI_MAX_NUM_DATA_POINTERS];
+    void *p_buffer;
+    uint32_t buffer_size;
+    uint8_t *p_metadata_buffer;
+    uint32_t metadata_buffer_size;
+    uint8_t *p_start_buffer;
+    uint32_t start_buffer_size;
+
+    uint32_t start_of_stream;
+    uint32_t end_of_stream;
+    uint32_t extra_data_len;
+    uint8_t  force_key_frame;
+    uint8_t  ni_pict_type;
+    uint8_t  force_pic_qp;
+    uint8_t  use_cur_src_as_long_term_pic;
+    uint8_t  use_long_term_ref;
+
+    uint32_t sei_total_len;
+    uint32_t sei_cc_offset, sei_cc_len;
+    uint32_t sei_hdr_mastering_display_color_vol_offset;
+    uint32_t sei_hdr_mastering_display_color_vol_len;
+    uint32_t sei_hdr_content_light_level_info_offset;
+    uint32_t sei_hdr_content_light_level_info_len;
+    uint32_t sei_hdr_plus_offset, sei_hdr_plus_len;
+    uint32_t sei_user_data_unreg_offset, sei_user_data_unreg_len;
+    uint32_t preferred_characteristics_data_len;
+    uint32_t roi_len;
+    uint32_t reconf_len;
+
+    ni_aux_data_t *aux_data[NI_MAX_NUM_AUX_DATA_PER_FRAME];
+    int nb_aux_data;
+} ni_frame_t;
+
+typedef struct _ni_packet {
+    long long pts;
+    long long dts;
+    void *p_data;
+    uint32_t data_len;
+    void *p_buffer;
+    uint32_t buffer_size;
+
+    int end_of_stream;
+    int frame_type;
+    int recycle_index;
+    uint32_t avg_frame_qp;
+
+    int av1_show_frame;
+    void *av1_p_buffer[MAX_AV1_ENCODER_GOP_NUM];
+    void *av1_p_data[MAX_AV1_ENCODER_GOP_NUM];
+    uint32_t av1_buffer_size[MAX_AV1_ENCODER_GOP_NUM];
+    uint32_t av1_data_len[MAX_AV1_ENCODER_GOP_NUM];
+    int av1_buffer_index;
+
+    double psnr_y, psnr_u, psnr_v, average_psnr;
+    double ssim_y, ssim_u, ssim_v;
+} ni_packet_t;
+
+typedef struct _ni_session_data_io {
+    union {
+        ni_frame_t frame;
+        ni_packet_t packet;
+    } data;
+} ni_session_data_io_t;
+
+#define NI_MAX_GOP_NUM 8
+
+typedef struct _ni_gop_params {
+    int poc_offset;
+    int qp_offset;
+    float qp_factor;
+    int temporal_id;
+    int pic_type;
+    int num_ref_pics;
+} ni_gop_params_t;
+
+typedef struct _ni_custom_gop_params {
+    int custom_gop_size;
+    ni_gop_params_t pic_param[NI_MAX_GOP_NUM];
+} ni_custom_gop_params_t;
+
+typedef struct _ni_encoder_rc_params {
+    int intra_qp;
+    int enable_rate_control;
+} ni_encoder_rc_params_t;
+
+typedef struct _ni_encoder_cfg_params {
+    int frame_rate;
+    int intra_period;
+    int gop_preset_index;
+    ni_custom_gop_params_t custom_gop_params;
+    ni_encoder_rc_params_t rc;
+
+    int lookAheadDepth;
+    int crf;
+    float crfFloat;
+    int planar;
+    int keep_alive_timeout;
+
+    int conf_win_top, conf_win_bottom, conf_win_left, conf_win_right;
+    int crop_width, crop_height, hor_offset, ver_offset;
+
+    int EnableAUD;
+    int hrdEnable;
+    int forced_header_enable;
+    int videoFullRange;
+    int colorDescPresent;
+    int colorPrimaries;
+    int colorTrc;
+    int colorSpace;
+    int aspectRatioWidth;
+    int aspectRatioHeight;
+
+    int HDR10CLLEnable, HDR10MaxLight, HDR10AveLight;
+    int HDR10Enable;
+    int HDR10dx0, HDR10dy0, HDR10dx1, HDR10dy1, HDR10dx2, HDR10dy2;
+    int HDR10wx, HDR10wy;
+    int HDR10maxluma, HDR10minluma;
+
+    int enable_acq_limit;
+    int enable_all_sei_passthru;
+    int enable_ssim;
+    int get_psnr_mode;
+    int roi_enable;
+    int motionConstrainedMode;
+    int multicoreJointMode;
+    int disable_adaptive_buffers;
+} ni_encoder_cfg_params_t;
+
+typedef struct _ni_xcoder_params {
+    int log;
+    int bitrate;
+    int source_width;
+    int source_height;
+    int hwframes;
+    int rootBufId;
+    int low_delay_mode;
+    int generate_enc_hdrs;
+    int enable_vfr;
+    int roi_demo_mode;
+    int force_pic_qp_demo_mode;
+    int dolby_vision_profile;
+    int luma_linesize;
+    int chroma_linesize;
+    ni_encoder_cfg_params_t cfg_enc_params;
+} ni_xcoder_params_t;
+
+typedef struct _ni_split_context {
+    int enabled;
+    int w[3];
+    int h[3];
+    int f[3];
+    int f8b[3];
+} ni_split_context_t;
+
+typedef struct _ni_session_context {
+    ni_device_handle_t device_handle;
+    ni_device_handle_t blk_io_handle;
+    ni_device_handle_t auto_dl_handle;
+    ni_device_handle_t sender_handle;
+    int hw_id;
+    char blk_dev_name[NI_MAX_DEVICE_NAME_LEN];
+    char dev_xcoder_name[MAX_CHAR_IN_DEVICE_NAME];
+    char blk_xcoder_name[MAX_CHAR_IN_DEVICE_NAME];
+    uint32_t session_id;
+    ni_retcode_t status;
+    char param_err_msg[512];
+    void *p_session_config;
+
+    int codec_format;
+    int pixel_format;
+    int bit_depth_factor;
+    int src_bit_depth;
+    int src_endian;
+    int hw_action;
+    int ddr_config;
+    int is_auto_dl;
+    uint32_t max_nvme_io_size;
+    uint32_t keep_alive_timeout;
+    uint32_t meta_size;
+    int ready_to_close;
+    ni_session_run_state_t session_run_state;
+    int force_frame_type;
+
+    uint64_t frame_num;
+    uint64_t pkt_num;
+
+    int ori_width, ori_height;
+    int ori_bit_depth_factor;
+    int ori_pix_fmt;
+    int ori_luma_linesize, ori_chroma_linesize;
+
+    int64_t enc_pts_list[NI_FIFO_SZ];
+    uint64_t enc_pts_r_idx;
+    uint64_t enc_pts_w_idx;
+
+    /* VFR */
+    int prev_fps;
+    int64_t prev_pts;
+    int64_t passed_time_in_timebase_unit;
+    int count_frame_num_in_sec;
+    int64_t last_change_framenum;
+    int fps_change_detect_count;
+
+    uint32_t roi_len;
+    uint32_t roi_avg_qp;
+
+    /* HDR SEI the session serialized last */
+    uint32_t sei_hdr_content_light_level_info_len;
+    uint32_t light_level_data_len;
+    uint32_t sei_hdr_mastering_display_color_vol_len;
+    uint32_t mdcv_max_min_lum_data_len;
+    void *p_master_display_meta_data;
+
+    double psnr_y, psnr_u, psnr_v, average_psnr;
+
+    /* state of the emulated device, owned by ni_mock.c */
+    void *p_mock;
+} ni_session_context_t;
+
+extern const char *const g_xcoder_preset_names[];
+extern const char *const g_xcoder_log_names[];
+
+ni_retcode_t ni_device_session_context_init(ni_session_context_t *p_ctx);
+void ni_device_session_context_clear(ni_session_context_t *p_ctx);
+
+ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
+                                    ni_device_type_t device_type);
+ni_retcode_t ni_device_session_close(ni_session_context_t *p_ctx, int eos_received,
+                                     ni_device_type_t device_type);
+ni_retcode_t ni_device_session_flush(ni_session_context_t *p_ctx,
+                                     ni_device_type_t device_type);
+int ni_device_session_write(ni_session_context_t *p_ctx, ni_session_data_io_t *p_data,
+                            ni_device_type_t device_type);
+int ni_device_session_read(ni_session_context_t *p_ctx, ni_session_data_io_t *p_data,
+                           ni_device_type_t device_type);
+ni_retcode_t ni_device_session_sequence_change(ni_session_context_t *p_ctx,
+                                               int width, int height,
+                                               int bit_depth_factor,
+                                               ni_device_type_t device_type);
+int ni_device_session_hwdl(ni_session_context_t *p_ctx,
+                           ni_session_data_io_t *p_data,
+                           niFrameSurface1_t *hwdesc);
+void ni_device_close(ni_device_handle_t dev);
+
+ni_retcode_t ni_encoder_init_default_params(ni_xcoder_params_t *p_param,
+                                            int fps_num, int fps_denom,
+                                            long bit_rate, int width, int height,
+                                            ni_codec_format_t codec_format);
+ni_retcode_t ni_encoder_params_set_value(ni_xcoder_params_t *p_params,
+                                         const char *name, const char *value);
+ni_retcode_t ni_encoder_gop_params_set_value(ni_xcoder_params_t *p_params,
+                                             const char *name, const char *value);
+void ni_gop_params_check_set(ni_xcoder_params_t *p_param, char *value);
+bool ni_gop_params_check(ni_xcoder_params_t *p_param);
+
+ni_retcode_t ni_packet_buffer_alloc(ni_packet_t *p_packet, int packet_size);
+ni_retcode_t ni_packet_buffer_free(ni_packet_t *p_packet);
+ni_retcode_t ni_packet_buffer_free_av1(ni_packet_t *p_packet);
+
+ni_retcode_t ni_frame_buffer_free(ni_frame_t *p_frame);
+ni_retcode_t ni_frame_buffer_alloc_hwenc(ni_frame_t *p_frame, int video_width,
+                                         int video_height, int extra_len);
+ni_retcode_t ni_encoder_sw_frame_buffer_alloc(bool planar, ni_frame_t *p_frame,
+                                              int video_width, int video_height,
+                                              int linesize[], int alignment,
+                                              int extra_len,
+                                              bool alignment_2pass_wa);
+ni_retcode_t ni_enc_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
+                                       int video_height, int alignment,
+                                       int metadata_flag, int factor,
+                                       int hw_frame_count, int is_planar,
+                                       ni_pix_fmt_t pix_fmt);
+ni_retcode_t ni_encoder_frame_zerocopy_check(ni_session_context_t *p_enc_ctx,
+                                             ni_xcoder_params_t *p_enc_params,
+                                             int width, int height,
+                                             const int linesize[],
+                                             bool set_linesize);
+ni_retcode_t ni_encoder_frame_zerocopy_buffer_alloc(ni_frame_t *p_frame,
+                                                    int video_width,
+                                                    int video_height,
+                                                    const int linesize[],
+                                                    const uint8_t *data[],
+                                                    int extra_len);
+
+ni_aux_data_t *ni_frame_new_aux_data(ni_frame_t *frame, ni_aux_data_type_t type,
+                                     int data_size);
+
+#endif /* COMPAT_NI_MOCK_NI_DEVICE_API_H */
@@ -0,0 +1,835 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Emulated libxcoder encoder session, for the tests and benchmarks built
+ * with --enable-ni_quadra_mock. The emulated device
+ *  - takes up to NI_MOCK_DEVICE_FRAMES unencoded frames beyond its
+ *    lookahead and refuses further writes with NVME_SC_WRITE_BUFFER_FULL,
+ *  - finishes one frame every ni_mock_ticks_per_frame session calls, a
+ *    frame becoming eligible once lookAheadDepth frames follow it or the
+ *    end of stream was written; this is the emulated device time,
+ *  - returns the stream headers first and then one packet per frame, in
+ *    order: a start code, a slice NAL unit header and the frame number,
+ *    pts and a checksum of the visible luma the host laid out, after an
+ *    SEI NAL unit with the length and a checksum of the SEI payloads if
+ *    the frame had any,
+ *  - holds finished packets back at random once a test seeds
+ *    ni_mock_delay_seed,
+ *  - keeps the HDR SEI it was handed last and sends it with each IDR,
+ *    other SEI go out with their frame.
+ * Hardware frames and zero copy input are not emulated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ni_av_codec.h"
+#include "ni_device_api.h"
+#include "ni_rsrc_api.h"
+#include "ni_util.h"
+
+#define NI_MOCK_DEVICE_FRAMES   4
+#define NI_MOCK_MAX_FRAMES      64
+#define NI_MOCK_ALIGN(x, a)     (((x) + (a) - 1) & ~((a) - 1))
+
+#define NI_MOCK_CLL_SEI_SIZE    12
+#define NI_MOCK_MDCV_SEI_SIZE   32
+
+typedef struct NIMockFrame {
+    long long pts;
+    uint64_t  number;
+    uint32_t  checksum;
+    uint32_t  sei_len;
+    uint32_t  sei_checksum;
+    int       idr;
+} NIMockFrame;
+
+typedef struct NIMockEncoder {
+    NIMockFrame frames[NI_MOCK_MAX_FRAMES];
+    uint64_t written;       // frames taken since open or sequence change
+    uint64_t encoded;       // frames finished by the device
+    uint64_t read;          // packets returned
+    uint64_t ticks;
+    int capacity;
+    int lookahead;
+    int intra_period;
+    int header_pending;
+    int eos;
+} NIMockEncoder;
+
+const char *const g_xcoder_preset_names[] = { "default", NULL };
+const char *const g_xcoder_log_names[] = {
+    "none", "fatal", "error", "info", "debug", "trace", NULL
+};
+
+static ni_log_level_t mock_log_level = NI_LOG_INFO;
+static uint32_t mock_session_id;
+
+/* emulated device speed, tests raise it to model a saturated device */
+static int ni_mock_ticks_per_frame = 3;
+
+/* benchmarks turn the luma checksum off, it is no host work */
+static int ni_mock_checksum = 1;
+
+/* packet output delays, off while 0 */
+static unsigned ni_mock_delay_seed;
+
+void ni_log_set_level(ni_log_level_t level)
+{
+    mock_log_level = level;
+}
+
+ni_log_level_t ff_to_ni_log_level(int fflog_level)
+{
+    /* AV_LOG_QUIET .. AV_LOG_TRACE */
+    if (fflog_level < 0)
+        return NI_LOG_NONE;
+    if (fflog_level <= 8)
+        return NI_LOG_FATAL;
+    if (fflog_level <= 16)
+        return NI_LOG_ERROR;
+    if (fflog_level <= 32)
+        return NI_LOG_INFO;
+    if (fflog_level <= 48)
+        return NI_LOG_DEBUG;
+    return NI_LOG_TRACE;
+}
+
+ni_retcode_t ni_device_session_context_init(ni_session_context_t *p_ctx)
+{
+    if (!p_ctx)
+        return NI_RETCODE_INVALID_PARAM;
+    memset(p_ctx, 0, sizeof(*p_ctx));
+    p_ctx->device_handle      = NI_INVALID_DEVICE_HANDLE;
+    p_ctx->blk_io_handle      = NI_INVALID_DEVICE_HANDLE;
+    p_ctx->hw_id              = -1;
+    p_ctx->keep_alive_timeout = NI_DEFAULT_KEEP_ALIVE_TIMEOUT;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ni_device_session_context_clear(ni_session_context_t *p_ctx)
+{
+    free(p_ctx->p_mock);
+    p_ctx->p_mock = NULL;
+}
+
+ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
+                                    ni_device_type_t device_type)
+{
+    const ni_xcoder_params_t *p_param = p_ctx->p_session_config;
+    NIMockEncoder *m;
+
+    if (device_type != NI_DEVICE_TYPE_ENCODER || !p_param)
+        return NI_RETCODE_INVALID_PARAM;
+
+    m = calloc(1, sizeof(*m));
+    if (!m)
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    m->lookahead      = p_param->cfg_enc_params.lookAheadDepth;
+    m->capacity       = m->lookahead + NI_MOCK_DEVICE_FRAMES;
+    m->intra_period   = p_param->cfg_enc_params.intra_period;
+    m->header_pending = 1;
+
+    p_ctx->p_mock        = m;
+    p_ctx->session_id    = ++mock_session_id;
+    p_ctx->meta_size     = NI_FW_ENC_BITSTREAM_META_DATA_SIZE;
+    p_ctx->status        = NI_RETCODE_SUCCESS;
+    if (p_ctx->hw_id < 0)
+        p_ctx->hw_id = 0;
+    if (p_ctx->device_handle == NI_INVALID_DEVICE_HANDLE) {
+        p_ctx->device_handle = 3;
+        p_ctx->blk_io_handle = 3;
+    }
+    snprintf(p_ctx->dev_xcoder_name, sizeof(p_ctx->dev_xcoder_name), "mock%d", p_ctx->hw_id);
+    snprintf(p_ctx->blk_xcoder_name, sizeof(p_ctx->blk_xcoder_name), "mock%dn1", p_ctx->hw_id);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_session_close(ni_session_context_t *p_ctx, int eos_received,
+                                     ni_device_type_t device_type)
+{
+    free(p_ctx->p_mock);
+    p_ctx->p_mock = NULL;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_session_flush(ni_session_context_t *p_ctx,
+                                     ni_device_type_t device_type)
+{
+    NIMockEncoder *m = p_ctx->p_mock;
+
+    if (!m)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    m->eos = 1;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_device_session_sequence_change(ni_session_context_t *p_ctx,
+                                               int width, int height,
+                                               int bit_depth_factor,
+                                               ni_device_type_t device_type)
+{
+    NIMockEncoder *m = p_ctx->p_mock;
+
+    if (!m)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    // only once the previous sequence is drained
+    if (!m->eos || m->read < m->written)
+        return NI_RETCODE_FAILURE;
+    m->written = m->encoded = m->read = 0;
+    m->header_pending = 1;
+    m->eos = 0;
+    return NI_RETCODE_SUCCESS;
+}
+
+static void mock_tick(NIMockEncoder *m)
+{
+    if (++m->ticks % ni_mock_ticks_per_frame)
+        return;
+    if (m->encoded < m->written &&
+        (m->written - m->encoded > m->lookahead || m->eos))
+        m->encoded++;
+}
+
+/* hold a finished packet back, 3 reads out of 8 on average */
+static int mock_delayed(void)
+{
+    if (!ni_mock_delay_seed)
+        return 0;
+    ni_mock_delay_seed = ni_mock_delay_seed * 1664525 + 1013904223;
+    return (ni_mock_delay_seed >> 29) < 3;
+}
+
+static uint32_t mock_adler(uint32_t sum, const uint8_t *data, int len)
+{
+    uint32_t a = sum & 0xffff, b = sum >> 16;
+
+    for (int i = 0; i < len; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+/* the SEI payloads, laid out after the planes as ni_enc_copy_aux_data() does */
+static uint32_t mock_sei_checksum(const ni_frame_t *p_frame)
+{
+    const uint8_t *p = p_frame->p_buffer;
+
+    if (!p_frame->sei_total_len || !p)
+        return 0;
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++)
+        p += p_frame->data_len[i];
+    p += NI_APP_ENC_FRAME_META_DATA_SIZE + sizeof(ni_encoder_change_params_t);
+    return mock_adler(1, p, p_frame->sei_total_len);
+}
+
+static uint32_t mock_checksum(const ni_session_context_t *p_ctx,
+                              const ni_frame_t *p_frame)
+{
+    int stride[NI_MAX_NUM_DATA_POINTERS], height[NI_MAX_NUM_DATA_POINTERS];
+    int width = p_frame->video_width * p_ctx->bit_depth_factor;
+    uint32_t sum = 1;
+
+    ni_get_min_frame_dim(p_frame->video_width, p_frame->video_height,
+                         p_ctx->pixel_format, stride, height);
+    for (int y = 0; y < p_frame->video_height; y++)
+        sum = mock_adler(sum, p_frame->p_data[0] + y * stride[0], width);
+    return sum;
+}
+
+int ni_device_session_write(ni_session_context_t *p_ctx, ni_session_data_io_t *p_data,
+                            ni_device_type_t device_type)
+{
+    NIMockEncoder *m = p_ctx->p_mock;
+    ni_frame_t *p_frame = &p_data->data.frame;
+    const ni_xcoder_params_t *p_param = p_ctx->p_session_config;
+    NIMockFrame *f;
+    int size = p_frame->extra_data_len;
+
+    if (!m || device_type != NI_DEVICE_TYPE_ENCODER)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    mock_tick(m);
+
+    if (p_frame->end_of_stream) {
+        m->eos = 1;
+        p_ctx->status = NI_RETCODE_SUCCESS;
+        return NI_APP_ENC_FRAME_META_DATA_SIZE;
+    }
+    if (m->eos)
+        return NI_RETCODE_FAILURE;
+    if (m->written - m->encoded >= m->capacity ||
+        m->written - m->read >= NI_MOCK_MAX_FRAMES) {
+        p_ctx->status = NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL;
+        return 0;
+    }
+
+    f = &m->frames[m->written % NI_MOCK_MAX_FRAMES];
+    f->pts      = p_frame->pts;
+    f->number   = m->written;
+    f->checksum = p_param->hwframes || !ni_mock_checksum ? 0 : mock_checksum(p_ctx, p_frame);
+    f->sei_len  = p_frame->sei_total_len;
+    f->sei_checksum = mock_sei_checksum(p_frame);
+    f->idr      = !m->written || p_frame->force_key_frame ||
+                  p_frame->ni_pict_type == PIC_TYPE_IDR ||
+                  (m->intra_period && !(m->written % m->intra_period));
+    m->written++;
+    p_ctx->frame_num++;
+    p_ctx->status = NI_RETCODE_SUCCESS;
+
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++)
+        size += p_frame->data_len[i];
+    return size;
+}
+
+static uint8_t *mock_put_nal(uint8_t *p, const ni_session_context_t *p_ctx,
+                             int h264_type, int hevc_type)
+{
+    static const uint8_t start_code[4] = { 0, 0, 0, 1 };
+
+    memcpy(p, start_code, sizeof(start_code));
+    p += sizeof(start_code);
+    if (p_ctx->codec_format == NI_CODEC_FORMAT_H265) {
+        *p++ = hevc_type << 1;
+        *p++ = 1;
+    } else {
+        *p++ = 0x60 | h264_type;
+    }
+    return p;
+}
+
+static uint8_t *mock_put_be32(uint8_t *p, uint32_t v)
+{
+    *p++ = v >> 24;
+    *p++ = v >> 16;
+    *p++ = v >> 8;
+    *p++ = v;
+    return p;
+}
+
+int ni_device_session_read(ni_session_context_t *p_ctx, ni_session_data_io_t *p_data,
+                           ni_device_type_t device_type)
+{
+    NIMockEncoder *m = p_ctx->p_mock;
+    ni_packet_t *p_packet = &p_data->data.packet;
+    const NIMockFrame *f;
+    uint8_t *start, *p;
+
+    if (!m || device_type != NI_DEVICE_TYPE_ENCODER)
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    if (!p_packet->p_data || p_packet->buffer_size < p_ctx->meta_size + 256)
+        return NI_RETCODE_INVALID_PARAM;
+
+    start = p = (uint8_t *)p_packet->p_data + p_ctx->meta_size;
+    memset(p_packet->p_data, 0, p_ctx->meta_size);
+    p_packet->end_of_stream  = 0;
+    p_packet->av1_show_frame = 1;
+    p_packet->avg_frame_qp   = 0;
+
+    if (m->header_pending) {
+        if (p_ctx->codec_format == NI_CODEC_FORMAT_H265)
+            p = mock_put_nal(p, p_ctx, 0, 32);
+        p = mock_put_nal(p, p_ctx, 7, 33);
+        p = mock_put_be32(p, p_ctx->session_id);
+        p = mock_put_nal(p, p_ctx, 8, 34);
+        *p++ = 0x80;
+        m->header_pending = 0;
+        p_packet->pts        = 0;
+        p_packet->frame_type = 0;
+        p_packet->data_len   = p_ctx->meta_size + (p - start);
+        return p_packet->data_len;
+    }
+
+    mock_tick(m);
+    if (m->read == m->encoded || mock_delayed()) {
+        p_packet->data_len      = 0;
+        p_packet->end_of_stream = m->eos && m->read == m->written;
+        return 0;
+    }
+
+    f = &m->frames[m->read++ % NI_MOCK_MAX_FRAMES];
+    if (f->sei_len) {
+        p = mock_put_nal(p, p_ctx, 6, 39);
+        p = mock_put_be32(p, f->sei_len);
+        p = mock_put_be32(p, f->sei_checksum);
+    }
+    p = mock_put_nal(p, p_ctx, f->idr ? 5 : 1, f->idr ? 19 : 1);
+    p = mock_put_be32(p, f->number);
+    p = mock_put_be32(p, f->pts);
+    p = mock_put_be32(p, f->checksum);
+
+    p_packet->pts        = f->pts;
+    p_packet->dts        = f->pts;
+    p_packet->frame_type = f->idr ? 0 : 1;
+    p_packet->data_len   = p_ctx->meta_size + (p - start);
+    p_ctx->pkt_num++;
+    return p_packet->data_len;
+}
+
+int ni_device_session_hwdl(ni_session_context_t *p_ctx,
+                           ni_session_data_io_t *p_data,
+                           niFrameSurface1_t *hwdesc)
+{
+    return NI_RETCODE_FAILURE;
+}
+
+void ni_device_close(ni_device_handle_t dev)
+{
+}
+
+void ni_rsrc_free_device_context(ni_device_context_t *p_device_context)
+{
+    free(p_device_context);
+}
+
+ni_retcode_t ni_encoder_init_default_params(ni_xcoder_params_t *p_param,
+                                            int fps_num, int fps_denom,
+                                            long bit_rate, int width, int height,
+                                            ni_codec_format_t codec_format)
+{
+    ni_encoder_cfg_params_t *cfg = &p_param->cfg_enc_params;
+
+    memset(p_param, 0, sizeof(*p_param));
+    p_param->bitrate       = bit_rate > 0 ? bit_rate : 200000;
+    p_param->source_width  = width;
+    p_param->source_height = height;
+
+    cfg->frame_rate         = fps_num > 0 && fps_denom > 0 ? (fps_num + fps_denom / 2) / fps_denom : 30;
+    cfg->intra_period       = 120;
+    cfg->gop_preset_index   = -1;
+    cfg->crf                = -1;
+    cfg->crfFloat           = -1.0f;
+    cfg->keep_alive_timeout = NI_DEFAULT_KEEP_ALIVE_TIMEOUT;
+    cfg->aspectRatioHeight  = 1;
+    cfg->get_psnr_mode      = 3;
+    cfg->rc.intra_qp        = 22;
+    cfg->colorPrimaries     = 2;
+    cfg->colorTrc           = 2;
+    cfg->colorSpace         = 2;
+
+    if (width > NI_PARAM_MAX_WIDTH)
+        return NI_RETCODE_PARAM_ERROR_WIDTH_TOO_BIG;
+    if (height > NI_PARAM_MAX_HEIGHT)
+        return NI_RETCODE_PARAM_ERROR_HEIGHT_TOO_BIG;
+    if ((int64_t)width * height > NI_MAX_RESOLUTION_AREA)
+        return NI_RETCODE_PARAM_ERROR_AREA_TOO_BIG;
+    return NI_RETCODE_SUCCESS;
+}
+
+static ni_retcode_t mock_set_int(int *dst, const char *value, int min, int max)
+{
+    char *end;
+    long v = strtol(value, &end, 10);
+
+    if (end == value || *end)
+        return NI_RETCODE_PARAM_INVALID_VALUE;
+    if (v > max)
+        return NI_RETCODE_PARAM_ERROR_TOO_BIG;
+    if (v < min)
+        return NI_RETCODE_PARAM_ERROR_TOO_SMALL;
+    *dst = v;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_encoder_params_set_value(ni_xcoder_params_t *p_params,
+                                         const char *name, const char *value)
+{
+    ni_encoder_cfg_params_t *cfg = &p_params->cfg_enc_params;
+
+    if (!strcmp(name, "lookAheadDepth")) {
+        ni_retcode_t ret = mock_set_int(&cfg->lookAheadDepth, value, 0, 40);
+        if (ret == NI_RETCODE_SUCCESS && cfg->lookAheadDepth && cfg->lookAheadDepth < 4)
+            return NI_RETCODE_PARAM_ERROR_OOR;
+        return ret;
+    }
+    if (!strcmp(name, "gopPresetIdx"))
+        return mock_set_int(&cfg->gop_preset_index, value, -1, 10);
+    if (!strcmp(name, "intraPeriod"))
+        return mock_set_int(&cfg->intra_period, value, 0, 1024);
+    if (!strcmp(name, "lowDelay"))
+        return mock_set_int(&p_params->low_delay_mode, value, 0, 1);
+    if (!strcmp(name, "crf"))
+        return mock_set_int(&cfg->crf, value, -1, 51);
+    if (!strcmp(name, "frameRate"))
+        return mock_set_int(&cfg->frame_rate, value, 1, 240);
+    return NI_RETCODE_PARAM_INVALID_NAME;
+}
+
+ni_retcode_t ni_encoder_gop_params_set_value(ni_xcoder_params_t *p_params,
+                                             const char *name, const char *value)
+{
+    return NI_RETCODE_PARAM_INVALID_NAME;
+}
+
+void ni_gop_params_check_set(ni_xcoder_params_t *p_param, char *value)
+{
+}
+
+bool ni_gop_params_check(ni_xcoder_params_t *p_param)
+{
+    return true;
+}
+
+ni_retcode_t ni_packet_buffer_alloc(ni_packet_t *p_packet, int packet_size)
+{
+    if (p_packet->p_buffer && p_packet->buffer_size >= packet_size) {
+        p_packet->p_data = p_packet->p_buffer;
+        return NI_RETCODE_SUCCESS;
+    }
+    free(p_packet->p_buffer);
+    p_packet->p_buffer = p_packet->p_data = malloc(packet_size);
+    p_packet->buffer_size = p_packet->p_buffer ? packet_size : 0;
+    return p_packet->p_buffer ? NI_RETCODE_SUCCESS : NI_RETCODE_ERROR_MEM_ALOC;
+}
+
+ni_retcode_t ni_packet_buffer_free(ni_packet_t *p_packet)
+{
+    free(p_packet->p_buffer);
+    p_packet->p_buffer    = p_packet->p_data = NULL;
+    p_packet->buffer_size = p_packet->data_len = 0;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_packet_buffer_free_av1(ni_packet_t *p_packet)
+{
+    for (int i = 0; i < p_packet->av1_buffer_index; i++) {
+        free(p_packet->av1_p_buffer[i]);
+        p_packet->av1_p_buffer[i]    = p_packet->av1_p_data[i] = NULL;
+        p_packet->av1_buffer_size[i] = p_packet->av1_data_len[i] = 0;
+    }
+    p_packet->av1_buffer_index = 0;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_frame_buffer_free(ni_frame_t *p_frame)
+{
+    for (int i = 0; i < p_frame->nb_aux_data; i++) {
+        free(p_frame->aux_data[i]->data);
+        free(p_frame->aux_data[i]);
+        p_frame->aux_data[i] = NULL;
+    }
+    p_frame->nb_aux_data = 0;
+
+    free(p_frame->p_buffer);
+    p_frame->p_buffer    = NULL;
+    p_frame->buffer_size = 0;
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        p_frame->p_data[i]   = NULL;
+        p_frame->data_len[i] = 0;
+    }
+    return NI_RETCODE_SUCCESS;
+}
+
+/* one buffer: the planes, then extra_len bytes of metadata and aux data */
+static ni_retcode_t mock_frame_alloc(ni_frame_t *p_frame, const int size[NI_MAX_NUM_DATA_POINTERS],
+                                     int extra_len)
+{
+    uint32_t total = extra_len;
+    uint8_t *p;
+
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++)
+        total += size[i];
+    if (!p_frame->p_buffer || p_frame->buffer_size < total) {
+        free(p_frame->p_buffer);
+        p_frame->p_buffer    = malloc(total);
+        p_frame->buffer_size = p_frame->p_buffer ? total : 0;
+        if (!p_frame->p_buffer) {
+            memset(p_frame->p_data, 0, sizeof(p_frame->p_data));
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        }
+    }
+
+    p = p_frame->p_buffer;
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        p_frame->p_data[i]   = size[i] ? p : NULL;
+        p_frame->data_len[i] = size[i];
+        p += size[i];
+    }
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_frame_buffer_alloc_hwenc(ni_frame_t *p_frame, int video_width,
+                                         int video_height, int extra_len)
+{
+    int size[NI_MAX_NUM_DATA_POINTERS] = { 0, 0, 0, sizeof(niFrameSurface1_t) };
+
+    p_frame->video_width  = video_width;
+    p_frame->video_height = video_height;
+    return mock_frame_alloc(p_frame, size, extra_len);
+}
+
+ni_retcode_t ni_encoder_sw_frame_buffer_alloc(bool planar, ni_frame_t *p_frame,
+                                              int video_width, int video_height,
+                                              int linesize[], int alignment,
+                                              int extra_len,
+                                              bool alignment_2pass_wa)
+{
+    int size[NI_MAX_NUM_DATA_POINTERS] = { 0 };
+    int chroma_height = video_height / 2;
+
+    if (alignment_2pass_wa)
+        chroma_height = NI_MOCK_ALIGN(video_height, 32) / 2;
+    size[0] = linesize[0] * video_height;
+    size[1] = linesize[1] * (planar ? video_height / 2 : chroma_height);
+    size[2] = planar ? linesize[2] * chroma_height : 0;
+
+    p_frame->video_width  = video_width;
+    p_frame->video_height = video_height;
+    return mock_frame_alloc(p_frame, size, extra_len);
+}
+
+ni_retcode_t ni_enc_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
+                                       int video_height, int alignment,
+                                       int metadata_flag, int factor,
+                                       int hw_frame_count, int is_planar,
+                                       ni_pix_fmt_t pix_fmt)
+{
+    int stride[NI_MAX_NUM_DATA_POINTERS], height[NI_MAX_NUM_DATA_POINTERS];
+    int size[NI_MAX_NUM_DATA_POINTERS] = { 0 };
+
+    ni_get_min_frame_dim(video_width, video_height, pix_fmt, stride, height);
+    for (int i = 0; i < 3; i++)
+        size[i] = stride[i] * height[i];
+
+    p_frame->video_width  = video_width;
+    p_frame->video_height = video_height;
+    return mock_frame_alloc(p_frame, size,
+                            metadata_flag ? NI_APP_ENC_FRAME_META_DATA_SIZE : 0);
+}
+
+ni_retcode_t ni_encoder_frame_zerocopy_check(ni_session_context_t *p_enc_ctx,
+                                             ni_xcoder_params_t *p_enc_params,
+                                             int width, int height,
+                                             const int linesize[],
+                                             bool set_linesize)
+{
+    return NI_RETCODE_FAILURE;
+}
+
+ni_retcode_t ni_encoder_frame_zerocopy_buffer_alloc(ni_frame_t *p_frame,
+                                                    int video_width,
+                                                    int video_height,
+                                                    const int linesize[],
+                                                    const uint8_t *data[],
+                                                    int extra_len)
+{
+    return NI_RETCODE_FAILURE;
+}
+
+ni_aux_data_t *ni_frame_new_aux_data(ni_frame_t *frame, ni_aux_data_type_t type,
+                                     int data_size)
+{
+    ni_aux_data_t *aux;
+
+    if (frame->nb_aux_data >= NI_MAX_NUM_AUX_DATA_PER_FRAME)
+        return NULL;
+    aux = calloc(1, sizeof(*aux));
+    if (!aux)
+        return NULL;
+    aux->data = calloc(1, data_size);
+    if (!aux->data) {
+        free(aux);
+        return NULL;
+    }
+    aux->type = type;
+    aux->size = data_size;
+    frame->aux_data[frame->nb_aux_data++] = aux;
+    return aux;
+}
+
+static const ni_aux_data_t *mock_get_aux_data(const ni_frame_t *frame,
+                                              ni_aux_data_type_t type)
+{
+    for (int i = 0; i < frame->nb_aux_data; i++)
+        if (frame->aux_data[i]->type == type)
+            return frame->aux_data[i];
+    return NULL;
+}
+
+void ni_get_min_frame_dim(int width, int height, ni_pix_fmt_t pix_fmt,
+                          int plane_stride[NI_MAX_NUM_DATA_POINTERS],
+                          int plane_height[NI_MAX_NUM_DATA_POINTERS])
+{
+    int factor = pix_fmt == NI_PIX_FMT_YUV420P10LE || pix_fmt == NI_PIX_FMT_P010LE ? 2 : 1;
+
+    width  = width < NI_MIN_WIDTH ? NI_MIN_WIDTH : width;
+    height = height < NI_MIN_HEIGHT ? NI_MIN_HEIGHT : NI_MOCK_ALIGN(height, 2);
+    memset(plane_stride, 0, NI_MAX_NUM_DATA_POINTERS * sizeof(*plane_stride));
+    memset(plane_height, 0, NI_MAX_NUM_DATA_POINTERS * sizeof(*plane_height));
+
+    switch (pix_fmt) {
+    case NI_PIX_FMT_RGBA:
+    case NI_PIX_FMT_BGRA:
+    case NI_PIX_FMT_ARGB:
+    case NI_PIX_FMT_ABGR:
+        plane_stride[0] = NI_MOCK_ALIGN(width * 4, 16);
+        plane_height[0] = height;
+        break;
+    case NI_PIX_FMT_NV12:
+    case NI_PIX_FMT_P010LE:
+        plane_stride[0] = plane_stride[1] = NI_MOCK_ALIGN(width * factor, 128);
+        plane_height[0] = height;
+        plane_height[1] = height / 2;
+        break;
+    default:
+        plane_stride[0] = NI_MOCK_ALIGN(width * factor, 128);
+        plane_stride[1] = plane_stride[2] = NI_MOCK_ALIGN(width * factor / 2, 128);
+        plane_height[0] = height;
+        plane_height[1] = plane_height[2] = height / 2;
+        break;
+    }
+}
+
+void ni_copy_frame_data(uint8_t *p_dst[NI_MAX_NUM_DATA_POINTERS],
+                        uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS],
+                        int frame_width, int frame_height, int factor,
+                        ni_pix_fmt_t pix_fmt, int conf_win_right,
+                        int dst_stride[NI_MAX_NUM_DATA_POINTERS],
+                        int dst_height[NI_MAX_NUM_DATA_POINTERS],
+                        int src_stride[NI_MAX_NUM_DATA_POINTERS],
+                        int src_height[NI_MAX_NUM_DATA_POINTERS])
+{
+    for (int i = 0; i < 3; i++) {
+        int width = frame_width * factor;
+
+        if (!p_dst[i] || !src_height[i])
+            continue;
+        if (pix_fmt == NI_PIX_FMT_RGBA || pix_fmt == NI_PIX_FMT_BGRA ||
+            pix_fmt == NI_PIX_FMT_ARGB || pix_fmt == NI_PIX_FMT_ABGR)
+            width = frame_width * 4;
+        else if (i && pix_fmt != NI_PIX_FMT_NV12 && pix_fmt != NI_PIX_FMT_P010LE)
+            width = (frame_width + 1) / 2 * factor;
+        if (width > dst_stride[i])
+            width = dst_stride[i];
+
+        // pad the bottom by repeating the last line
+        for (int y = 0; y < dst_height[i]; y++) {
+            int sy = y < src_height[i] ? y : src_height[i] - 1;
+            memcpy(p_dst[i] + y * dst_stride[i], p_src[i] + sy * src_stride[i], width);
+            memset(p_dst[i] + y * dst_stride[i] + width, 0, dst_stride[i] - width);
+        }
+    }
+}
+
+ni_retcode_t ni_expand_frame(ni_frame_t *dst, ni_frame_t *src,
+                             int dst_stride[], int raw_width, int raw_height,
+                             int ni_fmt, int nb_planes)
+{
+    return NI_RETCODE_FAILURE;
+}
+
+int ni_should_send_sei_with_frame(ni_session_context_t *p_enc_ctx,
+                                  ni_pic_type_t pic_type,
+                                  ni_xcoder_params_t *p_param)
+{
+    const NIMockEncoder *m = p_enc_ctx->p_mock;
+    int period = p_param->cfg_enc_params.intra_period;
+
+    return pic_type == PIC_TYPE_IDR || !m || !m->written ||
+           (period && !(m->written % period));
+}
+
+int ni_enc_prep_reconf_demo_data(ni_session_context_t *p_enc_ctx,
+                                 ni_frame_t *p_dec_frame)
+{
+    return 0;
+}
+
+/*
+ * HDR static metadata is kept from the last frame that had it and goes out
+ * with every frame that carries SEI, i.e. each IDR. Other SEI types go out
+ * only with the frame that has them.
+ */
+void ni_enc_prep_aux_data(ni_session_context_t *p_enc_ctx,
+                          ni_frame_t *p_enc_frame, ni_frame_t *p_dec_frame,
+                          ni_codec_format_t codec_format, int should_send_sei_with_frame,
+                          uint8_t *mdcv_data, uint8_t *cll_data,
+                          uint8_t *cc_data, uint8_t *udu_data, uint8_t *hdrp_data)
+{
+    const ni_aux_data_t *aux;
+
+    aux = mock_get_aux_data(p_dec_frame, NI_FRAME_AUX_DATA_CONTENT_LIGHT_LEVEL);
+    if (aux) {
+        memcpy(cll_data, aux->data,
+aux->size < NI_MOCK_CLL_SEI_SIZE ? aux->size : NI_MOCK_CLL_SEI_SIZE);
+        p_enc_ctx->light_level_data_len = NI_MOCK_CLL_SEI_SIZE;
+        p_enc_ctx->sei_hdr_content_light_level_info_len = NI_MOCK_CLL_SEI_SIZE;
+    }
+    aux = mock_get_aux_data(p_dec_frame, NI_FRAME_AUX_DATA_MASTERING_DISPLAY_METADATA);
+    if (aux) {
+        memcpy(mdcv_data, aux->data,
+               aux->size < NI_MOCK_MDCV_SEI_SIZE ? aux->size : NI_MOCK_MDCV_SEI_SIZE);
+        p_enc_ctx->sei_hdr_mastering_display_color_vol_len = NI_MOCK_MDCV_SEI_SIZE;
+    }
+
+    if (should_send_sei_with_frame) {
+        p_enc_frame->sei_hdr_content_light_level_info_len =
+            p_enc_ctx->sei_hdr_content_light_level_info_len;
+        p_enc_frame->sei_hdr_mastering_display_color_vol_len =
+            p_enc_ctx->sei_hdr_mastering_display_color_vol_len;
+    }
+
+    aux = mock_get_aux_data(p_dec_frame, NI_FRAME_AUX_DATA_A53_CC);
+    if (aux && aux->size <= NI_MAX_SEI_DATA) {
+        memcpy(cc_data, aux->data, aux->size);
+        p_enc_frame->sei_cc_len = aux->size;
+    }
+    aux = mock_get_aux_data(p_dec_frame, NI_FRAME_AUX_DATA_UDU_SEI);
+    if (aux && aux->size <= NI_MAX_SEI_DATA) {
+        memcpy(udu_data, aux->data, aux->size);
+        p_enc_frame->sei_user_data_unreg_len = aux->size;
+    }
+
+    p_enc_frame->sei_total_len = p_enc_frame->sei_hdr_content_light_level_info_len +
+                                 p_enc_frame->sei_hdr_mastering_display_color_vol_len +
+                                 p_enc_frame->sei_cc_len +
+                                 p_enc_frame->sei_user_data_unreg_len;
+}
+
+void ni_enc_copy_aux_data(ni_session_context_t *p_enc_ctx,
+                          ni_frame_t *p_enc_frame, ni_frame_t *p_dec_frame,
+                          ni_codec_format_t codec_format,
+                          const uint8_t *mdcv_data, const uint8_t *cll_data,
+                          const uint8_t *cc_data, const uint8_t *udu_data,
+                          const uint8_t *hdrp_data, int is_hwframe,
+                          int is_semiplanar)
+{
+    uint8_t *p = p_enc_frame->p_buffer;
+
+    if (!p_enc_frame->sei_total_len || !p)
+        return;
+    // the aux data follows the planes, the frame metadata and reconfig data
+    for (int i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++)
+        p += p_enc_frame->data_len[i];
+    p += NI_APP_ENC_FRAME_META_DATA_SIZE + sizeof(ni_encoder_change_params_t);
+
+    memcpy(p, mdcv_data, p_enc_frame->sei_hdr_mastering_display_color_vol_len);
+    p += p_enc_frame->sei_hdr_mastering_display_color_vol_len;
+    memcpy(p, cll_data, p_enc_frame->sei_hdr_content_light_level_info_len);
+    p += p_enc_frame->sei_hdr_content_light_level_info_len;
+    memcpy(p, cc_data, p_enc_frame->sei_cc_len);
+    p += p_enc_frame->sei_cc_len;
+    memcpy(p, udu_data, p_enc_frame->sei_user_data_unreg_len);
+}
+
+int ni_set_demo_roi_map(ni_session_context_t *p_enc_ctx)
+{
+    return 0;
+}
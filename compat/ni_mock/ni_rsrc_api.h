@@ -0,0 +1,37 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/*
+ * Software stand-in for the libxcoder headers, see ni_device_api.h.
+ */
+
+#ifndef COMPAT_NI_MOCK_NI_RSRC_API_H
+#define COMPAT_NI_MOCK_NI_RSRC_API_H
+
+#include "ni_device_api.h"
+
+/* resource pool entry of a card, never allocated by the emulation */
+typedef struct _ni_device_context {
+    char shm_name[32];
+    void *p_device_info;
+} ni_device_context_t;
+
+void ni_rsrc_free_device_context(ni_device_context_t *p_device_context);
+
+#endif /* COMPAT_NI_MOCK_NI_RSRC_API_H */
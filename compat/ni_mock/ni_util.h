@@ -0,0 +1,56 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/*
+ * Software stand-in for the libxcoder headers, see ni_device_api.h.
+ */
+
+#ifndef COMPAT_NI_MOCK_NI_UTIL_H
+#define COMPAT_NI_MOCK_NI_UTIL_H
+
+#include "ni_device_api.h"
+
+typedef enum {
+    NI_LOG_NONE  = 0,
+    NI_LOG_FATAL = 1,
+    NI_LOG_ERROR = 2,
+    NI_LOG_INFO  = 3,
+    NI_LOG_DEBUG = 4,
+    NI_LOG_TRACE = 5,
+} ni_log_level_t;
+
+void ni_log_set_level(ni_log_level_t level);
+ni_log_level_t ff_to_ni_log_level(int fflog_level);
+
+void ni_get_min_frame_dim(int width, int height, ni_pix_fmt_t pix_fmt,
+                          int plane_stride[NI_MAX_NUM_DATA_POINTERS],
+                          int plane_height[NI_MAX_NUM_DATA_POINTERS]);
+void ni_copy_frame_data(uint8_t *p_dst[NI_MAX_NUM_DATA_POINTERS],
+                        uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS],
+                        int frame_width, int frame_height, int factor,
+                        ni_pix_fmt_t pix_fmt, int conf_win_right,
+                        int dst_stride[NI_MAX_NUM_DATA_POINTERS],
+                        int dst_height[NI_MAX_NUM_DATA_POINTERS],
+                        int src_stride[NI_MAX_NUM_DATA_POINTERS],
+                        int src_height[NI_MAX_NUM_DATA_POINTERS]);
+ni_retcode_t ni_expand_frame(ni_frame_t *dst, ni_frame_t *src,
+                             int dst_stride[], int raw_width, int raw_height,
+                             int ni_fmt, int nb_planes);
+
+#endif /* COMPAT_NI_MOCK_NI_UTIL_H */
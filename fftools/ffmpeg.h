@@ -416,6 +416,10 @@ typedef struct DecoderOpts {
     // Either forced (when DECODER_FLAG_FRAMERATE_FORCED is set) or
     // estimated (otherwise) video framerate.
     AVRational                  framerate;
+
+    // splice scheduler shared by the SCTE-35 stream and the video stream
+    // of the same input that forces keyframes at its splice points
+    struct ni_scte35_decoder   *scte35;
 } DecoderOpts;
 
 typedef struct Decoder {
@@ -739,6 +743,7 @@ extern int print_stats;
 extern int64_t stats_period;
 extern int stdin_interaction;
 extern AVIOContext *progress_avio;
+extern AVIOContext *sched_stats_avio;
 extern float max_error_rate;
 
 extern char *filter_nbthreads;
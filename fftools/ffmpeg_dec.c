@@ -38,8 +38,6 @@
 
 #include "libavformat/ni_scte35.h"
 
-ni_scte35_decoder *scte35_decoder = NULL;
-
 typedef struct DecoderPriv {
     Decoder             dec;
 
@@ -58,6 +56,10 @@ typedef struct DecoderPriv {
     int                 flags;
     int                 apply_cropping;
 
+    // splice scheduler of this input, fed by the SCTE-35 decoder and
+    // consumed by the video decoder; owned by the demuxer
+    ni_scte35_decoder  *scte35;
+
     enum AVPixelFormat  hwaccel_pix_fmt;
     enum HWAccelID      hwaccel_id;
     enum AVHWDeviceType hwaccel_device_type;
@@ -708,16 +710,11 @@ static int packet_decode(DecoderPriv *dp, AVPacket *pkt, AVFrame *frame)
         return transcode_subtitles(dp, pkt, frame);
     else if (dec->codec_type == AVMEDIA_TYPE_DATA &&
              dec->codec_id == AV_CODEC_ID_SCTE_35) {
-        if (!scte35_decoder) {
-            scte35_decoder = ff_alloc_ni_scte35_decoder();
-            if (!scte35_decoder) {
-                av_log(dp, AV_LOG_ERROR, "Error allocating scte-35 decoder.\n");
-                return AVERROR(ENOMEM);
-            }
-        }
+        if (!dp->scte35)
+            return 0;
 
         av_log(dp, AV_LOG_VERBOSE, "Decoding SCTE-35 pkt !\n");
-        return decode_scte35(scte35_decoder, pkt);
+        return decode_scte35(dp->scte35, pkt);
     }
 
     // With fate-indeo3-2, we're getting 0-sized packets before EOF for some
@@ -801,8 +798,8 @@ static int packet_decode(DecoderPriv *dp, AVPacket *pkt, AVFrame *frame)
         fd->dec.frame_num           = dec->frame_num - 1;
         fd->bits_per_raw_sample     = dec->bits_per_raw_sample;
 
-        if (dec->codec_type == AVMEDIA_TYPE_VIDEO && scte35_decoder) {
-            fd->is_scte35_keyframe  = is_scte35_keyframe(scte35_decoder, frame->pts, &dec->pkt_timebase);
+        if (dec->codec_type == AVMEDIA_TYPE_VIDEO && dp->scte35) {
+            fd->is_scte35_keyframe  = is_scte35_keyframe(dp->scte35, frame->pts, &dec->pkt_timebase);
             if (fd->is_scte35_keyframe) {
                 av_log(NULL, AV_LOG_VERBOSE, "frame %" PRIu64 " is_scte35_keyframe\n", fd->dec.frame_num);
             }
@@ -1042,10 +1039,6 @@ static int decoder_thread(void *arg)
     }
 
 finish:
-    if (dp->dec_ctx && dp->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
-        ff_free_ni_scte35_decoder(scte35_decoder);
-    }
-
     dec_thread_uninit(&dt);
 
     return ret;
@@ -1555,6 +1548,7 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
 
     dp->flags      = o->flags;
     dp->log_parent = o->log_parent;
+    dp->scte35     = o->scte35;
 
     dp->dec.type                = codec->type;
     dp->framerate_in            = o->framerate;
@@ -39,6 +39,7 @@
 #include "libavcodec/packet.h"
 
 #include "libavformat/avformat.h"
+#include "libavformat/ni_scte35.h"
 
 typedef struct DemuxStream {
     InputStream              ist;
@@ -136,6 +137,12 @@ typedef struct Demuxer {
     int                   read_started;
     int                   nb_streams_used;
     int                   nb_streams_finished;
+
+    /* splice scheduler fed by the first SCTE-35 stream and consumed by the
+     * first decoded video stream of this input */
+    ni_scte35_decoder    *scte35;
+    int                   scte35_producer_bound;
+    int                   scte35_consumer_bound;
 } Demuxer;
 
 typedef struct DemuxThreadContext {
@@ -873,10 +880,46 @@ void ifile_close(InputFile **pf)
     avformat_close_input(&f->ctx);
 
     av_packet_free(&d->pkt_heartbeat);
+    ff_free_ni_scte35_decoder(d->scte35);
 
     av_freep(pf);
 }
 
+static int ist_scte35_attach(Demuxer *d, InputStream *ist, DecoderOpts *o)
+{
+    int has_scte35 = 0;
+
+    if (ist->par->codec_id == AV_CODEC_ID_SCTE_35) {
+        if (d->scte35_producer_bound) {
+            av_log(ist, AV_LOG_WARNING, "Only the first SCTE-35 stream of an "
+                   "input schedules splice points, ignoring this one\n");
+            return 0;
+        }
+        d->scte35_producer_bound = 1;
+    } else if (ist->par->codec_type == AVMEDIA_TYPE_VIDEO &&
+               !d->scte35_consumer_bound) {
+        for (unsigned i = 0; i < d->f.ctx->nb_streams && !has_scte35; i++)
+            has_scte35 = d->f.ctx->streams[i]->codecpar->codec_id == AV_CODEC_ID_SCTE_35;
+        if (!has_scte35)
+            return 0;
+        d->scte35_consumer_bound = 1;
+    } else
+        return 0;
+
+    if (!d->scte35) {
+        d->scte35 = ff_alloc_ni_scte35_decoder();
+        if (!d->scte35)
+            return AVERROR(ENOMEM);
+    }
+    // the SCTE-35 decoder may be bound first, cues are queued once a
+    // decoded video stream consumes them
+    if (d->scte35_consumer_bound)
+        ff_bind_ni_scte35_consumer(d->scte35);
+    o->scte35 = d->scte35;
+
+    return 0;
+}
+
 static int ist_use(InputStream *ist, int decoding_needed,
                    const ViewSpecifier *vs, SchedulerNode *src)
 {
@@ -952,6 +995,10 @@ static int ist_use(InputStream *ist, int decoding_needed,
 
         ds->dec_opts.log_parent = ist;
 
+        ret = ist_scte35_attach(d, ist, &ds->dec_opts);
+        if (ret < 0)
+            return ret;
+
         ds->decoded_params = av_frame_alloc();
         if (!ds->decoded_params)
             return AVERROR(ENOMEM);
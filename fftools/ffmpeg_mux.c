@@ -135,6 +135,39 @@ static void mux_log_debug_ts(OutputStream *ost, const AVPacket *pkt)
            pkt->size, *latency ? latency : "N/A");
 }
 
+static void mux_stats_latency(Muxer *mux, MuxStream *ms, const AVPacket *pkt)
+{
+    // the probe ending each stage
+    static const int stage_end[SCH_LATENCY_NB] = {
+        [SCH_LATENCY_DEC]    = LATENCY_PROBE_DEC_POST,
+        [SCH_LATENCY_FILTER] = LATENCY_PROBE_FILTER_POST,
+        [SCH_LATENCY_ENC]    = LATENCY_PROBE_ENC_POST,
+        [SCH_LATENCY_MUX]    = LATENCY_PROBE_NB,
+    };
+    const FrameData *fd = (FrameData*)pkt->opaque_ref->data;
+    int64_t latency[SCH_LATENCY_NB] = { 0 };
+    int64_t now  = av_gettime_relative();
+    int64_t prev = INT64_MIN;
+
+    // measure from the earliest probe, the demuxer for transcoded inputs
+    for (unsigned i = 0; i < FF_ARRAY_ELEMS(fd->wallclock) && prev == INT64_MIN; i++)
+        prev = fd->wallclock[i];
+    if (prev == INT64_MIN)
+        return;
+
+    for (int i = 0; i < SCH_LATENCY_NB; i++) {
+        int64_t end = stage_end[i] == LATENCY_PROBE_NB ? now :
+                      fd->wallclock[stage_end[i]];
+
+        if (end == INT64_MIN || end < prev)
+            continue;
+        latency[i] = end - prev;
+        prev       = end;
+    }
+
+    sch_mux_stream_latency(mux->sch, mux->sch_idx, ms->sch_idx, latency);
+}
+
 static int mux_fixup_ts(Muxer *mux, MuxStream *ms, AVPacket *pkt)
 {
     OutputStream *ost = &ms->ost;
@@ -203,6 +236,9 @@ static int mux_fixup_ts(Muxer *mux, MuxStream *ms, AVPacket *pkt)
     if (debug_ts)
         mux_log_debug_ts(ost, pkt);
 
+    if (sched_stats_avio && pkt->opaque_ref && ms->sch_idx >= 0)
+        mux_stats_latency(mux, ms, pkt);
+
     return 0;
 }
 
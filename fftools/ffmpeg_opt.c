@@ -616,6 +616,20 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(sch, arg);
 }
 
+static int opt_sched_pool(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    double num;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT, -1, INT_MAX, &num);
+    if (ret < 0)
+        return ret;
+
+    sch_job_pool(sch, num);
+    return 0;
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1431,6 +1445,24 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_sched_stats(void *optctx, const char *opt, const char *arg)
+{
+    AVIOContext *avio = NULL;
+    int ret;
+
+    if (!strcmp(arg, "-"))
+        arg = "pipe:";
+    ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &int_cb, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open scheduler statistics URL \"%s\": %s\n",
+               arg, av_err2str(ret));
+        return ret;
+    }
+    avio_closep(&sched_stats_avio);
+    sched_stats_avio = avio;
+    return 0;
+}
+
 int opt_timelimit(void *optctx, const char *opt, const char *arg)
 {
 #if HAVE_SETRLIMIT
@@ -1578,6 +1610,9 @@ const OptionDef options[] = {
     { "progress",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
+    { "sched_stats",            OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_stats },
+      "write scheduler statistics as JSON lines", "url" },
     { "stdin",                  OPT_TYPE_BOOL, OPT_EXPERT,
         { &stdin_interaction },
       "enable or disable interaction on standard input" },
@@ -1685,6 +1720,9 @@ const OptionDef options[] = {
     { "filter_complex_threads", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "sched_pool",             OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_pool },
+        "run the transcoding tasks on a pool of this many threads (-1: one per CPU, 0: a thread per task)", "number" },
     { "lavfi",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
@@ -26,18 +26,20 @@
 #include "cmdutils.h"
 #include "ffmpeg_sched.h"
 #include "ffmpeg_utils.h"
+#include "job_pool.h"
 #include "sync_queue.h"
 #include "thread_queue.h"
+#include "ts_heap.h"
 
 #include "libavcodec/packet.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
-#include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 #include "libavutil/avstring.h"
 
@@ -52,8 +54,15 @@ enum QueueType {
 
 typedef struct SchWaiter {
     pthread_mutex_t     lock;
-    pthread_cond_t      cond;
+    JobCond             cond;
     atomic_int          choked;
+    // time spent choked, in microseconds
+    atomic_int_least64_t wait_time;
+
+    /* unfinished muxer streams fed from this source, by last_dts;
+     * protected by Scheduler.schedule_lock */
+    TsHeap             *mux_streams;
+    unsigned         nb_mux_streams;
 
     // the following are internal state of schedule_update_locked() and must not
     // be accessed outside of it
@@ -69,9 +78,20 @@ typedef struct SchTask {
     void               *func_arg;
 
     pthread_t           thread;
+    // set instead of thread when the task runs on the job pool
+    Job                *job;
     int                 thread_running;
 } SchTask;
 
+// One-slot queue for the post-flush end timestamps of a decoder
+typedef struct SchEndTs {
+    pthread_mutex_t     lock;
+    JobCond             cond;
+    Timestamp           ts;
+    int                 full;
+    int                 finished;
+} SchEndTs;
+
 typedef struct SchDecOutput {
     SchedulerNode      *dst;
     uint8_t            *dst_finished;
@@ -91,7 +111,7 @@ typedef struct SchDec {
     ThreadQueue        *queue;
 
     // Queue for sending post-flush end timestamps back to the source
-    AVThreadMessageQueue *queue_end_ts;
+    SchEndTs           *queue_end_ts;
     int                 expect_end_ts;
 
     // temporary storage used by sch_dec_send()
@@ -101,7 +121,7 @@ typedef struct SchDec {
 typedef struct SchSyncQueue {
     SyncQueue          *sq;
     AVFrame            *frame;
-    pthread_mutex_t     lock;
+    JobMutex            lock;
 
     unsigned           *enc_idx;
     unsigned         nb_enc_idx;
@@ -208,7 +228,18 @@ typedef struct SchMuxStream {
     int64_t             last_dts;
     // this stream no longer accepts input
     int                 source_finished;
+    // SchWaiter.mux_streams of the src_sched waiter and the id in it
+    TsHeap             *sched_heap;
+    unsigned            sched_heap_id;
     ////////////////////////////////////////////////////////////
+
+    // packet latencies from sch_mux_stream_latency(), in microseconds
+    atomic_uint_least64_t latency_nb;
+    atomic_int_least64_t  latency_sum[SCH_LATENCY_NB];
+    atomic_int_least64_t  latency_max;
+    // the above at the previous sch_stats_print()
+    uint64_t            latency_nb_prev;
+    int64_t             latency_sum_prev[SCH_LATENCY_NB];
 } SchMuxStream;
 
 typedef struct SchMux {
@@ -283,7 +314,7 @@ struct Scheduler {
     unsigned         nb_mux;
 
     unsigned         nb_mux_ready;
-    pthread_mutex_t     mux_ready_lock;
+    JobMutex            mux_ready_lock;
 
     unsigned         nb_mux_done;
     pthread_mutex_t     mux_done_lock;
@@ -312,6 +343,12 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    // number of job pool workers, 0 to run each task on its own thread
+    int                 nb_pool_workers;
+    JobPool            *pool;
+
+    int64_t             start_time;
 };
 
 /**
@@ -324,18 +361,25 @@ static int waiter_wait(Scheduler *sch, SchWaiter *w)
 {
     int terminate;
 
+    int64_t t0;
+
     if (!atomic_load(&w->choked))
         return 0;
 
+    t0 = av_gettime_relative();
+
     pthread_mutex_lock(&w->lock);
 
     while (atomic_load(&w->choked) && !atomic_load(&sch->terminate))
-        pthread_cond_wait(&w->cond, &w->lock);
+        jp_cond_wait(&w->cond, &w->lock);
 
     terminate = atomic_load(&sch->terminate);
 
     pthread_mutex_unlock(&w->lock);
 
+    atomic_fetch_add_explicit(&w->wait_time, av_gettime_relative() - t0,
+                              memory_order_relaxed);
+
     return terminate;
 }
 
@@ -344,7 +388,7 @@ static void waiter_set(SchWaiter *w, int choked)
     pthread_mutex_lock(&w->lock);
 
     atomic_store(&w->choked, choked);
-    pthread_cond_signal(&w->cond);
+    jp_cond_signal(&w->cond);
 
     pthread_mutex_unlock(&w->lock);
 }
@@ -354,22 +398,111 @@ static int waiter_init(SchWaiter *w)
     int ret;
 
     atomic_init(&w->choked, 0);
+    atomic_init(&w->wait_time, 0);
+
+    w->mux_streams = ts_heap_alloc(0);
+    if (!w->mux_streams)
+        return AVERROR(ENOMEM);
 
     ret = pthread_mutex_init(&w->lock, NULL);
     if (ret)
         return AVERROR(ret);
 
-    ret = pthread_cond_init(&w->cond, NULL);
-    if (ret)
+    return jp_cond_init(&w->cond);
+}
+
+static void waiter_uninit(SchWaiter *w)
+{
+    pthread_mutex_destroy(&w->lock);
+    jp_cond_destroy(&w->cond);
+
+    ts_heap_free(&w->mux_streams);
+}
+
+static int end_ts_alloc(SchEndTs **pe)
+{
+    SchEndTs *e;
+    int ret;
+
+    e = av_mallocz(sizeof(*e));
+    if (!e)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&e->lock, NULL);
+    if (ret) {
+        av_freep(&e);
         return AVERROR(ret);
+    }
+
+    ret = jp_cond_init(&e->cond);
+    if (ret < 0) {
+        pthread_mutex_destroy(&e->lock);
+        av_freep(&e);
+        return ret;
+    }
 
+    *pe = e;
     return 0;
 }
 
-static void waiter_uninit(SchWaiter *w)
+static void end_ts_free(SchEndTs **pe)
 {
-    pthread_mutex_destroy(&w->lock);
-    pthread_cond_destroy(&w->cond);
+    SchEndTs *e = *pe;
+
+    if (!e)
+        return;
+
+    jp_cond_destroy(&e->cond);
+    pthread_mutex_destroy(&e->lock);
+    av_freep(pe);
+}
+
+static void end_ts_send(SchEndTs *e, Timestamp ts)
+{
+    pthread_mutex_lock(&e->lock);
+
+    while (e->full)
+        jp_cond_wait(&e->cond, &e->lock);
+
+    e->ts   = ts;
+    e->full = 1;
+    jp_cond_broadcast(&e->cond);
+
+    pthread_mutex_unlock(&e->lock);
+}
+
+/**
+ * @return 0 on success, AVERROR_EOF when the decoder has finished
+ */
+static int end_ts_receive(SchEndTs *e, Timestamp *ts)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&e->lock);
+
+    while (!e->full && !e->finished)
+        jp_cond_wait(&e->cond, &e->lock);
+
+    if (e->full) {
+        *ts     = e->ts;
+        e->full = 0;
+        jp_cond_broadcast(&e->cond);
+    } else
+        ret = AVERROR_EOF;
+
+    pthread_mutex_unlock(&e->lock);
+
+    return ret;
+}
+
+static void end_ts_finish(SchEndTs *e)
+{
+    pthread_mutex_lock(&e->lock);
+
+    e->finished = 1;
+    jp_cond_broadcast(&e->cond);
+
+    pthread_mutex_unlock(&e->lock);
 }
 
 static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
@@ -414,12 +547,26 @@ static void *task_wrapper(void *arg);
 
 static int task_start(SchTask *task)
 {
+    JobPool *pool = task->parent->pool;
     int ret;
 
-    av_log(task->func_arg, AV_LOG_VERBOSE, "Starting thread...\n");
+    av_log(task->func_arg, AV_LOG_VERBOSE, "Starting %s...\n",
+           pool ? "job" : "thread");
 
     av_assert0(!task->thread_running);
 
+    if (pool) {
+        ret = jp_submit(pool, &task->job, task_wrapper, task);
+        if (ret < 0) {
+            av_log(task->func_arg, AV_LOG_ERROR, "Could not start the job: %s\n",
+                   av_err2str(ret));
+            return ret;
+        }
+
+        task->thread_running = 1;
+        return 0;
+    }
+
     ret = pthread_create(&task->thread, NULL, task_wrapper, task);
     if (ret) {
         av_log(task->func_arg, AV_LOG_ERROR, "pthread_create() failed: %s\n",
@@ -443,18 +590,50 @@ static void task_init(Scheduler *sch, SchTask *task, enum SchedulerNodeType type
     task->func_arg  = func_arg;
 }
 
+// must be called with schedule_lock held
+static void mux_stream_set_dts(SchMuxStream *ms, int64_t dts)
+{
+    ms->last_dts = dts;
+    if (ms->sched_heap && !ms->source_finished)
+        ts_heap_set(ms->sched_heap, ms->sched_heap_id, dts, AV_TIME_BASE_Q);
+}
+
+// must be called with schedule_lock held
+static void mux_stream_source_finish(SchMuxStream *ms)
+{
+    ms->source_finished = 1;
+    if (ms->sched_heap)
+        ts_heap_remove(ms->sched_heap, ms->sched_heap_id);
+}
+
 static int64_t trailing_dts(const Scheduler *sch, int count_finished)
 {
     int64_t min_dts = INT64_MAX;
 
+    // the unfinished streams are kept sorted per source
+    if (!count_finished) {
+        for (unsigned type = 0; type < 2; type++)
+            for (unsigned i = 0; i < (type ? sch->nb_filters : sch->nb_demux); i++) {
+                const SchWaiter *w = type ? &sch->filters[i].waiter : &sch->demux[i].waiter;
+                int64_t dts;
+
+                if (ts_heap_top(w->mux_streams, &dts) < 0)
+                    continue;
+                if (dts == AV_NOPTS_VALUE)
+                    return AV_NOPTS_VALUE;
+
+                min_dts = FFMIN(min_dts, dts);
+            }
+
+        return min_dts == INT64_MAX ? AV_NOPTS_VALUE : min_dts;
+    }
+
     for (unsigned i = 0; i < sch->nb_mux; i++) {
         const SchMux *mux = &sch->mux[i];
 
         for (unsigned j = 0; j < mux->nb_streams; j++) {
             const SchMuxStream *ms = &mux->streams[j];
 
-            if (ms->source_finished && !count_finished)
-                continue;
             if (ms->last_dts == AV_NOPTS_VALUE)
                 return AV_NOPTS_VALUE;
 
@@ -474,6 +653,8 @@ void sch_free(Scheduler **psch)
 
     sch_stop(sch, NULL);
 
+    jp_free(&sch->pool);
+
     for (unsigned i = 0; i < sch->nb_demux; i++) {
         SchDemux *d = &sch->demux[i];
 
@@ -518,7 +699,7 @@ void sch_free(Scheduler **psch)
 
         tq_free(&dec->queue);
 
-        av_thread_message_queue_free(&dec->queue_end_ts);
+        end_ts_free(&dec->queue_end_ts);
 
         for (unsigned j = 0; j < dec->nb_outputs; j++) {
             SchDecOutput *o = &dec->outputs[j];
@@ -549,7 +730,7 @@ void sch_free(Scheduler **psch)
         SchSyncQueue *sq = &sch->sq_enc[i];
         sq_free(&sq->sq);
         av_frame_free(&sq->frame);
-        pthread_mutex_destroy(&sq->lock);
+        jp_mutex_destroy(&sq->lock);
         av_freep(&sq->enc_idx);
     }
     av_freep(&sch->sq_enc);
@@ -570,7 +751,7 @@ void sch_free(Scheduler **psch)
 
     pthread_mutex_destroy(&sch->schedule_lock);
 
-    pthread_mutex_destroy(&sch->mux_ready_lock);
+    jp_mutex_destroy(&sch->mux_ready_lock);
 
     pthread_mutex_destroy(&sch->mux_done_lock);
     pthread_cond_destroy(&sch->mux_done_cond);
@@ -599,8 +780,8 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
-    ret = pthread_mutex_init(&sch->mux_ready_lock, NULL);
-    if (ret)
+    ret = jp_mutex_init(&sch->mux_ready_lock);
+    if (ret < 0)
         goto fail;
 
     ret = pthread_mutex_init(&sch->mux_done_lock, NULL);
@@ -617,6 +798,11 @@ fail:
     return NULL;
 }
 
+void sch_job_pool(Scheduler *sch, int nb_workers)
+{
+    sch->nb_pool_workers = nb_workers;
+}
+
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
 {
     av_freep(&sch->sdp_filename);
@@ -775,7 +961,7 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx, int send_end_ts)
         return ret;
 
     if (send_end_ts) {
-        ret = av_thread_message_queue_alloc(&dec->queue_end_ts, 1, sizeof(Timestamp));
+        ret = end_ts_alloc(&dec->queue_end_ts);
         if (ret < 0)
             return ret;
     }
@@ -887,9 +1073,9 @@ int sch_add_sq_enc(Scheduler *sch, uint64_t buf_size_us, void *logctx)
     if (!sq->frame)
         return AVERROR(ENOMEM);
 
-    ret = pthread_mutex_init(&sq->lock, NULL);
-    if (ret)
-        return AVERROR(ret);
+    ret = jp_mutex_init(&sq->lock);
+    if (ret < 0)
+        return ret;
 
     return sq - sch->sq_enc;
 }
@@ -1114,19 +1300,34 @@ static int mux_task_start(SchMux *mux)
     /* flush the pre-muxing queues */
     for (unsigned i = 0; i < mux->nb_streams; i++) {
         SchMuxStream *ms = &mux->streams[i];
-        AVPacket *pkt;
-
-        while (av_fifo_read(ms->pre_mux_queue.fifo, &pkt, 1) >= 0) {
-            if (pkt) {
-                if (!ms->init_eof)
-                    ret = tq_send(mux->queue, i, pkt);
-                av_packet_free(&pkt);
-                if (ret == AVERROR_EOF)
-                    ms->init_eof = 1;
-                else if (ret < 0)
-                    return ret;
-            } else
+        AVPacket *pkts[16];
+
+        while (1) {
+            unsigned nb_pkts = 0;
+            int finished = 0;
+
+            while (nb_pkts < FF_ARRAY_ELEMS(pkts) &&
+                   av_fifo_read(ms->pre_mux_queue.fifo, &pkts[nb_pkts], 1) >= 0) {
+                if (!pkts[nb_pkts]) {
+                    finished = 1;
+                    break;
+                }
+                nb_pkts++;
+            }
+
+            if (nb_pkts && !ms->init_eof)
+                ret = tq_send_batch(mux->queue, i, (void**)pkts, nb_pkts);
+            for (unsigned j = 0; j < nb_pkts; j++)
+                av_packet_free(&pkts[j]);
+            if (ret == AVERROR_EOF)
+                ms->init_eof = 1;
+            else if (ret < 0)
+                return ret;
+
+            if (finished)
                 tq_send_finish(mux->queue, i);
+            else if (nb_pkts < FF_ARRAY_ELEMS(pkts))
+                break;
         }
     }
 
@@ -1199,7 +1400,7 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx)
 
     av_assert0(stream_idx < mux->nb_streams);
 
-    pthread_mutex_lock(&sch->mux_ready_lock);
+    jp_mutex_lock(&sch->mux_ready_lock);
 
     av_assert0(mux->nb_streams_ready < mux->nb_streams);
 
@@ -1209,7 +1410,7 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx)
         sch->state >= SCH_STATE_STARTED)
         ret = mux_init(sch, mux);
 
-    pthread_mutex_unlock(&sch->mux_ready_lock);
+    jp_mutex_unlock(&sch->mux_ready_lock);
 
     return ret;
 }
@@ -1291,26 +1492,25 @@ static void schedule_update_locked(Scheduler *sch)
         }
 
     // figure out the sources that are allowed to proceed
-    for (unsigned i = 0; i < sch->nb_mux; i++) {
-        SchMux *mux = &sch->mux[i];
-
-        for (unsigned j = 0; j < mux->nb_streams; j++) {
-            SchMuxStream *ms = &mux->streams[j];
+    for (unsigned type = 0; type < 2; type++)
+        for (unsigned i = 0; i < (type ? sch->nb_filters : sch->nb_demux); i++) {
+            SchWaiter *w = type ? &sch->filters[i].waiter : &sch->demux[i].waiter;
+            int64_t last_dts;
 
             // unblock sources for output streams that are not finished
-            // and not too far ahead of the trailing stream
-            if (ms->source_finished)
+            // and not too far ahead of the trailing stream; it is enough
+            // to check the trailing one of each source
+            if (ts_heap_top(w->mux_streams, &last_dts) < 0)
                 continue;
-            if (dts == AV_NOPTS_VALUE && ms->last_dts != AV_NOPTS_VALUE)
+            if (dts == AV_NOPTS_VALUE && last_dts != AV_NOPTS_VALUE)
                 continue;
-            if (dts != AV_NOPTS_VALUE && ms->last_dts - dts >= SCHEDULE_TOLERANCE)
+            if (dts != AV_NOPTS_VALUE && last_dts - dts >= SCHEDULE_TOLERANCE)
                 continue;
 
             // resolve the source to unchoke
-            unchoke_for_stream(sch, ms->src_sched);
+            unchoke_for_stream(sch, type ? SCH_FILTER_OUT(i, 0) : SCH_DSTREAM(i, 0));
             have_unchoked = 1;
         }
-    }
 
     // make sure to unchoke at least one source, if still available
     for (unsigned type = 0; !have_unchoked && type < 2; type++)
@@ -1523,6 +1723,7 @@ static int start_prepare(Scheduler *sch)
 
         for (unsigned j = 0; j < mux->nb_streams; j++) {
             SchMuxStream *ms = &mux->streams[j];
+            SchWaiter     *w;
 
             switch (ms->src.type) {
             case SCH_NODE_TYPE_ENC: {
@@ -1544,6 +1745,19 @@ static int start_prepare(Scheduler *sch)
                        "Muxer stream #%u not connected to a source\n", j);
                 return AVERROR(EINVAL);
             }
+
+            w = ms->src_sched.type == SCH_NODE_TYPE_DEMUX ?
+                &sch->demux[ms->src_sched.idx].waiter :
+                &sch->filters[ms->src_sched.idx].waiter;
+
+            ret = ts_heap_reserve(w->mux_streams, w->nb_mux_streams + 1);
+            if (ret < 0)
+                return ret;
+
+            ms->sched_heap    = w->mux_streams;
+            ms->sched_heap_id = w->nb_mux_streams++;
+            ts_heap_set(ms->sched_heap, ms->sched_heap_id,
+                        ms->last_dts, AV_TIME_BASE_Q);
         }
 
         ret = queue_alloc(&mux->queue, mux->nb_streams, mux->queue_size,
@@ -1606,8 +1820,18 @@ int sch_start(Scheduler *sch)
     if (ret < 0)
         return ret;
 
+    if (sch->nb_pool_workers) {
+        ret = jp_alloc(&sch->pool, sch->nb_pool_workers, sch);
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(sch, AV_LOG_WARNING, "Job pool not supported on this "
+                   "system, running each task on its own thread\n");
+        } else if (ret < 0)
+            return ret;
+    }
+
     av_assert0(sch->state == SCH_STATE_UNINIT);
-    sch->state = SCH_STATE_STARTED;
+    sch->state      = SCH_STATE_STARTED;
+    sch->start_time = av_gettime_relative();
 
     for (unsigned i = 0; i < sch->nb_mux; i++) {
         SchMux *mux = &sch->mux[i];
@@ -1691,6 +1915,153 @@ int sch_wait(Scheduler *sch, uint64_t timeout_us, int64_t *transcode_ts)
     return ret || err;
 }
 
+// time the sender of dst waited on its full input queue
+static int64_t node_send_wait(const Scheduler *sch, SchedulerNode dst)
+{
+    ThreadQueue *tq;
+    unsigned stream_idx = 0;
+
+    switch (dst.type) {
+    case SCH_NODE_TYPE_DEC:       tq = sch->dec[dst.idx].queue;     break;
+    case SCH_NODE_TYPE_ENC:       tq = sch->enc[dst.idx].queue;     break;
+    case SCH_NODE_TYPE_FILTER_IN: tq = sch->filters[dst.idx].queue;
+                                  stream_idx = dst.idx_stream;      break;
+    case SCH_NODE_TYPE_MUX:       tq = sch->mux[dst.idx].queue;
+                                  stream_idx = dst.idx_stream;      break;
+    default: return 0;
+    }
+
+    return tq ? tq_send_wait(tq, stream_idx) : 0;
+}
+
+static int64_t nodes_send_wait(const Scheduler *sch,
+                               const SchedulerNode *dst, unsigned nb_dst)
+{
+    int64_t ret = 0;
+
+    for (unsigned i = 0; i < nb_dst; i++)
+        ret += node_send_wait(sch, dst[i]);
+
+    return ret;
+}
+
+static void stats_print_task(AVBPrint *bp, int *first, const char *type,
+                             unsigned idx, ThreadQueue *in,
+                             int64_t out_wait, const SchWaiter *w)
+{
+    av_bprintf(bp, "%s{\"task\":\"%s:%u\"", *first ? "" : ",", type, idx);
+    *first = 0;
+
+    if (in) {
+        TQStats st;
+
+        tq_stats(in, &st);
+        av_bprintf(bp, ",\"in_wait_us\":%"PRId64, st.recv_wait);
+        av_bprintf(bp, ",\"queue\":{\"size\":%zu,\"depth\":%zu,\"items\":%"PRIu64"}",
+                   st.size, st.depth, st.nb_items);
+    }
+    av_bprintf(bp, ",\"out_wait_us\":%"PRId64, out_wait);
+    if (w)
+        av_bprintf(bp, ",\"choke_wait_us\":%"PRId64, atomic_load(&w->wait_time));
+    av_bprintf(bp, "}");
+}
+
+void sch_stats_print(Scheduler *sch, AVBPrint *bp)
+{
+    static const char *stage_names[SCH_LATENCY_NB] = {
+        [SCH_LATENCY_DEC]    = "dec",
+        [SCH_LATENCY_FILTER] = "filter",
+        [SCH_LATENCY_ENC]    = "enc",
+        [SCH_LATENCY_MUX]    = "mux",
+    };
+    int first = 1;
+
+    av_bprintf(bp, "{\"time_us\":%"PRId64",\"tasks\":[",
+               av_gettime_relative() - sch->start_time);
+
+    for (unsigned i = 0; i < sch->nb_demux; i++) {
+        const SchDemux *d = &sch->demux[i];
+        int64_t out_wait = 0;
+
+        for (unsigned j = 0; j < d->nb_streams; j++)
+            out_wait += nodes_send_wait(sch, d->streams[j].dst,
+                                        d->streams[j].nb_dst);
+
+        stats_print_task(bp, &first, "demux", i, NULL, out_wait, &d->waiter);
+    }
+
+    for (unsigned i = 0; i < sch->nb_dec; i++) {
+        const SchDec *dec = &sch->dec[i];
+        int64_t out_wait = 0;
+
+        for (unsigned j = 0; j < dec->nb_outputs; j++)
+            out_wait += nodes_send_wait(sch, dec->outputs[j].dst,
+                                        dec->outputs[j].nb_dst);
+
+        stats_print_task(bp, &first, "dec", i, dec->queue, out_wait, NULL);
+    }
+
+    for (unsigned i = 0; i < sch->nb_filters; i++) {
+        const SchFilterGraph *fg = &sch->filters[i];
+        int64_t out_wait = 0;
+
+        for (unsigned j = 0; j < fg->nb_outputs; j++)
+            out_wait += node_send_wait(sch, fg->outputs[j].dst);
+
+        stats_print_task(bp, &first, "filter", i, fg->queue, out_wait, &fg->waiter);
+    }
+
+    for (unsigned i = 0; i < sch->nb_enc; i++) {
+        const SchEnc *enc = &sch->enc[i];
+
+        stats_print_task(bp, &first, "enc", i, enc->queue,
+                         nodes_send_wait(sch, enc->dst, enc->nb_dst), NULL);
+    }
+
+    for (unsigned i = 0; i < sch->nb_mux; i++)
+        stats_print_task(bp, &first, "mux", i, sch->mux[i].queue, 0, NULL);
+
+    av_bprintf(bp, "],\"streams\":[");
+    first = 1;
+
+    for (unsigned i = 0; i < sch->nb_mux; i++) {
+        SchMux *mux = &sch->mux[i];
+
+        for (unsigned j = 0; j < mux->nb_streams; j++) {
+            SchMuxStream *ms = &mux->streams[j];
+            uint64_t nb = atomic_load(&ms->latency_nb);
+            int64_t  max = atomic_exchange(&ms->latency_max, 0);
+            uint64_t nb_period = nb - ms->latency_nb_prev;
+            int64_t  sum[SCH_LATENCY_NB], total = 0;
+
+            for (int k = 0; k < SCH_LATENCY_NB; k++) {
+                int64_t val = atomic_load(&ms->latency_sum[k]);
+
+                sum[k] = val - ms->latency_sum_prev[k];
+                ms->latency_sum_prev[k] = val;
+                total += sum[k];
+            }
+            ms->latency_nb_prev = nb;
+
+            av_bprintf(bp, "%s{\"stream\":\"%u:%u\",\"packets\":%"PRIu64,
+                       first ? "" : ",", i, j, nb_period);
+            first = 0;
+
+            // the sums may include packets counted after nb was read
+            if (nb_period) {
+                av_bprintf(bp, ",\"latency_us\":%"PRId64",\"max_us\":%"PRId64,
+                           total / (int64_t)nb_period, max);
+                for (int k = 0; k < SCH_LATENCY_NB; k++)
+                    av_bprintf(bp, ",\"%s_us\":%"PRId64, stage_names[k],
+                               sum[k] / (int64_t)nb_period);
+            }
+            av_bprintf(bp, "}");
+        }
+    }
+
+    av_bprintf(bp, "]}\n");
+}
+
 static int enc_open(Scheduler *sch, SchEnc *enc, const AVFrame *frame)
 {
     int ret;
@@ -1707,11 +2078,11 @@ static int enc_open(Scheduler *sch, SchEnc *enc, const AVFrame *frame)
         av_assert0(enc->sq_idx[0] >= 0);
         sq = &sch->sq_enc[enc->sq_idx[0]];
 
-        pthread_mutex_lock(&sq->lock);
+        jp_mutex_lock(&sq->lock);
 
         sq_frame_samples(sq->sq, enc->sq_idx[1], ret);
 
-        pthread_mutex_unlock(&sq->lock);
+        jp_mutex_unlock(&sq->lock);
     }
 
     return 0;
@@ -1759,14 +2130,14 @@ static int send_to_enc_sq(Scheduler *sch, SchEnc *enc, AVFrame *frame)
 
             pthread_mutex_lock(&sch->schedule_lock);
 
-            ms->source_finished = 1;
+            mux_stream_source_finish(ms);
             schedule_update_locked(sch);
 
             pthread_mutex_unlock(&sch->schedule_lock);
         }
     }
 
-    pthread_mutex_lock(&sq->lock);
+    jp_mutex_lock(&sq->lock);
 
     ret = sq_send(sq->sq, enc->sq_idx[1], SQFRAME(frame));
     if (ret < 0)
@@ -1807,7 +2178,7 @@ static int send_to_enc_sq(Scheduler *sch, SchEnc *enc, AVFrame *frame)
     }
 
 finish:
-    pthread_mutex_unlock(&sq->lock);
+    jp_mutex_unlock(&sq->lock);
 
     return ret;
 }
@@ -1882,14 +2253,14 @@ static int send_to_mux(Scheduler *sch, SchMux *mux, unsigned stream_idx,
 
         // the muxer could have started between the above atomic check and
         // locking the mutex, then this block falls through to normal send path
-        pthread_mutex_lock(&sch->mux_ready_lock);
+        jp_mutex_lock(&sch->mux_ready_lock);
 
         if (!atomic_load(&mux->mux_started)) {
             int ret = mux_queue_packet(mux, ms, pkt);
             queued = ret < 0 ? ret : 1;
         }
 
-        pthread_mutex_unlock(&sch->mux_ready_lock);
+        jp_mutex_unlock(&sch->mux_ready_lock);
 
         if (queued < 0)
             return queued;
@@ -1915,8 +2286,8 @@ update_schedule:
     if (dts != AV_NOPTS_VALUE || !pkt) {
         pthread_mutex_lock(&sch->schedule_lock);
 
-        if (pkt) ms->last_dts = dts;
-        else     ms->source_finished = 1;
+        if (pkt) mux_stream_set_dts(ms, dts);
+        else     mux_stream_source_finish(ms);
 
         schedule_update_locked(sch);
 
@@ -2019,7 +2390,7 @@ static int demux_flush(Scheduler *sch, SchDemux *d, AVPacket *pkt)
 
             if (dec->queue_end_ts) {
                 Timestamp ts;
-                ret = av_thread_message_queue_recv(dec->queue_end_ts, &ts, 0);
+                ret = end_ts_receive(dec->queue_end_ts, &ts);
                 if (ret < 0)
                     return ret;
 
@@ -2106,13 +2477,42 @@ void sch_mux_receive_finish(Scheduler *sch, unsigned mux_idx, unsigned stream_id
     tq_receive_finish(mux->queue, stream_idx);
 
     pthread_mutex_lock(&sch->schedule_lock);
-    mux->streams[stream_idx].source_finished = 1;
+    mux_stream_source_finish(&mux->streams[stream_idx]);
 
     schedule_update_locked(sch);
 
     pthread_mutex_unlock(&sch->schedule_lock);
 }
 
+void sch_mux_stream_latency(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
+                            const int64_t latency[SCH_LATENCY_NB])
+{
+    SchMux       *mux;
+    SchMuxStream *ms;
+    int64_t total = 0, max;
+
+    av_assert0(mux_idx < sch->nb_mux);
+    mux = &sch->mux[mux_idx];
+
+    av_assert0(stream_idx < mux->nb_streams);
+    ms = &mux->streams[stream_idx];
+
+    for (int i = 0; i < SCH_LATENCY_NB; i++) {
+        atomic_fetch_add_explicit(&ms->latency_sum[i], latency[i],
+                                  memory_order_relaxed);
+        total += latency[i];
+    }
+    atomic_fetch_add_explicit(&ms->latency_nb, 1, memory_order_relaxed);
+
+    // sch_stats_print() resets the maximum
+    max = atomic_load_explicit(&ms->latency_max, memory_order_relaxed);
+    while (total > max &&
+           !atomic_compare_exchange_weak_explicit(&ms->latency_max, &max, total,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
 int sch_mux_sub_heartbeat(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
                           const AVPacket *pkt)
 {
@@ -2147,7 +2547,7 @@ static int mux_done(Scheduler *sch, unsigned mux_idx)
 
     for (unsigned i = 0; i < mux->nb_streams; i++) {
         tq_receive_finish(mux->queue, i);
-        mux->streams[i].source_finished = 1;
+        mux_stream_source_finish(&mux->streams[i]);
     }
 
     schedule_update_locked(sch);
@@ -2177,9 +2577,7 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
     // the decoder should have given us post-flush end timestamp in pkt
     if (dec->expect_end_ts) {
         Timestamp ts = (Timestamp){ .ts = pkt->pts, .tb = pkt->time_base };
-        ret = av_thread_message_queue_send(dec->queue_end_ts, &ts, 0);
-        if (ret < 0)
-            return ret;
+        end_ts_send(dec->queue_end_ts, ts);
 
         dec->expect_end_ts = 0;
     }
@@ -2310,7 +2708,7 @@ static int dec_done(Scheduler *sch, unsigned dec_idx)
     // make sure our source does not get stuck waiting for end timestamps
     // that will never arrive
     if (dec->queue_end_ts)
-        av_thread_message_queue_set_err_recv(dec->queue_end_ts, AVERROR_EOF);
+        end_ts_finish(dec->queue_end_ts);
 
     for (unsigned i = 0; i < dec->nb_outputs; i++) {
         SchDecOutput *o = &dec->outputs[i];
@@ -2601,8 +2999,12 @@ static int task_stop(Scheduler *sch, SchTask *task)
     if (!task->thread_running)
         return task_cleanup(sch, task->node);
 
-    ret = pthread_join(task->thread, &thread_ret);
-    av_assert0(ret == 0);
+    if (task->job) {
+        thread_ret = jp_join(&task->job);
+    } else {
+        ret = pthread_join(task->thread, &thread_ret);
+        av_assert0(ret == 0);
+    }
 
     task->thread_running = 0;
 
@@ -85,6 +85,7 @@
  * knowledge about the whole transcoding pipeline.
  */
 
+struct AVBPrint;
 struct AVFrame;
 struct AVPacket;
 
@@ -133,6 +134,17 @@ typedef int (*SchThreadFunc)(void *arg);
 Scheduler *sch_alloc(void);
 void sch_free(Scheduler **sch);
 
+/**
+ * Run the tasks as jobs on a fixed pool of worker threads instead of one
+ * thread each. A task waiting on a queue or choked by the scheduler then
+ * leaves its worker to another one, and may be resumed on another thread.
+ * Must be called before sch_start().
+ *
+ * @param nb_workers number of worker threads, -1 for one per CPU, 0 for a
+ *                   thread per task (the default)
+ */
+void sch_job_pool(Scheduler *sch, int nb_workers);
+
 int sch_start(Scheduler *sch);
 int sch_stop(Scheduler *sch, int64_t *finish_ts);
 
@@ -149,6 +161,16 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts);
  */
 int sch_wait(Scheduler *sch, uint64_t timeout_us, int64_t *transcode_ts);
 
+/**
+ * Write the scheduler statistics to bp as one line of JSON: for each task the
+ * time it waited for input, on full downstream queues and choked by the
+ * scheduler, the state of its input queue, and for each muxed stream the
+ * packet latencies reported with sch_mux_stream_latency() since the previous
+ * call. Must be called from one thread only, after sch_start() and before
+ * sch_free().
+ */
+void sch_stats_print(Scheduler *sch, struct AVBPrint *bp);
+
 /**
  * Add a demuxer to the scheduler.
  *
@@ -497,6 +519,28 @@ int sch_mux_receive(Scheduler *sch, unsigned mux_idx, struct AVPacket *pkt);
  */
 void sch_mux_receive_finish(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
 
+/**
+ * Processing stages of a muxed packet, each measured from the end of the
+ * previous one that applies to it.
+ */
+enum SchLatencyStage {
+    SCH_LATENCY_DEC,    ///< from demuxing to the end of decoding
+    SCH_LATENCY_FILTER, ///< to the end of filtering
+    SCH_LATENCY_ENC,    ///< to the end of encoding
+    SCH_LATENCY_MUX,    ///< to muxing
+    SCH_LATENCY_NB,
+};
+
+/**
+ * Called by muxer tasks to account the latency of a packet in the statistics
+ * printed by sch_stats_print().
+ *
+ * @param latency time spent in each stage in microseconds, 0 for the stages
+ *                the packet did not go through
+ */
+void sch_mux_stream_latency(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
+                            const int64_t latency[SCH_LATENCY_NB]);
+
 int sch_mux_sub_heartbeat_add(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
                               unsigned dec_idx);
 int sch_mux_sub_heartbeat(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
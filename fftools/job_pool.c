@@ -0,0 +1,913 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+// jobs switch stacks with siglongjmp(), which the fortified longjmp checks
+// would take for a jump into a stale frame
+#undef _FORTIFY_SOURCE
+
+#define _DEFAULT_SOURCE
+#define _SVID_SOURCE // needed for MAP_ANONYMOUS
+#define _DARWIN_C_SOURCE // needed for MAP_ANON, ucontext
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#if HAVE_MAKECONTEXT
+#include <setjmp.h>
+#include <ucontext.h>
+#endif
+#if HAVE_MMAP
+#include <sys/mman.h>
+#if defined(MAP_ANON) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "job_pool.h"
+
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+#define STACK_MMAP 1
+#else
+#define STACK_MMAP 0
+#endif
+
+/* once in this many picks, a worker takes the oldest queued job rather than
+ * the one it just woke up, so that two jobs handing data to each other do
+ * not keep it for themselves */
+#define FAIR_INTERVAL 16
+
+/* a worker running the same job for a whole period while other jobs are
+ * queued is taken as blocked outside of a JobCond and another worker is
+ * started, up to a thread per job */
+#define MONITOR_PERIOD 10000 // us
+#define MAX_WORKERS    1024
+
+typedef struct JobWorker JobWorker;
+
+struct Job {
+    JobPool        *pool;
+    // in a run queue, or in the waiters of a JobCond
+    Job            *next;
+
+    void         *(*func)(void *);
+    void           *arg;
+    void           *ret;
+
+#if HAVE_MAKECONTEXT
+    // only used to enter the job the first time, the switches afterwards
+    // go through env, which does not save the signal mask
+    ucontext_t      ctx;
+    sigjmp_buf      env;
+#endif
+    int             started;
+    uint8_t        *stack;
+    size_t          stack_size;
+
+    // the worker running the job, only valid while it runs
+    JobWorker      *worker;
+    // unlocked by the worker once the job is suspended
+    pthread_mutex_t *release;
+    int             done;
+
+    pthread_mutex_t join_lock;
+    pthread_cond_t  join_cond;
+    int             joinable;
+};
+
+struct JobWorker {
+    JobPool        *pool;
+    int             idx;
+    pthread_t       thread;
+    int             thread_running;
+#if HAVE_MAKECONTEXT
+    sigjmp_buf      env;
+#endif
+    Job            *current;
+
+    // jobs run so far and whether one runs now, read by the monitor
+    atomic_uint     nb_runs;
+    atomic_int      running;
+    unsigned        monitor_runs;
+
+    // the job this worker woke up last, then the older ones
+    pthread_mutex_t lock;
+    Job            *runnext;
+    Job            *head, *tail;
+
+    // the following are protected by JobPool.lock
+    pthread_cond_t  cond;
+    JobWorker      *next_idle;
+    int             woken;
+    // looking for jobs after a wake up, counted in JobPool.nb_spinning
+    int             spinning;
+
+    unsigned        picks;
+
+    uint64_t        nb_resumed;
+    uint64_t        nb_stolen;
+    uint64_t        nb_sleeps;
+};
+
+struct JobPool {
+    void           *log_ctx;
+
+    // grown by the monitor, the entries below nb_workers never change
+    JobWorker     **workers;
+    atomic_int   nb_workers;
+
+    size_t          stack_size;
+    size_t          page_size;
+
+    atomic_int      nb_queued;
+    atomic_int      nb_injected;
+    atomic_int      nb_idle;
+    atomic_int      nb_spinning;
+    atomic_uint     nb_jobs;
+    // submitted and not finished, the most workers that can be busy
+    atomic_int      nb_live;
+
+    pthread_t       monitor;
+    int             monitor_running;
+    int             nb_added;
+
+    pthread_mutex_t lock;
+    // jobs made ready outside of the workers
+    Job            *inject_head, *inject_tail;
+    JobWorker      *idle;
+    int             terminate;
+};
+
+#if HAVE_MAKECONTEXT
+static pthread_key_t  worker_key;
+static pthread_once_t worker_key_once = PTHREAD_ONCE_INIT;
+static int            worker_key_ok;
+
+static void worker_key_create(void)
+{
+    worker_key_ok = !pthread_key_create(&worker_key, NULL);
+}
+
+static JobWorker *current_worker(void)
+{
+    return worker_key_ok ? pthread_getspecific(worker_key) : NULL;
+}
+
+static void list_push(Job **head, Job **tail, Job *job)
+{
+    job->next = NULL;
+    if (*tail)
+        (*tail)->next = job;
+    else
+        *head = job;
+    *tail = job;
+}
+
+static Job *list_pop(Job **head, Job **tail)
+{
+    Job *job = *head;
+
+    if (job) {
+        *head = job->next;
+        if (!*head)
+            *tail = NULL;
+        job->next = NULL;
+    }
+    return job;
+}
+
+static void pool_wake(JobPool *jp)
+{
+    JobWorker *w;
+
+    // a worker already looking for jobs will find this one
+    if (!atomic_load(&jp->nb_idle) || atomic_load(&jp->nb_spinning))
+        return;
+
+    pthread_mutex_lock(&jp->lock);
+
+    w = jp->idle;
+    if (w && !atomic_load(&jp->nb_spinning)) {
+        jp->idle = w->next_idle;
+        atomic_fetch_sub(&jp->nb_idle, 1);
+        atomic_fetch_add(&jp->nb_spinning, 1);
+
+        w->spinning = 1;
+        w->woken    = 1;
+        pthread_cond_signal(&w->cond);
+    }
+
+    pthread_mutex_unlock(&jp->lock);
+}
+
+static void job_ready(Job *job)
+{
+    JobPool   *jp = job->pool;
+    JobWorker  *w = current_worker();
+
+    atomic_fetch_add(&jp->nb_queued, 1);
+
+    if (w && w->pool == jp) {
+        pthread_mutex_lock(&w->lock);
+        if (w->runnext)
+            list_push(&w->head, &w->tail, w->runnext);
+        w->runnext = job;
+        pthread_mutex_unlock(&w->lock);
+    } else {
+        pthread_mutex_lock(&jp->lock);
+        list_push(&jp->inject_head, &jp->inject_tail, job);
+        atomic_fetch_add(&jp->nb_injected, 1);
+        pthread_mutex_unlock(&jp->lock);
+    }
+
+    pool_wake(jp);
+}
+
+static Job *inject_pop(JobPool *jp)
+{
+    Job *job;
+
+    if (!atomic_load(&jp->nb_injected))
+        return NULL;
+
+    pthread_mutex_lock(&jp->lock);
+    job = list_pop(&jp->inject_head, &jp->inject_tail);
+    if (job)
+        atomic_fetch_sub(&jp->nb_injected, 1);
+    pthread_mutex_unlock(&jp->lock);
+
+    return job;
+}
+
+static Job *local_pop(JobWorker *w, int oldest_first)
+{
+    Job *job = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    if (!oldest_first || !w->head) {
+        job = w->runnext;
+        w->runnext = NULL;
+    }
+    if (!job)
+        job = list_pop(&w->head, &w->tail);
+    pthread_mutex_unlock(&w->lock);
+
+    return job;
+}
+
+static Job *find_job(JobWorker *w)
+{
+    JobPool *jp = w->pool;
+    int fair = !(++w->picks % FAIR_INTERVAL);
+    Job *job = NULL;
+
+    if (fair)
+        job = inject_pop(jp);
+    if (!job)
+        job = local_pop(w, fair);
+    if (!job)
+        job = inject_pop(jp);
+
+    // steal the oldest job of the other workers
+    for (int i = 1, nb = atomic_load(&jp->nb_workers); !job && i < nb; i++) {
+        JobWorker *victim = jp->workers[(w->idx + i) % nb];
+
+        pthread_mutex_lock(&victim->lock);
+        job = list_pop(&victim->head, &victim->tail);
+        if (!job) {
+            job = victim->runnext;
+            victim->runnext = NULL;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (job)
+            w->nb_stolen++;
+    }
+
+    if (job)
+        atomic_fetch_sub(&jp->nb_queued, 1);
+
+    return job;
+}
+
+/**
+ * Wait until woken up.
+ *
+ * @retval 0 look for jobs again
+ * @retval 1 the pool is being freed
+ */
+static int worker_sleep(JobWorker *w)
+{
+    JobPool *jp = w->pool;
+    int terminate;
+
+    // drop the spinning state before registering as idle, so that a job
+    // queued meanwhile is either seen below or wakes this worker up
+    if (w->spinning) {
+        w->spinning = 0;
+        atomic_fetch_sub(&jp->nb_spinning, 1);
+    }
+
+    pthread_mutex_lock(&jp->lock);
+
+    if (jp->terminate) {
+        pthread_mutex_unlock(&jp->lock);
+        return 1;
+    }
+
+    w->woken     = 0;
+    w->next_idle = jp->idle;
+    jp->idle     = w;
+    atomic_fetch_add(&jp->nb_idle, 1);
+
+    if (atomic_load(&jp->nb_queued) > 0) {
+        JobWorker **pw = &jp->idle;
+
+        while (*pw != w)
+            pw = &(*pw)->next_idle;
+        *pw = w->next_idle;
+        atomic_fetch_sub(&jp->nb_idle, 1);
+
+        pthread_mutex_unlock(&jp->lock);
+        return 0;
+    }
+
+    w->nb_sleeps++;
+    while (!w->woken && !jp->terminate)
+        pthread_cond_wait(&w->cond, &jp->lock);
+
+    terminate = jp->terminate;
+
+    pthread_mutex_unlock(&jp->lock);
+
+    return terminate;
+}
+
+static void job_entry(void)
+{
+    Job *job = current_worker()->current;
+
+    job->ret  = job->func(job->arg);
+    job->done = 1;
+
+    // job->worker is the worker running the job now, not necessarily the
+    // one that started it
+    siglongjmp(job->worker->env, 1);
+}
+
+static void stack_free(Job *job)
+{
+    if (!job->stack)
+        return;
+#if STACK_MMAP
+    munmap(job->stack, job->stack_size);
+#else
+    av_free(job->stack);
+#endif
+    job->stack = NULL;
+}
+
+static void run_job(JobWorker *w, Job *job)
+{
+    pthread_mutex_t *release;
+
+    w->current  = job;
+    job->worker = w;
+    w->nb_resumed++;
+    atomic_fetch_add(&w->nb_runs, 1);
+    atomic_store(&w->running, 1);
+
+    // back here once the job waits or returns
+    if (!sigsetjmp(w->env, 0)) {
+        if (job->started)
+            siglongjmp(job->env, 1);
+        job->started = 1;
+        setcontext(&job->ctx);
+    }
+
+    atomic_store(&w->running, 0);
+    w->current = NULL;
+
+    if (job->done) {
+        stack_free(job);
+        atomic_fetch_sub(&job->pool->nb_live, 1);
+
+        pthread_mutex_lock(&job->join_lock);
+        job->joinable = 1;
+        pthread_cond_signal(&job->join_cond);
+        pthread_mutex_unlock(&job->join_lock);
+        return;
+    }
+
+    // the job is parked on a JobCond; it may be resumed elsewhere as soon
+    // as this mutex is released, so it must not be touched afterwards
+    release      = job->release;
+    job->release = NULL;
+    av_assert0(release);
+    pthread_mutex_unlock(release);
+}
+
+static void *worker_thread(void *arg)
+{
+    JobWorker *w = arg;
+    JobPool  *jp = w->pool;
+
+    pthread_setspecific(worker_key, w);
+
+    while (1) {
+        Job *job = find_job(w);
+
+        if (!job) {
+            if (worker_sleep(w))
+                break;
+            continue;
+        }
+
+        // keep one worker looking for the jobs still queued
+        if (w->spinning) {
+            w->spinning = 0;
+            if (atomic_fetch_sub(&jp->nb_spinning, 1) == 1 &&
+                atomic_load(&jp->nb_queued) > 0)
+                pool_wake(jp);
+        }
+
+        run_job(w, job);
+    }
+
+    return NULL;
+}
+
+static size_t default_stack_size(void)
+{
+    pthread_attr_t attr;
+    size_t size = 0;
+
+    // the jobs run the same code as the threads they replace
+    if (!pthread_attr_init(&attr)) {
+        pthread_attr_getstacksize(&attr, &size);
+        pthread_attr_destroy(&attr);
+    }
+
+    return FFMAX(size, 1 << 20);
+}
+
+static void pool_report(const JobPool *jp)
+{
+    int nb_workers = atomic_load(&jp->nb_workers);
+    uint64_t resumed = 0, stolen = 0, sleeps = 0;
+
+    for (int i = 0; i < nb_workers; i++) {
+        resumed += jp->workers[i]->nb_resumed;
+        stolen  += jp->workers[i]->nb_stolen;
+        sleeps  += jp->workers[i]->nb_sleeps;
+    }
+
+    av_log(jp->log_ctx, AV_LOG_VERBOSE,
+           "Job pool: %d workers (%d added for blocked jobs), %u jobs, "
+           "%"PRIu64" resumes, %"PRIu64" steals, %"PRIu64" sleeps\n",
+           nb_workers, jp->nb_added, atomic_load(&jp->nb_jobs),
+           resumed, stolen, sleeps);
+}
+
+static void worker_free(JobWorker *w)
+{
+    av_assert0(!w->runnext && !w->head);
+
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    av_free(w);
+}
+
+static int worker_add(JobPool *jp)
+{
+    int idx = atomic_load(&jp->nb_workers);
+    JobWorker *w;
+    int ret;
+
+    if (idx >= MAX_WORKERS)
+        return AVERROR(EINVAL);
+
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->pool = jp;
+    w->idx  = idx;
+
+    ret = pthread_mutex_init(&w->lock, NULL);
+    if (ret) {
+        av_free(w);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&w->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&w->lock);
+        av_free(w);
+        return AVERROR(ret);
+    }
+
+    // published before it can steal from the others or be stolen from
+    jp->workers[idx] = w;
+    atomic_store(&jp->nb_workers, idx + 1);
+
+    ret = pthread_create(&w->thread, NULL, worker_thread, w);
+    if (ret)
+        return AVERROR(ret);
+    w->thread_running = 1;
+
+    return 0;
+}
+
+/* whether a worker ran the same job since the last check while others wait */
+static int pool_blocked(JobPool *jp)
+{
+    int nb_workers = atomic_load(&jp->nb_workers);
+    int queued     = atomic_load(&jp->nb_queued) > 0 &&
+                     !atomic_load(&jp->nb_idle) && !atomic_load(&jp->nb_spinning);
+    int blocked    = 0;
+
+    for (int i = 0; i < nb_workers; i++) {
+        JobWorker *w = jp->workers[i];
+        unsigned runs = atomic_load(&w->nb_runs);
+
+        if (queued && atomic_load(&w->running) && runs == w->monitor_runs)
+            blocked = 1;
+        w->monitor_runs = runs;
+    }
+
+    return blocked;
+}
+
+static void *monitor_thread(void *arg)
+{
+    JobPool *jp = arg;
+
+    while (1) {
+        int terminate;
+
+        av_usleep(MONITOR_PERIOD);
+
+        pthread_mutex_lock(&jp->lock);
+        terminate = jp->terminate;
+        pthread_mutex_unlock(&jp->lock);
+        if (terminate)
+            break;
+
+        if (pool_blocked(jp) &&
+            atomic_load(&jp->nb_workers) < atomic_load(&jp->nb_live) &&
+            worker_add(jp) >= 0) {
+            jp->nb_added++;
+            av_log(jp->log_ctx, AV_LOG_VERBOSE,
+                   "Job pool: a job blocks its worker, starting worker %d\n",
+                   atomic_load(&jp->nb_workers));
+        }
+    }
+
+    return NULL;
+}
+
+void jp_free(JobPool **pjp)
+{
+    JobPool *jp = *pjp;
+
+    if (!jp)
+        return;
+
+    if (jp->workers) {
+        int nb_workers;
+
+        pthread_mutex_lock(&jp->lock);
+        jp->terminate = 1;
+        pthread_mutex_unlock(&jp->lock);
+
+        // no worker is added once the monitor is gone
+        if (jp->monitor_running)
+            pthread_join(jp->monitor, NULL);
+
+        pthread_mutex_lock(&jp->lock);
+        nb_workers = atomic_load(&jp->nb_workers);
+        for (int i = 0; i < nb_workers; i++)
+            pthread_cond_signal(&jp->workers[i]->cond);
+        pthread_mutex_unlock(&jp->lock);
+
+        for (int i = 0; i < nb_workers; i++)
+            if (jp->workers[i]->thread_running)
+                pthread_join(jp->workers[i]->thread, NULL);
+
+        pool_report(jp);
+
+        for (int i = 0; i < nb_workers; i++)
+            worker_free(jp->workers[i]);
+    }
+    av_assert0(!jp->inject_head);
+
+    av_freep(&jp->workers);
+    pthread_mutex_destroy(&jp->lock);
+
+    av_freep(pjp);
+}
+
+int jp_alloc(JobPool **pjp, int nb_workers, void *log_ctx)
+{
+    JobPool *jp;
+    int ret;
+
+    pthread_once(&worker_key_once, worker_key_create);
+    if (!worker_key_ok)
+        return AVERROR(ENOSYS);
+
+    if (nb_workers < 0)
+        nb_workers = av_cpu_count();
+    nb_workers = av_clip(nb_workers, 1, MAX_WORKERS);
+
+    jp = av_mallocz(sizeof(*jp));
+    if (!jp)
+        return AVERROR(ENOMEM);
+
+    jp->log_ctx    = log_ctx;
+    jp->stack_size = default_stack_size();
+#if HAVE_SYSCONF && defined(_SC_PAGESIZE)
+    jp->page_size  = sysconf(_SC_PAGESIZE);
+#endif
+    if (!jp->page_size)
+        jp->page_size = 4096;
+    jp->stack_size = FFALIGN(jp->stack_size, jp->page_size);
+
+    ret = pthread_mutex_init(&jp->lock, NULL);
+    if (ret) {
+        av_freep(&jp);
+        return AVERROR(ret);
+    }
+
+    jp->workers = av_calloc(MAX_WORKERS, sizeof(*jp->workers));
+    if (!jp->workers) {
+        jp_free(&jp);
+        return AVERROR(ENOMEM);
+    }
+
+    for (int i = 0; i < nb_workers; i++) {
+        ret = worker_add(jp);
+        if (ret < 0)
+            goto fail;
+    }
+
+    ret = pthread_create(&jp->monitor, NULL, monitor_thread, jp);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    jp->monitor_running = 1;
+
+    *pjp = jp;
+    return 0;
+fail:
+    jp_free(&jp);
+    return ret;
+}
+
+static int stack_alloc(JobPool *jp, Job *job)
+{
+    job->stack_size = jp->stack_size + jp->page_size;
+
+#if STACK_MMAP
+    job->stack = mmap(NULL, job->stack_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (job->stack == MAP_FAILED) {
+        job->stack = NULL;
+        return AVERROR(ENOMEM);
+    }
+#if HAVE_MPROTECT
+    // guard page below the stack, as for the threads
+    mprotect(job->stack, jp->page_size, PROT_NONE);
+#endif
+#else
+    job->stack = av_malloc(job->stack_size);
+    if (!job->stack)
+        return AVERROR(ENOMEM);
+#endif
+
+    return 0;
+}
+
+int jp_submit(JobPool *jp, Job **pjob, void *(*func)(void *), void *arg)
+{
+    Job *job;
+    int ret;
+
+    job = av_mallocz(sizeof(*job));
+    if (!job)
+        return AVERROR(ENOMEM);
+
+    job->pool = jp;
+    job->func = func;
+    job->arg  = arg;
+
+    ret = pthread_mutex_init(&job->join_lock, NULL);
+    if (ret) {
+        av_free(job);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&job->join_cond, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail_cond;
+    }
+
+    ret = stack_alloc(jp, job);
+    if (ret < 0)
+        goto fail;
+
+    if (getcontext(&job->ctx) < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    job->ctx.uc_stack.ss_sp   = job->stack     + jp->page_size;
+    job->ctx.uc_stack.ss_size = job->stack_size - jp->page_size;
+    job->ctx.uc_link          = NULL;
+    makecontext(&job->ctx, job_entry, 0);
+
+    atomic_fetch_add(&jp->nb_jobs, 1);
+    atomic_fetch_add(&jp->nb_live, 1);
+
+    *pjob = job;
+    job_ready(job);
+    return 0;
+fail:
+    stack_free(job);
+    pthread_cond_destroy(&job->join_cond);
+fail_cond:
+    pthread_mutex_destroy(&job->join_lock);
+    av_free(job);
+    return ret;
+}
+
+void *jp_join(Job **pjob)
+{
+    Job *job = *pjob;
+    void *ret;
+
+    pthread_mutex_lock(&job->join_lock);
+    while (!job->joinable)
+        pthread_cond_wait(&job->join_cond, &job->join_lock);
+    pthread_mutex_unlock(&job->join_lock);
+
+    ret = job->ret;
+
+    pthread_cond_destroy(&job->join_cond);
+    pthread_mutex_destroy(&job->join_lock);
+    av_freep(pjob);
+
+    return ret;
+}
+
+static void cond_wake(JobCond *c, int all)
+{
+    Job *job;
+
+    while ((job = list_pop(&c->waiters, &c->waiters_tail))) {
+        job_ready(job);
+        if (!all)
+            break;
+    }
+}
+#else
+void jp_free(JobPool **pjp)
+{
+}
+
+int jp_alloc(JobPool **pjp, int nb_workers, void *log_ctx)
+{
+    return AVERROR(ENOSYS);
+}
+
+int jp_submit(JobPool *jp, Job **pjob, void *(*func)(void *), void *arg)
+{
+    return AVERROR(ENOSYS);
+}
+
+void *jp_join(Job **pjob)
+{
+    return NULL;
+}
+#endif
+
+int jp_cond_init(JobCond *c)
+{
+    memset(c, 0, sizeof(*c));
+#if HAVE_MAKECONTEXT
+    pthread_once(&worker_key_once, worker_key_create);
+#endif
+    return AVERROR(pthread_cond_init(&c->cond, NULL));
+}
+
+void jp_cond_destroy(JobCond *c)
+{
+    av_assert0(!c->waiters);
+    pthread_cond_destroy(&c->cond);
+}
+
+void jp_cond_wait(JobCond *c, pthread_mutex_t *lock)
+{
+#if HAVE_MAKECONTEXT
+    JobWorker *w = current_worker();
+    Job     *job = w ? w->current : NULL;
+
+    if (job) {
+        list_push(&c->waiters, &c->waiters_tail, job);
+
+        // the worker releases the lock once the job is suspended, so a
+        // signal cannot reach it before
+        job->release = lock;
+        if (!sigsetjmp(job->env, 0))
+            siglongjmp(w->env, 1);
+
+        // running again, maybe on another worker
+        pthread_mutex_lock(lock);
+        return;
+    }
+#endif
+    pthread_cond_wait(&c->cond, lock);
+}
+
+void jp_cond_signal(JobCond *c)
+{
+    pthread_cond_signal(&c->cond);
+#if HAVE_MAKECONTEXT
+    cond_wake(c, 0);
+#endif
+}
+
+void jp_cond_broadcast(JobCond *c)
+{
+    pthread_cond_broadcast(&c->cond);
+#if HAVE_MAKECONTEXT
+    cond_wake(c, 1);
+#endif
+}
+
+int jp_mutex_init(JobMutex *m)
+{
+    int ret;
+
+    m->locked = 0;
+
+    ret = pthread_mutex_init(&m->lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+
+    ret = jp_cond_init(&m->cond);
+    if (ret < 0)
+        pthread_mutex_destroy(&m->lock);
+
+    return ret;
+}
+
+void jp_mutex_destroy(JobMutex *m)
+{
+    av_assert0(!m->locked);
+    jp_cond_destroy(&m->cond);
+    pthread_mutex_destroy(&m->lock);
+}
+
+void jp_mutex_lock(JobMutex *m)
+{
+    pthread_mutex_lock(&m->lock);
+    while (m->locked)
+        jp_cond_wait(&m->cond, &m->lock);
+    m->locked = 1;
+    pthread_mutex_unlock(&m->lock);
+}
+
+void jp_mutex_unlock(JobMutex *m)
+{
+    pthread_mutex_lock(&m->lock);
+    m->locked = 0;
+    jp_cond_signal(&m->cond);
+    pthread_mutex_unlock(&m->lock);
+}
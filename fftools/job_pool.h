@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFTOOLS_JOB_POOL_H
+#define FFTOOLS_JOB_POOL_H
+
+#include "libavutil/thread.h"
+
+/**
+ * A fixed set of worker threads running jobs, functions with their own
+ * stack that are suspended when they wait on a JobCond and resumed, maybe
+ * on another worker, once it is signalled. Each worker runs the jobs it
+ * woke up first and takes jobs from the other workers when it has none.
+ *
+ * A job should not block on anything else that only another job can
+ * release, as that holds its worker; JobCond and JobMutex are used instead
+ * of pthread conditions and of mutexes held while waiting. When a job does
+ * block elsewhere (a library call, a device), a monitor sees its worker
+ * run the same job for 10 ms while others are queued and starts one more
+ * worker, up to one per job as without the pool.
+ *
+ * A job may migrate between threads at each wait, so it must not keep
+ * thread-local state across one. The compiler may keep the address of
+ * errno from before the wait, glibc declares __errno_location() const, so
+ * errno has to be read right after the call that set it.
+ */
+typedef struct JobPool JobPool;
+typedef struct Job Job;
+
+/**
+ * A condition variable, waited on by jobs as well as by ordinary threads.
+ * The mutex passed to jp_cond_wait() must be held when it is signalled.
+ */
+typedef struct JobCond {
+    pthread_cond_t  cond;
+    Job            *waiters;
+    Job            *waiters_tail;
+} JobCond;
+
+/**
+ * A mutex that may be held by a job across a wait.
+ */
+typedef struct JobMutex {
+    pthread_mutex_t lock;
+    JobCond         cond;
+    int             locked;
+} JobMutex;
+
+/**
+ * @param nb_workers number of worker threads, or -1 for one per CPU
+ * @return 0 on success, AVERROR(ENOSYS) when jobs are not supported on this
+ *         system, another negative error code on failure
+ */
+int  jp_alloc(JobPool **jp, int nb_workers, void *log_ctx);
+
+/**
+ * Stop the workers and log the pool statistics; all the jobs must have been
+ * joined.
+ */
+void jp_free(JobPool **jp);
+
+/**
+ * Start running func(arg) as a job.
+ */
+int  jp_submit(JobPool *jp, Job **job, void *(*func)(void *), void *arg);
+
+/**
+ * Wait for the job to finish and free it.
+ *
+ * @return the value returned by the job function
+ */
+void *jp_join(Job **job);
+
+int  jp_cond_init(JobCond *c);
+void jp_cond_destroy(JobCond *c);
+void jp_cond_wait(JobCond *c, pthread_mutex_t *lock);
+/* may wake more than one waiter */
+void jp_cond_signal(JobCond *c);
+void jp_cond_broadcast(JobCond *c);
+
+int  jp_mutex_init(JobMutex *m);
+void jp_mutex_destroy(JobMutex *m);
+void jp_mutex_lock(JobMutex *m);
+void jp_mutex_unlock(JobMutex *m);
+
+#endif // FFTOOLS_JOB_POOL_H
@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 
 #include "libavcodec/packet.h"
@@ -24,18 +25,73 @@
 #include "libavutil/error.h"
 #include "libavutil/frame.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 
 #include "objpool.h"
 
+#define CACHE_SLOTS 8
+#define CACHE_SIZE  8
+
+/*
+ * Objects are usually taken by the threads sending to a queue and released
+ * by the one receiving from it, so each thread keeps a few objects in a
+ * cache slot of its own and only locks the shared pool to exchange half a
+ * cache at a time. Threads sharing a slot skip it when it is in use.
+ */
+typedef struct ObjCache {
+    atomic_int   busy;
+    unsigned int count;
+    void        *obj[CACHE_SIZE];
+} ObjCache;
+
 struct ObjPool {
+    pthread_mutex_t lock;
     void        *pool[32];
     unsigned int pool_count;
 
+    ObjCache     cache[CACHE_SLOTS];
+
     ObjPoolCBAlloc alloc;
     ObjPoolCBReset reset;
     ObjPoolCBFree  free;
 };
 
+static AVOnce        thread_slot_once = AV_ONCE_INIT;
+static pthread_key_t thread_slot_key;
+static atomic_uint   thread_slot_next;
+static int           thread_slot_ok;
+
+static void thread_slot_init(void)
+{
+    thread_slot_ok = !pthread_key_create(&thread_slot_key, NULL);
+}
+
+static ObjCache *cache_lock(ObjPool *op)
+{
+    uintptr_t slot;
+    ObjCache *c;
+
+    ff_thread_once(&thread_slot_once, thread_slot_init);
+    if (!thread_slot_ok)
+        return NULL;
+
+    slot = (uintptr_t)pthread_getspecific(thread_slot_key);
+    if (!slot) {
+        slot = atomic_fetch_add(&thread_slot_next, 1) % CACHE_SLOTS + 1;
+        pthread_setspecific(thread_slot_key, (void*)slot);
+    }
+
+    c = &op->cache[slot - 1];
+    if (atomic_exchange_explicit(&c->busy, 1, memory_order_acquire))
+        return NULL;
+    return c;
+}
+
+static void cache_unlock(ObjCache *c)
+{
+    atomic_store_explicit(&c->busy, 0, memory_order_release);
+}
+
 ObjPool *objpool_alloc(ObjPoolCBAlloc cb_alloc, ObjPoolCBReset cb_reset,
                        ObjPoolCBFree cb_free)
 {
@@ -44,6 +100,14 @@ ObjPool *objpool_alloc(ObjPoolCBAlloc cb_alloc, ObjPoolCBReset cb_reset,
     if (!op)
         return NULL;
 
+    if (pthread_mutex_init(&op->lock, NULL)) {
+        av_freep(&op);
+        return NULL;
+    }
+
+    for (int i = 0; i < CACHE_SLOTS; i++)
+        atomic_init(&op->cache[i].busy, 0);
+
     op->alloc = cb_alloc;
     op->reset = cb_reset;
     op->free  = cb_free;
@@ -61,15 +125,37 @@ void objpool_free(ObjPool **pop)
     for (unsigned int i = 0; i < op->pool_count; i++)
         op->free(&op->pool[i]);
 
+    for (int i = 0; i < CACHE_SLOTS; i++)
+        for (unsigned int j = 0; j < op->cache[i].count; j++)
+            op->free(&op->cache[i].obj[j]);
+
+    pthread_mutex_destroy(&op->lock);
+
     av_freep(pop);
 }
 
 int  objpool_get(ObjPool *op, void **obj)
 {
-    if (op->pool_count) {
-        *obj = op->pool[--op->pool_count];
-        op->pool[op->pool_count] = NULL;
-    } else
+    ObjCache *c = cache_lock(op);
+
+    *obj = NULL;
+
+    if (c && c->count) {
+        *obj = c->obj[--c->count];
+    } else {
+        pthread_mutex_lock(&op->lock);
+        // refill half of the cache along with this object
+        while (c && op->pool_count > 1 && c->count < CACHE_SIZE / 2)
+            c->obj[c->count++] = op->pool[--op->pool_count];
+        if (op->pool_count)
+            *obj = op->pool[--op->pool_count];
+        pthread_mutex_unlock(&op->lock);
+    }
+
+    if (c)
+        cache_unlock(c);
+
+    if (!*obj)
         *obj = op->alloc();
 
     return *obj ? 0 : AVERROR(ENOMEM);
@@ -77,15 +163,40 @@ int  objpool_get(ObjPool *op, void **obj)
 
 void objpool_release(ObjPool *op, void **obj)
 {
+    void *overflow[CACHE_SIZE / 2 + 1];
+    unsigned int nb_overflow = 0;
+    ObjCache *c;
+
     if (!*obj)
         return;
 
     op->reset(*obj);
 
-    if (op->pool_count < FF_ARRAY_ELEMS(op->pool))
-        op->pool[op->pool_count++] = *obj;
-    else
-        op->free(obj);
+    c = cache_lock(op);
+    if (c && c->count < CACHE_SIZE) {
+        c->obj[c->count++] = *obj;
+    } else {
+        pthread_mutex_lock(&op->lock);
+        // move half of the cache to the pool along with this object
+        while (c && c->count > CACHE_SIZE / 2) {
+            void *o = c->obj[--c->count];
+            if (op->pool_count < FF_ARRAY_ELEMS(op->pool))
+                op->pool[op->pool_count++] = o;
+            else
+                overflow[nb_overflow++] = o;
+        }
+        if (op->pool_count < FF_ARRAY_ELEMS(op->pool))
+            op->pool[op->pool_count++] = *obj;
+        else
+            overflow[nb_overflow++] = *obj;
+        pthread_mutex_unlock(&op->lock);
+    }
+
+    if (c)
+        cache_unlock(c);
+
+    for (unsigned int i = 0; i < nb_overflow; i++)
+        op->free(&overflow[i]);
 
     *obj = NULL;
 }
@@ -31,6 +31,7 @@ ObjPool *objpool_alloc(ObjPoolCBAlloc cb_alloc, ObjPoolCBReset cb_reset,
 ObjPool *objpool_alloc_packets(void);
 ObjPool *objpool_alloc_frames(void);
 
+/* may be called concurrently from any thread */
 int  objpool_get(ObjPool *op, void **obj);
 void objpool_release(ObjPool *op, void **obj);
 
@@ -31,6 +31,7 @@
 
 #include "objpool.h"
 #include "sync_queue.h"
+#include "ts_heap.h"
 
 /*
  * How this works:
@@ -65,8 +66,19 @@
  * streams 0 and 1 end at t=8 and t=9 respectively. All frames that _end_ at
  * or before t=5 can be output, i.e. the first 3 frames from stream 0, first
  * frame from stream 1, and all 4 frames from stream 2.
+ *
+ * With many streams, they are also kept in heaps so that nothing scans all
+ * of them for each frame: the limiting streams by head timestamp (the top is
+ * the head stream), all streams by head timestamp the other way round (the
+ * top is the stream most ahead), and the streams whose tail frame has enough
+ * samples to be output by the end timestamp of that frame (if the top cannot
+ * be output yet, no other stream can). With a few streams, scanning them is
+ * cheaper than keeping the heaps up to date. Either way, reading from any
+ * stream returns the frame that ends first.
  */
 
+#define SQ_HEAP_MIN_STREAMS 8
+
 typedef struct SyncQueueStream {
     AVFifo          *fifo;
     AVRational       tb;
@@ -104,6 +116,14 @@ struct SyncQueue {
     SyncQueueStream *streams;
     unsigned int  nb_streams;
 
+    // the heaps are only kept from SQ_HEAP_MIN_STREAMS streams on
+    int     use_heaps;
+    TsHeap *head_heap;
+    TsHeap *ahead_heap;
+    TsHeap *tail_heap;
+    // number of limiting streams without a head timestamp
+    unsigned int nb_limiting_nopts;
+
     // pool of preallocated frames to avoid constant allocations
     ObjPool *pool;
 
@@ -148,7 +168,72 @@ static int frame_null(const SyncQueue *sq, SyncQueueFrame frame)
     return (sq->type == SYNC_QUEUE_PACKETS) ? (frame.p == NULL) : (frame.f == NULL);
 }
 
-static void tb_update(const SyncQueue *sq, SyncQueueStream *st,
+/* whether the tail frame of the stream has enough samples to be output,
+ * and the end timestamp of that frame */
+static int tail_ready(const SyncQueue *sq, const SyncQueueStream *st,
+                      int64_t *ts)
+{
+    int nb_samples = st->frame_samples;
+    SyncQueueFrame peek;
+
+    if (!av_fifo_can_read(st->fifo) ||
+        (st->frame_samples > st->samples_queued && !st->finished))
+        return 0;
+
+    if (st->finished)
+        nb_samples = FFMIN(nb_samples, st->samples_queued);
+
+    av_fifo_peek(st->fifo, &peek, 1, 0);
+    *ts = frame_end(sq, peek, nb_samples);
+    return 1;
+}
+
+/* update the position of the stream in tail_heap, after its tail frame or the
+ * number of samples it needs changed */
+static void tail_update(SyncQueue *sq, unsigned int stream_idx)
+{
+    SyncQueueStream *st = &sq->streams[stream_idx];
+    int64_t ts;
+
+    if (!sq->use_heaps)
+        return;
+
+    if (tail_ready(sq, st, &ts))
+        ts_heap_set(sq->tail_heap, stream_idx, ts, st->tb);
+    else
+        ts_heap_remove(sq->tail_heap, stream_idx);
+}
+
+/* the stream whose tail frame ends first, in the order of tail_heap: no
+ * timestamp first, then the lowest index among equal timestamps */
+static int tail_top(const SyncQueue *sq)
+{
+    int64_t best_ts = AV_NOPTS_VALUE;
+    int best = -1;
+
+    if (sq->use_heaps)
+        return ts_heap_top(sq->tail_heap, NULL);
+
+    for (unsigned int i = 0; i < sq->nb_streams; i++) {
+        const SyncQueueStream *st = &sq->streams[i];
+        int64_t ts;
+
+        if (!tail_ready(sq, st, &ts))
+            continue;
+
+        if (best < 0 ||
+            (best_ts != AV_NOPTS_VALUE &&
+             (ts == AV_NOPTS_VALUE ||
+              av_compare_ts(ts, st->tb, best_ts, sq->streams[best].tb) < 0))) {
+            best    = i;
+            best_ts = ts;
+        }
+    }
+
+    return best;
+}
+
+static void tb_update(SyncQueue *sq, SyncQueueStream *st,
                       const SyncQueueFrame frame)
 {
     AVRational tb = (sq->type == SYNC_QUEUE_PACKETS) ?
@@ -166,6 +251,14 @@ static void tb_update(const SyncQueue *sq, SyncQueueStream *st,
         st->head_ts = av_rescale_q(st->head_ts, st->tb, tb);
 
     st->tb = tb;
+
+    if (sq->use_heaps && st->head_ts != AV_NOPTS_VALUE) {
+        unsigned int stream_idx = st - sq->streams;
+
+        if (st->limiting)
+            ts_heap_set(sq->head_heap, stream_idx, st->head_ts, st->tb);
+        ts_heap_set(sq->ahead_heap, stream_idx, st->head_ts, st->tb);
+    }
 }
 
 static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
@@ -178,6 +271,7 @@ static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
                av_ts2timestr(st->head_ts, &st->tb));
 
     st->finished = 1;
+    tail_update(sq, stream_idx);
 
     if (st->limiting && st->head_ts != AV_NOPTS_VALUE) {
         /* check if this stream is the new finished head */
@@ -195,12 +289,14 @@ static void finish_stream(SyncQueue *sq, unsigned int stream_idx)
             SyncQueueStream *st1 = &sq->streams[i];
             if (st != st1 && st1->head_ts != AV_NOPTS_VALUE &&
                 av_compare_ts(st->head_ts, st->tb, st1->head_ts, st1->tb) <= 0) {
-                if (!st1->finished)
+                if (!st1->finished) {
                     av_log(sq->logctx, AV_LOG_DEBUG,
                            "sq: finish secondary %u; head ts %s\n", i,
                            av_ts2timestr(st1->head_ts, &st1->tb));
 
-                st1->finished = 1;
+                    st1->finished = 1;
+                    tail_update(sq, i);
+                }
             }
         }
     }
@@ -219,34 +315,28 @@ static void queue_head_update(SyncQueue *sq)
 {
     av_assert0(sq->have_limiting);
 
-    if (sq->head_stream < 0) {
-        unsigned first_limiting = UINT_MAX;
-
-        /* wait for one timestamp in each stream before determining
-         * the queue head */
-        for (unsigned int i = 0; i < sq->nb_streams; i++) {
-            SyncQueueStream *st = &sq->streams[i];
-            if (!st->limiting)
-                continue;
-            if (st->head_ts == AV_NOPTS_VALUE)
-                return;
-            if (first_limiting == UINT_MAX)
-                first_limiting = i;
-        }
+    /* wait for one timestamp in each stream before determining
+     * the queue head */
+    if (sq->head_stream < 0 && sq->nb_limiting_nopts)
+        return;
 
-        // placeholder value, correct one will be found below
-        av_assert0(first_limiting < UINT_MAX);
-        sq->head_stream = first_limiting;
+    if (sq->use_heaps) {
+        sq->head_stream = ts_heap_top(sq->head_heap, NULL);
+        av_assert0(sq->head_stream >= 0);
+        return;
     }
 
     for (unsigned int i = 0; i < sq->nb_streams; i++) {
-        SyncQueueStream *st_head  = &sq->streams[sq->head_stream];
-        SyncQueueStream *st_other = &sq->streams[i];
-        if (st_other->limiting && st_other->head_ts != AV_NOPTS_VALUE &&
-            av_compare_ts(st_other->head_ts, st_other->tb,
-                          st_head->head_ts,  st_head->tb) < 0)
+        SyncQueueStream *st = &sq->streams[i];
+
+        if (st->limiting && st->head_ts != AV_NOPTS_VALUE &&
+            (sq->head_stream < 0 ||
+             av_compare_ts(st->head_ts, st->tb,
+                           sq->streams[sq->head_stream].head_ts,
+                           sq->streams[sq->head_stream].tb) < 0))
             sq->head_stream = i;
     }
+    av_assert0(sq->head_stream >= 0);
 }
 
 /* update this stream's head timestamp */
@@ -258,8 +348,17 @@ static void stream_update_ts(SyncQueue *sq, unsigned int stream_idx, int64_t ts)
         (st->head_ts != AV_NOPTS_VALUE && st->head_ts >= ts))
         return;
 
+    if (st->limiting && st->head_ts == AV_NOPTS_VALUE)
+        sq->nb_limiting_nopts--;
+
     st->head_ts = ts;
 
+    if (sq->use_heaps) {
+        if (st->limiting)
+            ts_heap_set(sq->head_heap, stream_idx, ts, st->tb);
+        ts_heap_set(sq->ahead_heap, stream_idx, ts, st->tb);
+    }
+
     /* if this stream is now ahead of some finished stream, then
      * this stream is also finished */
     if (sq->head_finished_stream >= 0 &&
@@ -289,7 +388,9 @@ static int overflow_heartbeat(SyncQueue *sq, int stream_idx)
     if (stream_idx < 0) {
         int64_t ts = AV_NOPTS_VALUE;
 
-        for (int i = 0; i < sq->nb_streams; i++) {
+        if (sq->use_heaps)
+            stream_idx = ts_heap_top(sq->ahead_heap, NULL);
+        else for (int i = 0; i < sq->nb_streams; i++) {
             st = &sq->streams[i];
             if (st->head_ts != AV_NOPTS_VALUE &&
                 (ts == AV_NOPTS_VALUE ||
@@ -391,6 +492,8 @@ int sq_send(SyncQueue *sq, unsigned int stream_idx, SyncQueueFrame frame)
     st->samples_queued += nb_samples;
     st->samples_sent   += nb_samples;
 
+    tail_update(sq, stream_idx);
+
     if (st->frame_samples)
         st->frames_sent = st->samples_sent / st->frame_samples;
     else
@@ -567,6 +670,8 @@ static int receive_for_stream(SyncQueue *sq, unsigned int stream_idx,
                 st->samples_queued -= frame_samples(sq, frame);
             }
 
+            tail_update(sq, stream_idx);
+
             av_log(sq->logctx, AV_LOG_DEBUG,
                    "sq: receive %u ts %s queue head %d ts %s\n", stream_idx,
                    av_ts2timestr(frame_end(sq, frame, 0), &st->tb),
@@ -583,7 +688,6 @@ static int receive_for_stream(SyncQueue *sq, unsigned int stream_idx,
 
 static int receive_internal(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
 {
-    int nb_eof = 0;
     int ret;
 
     /* read a frame for a specific stream */
@@ -592,17 +696,17 @@ static int receive_internal(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
         return (ret < 0) ? ret : stream_idx;
     }
 
-    /* read a frame for any stream with available output */
-    for (unsigned int i = 0; i < sq->nb_streams; i++) {
-        ret = receive_for_stream(sq, i, frame);
-        if (ret == AVERROR_EOF || ret == AVERROR(EAGAIN)) {
-            nb_eof += (ret == AVERROR_EOF);
-            continue;
-        }
-        return (ret < 0) ? ret : i;
+    /* read a frame for any stream with available output; the stream with
+     * the earliest tail is the only one that may be behind the queue head */
+    stream_idx = tail_top(sq);
+    if (stream_idx >= 0) {
+        ret = receive_for_stream(sq, stream_idx, frame);
+        if (ret != AVERROR_EOF && ret != AVERROR(EAGAIN))
+            return (ret < 0) ? ret : stream_idx;
     }
 
-    return (nb_eof == sq->nb_streams) ? AVERROR_EOF : AVERROR(EAGAIN);
+    /* all streams are finished once the queue is */
+    return sq->finished ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
 int sq_receive(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
@@ -617,15 +721,38 @@ int sq_receive(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
     return ret;
 }
 
+/* start keeping the heaps, from the current state of the streams */
+static void heaps_init(SyncQueue *sq)
+{
+    sq->use_heaps = 1;
+
+    for (unsigned int i = 0; i < sq->nb_streams; i++) {
+        SyncQueueStream *st = &sq->streams[i];
+
+        if (st->head_ts != AV_NOPTS_VALUE) {
+            if (st->limiting)
+                ts_heap_set(sq->head_heap, i, st->head_ts, st->tb);
+            ts_heap_set(sq->ahead_heap, i, st->head_ts, st->tb);
+        }
+        tail_update(sq, i);
+    }
+}
+
 int sq_add_stream(SyncQueue *sq, int limiting)
 {
     SyncQueueStream *tmp, *st;
+    int ret;
 
     tmp = av_realloc_array(sq->streams, sq->nb_streams + 1, sizeof(*sq->streams));
     if (!tmp)
         return AVERROR(ENOMEM);
     sq->streams = tmp;
 
+    if ((ret = ts_heap_reserve(sq->head_heap,  sq->nb_streams + 1)) < 0 ||
+        (ret = ts_heap_reserve(sq->ahead_heap, sq->nb_streams + 1)) < 0 ||
+        (ret = ts_heap_reserve(sq->tail_heap,  sq->nb_streams + 1)) < 0)
+        return ret;
+
     st = &sq->streams[sq->nb_streams];
     memset(st, 0, sizeof(*st));
 
@@ -641,9 +768,13 @@ int sq_add_stream(SyncQueue *sq, int limiting)
     st->frames_max = UINT64_MAX;
     st->limiting   = limiting;
 
-    sq->have_limiting |= limiting;
+    sq->have_limiting     |= limiting;
+    sq->nb_limiting_nopts += limiting;
+
+    if (++sq->nb_streams == SQ_HEAP_MIN_STREAMS)
+        heaps_init(sq);
 
-    return sq->nb_streams++;
+    return sq->nb_streams - 1;
 }
 
 void sq_limit_frames(SyncQueue *sq, unsigned int stream_idx, uint64_t frames)
@@ -670,6 +801,8 @@ void sq_frame_samples(SyncQueue *sq, unsigned int stream_idx,
     st->frame_samples = frame_samples;
 
     sq->align_mask = av_cpu_max_align() - 1;
+
+    tail_update(sq, stream_idx);
 }
 
 SyncQueue *sq_alloc(enum SyncQueueType type, int64_t buf_size_us, void *logctx)
@@ -688,8 +821,11 @@ SyncQueue *sq_alloc(enum SyncQueueType type, int64_t buf_size_us, void *logctx)
 
     sq->pool = (type == SYNC_QUEUE_PACKETS) ? objpool_alloc_packets() :
                                               objpool_alloc_frames();
-    if (!sq->pool) {
-        av_freep(&sq);
+    sq->head_heap  = ts_heap_alloc(0);
+    sq->ahead_heap = ts_heap_alloc(1);
+    sq->tail_heap  = ts_heap_alloc(0);
+    if (!sq->pool || !sq->head_heap || !sq->ahead_heap || !sq->tail_heap) {
+        sq_free(&sq);
         return NULL;
     }
 
@@ -713,6 +849,10 @@ void sq_free(SyncQueue **psq)
 
     av_freep(&sq->streams);
 
+    ts_heap_free(&sq->head_heap);
+    ts_heap_free(&sq->ahead_heap);
+    ts_heap_free(&sq->tail_heap);
+
     objpool_free(&sq->pool);
 
     av_freep(psq);
@@ -16,16 +16,18 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/common.h"
 #include "libavutil/error.h"
-#include "libavutil/fifo.h"
-#include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
+#include "job_pool.h"
 #include "objpool.h"
 #include "thread_queue.h"
 
@@ -39,17 +41,48 @@ typedef struct FifoElem {
     unsigned int stream_idx;
 } FifoElem;
 
+/**
+ * A slot of the ring; seq is set to its position + 1 once the element for
+ * that position has been written.
+ */
+typedef struct Cell {
+    atomic_size_t seq;
+    FifoElem      elem;
+} Cell;
+
+/*
+ * The items are passed through a bounded ring shared by any number of
+ * producers and a single consumer. Producers reserve positions by advancing
+ * tail, as far as the consumer has advanced head, and publish each cell
+ * separately; the consumer reads the cells in order and releases them by
+ * advancing head.
+ *
+ * The lock is only taken by a side that has to sleep, after setting its
+ * waiting flag, and by the other side to wake it up when that flag is set,
+ * so a busy queue never touches it.
+ */
 struct ThreadQueue {
-    int              *finished;
+    atomic_int       *finished;
     unsigned int    nb_streams;
 
-    AVFifo  *fifo;
+    // time spent waiting on a full queue by the senders of each stream,
+    // and on an empty queue by the receiver, in microseconds
+    atomic_int_least64_t *send_wait;
+    atomic_int_least64_t  recv_wait;
+
+    Cell            *cells;
+    size_t           size;
+    atomic_size_t    tail;
+    atomic_size_t    head;
 
     ObjPool *obj_pool;
     void   (*obj_move)(void *dst, void *src);
 
     pthread_mutex_t lock;
-    pthread_cond_t  cond;
+    JobCond         recv_cond;
+    JobCond         send_cond;
+    atomic_int      recv_waiting;
+    atomic_int      send_waiting;
 };
 
 void tq_free(ThreadQueue **ptq)
@@ -59,18 +92,24 @@ void tq_free(ThreadQueue **ptq)
     if (!tq)
         return;
 
-    if (tq->fifo) {
-        FifoElem elem;
-        while (av_fifo_read(tq->fifo, &elem, 1) >= 0)
-            objpool_release(tq->obj_pool, &elem.obj);
+    if (tq->cells) {
+        size_t tail = atomic_load(&tq->tail);
+
+        for (size_t pos = atomic_load(&tq->head); pos != tail; pos++) {
+            Cell *cell = &tq->cells[pos % tq->size];
+            if (atomic_load(&cell->seq) == pos + 1)
+                objpool_release(tq->obj_pool, &cell->elem.obj);
+        }
     }
-    av_fifo_freep2(&tq->fifo);
+    av_freep(&tq->cells);
 
     objpool_free(&tq->obj_pool);
 
     av_freep(&tq->finished);
+    av_freep(&tq->send_wait);
 
-    pthread_cond_destroy(&tq->cond);
+    jp_cond_destroy(&tq->send_cond);
+    jp_cond_destroy(&tq->recv_cond);
     pthread_mutex_destroy(&tq->lock);
 
     av_freep(ptq);
@@ -86,15 +125,23 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
     if (!tq)
         return NULL;
 
-    ret = pthread_cond_init(&tq->cond, NULL);
-    if (ret) {
+    ret = jp_cond_init(&tq->recv_cond);
+    if (ret < 0) {
+        av_freep(&tq);
+        return NULL;
+    }
+
+    ret = jp_cond_init(&tq->send_cond);
+    if (ret < 0) {
+        jp_cond_destroy(&tq->recv_cond);
         av_freep(&tq);
         return NULL;
     }
 
     ret = pthread_mutex_init(&tq->lock, NULL);
     if (ret) {
-        pthread_cond_destroy(&tq->cond);
+        jp_cond_destroy(&tq->send_cond);
+        jp_cond_destroy(&tq->recv_cond);
         av_freep(&tq);
         return NULL;
     }
@@ -103,10 +150,27 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
     if (!tq->finished)
         goto fail;
     tq->nb_streams = nb_streams;
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->finished[i], 0);
 
-    tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
-    if (!tq->fifo)
+    tq->send_wait = av_calloc(nb_streams, sizeof(*tq->send_wait));
+    if (!tq->send_wait)
         goto fail;
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->send_wait[i], 0);
+    atomic_init(&tq->recv_wait, 0);
+
+    tq->cells = av_calloc(queue_size, sizeof(*tq->cells));
+    if (!tq->cells)
+        goto fail;
+    tq->size = queue_size;
+    for (size_t i = 0; i < queue_size; i++)
+        atomic_init(&tq->cells[i].seq, 0);
+
+    atomic_init(&tq->tail, 0);
+    atomic_init(&tq->head, 0);
+    atomic_init(&tq->recv_waiting, 0);
+    atomic_init(&tq->send_waiting, 0);
 
     tq->obj_pool = obj_pool;
     tq->obj_move = obj_move;
@@ -117,73 +181,248 @@ fail:
     return NULL;
 }
 
-int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+static int send_blocked(ThreadQueue *tq, atomic_int *finished)
 {
-    int *finished;
-    int ret;
+    return !(atomic_load(finished) & FINISHED_RECV) &&
+           atomic_load(&tq->head) + tq->size == atomic_load(&tq->tail);
+}
+
+/**
+ * Reserve up to nb positions, waiting while the ring is full.
+ *
+ * @return the number of reserved positions starting at *pos, 0 when the
+ *         receiving side has finished the stream
+ */
+static size_t reserve(ThreadQueue *tq, unsigned int stream_idx,
+                      size_t *pos, size_t nb)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+
+    while (1) {
+        size_t tail = atomic_load_explicit(&tq->tail, memory_order_relaxed);
+
+        if (atomic_load(finished) & FINISHED_RECV)
+            return 0;
+
+        while (1) {
+            size_t head = atomic_load_explicit(&tq->head, memory_order_acquire);
+            size_t n    = FFMIN(nb, head + tq->size - tail);
+
+            if (!n)
+                break;
+
+            if (atomic_compare_exchange_weak_explicit(&tq->tail, &tail, tail + n,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *pos = tail;
+                return n;
+            }
+        }
+
+        pthread_mutex_lock(&tq->lock);
+        atomic_fetch_add(&tq->send_waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (send_blocked(tq, finished)) {
+            int64_t t0 = av_gettime_relative();
+
+            while (send_blocked(tq, finished))
+                jp_cond_wait(&tq->send_cond, &tq->lock);
+
+            atomic_fetch_add_explicit(&tq->send_wait[stream_idx],
+                                      av_gettime_relative() - t0,
+                                      memory_order_relaxed);
+        }
+        atomic_fetch_sub(&tq->send_waiting, 1);
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
+
+/*
+ * Wake the senders blocked on a full queue once half of it is free, so that
+ * they refill it in one go rather than waking up for every cell. The
+ * receiver empties the queue before it sleeps, so this always happens.
+ */
+static void wake_senders(ThreadQueue *tq, size_t head)
+{
+    // pairs with the fence in the waiting side, after it set its flag
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&tq->send_waiting, memory_order_relaxed))
+        return;
+    // tail may be older, which only overestimates the free cells
+    if (head + tq->size - atomic_load_explicit(&tq->tail, memory_order_relaxed) <
+        FFMAX(tq->size / 2, 1))
+        return;
+
+    pthread_mutex_lock(&tq->lock);
+    jp_cond_broadcast(&tq->send_cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+/* the receiver is alone, only the first sender seeing it asleep wakes it */
+static void wake_receiver(ThreadQueue *tq)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&tq->recv_waiting, memory_order_relaxed) ||
+        !atomic_exchange_explicit(&tq->recv_waiting, 0, memory_order_relaxed))
+        return;
+
+    pthread_mutex_lock(&tq->lock);
+    jp_cond_broadcast(&tq->recv_cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+int tq_send_batch(ThreadQueue *tq, unsigned int stream_idx,
+                  void **data, unsigned int nb_data)
+{
+    atomic_int *finished;
+    int ret = 0;
 
     av_assert0(stream_idx < tq->nb_streams);
     finished = &tq->finished[stream_idx];
 
-    pthread_mutex_lock(&tq->lock);
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
 
-    if (*finished & FINISHED_SEND) {
-        ret = AVERROR(EINVAL);
-        goto finish;
-    }
+    while (nb_data) {
+        size_t pos, n;
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo))
-        pthread_cond_wait(&tq->cond, &tq->lock);
+        n = reserve(tq, stream_idx, &pos, nb_data);
+        if (!n) {
+            atomic_fetch_or(finished, FINISHED_SEND);
+            return AVERROR_EOF;
+        }
 
-    if (*finished & FINISHED_RECV) {
-        ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
-    } else {
-        FifoElem elem = { .stream_idx = stream_idx };
+        for (size_t i = 0; i < n; i++) {
+            Cell *cell = &tq->cells[(pos + i) % tq->size];
 
-        ret = objpool_get(tq->obj_pool, &elem.obj);
-        if (ret < 0)
-            goto finish;
+            cell->elem.stream_idx = stream_idx;
+            cell->elem.obj        = NULL;
 
-        tq->obj_move(elem.obj, data);
+            // a reserved cell must still be published, the consumer skips
+            // it when the allocation failed
+            if (ret >= 0)
+                ret = objpool_get(tq->obj_pool, &cell->elem.obj);
+            if (ret >= 0) {
+                tq->obj_move(cell->elem.obj, *data++);
+                nb_data--;
+            }
 
-        ret = av_fifo_write(tq->fifo, &elem, 1);
-        av_assert0(ret >= 0);
-        pthread_cond_broadcast(&tq->cond);
+            atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+        }
+
+        wake_receiver(tq);
+
+        if (ret < 0)
+            return ret;
     }
 
-finish:
-    pthread_mutex_unlock(&tq->lock);
+    return 0;
+}
+
+int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    size_t tail, head;
+    Cell *cell;
+    int ret;
+
+    av_assert0(stream_idx < tq->nb_streams);
 
-    return ret;
+    /* one attempt at taking a cell; a full queue, a finished stream and
+     * a lost race with another sender go through the batch path */
+    tail = atomic_load_explicit(&tq->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&tq->head, memory_order_acquire);
+    if (atomic_load_explicit(&tq->finished[stream_idx], memory_order_relaxed) ||
+        tail - head >= tq->size ||
+        !atomic_compare_exchange_strong_explicit(&tq->tail, &tail, tail + 1,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed))
+        return tq_send_batch(tq, stream_idx, &data, 1);
+
+    cell = &tq->cells[tail % tq->size];
+    cell->elem.stream_idx = stream_idx;
+    cell->elem.obj        = NULL;
+
+    ret = objpool_get(tq->obj_pool, &cell->elem.obj);
+    if (ret >= 0)
+        tq->obj_move(cell->elem.obj, data);
+
+    atomic_store_explicit(&cell->seq, tail + 1, memory_order_release);
+    wake_receiver(tq);
+
+    return ret < 0 ? ret : 0;
 }
 
-static int receive_locked(ThreadQueue *tq, int *stream_idx,
-                          void *data)
+/* anything published at head, or a send-finished stream to report once the
+ * ring is empty */
+static int can_receive(ThreadQueue *tq, size_t head)
 {
-    FifoElem elem;
-    unsigned int nb_finished = 0;
+    Cell *cell = &tq->cells[head % tq->size];
+
+    if (atomic_load(&cell->seq) == head + 1)
+        return 1;
+
+    if (atomic_load(&tq->tail) != head)
+        return 0;
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++)
+        if (atomic_load(&tq->finished[i]) == FINISHED_SEND)
+            return 1;
 
-    while (av_fifo_read(tq->fifo, &elem, 1) >= 0) {
-        if (tq->finished[elem.stream_idx] & FINISHED_RECV) {
+    return 0;
+}
+
+static int receive_avail(ThreadQueue *tq, int *stream_idx,
+                         void **data, unsigned int nb_data)
+{
+    size_t head = atomic_load_explicit(&tq->head, memory_order_relaxed);
+    size_t head0 = head;
+    unsigned int nb_finished = 0, nb = 0;
+
+    while (nb < nb_data) {
+        Cell    *cell = &tq->cells[head % tq->size];
+        FifoElem elem;
+
+        if (atomic_load_explicit(&cell->seq, memory_order_acquire) != head + 1)
+            break;
+
+        elem = cell->elem;
+        head++;
+
+        if (!elem.obj ||
+            (atomic_load_explicit(&tq->finished[elem.stream_idx],
+                                  memory_order_relaxed) & FINISHED_RECV)) {
             objpool_release(tq->obj_pool, &elem.obj);
             continue;
         }
 
-        tq->obj_move(data, elem.obj);
+        tq->obj_move(data[nb], elem.obj);
         objpool_release(tq->obj_pool, &elem.obj);
-        *stream_idx = elem.stream_idx;
-        return 0;
+        stream_idx[nb++] = elem.stream_idx;
     }
 
+    if (head != head0) {
+        atomic_store_explicit(&tq->head, head, memory_order_release);
+        wake_senders(tq, head);
+    }
+
+    if (nb)
+        return nb;
+
+    /* the items of a finished stream may still be in flight, only
+     * look at the finished flags once every reserved cell was read */
+    if (atomic_load(&tq->tail) != head)
+        return AVERROR(EAGAIN);
+
     for (unsigned int i = 0; i < tq->nb_streams; i++) {
-        if (!tq->finished[i])
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!finished)
             continue;
 
         /* return EOF to the consumer at most once for each stream */
-        if (!(tq->finished[i] & FINISHED_RECV)) {
-            tq->finished[i] |= FINISHED_RECV;
-            *stream_idx   = i;
+        if (!(finished & FINISHED_RECV)) {
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
+            stream_idx[0] = i;
             return AVERROR_EOF;
         }
 
@@ -193,48 +432,74 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
-int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
+int tq_receive_batch(ThreadQueue *tq, int *stream_idx,
+                     void **data, unsigned int nb_data)
 {
     int ret;
 
-    *stream_idx = -1;
+    av_assert0(nb_data > 0);
 
-    pthread_mutex_lock(&tq->lock);
+    stream_idx[0] = -1;
 
     while (1) {
-        size_t can_read = av_fifo_can_read(tq->fifo);
+        ret = receive_avail(tq, stream_idx, data, nb_data);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
 
-        ret = receive_locked(tq, stream_idx, data);
+        pthread_mutex_lock(&tq->lock);
+        atomic_store(&tq->recv_waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!can_receive(tq, atomic_load(&tq->head))) {
+            int64_t t0 = av_gettime_relative();
 
-        // signal other threads if the fifo state changed
-        if (can_read != av_fifo_can_read(tq->fifo))
-            pthread_cond_broadcast(&tq->cond);
+            jp_cond_wait(&tq->recv_cond, &tq->lock);
 
-        if (ret == AVERROR(EAGAIN)) {
-            pthread_cond_wait(&tq->cond, &tq->lock);
-            continue;
+            atomic_fetch_add_explicit(&tq->recv_wait, av_gettime_relative() - t0,
+                                      memory_order_relaxed);
         }
+        atomic_store(&tq->recv_waiting, 0);
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
 
-        break;
+int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    size_t head = atomic_load_explicit(&tq->head, memory_order_relaxed);
+    Cell  *cell = &tq->cells[head % tq->size];
+    int ret;
+
+    /* the item at head is ready: take it without the batch bookkeeping */
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) == head + 1 &&
+        cell->elem.obj &&
+        !(atomic_load_explicit(&tq->finished[cell->elem.stream_idx],
+                               memory_order_relaxed) & FINISHED_RECV)) {
+        FifoElem elem = cell->elem;
+
+        atomic_store_explicit(&tq->head, head + 1, memory_order_release);
+        wake_senders(tq, head + 1);
+
+        tq->obj_move(data, elem.obj);
+        objpool_release(tq->obj_pool, &elem.obj);
+        *stream_idx = elem.stream_idx;
+        return 0;
     }
 
-    pthread_mutex_unlock(&tq->lock);
+    ret = tq_receive_batch(tq, stream_idx, &data, 1);
 
-    return ret;
+    return ret < 0 ? ret : 0;
 }
 
 void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
-    pthread_mutex_lock(&tq->lock);
-
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_SEND;
-    pthread_cond_broadcast(&tq->cond);
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
 
+    pthread_mutex_lock(&tq->lock);
+    jp_cond_broadcast(&tq->recv_cond);
     pthread_mutex_unlock(&tq->lock);
 }
 
@@ -242,13 +507,30 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
-    pthread_mutex_lock(&tq->lock);
-
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_RECV;
-    pthread_cond_broadcast(&tq->cond);
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
 
+    pthread_mutex_lock(&tq->lock);
+    jp_cond_broadcast(&tq->send_cond);
     pthread_mutex_unlock(&tq->lock);
 }
+
+void tq_stats(ThreadQueue *tq, TQStats *st)
+{
+    size_t head = atomic_load_explicit(&tq->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&tq->tail, memory_order_relaxed);
+
+    st->size      = tq->size;
+    // head may be more recent than tail
+    st->depth     = tail > head ? tail - head : 0;
+    st->nb_items  = tail;
+    st->recv_wait = atomic_load_explicit(&tq->recv_wait, memory_order_relaxed);
+}
+
+int64_t tq_send_wait(ThreadQueue *tq, unsigned int stream_idx)
+{
+    av_assert0(stream_idx < tq->nb_streams);
+    return atomic_load_explicit(&tq->send_wait[stream_idx], memory_order_relaxed);
+}
@@ -19,12 +19,21 @@
 #ifndef FFTOOLS_THREAD_QUEUE_H
 #define FFTOOLS_THREAD_QUEUE_H
 
+#include <stdint.h>
 #include <string.h>
 
 #include "objpool.h"
 
 typedef struct ThreadQueue ThreadQueue;
 
+typedef struct TQStats {
+    size_t   size;          ///< number of items the queue can hold
+    size_t   depth;         ///< number of items currently queued
+    uint64_t nb_items;      ///< number of items sent so far
+    int64_t  recv_wait;     ///< time the receiver waited on an empty queue,
+                            ///< in microseconds
+} TQStats;
+
 /**
  * Allocate a queue for sending data between threads.
  *
@@ -53,6 +62,16 @@ void         tq_free(ThreadQueue **tq);
  * - AVERROR_EOF the receiving side has marked the given stream as finished
  */
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data);
+/**
+ * Send several items for the given stream, waking the receiving side at most
+ * once for as many items as fit in the queue.
+ *
+ * @param data array of nb_data items to send; on failure the items that were
+ *             not sent are left untouched
+ * @return same as tq_send()
+ */
+int tq_send_batch(ThreadQueue *tq, unsigned int stream_idx,
+                  void **data, unsigned int nb_data);
 /**
  * Mark the given stream finished from the sending side.
  */
@@ -73,9 +92,32 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx);
  *   for each stream. When *stream_idx is -1, all streams are done.
  */
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
+/**
+ * Read the items that are available from the queue, waiting for the first one
+ * like tq_receive().
+ *
+ * @param stream_idx array of nb_data entries; the stream index of each item
+ *                   read is written here, or in its first entry what
+ *                   tq_receive() would write there on failure
+ * @param data array of nb_data items the data will be written to
+ * @return the number of items read, or a negative error code with the same
+ *         meaning as for tq_receive()
+ */
+int tq_receive_batch(ThreadQueue *tq, int *stream_idx,
+                     void **data, unsigned int nb_data);
 /**
  * Mark the given stream finished from the receiving side.
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * Get the current state of the queue; may be called from any thread.
+ */
+void tq_stats(ThreadQueue *tq, TQStats *st);
+/**
+ * @return the time the senders of the given stream waited on a full queue so
+ *         far, in microseconds; may be called from any thread
+ */
+int64_t tq_send_wait(ThreadQueue *tq, unsigned int stream_idx);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
@@ -0,0 +1,210 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+#include <stdint.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/avutil.h"
+#include "libavutil/error.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+
+#include "ts_heap.h"
+
+#define NOT_IN_HEAP UINT_MAX
+
+typedef struct TsHeapEntry {
+    int64_t      ts;
+    AVRational   tb;
+    // index in TsHeap.heap or NOT_IN_HEAP
+    unsigned int pos;
+} TsHeapEntry;
+
+struct TsHeap {
+    // ids in heap order
+    unsigned int *heap;
+    unsigned int  nb_heap;
+
+    TsHeapEntry  *entries;
+    unsigned int  nb_entries;
+
+    int           max;
+};
+
+TsHeap *ts_heap_alloc(int max)
+{
+    TsHeap *h = av_mallocz(sizeof(*h));
+
+    if (!h)
+        return NULL;
+
+    h->max = max;
+
+    return h;
+}
+
+void ts_heap_free(TsHeap **ph)
+{
+    TsHeap *h = *ph;
+
+    if (!h)
+        return;
+
+    av_freep(&h->heap);
+    av_freep(&h->entries);
+
+    av_freep(ph);
+}
+
+int ts_heap_reserve(TsHeap *h, unsigned int nb_ids)
+{
+    unsigned int *heap;
+    TsHeapEntry  *entries;
+
+    if (nb_ids <= h->nb_entries)
+        return 0;
+
+    heap = av_realloc_array(h->heap, nb_ids, sizeof(*h->heap));
+    if (!heap)
+        return AVERROR(ENOMEM);
+    h->heap = heap;
+
+    entries = av_realloc_array(h->entries, nb_ids, sizeof(*h->entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    h->entries = entries;
+
+    for (unsigned int i = h->nb_entries; i < nb_ids; i++)
+        h->entries[i].pos = NOT_IN_HEAP;
+    h->nb_entries = nb_ids;
+
+    return 0;
+}
+
+/* whether id a goes above id b */
+static int above(const TsHeap *h, unsigned int a, unsigned int b)
+{
+    const TsHeapEntry *ea = &h->entries[a], *eb = &h->entries[b];
+    int cmp;
+
+    if (ea->ts == AV_NOPTS_VALUE || eb->ts == AV_NOPTS_VALUE)
+        cmp = (ea->ts != AV_NOPTS_VALUE) - (eb->ts != AV_NOPTS_VALUE);
+    else
+        cmp = av_compare_ts(ea->ts, ea->tb, eb->ts, eb->tb);
+
+    if (h->max)
+        cmp = -cmp;
+
+    return cmp ? cmp < 0 : a < b;
+}
+
+static void place(TsHeap *h, unsigned int pos, unsigned int id)
+{
+    h->heap[pos]       = id;
+    h->entries[id].pos = pos;
+}
+
+static void sift_up(TsHeap *h, unsigned int pos)
+{
+    unsigned int id = h->heap[pos];
+
+    while (pos) {
+        unsigned int parent = (pos - 1) / 2;
+
+        if (!above(h, id, h->heap[parent]))
+            break;
+
+        place(h, pos, h->heap[parent]);
+        pos = parent;
+    }
+
+    place(h, pos, id);
+}
+
+static void sift_down(TsHeap *h, unsigned int pos)
+{
+    unsigned int id = h->heap[pos];
+
+    while (1) {
+        unsigned int child = 2 * pos + 1;
+
+        if (child >= h->nb_heap)
+            break;
+        if (child + 1 < h->nb_heap && above(h, h->heap[child + 1], h->heap[child]))
+            child++;
+        if (!above(h, h->heap[child], id))
+            break;
+
+        place(h, pos, h->heap[child]);
+        pos = child;
+    }
+
+    place(h, pos, id);
+}
+
+void ts_heap_set(TsHeap *h, unsigned int id, int64_t ts, AVRational tb)
+{
+    TsHeapEntry *e;
+
+    av_assert0(id < h->nb_entries);
+    e = &h->entries[id];
+
+    e->ts = ts;
+    e->tb = tb;
+
+    if (e->pos == NOT_IN_HEAP) {
+        place(h, h->nb_heap++, id);
+        sift_up(h, e->pos);
+        return;
+    }
+
+    sift_up(h, e->pos);
+    sift_down(h, e->pos);
+}
+
+void ts_heap_remove(TsHeap *h, unsigned int id)
+{
+    unsigned int pos, last;
+
+    av_assert0(id < h->nb_entries);
+    pos = h->entries[id].pos;
+    if (pos == NOT_IN_HEAP)
+        return;
+
+    h->entries[id].pos = NOT_IN_HEAP;
+
+    last = h->heap[--h->nb_heap];
+    if (pos == h->nb_heap)
+        return;
+
+    place(h, pos, last);
+    sift_up(h, pos);
+    sift_down(h, h->entries[last].pos);
+}
+
+int ts_heap_top(const TsHeap *h, int64_t *ts)
+{
+    if (!h->nb_heap)
+        return -1;
+
+    if (ts)
+        *ts = h->entries[h->heap[0]].ts;
+
+    return h->heap[0];
+}
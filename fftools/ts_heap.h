@@ -0,0 +1,60 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFTOOLS_TS_HEAP_H
+#define FFTOOLS_TS_HEAP_H
+
+#include <stdint.h>
+
+#include "libavutil/rational.h"
+
+/**
+ * An indexed heap of timestamps, each identified by a small integer id and
+ * with its own timebase. Timestamps are compared with av_compare_ts(),
+ * AV_NOPTS_VALUE is lower than any other timestamp and equal ones are ordered
+ * by id.
+ */
+typedef struct TsHeap TsHeap;
+
+/**
+ * @param max 0 to keep the lowest timestamp at the top, 1 for the highest
+ */
+TsHeap *ts_heap_alloc(int max);
+void    ts_heap_free(TsHeap **h);
+
+/**
+ * Allow ids up to nb_ids - 1 to be used.
+ */
+int     ts_heap_reserve(TsHeap *h, unsigned int nb_ids);
+
+/**
+ * Insert an id or change its timestamp.
+ */
+void    ts_heap_set(TsHeap *h, unsigned int id, int64_t ts, AVRational tb);
+/**
+ * Remove an id, if it is in the heap.
+ */
+void    ts_heap_remove(TsHeap *h, unsigned int id);
+
+/**
+ * @param ts if not NULL, the timestamp of the top id is written here
+ * @return the id at the top of the heap, -1 if it is empty
+ */
+int     ts_heap_top(const TsHeap *h, int64_t *ts);
+
+#endif // FFTOOLS_TS_HEAP_H
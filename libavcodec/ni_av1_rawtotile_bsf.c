@@ -21,14 +21,11 @@
 
 /**
  * @file
- * This bitstream filter splits AV1 Temporal Units into packets containing
- * just one frame, plus any leading and trailing OBUs that may be present at
- * the beginning or end, respectively.
- *
- * Temporal Units already containing only one frame will be passed through
- * unchanged. When splitting can't be performed, the Temporal Unit will be
- * passed through containing only the remaining OBUs starting from the first
- * one after the last successfully split frame.
+ * This bitstream filter prepares the temporal units of one tile encoder
+ * for av1_tile_repack. The temporal unit is parsed with CBS to locate the
+ * tile payload of every frame, and is output unchanged behind an
+ * AV1TileInfo header describing the full frame geometry and those
+ * payload positions.
  */
 
 #include "libavutil/opt.h"
@@ -41,11 +38,12 @@
 #endif
 #include "cbs.h"
 #include "cbs_av1.h"
-#include "ni_av1_rbsp.h"
+#include "ni_av1_tile.h"
 #if ((LIBAVCODEC_VERSION_MAJOR > 61) || (LIBAVCODEC_VERSION_MAJOR == 61 && LIBAVCODEC_VERSION_MINOR >= 19))
 #include "libavutil/mem.h"
 #endif
 typedef struct AV1FtoTileContext {
+    const AVClass *class;
     AVPacket *buffer_pkt;
     CodedBitstreamContext *cbc;
     CodedBitstreamFragment temporal_unit;
@@ -58,11 +56,6 @@ typedef struct AV1FtoTileContext {
     int y;
     int x_w;
     int y_h;
-
-    int nb_frames;
-    int cur_frame;
-    int cur_frame_idx;
-    int last_frame_idx;
 } AV1FtoTileContext;
 
 // called by raw_to_tile_bsf
@@ -70,76 +63,75 @@ static int av1_rawtotile_filter(AVBSFContext *ctx, AVPacket *out)
 {
     AV1FtoTileContext *s = ctx->priv_data;
     CodedBitstreamFragment *td = &s->temporal_unit;
+    AV1TileInfo tileinfo = {
+        .width  = s->width,
+        .height = s->height,
+        .column = s->column,
+        .row    = s->row,
+        .x      = s->x,
+        .y      = s->y,
+        .x_w    = s->x_w,
+        .y_h    = s->y_h,
+    };
     int i, ret;
-    AV1RawOBU *obu;
-    int out_size = 0;
-    AV1TileInfo tileinfo = {0};
-    AVPacket *pkt_in = s->buffer_pkt;
-
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: width %d height %d c %d r %d x %d y %d nb_number %d cur_frame %d %d %d\n",
-            __FILE__, __LINE__, __func__,
-            s->width, s->height, s->column, s->row, s->x, s->y, s->nb_frames, s->cur_frame, s->cur_frame_idx, s->last_frame_idx);
-
-    tileinfo.width = s->width;
-    tileinfo.height = s->height;
-    tileinfo.column = s->column;
-    tileinfo.row = s->row;
-    tileinfo.x = s->x;
-    tileinfo.y = s->y;
-    tileinfo.x_w = s->x_w;
-    tileinfo.y_h = s->y_h;
-
-    if (!s->buffer_pkt->data) {
-        ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
-        if (ret < 0)
-            return ret;
-
-        // read headers and save in ctx->priv_data in cbs_av1_read_unit()
-        ret = ff_cbs_read_packet(s->cbc, td, s->buffer_pkt);
-        if (ret < 0) {
-            av_log(ctx, AV_LOG_INFO, "Failed to parse temporal unit.\n");
-            goto passthrough;
-        }
 
-        av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: nb_units %d pkt_in->size %d sizeof AV1TileInfo %ld\n",
-                __FILE__, __LINE__, __func__, td->nb_units, pkt_in->size, sizeof(AV1TileInfo));
+    ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
+    if (ret < 0)
+        return ret;
 
-        tileinfo.num_obu = td->nb_units;
-        for (i = 0; i < td->nb_units; i++) {
-            CodedBitstreamUnit *unit = &td->units[i];
-            obu = (AV1RawOBU *) unit->content;
+    // read headers and save in ctx->priv_data in cbs_av1_read_unit()
+    ret = ff_cbs_read_packet(s->cbc, td, s->buffer_pkt);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to parse temporal unit.\n");
+        goto end;
+    }
 
-            tileinfo.type[i] = unit->type;
-            tileinfo.unit_size[i] = unit->data_size;
-            tileinfo.obu_size[i] = obu->obu_size;
+    for (i = 0; i < td->nb_units; i++) {
+        CodedBitstreamUnit *unit = &td->units[i];
+        AV1RawOBU *obu = unit->content;
+        AV1RawTileData *tile_data;
+
+        if (unit->type == AV1_OBU_TILE_GROUP)
+            tile_data = &obu->obu.tile_group.tile_data;
+        else if (unit->type == AV1_OBU_FRAME)
+            tile_data = &obu->obu.frame.tile_group.tile_data;
+        else
+            continue;
+
+        if (tileinfo.num_tile_group == MAX_NUM_TILE_GROUP_PER_PACKET) {
+            av_log(ctx, AV_LOG_ERROR, "too many frames in temporal unit\n");
+            ret = AVERROR_PATCHWELCOME;
+            goto end;
+        }
 
-            if(unit->type == AV1_OBU_TILE_GROUP) {
-                tileinfo.tile_raw_data_size[tileinfo.num_tile_group] = obu->obu_size;
-                tileinfo.tile_raw_data_pos[tileinfo.num_tile_group] = (unit->data_size - obu->obu_size) + tileinfo.total_raw_data_pos;
-                tileinfo.num_tile_group++;
-            }
-            tileinfo.total_raw_data_pos += unit->data_size;
+        // the tile data references the packet, so this is its offset there
+        tileinfo.tile_raw_data_pos[tileinfo.num_tile_group]  =
+            tile_data->data - s->buffer_pkt->data;
+        tileinfo.tile_raw_data_size[tileinfo.num_tile_group] =
+            tile_data->data_size;
+        tileinfo.num_tile_group++;
 
-            av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: unit %d type %d unit_size %ld obu_size %ld raw_data_pos %d\n",
-                __FILE__, __LINE__, __func__, i, unit->type, unit->data_size, obu->obu_size, tileinfo.tile_raw_data_pos[0]);
-        }
+        av_log(ctx, AV_LOG_DEBUG, "unit %d type %d tile data pos %d size %zu\n",
+               i, unit->type, tileinfo.tile_raw_data_pos[tileinfo.num_tile_group - 1],
+               tile_data->data_size);
     }
 
-    out_size = pkt_in->size + sizeof(AV1TileInfo);
-    ret = av_new_packet(out, out_size);
+    ret = av_new_packet(out, sizeof(AV1TileInfo) + s->buffer_pkt->size);
+    if (ret < 0)
+        goto end;
+
+    ret = av_packet_copy_props(out, s->buffer_pkt);
     if (ret < 0) {
-        return ret;
+        av_packet_unref(out);
+        goto end;
     }
 
-    av_packet_copy_props(out, s->buffer_pkt);
-
-    // out data structure is AV1TileInfo + AV1 frame data
-    memcpy(out->data, (uint8_t *)&tileinfo, sizeof(AV1TileInfo));
-
-    memcpy(out->data + sizeof(AV1TileInfo), s->buffer_pkt->data, pkt_in->size);
-    out->size = pkt_in->size + sizeof(AV1TileInfo);
+    // out data structure is AV1TileInfo + AV1 temporal unit
+    memcpy(out->data, &tileinfo, sizeof(AV1TileInfo));
+    memcpy(out->data + sizeof(AV1TileInfo), s->buffer_pkt->data,
+           s->buffer_pkt->size);
 
-passthrough:
+end:
     av_packet_unref(s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
@@ -148,7 +140,7 @@ passthrough:
 #else
     ff_cbs_fragment_uninit(s->cbc, td);
 #endif
-    return 0;
+    return ret;
 }
 
 static const CodedBitstreamUnitType decompose_unit_types[] = {
@@ -162,8 +154,6 @@ static const CodedBitstreamUnitType decompose_unit_types[] = {
 static int av1_rawtotile_init(AVBSFContext *ctx)
 {
     AV1FtoTileContext *s = ctx->priv_data;
-    CodedBitstreamFragment *td = &s->temporal_unit;
-    void *pb_buf;
     int ret;
 
     s->buffer_pkt = av_packet_alloc();
@@ -177,19 +167,6 @@ static int av1_rawtotile_init(AVBSFContext *ctx)
     s->cbc->decompose_unit_types    = (CodedBitstreamUnitType*)decompose_unit_types;
     s->cbc->nb_decompose_unit_types = FF_ARRAY_ELEMS(decompose_unit_types);
 
-#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-    ff_cbs_fragment_reset(td);
-#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, td);
-#else
-    ff_cbs_fragment_uninit(s->cbc, td);
-#endif
-
-    pb_buf = av_mallocz(MAX_PUT_BUF_SIZE);
-    if (!pb_buf) {
-        return AVERROR(ENOMEM);
-    }
-
     return 0;
 }
 
@@ -0,0 +1,48 @@
+/*
+ * NetInt AV1 tile info shared by the av1_rawtotile and av1_tile_repack BSFs
+ * Copyright (c) 2018-2023 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_NI_AV1_TILE_H
+#define AVCODEC_NI_AV1_TILE_H
+
+#define MAX_NUM_TILE_PER_FRAME 128
+#define MAX_NUM_TILE_GROUP_PER_PACKET 8
+
+/**
+ * Header prepended by av1_rawtotile to every single tile temporal unit.
+ * The geometry describes the full frame and the position of this tile in
+ * it, the tile_raw_data arrays locate the tile payload of every frame in
+ * the temporal unit, relative to the end of this header.
+ */
+typedef struct AV1TileInfo {
+    int width;
+    int height;
+    int column; //total tile number in column
+    int row;    //total tile number in row
+    int x;
+    int y;
+    int x_w;
+    int y_h;
+    int num_tile_group;
+    int tile_raw_data_size[MAX_NUM_TILE_GROUP_PER_PACKET];
+    int tile_raw_data_pos[MAX_NUM_TILE_GROUP_PER_PACKET];
+} AV1TileInfo;
+
+#endif /* AVCODEC_NI_AV1_TILE_H */
@@ -24,8 +24,15 @@
  *
  * This bitstream filter repacks AV1 tiles into one packet containing
  * just one frame.
+ *
+ * The temporal unit of tile 0 is parsed with CBS. Its sequence and frame
+ * headers are rewritten for the full frame geometry, every other OBU is
+ * passed through. Tile group OBUs are regenerated with empty tile data and
+ * the tile payloads of all tiles are then copied straight from the input
+ * packets behind their headers.
  */
 
+#include "libavutil/avassert.h"
 #include "libavutil/opt.h"
 
 #include "avcodec.h"
@@ -37,421 +44,512 @@
 #include "cbs.h"
 #include "cbs_av1.h"
 #include "internal.h"
-#include "ni_av1_rbsp.h"
+#include "ni_av1_tile.h"
+#include "ni_tile_repack.h"
 #if ((LIBAVCODEC_VERSION_MAJOR > 61) || (LIBAVCODEC_VERSION_MAJOR == 61 && LIBAVCODEC_VERSION_MINOR >= 19))
 #include "libavutil/mem.h"
 #endif
 typedef struct AV1RepackContext {
+    const AVClass *class;
     AVPacket *buffer_pkt;
     AVPacket **tile_pkt;
-    CodedBitstreamContext *cbc;
+    CodedBitstreamContext *cbc_in;  // parses the single tile stream of tile 0
+    CodedBitstreamContext *cbc_out; // writes the full frame headers
     CodedBitstreamFragment temporal_unit;
-    PutBitContext stream;
     AV1TileInfo tileinfo[MAX_NUM_TILE_PER_FRAME];
+    NITileRepackPool pool;
 
+    int first_tile;
     int tile_pos;
     int tile_num;
 } AV1RepackContext;
 
-static int ni_av1_log2(int blksize, int target)
-{
-    int k;
-    for (k = 0; (blksize << k) < target; k++);
-    return k;
+static int av1_tile_repack_add_tile(AVBSFContext *ctx, AVPacket *pkt) {
+    AV1RepackContext *s = ctx->priv_data;
+    AV1TileInfo *tileinfo;
+    AVPacket *first;
+    int *side_data;
+    int tile_idx, payload_size, i;
+
+    side_data = (int *)av_packet_get_side_data(pkt, AV_PKT_DATA_SLICE_ADDR,
+                                               NULL);
+    if (!side_data) {
+        av_log(ctx, AV_LOG_ERROR, "failed to get packet side data\n");
+        return AVERROR(EINVAL);
+    }
+
+    tile_idx = *side_data;
+    if (tile_idx < 0 || tile_idx >= s->tile_num) {
+        av_log(ctx, AV_LOG_ERROR,
+               "tile index %d exceeds maximum tile number %d\n", tile_idx,
+               s->tile_num);
+        return AVERROR(EINVAL);
+    }
+
+    if (s->tile_pkt[tile_idx]->data) {
+        av_log(ctx, AV_LOG_ERROR, "duplicated tile index %d\n", tile_idx);
+        return AVERROR(EINVAL);
+    }
+
+    if (pkt->size < (int)sizeof(AV1TileInfo)) {
+        av_log(ctx, AV_LOG_ERROR, "tile %d has no tile info, "
+               "is av1_rawtotile applied to it?\n", tile_idx);
+        return AVERROR(EINVAL);
+    }
+
+    if (s->tile_pos) {
+        first = s->tile_pkt[s->first_tile];
+        if (pkt->pts != first->pts || pkt->dts != first->dts ||
+            pkt->flags != first->flags ||
+            pkt->stream_index != first->stream_index) {
+            av_log(ctx, AV_LOG_ERROR, "packet metadata does not match\n");
+            return AVERROR(EINVAL);
+        }
+    } else {
+        s->first_tile = tile_idx;
+    }
+
+    tileinfo = &s->tileinfo[tile_idx];
+    memcpy(tileinfo, pkt->data, sizeof(AV1TileInfo));
+
+    if (tileinfo->num_tile_group < 0 ||
+        tileinfo->num_tile_group > MAX_NUM_TILE_GROUP_PER_PACKET) {
+        av_log(ctx, AV_LOG_ERROR, "invalid tile info for tile %d\n", tile_idx);
+        return AVERROR(EINVAL);
+    }
+    payload_size = pkt->size - (int)sizeof(AV1TileInfo);
+    for (i = 0; i < tileinfo->num_tile_group; i++) {
+        if (tileinfo->tile_raw_data_size[i] <= 0 ||
+            tileinfo->tile_raw_data_pos[i] < 0 ||
+            tileinfo->tile_raw_data_pos[i] > payload_size -
+                                             tileinfo->tile_raw_data_size[i]) {
+            av_log(ctx, AV_LOG_ERROR, "tile %d payload %d out of bounds\n",
+                   tile_idx, i);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    // keep a reference to the tile, its payload is copied only once into
+    // the repacked frame
+    av_packet_move_ref(s->tile_pkt[tile_idx], pkt);
+    s->tile_pkt[tile_idx]->data += sizeof(AV1TileInfo);
+    s->tile_pkt[tile_idx]->size -= sizeof(AV1TileInfo);
+    s->tile_pos++;
+
+    av_log(ctx, AV_LOG_DEBUG, "== tile %d, data size %d, %d frames\n",
+           tile_idx, s->tile_pkt[tile_idx]->size, tileinfo->num_tile_group);
+
+    return 0;
 }
 
-static int av1_rawtotile_encode_sequence_header_obu(AVBSFContext *ctx, AV1RawSequenceHeader *current, AV1TileInfo *tileinfo)
-{
-    AV1RepackContext *s = ctx->priv_data;
+/* Smallest tile_size_bytes able to code the size of all but the last tile. */
+static int av1_tile_repack_tile_size_bytes(const AV1RepackContext *s, int tg) {
+    int max_size = 1;
+    int i;
+
+    for (i = 0; i < s->tile_num - 1; i++)
+        max_size = FFMAX(max_size, s->tileinfo[i].tile_raw_data_size[tg]);
 
-    current->max_frame_width_minus_1 = tileinfo->width - 1;
-    current->max_frame_height_minus_1 = tileinfo->height - 1;
-    current->frame_width_bits_minus_1 = ni_av1_log2(1, tileinfo->width) - 1;
-    current->frame_height_bits_minus_1 = ni_av1_log2(1, tileinfo->height) - 1;
+    return (av_log2(max_size - 1) >> 3) + 1;
+}
+
+static size_t av1_tile_repack_tile_data_size(const AV1RepackContext *s,
+                                             int tg) {
+    size_t size = (size_t)(s->tile_num - 1) *
+                  av1_tile_repack_tile_size_bytes(s, tg);
+    int i;
 
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: width %d height %d\n",
-            __FILE__, __LINE__, __func__, tileinfo->width, tileinfo->height);
+    for (i = 0; i < s->tile_num; i++)
+        size += s->tileinfo[i].tile_raw_data_size[tg];
 
-    return netint_av1_write_sequence_header_obu(s->cbc, &s->stream, current);
+    return size;
 }
 
-static int av1_rawtotile_encode_temporal_delimiter_obu(AVBSFContext *ctx)
-{
+static int av1_tile_repack_sequence_header(AVBSFContext *ctx,
+                                           AV1RawSequenceHeader *seq) {
     AV1RepackContext *s = ctx->priv_data;
+    const AV1TileInfo *tileinfo = &s->tileinfo[0];
 
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: \n", __FILE__, __LINE__, __func__);
+    seq->max_frame_width_minus_1   = tileinfo->width - 1;
+    seq->max_frame_height_minus_1  = tileinfo->height - 1;
+    seq->frame_width_bits_minus_1  = FFMAX(seq->frame_width_bits_minus_1,
+                                           av_log2(tileinfo->width - 1));
+    seq->frame_height_bits_minus_1 = FFMAX(seq->frame_height_bits_minus_1,
+                                           av_log2(tileinfo->height - 1));
 
-    return netint_av1_write_temporal_delimiter_obu(s->cbc, &s->stream);
+    av_log(ctx, AV_LOG_DEBUG, "sequence header: width %d height %d\n",
+           tileinfo->width, tileinfo->height);
+
+    return 0;
 }
 
-#ifdef NOFRAMEOBU
-static int av1_rawtotile_encode_frame_header_obu(AVBSFContext *ctx, AV1RawSequenceHeader *seq, AV1RawFrameHeader *current, AV1TileInfo *tileinfo)
-{
-    int uniform_tile_spacing_flag = 1;
+/*
+ * Describe the tile grid in the frame header. Uniform spacing is used
+ * whenever it reproduces the tile sizes, otherwise the sizes are coded
+ * explicitly.
+ */
+static int av1_tile_repack_tile_info(AVBSFContext *ctx,
+                                     const AV1RawSequenceHeader *seq,
+                                     AV1RawFrameHeader *fh, int tg) {
     AV1RepackContext *s = ctx->priv_data;
+    const AV1TileInfo *tileinfo = s->tileinfo;
+    int sb_shift = seq->use_128x128_superblock ? 7 : 6;
+    int sb_cols  = (tileinfo->width  + (1 << sb_shift) - 1) >> sb_shift;
+    int sb_rows  = (tileinfo->height + (1 << sb_shift) - 1) >> sb_shift;
+    int cols = tileinfo->column, rows = tileinfo->row;
+    int cols_log2, rows_log2, tile_width_sb, tile_height_sb;
+    int uniform, start_sb, size_sb, i;
+
+    if (cols <= 0 || rows <= 0 || cols * rows != s->tile_num ||
+        cols > AV1_MAX_TILE_COLS || rows > AV1_MAX_TILE_ROWS) {
+        av_log(ctx, AV_LOG_ERROR, "invalid tile grid %dx%d for %d tiles\n",
+               cols, rows, s->tile_num);
+        return AVERROR(EINVAL);
+    }
 
-    current->frame_width_minus_1 = tileinfo->width - 1;
-    current->frame_height_minus_1 = tileinfo->height - 1;
-    current->tile_cols_log2 = ni_av1_log2(1, tileinfo->column);
-    current->tile_rows_log2 = ni_av1_log2(1, tileinfo->row);
-    current->tile_size_bytes_minus1 = TILE_SIZE_BYTES - 1;
-    for(int i = 1; i < tileinfo->column * tileinfo->row; i++)
-    {
-        if((tileinfo[i].x_w != tileinfo[i - 1].x_w) || (tileinfo[i].y_h != tileinfo[i - 1].y_h))
-        {
-            uniform_tile_spacing_flag = 0;
-            break;
-        }
+    cols_log2      = cols > 1 ? av_log2(cols - 1) + 1 : 0;
+    rows_log2      = rows > 1 ? av_log2(rows - 1) + 1 : 0;
+    tile_width_sb  = (sb_cols + (1 << cols_log2) - 1) >> cols_log2;
+    tile_height_sb = (sb_rows + (1 << rows_log2) - 1) >> rows_log2;
+    uniform        = cols == 1 << cols_log2 && rows == 1 << rows_log2;
+
+    for (i = start_sb = 0; i < cols; i++, start_sb += size_sb) {
+        size_sb = (tileinfo[i].x_w + (1 << sb_shift) - 1) >> sb_shift;
+        if (size_sb <= 0 || start_sb + size_sb > sb_cols)
+            goto invalid;
+        if (size_sb != FFMIN(tile_width_sb, sb_cols - i * tile_width_sb))
+            uniform = 0;
+        fh->width_in_sbs_minus_1[i] = size_sb - 1;
     }
-    if(!uniform_tile_spacing_flag)
-    {
-        for(int i = 0; i < tileinfo->column; i++)
-            current->width_in_sbs_minus_1[i] = (tileinfo[i].x_w + 63) / 64 - 1;
-        for(int i = 0; i < tileinfo->row; i++)
-            current->height_in_sbs_minus_1[i] = (tileinfo[i * tileinfo->column].y_h + 63) / 64 - 1;
-        current->uniform_tile_spacing_flag = 0;
+    if (start_sb != sb_cols)
+        goto invalid;
+
+    for (i = start_sb = 0; i < rows; i++, start_sb += size_sb) {
+        size_sb = (tileinfo[i * cols].y_h + (1 << sb_shift) - 1) >> sb_shift;
+        if (size_sb <= 0 || start_sb + size_sb > sb_rows)
+            goto invalid;
+        if (size_sb != FFMIN(tile_height_sb, sb_rows - i * tile_height_sb))
+            uniform = 0;
+        fh->height_in_sbs_minus_1[i] = size_sb - 1;
     }
+    if (start_sb != sb_rows)
+        goto invalid;
 
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: width %d height %d tile_size_bytes_minus1 %d\n",
-            __FILE__, __LINE__, __func__, tileinfo->width, tileinfo->height, current->tile_size_bytes_minus1);
+    fh->uniform_tile_spacing_flag = uniform;
+    fh->tile_cols_log2            = cols_log2;
+    fh->tile_rows_log2            = rows_log2;
+    fh->context_update_tile_id    = 0;
+    fh->tile_size_bytes_minus1    = av1_tile_repack_tile_size_bytes(s, tg) - 1;
 
-    return netint_av1_write_frame_header_obu(s->cbc, &s->stream, seq, current);
+    av_log(ctx, AV_LOG_DEBUG, "tile info: %dx%d tiles, uniform %d, "
+           "tile_size_bytes_minus1 %d\n", cols, rows, uniform,
+           fh->tile_size_bytes_minus1);
+
+    return 0;
+
+invalid:
+    av_log(ctx, AV_LOG_ERROR, "tile sizes do not cover the %dx%d frame\n",
+           tileinfo->width, tileinfo->height);
+    return AVERROR(EINVAL);
 }
 
-static int av1_rawtotile_encode_tile_group_obu(AVBSFContext *ctx, AV1RawSequenceHeader *seq, AV1RawTileGroup *current)
-{
+static int av1_tile_repack_frame_header(AVBSFContext *ctx,
+                                        AV1RawFrameHeader *fh, int tg) {
     AV1RepackContext *s = ctx->priv_data;
+    CodedBitstreamAV1Context *priv = s->cbc_in->priv_data;
+    const AV1TileInfo *tileinfo = &s->tileinfo[0];
+    int i;
 
-     current->tg_end = s->tile_num - 1;
-
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: tile_start_and_end_present_flag %d tg_start %d tg_end %d\n",
-            __FILE__, __LINE__, __func__, current->tile_start_and_end_present_flag, current->tg_start, current->tg_end);
+    if (fh->show_existing_frame)
+        return 0;
 
-    return netint_av1_write_tile_group_obu(s->cbc, &s->stream, seq, current);
-}
-#else
-static int av1_rawtotile_encode_frame_obu(
-    AVBSFContext *ctx, AV1RawSequenceHeader *seq, AV1RawTileGroup *tile_current, AV1RawFrameHeader *frame_current, AV1TileInfo *tileinfo)
-{
-    AV1RepackContext *s = ctx->priv_data;
-    AV1RawFrame current;
+    for (i = 0; i < s->tile_num; i++) {
+        if (tg >= s->tileinfo[i].num_tile_group) {
+            av_log(ctx, AV_LOG_ERROR, "tile %d is missing frame %d of the "
+                   "temporal unit\n", i, tg);
+            return AVERROR_INVALIDDATA;
+        }
+    }
 
-    frame_current->frame_width_minus_1 = tileinfo->width - 1;
-    frame_current->frame_height_minus_1 = tileinfo->height - 1;
-    frame_current->tile_cols_log2 = ni_av1_log2(1, tileinfo->column);
-    frame_current->tile_rows_log2 = ni_av1_log2(1, tileinfo->row);
-    frame_current->tile_size_bytes_minus1 = TILE_SIZE_BYTES - 1;
+    fh->frame_width_minus_1   = tileinfo->width - 1;
+    fh->frame_height_minus_1  = tileinfo->height - 1;
+    fh->render_width_minus_1  = tileinfo->width - 1;
+    fh->render_height_minus_1 = tileinfo->height - 1;
 
-    memcpy(&current.header, frame_current, sizeof(AV1RawFrameHeader));
-    memcpy(&current.tile_group, tile_current, sizeof(AV1RawTileGroup));
+    return av1_tile_repack_tile_info(ctx, priv->sequence_header, fh, tg);
+}
 
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: width %d height %d tile_size_bytes_minus1 %d\n",
-            __FILE__, __LINE__, __func__, tileinfo->width, tileinfo->height, frame_current->tile_size_bytes_minus1);
+static void av1_tile_repack_tile_group(AVBSFContext *ctx,
+                                       AV1RawTileGroup *tile_group) {
+    AV1RepackContext *s = ctx->priv_data;
 
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: tile_start_and_end_present_flag %d tg_start %d tg_end %d\n",
-            __FILE__, __LINE__, __func__, tile_current->tile_start_and_end_present_flag, tile_current->tg_start, tile_current->tg_end);
+    // all tiles go into one tile group, the tile data is added when the
+    // frame is assembled
+    tile_group->tile_start_and_end_present_flag = 0;
+    tile_group->tg_start                        = 0;
+    tile_group->tg_end                          = s->tile_num - 1;
 
-    return netint_av1_write_frame_obu(s->cbc, &s->stream, seq, &current);
+    av_buffer_unref(&tile_group->tile_data.data_ref);
+    tile_group->tile_data.data      = NULL;
+    tile_group->tile_data.data_size = 0;
 }
-#endif
 
-// called from tile_repack_bsf()
-static int av1_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
+/* Rewrite the headers of the tile 0 temporal unit for the full frame. */
+static int av1_tile_repack_rewrite_headers(AVBSFContext *ctx) {
     AV1RepackContext *s = ctx->priv_data;
     CodedBitstreamFragment *td = &s->temporal_unit;
-    CodedBitstreamAV1Context *priv = s->cbc->priv_data;
-    AVPacket *tile_pkt;
-    AV1RawOBU *obu;
-#ifndef NOFRAMEOBU
-    AV1RawOBU *frame_obu;
-#endif
-    AV1RawSequenceHeader *prev_sequence_header_obu;
-    PutBitContext pbc_tmp;
-    int start_pos, end_pos, data_pos, add_trailing_bits = 0;
-    size_t obu_size;
-    int ret;
-    int tile_idx;
-    int *side_data;
-    int i, j, new_size;
-    int tile_group_index;
+    int tg = 0;
+    int i, ret;
 
-    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: tile_pos %d, tile_num %d\n", __FILE__, __LINE__, __func__, s->tile_pos, s->tile_num);
+    for (i = 0; i < td->nb_units; i++) {
+        CodedBitstreamUnit *unit = &td->units[i];
+        AV1RawOBU *obu = unit->content;
 
-    if (s->tile_pos < s->tile_num) {
-        if (!s->buffer_pkt->data) {
-            ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
-            if (ret < 0) {
-                av_log(ctx, AV_LOG_INFO, "failed to get packet ref: 0x%x\n",
-                       ret);
+        switch (unit->type) {
+        case AV1_OBU_SEQUENCE_HEADER:
+            // the parser keeps the tile sequence header for the next frames
+            ret = ff_cbs_make_unit_writable(s->cbc_in, unit);
+            if (ret < 0)
                 return ret;
-            }
+            obu = unit->content;
+            ret = av1_tile_repack_sequence_header(ctx,
+                                                  &obu->obu.sequence_header);
+            break;
+        case AV1_OBU_FRAME_HEADER:
+            ret = av1_tile_repack_frame_header(ctx, &obu->obu.frame_header, tg);
+            break;
+        case AV1_OBU_FRAME:
+            ret = av1_tile_repack_frame_header(ctx, &obu->obu.frame.header, tg);
+            av1_tile_repack_tile_group(ctx, &obu->obu.frame.tile_group);
+            tg++;
+            break;
+        case AV1_OBU_TILE_GROUP:
+            av1_tile_repack_tile_group(ctx, &obu->obu.tile_group);
+            ret = 0;
+            tg++;
+            break;
+        case AV1_OBU_REDUNDANT_FRAME_HEADER:
+            // optional, and it would describe the tile rather than the frame
+            ff_cbs_delete_unit(td, i--);
+            ret = 0;
+            break;
+        case AV1_OBU_TILE_LIST:
+            av_log(ctx, AV_LOG_ERROR, "Large scale tiles are unsupported.\n");
+            return AVERROR_PATCHWELCOME;
+        default:
+            // passed through
+            ret = 0;
+            break;
         }
+        if (ret < 0)
+            return ret;
+    }
 
-        side_data = (int *)av_packet_get_side_data(
-            s->buffer_pkt, AV_PKT_DATA_SLICE_ADDR, NULL);
+    return 0;
+}
 
-        if (!side_data) {
-            av_log(ctx, AV_LOG_ERROR, "failed to get packet side data\n");
-            return AVERROR(EINVAL);
-        }
+static uint8_t *av1_tile_repack_put_leb128(uint8_t *dst, uint64_t value) {
+    do {
+        *dst++ = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
 
-        tile_idx = *side_data;
-        if (tile_idx >= s->tile_num) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "tile index %d exceeds maximum tile number %d\n", tile_idx,
-                   s->tile_num);
-            return AVERROR(EINVAL);
-        }
+    return dst;
+}
 
-        if (s->tile_pkt[tile_idx]->buf) {
-            av_log(ctx, AV_LOG_ERROR, "duplicated tile index %d\n", tile_idx);
-            return AVERROR(EINVAL);
-        }
+static int av1_tile_repack_leb128_size(uint64_t value) {
+    int size = 1;
 
-        s->tile_pkt[tile_idx]->buf = av_buffer_ref(s->buffer_pkt->buf);
-        if (!s->tile_pkt[tile_idx]->buf) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "failed to get buffer for tile index %d\n", tile_idx);
-            return AVERROR(ENOMEM);
-        }
+    while (value >>= 7)
+        size++;
 
-        // copy tile info
-        memcpy(&s->tileinfo[tile_idx], s->buffer_pkt->data, sizeof(AV1TileInfo));
-
-#ifdef PLOG
-        for (i = 0; i < s->tileinfo[tile_idx].num_obu; i++) {
-            av_log(ctx, AV_LOG_INFO, "### %s line %d %s: tile_idx %d tile_pos %d unit %d type %d unit_size %d obu_size %d column %d row %d raw_data_size %d\n",
-                __FILE__, __LINE__, __func__, tile_idx, s->tile_pos, i, s->tileinfo[tile_idx].type[i], s->tileinfo[tile_idx].unit_size[i],
-                s->tileinfo[tile_idx].obu_size[i], s->tileinfo[tile_idx].column, s->tileinfo[tile_idx].row);
-            for(j = 0; j < s->tileinfo[tile_idx].num_tile_group; j++)
-            {
-                av_log(ctx, AV_LOG_INFO, "raw_data_size[%d] %d\n", j, s->tileinfo[tile_idx].tile_raw_data_size[j]);
-            }
-        }
-#endif
+    return size;
+}
 
-        s->tile_pkt[tile_idx]->data = s->buffer_pkt->data + sizeof(AV1TileInfo);
-        s->tile_pkt[tile_idx]->size = s->buffer_pkt->size - sizeof(AV1TileInfo);
-
-        av_log(ctx, AV_LOG_DEBUG, "== tile %d, data actual size %d data pos %ld\n", tile_idx,
-               s->buffer_pkt->size, s->buffer_pkt->pos);
-
-        if (s->tile_pos == 0) {
-            s->tile_pkt[0]->pts          = s->buffer_pkt->pts;
-            s->tile_pkt[0]->dts          = s->buffer_pkt->dts;
-            s->tile_pkt[0]->pos          = s->buffer_pkt->pos;
-            s->tile_pkt[0]->flags        = s->buffer_pkt->flags;
-            s->tile_pkt[0]->stream_index = s->buffer_pkt->stream_index;
-
-            s->tile_pkt[0]->side_data       = NULL;
-            s->tile_pkt[0]->side_data_elems = 0;
-
-            for (i = 0; i < s->tile_pkt[0]->side_data_elems; i++) {
-                enum AVPacketSideDataType type =
-                    s->buffer_pkt->side_data[i].type;
-                if (type != AV_PKT_DATA_SLICE_ADDR) {
-                    int size          = s->buffer_pkt->side_data[i].size;
-                    uint8_t *src_data = s->buffer_pkt->side_data[i].data;
-                    uint8_t *dst_data =
-                        av_packet_new_side_data(s->tile_pkt[0], type, size);
-
-                    av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: side data type %d size %d added\n",
-                            __FILE__, __LINE__, __func__, type, size);
-
-                    if (!dst_data) {
-                        av_packet_free_side_data(s->tile_pkt[0]);
-                        return AVERROR(ENOMEM);
-                    }
-
-                    memcpy(dst_data, src_data, size);
-                }
-            }
-        } else {
-            if (s->buffer_pkt->pts != s->tile_pkt[0]->pts ||
-                s->buffer_pkt->dts != s->tile_pkt[0]->dts ||
-                s->buffer_pkt->flags != s->tile_pkt[0]->flags ||
-                s->buffer_pkt->stream_index != s->tile_pkt[0]->stream_index) {
-                av_log(ctx, AV_LOG_ERROR, "packet metadata does not match\n");
-                return AVERROR(EINVAL);
-            }
+/*
+ * The unit holds the tile group or frame OBU written with empty tile data.
+ * Split it into the OBU header and the payload headers behind the obu_size
+ * field, which has to be rewritten. OBUs without a size field are
+ * rejected, the size field is where the tile data length goes.
+ */
+static int av1_tile_repack_split_obu(void *logctx,
+                                     const CodedBitstreamUnit *unit,
+                                     size_t *header_size,
+                                     const uint8_t **payload,
+                                     size_t *payload_size) {
+    const uint8_t *p, *end = unit->data + unit->data_size;
+
+    if (unit->data_size < 2 || !(unit->data[0] & 0x02)) { // obu_has_size_field
+        av_log(logctx, AV_LOG_ERROR,
+               "Tile group OBU without obu_size is unsupported.\n");
+        return AVERROR_PATCHWELCOME;
+    }
+
+    *header_size = 1 + !!(unit->data[0] & 0x04); // obu_extension_flag
+    p = unit->data + *header_size;
+    while (p < end && *p & 0x80)
+        p++;
+    if (p >= end)
+        return AVERROR_INVALIDDATA;
+    p++;
+    *payload      = p;
+    *payload_size = end - p;
+    return 0;
+}
+
+static uint8_t *av1_tile_repack_put_tile_group(AVBSFContext *ctx,
+                                               const CodedBitstreamUnit *unit,
+                                               int tg, uint8_t *dst) {
+    AV1RepackContext *s = ctx->priv_data;
+    int size_bytes = av1_tile_repack_tile_size_bytes(s, tg);
+    const uint8_t *payload;
+    size_t header_size, payload_size;
+    int i, j;
+
+    // validated while sizing the output
+    av1_tile_repack_split_obu(ctx, unit, &header_size, &payload,
+                              &payload_size);
+
+    memcpy(dst, unit->data, header_size);
+    dst = av1_tile_repack_put_leb128(dst + header_size, payload_size +
+                                     av1_tile_repack_tile_data_size(s, tg));
+    memcpy(dst, payload, payload_size);
+    dst += payload_size;
+
+    for (i = 0; i < s->tile_num; i++) {
+        int tile_size = s->tileinfo[i].tile_raw_data_size[tg];
+
+        // no size field for the last tile
+        if (i < s->tile_num - 1) {
+            for (j = 0; j < size_bytes; j++)
+                *dst++ = (tile_size - 1) >> (8 * j);
         }
+        memcpy(dst, s->tile_pkt[i]->data + s->tileinfo[i].tile_raw_data_pos[tg],
+               tile_size);
+        dst += tile_size;
+    }
 
-        s->tile_pos++;
-        av_packet_unref(s->buffer_pkt);
+    return dst;
+}
+
+static int av1_tile_repack_output_frame(AVBSFContext *ctx, AVPacket *out) {
+    AV1RepackContext *s = ctx->priv_data;
+    CodedBitstreamFragment *td = &s->temporal_unit;
+    AVBufferRef *buf = NULL;
+    uint8_t *data;
+    size_t new_size = 0;
+    int i, tg, ret;
+
+    if (s->tile_num == 1) {
+        /* nothing to stitch, hand the tile on without its tile info */
+        av_packet_move_ref(out, s->tile_pkt[0]);
+        goto end;
     }
 
-    if (s->tile_pos == s->tile_num) {
-#ifndef NOFRAMEOBU
-        int frame_header_index = -1;
-#endif
-        tile_group_index = 0;
+    // read headers and save in ctx->priv_data in cbs_av1_read_unit()
+    ret = ff_cbs_read_packet(s->cbc_in, td, s->tile_pkt[0]);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to parse temporal unit.\n");
+        goto fail;
+    }
 
-        tile_pkt = s->tile_pkt[0];
+    ret = av1_tile_repack_rewrite_headers(ctx);
+    if (ret < 0)
+        goto fail;
 
-        priv->tile_cols = s->tileinfo[0].column;
-        priv->tile_rows = s->tileinfo[0].row;
-        priv->frame_width = s->tileinfo[0].width;
-        priv->frame_height = s->tileinfo[0].height;
+    ret = ff_cbs_write_fragment_data(s->cbc_out, td);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to write temporal unit.\n");
+        goto fail;
+    }
 
-        // read headers and save in ctx->priv_data in cbs_av1_read_unit()
-        ret = ff_cbs_read_packet(s->cbc, td, tile_pkt);
-        if (ret < 0) {
-            av_log(ctx, AV_LOG_INFO, "Failed to parse temporal unit.\n");
-            goto end;
+    for (i = tg = 0; i < td->nb_units; i++) {
+        const CodedBitstreamUnit *unit = &td->units[i];
+        const uint8_t *payload;
+        size_t header_size, payload_size, tile_data_size;
+
+        if (unit->type != AV1_OBU_TILE_GROUP && unit->type != AV1_OBU_FRAME) {
+            new_size += unit->data_size;
+            continue;
         }
 
-        for (i = 0; i < td->nb_units; i++) {
-
-            CodedBitstreamUnit *unit = &td->units[i];
-            obu = (AV1RawOBU *) unit->content;
-            obu->header.obu_has_size_field = 1;
-
-            netint_av1_write_obu_header(s->cbc, &s->stream, &obu->header);
-
-            av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: obu_has_size_field %d\n",
-                   __FILE__, __LINE__, __func__, obu->header.obu_has_size_field);
-
-            if (obu->header.obu_has_size_field) {
-                pbc_tmp = s->stream;
-                // Add space for the size field to fill later.
-                put_bits32(&s->stream, 0);
-                put_bits32(&s->stream, 0);
-            }
-
-            start_pos = put_bits_count(&s->stream);
-
-            switch(unit->type) {
-            case AV1_OBU_SEQUENCE_HEADER:
-                av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: AV1_OBU_SEQUENCE_HEADER \n",
-                       __FILE__, __LINE__, __func__);
-                av1_rawtotile_encode_sequence_header_obu(ctx, &obu->obu.sequence_header, &s->tileinfo[0]);
-                prev_sequence_header_obu = &obu->obu.sequence_header;
-                priv->sequence_header = &obu->obu.sequence_header;
-                add_trailing_bits = 1;
-                break;
-            case AV1_OBU_TEMPORAL_DELIMITER:
-                av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: AV1_OBU_TEMPORAL_DELIMITER \n",
-                       __FILE__, __LINE__, __func__);
-                av1_rawtotile_encode_temporal_delimiter_obu(ctx);
-                add_trailing_bits = 0;
-                break;
-            case AV1_OBU_FRAME_HEADER:
-                av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: AV1_OBU_FRAME_HEADER \n",
-                       __FILE__, __LINE__, __func__);
-#ifdef NOFRAMEOBU
-                av1_rawtotile_encode_frame_header_obu(ctx, prev_sequence_header_obu, &obu->obu.frame_header, &s->tileinfo[0]);
-                add_trailing_bits = 1;
-#else
-                frame_header_index = i;
-#endif
-                break;
-            case AV1_OBU_TILE_GROUP:
-                av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: AV1_OBU_TILE_GROUP \n",
-                       __FILE__, __LINE__, __func__);
-#ifdef NOFRAMEOBU
-                av1_rawtotile_encode_tile_group_obu(ctx, prev_sequence_header_obu, &obu->obu.tile_group);
-                add_trailing_bits = 0;
-#else
-                // Need to encode OBU_FRAME_HEADER + OBU_TILE_GROUP as OBU_FRAME
-                if(frame_header_index < 0) {
-                    av_log(ctx, AV_LOG_INFO, "AV1_OBU_FRAME_HEADER must be received first to repack\n");
-                    goto end;
-                }
+        ret = av1_tile_repack_split_obu(ctx, unit, &header_size, &payload,
+                                        &payload_size);
+        if (ret < 0)
+            goto fail;
+        tile_data_size = av1_tile_repack_tile_data_size(s, tg++);
+        new_size += header_size + payload_size + tile_data_size +
+                    av1_tile_repack_leb128_size(payload_size + tile_data_size);
+    }
 
-                frame_obu = td->units[frame_header_index].content;
+    ret = ff_ni_tile_repack_get_buffer(ctx, &s->pool, new_size, &buf);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to allocate new packet data\n");
+        goto fail;
+    }
 
-                av1_rawtotile_encode_frame_obu(ctx, prev_sequence_header_obu,
-                     &obu->obu.tile_group, &frame_obu->obu.frame_header, &tileinfo[0]);
-#endif
+    data = buf->data;
+    for (i = tg = 0; i < td->nb_units; i++) {
+        const CodedBitstreamUnit *unit = &td->units[i];
 
-                break;
-
-            case AV1_OBU_METADATA:
-            case AV1_OBU_FRAME:
-            case AV1_OBU_REDUNDANT_FRAME_HEADER:
-                continue;
-            case AV1_OBU_TILE_LIST:
-            default:
-                av_log(ctx, AV_LOG_INFO, "Large scale tiles are unsupported.\n");
-                goto end;
-            }
-
-
-            if(unit->type != AV1_OBU_TILE_GROUP) {
-               av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: calling netint_av1_update_obu_data_length 1 \n",
-                       __FILE__, __LINE__, __func__);
-               obu_size = netint_av1_update_obu_data_length(s->cbc, &s->stream, start_pos, obu, &pbc_tmp, add_trailing_bits);
-            } else {
-                uint8_t *rawdata;
-                int tile_size, last_tile;
-
-                for(j = 0; j < s->tile_num; j++) {
-                    end_pos = put_bits_count(&s->stream);
-                    tile_size = s->tileinfo[j].tile_raw_data_size[tile_group_index];
-                    last_tile = (j == (s->tile_num - 1));
-
-                    // Don't add the size info for the last tile
-                    if(!last_tile)
-                        netint_av1_write_le32(s->cbc, &s->stream, "tile_size_minus_1", tile_size - 1);
-
-                    data_pos = put_bits_count(&s->stream) / 8;
-                    flush_put_bits(&s->stream);
-
-                    if (tile_size > 0) {
-                        rawdata = s->tile_pkt[j]->data + s->tileinfo[j].tile_raw_data_pos[tile_group_index];
-
-                        memcpy(s->stream.buf + data_pos, rawdata, tile_size);
-                        skip_put_bytes(&s->stream, tile_size);
-
-                        av_log(ctx, AV_LOG_DEBUG, "### %s line %d %s: writing obu size plus raw data for tile %d last data %x %x\n",
-                                __FILE__, __LINE__, __func__, j, rawdata[tile_size-1], rawdata[tile_size]);
-                    }
-#ifdef PLOG
-                    av_log(ctx, AV_LOG_INFO, "### %s line %d %s: end_pos %d data_pos %d tile_size %d\n",
-                            __FILE__, __LINE__, __func__, end_pos, data_pos, tile_size);
-                    for(int k = 0; k < s->tileinfo[tile_idx].num_tile_group; k++)
-                    {
-                        av_log(ctx, AV_LOG_INFO, "raw_data_pos[%d] %d, raw_data_size[%d] %d", k, s->tileinfo[tile_idx].tile_raw_data_pos[k], k, s->tileinfo[tile_idx].tile_raw_data_size[k]);
-                    }
-#endif
-                }
-                tile_group_index++;
-                obu_size = netint_av1_update_obu_data_length(s->cbc, &s->stream, start_pos, obu, &pbc_tmp, add_trailing_bits);
-            }
-        }
-        for(i = 0; i < s->tile_num; i++)
-        {
-            av_buffer_unref(&s->tile_pkt[i]->buf);
-            s->tile_pkt[i]->buf = NULL;
+        if (unit->type == AV1_OBU_TILE_GROUP || unit->type == AV1_OBU_FRAME) {
+            data = av1_tile_repack_put_tile_group(ctx, unit, tg++, data);
+        } else {
+            memcpy(data, unit->data, unit->data_size);
+            data += unit->data_size;
         }
+    }
+    av_assert0(data - buf->data == new_size);
+    memset(data, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 
+    ret = av_packet_copy_props(out, s->tile_pkt[0]);
+    if (ret < 0) {
+        av_buffer_unref(&buf);
+        goto fail;
+    }
+
+    out->buf  = buf;
+    out->data = buf->data;
+    out->size = (int)new_size;
+
+end:
+    /* the tile index does not apply to the reassembled frame */
+    av_packet_side_data_remove(out->side_data, &out->side_data_elems,
+                               AV_PKT_DATA_SLICE_ADDR);
+    av_log(ctx, AV_LOG_DEBUG, "repacket new size %d\n", out->size);
+    ret = 0;
+
+fail:
+    for (i = 0; i < s->tile_num; i++)
+        av_packet_unref(s->tile_pkt[i]);
+    s->tile_pos = 0;
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-        ff_cbs_fragment_reset(td);
+    ff_cbs_fragment_reset(td);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-        ff_cbs_fragment_reset(s->cbc, td);
+    ff_cbs_fragment_reset(s->cbc_in, td);
 #else
-        ff_cbs_fragment_uninit(s->cbc, td);
+    ff_cbs_fragment_uninit(s->cbc_in, td);
 #endif
+    return ret;
+}
 
-        new_size = put_bits_count(&s->stream) / 8;
-        ret = av_new_packet(out, new_size);
-        if (ret < 0) {
-            return ret;
-        }
-
-        av_packet_copy_props(out, s->buffer_pkt);
+// called from tile_repack_bsf()
+static int av1_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
+    AV1RepackContext *s = ctx->priv_data;
+    int ret;
 
-        netint_av1_bitstream_fetch(&s->stream, out, new_size);
-        netint_av1_bitstream_reset(&s->stream);
+    while (s->tile_pos < s->tile_num) {
+        ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
+        if (ret < 0)
+            return ret;
 
-        s->tile_pos = 0;
-        goto end;
-    } else {
-        return AVERROR(EAGAIN);
+        ret = av1_tile_repack_add_tile(ctx, s->buffer_pkt);
+        av_packet_unref(s->buffer_pkt);
+        if (ret < 0)
+            return ret;
     }
 
-end:
-    return 0;
+    return av1_tile_repack_output_frame(ctx, out);
 }
 
 static const CodedBitstreamUnitType decompose_unit_types[] = {
@@ -464,8 +562,6 @@ static const CodedBitstreamUnitType decompose_unit_types[] = {
 
 static int av1_tile_repack_init(AVBSFContext *ctx) {
     AV1RepackContext *s = ctx->priv_data;
-    CodedBitstreamFragment *td = &s->temporal_unit;
-    void *pb_buf;
     int i, ret;
 
     av_log(ctx, AV_LOG_INFO, "number of tiles %d\n", s->tile_num);
@@ -478,115 +574,73 @@ static int av1_tile_repack_init(AVBSFContext *ctx) {
         return AVERROR(ENOMEM);
     }
 
-    s->tile_pkt = av_malloc(sizeof(AVPacket *) * s->tile_num);
+    s->tile_pkt = av_calloc(s->tile_num, sizeof(*s->tile_pkt));
     if (!s->tile_pkt) {
-        ret = AVERROR(ENOMEM);
-        goto fail_alloc_tile_pkt;
+        return AVERROR(ENOMEM);
     }
-    memset(s->tile_pkt, 0, sizeof(AVPacket *) * s->tile_num);
 
     for (i = 0; i < s->tile_num; i++) {
         s->tile_pkt[i] = av_packet_alloc();
         if (!s->tile_pkt[i]) {
-            ret = AVERROR(ENOMEM);
-            goto fail_alloc_pkts;
+            return AVERROR(ENOMEM);
         }
     }
 
-#if 1 // moved from rawtotile
-    s->buffer_pkt = av_packet_alloc();
-    if (!s->buffer_pkt)
-        return AVERROR(ENOMEM);
-
-    ret = ff_cbs_init(&s->cbc, AV_CODEC_ID_AV1, ctx);
+    ret = ff_cbs_init(&s->cbc_in, AV_CODEC_ID_AV1, ctx);
     if (ret < 0)
         return ret;
 
-    s->cbc->decompose_unit_types    = (CodedBitstreamUnitType*)decompose_unit_types;
-    s->cbc->nb_decompose_unit_types = FF_ARRAY_ELEMS(decompose_unit_types);
-
-#if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-    ff_cbs_fragment_reset(td);
-#elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, td);
-#else
-    ff_cbs_fragment_uninit(s->cbc, td);
-#endif
-
-    pb_buf = av_mallocz(MAX_PUT_BUF_SIZE);
-    if (!pb_buf) {
-        return AVERROR(ENOMEM);
-    }
-    init_put_bits(&s->stream, pb_buf, MAX_PUT_BUF_SIZE);
-#endif
-
-    return 0;
-
-fail_alloc_pkts:
-    for (i -= 1; i >= 0; i--) {
-        av_packet_free(&s->tile_pkt[i]);
-    }
-    free(s->tile_pkt);
-    s->tile_pkt = NULL;
-
-fail_alloc_tile_pkt:
-    av_packet_free(&s->buffer_pkt);
-    s->buffer_pkt = NULL;
+    s->cbc_in->decompose_unit_types    = (CodedBitstreamUnitType*)decompose_unit_types;
+    s->cbc_in->nb_decompose_unit_types = FF_ARRAY_ELEMS(decompose_unit_types);
 
-    return ret;
+    return ff_cbs_init(&s->cbc_out, AV_CODEC_ID_AV1, ctx);
 }
 
 static void av1_tile_repack_flush(AVBSFContext *ctx) {
     AV1RepackContext *s = ctx->priv_data;
     int i;
 
-#ifdef PLOG
-    av_log(ctx, AV_LOG_INFO, "### %s line %d %s: \n", __FILE__, __LINE__, __func__);
-#endif
-
     av_packet_unref(s->buffer_pkt);
 
     for (i = 0; i < s->tile_num; i++) {
         av_packet_unref(s->tile_pkt[i]);
     }
-
-    av_packet_unref(s->buffer_pkt);
+    s->tile_pos = 0;
 
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(&s->temporal_unit);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, &s->temporal_unit);
+    ff_cbs_fragment_reset(s->cbc_in, &s->temporal_unit);
 #else
-    ff_cbs_fragment_uninit(s->cbc, &s->temporal_unit);
+    ff_cbs_fragment_uninit(s->cbc_in, &s->temporal_unit);
 #endif
+    ff_cbs_flush(s->cbc_in);
+    ff_cbs_flush(s->cbc_out);
 }
 
 static void av1_tile_repack_close(AVBSFContext *ctx) {
     AV1RepackContext *s = ctx->priv_data;
     int i;
 
-#ifdef PLOG
-    av_log(ctx, AV_LOG_INFO, "### %s line %d %s: \n", __FILE__, __LINE__, __func__);
-#endif
-
     av_packet_free(&s->buffer_pkt);
-    s->buffer_pkt = NULL;
 
-    for (i = 0; i < s->tile_num; i++) {
+    for (i = 0; s->tile_pkt && i < s->tile_num; i++) {
         av_packet_free(&s->tile_pkt[i]);
     }
-    free(s->tile_pkt);
-    s->tile_pkt = NULL;
+    av_freep(&s->tile_pkt);
+
+    ff_ni_tile_repack_pool_uninit(&s->pool);
 
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
-    ff_cbs_fragment_reset(&s->temporal_unit);
+    ff_cbs_fragment_free(&s->temporal_unit);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
-    ff_cbs_fragment_reset(s->cbc, &s->temporal_unit);
+    ff_cbs_fragment_free(s->cbc_in, &s->temporal_unit);
 #else
-    ff_cbs_fragment_uninit(s->cbc, &s->temporal_unit);
+    ff_cbs_fragment_uninit(s->cbc_in, &s->temporal_unit);
 #endif
 
-    ff_cbs_close(&s->cbc);
+    ff_cbs_close(&s->cbc_in);
+    ff_cbs_close(&s->cbc_out);
 }
 
 static const enum AVCodecID av1_tile_repack_codec_ids[] = {
@@ -603,7 +657,7 @@ static const AVOption options[] = {
      AV_OPT_TYPE_INT,
      {.i64 = 0},
      0,
-     INT_MAX,
+     MAX_NUM_TILE_PER_FRAME,
      FLAGS},
     {NULL},
 };
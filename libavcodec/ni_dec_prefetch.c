@@ -0,0 +1,429 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+
+#include "config.h"
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/fifo.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "ni_dec_prefetch.h"
+
+/*
+ * libxcoder has no completion event for decoder reads and writes, so the
+ * threads poll the session; they back off while the device is busy.
+ */
+#define POLL_MIN_US 50
+#define POLL_MAX_US 800
+
+struct NIDecPrefetch {
+    const NIDecPrefetchOps *ops;
+    void *opaque;
+    void *log_ctx;
+    int depth;
+
+    AVFifo *packets;        ///< AVPacket *, the oldest one is being written
+    AVFifo *frames;         ///< AVFrame *, prepared by the harvest thread
+
+    AVMutex lock;           ///< queues and state below
+    AVMutex session_lock;   ///< held around the ops
+    AVCond send_cond;       ///< signalled to the submission thread
+    AVCond harvest_cond;    ///< signalled to the harvest thread
+    AVCond ready_cond;      ///< signalled to the caller
+    int quit;
+    int input_ended;
+    uint64_t nb_sent;       ///< packets written since the last flush
+    int status;             ///< error ending the output, 0 while running
+#if HAVE_THREADS
+    pthread_t send_thread;
+    pthread_t harvest_thread;
+    int running;
+#endif
+
+    uint64_t nb_packets;
+    uint64_t nb_frames;
+    uint64_t nb_send_busy;
+    uint64_t nb_read_busy;
+    uint64_t nb_waits;
+    int64_t  wait_us;
+    int ready_max;
+};
+
+#if HAVE_THREADS
+static void poll_wait(NIDecPrefetch *p, int *poll_us)
+{
+    ff_mutex_unlock(&p->lock);
+    av_usleep(*poll_us);
+    ff_mutex_lock(&p->lock);
+    *poll_us = FFMIN(*poll_us * 2, POLL_MAX_US);
+}
+
+static void *send_thread(void *arg)
+{
+    NIDecPrefetch *p = arg;
+    int poll_us = POLL_MIN_US;
+    AVPacket *pkt;
+    int ret;
+
+    ff_mutex_lock(&p->lock);
+    while (!p->quit) {
+        if (p->status || av_fifo_peek(p->packets, &pkt, 1, 0) < 0) {
+            ff_cond_wait(&p->send_cond, &p->lock);
+            continue;
+        }
+
+        /* the caller only appends, pkt stays at the head */
+        ff_mutex_unlock(&p->lock);
+        ff_mutex_lock(&p->session_lock);
+        ret = p->ops->send(p->opaque, pkt);
+        ff_mutex_unlock(&p->session_lock);
+        ff_mutex_lock(&p->lock);
+
+        if (ret == AVERROR(EAGAIN)) {
+            p->nb_send_busy++;
+            poll_wait(p, &poll_us);
+            continue;
+        }
+        poll_us = POLL_MIN_US;
+
+        av_fifo_drain2(p->packets, 1);
+        av_packet_free(&pkt);
+        if (ret < 0 && !p->status)
+            p->status = ret;
+        p->nb_sent++;
+        ff_cond_signal(&p->harvest_cond);
+        ff_cond_signal(&p->ready_cond);
+    }
+    ff_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+static void *harvest_thread(void *arg)
+{
+    NIDecPrefetch *p = arg;
+    int poll_us = POLL_MIN_US;
+    AVFrame *frame = NULL;
+    int ret;
+
+    ff_mutex_lock(&p->lock);
+    while (!p->quit) {
+        int nb_ready;
+
+        if (p->status || !p->nb_sent || !av_fifo_can_write(p->frames)) {
+            ff_cond_wait(&p->harvest_cond, &p->lock);
+            continue;
+        }
+
+        ff_mutex_unlock(&p->lock);
+        if (!frame)
+            frame = av_frame_alloc();
+        if (frame) {
+            ff_mutex_lock(&p->session_lock);
+            ret = p->ops->receive(p->opaque, frame);
+            ff_mutex_unlock(&p->session_lock);
+        } else {
+            ret = AVERROR(ENOMEM);
+        }
+        ff_mutex_lock(&p->lock);
+
+        if (ret == AVERROR(EAGAIN)) {
+            av_frame_unref(frame);
+            p->nb_read_busy++;
+            poll_wait(p, &poll_us);
+            continue;
+        }
+        poll_us = POLL_MIN_US;
+
+        if (ret < 0) {
+            av_frame_free(&frame);
+            if (!p->status)
+                p->status = ret;
+        } else {
+            av_fifo_write(p->frames, &frame, 1);
+            frame        = NULL;
+            nb_ready     = av_fifo_can_read(p->frames);
+            p->ready_max = FFMAX(p->ready_max, nb_ready);
+            p->nb_frames++;
+        }
+        ff_cond_signal(&p->ready_cond);
+    }
+    ff_mutex_unlock(&p->lock);
+    av_frame_free(&frame);
+
+    return NULL;
+}
+
+static int start_threads(NIDecPrefetch *p)
+{
+    int ret;
+
+    if (p->running)
+        return 0;
+
+    if ((ret = pthread_create(&p->send_thread, NULL, send_thread, p)))
+        return AVERROR(ret);
+    if ((ret = pthread_create(&p->harvest_thread, NULL, harvest_thread, p))) {
+        p->quit = 1;
+        ff_cond_signal(&p->send_cond);
+        ff_mutex_unlock(&p->lock);
+        pthread_join(p->send_thread, NULL);
+        ff_mutex_lock(&p->lock);
+        p->quit = 0;
+        return AVERROR(ret);
+    }
+    p->running = 1;
+
+    return 0;
+}
+
+static void stop_threads(NIDecPrefetch *p)
+{
+    ff_mutex_lock(&p->lock);
+    if (!p->running) {
+        ff_mutex_unlock(&p->lock);
+        return;
+    }
+    p->quit = 1;
+    ff_cond_signal(&p->send_cond);
+    ff_cond_signal(&p->harvest_cond);
+    ff_mutex_unlock(&p->lock);
+
+    pthread_join(p->send_thread, NULL);
+    pthread_join(p->harvest_thread, NULL);
+    p->running = 0;
+    p->quit    = 0;
+}
+#endif
+
+int ff_ni_dec_prefetch_alloc(NIDecPrefetch **prefetch, const NIDecPrefetchOps *ops,
+                             void *opaque, void *log_ctx, int depth)
+{
+    NIDecPrefetch *p;
+    int ret;
+
+#if !HAVE_THREADS
+    return AVERROR(ENOSYS);
+#endif
+    if (depth < 1 || depth > NI_DEC_PREFETCH_MAX)
+        return AVERROR(EINVAL);
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    p->ops     = ops;
+    p->opaque  = opaque;
+    p->log_ctx = log_ctx;
+    p->depth   = depth;
+
+    p->packets = av_fifo_alloc2(depth, sizeof(AVPacket *), 0);
+    p->frames  = av_fifo_alloc2(depth, sizeof(AVFrame *), 0);
+    if (!p->packets || !p->frames) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = ff_mutex_init(&p->lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = ff_mutex_init(&p->session_lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail_lock;
+    }
+    if ((ret = ff_cond_init(&p->send_cond, NULL))) {
+        ret = AVERROR(ret);
+        goto fail_session_lock;
+    }
+    if ((ret = ff_cond_init(&p->harvest_cond, NULL))) {
+        ret = AVERROR(ret);
+        goto fail_send_cond;
+    }
+    if ((ret = ff_cond_init(&p->ready_cond, NULL))) {
+        ret = AVERROR(ret);
+        goto fail_harvest_cond;
+    }
+
+    *prefetch = p;
+    return 0;
+
+fail_harvest_cond:
+    ff_cond_destroy(&p->harvest_cond);
+fail_send_cond:
+    ff_cond_destroy(&p->send_cond);
+fail_session_lock:
+    ff_mutex_destroy(&p->session_lock);
+fail_lock:
+    ff_mutex_destroy(&p->lock);
+fail:
+    av_fifo_freep2(&p->packets);
+    av_fifo_freep2(&p->frames);
+    av_free(p);
+    return ret;
+}
+
+static void drop_queued(NIDecPrefetch *p)
+{
+    AVPacket *pkt;
+    AVFrame *frame;
+
+    while (av_fifo_read(p->packets, &pkt, 1) >= 0)
+        av_packet_free(&pkt);
+    while (av_fifo_read(p->frames, &frame, 1) >= 0)
+        av_frame_free(&frame);
+}
+
+void ff_ni_dec_prefetch_free(NIDecPrefetch **prefetch)
+{
+    NIDecPrefetch *p = *prefetch;
+
+    if (!p)
+        return;
+
+#if HAVE_THREADS
+    stop_threads(p);
+#endif
+    drop_queued(p);
+    av_fifo_freep2(&p->packets);
+    av_fifo_freep2(&p->frames);
+
+    ff_cond_destroy(&p->ready_cond);
+    ff_cond_destroy(&p->harvest_cond);
+    ff_cond_destroy(&p->send_cond);
+    ff_mutex_destroy(&p->session_lock);
+    ff_mutex_destroy(&p->lock);
+    av_freep(prefetch);
+}
+
+int ff_ni_dec_prefetch_submit(NIDecPrefetch *p, AVPacket *pkt)
+{
+    AVPacket *queued;
+    int ret = 0;
+
+    ff_mutex_lock(&p->lock);
+    if (p->input_ended) {
+        if (pkt)
+            av_packet_unref(pkt);
+        goto end;
+    }
+    if (!av_fifo_can_write(p->packets)) {
+        ret = AVERROR(EAGAIN);
+        goto end;
+    }
+
+    queued = av_packet_alloc();
+    if (!queued) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if (pkt)
+        av_packet_move_ref(queued, pkt);
+
+#if HAVE_THREADS
+    ret = start_threads(p);
+#endif
+    if (ret < 0) {
+        av_packet_free(&queued);
+        goto end;
+    }
+
+    av_fifo_write(p->packets, &queued, 1);
+    if (!queued->size)
+        p->input_ended = 1;
+    p->nb_packets++;
+    ff_cond_signal(&p->send_cond);
+
+end:
+    ff_mutex_unlock(&p->lock);
+    return ret;
+}
+
+int ff_ni_dec_prefetch_receive(NIDecPrefetch *p, AVFrame *frame, int block)
+{
+    AVFrame *ready;
+    int64_t wait_start = 0;
+    int ret;
+
+    ff_mutex_lock(&p->lock);
+    for (;;) {
+        if (av_fifo_read(p->frames, &ready, 1) >= 0) {
+            av_frame_move_ref(frame, ready);
+            av_frame_free(&ready);
+            ff_cond_signal(&p->harvest_cond);
+            ret = 0;
+            break;
+        }
+        if (p->status) {
+            ret = p->status;
+            break;
+        }
+        if (!block || (!p->input_ended && av_fifo_can_write(p->packets))) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+#if HAVE_THREADS
+        if (!p->running) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+#endif
+
+        if (!wait_start) {
+            wait_start = av_gettime_relative();
+            p->nb_waits++;
+        }
+        ff_cond_wait(&p->ready_cond, &p->lock);
+    }
+    if (wait_start)
+        p->wait_us += av_gettime_relative() - wait_start;
+    ff_mutex_unlock(&p->lock);
+
+    return ret;
+}
+
+void ff_ni_dec_prefetch_flush(NIDecPrefetch *p)
+{
+#if HAVE_THREADS
+    stop_threads(p);
+#endif
+    drop_queued(p);
+    p->input_ended = 0;
+    p->nb_sent     = 0;
+    p->status      = 0;
+}
+
+void ff_ni_dec_prefetch_report(const NIDecPrefetch *p)
+{
+    if (!p->nb_packets)
+        return;
+
+    av_log(p->log_ctx, AV_LOG_VERBOSE,
+           "prefetch: %" PRIu64 " packets, %" PRIu64 " frames, %d of %d ready "
+           "at most, %" PRIu64 " waits %.1f us average, device busy on "
+           "%" PRIu64 " writes and %" PRIu64 " reads\n",
+           p->nb_packets, p->nb_frames, p->ready_max, p->depth, p->nb_waits,
+           p->nb_waits ? (double)p->wait_us / p->nb_waits : 0.0,
+           p->nb_send_busy, p->nb_read_busy);
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_NI_DEC_PREFETCH_H
+#define AVCODEC_NI_DEC_PREFETCH_H
+
+#include <stdint.h>
+
+#include "libavutil/frame.h"
+
+#include "packet.h"
+
+/* most packets or frames queued in either direction */
+#define NI_DEC_PREFETCH_MAX 16
+
+/**
+ * Session callbacks, never entered by two threads at once.
+ */
+typedef struct NIDecPrefetchOps {
+    /**
+     * Write pkt to the device, an empty packet starts draining.
+     *
+     * @return >= 0 once pkt is consumed, AVERROR(EAGAIN) if the device cannot
+     *         take it yet
+     */
+    int (*send)(void *opaque, AVPacket *pkt);
+
+    /**
+     * Read the next decoded picture into frame, side data included.
+     *
+     * @return 0 on success, AVERROR(EAGAIN) if no picture is ready,
+     *         AVERROR_EOF at the end of the stream
+     */
+    int (*receive)(void *opaque, AVFrame *frame);
+} NIDecPrefetchOps;
+
+/**
+ * Decoder output prefetch: one thread writes the packets queued by the
+ * caller, another reads the pictures and builds their AVFrames ahead of
+ * the caller, which then only moves prepared frames out of a ready queue.
+ *
+ * The threads start with the first packet and are stopped by a flush.
+ */
+typedef struct NIDecPrefetch NIDecPrefetch;
+
+/**
+ * @param depth  capacity of the packet queue and of the ready queue
+ */
+int ff_ni_dec_prefetch_alloc(NIDecPrefetch **prefetch, const NIDecPrefetchOps *ops,
+                             void *opaque, void *log_ctx, int depth);
+
+/** Stop the threads and free the queued packets and frames. */
+void ff_ni_dec_prefetch_free(NIDecPrefetch **prefetch);
+
+/**
+ * Queue pkt for the submission thread, taking its references. An empty
+ * packet ends the input, later ones are ignored until the next flush.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the packet queue is full
+ */
+int ff_ni_dec_prefetch_submit(NIDecPrefetch *p, AVPacket *pkt);
+
+/**
+ * Move the oldest prepared frame to frame.
+ *
+ * @param block  if set, wait until a frame is ready, the stream ended or
+ *               failed, or the packet queue can take another packet
+ * @return 0 on success, AVERROR(EAGAIN) if no frame is ready, otherwise the
+ *         error (AVERROR_EOF at the end) once all the frames before it
+ *         were returned
+ */
+int ff_ni_dec_prefetch_receive(NIDecPrefetch *p, AVFrame *frame, int block);
+
+/**
+ * Stop the threads and drop everything queued, so that the session can be
+ * flushed or reset by the caller. The threads restart with the next packet.
+ */
+void ff_ni_dec_prefetch_flush(NIDecPrefetch *p);
+
+/** Log the queue statistics at verbose level. */
+void ff_ni_dec_prefetch_report(const NIDecPrefetch *p);
+
+#endif /* AVCODEC_NI_DEC_PREFETCH_H */
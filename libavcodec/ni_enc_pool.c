@@ -0,0 +1,150 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+
+#include "defs.h"
+#include "ni_enc_pool.h"
+
+/* log2 of the buffer size in pkt_pool[0] */
+#define PKT_POOL_MIN_SHIFT 12
+
+AVBufferRef *ff_ni_enc_custom_sei(NIEncPools *pools, enum AVCodecID codec_id,
+                                  const ni_custom_sei_set_t *src, void *log_ctx)
+{
+    ni_custom_sei_set_t *dst;
+    AVBufferRef *buf;
+    int i, j;
+
+    if (!pools->sei_pool) {
+        pools->sei_pool = av_buffer_pool_init(sizeof(ni_custom_sei_set_t), NULL);
+        if (!pools->sei_pool)
+            return NULL;
+    }
+    buf = av_buffer_pool_get(pools->sei_pool);
+    if (!buf)
+        return NULL;
+    dst = (ni_custom_sei_set_t *)buf->data;
+
+    // only the used part of every entry is written, the set is too large
+    // to be cleared for each frame
+    for (i = 0; i < src->count; i++) {
+        const ni_custom_sei_t *p_src = &src->custom_sei[i];
+        const uint8_t *p_src_data = p_src->data;
+        ni_custom_sei_t *p_dst = &dst->custom_sei[i];
+        uint8_t *p_dst_data = p_dst->data;
+        int sei_size = p_src->size;
+        int size = 0;
+        int len;
+
+        // long start code
+        p_dst_data[size++] = 0x00;
+        p_dst_data[size++] = 0x00;
+        p_dst_data[size++] = 0x00;
+        p_dst_data[size++] = 0x01;
+
+        if (AV_CODEC_ID_H264 == codec_id) {
+            p_dst_data[size++] = 0x06;   //nal type: SEI
+        } else {
+            p_dst_data[size++] = 0x4e;   //nal type: SEI
+            p_dst_data[size++] = 0x01;
+        }
+
+        // SEI type
+        p_dst_data[size++] = p_src->type;
+
+        // original payload size
+        len = sei_size;
+        while (len >= 0) {
+            p_dst_data[size++] = len > 0xff ? 0xff : len;
+            len -= 0xff;
+        }
+
+        // payload data
+        for (j = 0; j < sei_size && size < NI_MAX_CUSTOM_SEI_DATA - 1; j++) {
+            if (j >= 2 && !p_dst_data[size - 2] && !p_dst_data[size - 1] && p_src_data[j] <= 0x03) {
+                /* insert 0x3 as emulation_prevention_three_byte */
+                p_dst_data[size++] = 0x03;
+            }
+            p_dst_data[size++] = p_src_data[j];
+        }
+
+        if (j != sei_size) {
+            av_log(log_ctx, AV_LOG_WARNING, "%s: sei RBSP size out of limit(%d), "
+                   "idx=%d, type=%u, size=%d, custom_sei_loc=%d.\n", __func__,
+                   NI_MAX_CUSTOM_SEI_DATA, i, p_src->type, sei_size, p_src->location);
+            break;
+        }
+
+        // trailing byte
+        p_dst_data[size++] = 0x80;
+
+        p_dst->size     = size;
+        p_dst->type     = p_src->type;
+        p_dst->location = p_src->location;
+        av_log(log_ctx, AV_LOG_TRACE, "%s: custom sei idx %d type %u len %d loc %d.\n",
+               __func__, i, p_src->type, size, p_dst->location);
+    }
+    // the SEIs before the one out of limit are still inserted
+    dst->count = i;
+
+    return buf;
+}
+
+int ff_ni_enc_get_packet(NIEncPools *pools, AVPacket *pkt, int size)
+{
+    AVBufferRef *buf;
+    int idx;
+
+    if (size < 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(EINVAL);
+
+    idx = av_log2(size + AV_INPUT_BUFFER_PADDING_SIZE - 1) + 1 - PKT_POOL_MIN_SHIFT;
+    idx = FFMAX(idx, 0);
+    if (idx < FF_ARRAY_ELEMS(pools->pkt_pool)) {
+        if (!pools->pkt_pool[idx]) {
+            pools->pkt_pool[idx] = av_buffer_pool_init(1 << (idx + PKT_POOL_MIN_SHIFT), NULL);
+            if (!pools->pkt_pool[idx])
+                return AVERROR(ENOMEM);
+        }
+        buf = av_buffer_pool_get(pools->pkt_pool[idx]);
+    } else {
+        // too large to be worth keeping around
+        buf = av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    }
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    memset(pkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    return 0;
+}
+
+void ff_ni_enc_pools_uninit(NIEncPools *pools)
+{
+    av_buffer_pool_uninit(&pools->sei_pool);
+    for (int i = 0; i < FF_ARRAY_ELEMS(pools->pkt_pool); i++)
+        av_buffer_pool_uninit(&pools->pkt_pool[i]);
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_NI_ENC_POOL_H
+#define AVCODEC_NI_ENC_POOL_H
+
+#include <ni_device_api.h>
+
+#include "libavutil/buffer.h"
+
+#include "codec_id.h"
+#include "packet.h"
+
+/**
+ * Buffers the encoder needs for every frame or packet: the custom SEI NAL
+ * units waiting for the packet of their frame, and the output packets.
+ */
+typedef struct NIEncPools {
+    AVBufferPool *sei_pool;
+    /* output packets, pkt_pool[i] holds buffers of 4 KiB << i */
+    AVBufferPool *pkt_pool[19];
+} NIEncPools;
+
+/**
+ * Turn the custom SEI payloads of a frame into NAL units, in a buffer
+ * holding a ni_custom_sei_set_t.
+ *
+ * @return the buffer, NULL on allocation failure
+ */
+AVBufferRef *ff_ni_enc_custom_sei(NIEncPools *pools, enum AVCodecID codec_id,
+                                  const ni_custom_sei_set_t *src, void *log_ctx);
+
+/**
+ * Allocate a padded packet of size bytes. Packets come from the pool of the
+ * smallest power of two size they fit in, so that P frames do not hold
+ * buffers sized for the largest I frame.
+ */
+int ff_ni_enc_get_packet(NIEncPools *pools, AVPacket *pkt, int size);
+
+void ff_ni_enc_pools_uninit(NIEncPools *pools);
+
+#endif /* AVCODEC_NI_ENC_POOL_H */
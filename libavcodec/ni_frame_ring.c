@@ -0,0 +1,125 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "ni_frame_ring.h"
+
+int ff_ni_frame_ring_init(NIFrameRing *ring, int size)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    if (size < 1)
+        return AVERROR(EINVAL);
+
+    ring->frames    = av_calloc(size, sizeof(*ring->frames));
+    ring->push_time = av_calloc(size, sizeof(*ring->push_time));
+    if (!ring->frames || !ring->push_time)
+        goto fail;
+    ring->size = size;
+
+    for (int i = 0; i < size; i++) {
+        ring->frames[i] = av_frame_alloc();
+        if (!ring->frames[i])
+            goto fail;
+    }
+
+    return 0;
+fail:
+    ff_ni_frame_ring_uninit(ring);
+    return AVERROR(ENOMEM);
+}
+
+void ff_ni_frame_ring_uninit(NIFrameRing *ring)
+{
+    if (ring->frames) {
+        for (int i = 0; i < ring->size; i++)
+            av_frame_free(&ring->frames[i]);
+    }
+    av_freep(&ring->frames);
+    av_freep(&ring->push_time);
+    ring->size = ring->head = ring->nb_frames = 0;
+}
+
+int ff_ni_frame_ring_push(NIFrameRing *ring, AVFrame *frame, int move)
+{
+    int idx, ret;
+
+    if (ff_ni_frame_ring_full(ring)) {
+        ring->nb_full++;
+        return AVERROR(EAGAIN);
+    }
+
+    idx = (ring->head + ring->nb_frames) % ring->size;
+    if (move) {
+        av_frame_move_ref(ring->frames[idx], frame);
+    } else {
+        ret = av_frame_ref(ring->frames[idx], frame);
+        if (ret < 0)
+            return ret;
+    }
+    ring->push_time[idx] = av_gettime_relative();
+
+    ring->nb_frames++;
+    ring->nb_pushed++;
+    ring->nb_frames_max = FFMAX(ring->nb_frames_max, ring->nb_frames);
+
+    return 0;
+}
+
+AVFrame *ff_ni_frame_ring_peek(const NIFrameRing *ring)
+{
+    return ring->nb_frames ? ring->frames[ring->head] : NULL;
+}
+
+void ff_ni_frame_ring_drop(NIFrameRing *ring)
+{
+    int64_t wait;
+
+    if (!ring->nb_frames)
+        return;
+
+    wait = av_gettime_relative() - ring->push_time[ring->head];
+    ring->wait_us    += wait;
+    ring->wait_max_us = FFMAX(ring->wait_max_us, wait);
+
+    av_frame_unref(ring->frames[ring->head]);
+    ring->head = (ring->head + 1) % ring->size;
+    ring->nb_frames--;
+}
+
+void ff_ni_frame_ring_report(const NIFrameRing *ring, void *log_ctx)
+{
+    int64_t nb_done = ring->nb_pushed - ring->nb_frames;
+
+    if (!ring->nb_pushed && !ring->nb_full)
+        return;
+
+    av_log(log_ctx, AV_LOG_VERBOSE,
+           "input queue: %" PRId64 " frames queued, %d max of %d, "
+           "wait %.1f us average, %" PRId64 " us max, full %" PRId64 " times\n",
+           ring->nb_pushed, ring->nb_frames_max, ring->size,
+           nb_done > 0 ? (double)ring->wait_us / nb_done : 0.0,
+           ring->wait_max_us, ring->nb_full);
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_NI_FRAME_RING_H
+#define AVCODEC_NI_FRAME_RING_H
+
+#include <stdint.h>
+
+#include "libavutil/frame.h"
+
+/**
+ * Fixed size queue of frame references holding the input the encoder could
+ * not send yet (device write buffer full, sequence change draining). All
+ * slots are allocated upfront; a push on a full ring fails with EAGAIN so
+ * that the caller can apply backpressure instead of growing the queue.
+ *
+ * The statistics are plain fields so that the encoder can export them as
+ * read-only AVOptions.
+ */
+typedef struct NIFrameRing {
+    AVFrame **frames;
+    int64_t *push_time;
+    int size;
+    int head;
+    int nb_frames;          ///< frames currently queued
+
+    int     nb_frames_max;  ///< highest number of frames queued at once
+    int64_t nb_pushed;
+    int64_t nb_full;        ///< times input was refused because the ring was full
+    int64_t wait_us;        ///< total time the dropped/sent frames were queued
+    int64_t wait_max_us;
+} NIFrameRing;
+
+int ff_ni_frame_ring_init(NIFrameRing *ring, int size);
+
+/** Unreference the queued frames and free the ring. */
+void ff_ni_frame_ring_uninit(NIFrameRing *ring);
+
+/**
+ * Queue a reference to frame, or take its references if move is set (frame
+ * is reset then).
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the ring is full
+ */
+int ff_ni_frame_ring_push(NIFrameRing *ring, AVFrame *frame, int move);
+
+/** @return the oldest queued frame, NULL if the ring is empty */
+AVFrame *ff_ni_frame_ring_peek(const NIFrameRing *ring);
+
+/** Unreference the oldest queued frame and remove it. */
+void ff_ni_frame_ring_drop(NIFrameRing *ring);
+
+static inline int ff_ni_frame_ring_full(const NIFrameRing *ring)
+{
+    return ring->nb_frames >= ring->size;
+}
+
+/** Log the queue statistics at verbose level. */
+void ff_ni_frame_ring_report(const NIFrameRing *ring, void *log_ctx);
+
+#endif /* AVCODEC_NI_FRAME_RING_H */
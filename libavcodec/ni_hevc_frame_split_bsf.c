@@ -25,11 +25,20 @@
  * This bitstream filter splits HEVC stream into packets containing just one
  * frame and re-encoding them with tile flags so that the splited packets can
  * be decoded independently.
+ *
+ * Rewritten parameter sets are cached and only re-encoded when the input
+ * parameter sets change. The slices of an access unit are rewritten by one
+ * job per tile, which run on a worker pool; the output packets are still
+ * delivered in slice order.
  */
 
 #include "version.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
+#include "libavutil/executor.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
 
 #include "avcodec.h"
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 91)
@@ -60,7 +69,32 @@ struct tile_format {
     int *row_idx;
 };
 
+/* cached rewrite of one parameter set for all tiles */
+typedef struct HEVCFSplitParamSet {
+    uint8_t *key;              ///< input NAL unit the rewrite was made from
+    unsigned int key_alloc;
+    size_t key_size;
+    int hid;                   ///< PPS an SPS was rewritten for, -1 otherwise
+    uint8_t *data;             ///< rewritten NAL units of all tiles
+    unsigned int data_alloc;
+    int *offset;               ///< num_tiles + 1 offsets into data
+} HEVCFSplitParamSet;
+
+typedef struct HEVCFSplitSlice {
+    int unit;                  ///< index in the temporal unit
+    int tile_idx;
+    AVPacket *pkt;             ///< rewritten slice, with pending parameter sets
+} HEVCFSplitSlice;
+
+typedef struct HEVCFSplitJob {
+    AVTask task;
+    AVBSFContext *ctx;
+    int tile_idx;
+    int ret;
+} HEVCFSplitJob;
+
 typedef struct HEVCFSplitContext {
+    const AVClass *class;
     AVPacket *buffer_pkt;
     CodedBitstreamContext *cbc;
     CodedBitstreamFragment temporal_unit;
@@ -69,10 +103,26 @@ typedef struct HEVCFSplitContext {
     struct tile_format **this_tile;
     ni_bitstream_t *streams;
 
+    HEVCFSplitParamSet vps_cache[HEVC_MAX_VPS_COUNT];
+    HEVCFSplitParamSet sps_cache[HEVC_MAX_SPS_COUNT];
+    HEVCFSplitParamSet pps_cache[HEVC_MAX_PPS_COUNT];
+
+    /* slices of the current temporal unit, output in this order */
+    HEVCFSplitSlice *slices;
+    unsigned int slices_alloc;
+    int nb_slices;
+    int next_slice;
+
+    AVExecutor *executor;
+    HEVCFSplitJob *jobs;
+    AVMutex lock;
+    AVCond cond;
+    int lock_init;
+    int jobs_pending;
+
     int tile_enabled;
     int num_tiles;
-    int unit_offset;
-    int nb_slices;
+    int threads;
 } HEVCFSplitContext;
 
 static int slice_addr_to_idx(HEVCFSplitContext *s, int slice_addr, int hid) {
@@ -318,19 +368,6 @@ static int hevc_frame_encode_vps(HEVCFSplitContext *s, AVBSFContext *ctx,
     return 0;
 }
 
-static int hevc_frame_tiles_encode_vps(HEVCFSplitContext *s, AVBSFContext *ctx,
-                                       CodedBitstreamUnit *unit) {
-    int i, ret = 0;
-
-    for (i = 0; i < s->num_tiles; i++) {
-        ret = hevc_frame_encode_vps(s, ctx, unit, i);
-        if (ret)
-            break;
-    }
-
-    return ret;
-}
-
 static int hevc_frame_encode_sps(HEVCFSplitContext *s, AVBSFContext *ctx,
                                  CodedBitstreamUnit *unit, int tile_idx,
                                  int hid) {
@@ -354,19 +391,6 @@ static int hevc_frame_encode_sps(HEVCFSplitContext *s, AVBSFContext *ctx,
     return 0;
 }
 
-static int hevc_frame_tiles_encode_sps(HEVCFSplitContext *s, AVBSFContext *ctx,
-                                       CodedBitstreamUnit *unit, int hid) {
-    int i, ret = 0;
-
-    for (i = 0; i < s->num_tiles; i++) {
-        ret = hevc_frame_encode_sps(s, ctx, unit, i, hid);
-        if (ret)
-            break;
-    }
-
-    return ret;
-}
-
 static int hevc_frame_encode_pps(HEVCFSplitContext *s, AVBSFContext *ctx,
                                  CodedBitstreamUnit *unit, int tile_idx) {
     ni_bitstream_t *stream = &s->streams[tile_idx];
@@ -383,17 +407,91 @@ static int hevc_frame_encode_pps(HEVCFSplitContext *s, AVBSFContext *ctx,
     return ret;
 }
 
-static int hevc_frame_tiles_encode_pps(HEVCFSplitContext *s, AVBSFContext *ctx,
-                                       CodedBitstreamUnit *unit) {
-    int i, ret = 0;
+static HEVCFSplitParamSet *hevc_frame_ps_cache(HEVCFSplitContext *s,
+                                               const CodedBitstreamUnit *unit) {
+    switch (unit->type) {
+    case HEVC_NAL_VPS:
+        return &s->vps_cache[((H265RawVPS *)unit->content)
+                                 ->vps_video_parameter_set_id];
+    case HEVC_NAL_SPS:
+        return &s->sps_cache[((H265RawSPS *)unit->content)
+                                 ->sps_seq_parameter_set_id];
+    default:
+        return &s->pps_cache[((H265RawPPS *)unit->content)
+                                 ->pps_pic_parameter_set_id];
+    }
+}
+
+/*
+ * Re-encode a VPS, SPS or PPS for every tile, unless the same parameter set
+ * was already rewritten, in which case the cached NAL units are appended to
+ * the tile streams as they are. hid is the PPS whose tile layout an SPS is
+ * rewritten for.
+ */
+static int hevc_frame_tiles_encode_ps(HEVCFSplitContext *s, AVBSFContext *ctx,
+                                      CodedBitstreamUnit *unit, int hid) {
+    HEVCFSplitParamSet *ps = hevc_frame_ps_cache(s, unit);
+    uint8_t *data;
+    size_t size = 0;
+    int i, ret, start;
+
+    if (ps->key_size && ps->key_size == unit->data_size && ps->hid == hid &&
+        !memcmp(ps->key, unit->data, unit->data_size)) {
+        for (i = 0; i < s->num_tiles; i++) {
+            ni_bitstream_write_raw(&s->streams[i], ps->data + ps->offset[i],
+                                   ps->offset[i + 1] - ps->offset[i]);
+        }
+        return 0;
+    }
+
+    av_log(ctx, AV_LOG_DEBUG, "rewriting parameter set, nal type %d\n",
+           unit->type);
+
+    ps->key_size = 0;
+    if (!ps->offset) {
+        ps->offset = av_calloc(s->num_tiles + 1, sizeof(*ps->offset));
+        if (!ps->offset) {
+            return AVERROR(ENOMEM);
+        }
+    }
 
     for (i = 0; i < s->num_tiles; i++) {
-        ret = hevc_frame_encode_pps(s, ctx, unit, i);
-        if (ret)
-            break;
+        ni_bitstream_t *stream = &s->streams[i];
+
+        start = ni_bitstream_count(stream) / 8;
+        if (unit->type == HEVC_NAL_VPS) {
+            ret = hevc_frame_encode_vps(s, ctx, unit, i);
+        } else if (unit->type == HEVC_NAL_SPS) {
+            ret = hevc_frame_encode_sps(s, ctx, unit, i, hid);
+        } else {
+            ret = hevc_frame_encode_pps(s, ctx, unit, i);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+
+        ps->offset[i] = size;
+        size += ni_bitstream_count(stream) / 8 - start;
+        data = av_fast_realloc(ps->data, &ps->data_alloc, size);
+        if (!data) {
+            return AVERROR(ENOMEM);
+        }
+        ps->data = data;
+        memcpy(ps->data + ps->offset[i], stream->pb_buf + start,
+               size - ps->offset[i]);
     }
+    ps->offset[s->num_tiles] = size;
 
-    return ret;
+    data = av_fast_realloc(ps->key, &ps->key_alloc, unit->data_size);
+    if (!data) {
+        return AVERROR(ENOMEM);
+    }
+    ps->key = data;
+    memcpy(ps->key, unit->data, unit->data_size);
+    ps->key_size = unit->data_size;
+    ps->hid      = hid;
+
+    return 0;
 }
 
 static int hevc_frame_encode_slice_header(HEVCFSplitContext *s,
@@ -405,7 +503,7 @@ static int hevc_frame_encode_slice_header(HEVCFSplitContext *s,
     CodedBitstreamH265Context *priv = s->cbc->priv_data;
     H265RawPPS *pps                 = priv->pps[hid];
     H265RawSPS *sps                 = priv->sps[pps->pps_seq_parameter_set_id];
-    int i, ret;
+    int ret;
 
     ni_write_nal_header(stream, slice->header.nal_unit_header.nal_unit_type, 0,
                         1);
@@ -421,24 +519,7 @@ static int hevc_frame_encode_slice_header(HEVCFSplitContext *s,
 
     av_assert0((slice->data_bit_start % 8) == 0);
 
-    for (i = 0; i < slice->data_size; i++) {
-        ni_put_bits(stream, 8, slice->data[i]);
-    }
-
-    return 0;
-}
-
-static int hevc_frame_init_bitstream(HEVCFSplitContext *s) {
-    int i;
-
-    s->streams = av_mallocz(s->num_tiles * sizeof(ni_bitstream_t));
-    if (!s->streams) {
-        return AVERROR(ENOMEM);
-    }
-
-    for (i = 0; i < s->num_tiles; i++) {
-        ni_bitstream_init(&s->streams[i]);
-    }
+    ni_put_bytes(stream, slice->data, slice->data_size);
 
     return 0;
 }
@@ -475,22 +556,185 @@ static int hevc_frame_parse_tiles(HEVCFSplitContext *s, AVBSFContext *ctx,
     return 0;
 }
 
+/* Rewrite all slices of one tile in the current temporal unit. */
+static int hevc_frame_split_tile(AVBSFContext *ctx, int tile_idx) {
+    HEVCFSplitContext *s       = ctx->priv_data;
+    CodedBitstreamFragment *td = &s->temporal_unit;
+    ni_bitstream_t *stream     = &s->streams[tile_idx];
+    int i, ret, new_size, *slice_addr;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        HEVCFSplitSlice *sl      = &s->slices[i];
+        CodedBitstreamUnit *unit = &td->units[sl->unit];
+        H265RawSlice *slice      = unit->content;
+
+        if (sl->tile_idx != tile_idx)
+            continue;
+
+        ret = hevc_frame_encode_slice_header(
+            s, ctx, unit, tile_idx, slice->header.slice_pic_parameter_set_id);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "failed to re-encode slice header\n");
+            return ret;
+        }
+
+        new_size = (int)(ni_bitstream_count(stream) / 8);
+        ret      = av_new_packet(sl->pkt, new_size);
+        if (ret < 0) {
+            return ret;
+        }
+
+        ret = av_packet_copy_props(sl->pkt, s->buffer_pkt);
+        if (ret < 0) {
+            return ret;
+        }
+
+        slice_addr = (int *)av_packet_new_side_data(
+            sl->pkt, AV_PKT_DATA_SLICE_ADDR, sizeof(*slice_addr));
+        if (!slice_addr) {
+            return AVERROR(ENOMEM);
+        }
+        *slice_addr = tile_idx;
+
+        ni_bitstream_fetch(stream, sl->pkt->data, new_size);
+        ni_bitstream_reset(stream);
+    }
+
+    return 0;
+}
+
+static int hevc_frame_job_priority_higher(const AVTask *a, const AVTask *b) {
+    return ((const HEVCFSplitJob *)a)->tile_idx <
+           ((const HEVCFSplitJob *)b)->tile_idx;
+}
+
+static int hevc_frame_job_ready(const AVTask *t, void *user_data) {
+    return 1;
+}
+
+static int hevc_frame_job_run(AVTask *t, void *local_context,
+                              void *user_data) {
+    HEVCFSplitContext *s = user_data;
+    HEVCFSplitJob *job   = (HEVCFSplitJob *)t;
+
+    job->ret = hevc_frame_split_tile(job->ctx, job->tile_idx);
+
+    ff_mutex_lock(&s->lock);
+    if (!--s->jobs_pending)
+        ff_cond_signal(&s->cond);
+    ff_mutex_unlock(&s->lock);
+
+    return 0;
+}
+
+/* Rewrite the slices of all tiles, in parallel if a worker pool exists. */
+static int hevc_frame_split_slices(AVBSFContext *ctx) {
+    HEVCFSplitContext *s = ctx->priv_data;
+    int i, nb_jobs = 0, ret = 0;
+
+    for (i = 0; i < s->num_tiles; i++) {
+        HEVCFSplitJob *job = &s->jobs[i];
+        int j;
+
+        for (j = 0; j < s->nb_slices && s->slices[j].tile_idx != i; j++)
+            ;
+        job->ret = 0;
+        if (j < s->nb_slices)
+            s->jobs[nb_jobs++].tile_idx = i;
+    }
+
+    if (!s->executor || nb_jobs == 1) {
+        for (i = 0; i < nb_jobs && ret >= 0; i++) {
+            ret = hevc_frame_split_tile(ctx, s->jobs[i].tile_idx);
+        }
+        return ret;
+    }
+
+    s->jobs_pending = nb_jobs;
+    for (i = 0; i < nb_jobs; i++) {
+        s->jobs[i].ctx = ctx;
+        av_executor_execute(s->executor, &s->jobs[i].task);
+    }
+
+    ff_mutex_lock(&s->lock);
+    while (s->jobs_pending)
+        ff_cond_wait(&s->cond, &s->lock);
+    ff_mutex_unlock(&s->lock);
+
+    for (i = 0; i < nb_jobs; i++) {
+        if (s->jobs[i].ret < 0)
+            return s->jobs[i].ret;
+    }
+
+    return 0;
+}
+
+static int hevc_frame_add_slice(HEVCFSplitContext *s, AVBSFContext *ctx,
+                                int unit_idx) {
+    H265RawSlice *slice = s->temporal_unit.units[unit_idx].content;
+    HEVCFSplitSlice *sl;
+    int tile_idx;
+
+    tile_idx = slice_addr_to_idx(s, slice->header.slice_segment_address,
+                                 slice->header.slice_pic_parameter_set_id);
+    if (tile_idx < 0 || tile_idx >= s->num_tiles) {
+        av_log(ctx, AV_LOG_ERROR, "invalid tile index %d\n", tile_idx);
+        return AVERROR_INVALIDDATA;
+    }
+    av_log(ctx, AV_LOG_DEBUG, "slice_seg_addr %d, tile_idx %d\n",
+           slice->header.slice_segment_address, tile_idx);
+
+    if (s->nb_slices >= s->slices_alloc / sizeof(*s->slices)) {
+        unsigned int old_alloc = s->slices_alloc;
+
+        sl = av_fast_realloc(s->slices, &s->slices_alloc,
+                             (s->nb_slices + 1) * sizeof(*s->slices));
+        if (!sl) {
+            return AVERROR(ENOMEM);
+        }
+        s->slices = sl;
+        memset((uint8_t *)s->slices + old_alloc, 0,
+               s->slices_alloc - old_alloc);
+    }
+
+    sl = &s->slices[s->nb_slices];
+    if (!sl->pkt) {
+        sl->pkt = av_packet_alloc();
+        if (!sl->pkt) {
+            return AVERROR(ENOMEM);
+        }
+    }
+    sl->unit     = unit_idx;
+    sl->tile_idx = tile_idx;
+    s->nb_slices++;
+
+    return 0;
+}
+
+static void hevc_frame_reset_slices(HEVCFSplitContext *s) {
+    int i;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        av_packet_unref(s->slices[i].pkt);
+    }
+    s->nb_slices  = 0;
+    s->next_slice = 0;
+}
+
 static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
     HEVCFSplitContext *s       = ctx->priv_data;
     CodedBitstreamFragment *td = &s->temporal_unit;
-    int i, ret, tile_idx = 0, new_size, *slice_addr;
-    H265RawSlice *slice;
-    ni_bitstream_t *stream = &s->streams[0];
+    int i, ret;
 
     if (!s->tile_enabled) {
         av_assert0(s->tile_enabled);
         goto passthrough;
     }
 
-    if (s->buffer_pkt->data) {
-        av_assert0(s->nb_slices > 0);
-        goto slice_split;
+    if (s->next_slice < s->nb_slices) {
+        goto output;
     }
+    hevc_frame_reset_slices(s);
 
     ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
     if (ret < 0) {
@@ -504,18 +748,16 @@ static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
         goto passthrough;
     }
 
-    s->nb_slices   = 0;
-    s->unit_offset = 0;
     for (i = 0; i < td->nb_units; i++) {
         CodedBitstreamUnit *unit = &td->units[i];
         av_log(ctx, AV_LOG_DEBUG, "query index %d, unit type %d\n", i,
                unit->type);
 
         if (unit->type == HEVC_NAL_VPS) {
-            ret = hevc_frame_tiles_encode_vps(s, ctx, unit);
+            ret = hevc_frame_tiles_encode_ps(s, ctx, unit, -1);
             if (ret < 0) {
                 av_log(ctx, AV_LOG_ERROR, "failed to re-encode vps\n");
-                return ret;
+                goto end;
             }
         } else if (unit->type == HEVC_NAL_SPS) {
             if (i < td->nb_units - 1 && td->units[i + 1].type == HEVC_NAL_PPS) {
@@ -526,37 +768,39 @@ static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
                     ret = hevc_frame_parse_tiles(s, ctx, sps, pps);
                     if (ret < 0) {
                         av_log(ctx, AV_LOG_ERROR, "failed to parse tiles\n");
-                        return ret;
+                        goto end;
                     }
 
-                    ret = hevc_frame_tiles_encode_sps(
+                    ret = hevc_frame_tiles_encode_ps(
                         s, ctx, unit, pps->pps_pic_parameter_set_id);
                     if (ret < 0) {
                         av_log(ctx, AV_LOG_ERROR, "failed to re-encode sps\n");
-                        return ret;
+                        goto end;
                     }
                 } else {
                     av_log(ctx, AV_LOG_ERROR,
                            "seq_parameter_set_id mismatch: %d, %d\n",
                            pps->pps_seq_parameter_set_id,
                            sps->sps_seq_parameter_set_id);
-                    return AVERROR(EINVAL);
+                    ret = AVERROR(EINVAL);
+                    goto end;
                 }
             } else {
                 av_log(ctx, AV_LOG_ERROR, "failed to find PPS after SPS\n");
-                return AVERROR(EINVAL);
+                ret = AVERROR(EINVAL);
+                goto end;
             }
         } else if (unit->type == HEVC_NAL_PPS) {
-            ret = hevc_frame_tiles_encode_pps(s, ctx, unit);
+            ret = hevc_frame_tiles_encode_ps(s, ctx, unit, -1);
             if (ret < 0) {
                 av_log(ctx, AV_LOG_ERROR, "failed to re-encode pps\n");
-                return ret;
+                goto end;
             }
         } else if (unit->type <= HEVC_NAL_RSV_VCL31) {
-            if (s->nb_slices == 0) {
-                s->unit_offset = i;
+            ret = hevc_frame_add_slice(s, ctx, i);
+            if (ret < 0) {
+                goto end;
             }
-            s->nb_slices++;
         }
     }
 
@@ -565,54 +809,14 @@ static int hevc_frame_split_filter(AVBSFContext *ctx, AVPacket *out) {
         goto end;
     }
 
-slice_split:
-    for (i = s->unit_offset; i < td->nb_units; i++) {
-        CodedBitstreamUnit *unit = &td->units[i];
-        if (unit->type <= HEVC_NAL_RSV_VCL31) {
-            slice = unit->content;
-            tile_idx =
-                slice_addr_to_idx(s, slice->header.slice_segment_address,
-                                  slice->header.slice_pic_parameter_set_id);
-            av_assert0(tile_idx >= 0 && tile_idx < s->num_tiles);
-            av_log(ctx, AV_LOG_DEBUG, "slice_seg_addr %d, tile_idx %d\n",
-                   slice->header.slice_segment_address, tile_idx);
-
-            ret = hevc_frame_encode_slice_header(
-                s, ctx, unit, tile_idx,
-                slice->header.slice_pic_parameter_set_id);
-            if (ret) {
-                av_log(ctx, AV_LOG_ERROR, "failed to re-encode slice header\n");
-                av_assert0(0);
-            }
+    /* the rewritten slices no longer reference the input */
+    ret = hevc_frame_split_slices(ctx);
 
-            stream = &s->streams[tile_idx];
-            break;
-        }
-    }
-
-    new_size = (int)(ni_bitstream_count(stream) / 8);
-    ret      = av_new_packet(out, new_size);
+end:
+    /* slices added before a failure index the fragment reset below */
     if (ret < 0) {
-        return ret;
-    }
-
-    av_packet_copy_props(out, s->buffer_pkt);
-
-    slice_addr = (int *)av_packet_new_side_data(out, AV_PKT_DATA_SLICE_ADDR,
-                                                sizeof(*slice_addr));
-    av_assert0(slice_addr);
-    *slice_addr = tile_idx;
-
-    ni_bitstream_fetch(stream, out->data, new_size);
-    ni_bitstream_reset(stream);
-
-    s->unit_offset++;
-    if (s->unit_offset < td->nb_units) {
-        // To be continued...
-        return ret;
+        hevc_frame_reset_slices(s);
     }
-
-end:
     av_packet_unref(s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
@@ -621,7 +825,13 @@ end:
 #else
     ff_cbs_fragment_uninit(s->cbc, td);
 #endif
-    return ret;
+    if (ret < 0) {
+        return ret;
+    }
+
+output:
+    av_packet_move_ref(out, s->slices[s->next_slice++].pkt);
+    return 0;
 
 passthrough:
     av_packet_move_ref(out, s->buffer_pkt);
@@ -636,6 +846,66 @@ passthrough:
     return ret;
 }
 
+static int hevc_frame_init_bitstream(HEVCFSplitContext *s) {
+    int i, ret;
+
+    s->streams = av_mallocz(s->num_tiles * sizeof(ni_bitstream_t));
+    if (!s->streams) {
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < s->num_tiles; i++) {
+        ret = ni_bitstream_init(&s->streams[i]);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+static int hevc_frame_init_workers(HEVCFSplitContext *s, AVBSFContext *ctx) {
+    AVTaskCallbacks callbacks = {
+        .user_data       = s,
+        .priority_higher = hevc_frame_job_priority_higher,
+        .ready           = hevc_frame_job_ready,
+        .run             = hevc_frame_job_run,
+    };
+    int threads = s->threads;
+
+    s->jobs = av_calloc(s->num_tiles, sizeof(*s->jobs));
+    if (!s->jobs) {
+        return AVERROR(ENOMEM);
+    }
+
+    if (!threads) {
+        threads = av_cpu_count();
+    }
+    threads = FFMIN(threads, s->num_tiles);
+    if (threads <= 1) {
+        return 0;
+    }
+
+    if (ff_mutex_init(&s->lock, NULL)) {
+        return AVERROR(ENOMEM);
+    }
+    if (ff_cond_init(&s->cond, NULL)) {
+        ff_mutex_destroy(&s->lock);
+        return AVERROR(ENOMEM);
+    }
+    s->lock_init = 1;
+
+    s->executor = av_executor_alloc(&callbacks, threads);
+    if (!s->executor) {
+        return AVERROR(ENOMEM);
+    }
+
+    av_log(ctx, AV_LOG_VERBOSE, "rewriting %d tiles on %d threads\n",
+           s->num_tiles, threads);
+
+    return 0;
+}
+
 static int hevc_frame_split_init(AVBSFContext *ctx) {
     HEVCFSplitContext *s       = ctx->priv_data;
     CodedBitstreamFragment *td = &s->temporal_unit;
@@ -680,6 +950,12 @@ static int hevc_frame_split_init(AVBSFContext *ctx) {
         goto fail_out;
     }
 
+    ret = hevc_frame_init_workers(s, ctx);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to initialize worker pool\n");
+        goto fail_out;
+    }
+
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(td);
 #elif (LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 54)
@@ -709,6 +985,7 @@ static void hevc_frame_split_flush(AVBSFContext *ctx) {
         ni_bitstream_reset(&s->streams[i]);
     }
 
+    hevc_frame_reset_slices(s);
     av_packet_unref(s->buffer_pkt);
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 134)
     ff_cbs_fragment_reset(&s->temporal_unit);
@@ -721,12 +998,35 @@ static void hevc_frame_split_flush(AVBSFContext *ctx) {
 
 static void hevc_frame_split_close(AVBSFContext *ctx) {
     HEVCFSplitContext *s = ctx->priv_data;
-    int i;
+    HEVCFSplitParamSet *caches[] = { s->vps_cache, s->sps_cache, s->pps_cache };
+    const int nb_caches[] = { HEVC_MAX_VPS_COUNT, HEVC_MAX_SPS_COUNT,
+                              HEVC_MAX_PPS_COUNT };
+    int i, j;
 
-    for (i = 0; i < s->num_tiles; i++) {
+    av_executor_free(&s->executor);
+    if (s->lock_init) {
+        ff_cond_destroy(&s->cond);
+        ff_mutex_destroy(&s->lock);
+    }
+    av_freep(&s->jobs);
+
+    for (i = 0; s->streams && i < s->num_tiles; i++) {
         ni_bitstream_deinit(&s->streams[i]);
     }
 
+    for (i = 0; i < FF_ARRAY_ELEMS(caches); i++) {
+        for (j = 0; j < nb_caches[i]; j++) {
+            av_freep(&caches[i][j].key);
+            av_freep(&caches[i][j].data);
+            av_freep(&caches[i][j].offset);
+        }
+    }
+
+    for (i = 0; i < s->slices_alloc / sizeof(*s->slices); i++) {
+        av_packet_free(&s->slices[i].pkt);
+    }
+    av_freep(&s->slices);
+
     for (i = 0; i < HEVC_MAX_PPS_COUNT; i++) {
         if (s->tiles[i]) {
             if (s->tiles[i]->column_width) {
@@ -753,6 +1053,27 @@ static const enum AVCodecID hevc_frame_split_codec_ids[] = {
     AV_CODEC_ID_NONE,
 };
 
+#define OFFSET(x) offsetof(HEVCFSplitContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_BSF_PARAM)
+static const AVOption options[] = {
+    {"threads",
+     "number of threads rewriting tiles, 0 for automatic",
+     OFFSET(threads),
+     AV_OPT_TYPE_INT,
+     {.i64 = 0},
+     0,
+     INT_MAX,
+     FLAGS},
+    {NULL},
+};
+
+static const AVClass frame_split_class = {
+    .class_name = "hevc_frame_split_bsf",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const
 #if (LIBAVCODEC_VERSION_MAJOR > 59 || LIBAVCODEC_VERSION_MAJOR >= 59 && LIBAVCODEC_VERSION_MINOR >= 37)
 FFBitStreamFilter
@@ -763,9 +1084,11 @@ ff_hevc_frame_split_bsf = {
 #if (LIBAVCODEC_VERSION_MAJOR > 59 || LIBAVCODEC_VERSION_MAJOR >= 59 && LIBAVCODEC_VERSION_MINOR >= 37)
     .p.name         = "hevc_frame_split",
     .p.codec_ids    = hevc_frame_split_codec_ids,
+    .p.priv_class   = &frame_split_class,
 #else
     .name           = "hevc_frame_split",
     .codec_ids      = hevc_frame_split_codec_ids,
+    .priv_class     = &frame_split_class,
 #endif
     .priv_data_size = sizeof(HEVCFSplitContext),
     .init           = hevc_frame_split_init,
@@ -87,6 +87,20 @@ int ni_bitstream_count(ni_bitstream_t *stream) {
     return put_bits_count(&stream->pbc);
 }
 
+/**
+ * \brief Append complete, already escaped NAL units to a byte aligned
+ *        bitstream
+ */
+void ni_bitstream_write_raw(ni_bitstream_t *stream, const uint8_t *buf,
+                            size_t size) {
+    av_assert0(stream->cur_bits == 0);
+    av_assert0(size <= put_bytes_left(&stream->pbc, 0));
+
+    flush_put_bits(&stream->pbc);
+    memcpy(put_bits_ptr(&stream->pbc), buf, size);
+    skip_put_bytes(&stream->pbc, size);
+}
+
 static uint8_t ni_bitstream_dump_last_byte(ni_bitstream_t *stream) {
     return stream->pb_buf[ni_bitstream_count(stream) / 8 - 1];
 }
@@ -133,6 +147,36 @@ void ni_put_bits(ni_bitstream_t *stream, uint8_t bits, const uint32_t data) {
     }
 }
 
+/**
+ * \brief Write bytes to bitstream
+ *        Equivalent to ni_put_bits(stream, 8, data[i]) for every byte, but
+ *        skips the per bit loop when the stream is byte aligned.
+ * \param stream  stream the data is to be appended to
+ * \param data  input data
+ * \param size  number of bytes to write
+ */
+void ni_put_bytes(ni_bitstream_t *stream, const uint8_t *data, size_t size) {
+    const uint8_t emulation_prevention_three_byte = 0x03;
+    size_t i;
+
+    if (stream->cur_bits) {
+        for (i = 0; i < size; i++) {
+            ni_put_bits(stream, 8, data[i]);
+        }
+        return;
+    }
+
+    for (i = 0; i < size; i++) {
+        if (stream->zero_cnt == 2 && data[i] < 4) {
+            put_bits(&stream->pbc, 8, emulation_prevention_three_byte);
+            stream->zero_cnt = 0;
+        }
+        stream->zero_cnt = data[i] == 0 ? stream->zero_cnt + 1 : 0;
+        put_bits(&stream->pbc, 8, data[i]);
+    }
+    flush_put_bits(&stream->pbc);
+}
+
 static unsigned ni_math_floor_log2(unsigned value) {
     unsigned result = 0;
     av_assert0(value > 0);
@@ -40,8 +40,12 @@ extern void ni_bitstream_reset(ni_bitstream_t *stream);
 extern void ni_bitstream_fetch(const ni_bitstream_t *stream, uint8_t *buf,
                                size_t size);
 extern int ni_bitstream_count(ni_bitstream_t *stream);
+extern void ni_bitstream_write_raw(ni_bitstream_t *stream, const uint8_t *buf,
+                                   size_t size);
 extern void ni_put_bits(ni_bitstream_t *stream, uint8_t bits,
                         const uint32_t data);
+extern void ni_put_bytes(ni_bitstream_t *stream, const uint8_t *data,
+                         size_t size);
 extern void ni_write_nal_header(ni_bitstream_t *stream, const uint8_t nal_type,
                                 const uint8_t temporal_id,
                                 const int long_start_code);
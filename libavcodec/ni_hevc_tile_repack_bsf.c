@@ -24,11 +24,17 @@
  *
  * This bitstream filter repacks HEVC tiles into one packet containing
  * just one frame.
+ *
+ * Tiles are held by reference until their frame is complete and then
+ * gathered into a pooled output buffer in one pass. Tiles of up to
+ * reorder_window frames may arrive interleaved, frames are output in the
+ * order their first tile arrived.
  */
 
 #include "version.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/buffer.h"
 #include "libavutil/opt.h"
 
 #include "avcodec.h"
@@ -52,188 +58,331 @@
 #include "hevc.h"
 #endif
 
+#include "ni_tile_repack.h"
+
+/*
+ * Largest number of frames whose tiles may be in flight at the same time.
+ */
+#define HEVC_REPACK_MAX_WINDOW 64
+
+typedef struct HEVCRepackFrame {
+    AVPacket **tile_pkt;
+    int nb_tiles;      ///< number of tiles received so far, 0 if slot is free
+    uint64_t seq;      ///< arrival order of the first tile of the frame
+} HEVCRepackFrame;
+
+typedef struct HEVCRepackRange {
+    const uint8_t *data;
+    int size;
+} HEVCRepackRange;
+
 typedef struct HEVCRepackContext {
+    const AVClass *class;
     AVPacket *buffer_pkt;
-    AVPacket **tile_pkt;
-    int tile_pos;
+
+    /* frames being reassembled, reorder_window entries */
+    HEVCRepackFrame *frames;
+    uint64_t next_seq;
+
+    /* scatter-gather list of the frame being output */
+    HEVCRepackRange *ranges;
+    unsigned int ranges_size;
+
+    /* output buffers, sized from the largest frame seen so far */
+    NITileRepackPool pool;
+
     int tile_num;
+    int reorder_window;
 } HEVCRepackContext;
 
-static int hevc_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
+/*
+ * Find the frame a tile belongs to by its timestamps. Without timestamps the
+ * tile goes to the oldest frame which is still missing it.
+ */
+static HEVCRepackFrame *repack_find_frame(HEVCRepackContext *s,
+                                          const AVPacket *pkt, int tile_idx) {
+    int untimed = pkt->pts == AV_NOPTS_VALUE && pkt->dts == AV_NOPTS_VALUE;
+    HEVCRepackFrame *found = NULL;
+    int i;
+
+    for (i = 0; i < s->reorder_window; i++) {
+        HEVCRepackFrame *frame = &s->frames[i];
+        const AVPacket *first;
+        int j;
+
+        if (!frame->nb_tiles)
+            continue;
+        if (untimed && frame->tile_pkt[tile_idx]->buf)
+            continue;
+
+        for (j = 0; !frame->tile_pkt[j]->buf; j++)
+            ;
+        first = frame->tile_pkt[j];
+        if (first->pts == pkt->pts && first->dts == pkt->dts &&
+            (!found || frame->seq < found->seq))
+            found = frame;
+    }
+
+    return found;
+}
+
+static HEVCRepackFrame *repack_oldest_frame(HEVCRepackContext *s) {
+    HEVCRepackFrame *oldest = NULL;
+    int i;
+
+    for (i = 0; i < s->reorder_window; i++) {
+        HEVCRepackFrame *frame = &s->frames[i];
+        if (frame->nb_tiles && (!oldest || frame->seq < oldest->seq))
+            oldest = frame;
+    }
+
+    return oldest;
+}
+
+static void repack_release_frame(HEVCRepackContext *s, HEVCRepackFrame *frame) {
+    int i;
+
+    for (i = 0; i < s->tile_num; i++) {
+        av_packet_unref(frame->tile_pkt[i]);
+    }
+    frame->nb_tiles = 0;
+}
+
+/* Keep a reference to the tile in pkt in the slot of its frame. */
+static int repack_add_tile(AVBSFContext *ctx, AVPacket *pkt) {
     HEVCRepackContext *s = ctx->priv_data;
-    int ret;
-    int tile_idx;
+    HEVCRepackFrame *frame;
+    AVPacket *first = NULL;
     int *side_data;
+    int tile_idx;
     int i;
 
-    av_log(ctx, AV_LOG_DEBUG, "tile_pos %d, tile_num %d\n", s->tile_pos,
-           s->tile_num);
+    side_data = (int *)av_packet_get_side_data(pkt, AV_PKT_DATA_SLICE_ADDR,
+                                               NULL);
+    if (!side_data) {
+        av_log(ctx, AV_LOG_ERROR, "failed to get packet side data\n");
+        return AVERROR(EINVAL);
+    }
 
-    if (s->tile_pos < s->tile_num) {
-        if (!s->buffer_pkt->data) {
-            ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
-            if (ret < 0) {
-                av_log(ctx, AV_LOG_INFO, "failed to get packet ref: 0x%x\n",
-                       ret);
-                return ret;
-            }
-        }
+    tile_idx = *side_data;
+    if (tile_idx < 0 || tile_idx >= s->tile_num) {
+        av_log(ctx, AV_LOG_ERROR,
+               "tile index %d exceeds maximum tile number %d\n", tile_idx,
+               s->tile_num);
+        return AVERROR(EINVAL);
+    }
 
-        side_data = (int *)av_packet_get_side_data(
-            s->buffer_pkt, AV_PKT_DATA_SLICE_ADDR, NULL);
-        if (!side_data) {
-            av_log(ctx, AV_LOG_ERROR, "failed to get packet side data\n");
-            return AVERROR(EINVAL);
+    frame = repack_find_frame(s, pkt, tile_idx);
+    if (!frame) {
+        for (i = 0; i < s->reorder_window; i++) {
+            if (!s->frames[i].nb_tiles) {
+                frame = &s->frames[i];
+                break;
+            }
         }
-
-        tile_idx = *side_data;
-        if (tile_idx >= s->tile_num) {
+        if (!frame) {
             av_log(ctx, AV_LOG_ERROR,
-                   "tile index %d exceeds maximum tile number %d\n", tile_idx,
-                   s->tile_num);
+                   "tiles of more than %d frames in flight, increase "
+                   "reorder_window\n", s->reorder_window);
             return AVERROR(EINVAL);
         }
-
-        if (s->tile_pkt[tile_idx]->buf) {
-            av_log(ctx, AV_LOG_ERROR, "duplicated tile index %d\n", tile_idx);
+        frame->seq = s->next_seq++;
+    } else {
+        for (i = 0; !first; i++) {
+            if (frame->tile_pkt[i]->buf)
+                first = frame->tile_pkt[i];
+        }
+        if (pkt->flags != first->flags ||
+            pkt->stream_index != first->stream_index) {
+            av_log(ctx, AV_LOG_ERROR, "packet metadata does not match\n");
             return AVERROR(EINVAL);
         }
+    }
 
-        s->tile_pkt[tile_idx]->buf = av_buffer_ref(s->buffer_pkt->buf);
-        if (!s->tile_pkt[tile_idx]->buf) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "failed to get buffer for tile index %d\n", tile_idx);
-            return AVERROR(ENOMEM);
-        }
-        s->tile_pkt[tile_idx]->data = s->buffer_pkt->data;
-        s->tile_pkt[tile_idx]->size = s->buffer_pkt->size;
-
-        av_log(ctx, AV_LOG_DEBUG, "tile %d, data actual size %d\n", tile_idx,
-               s->buffer_pkt->size);
-
-        if (s->tile_pos == 0) {
-            s->tile_pkt[0]->pts          = s->buffer_pkt->pts;
-            s->tile_pkt[0]->dts          = s->buffer_pkt->dts;
-            s->tile_pkt[0]->pos          = s->buffer_pkt->pos;
-            s->tile_pkt[0]->flags        = s->buffer_pkt->flags;
-            s->tile_pkt[0]->stream_index = s->buffer_pkt->stream_index;
-
-            s->tile_pkt[0]->side_data       = NULL;
-            s->tile_pkt[0]->side_data_elems = 0;
-
-            for (i = 0; i < s->tile_pkt[0]->side_data_elems; i++) {
-                enum AVPacketSideDataType type =
-                    s->buffer_pkt->side_data[i].type;
-                if (type != AV_PKT_DATA_SLICE_ADDR) {
-                    int size          = s->buffer_pkt->side_data[i].size;
-                    uint8_t *src_data = s->buffer_pkt->side_data[i].data;
-                    uint8_t *dst_data =
-                        av_packet_new_side_data(s->tile_pkt[0], type, size);
-
-                    if (!dst_data) {
-                        av_packet_free_side_data(s->tile_pkt[0]);
-                        return AVERROR(ENOMEM);
-                    }
-
-                    memcpy(dst_data, src_data, size);
-                }
-            }
-        } else {
-            if (s->buffer_pkt->pts != s->tile_pkt[0]->pts ||
-                s->buffer_pkt->dts != s->tile_pkt[0]->dts ||
-                s->buffer_pkt->flags != s->tile_pkt[0]->flags ||
-                s->buffer_pkt->stream_index != s->tile_pkt[0]->stream_index) {
-                av_log(ctx, AV_LOG_ERROR, "packet metadata does not match\n");
-                return AVERROR(EINVAL);
-            }
-        }
-        s->tile_pos++;
-        av_packet_unref(s->buffer_pkt);
+    if (frame->tile_pkt[tile_idx]->buf) {
+        av_log(ctx, AV_LOG_ERROR, "duplicated tile index %d\n", tile_idx);
+        return AVERROR(EINVAL);
     }
 
-    if (s->tile_pos == s->tile_num) {
-        int new_size = 0;
-        int found;
-        const uint8_t *ptr;
-        const uint8_t *end;
-        const uint8_t *p_offset;
-        uint32_t nalu_type;
-        uint32_t stc;
-        uint8_t *data;
-        AVBufferRef *buf;
-
-        /* max payload size */
-        for (i = 0; i < s->tile_num; i++) {
-            new_size += s->tile_pkt[i]->size;
-        }
+    av_log(ctx, AV_LOG_DEBUG, "tile %d, pts %" PRId64 ", data actual size %d\n",
+           tile_idx, pkt->pts, pkt->size);
 
-        buf = av_buffer_alloc(new_size);
-        if (!buf) {
-            av_log(ctx, AV_LOG_ERROR, "failed to allocate new packet data\n");
-            return AVERROR(ENOMEM);
-        }
+    av_packet_move_ref(frame->tile_pkt[tile_idx], pkt);
+    frame->nb_tiles++;
 
-        data = buf->data;
-        memcpy(data, s->tile_pkt[0]->data, s->tile_pkt[0]->size);
-        new_size = s->tile_pkt[0]->size;
-        av_log(ctx, AV_LOG_DEBUG, "tile %d size %d\n", 0, new_size);
-        av_buffer_unref(&s->tile_pkt[0]->buf);
-        s->tile_pkt[0]->buf = NULL;
-
-        for (i = 1; i < s->tile_num; i++) {
-            ptr = s->tile_pkt[i]->data;
-            end = s->tile_pkt[i]->data + s->tile_pkt[i]->size;
-
-            stc   = -1;
-            found = 0;
-            ptr   = (const uint8_t *) avpriv_find_start_code(ptr, end, &stc);
-            while (ptr < end) {
-                av_log(ctx, AV_LOG_DEBUG, "tile %d, %02x %02x %02x %02x %02x\n",
-                       i, *(ptr - 4), *(ptr - 3), *(ptr - 2), *(ptr - 1), *ptr);
-
-                if (found) {
-                    memcpy(data + new_size, p_offset, ptr - 4 - p_offset);
-                    new_size += (int)(ptr - 4 - p_offset);
-                    found = 0;
-                }
-
-                nalu_type = (stc >> 1) & 0x3F;
-                if (nalu_type <= HEVC_NAL_RSV_VCL31) {
-                    p_offset = ptr - 4;
-                    found    = 1;
-                }
-
-                stc = -1;
-                ptr = (const uint8_t *) avpriv_find_start_code(ptr, end, &stc);
-            }
+    return 0;
+}
+
+static int repack_add_range(HEVCRepackContext *s, int *nb_ranges,
+                            const uint8_t *data, int size) {
+    HEVCRepackRange *ranges;
+
+    if (size <= 0)
+        return 0;
 
-            if (found) {
-                memcpy(data + new_size, p_offset, end - p_offset);
-                new_size += (int)(end - p_offset);
-                av_log(ctx, AV_LOG_DEBUG, "tile %d size %d\n", i,
-                       (int)(end - p_offset));
+    ranges = av_fast_realloc(s->ranges, &s->ranges_size,
+                             (*nb_ranges + 1) * sizeof(*ranges));
+    if (!ranges)
+        return AVERROR(ENOMEM);
+    s->ranges = ranges;
+
+    ranges[*nb_ranges].data = data;
+    ranges[*nb_ranges].size = size;
+    (*nb_ranges)++;
+
+    return 0;
+}
+
+/*
+ * Collect the parts of the frame which go into the output packet: the whole
+ * first tile, including its parameter sets, followed by the VCL NAL units of
+ * the remaining tiles.
+ */
+static int repack_gather(AVBSFContext *ctx, HEVCRepackFrame *frame,
+                         int *nb_ranges, size_t *total) {
+    HEVCRepackContext *s = ctx->priv_data;
+    const uint8_t *ptr;
+    const uint8_t *end;
+    const uint8_t *p_offset = NULL;
+    uint32_t nalu_type;
+    uint32_t stc;
+    int i, j, ret;
+
+    *nb_ranges = 0;
+    ret = repack_add_range(s, nb_ranges, frame->tile_pkt[0]->data,
+                           frame->tile_pkt[0]->size);
+    if (ret < 0)
+        return ret;
+
+    for (i = 1; i < s->tile_num; i++) {
+        ptr = frame->tile_pkt[i]->data;
+        end = frame->tile_pkt[i]->data + frame->tile_pkt[i]->size;
+
+        p_offset = NULL;
+        stc      = -1;
+        ptr      = (const uint8_t *) avpriv_find_start_code(ptr, end, &stc);
+        while (ptr < end) {
+            if (p_offset) {
+                ret = repack_add_range(s, nb_ranges, p_offset,
+                                       (int)(ptr - 4 - p_offset));
+                if (ret < 0)
+                    return ret;
+                p_offset = NULL;
             }
-            av_buffer_unref(&s->tile_pkt[i]->buf);
-            s->tile_pkt[i]->buf = NULL;
+
+            nalu_type = (stc >> 1) & 0x3F;
+            if (nalu_type <= HEVC_NAL_RSV_VCL31)
+                p_offset = ptr - 4;
+
+            stc = -1;
+            ptr = (const uint8_t *) avpriv_find_start_code(ptr, end, &stc);
+        }
+
+        if (p_offset) {
+            ret = repack_add_range(s, nb_ranges, p_offset,
+                                   (int)(end - p_offset));
+            if (ret < 0)
+                return ret;
         }
+    }
 
-        out->buf  = buf;
-        out->data = data;
-        out->size = new_size;
+    *total = 0;
+    for (j = 0; j < *nb_ranges; j++)
+        *total += s->ranges[j].size;
 
-        av_log(ctx, AV_LOG_DEBUG, "repacket new size %d\n", new_size);
+    if (*total > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(ERANGE);
 
-        s->tile_pos = 0;
-        return 0;
-    } else {
-        return AVERROR(EAGAIN);
+    return 0;
+}
+
+static int repack_output_frame(AVBSFContext *ctx, HEVCRepackFrame *frame,
+                               AVPacket *out) {
+    HEVCRepackContext *s = ctx->priv_data;
+    AVBufferRef *buf = NULL;
+    uint8_t *data;
+    size_t new_size;
+    int nb_ranges;
+    int i, ret;
+
+    if (s->tile_num == 1) {
+        /* nothing to stitch, hand the tile on as is */
+        av_packet_move_ref(out, frame->tile_pkt[0]);
+        goto end;
+    }
+
+    ret = repack_gather(ctx, frame, &nb_ranges, &new_size);
+    if (ret < 0)
+        goto fail;
+
+    ret = ff_ni_tile_repack_get_buffer(ctx, &s->pool, new_size, &buf);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to allocate new packet data\n");
+        goto fail;
+    }
+
+    data = buf->data;
+    for (i = 0; i < nb_ranges; i++) {
+        memcpy(data, s->ranges[i].data, s->ranges[i].size);
+        data += s->ranges[i].size;
     }
+    memset(data, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    ret = av_packet_copy_props(out, frame->tile_pkt[0]);
+    if (ret < 0) {
+        av_buffer_unref(&buf);
+        goto fail;
+    }
+
+    out->buf  = buf;
+    out->data = buf->data;
+    out->size = (int)new_size;
+
+end:
+    /* the tile index does not apply to the reassembled frame */
+    av_packet_side_data_remove(out->side_data, &out->side_data_elems,
+                               AV_PKT_DATA_SLICE_ADDR);
+    av_log(ctx, AV_LOG_DEBUG, "repacket new size %d\n", out->size);
+    repack_release_frame(s, frame);
+    return 0;
+
+fail:
+    repack_release_frame(s, frame);
+    return ret;
 }
 
-static int hevc_tile_repack_init(AVBSFContext *ctx) {
+static int hevc_tile_repack_filter(AVBSFContext *ctx, AVPacket *out) {
     HEVCRepackContext *s = ctx->priv_data;
+    HEVCRepackFrame *oldest;
     int ret;
-    int i;
+
+    for (;;) {
+        /* frames are output in the order their first tile arrived */
+        oldest = repack_oldest_frame(s);
+        if (oldest && oldest->nb_tiles == s->tile_num)
+            return repack_output_frame(ctx, oldest, out);
+
+        ret = ff_bsf_get_packet_ref(ctx, s->buffer_pkt);
+        if (ret == AVERROR_EOF && oldest) {
+            av_log(ctx, AV_LOG_WARNING,
+                   "dropping incomplete frame with %d of %d tiles\n",
+                   oldest->nb_tiles, s->tile_num);
+            repack_release_frame(s, oldest);
+            continue;
+        }
+        if (ret < 0)
+            return ret;
+
+        ret = repack_add_tile(ctx, s->buffer_pkt);
+        av_packet_unref(s->buffer_pkt);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static int hevc_tile_repack_init(AVBSFContext *ctx) {
+    HEVCRepackContext *s = ctx->priv_data;
+    int i, j;
 
     av_log(ctx, AV_LOG_INFO, "number of tiles %d\n", s->tile_num);
     if (s->tile_num <= 0) {
@@ -245,35 +394,28 @@ static int hevc_tile_repack_init(AVBSFContext *ctx) {
         return AVERROR(ENOMEM);
     }
 
-    s->tile_pkt = av_malloc(sizeof(AVPacket *) * s->tile_num);
-    if (!s->tile_pkt) {
-        ret = AVERROR(ENOMEM);
-        goto fail_alloc_tile_pkt;
+    s->frames = av_calloc(s->reorder_window, sizeof(*s->frames));
+    if (!s->frames) {
+        return AVERROR(ENOMEM);
     }
-    memset(s->tile_pkt, 0, sizeof(AVPacket *) * s->tile_num);
 
-    for (i = 0; i < s->tile_num; i++) {
-        s->tile_pkt[i] = av_packet_alloc();
-        if (!s->tile_pkt[i]) {
-            ret = AVERROR(ENOMEM);
-            goto fail_alloc_pkts;
-        }
-    }
+    for (i = 0; i < s->reorder_window; i++) {
+        HEVCRepackFrame *frame = &s->frames[i];
 
-    return 0;
+        frame->tile_pkt = av_calloc(s->tile_num, sizeof(*frame->tile_pkt));
+        if (!frame->tile_pkt) {
+            return AVERROR(ENOMEM);
+        }
 
-fail_alloc_pkts:
-    for (i -= 1; i >= 0; i--) {
-        av_packet_free(&s->tile_pkt[i]);
+        for (j = 0; j < s->tile_num; j++) {
+            frame->tile_pkt[j] = av_packet_alloc();
+            if (!frame->tile_pkt[j]) {
+                return AVERROR(ENOMEM);
+            }
+        }
     }
-    free(s->tile_pkt);
-    s->tile_pkt = NULL;
-
-fail_alloc_tile_pkt:
-    av_packet_free(&s->buffer_pkt);
-    s->buffer_pkt = NULL;
 
-    return ret;
+    return 0;
 }
 
 static void hevc_tile_repack_flush(AVBSFContext *ctx) {
@@ -282,23 +424,35 @@ static void hevc_tile_repack_flush(AVBSFContext *ctx) {
 
     av_packet_unref(s->buffer_pkt);
 
-    for (i = 0; i < s->tile_num; i++) {
-        av_packet_unref(s->tile_pkt[i]);
+    for (i = 0; i < s->reorder_window; i++) {
+        repack_release_frame(s, &s->frames[i]);
     }
+    s->next_seq = 0;
 }
 
 static void hevc_tile_repack_close(AVBSFContext *ctx) {
     HEVCRepackContext *s = ctx->priv_data;
-    int i;
+    int i, j;
 
     av_packet_free(&s->buffer_pkt);
-    s->buffer_pkt = NULL;
 
-    for (i = 0; i < s->tile_num; i++) {
-        av_packet_free(&s->tile_pkt[i]);
+    if (s->frames) {
+        for (i = 0; i < s->reorder_window; i++) {
+            HEVCRepackFrame *frame = &s->frames[i];
+
+            if (!frame->tile_pkt)
+                continue;
+            for (j = 0; j < s->tile_num; j++) {
+                av_packet_free(&frame->tile_pkt[j]);
+            }
+            av_freep(&frame->tile_pkt);
+        }
+        av_freep(&s->frames);
     }
-    free(s->tile_pkt);
-    s->tile_pkt = NULL;
+
+    av_freep(&s->ranges);
+    s->ranges_size = 0;
+    ff_ni_tile_repack_pool_uninit(&s->pool);
 }
 
 static const enum AVCodecID hevc_tile_repack_codec_ids[] = {
@@ -317,6 +471,14 @@ static const AVOption options[] = {
      0,
      INT_MAX,
      FLAGS},
+    {"reorder_window",
+     "number of frames whose tiles may arrive interleaved",
+     OFFSET(reorder_window),
+     AV_OPT_TYPE_INT,
+     {.i64 = 4},
+     1,
+     HEVC_REPACK_MAX_WINDOW,
+     FLAGS},
     {NULL},
 };
 
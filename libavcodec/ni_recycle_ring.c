@@ -0,0 +1,103 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+#include "ni_recycle_ring.h"
+
+#define MAP_SIZE (UINT16_MAX + 1)
+
+int ff_ni_recycle_ring_init(NIRecycleRing *ring, int size)
+{
+    ring->slots = NULL;
+    ring->map   = NULL;
+    ring->size  = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+
+    if (size < 1 || size > NI_RECYCLE_RING_MAX_SLOTS)
+        return AVERROR(EINVAL);
+
+    ring->slots = av_malloc_array(size + 1, sizeof(*ring->slots));
+    ring->map   = av_calloc(MAP_SIZE, sizeof(*ring->map));
+    if (!ring->slots || !ring->map) {
+        ff_ni_recycle_ring_uninit(ring);
+        return AVERROR(ENOMEM);
+    }
+    for (int i = 0; i < MAP_SIZE; i++)
+        atomic_init(&ring->map[i], 0);
+
+    for (int i = 0; i < size; i++)
+        ring->slots[i] = i;
+    ring->size = size;
+    atomic_init(&ring->tail, size);
+
+    return 0;
+}
+
+void ff_ni_recycle_ring_uninit(NIRecycleRing *ring)
+{
+    av_freep(&ring->slots);
+    av_freep(&ring->map);
+    ring->size = 0;
+}
+
+static inline int next_entry(const NIRecycleRing *ring, int i)
+{
+    return i == ring->size ? 0 : i + 1;
+}
+
+int ff_ni_recycle_ring_acquire(NIRecycleRing *ring, uint16_t frame_idx)
+{
+    int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int slot;
+
+    if (head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+        return AVERROR(EAGAIN);
+
+    slot = ring->slots[head];
+    // pairs with the acquire loads in lookup/release, which may run on the
+    // thread receiving packets
+    atomic_store_explicit(&ring->map[frame_idx], slot + 1, memory_order_release);
+    atomic_store_explicit(&ring->head, next_entry(ring, head), memory_order_release);
+
+    return slot;
+}
+
+int ff_ni_recycle_ring_lookup(NIRecycleRing *ring, uint16_t frame_idx)
+{
+    return (int)atomic_load_explicit(&ring->map[frame_idx], memory_order_acquire) - 1;
+}
+
+int ff_ni_recycle_ring_release(NIRecycleRing *ring, uint16_t frame_idx)
+{
+    int slot = atomic_exchange_explicit(&ring->map[frame_idx], 0,
+                                        memory_order_acquire) - 1;
+    int tail;
+
+    if (slot < 0)
+        return -1;
+
+    // at most size slots are in flight, so the ring cannot be full here
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    ring->slots[tail] = slot;
+    atomic_store_explicit(&ring->tail, next_entry(ring, tail), memory_order_release);
+
+    return slot;
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_NI_RECYCLE_RING_H
+#define AVCODEC_NI_RECYCLE_RING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define NI_RECYCLE_RING_MAX_SLOTS 255
+
+/**
+ * Free list of the encoder slots holding the hardware frames sent to the
+ * device, and the map from the device frame index (ui16FrameIdx, which the
+ * packets return as recycle index) to the slot holding that frame.
+ *
+ * The free list is a single producer, single consumer lock-free ring: one
+ * thread acquires slots when sending frames, one releases them when the
+ * device recycles the frames; they may be the same thread. The contents of
+ * a slot released by one thread are visible to the thread acquiring it.
+ */
+typedef struct NIRecycleRing {
+    int *slots;             ///< free slot indices, size + 1 entries
+    int size;               ///< number of slots
+    atomic_int head;        ///< next free entry, written by the acquiring thread
+    atomic_int tail;        ///< next empty entry, written by the releasing thread
+    atomic_uchar *map;      ///< frame index -> slot + 1, 0 if not in flight
+} NIRecycleRing;
+
+/** Set up size free slots, size is at most NI_RECYCLE_RING_MAX_SLOTS. */
+int ff_ni_recycle_ring_init(NIRecycleRing *ring, int size);
+
+void ff_ni_recycle_ring_uninit(NIRecycleRing *ring);
+
+/**
+ * Take a free slot for the frame with device index frame_idx.
+ *
+ * @return the slot, AVERROR(EAGAIN) if all slots are in flight
+ */
+int ff_ni_recycle_ring_acquire(NIRecycleRing *ring, uint16_t frame_idx);
+
+/** @return the slot of the frame with device index frame_idx, -1 if none */
+int ff_ni_recycle_ring_lookup(NIRecycleRing *ring, uint16_t frame_idx);
+
+/**
+ * Give back the slot of the frame with device index frame_idx. The slot
+ * must not be touched afterwards, it may be acquired right away.
+ *
+ * @return the slot, -1 if frame_idx is not in flight
+ */
+int ff_ni_recycle_ring_release(NIRecycleRing *ring, uint16_t frame_idx);
+
+#endif /* AVCODEC_NI_RECYCLE_RING_H */
@@ -0,0 +1,140 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_NI_SESSION_STATS_H
+#define AVCODEC_NI_SESSION_STATS_H
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include "libavutil/bprint.h"
+#include "libavutil/common.h"
+#include "libavutil/log.h"
+#include "libavutil/time.h"
+
+enum NISessionIO {
+    NI_SESSION_IO_WRITE,
+    NI_SESSION_IO_READ,
+    NI_SESSION_IO_NB
+};
+
+/**
+ * Splits the time spent in a codec entry point into the part spent inside
+ * libxcoder session reads/writes (device) and everything else (host side
+ * queuing, copies, side data packing and pool handling).
+ */
+typedef struct NISessionStats {
+    int64_t  entry_start;
+    int64_t  io_start;
+    uint64_t nb_entries;
+    int64_t  entry_us;
+    uint64_t nb_io[NI_SESSION_IO_NB];
+    int64_t  io_us[NI_SESSION_IO_NB];
+} NISessionStats;
+
+static inline void ff_ni_stats_enter(NISessionStats *st)
+{
+    st->entry_start = av_gettime_relative();
+}
+
+static inline void ff_ni_stats_leave(NISessionStats *st)
+{
+    st->entry_us += av_gettime_relative() - st->entry_start;
+    st->nb_entries++;
+}
+
+static inline void ff_ni_stats_io_begin(NISessionStats *st)
+{
+    st->io_start = av_gettime_relative();
+}
+
+static inline void ff_ni_stats_io_end(NISessionStats *st, enum NISessionIO io)
+{
+    st->io_us[io] += av_gettime_relative() - st->io_start;
+    st->nb_io[io]++;
+}
+
+static inline void ff_ni_stats_report(void *log_ctx, const NISessionStats *st)
+{
+    int64_t io_us = st->io_us[NI_SESSION_IO_WRITE] + st->io_us[NI_SESSION_IO_READ];
+
+    if (!st->nb_entries)
+        return;
+
+    av_log(log_ctx, AV_LOG_VERBOSE,
+           "%" PRIu64 " calls, host %.1f us/call, device %.1f us/call "
+           "(%" PRIu64 " writes %.1f us, %" PRIu64 " reads %.1f us)\n",
+           st->nb_entries,
+           (double)(st->entry_us - io_us) / st->nb_entries,
+           (double)io_us / st->nb_entries,
+           st->nb_io[NI_SESSION_IO_WRITE],
+           st->nb_io[NI_SESSION_IO_WRITE] ?
+               (double)st->io_us[NI_SESSION_IO_WRITE] / st->nb_io[NI_SESSION_IO_WRITE] : 0.0,
+           st->nb_io[NI_SESSION_IO_READ],
+           st->nb_io[NI_SESSION_IO_READ] ?
+               (double)st->io_us[NI_SESSION_IO_READ] / st->nb_io[NI_SESSION_IO_READ] : 0.0);
+}
+
+#define NI_LATENCY_BUCKETS 20
+
+/**
+ * Log2 histogram of the time a codec entry point took to hand out its
+ * result: bucket 0 counts the calls under 1 us, bucket i those under
+ * 2^i us, the last bucket all the longer ones.
+ */
+typedef struct NILatencyHist {
+    uint64_t count[NI_LATENCY_BUCKETS];
+    uint64_t nb;
+    int64_t  sum_us;
+    int64_t  max_us;
+} NILatencyHist;
+
+static inline void ff_ni_latency_add(NILatencyHist *h, int64_t us)
+{
+    int bucket = us > 0 ? FFMIN(av_log2(us) + 1, NI_LATENCY_BUCKETS - 1) : 0;
+
+    h->count[bucket]++;
+    h->nb++;
+    h->sum_us += us;
+    h->max_us  = FFMAX(h->max_us, us);
+}
+
+static inline void ff_ni_latency_report(void *log_ctx, const char *what,
+                                        const NILatencyHist *h)
+{
+    AVBPrint bp;
+
+    if (!h->nb)
+        return;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    for (int i = 0; i < NI_LATENCY_BUCKETS; i++) {
+        if (!h->count[i])
+            continue;
+        if (i < NI_LATENCY_BUCKETS - 1)
+            av_bprintf(&bp, " <%dus:%" PRIu64, 1 << i, h->count[i]);
+        else
+            av_bprintf(&bp, " >=%dus:%" PRIu64, 1 << (i - 1), h->count[i]);
+    }
+    av_log(log_ctx, AV_LOG_VERBOSE,
+           "%s latency: %" PRIu64 " calls, %.1f us average, %" PRId64 " us max,%s\n",
+           what, h->nb, (double)h->sum_us / h->nb, h->max_us, bp.str);
+    av_bprint_finalize(&bp, NULL);
+}
+
+#endif /* AVCODEC_NI_SESSION_STATS_H */
@@ -0,0 +1,73 @@
+/*
+ * NetInt output buffer pool shared by the HEVC and AV1 tile repack BSFs
+ * Copyright (c) 2018-2023 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_NI_TILE_REPACK_H
+#define AVCODEC_NI_TILE_REPACK_H
+
+#include <stddef.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+
+#include "defs.h"
+
+typedef struct NITileRepackPool {
+    AVBufferPool *pool;
+    size_t size;
+} NITileRepackPool;
+
+/**
+ * Get a padded output buffer of at least size bytes. The pool is
+ * recreated with some headroom when a frame outgrows it, so a slowly
+ * growing bitrate does not recreate it on every frame.
+ */
+static inline int ff_ni_tile_repack_get_buffer(void *logctx,
+                                               NITileRepackPool *p,
+                                               size_t size, AVBufferRef **buf)
+{
+    size += AV_INPUT_BUFFER_PADDING_SIZE;
+    if (size > p->size) {
+        size_t new_size = FFMIN(size + size / 4, INT_MAX);
+
+        av_log(logctx, AV_LOG_DEBUG, "resizing buffer pool %zu -> %zu\n",
+               p->size, new_size);
+        av_buffer_pool_uninit(&p->pool);
+        p->pool = av_buffer_pool_init(new_size, NULL);
+        if (!p->pool) {
+            p->size = 0;
+            return AVERROR(ENOMEM);
+        }
+        p->size = new_size;
+    }
+
+    *buf = av_buffer_pool_get(p->pool);
+    return *buf ? 0 : AVERROR(ENOMEM);
+}
+
+static inline void ff_ni_tile_repack_pool_uninit(NITileRepackPool *p)
+{
+    av_buffer_pool_uninit(&p->pool);
+    p->size = 0;
+}
+
+#endif /* AVCODEC_NI_TILE_REPACK_H */
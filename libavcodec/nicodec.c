@@ -446,6 +446,62 @@ int ff_xcoder_add_headers(AVCodecContext *avctx, AVPacket *pkt,
 
     return ret;
 }
+/* Keep the props of a packet written while prefetching for its frame. */
+static int pkt_props_push(XCoderDecContext *s, const AVPacket *pkt)
+{
+    AVPacket **q = s->pkt_props_queue;
+    AVPacket *props;
+
+    if (s->nb_pkt_props == NI_DEC_PKT_PROPS_NB) {
+        /* the oldest packet did not give a frame, it was dropped */
+        props = q[0];
+        memmove(q, q + 1, (NI_DEC_PKT_PROPS_NB - 1) * sizeof(*q));
+        q[NI_DEC_PKT_PROPS_NB - 1] = props;
+        s->nb_pkt_props--;
+    }
+
+    props = q[s->nb_pkt_props];
+    av_packet_unref(props);
+    if (av_packet_copy_props(props, pkt) < 0)
+        return AVERROR(ENOMEM);
+    s->nb_pkt_props++;
+
+    return 0;
+}
+
+/*
+ * Move the props of the packet the frame at pkt_pos was decoded from to
+ * s->pkt_props. Without a packet at that position, as when the input has
+ * no positions, the oldest packet is taken, in decode order.
+ */
+static void pkt_props_pop(XCoderDecContext *s, int64_t pkt_pos)
+{
+    AVPacket **q = s->pkt_props_queue;
+    AVPacket *props;
+    int i;
+
+    av_packet_unref(s->pkt_props);
+    if (!s->nb_pkt_props)
+        return;
+
+    for (i = 0; i < s->nb_pkt_props && q[i]->pos != pkt_pos; i++)
+        ;
+    if (i == s->nb_pkt_props)
+        i = 0;
+
+    props = q[i];
+    av_packet_move_ref(s->pkt_props, props);
+    memmove(q + i, q + i + 1, (s->nb_pkt_props - i - 1) * sizeof(*q));
+    q[--s->nb_pkt_props] = props;
+}
+
+void ff_xcoder_dec_pkt_props_flush(XCoderDecContext *s)
+{
+    for (int i = 0; i < s->nb_pkt_props; i++)
+        av_packet_unref(s->pkt_props_queue[i]);
+    s->nb_pkt_props = 0;
+}
+
 int ff_xcoder_dec_send(AVCodecContext *avctx, XCoderDecContext *s, AVPacket *pkt) {
     /* call ni_decoder_session_write to send compressed video packet to the decoder
        instance */
@@ -649,7 +705,9 @@ int ff_xcoder_dec_send(AVCodecContext *avctx, XCoderDecContext *s, AVPacket *pkt
 
         sent = 0;
         if (xpkt->data_len > 0) {
+            ff_ni_stats_io_begin(&s->stats);
             sent = ni_device_session_write(&(s->api_ctx), &(s->api_pkt), NI_DEVICE_TYPE_DECODER);
+            ff_ni_stats_io_end(&s->stats, NI_SESSION_IO_WRITE);
         }
         if (sent < 0) {
             av_log(avctx, AV_LOG_ERROR, "Failed to send eos signal (status = %d)\n",
@@ -689,7 +747,9 @@ int ff_xcoder_dec_send(AVCodecContext *avctx, XCoderDecContext *s, AVPacket *pkt
 
         sent = 0;
         if (xpkt->data_len > 0) {
+            ff_ni_stats_io_begin(&s->stats);
             sent = ni_device_session_write(&s->api_ctx, &(s->api_pkt), NI_DEVICE_TYPE_DECODER);
+            ff_ni_stats_io_end(&s->stats, NI_SESSION_IO_WRITE);
             av_log(avctx, AV_LOG_VERBOSE, "ff_xcoder_dec_send pts=%" PRIi64 ", dts=%" PRIi64 ", pos=%" PRIi64 ", sent=%d\n", pkt->pts, pkt->dts, pkt->pos, sent);
         }
         if (sent < 0) {
@@ -715,6 +775,12 @@ int ff_xcoder_dec_send(AVCodecContext *avctx, XCoderDecContext *s, AVPacket *pkt
         free(xpkt->p_custom_sei_set);
         xpkt->p_custom_sei_set = NULL;
 
+        if (s->prefetcher && size) {
+            ret = pkt_props_push(s, pkt);
+            if (ret < 0)
+                return ret;
+        }
+
 #if LIBAVCODEC_VERSION_MAJOR >= 60
         /* save the opaque pointers from input packet to be copied to corresponding frame later */
         if (avctx->flags & AV_CODEC_FLAG_COPY_OPAQUE) {
@@ -909,6 +975,14 @@ int retrieve_frame(AVCodecContext *avctx, AVFrame *data, int *got_frame,
                s->api_ctx.session_id, s->api_ctx.frame_num);
         s->low_delay = 0;
     }
+#if LIBAVCODEC_VERSION_MAJOR >= 61
+    // while prefetching, avctx->internal->last_pkt_props belongs to the
+    // thread fetching the packets, which runs ahead of the frames
+    if (s->prefetcher) {
+        pkt_props_pop(s, (int64_t)xfme->pkt_pos);
+        res = ff_decode_frame_props_from_pkt(avctx, frame, s->pkt_props);
+    } else
+#endif
     res = ff_decode_frame_props(avctx, frame);
     if (res < 0)
         return res;
@@ -920,7 +994,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
 #if LIBAVCODEC_VERSION_MAJOR >= 61 //7.0
-    frame->duration = avctx->internal->last_pkt_props->duration;
+    frame->duration = (s->prefetcher ? s->pkt_props : avctx->internal->last_pkt_props)->duration;
 #else
     frame->pkt_duration = avctx->internal->last_pkt_props->duration;
 #endif
@@ -1310,11 +1384,13 @@ read_op:
         return AVERROR_EXTERNAL;
     }
 
+    ff_ni_stats_io_begin(&s->stats);
     if (avctx->pix_fmt != AV_PIX_FMT_NI_QUAD) {
         ret = ni_device_session_read(&s->api_ctx, p_session_data, NI_DEVICE_TYPE_DECODER);
     } else {
         ret = ni_device_session_read_hwdesc(&s->api_ctx, p_session_data, NI_DEVICE_TYPE_DECODER);
     }
+    ff_ni_stats_io_end(&s->stats, NI_SESSION_IO_READ);
 
     if (ret == 0) {
         s->eos = p_session_data->data.frame.end_of_stream;
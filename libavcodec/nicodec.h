@@ -35,6 +35,12 @@
 #include "bsf.h"
 #endif
 #include "libavutil/fifo.h"
+#include "libavutil/mastering_display_metadata.h"
+#include "ni_dec_prefetch.h"
+#include "ni_enc_pool.h"
+#include "ni_frame_ring.h"
+#include "ni_recycle_ring.h"
+#include "ni_session_stats.h"
 
 #include <ni_device_api.h>
 #include "libavutil/hwcontext_ni_quad.h"
@@ -45,6 +51,10 @@
 #define NI_NAL_PPS_BIT (0x01 << 2)
 #define NI_GENERATE_ALL_NAL_HEADER_BIT (0x01 << 3)
 
+/* packet props kept for the frames to come while prefetching, sized like
+ * the opaque pointers buffer */
+#define NI_DEC_PKT_PROPS_NB 30
+
 /* enum for specifying xcoder device/coder index; can be specified in either
    decoder or encoder options. */
 enum {
@@ -119,6 +129,18 @@ typedef struct XCoderDecContext {
     int custom_sei_type;
     int low_delay;
     int pkt_nal_bitmap;
+    int prefetch;
+
+    /* session threads when prefetch is set */
+    NIDecPrefetch *prefetcher;
+    AVPacket *pkt_props;            /* props of the frame being retrieved */
+    /* props of the packets written and not yet matched to a frame, oldest
+     * first; the submission thread runs ahead of the frames */
+    AVPacket *pkt_props_queue[NI_DEC_PKT_PROPS_NB];
+    int nb_pkt_props;
+
+    NISessionStats stats;
+    NILatencyHist receive_latency;
 } XCoderDecContext;
 
 typedef struct XCoderEncContext {
@@ -135,12 +157,8 @@ typedef struct XCoderEncContext {
     ni_device_context_t *rsrc_ctx;  /* resource management context */
     uint64_t xcode_load_pixel; /* xcode load in pixels by this encode task */
 
-#if LIBAVUTIL_VERSION_MAJOR >= 59 //7.0
-    AVFifo *fme_fifo;
-#else
-    // frame fifo, to be used for sequence change frame buffering
-    AVFifoBuffer *fme_fifo;
-#endif
+    // frames not sent yet: device write buffer full or sequence change ongoing
+    NIFrameRing fme_ring;
     int eos_fme_received;
     AVFrame buffered_fme; // buffered frame for sequence change handling
 
@@ -171,10 +189,9 @@ typedef struct XCoderEncContext {
     /* backup copy of original values of -enc command line option */
     int  orig_dev_enc_idx;
 
+    // hw frames sent to the device until it recycles them
     AVFrame *sframe_pool[MAX_NUM_FRAMEPOOL_HWAVFRAME];
-    int aFree_Avframes_list[MAX_NUM_FRAMEPOOL_HWAVFRAME + 1];
-    int freeHead;
-    int freeTail;
+    NIRecycleRing recycle_ring;
 
     /* below are all command line options */
     char *xcoder_opts;
@@ -186,6 +203,15 @@ typedef struct XCoderEncContext {
     int seqChangeCount;
     // actual enc_change_params is in ni_session_context !
 
+    NIEncPools pools;
+    // custom SEI NAL units of the frames being encoded, by pts % NI_FIFO_SZ
+    AVBufferRef *custom_sei_buf[NI_FIFO_SZ];
+    // HDR static metadata last handed to the session, which keeps their SEI
+    AVContentLightMetadata last_cll;
+    AVMasteringDisplayMetadata last_mdcv;
+
+    NISessionStats stats;
+
 } XCoderEncContext;
 
 // copy maximum number of bytes of a string from src to dst, ensuring null byte
@@ -213,6 +239,9 @@ int ff_xcoder_dec_receive(AVCodecContext *avctx,
                           AVFrame *frame,
                           bool wait);
 
+/* drop the props of the packets written while prefetching */
+void ff_xcoder_dec_pkt_props_flush(XCoderDecContext *s);
+
 int ff_xcoder_dec_is_flushing(AVCodecContext *avctx,
                               XCoderDecContext *s);
 
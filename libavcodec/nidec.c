@@ -40,6 +40,18 @@ int xcoder_decode_close(AVCodecContext *avctx) {
     XCoderDecContext *s = avctx->priv_data;
     av_log(avctx, AV_LOG_VERBOSE, "XCoder decode close\n");
 
+    ff_ni_stats_report(avctx, &s->stats);
+    ff_ni_latency_report(avctx, "receive_frame", &s->receive_latency);
+
+    /* the session threads go before the session */
+    if (s->prefetcher) {
+        ff_ni_dec_prefetch_report(s->prefetcher);
+        ff_ni_dec_prefetch_free(&s->prefetcher);
+    }
+    av_packet_free(&s->pkt_props);
+    for (int j = 0; j < NI_DEC_PKT_PROPS_NB; j++)
+        av_packet_free(&s->pkt_props_queue[j]);
+
     /* this call shall release resource based on s->api_ctx */
     ff_xcoder_dec_close(avctx, s);
 
@@ -259,6 +271,55 @@ static int xcoder_setup_decoder(AVCodecContext *avctx) {
     return 0;
 }
 
+static int prefetch_send(void *opaque, AVPacket *pkt)
+{
+    AVCodecContext *avctx = opaque;
+
+    return ff_xcoder_dec_send(avctx, avctx->priv_data, pkt);
+}
+
+static int prefetch_receive(void *opaque, AVFrame *frame)
+{
+    AVCodecContext *avctx = opaque;
+
+    return ff_xcoder_dec_receive(avctx, avctx->priv_data, frame, true);
+}
+
+static const NIDecPrefetchOps prefetch_ops = {
+    .send    = prefetch_send,
+    .receive = prefetch_receive,
+};
+
+static int xcoder_setup_prefetch(AVCodecContext *avctx)
+{
+    XCoderDecContext *s = avctx->priv_data;
+    int ret;
+
+#if LIBAVCODEC_VERSION_MAJOR >= 61
+    s->pkt_props = av_packet_alloc();
+    if (!s->pkt_props)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < NI_DEC_PKT_PROPS_NB; i++) {
+        s->pkt_props_queue[i] = av_packet_alloc();
+        if (!s->pkt_props_queue[i])
+            return AVERROR(ENOMEM);
+    }
+
+    ret = ff_ni_dec_prefetch_alloc(&s->prefetcher, &prefetch_ops, avctx, avctx,
+                                   s->prefetch);
+    if (ret == AVERROR(ENOSYS)) {
+        av_log(avctx, AV_LOG_WARNING, "prefetch needs threads, decoding on "
+               "the calling thread\n");
+        ret = 0;
+    }
+#else
+    av_log(avctx, AV_LOG_WARNING, "prefetch needs FFmpeg 7.0 or later, "
+           "decoding on the calling thread\n");
+    ret = 0;
+#endif
+    return ret;
+}
+
 int xcoder_decode_init(AVCodecContext *avctx) {
 #if LIBAVCODEC_VERSION_MAJOR >= 60
     int i;
@@ -424,6 +485,10 @@ int xcoder_decode_init(AVCodecContext *avctx) {
     }
 #endif
 
+    /* kept over a reset */
+    if (s->prefetch && !s->pkt_props)
+        ret = xcoder_setup_prefetch(avctx);
+
 done:
     return ret;
 }
@@ -477,12 +542,11 @@ static int xcoder_send_receive(AVCodecContext *avctx, XCoderDecContext *s,
     return ff_xcoder_dec_receive(avctx, s, frame, wait);
 }
 
-int xcoder_receive_frame(AVCodecContext *avctx, AVFrame *frame) {
+static int receive_frame(AVCodecContext *avctx, AVFrame *frame) {
     XCoderDecContext *s = avctx->priv_data;
     const AVPixFmtDescriptor *desc;
     int ret;
 
-    av_log(avctx, AV_LOG_VERBOSE, "XCoder receive frame\n");
     /*
      * After we have buffered an input packet, check if the codec is in the
      * flushing state. If it is, we need to call ff_xcoder_dec_flush.
@@ -563,8 +627,78 @@ int xcoder_receive_frame(AVCodecContext *avctx, AVFrame *frame) {
     return xcoder_send_receive(avctx, s, frame, true);
 }
 
+/*
+ * The session threads write the packets and build the frames, this only
+ * moves packets in and prepared frames out. It waits on the threads only
+ * when the packet queue is full or the input has ended.
+ */
+static int receive_frame_prefetch(AVCodecContext *avctx, AVFrame *frame) {
+    XCoderDecContext *s = avctx->priv_data;
+    int block = 0;
+    int ret;
+
+    if (ff_xcoder_dec_is_flushing(avctx, s)) {
+        if (!ff_xcoder_dec_flush(avctx, s)) {
+            return AVERROR(EAGAIN);
+        }
+    }
+
+    for (;;) {
+        ret = ff_ni_dec_prefetch_receive(s->prefetcher, frame, block);
+        if (NI_RETCODE_ERROR_VPU_RECOVERY == ret) {
+            ff_ni_dec_prefetch_flush(s->prefetcher);
+            ret = xcoder_decode_reset(avctx);
+            return ret ? ret : AVERROR(EAGAIN);
+        } else if (ret != AVERROR(EAGAIN)) {
+            return ret;
+        }
+
+        if (s->buffered_pkt.size == 0) {
+            ret = ff_decode_get_packet(avctx, &s->buffered_pkt);
+            if (ret == AVERROR_EOF) {
+                /* queue the end of the input, retried while the queue is full */
+                ret = ff_ni_dec_prefetch_submit(s->prefetcher, NULL);
+                if (ret < 0 && ret != AVERROR(EAGAIN))
+                    return ret;
+                block = 1;
+                continue;
+            } else if (ret < 0) {
+                return ret;
+            }
+        }
+
+        ret = ff_ni_dec_prefetch_submit(s->prefetcher, &s->buffered_pkt);
+        if (ret < 0 && ret != AVERROR(EAGAIN))
+            return ret;
+        block = ret == AVERROR(EAGAIN);
+    }
+}
+
+int xcoder_receive_frame(AVCodecContext *avctx, AVFrame *frame) {
+    XCoderDecContext *s = avctx->priv_data;
+    int ret;
+
+    av_log(avctx, AV_LOG_VERBOSE, "XCoder receive frame\n");
+
+    ff_ni_stats_enter(&s->stats);
+    if (s->prefetcher)
+        ret = receive_frame_prefetch(avctx, frame);
+    else
+        ret = receive_frame(avctx, frame);
+    ff_ni_stats_leave(&s->stats);
+    if (!ret)
+        ff_ni_latency_add(&s->receive_latency,
+                          av_gettime_relative() - s->stats.entry_start);
+
+    return ret;
+}
+
 void xcoder_decode_flush(AVCodecContext *avctx) {
     XCoderDecContext *s = avctx->priv_data;
+    if (s->prefetcher) {
+        ff_ni_dec_prefetch_flush(s->prefetcher);
+        ff_xcoder_dec_pkt_props_flush(s);
+    }
     ni_device_dec_session_flush(&s->api_ctx);
     s->draining = 0;
     s->flushing = 0;
@@ -71,7 +71,10 @@
     \
     { "keep_alive_timeout", "Specify a custom session keep alive timeout in seconds.", \
       OFFSETDEC(keep_alive_timeout), AV_OPT_TYPE_INT, {.i64 = NI_DEFAULT_KEEP_ALIVE_TIMEOUT}, \
-      NI_MIN_KEEP_ALIVE_TIMEOUT, NI_MAX_KEEP_ALIVE_TIMEOUT, VD, "keep_alive_timeout"}
+      NI_MIN_KEEP_ALIVE_TIMEOUT, NI_MAX_KEEP_ALIVE_TIMEOUT, VD, "keep_alive_timeout"}, \
+    \
+    { "prefetch", "Number of frames prepared ahead on session threads, 0 to decode on the calling thread.", \
+      OFFSETDEC(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, NI_DEC_PREFETCH_MAX, VD, "prefetch"}
 
 #define NI_DEC_OPTION_SEI_PASSTHRU\
     { "user_data_sei_passthru", "Enable user data unregistered SEI passthrough.", \
@@ -285,6 +285,22 @@ static int xcoder_encoder_header_check_set(AVCodecContext *avctx)
     return 0;
 }
 
+#define NI_FRAME_QUEUE_MARGIN 8
+
+/*
+ * The input queue only has to absorb what arrives while the device cannot
+ * take frames: its lookahead and reordering window fill up on a sequence
+ * change drain, a few more cover write buffer full bursts. Beyond that the
+ * encoder refuses input and the caller gets EAGAIN.
+ */
+static int frame_queue_size(const XCoderEncContext *s)
+{
+    int size = NI_FRAME_QUEUE_MARGIN + s->api_param.cfg_enc_params.lookAheadDepth +
+               s->dtsOffset + 1;
+
+    return av_clip(size, NI_FRAME_QUEUE_MARGIN, NI_MAX_FIFO_CAPACITY);
+}
+
 static int xcoder_setup_encoder(AVCodecContext *avctx)
 {
     XCoderEncContext *s = avctx->priv_data;
@@ -328,26 +344,6 @@ static int xcoder_setup_encoder(AVCodecContext *avctx)
     s->latest_dts = 0;
     s->first_frame_pts = INT_MIN;
 
-    if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING != s->api_ctx.session_run_state) {
-        av_log(avctx, AV_LOG_INFO, "Session state: %d allocate frame fifo.\n",
-               s->api_ctx.session_run_state);
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        s->fme_fifo = av_fifo_alloc2((size_t) 1, sizeof(AVFrame), 0);
-#else
-        s->fme_fifo = av_fifo_alloc(sizeof(AVFrame));
-#endif
-    } else {
-        av_log(avctx, AV_LOG_INFO, "Session seq change, fifo size: %lu.\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-               av_fifo_can_read(s->fme_fifo));
-#else
-               av_fifo_size(s->fme_fifo) / sizeof(AVFrame));
-#endif
-    }
-
-    if (!s->fme_fifo) {
-        return AVERROR(ENOMEM);
-    }
     s->eos_fme_received = 0;
 
     //Xcoder User Configuration
@@ -687,6 +683,19 @@ static int xcoder_setup_encoder(AVCodecContext *avctx)
     }
     av_log(avctx, AV_LOG_VERBOSE, "dts offset set to %ld\n", s->dtsOffset);
 
+    if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING != s->api_ctx.session_run_state) {
+        int queue_size = frame_queue_size(s);
+
+        av_log(avctx, AV_LOG_INFO, "Session state: %d allocate frame queue of %d.\n",
+               s->api_ctx.session_run_state, queue_size);
+        ret = ff_ni_frame_ring_init(&s->fme_ring, queue_size);
+        if (ret < 0)
+            return ret;
+    } else {
+        av_log(avctx, AV_LOG_INFO, "Session seq change, frame queue: %d of %d.\n",
+               s->fme_ring.nb_frames, s->fme_ring.size);
+    }
+
     s->total_frames_received = 0;
     s->gop_offset_count = 0;
     av_log(avctx, AV_LOG_INFO, "dts offset: %ld, gop_offset_count: %d\n",
@@ -746,17 +755,16 @@ static int xcoder_setup_encoder(AVCodecContext *avctx)
     }
 
     if (1) {
-        s->freeHead = 0;
-        s->freeTail = 0;
         for (i = 0; i < MAX_NUM_FRAMEPOOL_HWAVFRAME; i++) {
             s->sframe_pool[i] = av_frame_alloc();
             if (!s->sframe_pool[i]) {
                 return AVERROR(ENOMEM);
             }
-            s->aFree_Avframes_list[i] = i;
-            s->freeTail++;
         }
-        s->aFree_Avframes_list[i] = -1;
+        ret = ff_ni_recycle_ring_init(&s->recycle_ring, MAX_NUM_FRAMEPOOL_HWAVFRAME);
+        if (ret < 0) {
+            return ret;
+        }
     }
 
     // init HDR SEI stuff
@@ -854,6 +862,9 @@ int xcoder_encode_close(AVCodecContext *avctx)
         av_frame_free(&(ctx->sframe_pool[i])); //any remaining stored AVframes that have not been unref will die here
         ctx->sframe_pool[i] = NULL;
     }
+    ff_ni_recycle_ring_uninit(&ctx->recycle_ring);
+
+    ff_ni_stats_report(avctx, &ctx->stats);
 
     ret = ni_device_session_close(&ctx->api_ctx, ctx->encoder_eof,
                                   NI_DEVICE_TYPE_ENCODER);
@@ -888,20 +899,15 @@ int xcoder_encode_close(AVCodecContext *avctx)
         ctx->api_pkt.data.packet.av1_buffer_index)
         ni_packet_buffer_free_av1(&(ctx->api_pkt.data.packet));
 
-    av_log(avctx, AV_LOG_DEBUG, "fifo num frames: %lu\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-           av_fifo_can_read(ctx->fme_fifo));
-#else
-           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+    for (int i = 0; i < NI_FIFO_SZ; i++)
+        av_buffer_unref(&ctx->custom_sei_buf[i]);
+
+    av_log(avctx, AV_LOG_DEBUG, "queue num frames: %d\n", ctx->fme_ring.nb_frames);
     if (ctx->api_ctx.session_run_state != SESSION_RUN_STATE_SEQ_CHANGE_DRAINING) {
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_freep2(&ctx->fme_fifo);
-#else
-        if (ctx->fme_fifo)
-            av_fifo_free(ctx->fme_fifo);
-        ctx->fme_fifo = NULL;
-#endif
+        ff_ni_frame_ring_report(&ctx->fme_ring, avctx);
+        ff_ni_frame_ring_uninit(&ctx->fme_ring);
+        ff_ni_enc_pools_uninit(&ctx->pools);
+        av_frame_unref(&ctx->buffered_fme);
         av_log(avctx, AV_LOG_DEBUG, " , freed.\n");
     } else {
         av_log(avctx, AV_LOG_DEBUG, " , kept.\n");
@@ -1017,96 +1023,35 @@ static int xcoder_encode_reset(AVCodecContext *avctx)
     return xcoder_encode_init(avctx);
 }
 
-// frame fifo operations
+// frame queue operations
 static int is_input_fifo_empty(XCoderEncContext *s)
 {
-    if (!s->fme_fifo) {
-        return 1;
-    }
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-    return av_fifo_can_read(s->fme_fifo) ? 0 : 1;
-#else
-    return av_fifo_size(s->fme_fifo) < sizeof(AVFrame);
-#endif
+    return !s->fme_ring.nb_frames;
 }
 
 static int enqueue_frame(AVCodecContext *avctx, const AVFrame *inframe)
 {
     XCoderEncContext *ctx = avctx->priv_data;
-    size_t nb_elems;
-    int ret = 0;
-
-    // expand frame buffer fifo if not enough space
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-    if (!av_fifo_can_write(ctx->fme_fifo)) {
-#else
-    if (av_fifo_space(ctx->fme_fifo) < sizeof(AVFrame)) {
-#endif
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        if (av_fifo_can_read(ctx->fme_fifo) >= NI_MAX_FIFO_CAPACITY) {
-            av_log(avctx, AV_LOG_ERROR, "Encoder frame buffer fifo capacity (%lu) reached maximum (%d)\n",
-                   av_fifo_can_read(ctx->fme_fifo), NI_MAX_FIFO_CAPACITY);
-            return AVERROR_EXTERNAL;
-#else
-        if (av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame) >= NI_MAX_FIFO_CAPACITY) {
-            av_log(avctx, AV_LOG_ERROR, "Encoder frame buffer fifo capacity (%lu) reached maximum (%d)\n",
-                   av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame), NI_MAX_FIFO_CAPACITY);
-            return AVERROR_EXTERNAL;
-#endif
-        }
-
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        ret = av_fifo_grow2(ctx->fme_fifo, (size_t) 1);
-#else
-        ret = av_fifo_grow(ctx->fme_fifo, sizeof(AVFrame));
-#endif
-        if (ret < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Cannot grow FIFO: out of memory\n");
-            return ret;
-        }
-
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        nb_elems = av_fifo_can_read(ctx->fme_fifo) + av_fifo_can_write(ctx->fme_fifo);
-#else
-        nb_elems = (av_fifo_size(ctx->fme_fifo) + av_fifo_space(ctx->fme_fifo)) / sizeof(AVFrame);
-#endif
-        if ((nb_elems % 100) == 0) {
-            av_log(avctx, AV_LOG_INFO, "Enc fifo being extended to: %lu\n", nb_elems);
-        }
-#if (LIBAVUTIL_VERSION_MAJOR < 59)
-        av_assert0(0 == (av_fifo_size(ctx->fme_fifo) + av_fifo_space(ctx->fme_fifo)) % sizeof(AVFrame));
-#endif
-    }
+    int ret;
 
-    if (inframe == &ctx->buffered_fme) {
-        // For FFmpeg-n4.4+ receive_packet interface the buffered_fme is fetched from
-        // ff_alloc_get_frame rather than passed as function argument. So we need to
-        // judge whether they are the same object. If they are the same NO need to do
-        // any reference before queue operation.
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_write(ctx->fme_fifo, (void *)inframe, (size_t) 1);
-#else
-        av_fifo_generic_write(ctx->fme_fifo, (void *)inframe, sizeof(*inframe), NULL);
-#endif
-    } else {
-        AVFrame temp_frame;
-        memset(&temp_frame, 0, sizeof(AVFrame));
-        // In case double free for external input frame and our buffered frame.
-        av_frame_ref(&temp_frame, inframe);
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_write(ctx->fme_fifo, &temp_frame, 1);
-#else
-        av_fifo_generic_write(ctx->fme_fifo, &temp_frame, sizeof(*inframe), NULL);
-#endif
+    // For FFmpeg-n4.4+ receive_packet interface the buffered_fme is fetched from
+    // ff_alloc_get_frame rather than passed as function argument, the queue
+    // takes its references then; an external input frame gets referenced.
+    if (inframe == &ctx->buffered_fme)
+        ret = ff_ni_frame_ring_push(&ctx->fme_ring, &ctx->buffered_fme, 1);
+    else
+        ret = ff_ni_frame_ring_push(&ctx->fme_ring, (AVFrame *)inframe, 0);
+    if (ret == AVERROR(EAGAIN)) {
+        av_log(avctx, AV_LOG_DEBUG, "Encoder frame queue full (%d)\n",
+               ctx->fme_ring.size);
+        return ret;
+    } else if (ret < 0) {
+        return ret;
     }
 
-    av_log(avctx, AV_LOG_DEBUG, "fme queued, fifo num frames: %lu\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-           av_fifo_can_read(ctx->fme_fifo));
-#else
-           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
-    return ret;
+    av_log(avctx, AV_LOG_DEBUG, "fme queued, queue num frames: %d\n",
+           ctx->fme_ring.nb_frames);
+    return 0;
 }
 
 int xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
@@ -1118,7 +1063,7 @@ int xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
     int format_in_use;
     int ret = 0;
     int sent;
-    int i, j;
+    int i;
     int orig_avctx_width = avctx->width;
     int orig_avctx_height = avctx->height;
     ni_xcoder_params_t *p_param;
@@ -1154,15 +1099,8 @@ int xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
     // its stride size is known and handled accordingly.
     if (ctx->started == 0) {
         if (!is_input_fifo_empty(ctx)) {
-            av_log(avctx, AV_LOG_VERBOSE, "first frame: use fme from fifo peek\n");
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-            av_fifo_peek(ctx->fme_fifo, &ctx->buffered_fme, (size_t) 1, NULL);
-#else
-            av_fifo_generic_peek(ctx->fme_fifo, &ctx->buffered_fme, sizeof(AVFrame),
-                               NULL);
-#endif
-            ctx->buffered_fme.extended_data = ctx->buffered_fme.data;
-            first_frame = &ctx->buffered_fme;
+            av_log(avctx, AV_LOG_VERBOSE, "first frame: use fme from queue peek\n");
+            first_frame = ff_ni_frame_ring_peek(&ctx->fme_ring);
 
         } else if (frame) {
             av_log(avctx, AV_LOG_VERBOSE, "first frame: use input frame\n");
@@ -1172,15 +1110,8 @@ int xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
         }
     } else if (ctx->api_ctx.session_run_state == SESSION_RUN_STATE_SEQ_CHANGE_OPENING) {
         if (!is_input_fifo_empty(ctx)) {
-            av_log(avctx, AV_LOG_VERBOSE, "first frame: use fme from fifo peek\n");
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-            av_fifo_peek(ctx->fme_fifo, &ctx->buffered_fme, (size_t) 1, NULL);
-#else
-            av_fifo_generic_peek(ctx->fme_fifo, &ctx->buffered_fme, sizeof(AVFrame),
-                               NULL);
-#endif
-            ctx->buffered_fme.extended_data = ctx->buffered_fme.data;
-            first_frame = &ctx->buffered_fme;
+            av_log(avctx, AV_LOG_VERBOSE, "first frame: use fme from queue peek\n");
+            first_frame = ff_ni_frame_ring_peek(&ctx->fme_ring);
         } else {
             av_log(avctx, AV_LOG_ERROR, "No buffered frame - Sequence Change Fail");
             ret = AVERROR_EXTERNAL;
@@ -1349,15 +1280,9 @@ int xcoder_send_frame(AVCodecContext *avctx, const AVFrame *frame)
             if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING !=
                 ctx->api_ctx.session_run_state) {
                 if (! is_input_fifo_empty(ctx)) {
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-                    av_fifo_drain2(ctx->fme_fifo, (size_t) 1);
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_can_read(ctx->fme_fifo));
-#else
-                    av_fifo_drain(ctx->fme_fifo, sizeof(AVFrame));
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+                    ff_ni_frame_ring_drop(&ctx->fme_ring);
+                    av_log(avctx, AV_LOG_DEBUG, "fme popped, queue num frames: %d\n",
+                           ctx->fme_ring.nb_frames);
                 }
             }
             ret = AVERROR_EXTERNAL;
@@ -1438,14 +1363,12 @@ resend:
                    "no frame in fifo to send, send eos ..\n");
         }
     } else {
-        av_log(avctx, AV_LOG_DEBUG, "fifo peek fme\n");
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-        av_fifo_peek(ctx->fme_fifo, &ctx->buffered_fme, (size_t) 1, NULL);
-#else
-        av_fifo_generic_peek(ctx->fme_fifo, &ctx->buffered_fme, sizeof(AVFrame),
-                             NULL);
-#endif
-        ctx->buffered_fme.extended_data = ctx->buffered_fme.data;
+        av_log(avctx, AV_LOG_DEBUG, "queue peek fme\n");
+        // the queue keeps its reference until the frame is sent
+        av_frame_unref(&ctx->buffered_fme);
+        ret = av_frame_ref(&ctx->buffered_fme, ff_ni_frame_ring_peek(&ctx->fme_ring));
+        if (ret < 0)
+            return ret;
     }
 
     if (!ctx->eos_fme_received) {
@@ -1723,7 +1646,12 @@ resend:
         if (!(p_param->cfg_enc_params.HDR10CLLEnable)) { // not user set
             side_data = av_frame_get_side_data(&ctx->buffered_fme, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
 
-            if (side_data && side_data->size == sizeof(AVContentLightMetadata)) {
+            // the session keeps the SEI it last serialized and repeats it as
+            // required, so only hand it over again when the metadata changes
+            if (side_data && side_data->size == sizeof(AVContentLightMetadata) &&
+                (!ctx->api_ctx.light_level_data_len ||
+                 memcmp(&ctx->last_cll, side_data->data, side_data->size))) {
+                memcpy(&ctx->last_cll, side_data->data, side_data->size);
                 aux_data = ni_frame_new_aux_data(
                     &dec_frame, NI_FRAME_AUX_DATA_CONTENT_LIGHT_LEVEL,
                     sizeof(ni_content_light_level_t));
@@ -1751,7 +1679,10 @@ resend:
         // mastering display color volume
         if (!(p_param->cfg_enc_params.HDR10Enable)) { // not user set
             side_data = av_frame_get_side_data(&ctx->buffered_fme, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
-            if (side_data && side_data->size == sizeof(AVMasteringDisplayMetadata)) {
+            if (side_data && side_data->size == sizeof(AVMasteringDisplayMetadata) &&
+                (!ctx->api_ctx.sei_hdr_mastering_display_color_vol_len ||
+                 memcmp(&ctx->last_mdcv, side_data->data, side_data->size))) {
+                memcpy(&ctx->last_mdcv, side_data->data, side_data->size);
                 aux_data = ni_frame_new_aux_data(
                     &dec_frame, NI_FRAME_AUX_DATA_MASTERING_DISPLAY_METADATA,
                     sizeof(ni_mastering_display_metadata_t));
@@ -1870,98 +1801,23 @@ resend:
                                        AV_FRAME_DATA_NETINT_CUSTOM_SEI);
     if (side_data && side_data->size > 0) {
         int64_t local_pts = ctx->buffered_fme.pts;
-        uint8_t *p_src_sei_data, *p_dst_sei_data;
-        int sei_size;
-        uint8_t sei_type;
-        int size;
-        ni_custom_sei_set_t *src_custom_sei_set, *dst_custom_sei_set;
-        ni_custom_sei_t *p_src_custom_sei, *p_dst_custom_sei;
+        AVBufferRef **custom_sei_buf = &ctx->custom_sei_buf[local_pts % NI_FIFO_SZ];
 
         // if one picture can be skipped, nienc will send that frame but will not
-        // receive packet, therefore it will skip the free in receive packet as
-        // well and cause memory leak. So check the last pkt_custom_sei_set has
-        // been released or not.
-        dst_custom_sei_set = ctx->api_ctx.pkt_custom_sei_set[local_pts % NI_FIFO_SZ];
-        if (dst_custom_sei_set) {
-            free(dst_custom_sei_set);
-        }
-
-        /* copy the whole SEI data */
-        src_custom_sei_set = (ni_custom_sei_set_t *)side_data->data;
-        dst_custom_sei_set = malloc(sizeof(ni_custom_sei_set_t));
-        if (dst_custom_sei_set == NULL) {
+        // receive packet, so the set of the last frame in this slot may not
+        // have been released yet.
+        av_buffer_unref(custom_sei_buf);
+
+        *custom_sei_buf = ff_ni_enc_custom_sei(&ctx->pools, avctx->codec_id,
+                                               (ni_custom_sei_set_t *)side_data->data,
+                                               avctx);
+        if (!*custom_sei_buf) {
             av_log(avctx, AV_LOG_ERROR, "failed to allocate memory for custom sei data\n");
             ret = AVERROR(ENOMEM);
             return ret;
         }
-        memset(dst_custom_sei_set, 0, sizeof(ni_custom_sei_set_t));
-
-        /* fill sei data */
-        for (i = 0; i < src_custom_sei_set->count; i++) {
-            int len;
-            p_src_custom_sei = &src_custom_sei_set->custom_sei[i];
-            sei_size = p_src_custom_sei->size;
-            sei_type = p_src_custom_sei->type;
-            p_src_sei_data = &p_src_custom_sei->data[0];
-
-            p_dst_custom_sei = &dst_custom_sei_set->custom_sei[i];
-            p_dst_sei_data = &p_dst_custom_sei->data[0];
-            size = 0;
-
-            // long start code
-            p_dst_sei_data[size++] = 0x00;
-            p_dst_sei_data[size++] = 0x00;
-            p_dst_sei_data[size++] = 0x00;
-            p_dst_sei_data[size++] = 0x01;
-
-            if (AV_CODEC_ID_H264 == avctx->codec_id) {
-                p_dst_sei_data[size++] = 0x06;   //nal type: SEI
-            } else {
-                p_dst_sei_data[size++] = 0x4e;   //nal type: SEI
-                p_dst_sei_data[size++] = 0x01;
-            }
-
-            // SEI type
-            p_dst_sei_data[size++] = sei_type;
-
-            // original payload size
-            len = sei_size;
-            while (len >= 0) {
-                p_dst_sei_data[size++] = len > 0xff ? 0xff : len;
-                len -= 0xff;
-            }
-
-            // payload data
-            for (j = 0; j < sei_size && size < NI_MAX_CUSTOM_SEI_DATA - 1; j++) {
-                if (j >= 2 && !p_dst_sei_data[size - 2] && !p_dst_sei_data[size - 1] && p_src_sei_data[j] <= 0x03) {
-                    /* insert 0x3 as emulation_prevention_three_byte */
-                    p_dst_sei_data[size++] = 0x03;
-                }
-                p_dst_sei_data[size++] = p_src_sei_data[j];
-            }
-
-            if (j != sei_size) {
-                av_log(avctx, AV_LOG_WARNING, "%s: sei RBSP size out of limit(%d), "
-                       "idx=%u, type=%u, size=%d, custom_sei_loc=%d.\n", __func__,
-                       NI_MAX_CUSTOM_SEI_DATA, i, sei_type, sei_size, p_src_custom_sei->location);
-                free(dst_custom_sei_set);
-                break;
-            }
-
-            // trailing byte
-            p_dst_sei_data[size++] = 0x80;
-
-            p_dst_custom_sei->size = size;
-            p_dst_custom_sei->type = sei_type;
-            p_dst_custom_sei->location = p_src_custom_sei->location;
-            av_log(avctx, AV_LOG_TRACE, "%s: custom sei idx %d type %u len %d loc %d.\n",
-                   __func__, i, sei_type, size, p_dst_custom_sei->location);
-        }
-
-        dst_custom_sei_set->count = src_custom_sei_set->count;
-        ctx->api_ctx.pkt_custom_sei_set[local_pts % NI_FIFO_SZ] = dst_custom_sei_set;
-        av_log(avctx, AV_LOG_TRACE, "%s: sei number %d pts %" PRId64 ".\n",
-               __func__, dst_custom_sei_set->count, local_pts);
+        av_log(avctx, AV_LOG_TRACE, "%s: sei number %d pts %" PRId64 ".\n", __func__,
+               ((ni_custom_sei_set_t *)(*custom_sei_buf)->data)->count, local_pts);
     }
 
     if (ctx->api_fme.data.frame.sei_total_len > NI_ENC_MAX_SEI_BUF_SIZE) {
@@ -2247,7 +2103,9 @@ resend:
 
     } // end non seq change
 
+    ff_ni_stats_io_begin(&ctx->stats);
     sent = ni_device_session_write(&ctx->api_ctx, &ctx->api_fme, NI_DEVICE_TYPE_ENCODER);
+    ff_ni_stats_io_end(&ctx->stats, NI_SESSION_IO_WRITE);
 
     av_log(avctx, AV_LOG_DEBUG, "xcoder_send_frame: size %d sent to xcoder\n", sent);
 
@@ -2313,45 +2171,26 @@ resend:
                         (avctx->width >= NI_MIN_WIDTH);
 
             if (!ctx->eos_fme_received && ishwframe) {
-                av_log(avctx, AV_LOG_TRACE, "AVframe_index = %d at head %d\n",
-                       ctx->aFree_Avframes_list[ctx->freeHead], ctx->freeHead);
-                av_frame_ref(
-                    ctx->sframe_pool[ctx->aFree_Avframes_list[ctx->freeHead]],
-                    &ctx->buffered_fme);
-                av_log(avctx, AV_LOG_TRACE,
-                       "AVframe_index = %d popped from free head %d\n",
-                       ctx->aFree_Avframes_list[ctx->freeHead], ctx->freeHead);
-                av_log(avctx, AV_LOG_TRACE,
-                       "ctx->buffered_fme.data[3] %p sframe_pool[%d]->data[3] %p\n",
-                       ctx->buffered_fme.data[3],
-                       ctx->aFree_Avframes_list[ctx->freeHead],
-                       ctx->sframe_pool[ctx->aFree_Avframes_list[ctx->freeHead]]
-                           ->data[3]);
-                if (ctx->sframe_pool[ctx->aFree_Avframes_list[ctx->freeHead]]
-                        ->data[3]) {
-                    av_log(avctx, AV_LOG_DEBUG,
-                           "nienc.c sframe_pool[%d] trace ui16FrameIdx = [%u] sent\n",
-                           ctx->aFree_Avframes_list[ctx->freeHead],
-                           ((niFrameSurface1_t
-                                 *)((uint8_t *)ctx
-                                        ->sframe_pool
-                                            [ctx->aFree_Avframes_list[ctx->freeHead]]
-                                        ->data[3]))
-                               ->ui16FrameIdx);
-                    av_log(
-                        avctx, AV_LOG_TRACE,
-                        "xcoder_send_frame: after ref sframe_pool, hw frame "
-                        "av_buffer_get_ref_count=%d, data[3]=%p\n",
-                        av_buffer_get_ref_count(
-                            ctx->sframe_pool[ctx->aFree_Avframes_list[ctx->freeHead]]
-                                ->buf[0]),
-                        ctx->sframe_pool[ctx->aFree_Avframes_list[ctx->freeHead]]
-                            ->data[3]);
-                }
-                if (deq_free_frames(ctx) != 0) {
+                niFrameSurface1_t *surface = (niFrameSurface1_t *)ctx->buffered_fme.data[3];
+                int avframe_index = ff_ni_recycle_ring_acquire(&ctx->recycle_ring,
+                                                               surface->ui16FrameIdx);
+                if (avframe_index < 0) {
                     ret = AVERROR_EXTERNAL;
                     return ret;
                 }
+                ret = av_frame_ref(ctx->sframe_pool[avframe_index], &ctx->buffered_fme);
+                if (ret < 0) {
+                    ff_ni_recycle_ring_release(&ctx->recycle_ring, surface->ui16FrameIdx);
+                    return ret;
+                }
+                av_log(avctx, AV_LOG_DEBUG,
+                       "nienc.c sframe_pool[%d] trace ui16FrameIdx = [%u] sent\n",
+                       avframe_index, surface->ui16FrameIdx);
+                av_log(avctx, AV_LOG_TRACE,
+                       "xcoder_send_frame: after ref sframe_pool, hw frame "
+                       "av_buffer_get_ref_count=%d, data[3]=%p\n",
+                       av_buffer_get_ref_count(ctx->sframe_pool[avframe_index]->buf[0]),
+                       ctx->sframe_pool[avframe_index]->data[3]);
             }
 
             // only if it's NOT sequence change flushing (in which case only the eos
@@ -2360,15 +2199,9 @@ resend:
             if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING !=
                 ctx->api_ctx.session_run_state) {
                 if (!is_input_fifo_empty(ctx)) {
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-                    av_fifo_drain2(ctx->fme_fifo, (size_t) 1);
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_can_read(ctx->fme_fifo));
-#else
-                    av_fifo_drain(ctx->fme_fifo, sizeof(AVFrame));
-                    av_log(avctx, AV_LOG_DEBUG, "fme popped, fifo num frames: %lu\n",
-                           av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+                    ff_ni_frame_ring_drop(&ctx->fme_ring);
+                    av_log(avctx, AV_LOG_DEBUG, "fme popped, queue num frames: %d\n",
+                           ctx->fme_ring.nb_frames);
                 }
                 av_frame_unref(&ctx->buffered_fme);
                 ishwframe = (ctx->buffered_fme.format == AV_PIX_FMT_NI_QUAD) &&
@@ -2406,12 +2239,8 @@ resend:
     // fifo because its size increases with seqchange.
     if (ret == 0 && frame && !is_input_fifo_empty(ctx) &&
         SESSION_RUN_STATE_SEQ_CHANGE_DRAINING != ctx->api_ctx.session_run_state) {
-        av_log(avctx, AV_LOG_DEBUG, "try to flush encoder input fifo. Fifo num frames: %lu\n",
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-               av_fifo_can_read(ctx->fme_fifo));
-#else
-               av_fifo_size(ctx->fme_fifo) / sizeof(AVFrame));
-#endif
+        av_log(avctx, AV_LOG_DEBUG, "try to flush encoder input fifo. Queue num frames: %d\n",
+               ctx->fme_ring.nb_frames);
         goto resend;
     }
 
@@ -2437,7 +2266,7 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
     int pix_fmt = AV_PIX_FMT_YUV420P;
     int stride, ori_stride;
     bool bIsSmallPicture = false;
-    AVFrame temp_frame;
+    const AVFrame *temp_frame;
     ni_xcoder_params_t *p_param = &ctx->api_param;
 
     ff_xcoder_strncpy(tmp_blk_dev_name, ctx->api_ctx.blk_dev_name,
@@ -2445,17 +2274,14 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
 
     // re-init avctx's resolution to the changed one that is
     // stored in the first frame of the fifo
-#if (LIBAVUTIL_VERSION_MAJOR >= 59)
-    av_fifo_peek(ctx->fme_fifo, &temp_frame, (size_t) 1, NULL);
-#else
-    av_fifo_generic_peek(ctx->fme_fifo, &temp_frame, sizeof(AVFrame), NULL);
-#endif
-    temp_frame.extended_data = temp_frame.data;
+    temp_frame = ff_ni_frame_ring_peek(&ctx->fme_ring);
+    if (!temp_frame)
+        return AVERROR_BUG;
 
-    ishwframe = temp_frame.format == AV_PIX_FMT_NI_QUAD;
+    ishwframe = temp_frame->format == AV_PIX_FMT_NI_QUAD;
 
     if (ishwframe) {
-        bit_depth = (uint8_t)((niFrameSurface1_t*)((uint8_t*)temp_frame.data[3]))->bit_depth;
+        bit_depth = (uint8_t)((niFrameSurface1_t*)((uint8_t*)temp_frame->data[3]))->bit_depth;
         av_log(avctx, AV_LOG_INFO, "xcoder_receive_packet hw frame bit depth "
                "changing %d -> %d\n",
                ctx->api_ctx.bit_depth_factor, bit_depth);
@@ -2527,7 +2353,7 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
                 break;
         }
     } else {
-        switch (temp_frame.format) {
+        switch (temp_frame->format) {
             case AV_PIX_FMT_YUV420P:
             case AV_PIX_FMT_YUVJ420P:
                 pix_fmt = NI_PIX_FMT_YUV420P;
@@ -2565,11 +2391,11 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
 
     // check if resolution is zero copy compatible and set linesize according to new resolution
     if (ni_encoder_frame_zerocopy_check(&ctx->api_ctx,
-        p_param, temp_frame.width, temp_frame.height,
-        (const int *)temp_frame.linesize, true) == NI_RETCODE_SUCCESS) {
+        p_param, temp_frame->width, temp_frame->height,
+        (const int *)temp_frame->linesize, true) == NI_RETCODE_SUCCESS) {
         stride = p_param->luma_linesize; // new sequence is zero copy compatible
     } else {
-        stride = FFALIGN(temp_frame.width*bit_depth, 128);
+        stride = FFALIGN(temp_frame->width*bit_depth, 128);
     }
 
     if (ctx->api_ctx.ori_luma_linesize && ctx->api_ctx.ori_chroma_linesize) {
@@ -2582,7 +2408,7 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
        || pix_fmt == NI_PIX_FMT_ABGR
        || pix_fmt == NI_PIX_FMT_RGBA
        || pix_fmt == NI_PIX_FMT_BGRA) {
-        stride = temp_frame.width;
+        stride = temp_frame->width;
         ori_stride = ctx->api_ctx.ori_width;
     }
 
@@ -2594,13 +2420,13 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
                ctx->api_param.cfg_enc_params.lookAheadDepth,
                ctx->api_param.cfg_enc_params.crf,
                ctx->api_param.cfg_enc_params.crfFloat);
-        if ((temp_frame.width < NI_2PASS_ENCODE_MIN_WIDTH) ||
-            (temp_frame.height < NI_2PASS_ENCODE_MIN_HEIGHT)) {
+        if ((temp_frame->width < NI_2PASS_ENCODE_MIN_WIDTH) ||
+            (temp_frame->height < NI_2PASS_ENCODE_MIN_HEIGHT)) {
             bIsSmallPicture = true;
         }
     } else {
-        if ((temp_frame.width < NI_MIN_WIDTH) ||
-           (temp_frame.height < NI_MIN_HEIGHT)) {
+        if ((temp_frame->width < NI_MIN_WIDTH) ||
+           (temp_frame->height < NI_MIN_HEIGHT)) {
             bIsSmallPicture = true;
         }
     }
@@ -2608,8 +2434,8 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
     if (ctx->api_param.cfg_enc_params.multicoreJointMode) {
         av_log(avctx, AV_LOG_DEBUG, "xcoder_encode_reinit multicore "
                "joint mode\n");
-        if ((temp_frame.width < 256) ||
-           (temp_frame.height < 256)) {
+        if ((temp_frame->width < 256) ||
+           (temp_frame->height < 256)) {
             bIsSmallPicture = true;
         }
     }
@@ -2626,17 +2452,17 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
            "original stride %d height %d pix fmt %d "
            "new stride %d height %d pix fmt %d \n",
            __func__, avctx->width, avctx->height,
-           temp_frame.width, temp_frame.height,
-           avctx->pix_fmt, temp_frame.format,
+           temp_frame->width, temp_frame->height,
+           avctx->pix_fmt, temp_frame->format,
            ori_stride, ctx->api_ctx.ori_height, ctx->api_ctx.ori_pix_fmt,
-           stride, temp_frame.height, pix_fmt);
+           stride, temp_frame->height, pix_fmt);
 
-    avctx->width = temp_frame.width;
-    avctx->height = temp_frame.height;
-    avctx->pix_fmt = temp_frame.format;
+    avctx->width = temp_frame->width;
+    avctx->height = temp_frame->height;
+    avctx->pix_fmt = temp_frame->format;
 
     // fast sequence change without close / open only if new resolution < original resolution
-    if ((ori_stride*ctx->api_ctx.ori_height < stride*temp_frame.height) ||
+    if ((ori_stride*ctx->api_ctx.ori_height < stride*temp_frame->height) ||
         (ctx->api_ctx.ori_pix_fmt != pix_fmt) ||
         bIsSmallPicture ||
         (avctx->codec_id == AV_CODEC_ID_MJPEG) ||
@@ -2646,8 +2472,8 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
         // clear crop parameters upon sequence change because cropping values may not be compatible to new resolution
         // (except for Motion Constrained mode 2, for which we crop to 64x64 alignment)
         if (ctx->api_param.cfg_enc_params.motionConstrainedMode == MOTION_CONSTRAINED_QUALITY_MODE && avctx->codec_id == AV_CODEC_ID_HEVC) {
-            ctx->api_param.cfg_enc_params.crop_width = (temp_frame.width / 64 * 64);
-            ctx->api_param.cfg_enc_params.crop_height = (temp_frame.height / 64 * 64);
+            ctx->api_param.cfg_enc_params.crop_width = (temp_frame->width / 64 * 64);
+            ctx->api_param.cfg_enc_params.crop_height = (temp_frame->height / 64 * 64);
             ctx->api_param.cfg_enc_params.hor_offset = ctx->api_param.cfg_enc_params.ver_offset = 0;
             av_log(avctx, AV_LOG_DEBUG, "xcoder_encode_reinit sets "
                    "crop width x height to %d x %d for Motion Constrained mode 2\n",
@@ -2660,17 +2486,17 @@ static int xcoder_encode_reinit(AVCodecContext *avctx)
     } else {
         if (avctx->codec_id == AV_CODEC_ID_AV1) {
             // AV1 8x8 alignment HW limitation is now worked around by FW cropping input resolution
-            if (temp_frame.width % NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT)
+            if (temp_frame->width % NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT)
                 av_log(avctx, AV_LOG_ERROR,
                        "resolution change: AV1 Picture Width not aligned to %d - picture will be cropped\n",
                        NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT);
 
-            if (temp_frame.height % NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT)
+            if (temp_frame->height % NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT)
                 av_log(avctx, AV_LOG_ERROR,
                        "resolution change: AV1 Picture Height not aligned to %d - picture will be cropped\n",
                        NI_PARAM_AV1_ALIGN_WIDTH_HEIGHT);
         }
-        ret = xcoder_encode_sequence_change(avctx, temp_frame.width, temp_frame.height, bit_depth);
+        ret = xcoder_encode_sequence_change(avctx, temp_frame->width, temp_frame->height, bit_depth);
     }
 
     // keep device handle(s) open during sequence change to fix mem bin buffer not recycled
@@ -2716,7 +2542,9 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
 
     while (1) {
         xpkt->recycle_index = -1;
+        ff_ni_stats_io_begin(&ctx->stats);
         recv = ni_device_session_read(&ctx->api_ctx, &(ctx->api_pkt), NI_DEVICE_TYPE_ENCODER);
+        ff_ni_stats_io_end(&ctx->stats, NI_SESSION_IO_READ);
 
         av_log(avctx, AV_LOG_TRACE,
                "XCoder receive packet: xpkt.end_of_stream=%d, xpkt.data_len=%d, "
@@ -2770,6 +2598,7 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
             /* got encoded data back */
             uint8_t *p_src, *p_end;
             int64_t local_pts;
+            AVBufferRef *custom_sei_buf;
             ni_custom_sei_set_t *p_custom_sei_set;
             int meta_size = ctx->api_ctx.meta_size;
             uint32_t copy_len = 0;
@@ -2781,7 +2610,7 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
                 avctx->height >= NI_MIN_HEIGHT && avctx->width >= NI_MIN_WIDTH &&
                 xpkt->recycle_index < NI_GET_MAX_HWDESC_P2P_BUF_ID(ctx->api_ctx.ddr_config)) {
                 int avframe_index =
-                    recycle_index_2_avframe_index(ctx, xpkt->recycle_index);
+                    ff_ni_recycle_ring_lookup(&ctx->recycle_ring, xpkt->recycle_index);
                 av_log(avctx, AV_LOG_VERBOSE, "UNREF trace ui16FrameIdx = [%d].\n",
                        xpkt->recycle_index);
                 if (avframe_index >= 0 && ctx->sframe_pool[avframe_index]) {
@@ -2807,16 +2636,15 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
                         }
                     }
 
-                    av_log(avctx, AV_LOG_DEBUG,
-                           "AVframe_index = %d pushed to free tail %d\n",
-                           avframe_index, ctx->freeTail);
-                    enq_free_frames(ctx, avframe_index);
-                    // enqueue the index back to free
+                    av_log(avctx, AV_LOG_DEBUG, "AVframe_index = %d recycled\n",
+                           avframe_index);
+                    // give the slot back, it can be reused from now on
+                    ff_ni_recycle_ring_release(&ctx->recycle_ring, xpkt->recycle_index);
                     xpkt->recycle_index = -1;
                 } else {
                     av_log(avctx, AV_LOG_DEBUG,
-                           "can't push to tail - avframe_index %d sframe_pool %p\n",
-                           avframe_index, ctx->sframe_pool[avframe_index]);
+                           "can't recycle - no frame with ui16FrameIdx %d in flight\n",
+                           xpkt->recycle_index);
                 }
             }
 
@@ -2935,7 +2763,8 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
             p_end = p_src + (xpkt->data_len - meta_size);
             local_pts = xpkt->pts;
 
-            p_custom_sei_set = ctx->api_ctx.pkt_custom_sei_set[local_pts % NI_FIFO_SZ];
+            custom_sei_buf = ctx->custom_sei_buf[local_pts % NI_FIFO_SZ];
+            p_custom_sei_set = custom_sei_buf ? (ni_custom_sei_set_t *)custom_sei_buf->data : NULL;
             if (p_custom_sei_set != NULL) {
                 custom_sei_count = p_custom_sei_set->count;
                 for (i = 0; i < p_custom_sei_set->count; i++) {
@@ -2998,7 +2827,7 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
                     av_log(avctx, AV_LOG_TRACE, "xcoder_receive_packet: AV1 first output pkt size %d\n", data_len);
 
 #if (LIBAVCODEC_VERSION_MAJOR >= 59)
-                ret = ff_get_encode_buffer(avctx, pkt, data_len, 0);
+                ret = ff_ni_enc_get_packet(&ctx->pools, pkt, data_len);
 #else
                 ret = ff_alloc_packet2(avctx, pkt, data_len, data_len);
 #endif
@@ -3082,7 +2911,7 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
                     av_log(avctx, AV_LOG_TRACE, "xcoder_receive_packet: AV1 output pkt size %d\n", data_len);
 
 #if (LIBAVCODEC_VERSION_MAJOR >= 59)
-                ret = ff_get_encode_buffer(avctx, pkt, data_len, 0);
+                ret = ff_ni_enc_get_packet(&ctx->pools, pkt, data_len);
 #else
                 ret = ff_alloc_packet2(avctx, pkt, data_len, data_len);
 #endif
@@ -3184,10 +3013,7 @@ int xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
 #endif
 
             // free buffer
-            if (custom_sei_count) {
-                free(p_custom_sei_set);
-                ctx->api_ctx.pkt_custom_sei_set[local_pts % NI_FIFO_SZ] = NULL;
-            }
+            av_buffer_unref(&ctx->custom_sei_buf[local_pts % NI_FIFO_SZ]);
 
             if (!ret) {
                 if (xpkt->frame_type == 0) {
@@ -3309,16 +3135,45 @@ int ff_xcoder_receive_packet(AVCodecContext *avctx, AVPacket *pkt)
     AVFrame *frame = &ctx->buffered_fme;
     int ret;
 
+    ff_ni_stats_enter(&ctx->stats);
+    if (ff_ni_frame_ring_full(&ctx->fme_ring)) {
+        // leave the next frame with the generic encode layer, the caller gets
+        // EAGAIN from avcodec_send_frame() until the queue has room again
+        ctx->fme_ring.nb_full++;
+        if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING != ctx->api_ctx.session_run_state &&
+            !ctx->encoder_flushing) {
+            ret = xcoder_send_frame(avctx, NULL);
+            if (ret < 0) {
+                ff_ni_stats_leave(&ctx->stats);
+                return ret;
+            }
+        }
+        ret = xcoder_receive_packet(avctx, pkt);
+        ff_ni_stats_leave(&ctx->stats);
+        return ret;
+    }
+    if (SESSION_RUN_STATE_SEQ_CHANGE_DRAINING == ctx->api_ctx.session_run_state &&
+        ctx->encoder_flushing) {
+        // the old sequence is being drained and would not take the frame,
+        // leave it with the generic encode layer until the session reopens
+        ret = xcoder_receive_packet(avctx, pkt);
+        ff_ni_stats_leave(&ctx->stats);
+        return ret;
+    }
+
     ret = ff_encode_get_frame(avctx, frame);
     if (!ctx->encoder_flushing && ret >= 0 || ret == AVERROR_EOF) {
         ret = xcoder_send_frame(avctx, (ret == AVERROR_EOF ? NULL : frame));
         if (ret < 0 && ret != AVERROR_EOF) {
             av_frame_unref(frame);
+            ff_ni_stats_leave(&ctx->stats);
             return ret;
         }
     }
     // Once send_frame returns EOF go on receiving packets until EOS is met.
-    return xcoder_receive_packet(avctx, pkt);
+    ret = xcoder_receive_packet(avctx, pkt);
+    ff_ni_stats_leave(&ctx->stats);
+    return ret;
 }
 #else
 int xcoder_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
@@ -3329,14 +3184,17 @@ int xcoder_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     av_log(avctx, AV_LOG_VERBOSE, "XCoder encode frame\n");
 
+    ff_ni_stats_enter(&ctx->stats);
     if (!ctx->encoder_flushing) {
         ret = xcoder_send_frame(avctx, frame);
         if (ret < 0) {
+            ff_ni_stats_leave(&ctx->stats);
             return ret;
         }
     }
 
     ret = xcoder_receive_packet(avctx, pkt);
+    ff_ni_stats_leave(&ctx->stats);
     if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
         *got_packet = 0;
     } else if (ret < 0) {
@@ -3349,48 +3207,6 @@ int xcoder_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 }
 #endif
 
-bool free_frames_isempty(XCoderEncContext *ctx)
-{
-    return (ctx->freeHead == ctx->freeTail);
-}
-
-bool free_frames_isfull(XCoderEncContext *ctx)
-{
-    return (ctx->freeHead == ((ctx->freeTail == MAX_NUM_FRAMEPOOL_HWAVFRAME) ? 0 : ctx->freeTail + 1));
-}
-
-int deq_free_frames(XCoderEncContext *ctx)
-{
-    if (free_frames_isempty(ctx)) {
-        return -1;
-    }
-    ctx->aFree_Avframes_list[ctx->freeHead] = -1;
-    ctx->freeHead = (ctx->freeHead == MAX_NUM_FRAMEPOOL_HWAVFRAME) ? 0 : ctx->freeHead + 1;
-    return 0;
-}
-
-int enq_free_frames(XCoderEncContext *ctx, int idx)
-{
-    if (free_frames_isfull(ctx)) {
-        return -1;
-    }
-    ctx->aFree_Avframes_list[ctx->freeTail] = idx;
-    ctx->freeTail = (ctx->freeTail == MAX_NUM_FRAMEPOOL_HWAVFRAME) ? 0 : ctx->freeTail + 1;
-    return 0;
-}
-
-int recycle_index_2_avframe_index(XCoderEncContext *ctx, uint32_t recycleIndex)
-{
-    int i;
-    for (i = 0; i < MAX_NUM_FRAMEPOOL_HWAVFRAME; i++) {
-        if (ctx->sframe_pool[i]->data[3] &&
-            ((niFrameSurface1_t *)(ctx->sframe_pool[i]->data[3]))->ui16FrameIdx == recycleIndex) {
-            return i;
-        }
-    }
-    return -1;
-}
-
 // Needed for hwframe on FFmpeg-n4.3+
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 82)
 const AVCodecHWConfigInternal *ff_ni_enc_hw_configs[] = {
@@ -100,6 +100,22 @@
     { "udu_sei", "Pass through user data unregistered SEI if available", OFFSETENC(udu_sei), \
       AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, VE }
 
+// input queue statistics, exported read-only
+#define NI_ENC_OPTION_QUEUE_STATS \
+    { "queue_size", "Size of the input frame queue.", OFFSETENC(fme_ring.size), \
+      AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }, \
+    { "queue_frames", "Frames currently queued.", OFFSETENC(fme_ring.nb_frames), \
+      AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }, \
+    { "queue_frames_max", "Highest number of frames queued at once.", OFFSETENC(fme_ring.nb_frames_max), \
+      AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }, \
+    { "queue_full", "Times input was refused with EAGAIN because the queue was full.", \
+      OFFSETENC(fme_ring.nb_full), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, \
+      VE | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }, \
+    { "queue_wait", "Total time in microseconds frames spent queued.", OFFSETENC(fme_ring.wait_us), \
+      AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, VE | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }, \
+    { "queue_wait_max", "Longest time in microseconds a frame spent queued.", OFFSETENC(fme_ring.wait_max_us), \
+      AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, VE | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }
+
 int xcoder_encode_init(AVCodecContext *avctx);
 
 int xcoder_encode_close(AVCodecContext *avctx);
@@ -118,16 +134,6 @@ int xcoder_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *frame, int *got_packet);
 #endif
 
-bool free_frames_isempty(XCoderEncContext *ctx);
-
-bool free_frames_isfull(XCoderEncContext *ctx);
-
-int deq_free_frames(XCoderEncContext *ctx);
-
-int enq_free_frames(XCoderEncContext *ctx, int idx);
-
-int recycle_index_2_avframe_index(XCoderEncContext *ctx, uint32_t recycleIndex);
-
 // Needed for hwframe on FFmpeg-n4.3+
 #if (LIBAVCODEC_VERSION_MAJOR >= 59 || LIBAVCODEC_VERSION_MAJOR >= 58 && LIBAVCODEC_VERSION_MINOR >= 82)
 extern const AVCodecHWConfigInternal *ff_ni_enc_hw_configs[];
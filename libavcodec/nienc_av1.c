@@ -21,6 +21,7 @@
 
 static const AVOption enc_options[] = {
     NI_ENC_OPTIONS,
+    NI_ENC_OPTION_QUEUE_STATS,
     NI_ENC_OPTION_GEN_GLOBAL_HEADERS,
     {NULL}
 };
@@ -0,0 +1,478 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Build 4 and 16 tile AV1 streams together with the single tile streams a
+ * tile encoder would produce for them, run the tile streams through
+ * av1_rawtotile and av1_tile_repack and check that the repacked temporal
+ * units are identical to the original ones.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/crc.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavcodec/av1.h"
+#include "libavcodec/bsf.h"
+#include "libavcodec/cbs.h"
+#include "libavcodec/cbs_av1.h"
+
+#define NB_FRAMES 6
+#define SB_SIZE   64
+#define MAX_TILES 16
+
+typedef struct TestLayout {
+    const char *name;
+    int width, height;
+    int cols, rows;
+    int width_sb[4];    /* tile sizes in superblocks */
+    int height_sb[4];
+    int uniform;
+} TestLayout;
+
+static const TestLayout layouts[] = {
+    { "2x2 uniform",  320, 192, 2, 2, { 3, 2 },       { 2, 1 },       1 },
+    { "4x4 explicit", 512, 256, 4, 4, { 1, 3, 2, 2 }, { 1, 1, 1, 1 }, 0 },
+};
+
+typedef struct Tile {
+    int x, y, w, h;
+    uint8_t data[600];
+    int size;
+} Tile;
+
+static void get_tiles(const TestLayout *l, int frame, Tile *tiles)
+{
+    int y = 0;
+
+    for (int r = 0; r < l->rows; r++) {
+        int x = 0;
+
+        for (int c = 0; c < l->cols; c++) {
+            Tile *t = &tiles[r * l->cols + c];
+            int idx = r * l->cols + c;
+
+            t->x = x;
+            t->y = y;
+            t->w = FFMIN(l->width_sb[c] * SB_SIZE, l->width - x);
+            t->h = FFMIN(l->height_sb[r] * SB_SIZE, l->height - y);
+            /* the last frame needs a two byte tile size field */
+            t->size = frame == NB_FRAMES - 1 ? 260 + idx * 20
+                                             : 8 + (frame * 7 + idx * 13) % 50;
+            for (int i = 0; i < t->size; i++)
+                t->data[i] = frame * 31 + idx * 17 + i;
+            x += t->w;
+        }
+        y += tiles[r * l->cols].h;
+    }
+}
+
+static void init_sequence_header(AV1RawOBU *obu, int width, int height)
+{
+    AV1RawSequenceHeader *seq = &obu->obu.sequence_header;
+
+    memset(obu, 0, sizeof(*obu));
+    obu->header.obu_type             = AV1_OBU_SEQUENCE_HEADER;
+    seq->seq_profile                 = AV_PROFILE_AV1_MAIN;
+    seq->seq_level_idx[0]            = 8;
+    seq->frame_width_bits_minus_1    = av_log2(width - 1);
+    seq->frame_height_bits_minus_1   = av_log2(height - 1);
+    seq->max_frame_width_minus_1     = width - 1;
+    seq->max_frame_height_minus_1    = height - 1;
+    seq->enable_filter_intra         = 1;
+    seq->enable_intra_edge_filter    = 1;
+    seq->seq_force_integer_mv        = AV1_SELECT_INTEGER_MV;
+    seq->enable_cdef                 = 1;
+    seq->color_config.color_primaries          = AVCOL_PRI_UNSPECIFIED;
+    seq->color_config.transfer_characteristics = AVCOL_TRC_UNSPECIFIED;
+    seq->color_config.matrix_coefficients      = AVCOL_SPC_UNSPECIFIED;
+    seq->color_config.subsampling_x  = 1;
+    seq->color_config.subsampling_y  = 1;
+}
+
+/*
+ * Key frame header, the tile sizes are coded with the smallest tile size
+ * field that fits, as av1_tile_repack does.
+ */
+static void init_frame_header(AV1RawFrameHeader *fh, const TestLayout *l,
+                              int width, int height, int frame,
+                              const Tile *tiles, int nb_tiles)
+{
+    static const int8_t default_ref_deltas[AV1_TOTAL_REFS_PER_FRAME] = {
+        1, 0, 0, 0, -1, 0, -1, -1
+    };
+    int max_size = 1;
+
+    memset(fh, 0, sizeof(*fh));
+    fh->frame_type                = AV1_FRAME_KEY;
+    fh->show_frame                = 1;
+    fh->error_resilient_mode      = 1;
+    fh->frame_size_override_flag  = frame & 1;
+    fh->primary_ref_frame         = AV1_PRIMARY_REF_NONE;
+    fh->refresh_frame_flags       = 0xff;
+    fh->frame_width_minus_1       = width - 1;
+    fh->frame_height_minus_1      = height - 1;
+    fh->render_width_minus_1      = width - 1;
+    fh->render_height_minus_1     = height - 1;
+    fh->base_q_idx                = 40 + frame;
+    fh->loop_filter_level[0]      = 10;
+    fh->loop_filter_level[1]      = 12;
+    fh->loop_filter_sharpness     = 2;
+    memcpy(fh->loop_filter_ref_deltas, default_ref_deltas,
+           sizeof(default_ref_deltas));
+    fh->cdef_damping_minus_3      = 1;
+    fh->cdef_bits                 = 0;
+    fh->cdef_y_pri_strength[0]    = 4;
+    fh->tx_mode                   = AV1_TX_MODE_SELECT;
+
+    if (nb_tiles == 1) {
+        fh->uniform_tile_spacing_flag = 1;
+        fh->width_in_sbs_minus_1[0]   = (width  + SB_SIZE - 1) / SB_SIZE - 1;
+        fh->height_in_sbs_minus_1[0]  = (height + SB_SIZE - 1) / SB_SIZE - 1;
+        return;
+    }
+
+    fh->uniform_tile_spacing_flag = l->uniform;
+    fh->tile_cols_log2            = av_log2(l->cols - 1) + 1;
+    fh->tile_rows_log2            = av_log2(l->rows - 1) + 1;
+    for (int i = 0; i < l->cols; i++)
+        fh->width_in_sbs_minus_1[i] = l->width_sb[i] - 1;
+    for (int i = 0; i < l->rows; i++)
+        fh->height_in_sbs_minus_1[i] = l->height_sb[i] - 1;
+    for (int i = 0; i < nb_tiles - 1; i++)
+        max_size = FFMAX(max_size, tiles[i].size);
+    fh->tile_size_bytes_minus1 = av_log2(max_size - 1) >> 3;
+}
+
+/*
+ * One temporal unit. Frames alternate between a frame header and tile
+ * group OBU pair and a frame OBU, the sequence header is repeated every
+ * 3 frames and frame 2 carries a padding OBU that has to pass through.
+ */
+static int make_temporal_unit(CodedBitstreamContext *cbc, AVPacket *pkt,
+                              const TestLayout *l, int frame, int tile_idx)
+{
+    static uint8_t padding[] = { 0x50, 0x41, 0x44 };
+    CodedBitstreamFragment frag = { 0 };
+    AV1RawOBU td = { .header.obu_type = AV1_OBU_TEMPORAL_DELIMITER };
+    AV1RawOBU seq, fh, tg, pad;
+    Tile tiles[MAX_TILES];
+    uint8_t tile_data[MAX_TILES * 604];
+    int nb_tiles = l->cols * l->rows;
+    int width = l->width, height = l->height;
+    int size = 0, ret;
+
+    get_tiles(l, frame, tiles);
+    if (tile_idx >= 0) {
+        /* single tile stream of one tile encoder */
+        width  = tiles[tile_idx].w;
+        height = tiles[tile_idx].h;
+        memcpy(tile_data, tiles[tile_idx].data, tiles[tile_idx].size);
+        size = tiles[tile_idx].size;
+    }
+
+    init_sequence_header(&seq, width, height);
+    memset(&fh, 0, sizeof(fh));
+    memset(&tg, 0, sizeof(tg));
+    init_frame_header(frame & 1 ? &fh.obu.frame.header : &fh.obu.frame_header,
+                      l, width, height, frame, tiles,
+                      tile_idx >= 0 ? 1 : nb_tiles);
+
+    if (tile_idx < 0) {
+        AV1RawFrameHeader *hdr = frame & 1 ? &fh.obu.frame.header
+                                           : &fh.obu.frame_header;
+        int size_bytes = hdr->tile_size_bytes_minus1 + 1;
+
+        for (int i = 0; i < nb_tiles; i++) {
+            if (i < nb_tiles - 1) {
+                for (int b = 0; b < size_bytes; b++)
+                    tile_data[size++] = (tiles[i].size - 1) >> (8 * b);
+            }
+            memcpy(tile_data + size, tiles[i].data, tiles[i].size);
+            size += tiles[i].size;
+        }
+    }
+
+    if ((ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_TEMPORAL_DELIMITER,
+                                          &td, NULL)) < 0)
+        goto end;
+    if (!(frame % 3) &&
+        (ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_SEQUENCE_HEADER,
+                                          &seq, NULL)) < 0)
+        goto end;
+    if (frame == 2 && tile_idx <= 0) {
+        memset(&pad, 0, sizeof(pad));
+        pad.header.obu_type          = AV1_OBU_PADDING;
+        pad.obu.padding.payload      = padding;
+        pad.obu.padding.payload_size = sizeof(padding);
+        if ((ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_PADDING,
+                                              &pad, NULL)) < 0)
+            goto end;
+    }
+
+    if (frame & 1) {
+        fh.header.obu_type = AV1_OBU_FRAME;
+        fh.obu.frame.tile_group.tg_end              = tile_idx >= 0 ? 0 : nb_tiles - 1;
+        fh.obu.frame.tile_group.tile_data.data      = tile_data;
+        fh.obu.frame.tile_group.tile_data.data_size = size;
+        ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_FRAME, &fh, NULL);
+    } else {
+        fh.header.obu_type = AV1_OBU_FRAME_HEADER;
+        tg.header.obu_type = AV1_OBU_TILE_GROUP;
+        tg.obu.tile_group.tg_end              = tile_idx >= 0 ? 0 : nb_tiles - 1;
+        tg.obu.tile_group.tile_data.data      = tile_data;
+        tg.obu.tile_group.tile_data.data_size = size;
+        if ((ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_FRAME_HEADER,
+                                              &fh, NULL)) >= 0)
+            ret = ff_cbs_insert_unit_content(&frag, -1, AV1_OBU_TILE_GROUP,
+                                             &tg, NULL);
+    }
+    if (ret < 0)
+        goto end;
+
+    ret = ff_cbs_write_packet(cbc, pkt, &frag);
+    pkt->pts = pkt->dts = frame;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+
+end:
+    ff_cbs_fragment_free(&frag);
+    return ret;
+}
+
+static int open_bsf(AVBSFContext **pbsf, const char *name,
+                    const AVCodecParameters *par)
+{
+    int ret = av_bsf_alloc(av_bsf_get_by_name(name), pbsf);
+
+    if (ret < 0)
+        return ret;
+    (*pbsf)->time_base_in = (AVRational){ 1, 25 };
+    return avcodec_parameters_copy((*pbsf)->par_in, par);
+}
+
+static int open_rawtotile(AVBSFContext **pbsf, const AVCodecParameters *par,
+                          const TestLayout *l, const Tile *tile)
+{
+    int ret;
+
+    if ((ret = open_bsf(pbsf, "av1_rawtotile", par)) < 0)
+        return ret;
+    if ((ret = av_opt_set_int((*pbsf)->priv_data, "width",  l->width,  0)) < 0 ||
+        (ret = av_opt_set_int((*pbsf)->priv_data, "height", l->height, 0)) < 0 ||
+        (ret = av_opt_set_int((*pbsf)->priv_data, "column", l->cols,   0)) < 0 ||
+        (ret = av_opt_set_int((*pbsf)->priv_data, "row",    l->rows,   0)) < 0 ||
+        (ret = av_opt_set_int((*pbsf)->priv_data, "x",      tile->x,   0)) < 0 ||
+        (ret = av_opt_set_int((*pbsf)->priv_data, "y",      tile->y,   0)) < 0 ||
+        (ret = av_opt_set_int((*pbsf)->priv_data, "x_w",    tile->w,   0)) < 0 ||
+        (ret = av_opt_set_int((*pbsf)->priv_data, "y_h",    tile->h,   0)) < 0)
+        return ret;
+    return av_bsf_init(*pbsf);
+}
+
+static int filter(AVBSFContext *bsf, AVPacket *pkt)
+{
+    int ret = av_bsf_send_packet(bsf, pkt);
+
+    if (ret < 0)
+        return ret;
+    return av_bsf_receive_packet(bsf, pkt);
+}
+
+/*
+ * Run the tile streams of the layout through av1_rawtotile and
+ * av1_tile_repack, sending each frame's tiles in the given order, and
+ * compare with the original stream.
+ */
+static int test_layout(const TestLayout *l, int reverse)
+{
+    const AVCRC *crc_tab = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    int nb_tiles = l->cols * l->rows;
+    CodedBitstreamContext *cbc = NULL, *tile_cbc[MAX_TILES] = { NULL };
+    AVBSFContext *rawtotile[MAX_TILES] = { NULL }, *repack = NULL;
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    AVPacket *orig = av_packet_alloc(), *pkt = av_packet_alloc();
+    Tile tiles[MAX_TILES];
+    int ret;
+
+    if (!par || !orig || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    par->codec_type = AVMEDIA_TYPE_VIDEO;
+    par->codec_id   = AV_CODEC_ID_AV1;
+    par->width      = l->width;
+    par->height     = l->height;
+
+    get_tiles(l, 0, tiles);
+    if ((ret = ff_cbs_init(&cbc, AV_CODEC_ID_AV1, NULL)) < 0 ||
+        (ret = open_bsf(&repack, "av1_tile_repack", par)) < 0 ||
+        (ret = av_opt_set_int(repack->priv_data, "tile_num", nb_tiles, 0)) < 0 ||
+        (ret = av_bsf_init(repack)) < 0)
+        goto end;
+    for (int t = 0; t < nb_tiles; t++) {
+        if ((ret = ff_cbs_init(&tile_cbc[t], AV_CODEC_ID_AV1, NULL)) < 0 ||
+            (ret = open_rawtotile(&rawtotile[t], par, l, &tiles[t])) < 0)
+            goto end;
+    }
+
+    printf("%s, %d tiles%s\n", l->name, nb_tiles,
+           reverse ? ", reverse order" : "");
+
+    for (int f = 0; f < NB_FRAMES; f++) {
+        for (int i = 0; i < nb_tiles; i++) {
+            int t = reverse ? nb_tiles - 1 - i : i;
+            uint8_t *sd;
+
+            if ((ret = make_temporal_unit(tile_cbc[t], pkt, l, f, t)) < 0)
+                goto end;
+            sd = av_packet_new_side_data(pkt, AV_PKT_DATA_SLICE_ADDR,
+                                         sizeof(int));
+            if (!sd) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            memcpy(sd, &t, sizeof(int));
+
+            if ((ret = filter(rawtotile[t], pkt)) < 0)
+                goto end;
+            ret = filter(repack, pkt);
+            if (ret == AVERROR(EAGAIN) && i < nb_tiles - 1)
+                continue;
+            if (ret < 0) {
+                printf("frame %d: repack failed\n", f);
+                goto end;
+            }
+            if (i < nb_tiles - 1) {
+                printf("frame %d: output before the last tile\n", f);
+                ret = AVERROR_BUG;
+                goto end;
+            }
+        }
+
+        if ((ret = make_temporal_unit(cbc, orig, l, f, -1)) < 0)
+            goto end;
+
+        printf("frame %d: pts %"PRId64" size %d crc 0x%08"PRIX32"\n", f,
+               pkt->pts, pkt->size, av_crc(crc_tab, 0, pkt->data, pkt->size));
+        if (pkt->size != orig->size || memcmp(pkt->data, orig->data, pkt->size)) {
+            printf("frame %d: repacked temporal unit differs from the "
+                   "original (%d bytes)\n", f, orig->size);
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+        if (pkt->pts != f || av_packet_get_side_data(pkt, AV_PKT_DATA_SLICE_ADDR,
+                                                     NULL)) {
+            printf("frame %d: wrong packet properties\n", f);
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+        av_packet_unref(orig);
+        av_packet_unref(pkt);
+    }
+
+end:
+    for (int t = 0; t < nb_tiles; t++) {
+        av_bsf_free(&rawtotile[t]);
+        ff_cbs_close(&tile_cbc[t]);
+    }
+    av_bsf_free(&repack);
+    ff_cbs_close(&cbc);
+    av_packet_free(&orig);
+    av_packet_free(&pkt);
+    avcodec_parameters_free(&par);
+    return ret;
+}
+
+/* With a single tile the filters must hand the stream on unchanged. */
+static int test_passthrough(void)
+{
+    const TestLayout *l = &layouts[0];
+    CodedBitstreamContext *cbc = NULL;
+    AVBSFContext *rawtotile = NULL, *repack = NULL;
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    AVPacket *orig = av_packet_alloc(), *pkt = av_packet_alloc();
+    Tile tiles[MAX_TILES];
+    int ret;
+
+    if (!par || !orig || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    par->codec_type = AVMEDIA_TYPE_VIDEO;
+    par->codec_id   = AV_CODEC_ID_AV1;
+
+    get_tiles(l, 0, tiles);
+    if ((ret = ff_cbs_init(&cbc, AV_CODEC_ID_AV1, NULL)) < 0 ||
+        (ret = open_rawtotile(&rawtotile, par, l, &tiles[0])) < 0 ||
+        (ret = open_bsf(&repack, "av1_tile_repack", par)) < 0 ||
+        (ret = av_opt_set_int(repack->priv_data, "tile_num", 1, 0)) < 0 ||
+        (ret = av_bsf_init(repack)) < 0)
+        goto end;
+
+    for (int f = 0; f < NB_FRAMES; f++) {
+        int zero = 0;
+        uint8_t *sd;
+
+        if ((ret = make_temporal_unit(cbc, orig, l, f, 0)) < 0 ||
+            (ret = av_packet_ref(pkt, orig)) < 0)
+            goto end;
+        sd = av_packet_new_side_data(pkt, AV_PKT_DATA_SLICE_ADDR, sizeof(int));
+        if (!sd) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        memcpy(sd, &zero, sizeof(int));
+
+        if ((ret = filter(rawtotile, pkt)) < 0 ||
+            (ret = filter(repack, pkt)) < 0)
+            goto end;
+        if (pkt->size != orig->size || memcmp(pkt->data, orig->data, pkt->size)) {
+            printf("frame %d: single tile not passed through\n", f);
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+        av_packet_unref(orig);
+        av_packet_unref(pkt);
+    }
+    printf("single tile passthrough\n");
+
+end:
+    av_bsf_free(&rawtotile);
+    av_bsf_free(&repack);
+    ff_cbs_close(&cbc);
+    av_packet_free(&orig);
+    av_packet_free(&pkt);
+    avcodec_parameters_free(&par);
+    return ret;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(layouts) && ret >= 0; i++)
+        ret = test_layout(&layouts[i], 0);
+    if (ret >= 0)
+        ret = test_layout(&layouts[1], 1);
+    if (ret >= 0)
+        ret = test_passthrough();
+
+    return ret < 0;
+}
@@ -0,0 +1,456 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Split a synthetic 2x2 tiled HEVC stream with hevc_frame_split, repack the
+ * tiles with hevc_tile_repack, in order and interleaved across frames, and
+ * check that the slice payloads survive bit-exact.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/crc.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavcodec/bsf.h"
+#include "libavcodec/cbs.h"
+#include "libavcodec/cbs_h265.h"
+#include "libavcodec/hevc/hevc.h"
+
+#define WIDTH        128
+#define HEIGHT       128
+#define CTB_SIZE     32
+#define TILE_COLS    2
+#define TILE_ROWS    2
+#define NB_TILES     (TILE_COLS * TILE_ROWS)
+#define NB_FRAMES    8
+#define PAYLOAD_SIZE 24
+
+static H265RawVPS vps;
+static H265RawSPS sps;
+static H265RawPPS pps;
+
+static void init_ptl(H265RawProfileTierLevel *ptl)
+{
+    ptl->general_profile_idc                   = 1;
+    ptl->general_profile_compatibility_flag[1] = 1;
+    ptl->general_profile_compatibility_flag[2] = 1;
+    ptl->general_progressive_source_flag       = 1;
+    ptl->general_frame_only_constraint_flag    = 1;
+    ptl->general_level_idc                     = 30;
+}
+
+static void init_parameter_sets(void)
+{
+    vps.nal_unit_header = (H265RawNALUnitHeader) {
+        .nal_unit_type = HEVC_NAL_VPS, .nuh_temporal_id_plus1 = 1,
+    };
+    vps.vps_base_layer_internal_flag  = 1;
+    vps.vps_base_layer_available_flag = 1;
+    vps.vps_temporal_id_nesting_flag  = 1;
+    vps.layer_id_included_flag[0][0] = 1;
+    init_ptl(&vps.profile_tier_level);
+
+    sps.nal_unit_header = (H265RawNALUnitHeader) {
+        .nal_unit_type = HEVC_NAL_SPS, .nuh_temporal_id_plus1 = 1,
+    };
+    sps.sps_temporal_id_nesting_flag                = 1;
+    init_ptl(&sps.profile_tier_level);
+    sps.chroma_format_idc                           = 1;
+    sps.pic_width_in_luma_samples                   = WIDTH;
+    sps.pic_height_in_luma_samples                  = HEIGHT;
+    sps.log2_max_pic_order_cnt_lsb_minus4           = 4;
+    sps.sps_sub_layer_ordering_info_present_flag    = 1;
+    sps.log2_min_luma_coding_block_size_minus3      = 0;
+    sps.log2_diff_max_min_luma_coding_block_size    = 2;
+    sps.log2_min_luma_transform_block_size_minus2   = 0;
+    sps.log2_diff_max_min_luma_transform_block_size = 3;
+    /* values inferred for an absent VUI */
+    sps.vui.video_format                            = 5;
+    sps.vui.colour_primaries                        = 2;
+    sps.vui.transfer_characteristics                = 2;
+    sps.vui.matrix_coefficients                     = 2;
+    sps.vui.motion_vectors_over_pic_boundaries_flag = 1;
+    sps.vui.max_bytes_per_pic_denom                 = 2;
+    sps.vui.max_bits_per_min_cu_denom               = 1;
+    sps.vui.log2_max_mv_length_horizontal           = 15;
+    sps.vui.log2_max_mv_length_vertical             = 15;
+
+    pps.nal_unit_header = (H265RawNALUnitHeader) {
+        .nal_unit_type = HEVC_NAL_PPS, .nuh_temporal_id_plus1 = 1,
+    };
+    pps.tiles_enabled_flag     = 1;
+    pps.num_tile_columns_minus1 = TILE_COLS - 1;
+    pps.num_tile_rows_minus1    = TILE_ROWS - 1;
+    pps.uniform_spacing_flag   = 1;
+}
+
+static void fill_payload(uint8_t *buf, int frame, int tile)
+{
+    for (int i = 0; i < PAYLOAD_SIZE - 1; i++)
+        buf[i] = 0x10 + ((frame * 37 + tile * 11 + i * 5) & 0xef);
+    buf[PAYLOAD_SIZE - 1] = 0x80; /* rbsp_stop_one_bit */
+}
+
+static int tile_address(int tile)
+{
+    int ctb_cols = WIDTH / CTB_SIZE, ctb_rows = HEIGHT / CTB_SIZE;
+    int x = tile % TILE_COLS * ctb_cols / TILE_COLS;
+    int y = tile / TILE_COLS * ctb_rows / TILE_ROWS;
+
+    return y * ctb_cols + x;
+}
+
+static int write_parameter_sets(CodedBitstreamFragment *frag)
+{
+    int ret;
+
+    if ((ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_VPS, &vps, NULL)) < 0 ||
+        (ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_SPS, &sps, NULL)) < 0 ||
+        (ret = ff_cbs_insert_unit_content(frag, -1, HEVC_NAL_PPS, &pps, NULL)) < 0)
+        return ret;
+    return 0;
+}
+
+/*
+ * One IDR access unit with one slice per tile. Parameter sets are repeated
+ * every 4 frames, so the split filter reuses its cached rewrites.
+ */
+static int make_frame(CodedBitstreamContext *cbc, AVPacket *pkt, int frame)
+{
+    CodedBitstreamFragment frag = { 0 };
+    H265RawSlice slices[NB_TILES] = { 0 };
+    uint8_t payload[NB_TILES][PAYLOAD_SIZE];
+    int ret = 0;
+
+    if (!(frame % 4) && (ret = write_parameter_sets(&frag)) < 0)
+        goto end;
+
+    for (int t = 0; t < NB_TILES; t++) {
+        H265RawSliceHeader *sh = &slices[t].header;
+
+        sh->nal_unit_header = (H265RawNALUnitHeader) {
+            .nal_unit_type = HEVC_NAL_IDR_W_RADL, .nuh_temporal_id_plus1 = 1,
+        };
+        sh->first_slice_segment_in_pic_flag = !t;
+        sh->slice_segment_address           = tile_address(t);
+        sh->slice_type                      = HEVC_SLICE_I;
+
+        fill_payload(payload[t], frame, t);
+        slices[t].data      = payload[t];
+        slices[t].data_size = PAYLOAD_SIZE;
+
+        ret = ff_cbs_insert_unit_content(&frag, -1, HEVC_NAL_IDR_W_RADL,
+                                         &slices[t], NULL);
+        if (ret < 0)
+            goto end;
+    }
+
+    ret = ff_cbs_write_packet(cbc, pkt, &frag);
+    pkt->pts = pkt->dts = frame;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+
+end:
+    ff_cbs_fragment_free(&frag);
+    return ret;
+}
+
+static int make_extradata(CodedBitstreamContext *cbc, AVCodecParameters *par)
+{
+    CodedBitstreamFragment frag = { 0 };
+    int ret;
+
+    if ((ret = write_parameter_sets(&frag)) < 0 ||
+        (ret = ff_cbs_write_fragment_data(cbc, &frag)) < 0)
+        goto end;
+
+    par->extradata = av_mallocz(frag.data_size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!par->extradata) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    memcpy(par->extradata, frag.data, frag.data_size);
+    par->extradata_size = frag.data_size;
+
+end:
+    ff_cbs_fragment_free(&frag);
+    return ret;
+}
+
+static int open_bsf(AVBSFContext **pbsf, const char *name,
+                    const AVCodecParameters *par, int reorder_window)
+{
+    AVBSFContext *bsf;
+    int ret;
+
+    ret = av_bsf_alloc(av_bsf_get_by_name(name), pbsf);
+    if (ret < 0)
+        return ret;
+    bsf = *pbsf;
+
+    if ((ret = avcodec_parameters_copy(bsf->par_in, par)) < 0)
+        return ret;
+    bsf->time_base_in = (AVRational){ 1, 25 };
+
+    if (reorder_window) {
+        if ((ret = av_opt_set_int(bsf->priv_data, "tile_num", NB_TILES, 0)) < 0 ||
+            (ret = av_opt_set_int(bsf->priv_data, "reorder_window",
+                                  reorder_window, 0)) < 0)
+            return ret;
+    } else {
+        /* rewrite the tiles on the worker pool even on a single core */
+        if ((ret = av_opt_set_int(bsf->priv_data, "threads", NB_TILES, 0)) < 0)
+            return ret;
+    }
+
+    return av_bsf_init(bsf);
+}
+
+/* Run packets through bsf, appending everything it outputs to out. */
+static int run_bsf(AVBSFContext *bsf, AVPacket **in, int nb_in,
+                   AVPacket **out, int *nb_out, int max_out)
+{
+    int ret;
+
+    for (int i = 0; i <= nb_in; i++) {
+        AVPacket *pkt = NULL;
+
+        if (i < nb_in && !(pkt = av_packet_clone(in[i])))
+            return AVERROR(ENOMEM);
+        ret = av_bsf_send_packet(bsf, pkt);
+        av_packet_free(&pkt);
+        if (ret < 0)
+            return ret;
+
+        for (;;) {
+            AVPacket *res = av_packet_alloc();
+
+            if (!res)
+                return AVERROR(ENOMEM);
+            ret = av_bsf_receive_packet(bsf, res);
+            if (ret >= 0 && *nb_out >= max_out)
+                ret = AVERROR(ENOSPC);
+            if (ret < 0) {
+                av_packet_free(&res);
+                break;
+            }
+            out[(*nb_out)++] = res;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            return ret;
+    }
+
+    return 0;
+}
+
+/* Check that the repacked frames carry the original payloads in tile order. */
+static int check_payloads(AVPacket **frames, int nb_frames)
+{
+    CodedBitstreamContext *cbc = NULL;
+    CodedBitstreamFragment frag = { 0 };
+    uint8_t payload[PAYLOAD_SIZE];
+    int ret;
+
+    if ((ret = ff_cbs_init(&cbc, AV_CODEC_ID_HEVC, NULL)) < 0)
+        return ret;
+
+    for (int f = 0; f < nb_frames && ret >= 0; f++) {
+        int tile = 0;
+
+        ret = ff_cbs_read_packet(cbc, &frag, frames[f]);
+        for (int i = 0; i < frag.nb_units && ret >= 0; i++) {
+            const H265RawSlice *slice = frag.units[i].content;
+
+            if (frag.units[i].type > HEVC_NAL_RSV_VCL31)
+                continue;
+
+            fill_payload(payload, f, tile);
+            if (slice->data_size != PAYLOAD_SIZE ||
+                memcmp(slice->data, payload, PAYLOAD_SIZE)) {
+                printf("frame %d tile %d: payload mismatch\n", f, tile);
+                ret = AVERROR_INVALIDDATA;
+            }
+            tile++;
+        }
+        if (ret >= 0 && tile != NB_TILES) {
+            printf("frame %d: %d slices, expected %d\n", f, tile, NB_TILES);
+            ret = AVERROR_INVALIDDATA;
+        }
+        ff_cbs_fragment_reset(&frag);
+    }
+
+    ff_cbs_fragment_free(&frag);
+    ff_cbs_close(&cbc);
+    return ret;
+}
+
+static int same_packets(AVPacket **a, AVPacket **b, int nb)
+{
+    for (int i = 0; i < nb; i++) {
+        if (a[i]->size != b[i]->size || a[i]->pts != b[i]->pts ||
+            memcmp(a[i]->data, b[i]->data, a[i]->size))
+            return 0;
+    }
+    return 1;
+}
+
+int main(void)
+{
+    const AVCRC *crc_tab = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    CodedBitstreamContext *cbc = NULL;
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    AVBSFContext *split = NULL, *repack = NULL;
+    AVPacket *frames[NB_FRAMES] = { NULL };
+    AVPacket *tiles[NB_FRAMES * NB_TILES] = { NULL };
+    AVPacket *shuffled[NB_FRAMES * NB_TILES];
+    AVPacket *in_order[NB_FRAMES] = { NULL }, *reordered[NB_FRAMES] = { NULL };
+    int nb_tiles = 0, nb_in_order = 0, nb_reordered = 0, n = 0;
+    int ret;
+
+    if (!par)
+        return 1;
+    par->codec_type = AVMEDIA_TYPE_VIDEO;
+    par->codec_id   = AV_CODEC_ID_HEVC;
+    par->width      = WIDTH;
+    par->height     = HEIGHT;
+
+    init_parameter_sets();
+    if ((ret = ff_cbs_init(&cbc, AV_CODEC_ID_HEVC, NULL)) < 0 ||
+        (ret = make_extradata(cbc, par)) < 0)
+        goto end;
+
+    for (int f = 0; f < NB_FRAMES; f++) {
+        uint8_t *sd;
+
+        if (!(frames[f] = av_packet_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = make_frame(cbc, frames[f], f)) < 0)
+            goto end;
+        sd = av_packet_new_side_data(frames[f], AV_PKT_DATA_QUALITY_STATS, 8);
+        if (!sd) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        memset(sd, f, 8);
+    }
+
+    /* split */
+    if ((ret = open_bsf(&split, "hevc_frame_split", par, 0)) < 0 ||
+        (ret = run_bsf(split, frames, NB_FRAMES, tiles, &nb_tiles,
+                       FF_ARRAY_ELEMS(tiles))) < 0)
+        goto end;
+    if (nb_tiles != NB_FRAMES * NB_TILES) {
+        printf("split produced %d tiles, expected %d\n", nb_tiles,
+               NB_FRAMES * NB_TILES);
+        ret = 1;
+        goto end;
+    }
+
+    /* repack in order */
+    if ((ret = open_bsf(&repack, "hevc_tile_repack", par, 1)) < 0 ||
+        (ret = run_bsf(repack, tiles, nb_tiles, in_order, &nb_in_order,
+                       NB_FRAMES)) < 0)
+        goto end;
+    av_bsf_free(&repack);
+    if (nb_in_order != NB_FRAMES) {
+        printf("repack produced %d frames, expected %d\n", nb_in_order,
+               NB_FRAMES);
+        ret = 1;
+        goto end;
+    }
+
+    for (int f = 0; f < NB_FRAMES; f++) {
+        const AVPacket *pkt = in_order[f];
+        size_t sd_size;
+        const uint8_t *sd = av_packet_get_side_data(pkt,
+                                                    AV_PKT_DATA_QUALITY_STATS,
+                                                    &sd_size);
+
+        printf("frame %d: pts %"PRId64" size %d crc 0x%08"PRIX32"\n", f,
+               pkt->pts, pkt->size,
+               av_crc(crc_tab, 0, pkt->data, pkt->size));
+
+        if (av_packet_get_side_data(pkt, AV_PKT_DATA_SLICE_ADDR, NULL)) {
+            printf("frame %d: tile index leaked into output\n", f);
+            ret = 1;
+        }
+        if (!sd || sd_size != 8 || sd[0] != f) {
+            printf("frame %d: side data not carried over\n", f);
+            ret = 1;
+        }
+    }
+    if (ret)
+        goto end;
+    if ((ret = check_payloads(in_order, nb_in_order)) < 0)
+        goto end;
+
+    /*
+     * Interleave tiles of three frames at a time, each frame's tiles in
+     * reverse order, the result must not change.
+     */
+    for (int f = 0; f < NB_FRAMES; f += 3) {
+        int nb = FFMIN(3, NB_FRAMES - f);
+        for (int t = NB_TILES - 1; t >= 0; t--)
+            for (int i = 0; i < nb; i++)
+                shuffled[n++] = tiles[(f + i) * NB_TILES + t];
+    }
+
+    if ((ret = open_bsf(&repack, "hevc_tile_repack", par, 3)) < 0 ||
+        (ret = run_bsf(repack, shuffled, n, reordered, &nb_reordered,
+                       NB_FRAMES)) < 0)
+        goto end;
+    av_bsf_free(&repack);
+    if (nb_reordered != NB_FRAMES || !same_packets(in_order, reordered, NB_FRAMES)) {
+        printf("interleaved tiles were repacked differently\n");
+        ret = 1;
+        goto end;
+    }
+
+    /* the same input must be rejected if the window is too small */
+    for (int i = 0; i < nb_reordered; i++)
+        av_packet_free(&reordered[i]);
+    nb_reordered = 0;
+    if ((ret = open_bsf(&repack, "hevc_tile_repack", par, 2)) < 0)
+        goto end;
+    ret = run_bsf(repack, shuffled, n, reordered, &nb_reordered, NB_FRAMES);
+    if (ret != AVERROR(EINVAL)) {
+        printf("reorder window overflow not detected\n");
+        ret = 1;
+        goto end;
+    }
+    ret = 0;
+
+end:
+    if (ret < 0)
+        printf("error: %s\n", av_err2str(ret));
+    for (int i = 0; i < NB_FRAMES; i++) {
+        av_packet_free(&frames[i]);
+        av_packet_free(&in_order[i]);
+        av_packet_free(&reordered[i]);
+    }
+    for (int i = 0; i < nb_tiles; i++)
+        av_packet_free(&tiles[i]);
+    av_bsf_free(&split);
+    av_bsf_free(&repack);
+    avcodec_parameters_free(&par);
+    ff_cbs_close(&cbc);
+    return !!ret;
+}
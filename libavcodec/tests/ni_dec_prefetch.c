@@ -0,0 +1,278 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavcodec/ni_dec_prefetch.c"
+#include "libavcodec/ni_session_stats.h"
+
+#define NB_PACKETS  48
+#define DEV_SLOTS   4
+#define DECODE_US   300     ///< device time per picture
+#define PREPARE_US  200     ///< host time building a frame, the SEI parsing
+#define CONSUME_US  600     ///< time the caller spends on each frame
+
+/*
+ * A decoder session holding at most DEV_SLOTS pictures, decoding them one
+ * after the other and returning them in order.
+ */
+typedef struct MockDecoder {
+    int64_t pts[DEV_SLOTS];
+    int64_t ready[DEV_SLOTS];
+    int head, nb;
+    int draining;
+} MockDecoder;
+
+static void mock_reset(MockDecoder *d)
+{
+    memset(d, 0, sizeof(*d));
+}
+
+static int mock_send(void *opaque, AVPacket *pkt)
+{
+    MockDecoder *d = opaque;
+    int64_t now = av_gettime_relative();
+    int idx;
+
+    if (!pkt->size) {
+        d->draining = 1;
+        return 0;
+    }
+    if (d->nb == DEV_SLOTS)
+        return AVERROR(EAGAIN);
+
+    idx = (d->head + d->nb) % DEV_SLOTS;
+    d->pts[idx]   = pkt->pts;
+    d->ready[idx] = FFMAX(now, d->nb ? d->ready[(idx + DEV_SLOTS - 1) % DEV_SLOTS] : 0) +
+                    DECODE_US;
+    d->nb++;
+    return 0;
+}
+
+static int mock_receive(void *opaque, AVFrame *frame)
+{
+    MockDecoder *d = opaque;
+    AVFrameSideData *sd;
+    int ret;
+
+    if (!d->nb)
+        return d->draining ? AVERROR_EOF : AVERROR(EAGAIN);
+    if (av_gettime_relative() < d->ready[d->head])
+        return AVERROR(EAGAIN);
+
+    frame->format = AV_PIX_FMT_GRAY8;
+    frame->width  = 64;
+    frame->height = 36;
+    frame->pts    = d->pts[d->head];
+    ret = av_frame_get_buffer(frame, 0);
+    if (ret < 0)
+        return ret;
+    memset(frame->data[0], frame->pts, frame->linesize[0] * frame->height);
+    sd = av_frame_new_side_data(frame, AV_FRAME_DATA_A53_CC, 16);
+    if (!sd)
+        return AVERROR(ENOMEM);
+    av_usleep(PREPARE_US);
+
+    d->head = (d->head + 1) % DEV_SLOTS;
+    d->nb--;
+    return 0;
+}
+
+static const NIDecPrefetchOps mock_ops = {
+    .send    = mock_send,
+    .receive = mock_receive,
+};
+
+/* the packets the generic layer hands out, then the end of the input */
+typedef struct Source {
+    int64_t next, end;
+} Source;
+
+static int get_packet(Source *src, AVPacket *pkt)
+{
+    int ret;
+
+    if (src->next == src->end)
+        return AVERROR_EOF;
+    ret = av_new_packet(pkt, 32);
+    if (ret < 0)
+        return ret;
+    pkt->pts = src->next++;
+    return 0;
+}
+
+/* the receive_frame of nidec without prefetch */
+static int receive_sync(MockDecoder *d, Source *src, AVPacket *buffered,
+                        AVFrame *frame)
+{
+    int ret;
+
+    for (;;) {
+        if (!buffered->data && !d->draining) {
+            ret = get_packet(src, buffered);
+            if (ret < 0 && ret != AVERROR_EOF)
+                return ret;
+        }
+        ret = mock_send(d, buffered);
+        if (ret >= 0)
+            av_packet_unref(buffered);
+
+        ret = mock_receive(d, frame);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+        if (buffered->data || d->draining)
+            av_usleep(POLL_MIN_US);
+    }
+}
+
+/* the receive_frame of nidec with prefetch */
+static int receive_prefetch(NIDecPrefetch *p, Source *src, AVPacket *buffered,
+                            AVFrame *frame)
+{
+    int block = 0;
+    int ret;
+
+    for (;;) {
+        ret = ff_ni_dec_prefetch_receive(p, frame, block);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        if (!buffered->size) {
+            ret = get_packet(src, buffered);
+            if (ret == AVERROR_EOF) {
+                ret = ff_ni_dec_prefetch_submit(p, NULL);
+                if (ret < 0 && ret != AVERROR(EAGAIN))
+                    return ret;
+                block = 1;
+                continue;
+            } else if (ret < 0) {
+                return ret;
+            }
+        }
+
+        ret = ff_ni_dec_prefetch_submit(p, buffered);
+        if (ret < 0 && ret != AVERROR(EAGAIN))
+            return ret;
+        block = ret == AVERROR(EAGAIN);
+    }
+}
+
+static int drain(const char *name, NIDecPrefetch *p, MockDecoder *d,
+                 Source *src, int max_frames, NILatencyHist *hist)
+{
+    AVPacket *buffered = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int64_t expected = src->next;
+    int nb_frames = 0, err = 0;
+
+    if (!buffered || !frame)
+        return -1;
+
+    while (nb_frames < max_frames) {
+        int64_t start = av_gettime_relative();
+        int ret = p ? receive_prefetch(p, src, buffered, frame)
+                    : receive_sync(d, src, buffered, frame);
+
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            printf("%s: error %d\n", name, ret);
+            err = 1;
+            break;
+        }
+        ff_ni_latency_add(hist, av_gettime_relative() - start);
+        if (frame->pts != expected++ || frame->data[0][0] != (uint8_t)frame->pts ||
+            !av_frame_get_side_data(frame, AV_FRAME_DATA_A53_CC)) {
+            printf("%s: frame %"PRId64" wrong\n", name, frame->pts);
+            err = 1;
+        }
+        av_frame_unref(frame);
+        nb_frames++;
+        av_usleep(CONSUME_US);
+    }
+
+    av_packet_free(&buffered);
+    av_frame_free(&frame);
+    return err ? -1 : nb_frames;
+}
+
+static int run(int depth)
+{
+    MockDecoder d = { 0 };
+    Source src = { 0, NB_PACKETS };
+    NILatencyHist hist = { 0 };
+    NIDecPrefetch *p = NULL;
+    char name[32];
+    int nb_frames;
+
+    snprintf(name, sizeof(name), depth ? "prefetch %d" : "sync", depth);
+    if (depth && ff_ni_dec_prefetch_alloc(&p, &mock_ops, &d, NULL, depth) < 0)
+        return 1;
+
+    nb_frames = drain(name, p, &d, &src, NB_PACKETS + 1, &hist);
+    if (nb_frames >= 0)
+        printf("%s: %d frames in order\n", name, nb_frames);
+    ff_ni_latency_report(NULL, name, &hist);
+    if (p)
+        ff_ni_dec_prefetch_report(p);
+
+    ff_ni_dec_prefetch_free(&p);
+    return nb_frames != NB_PACKETS;
+}
+
+/* a seek: the frames prepared for the old position must not come out */
+static int run_flush(int depth)
+{
+    MockDecoder d = { 0 };
+    Source src = { 0, NB_PACKETS };
+    NILatencyHist hist = { 0 };
+    NIDecPrefetch *p = NULL;
+    int before, after;
+
+    if (ff_ni_dec_prefetch_alloc(&p, &mock_ops, &d, NULL, depth) < 0)
+        return 1;
+
+    before = drain("flush", p, &d, &src, 10, &hist);
+    ff_ni_dec_prefetch_flush(p);
+    mock_reset(&d);
+
+    src.next = 100;
+    src.end  = 120;
+    after = drain("flush", p, &d, &src, NB_PACKETS, &hist);
+    printf("prefetch %d flush: %d frames before, %d after\n", depth, before, after);
+
+    ff_ni_dec_prefetch_free(&p);
+    return before != 10 || after != 20;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+
+    /* -v prints the receive latency histograms */
+    av_log_set_level(argc > 1 && !strcmp(argv[1], "-v") ? AV_LOG_VERBOSE
+                                                        : AV_LOG_QUIET);
+
+    ret |= run(0);
+    ret |= run(1);
+    ret |= run(4);
+    ret |= run_flush(3);
+
+    return ret;
+}
@@ -0,0 +1,124 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/lfg.h"
+#include "libavcodec/ni_frame_ring.c"
+
+#define NB_FRAMES   200
+
+/*
+ * Random bursts of pushes and drops: the ring must hand the frames back in
+ * order, refuse pushes with EAGAIN when full instead of growing, and
+ * release every reference it took. The encoder side is covered by the
+ * nienc test on the emulated session.
+ */
+static int run(int size, unsigned seed)
+{
+    NIFrameRing ring = { 0 };
+    AVBufferRef *bufs[NB_FRAMES] = { NULL };
+    AVFrame *frame = av_frame_alloc();
+    AVLFG lfg;
+    int64_t next_pts = 0;
+    int nb_pushed = 0, nb_eagain = 0;
+    int err = 0, ret;
+
+    if (!frame || ff_ni_frame_ring_init(&ring, size) < 0)
+        return 1;
+    av_lfg_init(&lfg, seed);
+
+    while (next_pts < NB_FRAMES && !err) {
+        int burst = av_lfg_get(&lfg) % (2 * size + 1);
+
+        for (int i = 0; i < burst && nb_pushed < NB_FRAMES; i++) {
+            if (!frame->buf[0]) {
+                bufs[nb_pushed] = av_buffer_alloc(1);
+                if (!bufs[nb_pushed])
+                    return 1;
+                frame->buf[0] = av_buffer_ref(bufs[nb_pushed]);
+                if (!frame->buf[0])
+                    return 1;
+                frame->data[0] = frame->buf[0]->data;
+                frame->pts     = nb_pushed;
+            }
+            // alternate between queuing a new reference and moving ours
+            ret = ff_ni_frame_ring_push(&ring, frame, nb_pushed & 1);
+            if (ret == AVERROR(EAGAIN)) {
+                if (!ff_ni_frame_ring_full(&ring)) {
+                    printf("size %d: EAGAIN with %d frames queued\n", size, ring.nb_frames);
+                    err = 1;
+                }
+                nb_eagain++;
+                break;
+            } else if (ret < 0) {
+                printf("size %d: error %d\n", size, ret);
+                err = 1;
+                break;
+            }
+            av_frame_unref(frame);
+            nb_pushed++;
+        }
+
+        burst = av_lfg_get(&lfg) % (2 * size + 1);
+        for (int i = 0; i < burst && ring.nb_frames; i++) {
+            const AVFrame *head = ff_ni_frame_ring_peek(&ring);
+
+            if (head->pts != next_pts++) {
+                printf("size %d: frame %"PRId64" out of order\n", size, head->pts);
+                err = 1;
+            }
+            ff_ni_frame_ring_drop(&ring);
+        }
+        if (ring.nb_frames > size) {
+            printf("size %d: %d frames queued\n", size, ring.nb_frames);
+            err = 1;
+        }
+    }
+
+    if (ring.nb_full != nb_eagain) {
+        printf("size %d: %"PRId64" full counted\n", size, ring.nb_full);
+        err = 1;
+    }
+    ff_ni_frame_ring_uninit(&ring);
+    av_frame_free(&frame);
+
+    for (int i = 0; i < nb_pushed; i++) {
+        if (av_buffer_get_ref_count(bufs[i]) != 1) {
+            printf("size %d: frame %d still referenced\n", size, i);
+            err = 1;
+        }
+        av_buffer_unref(&bufs[i]);
+    }
+
+    printf("size %d: %"PRId64" frames, %d max queued, %d push EAGAIN%s\n",
+           size, next_pts, ring.nb_frames_max, nb_eagain, err ? ", FAILED" : "");
+
+    return err;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    ret |= run(1, 1);
+    ret |= run(2, 2);
+    ret |= run(8, 3);
+
+    return ret;
+}
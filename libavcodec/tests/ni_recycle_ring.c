@@ -0,0 +1,204 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "libavutil/lfg.h"
+#include "libavcodec/ni_recycle_ring.c"
+
+#define NB_ENCODERS 8
+#define NB_SLOTS    16
+#define NB_FRAMES   100000
+
+/*
+ * One encoder: a sending thread acquiring slots for its frames, and a
+ * recycling thread getting the frame indices back from the "device" in a
+ * random order and releasing their slots.
+ */
+typedef struct Encoder {
+    NIRecycleRing ring;
+    uint16_t owner[NB_SLOTS];       ///< written in the slot like the AVFrame ref
+    atomic_int busy[NB_SLOTS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint16_t device[NB_SLOTS];      ///< frames in flight, protected by lock
+    int nb_device;
+    int sent_all;
+
+    unsigned seed;
+    atomic_int errors;
+} Encoder;
+
+static uint16_t frame_index(int n)
+{
+    // spread over the whole range, the multiplier is odd so no two of the
+    // frames in flight share an index
+    return (uint16_t)(n * 40503u);
+}
+
+static void *send_thread(void *arg)
+{
+    Encoder *e = arg;
+
+    for (int n = 0; n < NB_FRAMES; n++) {
+        uint16_t idx = frame_index(n);
+        int slot;
+
+        slot = ff_ni_recycle_ring_acquire(&e->ring, idx);
+        while (slot == AVERROR(EAGAIN)) {
+            pthread_mutex_lock(&e->lock);
+            slot = ff_ni_recycle_ring_acquire(&e->ring, idx);
+            if (slot == AVERROR(EAGAIN))
+                pthread_cond_wait(&e->cond, &e->lock);
+            pthread_mutex_unlock(&e->lock);
+        }
+        if (slot < 0 || slot >= NB_SLOTS || atomic_exchange(&e->busy[slot], 1)) {
+            atomic_fetch_add(&e->errors, 1);
+            continue;
+        }
+        e->owner[slot] = idx;
+
+        pthread_mutex_lock(&e->lock);
+        e->device[e->nb_device++] = idx;
+        pthread_cond_broadcast(&e->cond);
+        pthread_mutex_unlock(&e->lock);
+    }
+
+    pthread_mutex_lock(&e->lock);
+    e->sent_all = 1;
+    pthread_cond_broadcast(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+    return NULL;
+}
+
+static void *recycle_thread(void *arg)
+{
+    Encoder *e = arg;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, e->seed);
+
+    for (;;) {
+        uint16_t idx;
+        int slot;
+
+        pthread_mutex_lock(&e->lock);
+        while (!e->nb_device && !e->sent_all)
+            pthread_cond_wait(&e->cond, &e->lock);
+        if (!e->nb_device) {
+            pthread_mutex_unlock(&e->lock);
+            break;
+        }
+        slot = av_lfg_get(&lfg) % e->nb_device;
+        idx  = e->device[slot];
+        e->device[slot] = e->device[--e->nb_device];
+        pthread_mutex_unlock(&e->lock);
+
+        slot = ff_ni_recycle_ring_lookup(&e->ring, idx);
+        if (slot < 0 || e->owner[slot] != idx || !atomic_load(&e->busy[slot])) {
+            atomic_fetch_add(&e->errors, 1);
+            continue;
+        }
+        e->owner[slot] = 0;
+        atomic_store(&e->busy[slot], 0);
+        if (ff_ni_recycle_ring_release(&e->ring, idx) != slot)
+            atomic_fetch_add(&e->errors, 1);
+
+        pthread_mutex_lock(&e->lock);
+        pthread_cond_broadcast(&e->cond);
+        pthread_mutex_unlock(&e->lock);
+    }
+    return NULL;
+}
+
+static int test_single(void)
+{
+    NIRecycleRing ring;
+    int err = 0;
+
+    if (ff_ni_recycle_ring_init(&ring, NI_RECYCLE_RING_MAX_SLOTS + 1) != AVERROR(EINVAL) ||
+        ff_ni_recycle_ring_init(&ring, 4) < 0)
+        return 1;
+
+    for (int i = 0; i < 4; i++)
+        err |= ff_ni_recycle_ring_acquire(&ring, 100 + i) != i;
+    err |= ff_ni_recycle_ring_acquire(&ring, 200) != AVERROR(EAGAIN);
+    err |= ff_ni_recycle_ring_lookup(&ring, 102) != 2;
+    err |= ff_ni_recycle_ring_lookup(&ring, 200) != -1;
+    err |= ff_ni_recycle_ring_release(&ring, 200) != -1;
+    err |= ff_ni_recycle_ring_release(&ring, 102) != 2;
+    err |= ff_ni_recycle_ring_release(&ring, 102) != -1;
+    err |= ff_ni_recycle_ring_acquire(&ring, 65535) != 2;
+    err |= ff_ni_recycle_ring_lookup(&ring, 65535) != 2;
+
+    ff_ni_recycle_ring_uninit(&ring);
+    printf("single thread: %s\n", err ? "FAILED" : "ok");
+    return err;
+}
+
+int main(void)
+{
+    static Encoder enc[NB_ENCODERS];
+    pthread_t threads[NB_ENCODERS][2];
+    int ret = test_single();
+
+    for (int i = 0; i < NB_ENCODERS; i++) {
+        Encoder *e = &enc[i];
+
+        if (ff_ni_recycle_ring_init(&e->ring, NB_SLOTS) < 0)
+            return 1;
+        for (int j = 0; j < NB_SLOTS; j++)
+            atomic_init(&e->busy[j], 0);
+        atomic_init(&e->errors, 0);
+        e->seed = i + 1;
+        pthread_mutex_init(&e->lock, NULL);
+        pthread_cond_init(&e->cond, NULL);
+    }
+
+    for (int i = 0; i < NB_ENCODERS; i++) {
+        if (pthread_create(&threads[i][0], NULL, send_thread, &enc[i]) ||
+            pthread_create(&threads[i][1], NULL, recycle_thread, &enc[i]))
+            return 1;
+    }
+
+    for (int i = 0; i < NB_ENCODERS; i++) {
+        Encoder *e = &enc[i];
+        int nb_free = 0;
+
+        pthread_join(threads[i][0], NULL);
+        pthread_join(threads[i][1], NULL);
+
+        // every slot is back in the free list exactly once
+        while (ff_ni_recycle_ring_acquire(&e->ring, nb_free) >= 0)
+            nb_free++;
+        if (nb_free != NB_SLOTS)
+            atomic_fetch_add(&e->errors, 1);
+
+        printf("encoder %d: %d frames, %d slots free%s\n", i, NB_FRAMES, nb_free,
+               atomic_load(&e->errors) ? ", FAILED" : "");
+        ret |= !!atomic_load(&e->errors);
+
+        ff_ni_recycle_ring_uninit(&e->ring);
+        pthread_mutex_destroy(&e->lock);
+        pthread_cond_destroy(&e->cond);
+    }
+
+    return ret;
+}
@@ -0,0 +1,210 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Runs the h264_ni_quadra encoder on the emulated session in compat/ni_mock.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/log.h"
+#include "libavutil/mastering_display_metadata.h"
+#include "libavutil/opt.h"
+#include "libavcodec/nienc.c"
+#include "libavcodec/nienc_h264.c"
+#include "libavcodec/ni_enc_pool.c"
+#include "libavcodec/ni_frame_ring.c"
+#include "libavcodec/ni_recycle_ring.c"
+#include "compat/ni_mock/ni_mock.c"
+
+static int verbose = 1;
+/* attach HDR static metadata, the content light level changing at this frame */
+static int hdr_change_at;
+
+typedef struct EncodeStats {
+    int nb_packets;
+    int nb_keys;
+    int nb_eagain;
+    int64_t next_pts;
+} EncodeStats;
+
+static void fill_frame(AVFrame *frame, int n)
+{
+    for (int p = 0; p < 3; p++) {
+        int w = p ? AV_CEIL_RSHIFT(frame->width,  1) : frame->width;
+        int h = p ? AV_CEIL_RSHIFT(frame->height, 1) : frame->height;
+
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+                frame->data[p][y * frame->linesize[p] + x] = x + 3 * y + 7 * n + 64 * p;
+    }
+}
+
+/* take up to max_packets packets, all available ones if 0 */
+static int receive_packets(AVCodecContext *avctx, AVPacket *pkt, EncodeStats *st,
+                           int max_packets)
+{
+    int ret = 0;
+
+    for (int n = 0; !max_packets || n < max_packets; n++) {
+        ret = avcodec_receive_packet(avctx, pkt);
+        if (ret < 0)
+            break;
+        if (verbose)
+            printf("%dx%d pts %3"PRId64" dts %3"PRId64" size %3d%s adler %08x\n",
+                   avctx->width, avctx->height, pkt->pts, pkt->dts, pkt->size,
+                   pkt->flags & AV_PKT_FLAG_KEY ? " key" : "    ",
+                   (unsigned)av_adler32_update(1, pkt->data, pkt->size));
+        if (pkt->pts != st->next_pts++)
+            printf("packet %"PRId64" out of order\n", pkt->pts);
+        st->nb_packets++;
+        st->nb_keys += !!(pkt->flags & AV_PKT_FLAG_KEY);
+        av_packet_unref(pkt);
+    }
+    if (ret == AVERROR_EOF)
+        return 1;
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+typedef struct Segment {
+    int width, height, nb_frames;
+} Segment;
+
+/* encode the segments back to back, then drain */
+static int encode(const char *params, int max_packets, const Segment *seg, int nb_seg)
+{
+    AVCodecContext *avctx = avcodec_alloc_context3(&ff_h264_ni_quadra_encoder.p);
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *pkt = av_packet_alloc();
+    EncodeStats st = { 0 };
+    int64_t nb_full = 0, queued_max = 0;
+    int nb_frames = 0, ret;
+
+    if (!avctx || !frame || !pkt)
+        return AVERROR(ENOMEM);
+
+    avctx->width     = seg[0].width;
+    avctx->height    = seg[0].height;
+    avctx->pix_fmt   = AV_PIX_FMT_YUV420P;
+    avctx->time_base = (AVRational){ 1, 25 };
+    avctx->framerate = (AVRational){ 25, 1 };
+    av_opt_set(avctx->priv_data, "xcoder-params", params, 0);
+
+    ret = avcodec_open2(avctx, NULL, NULL);
+    if (ret < 0)
+        goto end;
+
+    for (int s = 0; s < nb_seg; s++) {
+        for (int i = 0; i < seg[s].nb_frames; i++) {
+            frame->format = avctx->pix_fmt;
+            frame->width  = seg[s].width;
+            frame->height = seg[s].height;
+            ret = av_frame_get_buffer(frame, 0);
+            if (ret < 0)
+                goto end;
+            fill_frame(frame, nb_frames);
+            if (hdr_change_at) {
+                AVContentLightMetadata *cll =
+                    av_content_light_metadata_create_side_data(frame);
+                AVMasteringDisplayMetadata *mdcv =
+                    av_mastering_display_metadata_create_side_data(frame);
+                if (!cll || !mdcv) {
+                    ret = AVERROR(ENOMEM);
+                    goto end;
+                }
+                cll->MaxCLL  = 1000;
+                cll->MaxFALL = nb_frames < hdr_change_at ? 400 : 600;
+                mdcv->min_luminance = av_make_q(50, 10000);
+                mdcv->max_luminance = av_make_q(1000, 1);
+                mdcv->has_luminance = 1;
+            }
+            frame->pts = nb_frames++;
+
+            // EAGAIN: the frame is held back until the encoder has room
+            while ((ret = avcodec_send_frame(avctx, frame)) == AVERROR(EAGAIN)) {
+                st.nb_eagain++;
+                ret = receive_packets(avctx, pkt, &st, max_packets);
+                if (ret < 0)
+                    goto end;
+            }
+            if (ret < 0)
+                goto end;
+            av_frame_unref(frame);
+
+            ret = receive_packets(avctx, pkt, &st, max_packets);
+            if (ret < 0)
+                goto end;
+        }
+    }
+
+    ret = avcodec_send_frame(avctx, NULL);
+    while (!ret)
+        ret = receive_packets(avctx, pkt, &st, 0);
+
+end:
+    av_opt_get_int(avctx->priv_data, "queue_full", 0, &nb_full);
+    av_opt_get_int(avctx->priv_data, "queue_frames_max", 0, &queued_max);
+    printf("%s: %d frames, %d packets, %d keyframes, %d send EAGAIN, "
+           "queue full %"PRId64" times, %"PRId64" max queued%s\n",
+           params, nb_frames, st.nb_packets, st.nb_keys, st.nb_eagain,
+           nb_full, queued_max, ret < 0 ? ", FAILED" : "");
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    avcodec_free_context(&avctx);
+    return ret < 0 || st.nb_packets != nb_frames;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    ret |= encode("intraPeriod=8", 0, (const Segment[]){ { 320, 240, 20 } }, 1);
+    ret |= encode("intraPeriod=16:lookAheadDepth=4", 0,
+                  (const Segment[]){ { 352, 288, 24 } }, 1);
+
+    /* HDR SEI go out with each IDR, though the session is only handed the
+     * metadata again when it changes */
+    hdr_change_at = 12;
+    ret |= encode("intraPeriod=8", 0, (const Segment[]){ { 320, 240, 20 } }, 1);
+    hdr_change_at = 0;
+
+    /* a slow device and a caller taking one packet per frame, so that the
+     * input queue fills up while a sequence change drains; the caller must
+     * see EAGAIN from avcodec_send_frame() and no error */
+    ni_mock_ticks_per_frame = 8;
+    ret |= encode("intraPeriod=30:lookAheadDepth=4", 1,
+                  (const Segment[]){ { 352, 288, 12 }, { 320, 240, 12 },
+                                     { 416, 240, 12 } }, 3);
+
+    /* the same with packets held back at random by the device: no frame
+     * may be lost or reordered around the sequence changes */
+    verbose = 0;
+    for (unsigned seed = 1; seed <= 8; seed++) {
+        ni_mock_delay_seed = seed;
+        ni_mock_ticks_per_frame = 2 + seed % 4;
+        ret |= encode("intraPeriod=30:lookAheadDepth=4", seed % 3,
+                      (const Segment[]){ { 352, 288, 10 }, { 320, 240, 7 },
+                                         { 352, 288, 1 }, { 416, 240, 12 } }, 4);
+    }
+    ni_mock_delay_seed = 0;
+
+    return ret;
+}
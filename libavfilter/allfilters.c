@@ -229,6 +229,7 @@ extern const AVFilter ff_vf_colormatrix;
 extern const AVFilter ff_vf_colorspace;
 extern const AVFilter ff_vf_colorspace_cuda;
 extern const AVFilter ff_vf_colortemperature;
+extern const AVFilter ff_vf_compose_ni_quadra;
 extern const AVFilter ff_vf_convolution;
 extern const AVFilter ff_vf_convolution_opencl;
 extern const AVFilter ff_vf_convolve;
@@ -0,0 +1,167 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/eval.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+
+#include "ni_compose.h"
+
+static const char *const var_names[] = { "W", "H", "w", "h", NULL };
+
+enum { VAR_MAIN_W, VAR_MAIN_H, VAR_LAYER_W, VAR_LAYER_H, VAR_VARS_NB };
+
+static int eval_coord(const char *expr, const double *var_values, int *coord,
+                      void *log_ctx)
+{
+    double d;
+    int ret;
+
+    ret = av_expr_parse_and_eval(&d, expr, var_names, var_values,
+                                 NULL, NULL, NULL, NULL, NULL, 0, log_ctx);
+    if (ret < 0 || isnan(d) || d < 0 || d > INT_MAX - 1) {
+        av_log(log_ctx, AV_LOG_ERROR, "Invalid layer coordinate '%s'\n", expr);
+        return AVERROR(EINVAL);
+    }
+    *coord = FFALIGN((int)d, 2);
+    return 0;
+}
+
+static int intersects(const NIComposeLayer *a, const NIComposeLayer *b)
+{
+    return a->x < b->x + b->w && b->x < a->x + a->w &&
+           a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+int ff_ni_compose_layout(NICompose *c, const char *layout, int nb_layers,
+                         int main_w, int main_h, const int *w, const int *h,
+                         void *log_ctx)
+{
+    double var_values[VAR_VARS_NB];
+    char *str, *p, *saveptr = NULL;
+    int x1 = INT_MAX, y1 = INT_MAX, x2 = 0, y2 = 0;
+    int ret = 0;
+
+    memset(c, 0, sizeof(*c));
+    if (nb_layers < 1 || nb_layers > NI_COMPOSE_MAX_LAYERS)
+        return AVERROR(EINVAL);
+    c->nb_layers = nb_layers;
+
+    str = av_strdup(layout ? layout : "");
+    if (!str)
+        return AVERROR(ENOMEM);
+
+    var_values[VAR_MAIN_W] = main_w;
+    var_values[VAR_MAIN_H] = main_h;
+
+    p = str;
+    for (int i = 0; i < nb_layers; i++) {
+        NIComposeLayer *l = &c->layers[i];
+        char *arg, *sep;
+
+        if (!(arg = av_strtok(p, "|", &saveptr)) || !(sep = strchr(arg, '_'))) {
+            av_log(log_ctx, AV_LOG_ERROR, "No position for layer %d\n", i);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        p = NULL;
+        *sep = 0;
+
+        l->w = FFALIGN(w[i], 2);
+        l->h = FFALIGN(h[i], 2);
+        var_values[VAR_LAYER_W] = l->w;
+        var_values[VAR_LAYER_H] = l->h;
+        if ((ret = eval_coord(arg,     var_values, &l->x, log_ctx)) < 0 ||
+            (ret = eval_coord(sep + 1, var_values, &l->y, log_ctx)) < 0)
+            goto end;
+
+        if (l->x + (int64_t)l->w > main_w || l->y + (int64_t)l->h > main_h) {
+            av_log(log_ctx, AV_LOG_ERROR,
+                   "Layer %d (%dx%d at %d,%d) does not fit in the main "
+                   "picture (%dx%d)\n", i, l->w, l->h, l->x, l->y,
+                   main_w, main_h);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+
+        for (int j = 0; j < i && !c->overlap; j++)
+            if (intersects(&c->layers[j], l))
+                c->overlap = i;
+
+        x1 = FFMIN(x1, l->x);
+        y1 = FFMIN(y1, l->y);
+        x2 = FFMAX(x2, l->x + l->w);
+        y2 = FFMAX(y2, l->y + l->h);
+    }
+
+    c->sheet_x = x1;
+    c->sheet_y = y1;
+    c->sheet_w = x2 - x1;
+    c->sheet_h = y2 - y1;
+
+end:
+    av_free(str);
+    return ret;
+}
+
+int ff_ni_compose_update(NICompose *c, int layer, uint16_t session_id,
+                         uint16_t frame_idx)
+{
+    NIComposeLayer *l = &c->layers[layer];
+    int changed = !l->cached || l->session_id != session_id ||
+                  l->frame_idx != frame_idx;
+
+    l->cached     = 1;
+    l->session_id = session_id;
+    l->frame_idx  = frame_idx;
+    return changed;
+}
+
+void ff_ni_compose_invalidate(NICompose *c)
+{
+    for (int i = 0; i < c->nb_layers; i++)
+        c->layers[i].cached = 0;
+}
+
+void ff_ni_compose_count(NICompose *c, int nb_jobs, int sheet_built)
+{
+    c->frames++;
+    c->jobs         += nb_jobs;
+    c->sheet_builds += sheet_built;
+}
+
+void ff_ni_compose_report(const NICompose *c, void *log_ctx)
+{
+    uint64_t chained = c->frames * c->nb_layers;
+
+    if (!c->frames)
+        return;
+
+    av_log(log_ctx, AV_LOG_VERBOSE,
+           "%"PRIu64" frames, %d layers: %"PRIu64" scaler jobs, %"PRIu64
+           " sheets built, %"PRId64" round trips saved over chained overlays\n",
+           c->frames, c->nb_layers, c->jobs, c->sheet_builds,
+           (int64_t)(chained - c->jobs));
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Layer bookkeeping of the ni_quadra_compose filter: where the layers go
+ * on the main picture, the sheet they are gathered on, which layers changed
+ * since the sheet was built and how many scaler jobs that took.
+ */
+
+#ifndef AVFILTER_NI_COMPOSE_H
+#define AVFILTER_NI_COMPOSE_H
+
+#include <stdint.h>
+
+/* the scaler takes 8 inputs per job, one of them is the main picture */
+#define NI_COMPOSE_MAX_LAYERS 7
+
+typedef struct NIComposeLayer {
+    int x, y, w, h;             ///< placement on the main picture, even
+
+    /* surface the layer had when the sheet was last built */
+    int cached;
+    uint16_t session_id;
+    uint16_t frame_idx;
+} NIComposeLayer;
+
+typedef struct NICompose {
+    int nb_layers;
+    NIComposeLayer layers[NI_COMPOSE_MAX_LAYERS];
+
+    /* bounding box of the layers on the main picture */
+    int sheet_x, sheet_y, sheet_w, sheet_h;
+    /* index of a layer drawn over an earlier one, 0 if none */
+    int overlap;
+
+    uint64_t frames;
+    uint64_t jobs;
+    uint64_t sheet_builds;
+} NICompose;
+
+/**
+ * Place the layers on the main picture.
+ *
+ * @param layout "x_y" per layer, separated by '|'. The coordinates are
+ *               expressions of W, H (main size) and w, h (layer size).
+ * @param w,h    layer sizes
+ * @return 0 on success, AVERROR(EINVAL) if the layout is invalid or a layer
+ *         does not fit in the main picture
+ */
+int ff_ni_compose_layout(NICompose *c, const char *layout, int nb_layers,
+                         int main_w, int main_h, const int *w, const int *h,
+                         void *log_ctx);
+
+/**
+ * Record the surface of a layer.
+ *
+ * @return 1 if it differs from the one the sheet was built with, 0 otherwise
+ */
+int ff_ni_compose_update(NICompose *c, int layer, uint16_t session_id,
+                         uint16_t frame_idx);
+
+/** Forget the surfaces, the next frame builds the sheet again. */
+void ff_ni_compose_invalidate(NICompose *c);
+
+/** Account an output frame made with nb_jobs scaler jobs. */
+void ff_ni_compose_count(NICompose *c, int nb_jobs, int sheet_built);
+
+/**
+ * Log the scaler jobs made and the ones a chain of overlays would have
+ * needed at verbose level.
+ */
+void ff_ni_compose_report(const NICompose *c, void *log_ctx);
+
+#endif /* AVFILTER_NI_COMPOSE_H */
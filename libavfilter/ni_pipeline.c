@@ -0,0 +1,395 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+
+#include "config.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "ni_pipeline.h"
+
+/*
+ * libxcoder has no completion event for device reads, so the worker still
+ * has to poll the oldest job; it backs off while the device is busy.
+ */
+#define POLL_MIN_US 50
+#define POLL_MAX_US 800
+
+enum WorkerStep {
+    STEP_IDLE,    ///< nothing queued or submitted
+    STEP_BUSY,    ///< the oldest submitted job is not done yet
+    STEP_DONE,    ///< a job was submitted or collected
+};
+
+typedef struct PipelineSlot {
+    void *job;
+    AVFrame *frame;
+    int ret;
+    int64_t push_time;
+    int64_t done_time;
+} PipelineSlot;
+
+struct NIPipeline {
+    const NIPipelineOps *ops;
+    void *opaque;
+    void *log_ctx;
+
+    PipelineSlot *slots;
+    int depth;
+
+    /* sequence numbers of jobs, the slot of job n is n % depth */
+    unsigned pushed;
+    unsigned submitted;
+    unsigned collected;
+    unsigned popped;
+    unsigned released;
+
+    AVMutex lock;
+    AVCond work_cond;   ///< signalled to the worker on push and quit
+    AVCond done_cond;   ///< signalled to the filter when a job is done
+    int quit;
+    int poll_us;
+#if HAVE_THREADS
+    pthread_t worker;
+    int worker_started;
+#endif
+
+    uint64_t nb_jobs;
+    uint64_t depth_sum;
+    int depth_max;
+    int64_t latency_sum;
+    int64_t latency_max;
+};
+
+static PipelineSlot *slot(NIPipeline *p, unsigned seq)
+{
+    return &p->slots[seq % p->depth];
+}
+
+static const char *job_name(NIPipeline *p)
+{
+    return p->ops->job_name ? p->ops->job_name : "job";
+}
+
+/* must be called with the lock held, which is dropped around device calls */
+static enum WorkerStep worker_step(NIPipeline *p)
+{
+    PipelineSlot *s;
+    int ret;
+
+    if (p->submitted != p->pushed) {
+        s = slot(p, p->submitted);
+        ff_mutex_unlock(&p->lock);
+        ret = p->ops->submit(p->opaque, s->job);
+        ff_mutex_lock(&p->lock);
+        if (ret < 0)
+            s->ret = ret;
+        p->submitted++;
+        return STEP_DONE;
+    }
+
+    if (p->collected != p->submitted) {
+        s = slot(p, p->collected);
+        /* a job that failed to submit has nothing to collect */
+        if (s->ret >= 0) {
+            ff_mutex_unlock(&p->lock);
+            ret = p->ops->collect(p->opaque, s->job);
+            ff_mutex_lock(&p->lock);
+            if (!ret)
+                return STEP_BUSY;
+            if (ret < 0)
+                s->ret = ret;
+        }
+        s->done_time = av_gettime_relative();
+        p->collected++;
+        p->poll_us = POLL_MIN_US;
+        ff_cond_broadcast(&p->done_cond);
+        return STEP_DONE;
+    }
+
+    return STEP_IDLE;
+}
+
+static void worker_wait_device(NIPipeline *p)
+{
+    ff_mutex_unlock(&p->lock);
+    av_usleep(p->poll_us);
+    ff_mutex_lock(&p->lock);
+    p->poll_us = FFMIN(p->poll_us * 2, POLL_MAX_US);
+}
+
+#if HAVE_THREADS
+static void *worker_thread(void *arg)
+{
+    NIPipeline *p = arg;
+
+    ff_mutex_lock(&p->lock);
+    while (!p->quit) {
+        switch (worker_step(p)) {
+        case STEP_IDLE:
+            ff_cond_wait(&p->work_cond, &p->lock);
+            break;
+        case STEP_BUSY:
+            worker_wait_device(p);
+            break;
+        case STEP_DONE:
+            break;
+        }
+    }
+    ff_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+#endif
+
+int ff_ni_pipeline_alloc(NIPipeline **pipeline, const NIPipelineOps *ops,
+                         void *opaque, void *log_ctx, int depth,
+                         size_t job_size)
+{
+    NIPipeline *p;
+    int i, ret;
+
+    if (depth < 1)
+        return AVERROR(EINVAL);
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    p->ops     = ops;
+    p->opaque  = opaque;
+    p->log_ctx = log_ctx;
+    p->depth   = depth;
+    p->poll_us = POLL_MIN_US;
+
+    p->slots = av_calloc(depth, sizeof(*p->slots));
+    if (!p->slots) {
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < depth; i++) {
+        p->slots[i].job = av_mallocz(FFMAX(job_size, 1));
+        if (!p->slots[i].job)
+            goto fail_slots;
+    }
+
+    if ((ret = ff_mutex_init(&p->lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = ff_cond_init(&p->work_cond, NULL))) {
+        ff_mutex_destroy(&p->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = ff_cond_init(&p->done_cond, NULL))) {
+        ff_cond_destroy(&p->work_cond);
+        ff_mutex_destroy(&p->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+#if HAVE_THREADS
+    if ((ret = pthread_create(&p->worker, NULL, worker_thread, p))) {
+        ff_cond_destroy(&p->done_cond);
+        ff_cond_destroy(&p->work_cond);
+        ff_mutex_destroy(&p->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    p->worker_started = 1;
+#endif
+
+    *pipeline = p;
+    return 0;
+
+fail_slots:
+    ret = AVERROR(ENOMEM);
+fail:
+    for (i = 0; i < depth; i++)
+        av_free(p->slots[i].job);
+    av_free(p->slots);
+    av_free(p);
+    return ret;
+}
+
+void ff_ni_pipeline_free(NIPipeline **pipeline)
+{
+    NIPipeline *p = *pipeline;
+    int i;
+
+    if (!p)
+        return;
+
+#if HAVE_THREADS
+    if (p->worker_started) {
+        ff_mutex_lock(&p->lock);
+        p->quit = 1;
+        ff_cond_signal(&p->work_cond);
+        ff_mutex_unlock(&p->lock);
+        pthread_join(p->worker, NULL);
+    }
+#endif
+    ff_cond_destroy(&p->done_cond);
+    ff_cond_destroy(&p->work_cond);
+    ff_mutex_destroy(&p->lock);
+
+    for (i = 0; i < p->depth; i++) {
+        av_frame_free(&p->slots[i].frame);
+        if (p->ops->uninit_job)
+            p->ops->uninit_job(p->opaque, p->slots[i].job);
+        av_free(p->slots[i].job);
+    }
+    av_free(p->slots);
+    av_freep(pipeline);
+}
+
+void *ff_ni_pipeline_next_job(NIPipeline *p)
+{
+    void *job = NULL;
+
+    ff_mutex_lock(&p->lock);
+    if (p->pushed - p->released < (unsigned)p->depth)
+        job = slot(p, p->pushed)->job;
+    ff_mutex_unlock(&p->lock);
+
+    return job;
+}
+
+int ff_ni_pipeline_push(NIPipeline *p, AVFrame *frame)
+{
+    PipelineSlot *s;
+    int in_flight;
+
+    ff_mutex_lock(&p->lock);
+    if (p->pushed - p->released >= (unsigned)p->depth) {
+        ff_mutex_unlock(&p->lock);
+        return AVERROR(EAGAIN);
+    }
+
+    s = slot(p, p->pushed);
+    s->frame     = frame;
+    s->ret       = 0;
+    s->push_time = av_gettime_relative();
+    p->pushed++;
+
+    in_flight     = p->pushed - p->popped;
+    p->depth_sum += in_flight;
+    p->depth_max  = FFMAX(p->depth_max, in_flight);
+
+#if HAVE_THREADS
+    ff_cond_signal(&p->work_cond);
+#else
+    worker_step(p);
+#endif
+    ff_mutex_unlock(&p->lock);
+
+    return 0;
+}
+
+int ff_ni_pipeline_pop(NIPipeline *p, AVFrame **frame, void **job,
+                       int block)
+{
+    PipelineSlot *s;
+    int64_t latency;
+    int ret;
+
+    *frame = NULL;
+    *job   = NULL;
+
+    ff_mutex_lock(&p->lock);
+    // a slot is reused once released, the previous job has to be first
+    av_assert0(p->released == p->popped);
+    if (p->popped == p->pushed) {
+        ff_mutex_unlock(&p->lock);
+        return 0;
+    }
+
+    while (p->popped == p->collected) {
+#if HAVE_THREADS
+        if (!block) {
+            ff_mutex_unlock(&p->lock);
+            return 0;
+        }
+        ff_cond_wait(&p->done_cond, &p->lock);
+#else
+        enum WorkerStep step = worker_step(p);
+        if (step == STEP_BUSY) {
+            if (!block) {
+                ff_mutex_unlock(&p->lock);
+                return 0;
+            }
+            worker_wait_device(p);
+        }
+#endif
+    }
+
+    s = slot(p, p->popped++);
+    *frame   = s->frame;
+    *job     = s->job;
+    s->frame = NULL;
+    ret      = s->ret;
+
+    latency         = s->done_time - s->push_time;
+    p->nb_jobs++;
+    p->latency_sum += latency;
+    p->latency_max  = FFMAX(p->latency_max, latency);
+    av_log(p->log_ctx, AV_LOG_DEBUG, "%s %u: %" PRId64 " us, %u in flight\n",
+           job_name(p), p->popped - 1, latency, p->pushed - p->popped + 1);
+    ff_mutex_unlock(&p->lock);
+
+    return ret < 0 ? ret : 1;
+}
+
+void ff_ni_pipeline_release(NIPipeline *p)
+{
+    ff_mutex_lock(&p->lock);
+    if (p->released != p->popped)
+        p->released++;
+    ff_mutex_unlock(&p->lock);
+}
+
+int ff_ni_pipeline_pending(NIPipeline *p)
+{
+    int pending;
+
+    ff_mutex_lock(&p->lock);
+    pending = p->pushed - p->popped;
+    ff_mutex_unlock(&p->lock);
+
+    return pending;
+}
+
+void ff_ni_pipeline_report(NIPipeline *p, void *log_ctx)
+{
+    if (!p || !p->nb_jobs)
+        return;
+
+    av_log(log_ctx, AV_LOG_VERBOSE,
+           "%" PRIu64 " %ss, depth %d: %.2f in flight on average, "
+           "%d max, latency %.1f us average, %" PRId64 " us max\n",
+           p->nb_jobs, job_name(p), p->depth, (double)p->depth_sum / p->pushed,
+           p->depth_max, (double)p->latency_sum / p->nb_jobs, p->latency_max);
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Keeps several jobs in flight on a device session, such as inferences on
+ * an AI session or uploads. A worker thread submits the queued jobs and
+ * collects their results in order, the filter thread pushes jobs and sleeps
+ * on a condition until the oldest one is done instead of polling the device
+ * itself.
+ */
+
+#ifndef AVFILTER_NI_PIPELINE_H
+#define AVFILTER_NI_PIPELINE_H
+
+#include <stdint.h>
+
+#include "libavutil/frame.h"
+
+typedef struct NIPipelineOps {
+    /**
+     * Send the input of job to the device. Called on the worker thread, in
+     * push order.
+     *
+     * @return 0 on success, a negative AVERROR on failure
+     */
+    int (*submit)(void *opaque, void *job);
+
+    /**
+     * Try to read the result of the oldest submitted job. Called on the
+     * worker thread.
+     *
+     * @return >0 when the result was read, 0 when it is not ready yet,
+     *         a negative AVERROR on failure
+     */
+    int (*collect)(void *opaque, void *job);
+
+    /** Free what the filter allocated in a job, may be NULL. */
+    void (*uninit_job)(void *opaque, void *job);
+
+    /** What a job is in the logs, "job" if NULL. */
+    const char *job_name;
+} NIPipelineOps;
+
+typedef struct NIPipeline NIPipeline;
+
+/**
+ * @param opaque   passed to the callbacks
+ * @param depth    maximum number of jobs pushed and not yet released
+ * @param job_size size of the filter specific job data of every slot
+ */
+int ff_ni_pipeline_alloc(NIPipeline **pipeline, const NIPipelineOps *ops,
+                         void *opaque, void *log_ctx, int depth,
+                         size_t job_size);
+
+void ff_ni_pipeline_free(NIPipeline **pipeline);
+
+/**
+ * @return the job data of the next slot to fill, or NULL when depth jobs
+ *         are already in the pipeline
+ */
+void *ff_ni_pipeline_next_job(NIPipeline *pipeline);
+
+/**
+ * Queue the slot returned by ff_ni_pipeline_next_job(). frame is
+ * handed back with the job by ff_ni_pipeline_pop().
+ */
+int ff_ni_pipeline_push(NIPipeline *pipeline, AVFrame *frame);
+
+/**
+ * Take the oldest job once its result was collected. The slot stays in use
+ * until ff_ni_pipeline_release(), which has to be called before the next
+ * pop, also when the job failed.
+ *
+ * @param block wait for the oldest job instead of returning 0 if it is
+ *              not done
+ * @return 1 with *frame and *job set, 0 if no job is done (or none is
+ *         pending), a negative AVERROR with *frame and *job set if its
+ *         submission or collection failed
+ */
+int ff_ni_pipeline_pop(NIPipeline *pipeline, AVFrame **frame, void **job,
+                       int block);
+
+void ff_ni_pipeline_release(NIPipeline *pipeline);
+
+/** @return the number of jobs pushed and not popped */
+int ff_ni_pipeline_pending(NIPipeline *pipeline);
+
+/** Log the queue depth and latency statistics at verbose level. */
+void ff_ni_pipeline_report(NIPipeline *pipeline, void *log_ctx);
+
+#endif /* AVFILTER_NI_PIPELINE_H */
@@ -0,0 +1,161 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "ni_pool_plan.h"
+
+/* filtergraphs have no cycles, this only bounds the recursion */
+#define MAX_WALK_DEPTH 64
+
+static int is_ni_producer(const AVFilterContext *ctx)
+{
+    static const char prefix[] = "ni_quadra_";
+    const char *name = ctx->filter->name;
+
+    if (strncmp(name, prefix, sizeof(prefix) - 1))
+        return 0;
+    // these forward their input frames when they are already on the device
+    return strcmp(name, "ni_quadra_split") && strcmp(name, "ni_quadra_hwupload");
+}
+
+static int filter_demand(AVFilterContext *ctx, int in_format, int depth);
+
+static int outputs_demand(AVFilterContext *ctx, int format, int depth)
+{
+    int demand = 0, nb_branches = 0;
+
+    for (unsigned i = 0; i < ctx->nb_outputs; i++) {
+        AVFilterLink *out = ctx->outputs[i];
+
+        // frames of another format are new frames, not ours
+        if (!out || !out->dst || out->format != format)
+            continue;
+        demand = FFMAX(demand, filter_demand(out->dst, format, depth + 1));
+        nb_branches++;
+    }
+
+    // the branches do not consume the frames in lockstep
+    return nb_branches ? demand + nb_branches - 1 : -1;
+}
+
+static int filter_demand(AVFilterContext *ctx, int in_format, int depth)
+{
+    int demand;
+
+    if (is_ni_producer(ctx)) {
+        int64_t ai_depth;
+        int hold = ctx->nb_inputs > 1 ? 2 : 1;
+
+        if (av_opt_get_int(ctx, "depth", AV_OPT_SEARCH_CHILDREN, &ai_depth) >= 0)
+            hold = FFMAX(hold, ai_depth);
+        return hold;
+    }
+
+    if (depth >= MAX_WALK_DEPTH)
+        return 1;
+
+    demand = outputs_demand(ctx, in_format, depth);
+    // not forwarded anywhere: converted, downloaded or at a sink
+    return demand < 0 ? 1 : demand;
+}
+
+int ff_ni_pool_plan_demand(AVFilterContext *ctx)
+{
+    int demand = -1;
+
+    if (ctx->nb_outputs && ctx->outputs[0])
+        demand = outputs_demand(ctx, ctx->outputs[0]->format, 0);
+    return FFMAX(demand, 0);
+}
+
+int ff_ni_pool_plan(AVFilterContext *ctx, int min_size)
+{
+    int demand = ff_ni_pool_plan_demand(ctx);
+    int extra  = FFMAX(ctx->extra_hw_frames, 0);
+    int size   = av_clip(1 + demand + extra, min_size, FFMAX(min_size, NI_POOL_PLAN_MAX_SIZE));
+
+    av_log(ctx, AV_LOG_VERBOSE, "frame pool: %d frames planned, %d held downstream, "
+           "%d extra\n", size, demand, extra);
+    return size;
+}
+
+NIPoolUsage *ff_ni_pool_usage_alloc(int size)
+{
+    NIPoolUsage *u = av_mallocz(sizeof(*u));
+
+    if (!u)
+        return NULL;
+    atomic_init(&u->refs, 1);
+    atomic_init(&u->in_use, 0);
+    atomic_init(&u->peak, 0);
+    u->size = size;
+    return u;
+}
+
+void ff_ni_pool_usage_acquire(NIPoolUsage *u)
+{
+    int in_use, peak;
+
+    if (!u)
+        return;
+
+    atomic_fetch_add_explicit(&u->refs, 1, memory_order_relaxed);
+    in_use = atomic_fetch_add_explicit(&u->in_use, 1, memory_order_relaxed) + 1;
+    peak   = atomic_load_explicit(&u->peak, memory_order_relaxed);
+    while (in_use > peak &&
+           !atomic_compare_exchange_weak_explicit(&u->peak, &peak, in_use,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+void ff_ni_pool_usage_release(NIPoolUsage *u)
+{
+    if (!u)
+        return;
+
+    atomic_fetch_sub_explicit(&u->in_use, 1, memory_order_relaxed);
+    ff_ni_pool_usage_unref(&u);
+}
+
+void ff_ni_pool_usage_report(NIPoolUsage *u, void *log_ctx)
+{
+    int peak;
+
+    if (!u)
+        return;
+
+    peak = atomic_load_explicit(&u->peak, memory_order_relaxed);
+    av_log(log_ctx, AV_LOG_VERBOSE, "frame pool: %d frames planned, %d in use at most%s\n",
+           u->size, peak, peak >= u->size ? " (exhausted, try raising extra_hw_frames)" : "");
+}
+
+void ff_ni_pool_usage_unref(NIPoolUsage **pu)
+{
+    NIPoolUsage *u = *pu;
+
+    *pu = NULL;
+    if (u && atomic_fetch_sub_explicit(&u->refs, 1, memory_order_acq_rel) == 1)
+        av_free(u);
+}
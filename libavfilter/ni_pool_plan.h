@@ -0,0 +1,80 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_NI_POOL_PLAN_H
+#define AVFILTER_NI_POOL_PLAN_H
+
+#include <stdatomic.h>
+
+#include "avfilter.h"
+
+/* largest pool the planner asks for, device memory is scarce */
+#define NI_POOL_PLAN_MAX_SIZE 16
+
+/**
+ * Number of frames the consumers downstream of ctx can hold at once.
+ *
+ * Hardware frames are only ever forwarded as they are by the filters
+ * keeping the format of their input (split, null, fifo, setpts, ...); the
+ * walk follows those, adding one frame per extra branch, and stops at the
+ * filters making new frames (the NI filters, hwdownload, the sinks), which
+ * hold one frame, two when they synchronize several inputs, or the number
+ * of inferences they keep in flight.
+ */
+int ff_ni_pool_plan_demand(AVFilterContext *ctx);
+
+/**
+ * Size the output frame pool of ctx for the graph it is in: one frame
+ * being written, the downstream demand and the extra_hw_frames of ctx,
+ * which covers the consumers outside the graph (encoder lookahead).
+ * The plan is logged.
+ *
+ * Only the frames held in lavfi are counted, not those still in flight on
+ * the device (scaler and encoder pipelining, P2P transfers), so min_size,
+ * the fixed size the filter used before, stays the floor: the plan only
+ * grows pools.
+ *
+ * @return the pool size, between min_size and NI_POOL_PLAN_MAX_SIZE
+ */
+int ff_ni_pool_plan(AVFilterContext *ctx, int min_size);
+
+/**
+ * Usage of a frame pool. It is refcounted by the filter and by each of the
+ * frames from the pool, as they may outlive the filter.
+ */
+typedef struct NIPoolUsage {
+    atomic_int refs;
+    atomic_int in_use;
+    atomic_int peak;
+    int size;
+} NIPoolUsage;
+
+NIPoolUsage *ff_ni_pool_usage_alloc(int size);
+
+/** Account a frame taken from the pool, u may be NULL. */
+void ff_ni_pool_usage_acquire(NIPoolUsage *u);
+
+/** Account a frame given back to the pool, from its buffer free callback. */
+void ff_ni_pool_usage_release(NIPoolUsage *u);
+
+/** Log the planned size and the peak usage at verbose level. */
+void ff_ni_pool_usage_report(NIPoolUsage *u, void *log_ctx);
+
+void ff_ni_pool_usage_unref(NIPoolUsage **u);
+
+#endif /* AVFILTER_NI_POOL_PLAN_H */
@@ -0,0 +1,148 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+#include "ni_scale_cache.h"
+
+typedef struct NIScaleEntry {
+    void *owner;                ///< NULL if the entry is free
+    NIScaleKey key;
+    uint64_t seq;               ///< order of the puts
+    AVBufferRef *src;
+    AVFrame *out;
+} NIScaleEntry;
+
+struct NIScaleCache {
+    NIScaleEntry entries[NI_SCALE_CACHE_SIZE];
+    uint64_t next_seq;
+};
+
+static int same_key(const NIScaleKey *a, const NIScaleKey *b)
+{
+    return a->device == b->device && a->session_id == b->session_id &&
+           a->frame_idx == b->frame_idx && a->node == b->node &&
+           a->w == b->w && a->h == b->h &&
+           a->format == b->format && a->params == b->params;
+}
+
+static int same_session(const NIScaleKey *a, const NIScaleKey *b)
+{
+    return a->device == b->device && a->session_id == b->session_id;
+}
+
+static int same_surface(const NIScaleKey *a, const NIScaleKey *b)
+{
+    return same_session(a, b) &&
+           a->frame_idx == b->frame_idx && a->node == b->node;
+}
+
+static void drop(NIScaleEntry *e)
+{
+    av_buffer_unref(&e->src);
+    av_frame_free(&e->out);
+    e->owner = NULL;
+}
+
+static void cache_free(void *opaque, uint8_t *data)
+{
+    NIScaleCache *c = (NIScaleCache *)data;
+
+    for (int i = 0; i < NI_SCALE_CACHE_SIZE; i++)
+        if (c->entries[i].owner)
+            drop(&c->entries[i]);
+    av_free(c);
+}
+
+AVBufferRef *ff_ni_scale_cache_alloc(void)
+{
+    NIScaleCache *c = av_mallocz(sizeof(*c));
+    AVBufferRef *buf;
+
+    if (!c)
+        return NULL;
+    buf = av_buffer_create((uint8_t *)c, sizeof(*c), cache_free, NULL, 0);
+    if (!buf)
+        av_free(c);
+    return buf;
+}
+
+int ff_ni_scale_cache_get(NIScaleCache *c, const NIScaleKey *key, AVFrame *dst)
+{
+    for (int i = 0; i < NI_SCALE_CACHE_SIZE; i++) {
+        NIScaleEntry *e = &c->entries[i];
+
+        if (e->owner && same_key(&e->key, key)) {
+            int ret = av_frame_ref(dst, e->out);
+            return ret < 0 ? ret : 1;
+        }
+    }
+    return 0;
+}
+
+int ff_ni_scale_cache_put(NIScaleCache *c, void *owner, const NIScaleKey *key,
+                          AVBufferRef *src, const AVFrame *out)
+{
+    NIScaleEntry *slot = NULL;
+
+    for (int i = 0; i < NI_SCALE_CACHE_SIZE; i++) {
+        NIScaleEntry *e = &c->entries[i];
+
+        if (!e->owner)
+            continue;
+        if (same_key(&e->key, key))
+            return 0;           // another scaler got there first
+
+        // put before this one, so an older picture of the session
+        if (same_session(&e->key, key) && !same_surface(&e->key, key))
+            drop(e);
+    }
+
+    for (int i = 0; i < NI_SCALE_CACHE_SIZE; i++) {
+        NIScaleEntry *e = &c->entries[i];
+
+        if (!e->owner) {
+            slot = e;
+            break;
+        }
+        if (!slot || e->seq < slot->seq)
+            slot = e;
+    }
+    if (slot->owner)
+        drop(slot);
+
+    slot->src = av_buffer_ref(src);
+    slot->out = av_frame_clone(out);
+    if (!slot->src || !slot->out) {
+        drop(slot);
+        return AVERROR(ENOMEM);
+    }
+    slot->owner = owner;
+    slot->key   = *key;
+    slot->seq   = c->next_seq++;
+
+    return 0;
+}
+
+void ff_ni_scale_cache_purge(NIScaleCache *c, void *owner)
+{
+    for (int i = 0; i < NI_SCALE_CACHE_SIZE; i++)
+        if (c->entries[i].owner == owner)
+            drop(&c->entries[i]);
+}
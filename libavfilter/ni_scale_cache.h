@@ -0,0 +1,91 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Scaled surfaces shared between scaler instances. The branches of an ABR
+ * ladder often scale the same decoded surface to the same size; the first
+ * one to do it leaves a reference to its output here and the others take
+ * it instead of running the scaler again.
+ *
+ * A cache is shared by the scalers of one filter graph and only used from
+ * the thread running that graph.
+ */
+
+#ifndef AVFILTER_NI_SCALE_CACHE_H
+#define AVFILTER_NI_SCALE_CACHE_H
+
+#include <stdint.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/frame.h"
+
+/* entries kept at most in one cache */
+#define NI_SCALE_CACHE_SIZE 16
+
+typedef struct NIScaleCache NIScaleCache;
+
+typedef struct NIScaleKey {
+    /* input surface */
+    int64_t  device;
+    uint16_t session_id;
+    uint16_t frame_idx;
+    uint32_t node;              ///< offset of the picture in the surface
+
+    /* output geometry and format */
+    int w, h;
+    int format;
+
+    /* checksum of the scaler settings changing the picture */
+    uint32_t params;
+} NIScaleKey;
+
+/**
+ * Allocate an empty cache. The data of the returned buffer is the
+ * NIScaleCache, each scaler sharing it holds a reference.
+ *
+ * @return the cache or NULL on failure
+ */
+AVBufferRef *ff_ni_scale_cache_alloc(void);
+
+/**
+ * Look up the output made for key.
+ *
+ * @param dst  on a hit, references the cached output
+ * @return 1 on a hit, 0 on a miss, a negative error code on failure
+ */
+int ff_ni_scale_cache_get(NIScaleCache *c, const NIScaleKey *key, AVFrame *dst);
+
+/**
+ * Share the output made for key.
+ *
+ * The entry holds a reference to src, the input surface, so its id is not
+ * given to another picture while the entry lives. The entries put earlier
+ * for another surface of the same decoder session are dropped: the sharing
+ * only happens within one frame interval, and the order of the puts, not
+ * the timestamps of the scalers, tells which picture is older.
+ *
+ * @param owner  the scaler making out, see ff_ni_scale_cache_purge()
+ */
+int ff_ni_scale_cache_put(NIScaleCache *c, void *owner, const NIScaleKey *key,
+                          AVBufferRef *src, const AVFrame *out);
+
+/** Drop the entries put by owner, before its scaler session is closed. */
+void ff_ni_scale_cache_purge(NIScaleCache *c, void *owner);
+
+#endif /* AVFILTER_NI_SCALE_CACHE_H */
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2022 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+#include "ni_yolo.h"
+
+/* cells tested at once by the objectness scan */
+#define CULL_BLOCK 32
+
+/* below this many detections of a class the pairwise NMS is cheaper */
+#define NMS_GRID_MIN_DETS 16
+#define NMS_GRID_MAX_SIZE 16
+
+static inline float sigmoid(float x)
+{
+    return (float)(1.0 / (1.0 + (float)exp((double)(-x))));
+}
+
+/*
+ * The class probability is below 1, so a cell can only pass the threshold
+ * if sigmoid(objectness) does. Compare the raw logits against the inverse
+ * sigmoid of the threshold instead, with some slack for rounding: the
+ * cells that pass are tested exactly afterwards.
+ */
+static float objectness_cutoff(float thresh)
+{
+    double t;
+
+    if (!(thresh > 0))
+        return -INFINITY;
+
+    t = FFMIN(thresh, 1.0 - 1e-6);
+    return (float)(log(t / (1.0 - t)) - 0.01);
+}
+
+static int add_detection(NIYoloContext *yc, NIYoloDetection **det)
+{
+    NIYoloDetection *dets = av_fast_realloc(yc->dets, &yc->dets_size,
+                                            (yc->nb_dets + 1) * sizeof(*dets));
+    if (!dets)
+        return AVERROR(ENOMEM);
+
+    yc->dets = dets;
+    *det = &dets[yc->nb_dets++];
+    return 0;
+}
+
+static int decode_layer(NIYoloContext *yc, const NIYoloLayer *l,
+                        int netw, int neth, float thresh, int index_base)
+{
+    const int plane   = l->width * l->height;
+    const int entries = 4 + 1 + l->classes;
+    const float cut   = objectness_cutoff(thresh);
+    int n, b, i, k, ret;
+
+    for (n = 0; n < l->component; n++) {
+        const float *x   = l->output + n * plane * entries;
+        const float *obj = x + 4 * plane;
+        const float bw   = l->biases[2 * l->mask[n]];
+        const float bh   = l->biases[2 * l->mask[n] + 1];
+
+        for (b = 0; b < plane; b += CULL_BLOCK) {
+            const int end = FFMIN(b + CULL_BLOCK, plane);
+            int hit = 0;
+
+            /* no early exit so that the compiler can vectorize the scan */
+            for (i = b; i < end; i++)
+                hit |= obj[i] >= cut;
+            if (!hit)
+                continue;
+
+            for (i = b; i < end; i++) {
+                NIYoloDetection *det;
+                float objectness, max_prob = thresh;
+                int prob_class = -1;
+                int row, col;
+
+                if (!(obj[i] >= cut))
+                    continue;
+
+                objectness = sigmoid(obj[i]);
+                for (k = 0; k < l->classes; k++) {
+                    float prob = objectness * sigmoid(x[(5 + k) * plane + i]);
+                    if (prob >= max_prob) {
+                        prob_class = k;
+                        max_prob   = prob;
+                    }
+                }
+                if (prob_class < 0)
+                    continue;
+
+                if ((ret = add_detection(yc, &det)) < 0)
+                    return ret;
+
+                row = i / l->width;
+                col = i % l->width;
+
+                det->x = (float)((float)col + sigmoid(x[i])) / (float)l->width;
+                det->y = (float)((float)row + sigmoid(x[plane + i])) / (float)l->height;
+                det->w = (float)exp((double)x[2 * plane + i]) * bw / (float)netw;
+                det->h = (float)exp((double)x[3 * plane + i]) * bh / (float)neth;
+                det->x -= det->w / 2;
+                det->y -= det->h / 2;
+
+                det->objectness = objectness;
+                det->prob       = max_prob;
+                det->cls        = prob_class;
+                det->anchor     = n;
+                /* the order the per cell decoding used to produce */
+                det->index      = index_base + i * l->component + n;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int detection_cmp(const void *pa, const void *pb)
+{
+    const NIYoloDetection *a = pa, *b = pb;
+
+    if (a->cls != b->cls)
+        return FFDIFFSIGN(a->cls, b->cls);
+    if (a->prob != b->prob)
+        return a->prob < b->prob ? 1 : -1;
+    return FFDIFFSIGN(a->index, b->index);
+}
+
+/*
+ * IoU as the detections were always compared: x/y are taken as the box
+ * center here even though they hold the top left corner.
+ */
+static float overlap(float x1, float w1, float x2, float w2)
+{
+    float l1    = x1 - w1 / 2;
+    float l2    = x2 - w2 / 2;
+    float left  = l1 > l2 ? l1 : l2;
+    float r1    = x1 + w1 / 2;
+    float r2    = x2 + w2 / 2;
+    float right = r1 < r2 ? r1 : r2;
+    return right - left;
+}
+
+static float box_iou(const NIYoloDetection *a, const NIYoloDetection *b)
+{
+    float w = overlap(a->x, a->w, b->x, b->w);
+    float h = overlap(a->y, a->h, b->y, b->h);
+    float i, u;
+
+    if (w < 0 || h < 0)
+        return 0;
+
+    i = w * h;
+    u = a->w * a->h + b->w * b->h - i;
+    if (i == 0 || u == 0)
+        return 0;
+
+    return i / u;
+}
+
+static void nms_pairwise(NIYoloDetection *dets, int nb, float nms_thresh)
+{
+    int i, j;
+
+    for (i = 0; i < nb - 1; i++) {
+        if (dets[i].prob == 0)
+            continue;
+        for (j = i + 1; j < nb; j++) {
+            if (dets[j].prob == 0)
+                continue;
+            if (box_iou(&dets[i], &dets[j]) > nms_thresh)
+                dets[j].prob = 0;
+        }
+    }
+}
+
+typedef struct GridRange {
+    int x0, x1, y0, y1;
+} GridRange;
+
+static void grid_range(const NIYoloDetection *d, float minx, float miny,
+                       float sx, float sy, int g, GridRange *r)
+{
+    r->x0 = av_clip((int)((d->x - d->w / 2 - minx) * sx), 0, g - 1);
+    r->x1 = av_clip((int)((d->x + d->w / 2 - minx) * sx), 0, g - 1);
+    r->y0 = av_clip((int)((d->y - d->h / 2 - miny) * sy), 0, g - 1);
+    r->y1 = av_clip((int)((d->y + d->h / 2 - miny) * sy), 0, g - 1);
+}
+
+/*
+ * Same result as nms_pairwise() for a non-negative threshold: a suppression
+ * needs a positive intersection, so only detections sharing a grid cell
+ * have to be compared.
+ */
+static int nms_grid(NIYoloContext *yc, NIYoloDetection *dets, int nb,
+                    float nms_thresh)
+{
+    float minx = INFINITY, maxx = -INFINITY, miny = INFINITY, maxy = -INFINITY;
+    float sx, sy;
+    int g, cells, i, j, cx, cy, c;
+    GridRange r;
+
+    for (i = 0; i < nb; i++) {
+        minx = FFMIN(minx, dets[i].x - dets[i].w / 2);
+        maxx = FFMAX(maxx, dets[i].x + dets[i].w / 2);
+        miny = FFMIN(miny, dets[i].y - dets[i].h / 2);
+        maxy = FFMAX(maxy, dets[i].y + dets[i].h / 2);
+    }
+    /* NaN or infinite boxes can not be bucketed */
+    if (!isfinite(minx) || !isfinite(maxx) || !isfinite(miny) || !isfinite(maxy) ||
+        !isfinite(maxx - minx) || !isfinite(maxy - miny)) {
+        nms_pairwise(dets, nb, nms_thresh);
+        return 0;
+    }
+
+    g     = av_clip((int)sqrt(nb / 2), 1, NMS_GRID_MAX_SIZE);
+    cells = g * g;
+    sx    = maxx > minx ? g / (maxx - minx) : 0;
+    sy    = maxy > miny ? g / (maxy - miny) : 0;
+
+    av_fast_malloc(&yc->cell_start, &yc->cell_start_size,
+                   (cells + 1) * sizeof(*yc->cell_start));
+    if (!yc->cell_start)
+        return AVERROR(ENOMEM);
+    memset(yc->cell_start, 0, (cells + 1) * sizeof(*yc->cell_start));
+
+    /* count the detections of every cell, then turn counts into offsets */
+    for (i = 0; i < nb; i++) {
+        grid_range(&dets[i], minx, miny, sx, sy, g, &r);
+        for (cy = r.y0; cy <= r.y1; cy++)
+            for (cx = r.x0; cx <= r.x1; cx++)
+                yc->cell_start[cy * g + cx + 1]++;
+    }
+    for (c = 0; c < cells; c++)
+        yc->cell_start[c + 1] += yc->cell_start[c];
+
+    av_fast_malloc(&yc->cell_dets, &yc->cell_dets_size,
+                   FFMAX(yc->cell_start[cells], 1) * sizeof(*yc->cell_dets));
+    av_fast_malloc(&yc->visited, &yc->visited_size, nb * sizeof(*yc->visited));
+    if (!yc->cell_dets || !yc->visited)
+        return AVERROR(ENOMEM);
+
+    /* fill in increasing order, so that every cell list is sorted; the
+     * start offsets are shifted by one cell while filling and restored */
+    for (i = 0; i < nb; i++) {
+        grid_range(&dets[i], minx, miny, sx, sy, g, &r);
+        for (cy = r.y0; cy <= r.y1; cy++)
+            for (cx = r.x0; cx <= r.x1; cx++)
+                yc->cell_dets[yc->cell_start[cy * g + cx]++] = i;
+    }
+    for (c = cells; c > 0; c--)
+        yc->cell_start[c] = yc->cell_start[c - 1];
+    yc->cell_start[0] = 0;
+
+    memset(yc->visited, 0, nb * sizeof(*yc->visited));
+    yc->stamp = 0;
+
+    for (i = 0; i < nb - 1; i++) {
+        if (dets[i].prob == 0)
+            continue;
+
+        yc->stamp++;
+        grid_range(&dets[i], minx, miny, sx, sy, g, &r);
+        for (cy = r.y0; cy <= r.y1; cy++) {
+            for (cx = r.x0; cx <= r.x1; cx++) {
+                const int *list = yc->cell_dets + yc->cell_start[cy * g + cx];
+                const int *end  = yc->cell_dets + yc->cell_start[cy * g + cx + 1];
+
+                for (; list < end; list++) {
+                    j = *list;
+                    if (j <= i || yc->visited[j] == yc->stamp)
+                        continue;
+                    yc->visited[j] = yc->stamp;
+                    if (dets[j].prob == 0)
+                        continue;
+                    if (box_iou(&dets[i], &dets[j]) > nms_thresh)
+                        dets[j].prob = 0;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+int ff_ni_yolo_detect(NIYoloContext *yc, const NIYoloLayer *layers,
+                      int nb_layers, int netw, int neth,
+                      float obj_thresh, float nms_thresh)
+{
+    NIYoloDetection *dets;
+    int i, start, end, nb, ret;
+    int index_base = 0;
+
+    yc->nb_dets = 0;
+
+    for (i = 0; i < nb_layers; i++) {
+        ret = decode_layer(yc, &layers[i], netw, neth, obj_thresh, index_base);
+        if (ret < 0)
+            return ret;
+        index_base += layers[i].width * layers[i].height * layers[i].component;
+    }
+
+    if (!yc->nb_dets)
+        return 0;
+
+    dets = yc->dets;
+    qsort(dets, yc->nb_dets, sizeof(*dets), detection_cmp);
+
+    for (start = 0; start < yc->nb_dets; start = end) {
+        for (end = start + 1; end < yc->nb_dets && dets[end].cls == dets[start].cls; end++)
+            ;
+        if (end - start < NMS_GRID_MIN_DETS || nms_thresh < 0) {
+            nms_pairwise(dets + start, end - start, nms_thresh);
+        } else {
+            ret = nms_grid(yc, dets + start, end - start, nms_thresh);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    /* suppressed detections have their probability zeroed */
+    for (i = nb = 0; i < yc->nb_dets; i++)
+        if (dets[i].prob != 0)
+            dets[nb++] = dets[i];
+    yc->nb_dets = nb;
+
+    return nb;
+}
+
+void ff_ni_yolo_uninit(NIYoloContext *yc)
+{
+    av_freep(&yc->dets);
+    av_freep(&yc->cell_start);
+    av_freep(&yc->cell_dets);
+    av_freep(&yc->visited);
+    yc->dets_size = yc->cell_start_size = yc->cell_dets_size = 0;
+    yc->visited_size = 0;
+    yc->nb_dets = 0;
+}
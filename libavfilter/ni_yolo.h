@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2022 NetInt
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * YOLO output layer decoding and non-maximum suppression, shared by the
+ * NetInt AI filters. Does not depend on libxcoder so that it can be tested
+ * and benchmarked on recorded network output.
+ */
+
+#ifndef AVFILTER_NI_YOLO_H
+#define AVFILTER_NI_YOLO_H
+
+#include <stdint.h>
+
+typedef struct NIYoloLayer {
+    int width;
+    int height;
+    int classes;
+    int component;          ///< anchors per cell
+    int mask[3];            ///< anchor index of each component into biases
+    const float *biases;    ///< anchor width/height pairs in network pixels
+    /**
+     * Layer output, component blocks of (4 + 1 + classes) planes of
+     * width * height logits each: x, y, w, h, objectness, class scores.
+     */
+    const float *output;
+} NIYoloLayer;
+
+typedef struct NIYoloDetection {
+    float x, y, w, h;       ///< top left corner and size, relative to the network input
+    float objectness;
+    float prob;             ///< objectness * class probability of the best class
+    int cls;
+    int anchor;             ///< component of the layer the detection comes from
+    int index;              ///< decoding order, breaks ties when sorting
+} NIYoloDetection;
+
+typedef struct NIYoloContext {
+    NIYoloDetection *dets;
+    unsigned int dets_size;
+    int nb_dets;
+
+    /* non-maximum suppression scratch */
+    int *cell_start;
+    unsigned int cell_start_size;
+    int *cell_dets;
+    unsigned int cell_dets_size;
+    unsigned int *visited;
+    unsigned int visited_size;
+    unsigned int stamp;
+} NIYoloContext;
+
+/**
+ * Decode the detections of all layers, sort them by class and decreasing
+ * probability and remove the ones suppressed by a better detection of the
+ * same class.
+ *
+ * @param obj_thresh minimum objectness * class probability of a detection
+ * @param nms_thresh IoU above which the weaker of two detections is dropped
+ * @return number of detections left in yc->dets, or a negative AVERROR
+ */
+int ff_ni_yolo_detect(NIYoloContext *yc, const NIYoloLayer *layers,
+                      int nb_layers, int netw, int neth,
+                      float obj_thresh, float nms_thresh);
+
+void ff_ni_yolo_uninit(NIYoloContext *yc);
+
+#endif /* AVFILTER_NI_YOLO_H */
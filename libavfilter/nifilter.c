@@ -38,12 +38,14 @@
 #endif
 #include "video.h"
 #include "libavutil/eval.h"
+#include "libavutil/hwcontext_ni_quad_internal.h"
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/libm.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
+#include "libavutil/planecopy.h"
 #include "libavutil/time.h"
 
 #if HAVE_SYS_RESOURCE_H
@@ -164,88 +166,283 @@ int ff_ni_ffmpeg_to_libxcoder_pix_fmt(enum AVPixelFormat pix_fmt)
     return -1;
 }
 
-int ff_ni_copy_device_to_host_frame(AVFrame *dst, const ni_frame_t *src, int pix_fmt)
+#ifndef NI_MEM_PAGE_ALIGNMENT
+#define NI_MEM_PAGE_ALIGNMENT 0x1000
+#endif
+
+int ff_ni_get_device_layout(NIDeviceLayout *layout, enum AVPixelFormat pix_fmt,
+                            int width, int height, int nb_planes)
 {
-  switch (pix_fmt)
-  {
-    /* packed */
-    case GC620_RGBA8888:
-    case GC620_BGRA8888:
-    case GC620_ABGR8888:
-    case GC620_ARGB8888:
-    case GC620_RGB565:
-    case GC620_BGR565:
-    case GC620_B5G5R5X1:
-    case GC620_YUYV:
-      memcpy(dst->data[0],src->p_data[0],src->data_len[0]);
-      break;
-
-    /* semi-planar */
-    case GC620_NV12:
-    case GC620_NV21:
-    case GC620_P010_MSB:
-    case GC620_NV16:
-      memcpy(dst->data[0], src->p_data[0], src->data_len[0]);
-      memcpy(dst->data[1], src->p_data[1], src->data_len[1]);
-      break;
-
-    /* planar */
-    case GC620_I420:
-    case GC620_I010:
-      memcpy(dst->data[0], src->p_data[0], src->data_len[0]);
-      memcpy(dst->data[1], src->p_data[1], src->data_len[1]);
-      memcpy(dst->data[2], src->p_data[2], src->data_len[2]);
-      break;
-
-    default:
-      return -1;
-  }
+    const NIFrameLayout *fmt = avpriv_ni_frame_layout(pix_fmt);
+    size_t size = 0;
+    int i, h, max_planes;
+
+    if (!fmt || width <= 0 || height <= 0) {
+        return AVERROR(EINVAL);
+    }
+
+    max_planes = av_pix_fmt_count_planes(pix_fmt);
+    if (nb_planes <= 0 || nb_planes > max_planes) {
+        nb_planes = max_planes;
+    }
+
+    memset(layout, 0, sizeof(*layout));
+    layout->pix_fmt   = pix_fmt;
+    layout->width     = width;
+    layout->height    = height;
+    layout->nb_planes = nb_planes;
+
+    for (i = 0; i < nb_planes; i++) {
+        const NIPlaneLayout *p = &fmt->plane[i];
 
-  return 0;
+        /* 4:2:0 planes are padded to an even height, chroma included, as
+         * the hwcontext upload does */
+        h = p->log2_h ? FFALIGN(height, 2) >> p->log2_h : height;
+        if (fmt->vpad) {
+            h = FFALIGN(h, 2);
+        }
+
+        layout->linesize[i]     = FFALIGN(width * p->num / p->den, p->align);
+        layout->plane_height[i] = h;
+        layout->offset[i]       = size;
+        size += (size_t)layout->linesize[i] * layout->plane_height[i];
+    }
+    layout->size = size;
+
+    return 0;
 }
 
-int ff_ni_copy_host_to_device_frame(ni_frame_t *dst, const AVFrame *src, int pix_fmt)
+/* Largest pixel step of the components stored in a plane, e.g. a UV pair
+ * for NV12 chroma or a Y0UY1V group for YUYV */
+static int ni_plane_sample_size(const AVPixFmtDescriptor *desc, int plane)
 {
-  switch (pix_fmt)
-  {
-    /* packed */
-    case GC620_RGBA8888:
-    case GC620_BGRA8888:
-    case GC620_ABGR8888:
-    case GC620_ARGB8888:
-    case GC620_RGB565:
-    case GC620_BGR565:
-    case GC620_B5G5R5X1:
-    case GC620_YUYV:
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      dst->pixel_format = pix_fmt;
-      break;
-
-    /* planar */
-    case GC620_I420:
-    case GC620_I010:
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      memcpy(dst->p_data[1], src->data[1], dst->data_len[1]);
-      memcpy(dst->p_data[2], src->data[2], dst->data_len[2]);
-      dst->pixel_format = pix_fmt;
-      break;
-
-    /* semi-planar */
-    case GC620_NV12:
-    case GC620_NV21:
-    case GC620_P010_MSB:
-    case GC620_NV16:
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      memcpy(dst->p_data[0], src->data[0], dst->data_len[0]);
-      dst->pixel_format = pix_fmt;
-      break;
-
-    default:
-      dst->pixel_format = -1;
-      return -1;
-  }
+    int i, step = 1;
+
+    for (i = 0; i < desc->nb_components; i++) {
+        if (desc->comp[i].plane == plane) {
+            step = FFMAX(step, desc->comp[i].step);
+        }
+    }
+
+    return step;
+}
+
+static int ni_plane_height(const AVPixFmtDescriptor *desc, int plane, int height)
+{
+    return (plane == 1 || plane == 2) ?
+           AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+}
+
+void ff_ni_copy_plane(uint8_t *dst, ptrdiff_t dst_linesize,
+                      const uint8_t *src, ptrdiff_t src_linesize,
+                      ptrdiff_t bytewidth, int height)
+{
+    PlaneCopyDesc plane = {
+        .dst          = dst,
+        .dst_linesize = dst_linesize,
+        .src          = src,
+        .src_linesize = src_linesize,
+        .bytewidth    = bytewidth,
+        .height       = height,
+    };
+
+    avpriv_plane_copy(NULL, &plane, 1);
+}
+
+int ff_ni_copy_host_to_device_frame(uint8_t *dst, size_t dst_size,
+                                    const NIDeviceLayout *layout,
+                                    const AVFrame *src)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(layout->pix_fmt);
+    PlaneCopyDesc planes[4];
+    int i, x, y, bytewidth, height, sample;
+    uint8_t *line;
+
+    if (src->format != layout->pix_fmt ||
+        src->width > layout->width || src->height > layout->height) {
+        av_log(NULL, AV_LOG_ERROR, "%s: %s %dx%d frame does not fit the "
+               "%s %dx%d device layout\n", __func__,
+               av_get_pix_fmt_name(src->format), src->width, src->height,
+               av_get_pix_fmt_name(layout->pix_fmt), layout->width,
+               layout->height);
+        return AVERROR(EINVAL);
+    }
+    if (dst_size < layout->size) {
+        av_log(NULL, AV_LOG_ERROR, "%s: device buffer size %zu < %zu, please "
+               "check the frame and the module resolution\n", __func__,
+               dst_size, layout->size);
+        return AVERROR(EINVAL);
+    }
+
+    for (i = 0; i < layout->nb_planes; i++) {
+        bytewidth = av_image_get_linesize(src->format, src->width, i);
+        height    = ni_plane_height(desc, i, src->height);
+
+        planes[i].dst          = dst + layout->offset[i];
+        planes[i].dst_linesize = layout->linesize[i];
+        planes[i].src          = src->data[i];
+        planes[i].src_linesize = src->linesize[i];
+        planes[i].bytewidth    = FFMIN(bytewidth, layout->linesize[i]);
+        planes[i].height       = FFMIN(height, layout->plane_height[i]);
+    }
+
+    avpriv_plane_copy(NULL, planes, layout->nb_planes);
+
+    for (i = 0; i < layout->nb_planes; i++) {
+        bytewidth = planes[i].bytewidth;
+        sample    = ni_plane_sample_size(desc, i);
+        line      = planes[i].dst;
+
+        /* Extend the width by cloning the last sample of each line */
+        if (bytewidth >= sample && bytewidth < layout->linesize[i]) {
+            for (y = 0; y < planes[i].height; y++) {
+                if (sample == 1) {
+                    memset(line + bytewidth, line[bytewidth - 1],
+                           layout->linesize[i] - bytewidth);
+                } else {
+                    for (x = bytewidth; x < layout->linesize[i]; x += sample) {
+                        memcpy(line + x, line + bytewidth - sample,
+                               FFMIN(sample, layout->linesize[i] - x));
+                    }
+                }
+                line += layout->linesize[i];
+            }
+        } else {
+            line += (ptrdiff_t)planes[i].height * layout->linesize[i];
+        }
+
+        /* Extend the height by cloning the last line */
+        for (y = planes[i].height; y < layout->plane_height[i]; y++) {
+            memcpy(line, line - layout->linesize[i], layout->linesize[i]);
+            line += layout->linesize[i];
+        }
+    }
 
-  return 0;
+    return 0;
+}
+
+int ff_ni_copy_device_to_host_frame(AVFrame *dst, const uint8_t *src,
+                                    size_t src_size,
+                                    const NIDeviceLayout *layout)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(layout->pix_fmt);
+    PlaneCopyDesc planes[4];
+    size_t needed = 0;
+    int i, bytewidth, height;
+
+    if (dst->format != layout->pix_fmt) {
+        av_log(NULL, AV_LOG_ERROR, "%s: frame format %s does not match the "
+               "device layout %s\n", __func__, av_get_pix_fmt_name(dst->format),
+               av_get_pix_fmt_name(layout->pix_fmt));
+        return AVERROR(EINVAL);
+    }
+
+    /* Crop the device planes to the frame dimensions */
+    for (i = 0; i < layout->nb_planes; i++) {
+        bytewidth = av_image_get_linesize(dst->format, dst->width, i);
+        height    = ni_plane_height(desc, i, dst->height);
+
+        planes[i].dst          = dst->data[i];
+        planes[i].dst_linesize = dst->linesize[i];
+        planes[i].src          = src + layout->offset[i];
+        planes[i].src_linesize = layout->linesize[i];
+        planes[i].bytewidth    = FFMIN(bytewidth, layout->linesize[i]);
+        planes[i].height       = FFMIN(height, layout->plane_height[i]);
+
+        if (planes[i].height > 0 && planes[i].bytewidth > 0) {
+            needed = FFMAX(needed, layout->offset[i] + planes[i].bytewidth +
+                           (size_t)(planes[i].height - 1) * layout->linesize[i]);
+        }
+    }
+
+    if (src_size < needed) {
+        av_log(NULL, AV_LOG_ERROR, "%s: device data size %zu < %zu, please "
+               "check the frame and the module resolution\n", __func__,
+               src_size, needed);
+        return AVERROR(EINVAL);
+    }
+
+    avpriv_plane_copy(NULL, planes, layout->nb_planes);
+
+    return 0;
+}
+
+int ff_ni_frame_matches_device_layout(const AVFrame *frame,
+                                      const NIDeviceLayout *layout)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(layout->pix_fmt);
+    const AVBufferRef *buf = frame->buf[0];
+    int i;
+
+    if (frame->format != layout->pix_fmt ||
+        frame->width != layout->width ||
+        frame->height != layout->plane_height[0]) {
+        return 0;
+    }
+
+    /* the device reads the buffer directly, it must be page aligned */
+    if (!buf || ((uintptr_t)frame->data[0] & (NI_MEM_PAGE_ALIGNMENT - 1))) {
+        return 0;
+    }
+
+    /* Nothing is written into a lent buffer, so it must not need the edge
+     * padding of the copy path: every plane fills its stride and height. */
+    for (i = 0; i < layout->nb_planes; i++) {
+        if (frame->linesize[i] != layout->linesize[i] ||
+            av_image_get_linesize(frame->format, frame->width, i) != layout->linesize[i] ||
+            ni_plane_height(desc, i, frame->height) != layout->plane_height[i] ||
+            frame->data[i] != frame->data[0] + layout->offset[i]) {
+            return 0;
+        }
+    }
+
+    return frame->data[0] >= buf->data &&
+           layout->size <= buf->size - (size_t)(frame->data[0] - buf->data);
+}
+
+int ff_ni_map_host_frame(ni_frame_t *dst, NIHostFrameMap *map,
+                         const AVFrame *src, const NIDeviceLayout *layout)
+{
+    int i;
+
+    memset(map, 0, sizeof(*map));
+
+    if (!ff_ni_frame_matches_device_layout(src, layout)) {
+        return ff_ni_copy_host_to_device_frame(dst->p_buffer, dst->buffer_size,
+                                               layout, src);
+    }
+
+    map->p_buffer    = dst->p_buffer;
+    map->buffer_size = dst->buffer_size;
+    for (i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        map->p_data[i] = dst->p_data[i];
+    }
+    map->mapped = 1;
+
+    /* the device only reads from the frame, so lending the buffer is safe */
+    dst->p_buffer    = src->data[0];
+    dst->buffer_size = layout->size;
+    for (i = 0; i < layout->nb_planes; i++) {
+        dst->p_data[i] = src->data[i];
+    }
+
+    return 1;
+}
+
+void ff_ni_unmap_host_frame(ni_frame_t *dst, NIHostFrameMap *map)
+{
+    int i;
+
+    if (!map->mapped) {
+        return;
+    }
+
+    dst->p_buffer    = map->p_buffer;
+    dst->buffer_size = map->buffer_size;
+    for (i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++) {
+        dst->p_data[i] = map->p_data[i];
+    }
+    map->mapped = 0;
 }
 
 void ff_ni_frame_free(void *opaque, uint8_t *data)
@@ -267,6 +464,7 @@ void ff_ni_frame_free(void *opaque, uint8_t *data)
     // buffer is created by av_malloc, so use av_free to release.
     av_free(data);
   }
+  ff_ni_pool_usage_release(opaque);
 };
 
 int ff_ni_build_frame_pool(ni_session_context_t *ctx,
@@ -33,6 +33,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/hwcontext_ni_quad.h"
+#include "ni_pool_plan.h"
 
 #include <ni_device_api.h>
 
@@ -72,6 +73,10 @@
     { "buffer_limit", "Limit output buffering", OFFSET(buffer_limit), AV_OPT_TYPE_BOOL, \
       {.i64 = 0}, 0, 1, FLAGS }
 
+#define NI_FILT_OPTION_AI_DEPTH                                                        \
+    { "depth", "number of inferences kept in flight", OFFSET(ai_depth), AV_OPT_TYPE_INT, \
+      {.i64 = 2}, 1, DEFAULT_NI_FILTER_POOL_SIZE - 1, FLAGS }
+
 #define NI_FILT_OPTION_IS_P2P                                                              \
     { "is_p2p", "enable p2p transfer", OFFSET(is_p2p), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, \
       FLAGS}
@@ -80,11 +85,79 @@
     { "auto_skip", "skip processing when output would be same as input", OFFSET(auto_skip), \
       AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS}
 
+/**
+ * Layout of a raw frame in a host buffer exchanged with the device: the
+ * planes are stored back to back, each padded to the device stride and,
+ * for 4:2:0 formats, to an even number of lines.
+ */
+typedef struct NIDeviceLayout {
+    enum AVPixelFormat pix_fmt;
+    int width, height;
+    int nb_planes;
+    int linesize[4];
+    int plane_height[4];
+    size_t offset[4];
+    size_t size;
+} NIDeviceLayout;
+
+/* Saved ni_frame_t buffer pointers while an AVFrame is lent to it */
+typedef struct NIHostFrameMap {
+    uint8_t *p_buffer;
+    uint32_t buffer_size;
+    uint8_t *p_data[NI_MAX_NUM_DATA_POINTERS];
+    int mapped;
+} NIHostFrameMap;
+
 void ff_ni_update_benchmark(const char *fmt, ...);
 int ff_ni_ffmpeg_to_gc620_pix_fmt(enum AVPixelFormat pix_fmt);
 int ff_ni_ffmpeg_to_libxcoder_pix_fmt(enum AVPixelFormat pix_fmt);
-int ff_ni_copy_device_to_host_frame(AVFrame *dst, const ni_frame_t *src, int pix_fmt);
-int ff_ni_copy_host_to_device_frame(ni_frame_t *dst, const AVFrame *src, int pix_fmt);
+
+/**
+ * Fill in the device layout of a width x height frame.
+ *
+ * @param nb_planes number of planes to lay out, 0 for all of them
+ * @return 0 on success, AVERROR(EINVAL) for unsupported formats
+ */
+int ff_ni_get_device_layout(NIDeviceLayout *layout, enum AVPixelFormat pix_fmt,
+                            int width, int height, int nb_planes);
+
+/**
+ * Copy src into a device layout buffer, replicating the right and bottom
+ * edges into the padding. src may be smaller than the layout.
+ */
+int ff_ni_copy_host_to_device_frame(uint8_t *dst, size_t dst_size,
+                                    const NIDeviceLayout *layout,
+                                    const AVFrame *src);
+
+/**
+ * Copy a device layout buffer into dst, cropping it to the frame size.
+ */
+int ff_ni_copy_device_to_host_frame(AVFrame *dst, const uint8_t *src,
+                                    size_t src_size,
+                                    const NIDeviceLayout *layout);
+
+/**
+ * @return 1 if the frame buffer can be handed to the device as is: it has
+ *         the device layout and no plane needs edge padding
+ */
+int ff_ni_frame_matches_device_layout(const AVFrame *frame,
+                                      const NIDeviceLayout *layout);
+
+/**
+ * Point dst at the buffer of src when it already has the device layout,
+ * otherwise copy src into dst's own buffer. ff_ni_unmap_host_frame() must
+ * be called once the device has consumed dst, and before src is freed.
+ *
+ * @return 1 if src was mapped, 0 if it was copied, a negative AVERROR on failure
+ */
+int ff_ni_map_host_frame(ni_frame_t *dst, NIHostFrameMap *map,
+                         const AVFrame *src, const NIDeviceLayout *layout);
+void ff_ni_unmap_host_frame(ni_frame_t *dst, NIHostFrameMap *map);
+
+void ff_ni_copy_plane(uint8_t *dst, ptrdiff_t dst_linesize,
+                      const uint8_t *src, ptrdiff_t src_linesize,
+                      ptrdiff_t bytewidth, int height);
+
 int ff_ni_build_frame_pool(ni_session_context_t *ctx,int width,int height, enum AVPixelFormat out_format, int pool_size, int buffer_limit);
 void ff_ni_frame_free(void *opaque, uint8_t *data);
 void ff_ni_set_bit_depth_and_encoding_type(int8_t *p_bit_depth,
@@ -0,0 +1,93 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavfilter/ni_compose.c"
+
+static const struct {
+    const char *layout;
+    int nb_layers;
+    int w[3], h[3];
+} tests[] = {
+    { "0_0",                          1, { 128 },          { 64 } },
+    { "W-w-16_16|16_H-h-16",          2, { 200, 320 },     { 100, 181 } },
+    { "10_10|100_10|W/2_H/2",         3, { 64, 64, 64 },   { 64, 64, 64 } },
+    { "0_0|w/2_h/2",                  2, { 64, 64 },       { 64, 64 } },
+    { "0_0",                          2, { 64, 64 },       { 64, 64 } },
+    { "W-w+2_0",                      1, { 64 },           { 64 } },
+    { "-2_0",                         1, { 64 },           { 64 } },
+    { "0_foo",                        1, { 64 },           { 64 } },
+    { "00",                           1, { 64 },           { 64 } },
+};
+
+static void test_layout(void)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        NICompose c;
+        int ret = ff_ni_compose_layout(&c, tests[i].layout, tests[i].nb_layers,
+                                       1280, 720, tests[i].w, tests[i].h, NULL);
+
+        printf("%s:", tests[i].layout);
+        if (ret < 0) {
+            printf(" invalid\n");
+            continue;
+        }
+        for (int j = 0; j < c.nb_layers; j++)
+            printf(" %dx%d@%d,%d", c.layers[j].w, c.layers[j].h,
+                   c.layers[j].x, c.layers[j].y);
+        printf(", sheet %dx%d@%d,%d, overlap %d\n", c.sheet_w, c.sheet_h,
+               c.sheet_x, c.sheet_y, c.overlap);
+    }
+}
+
+/*
+ * Two layers over 10 frames: a static logo, and a clock updated every 4th
+ * frame; the sheet is rebuilt when either changes.
+ */
+static void test_cache(void)
+{
+    static const int w[2] = { 64, 64 }, h[2] = { 32, 32 };
+    NICompose c;
+
+    if (ff_ni_compose_layout(&c, "0_0|100_0", 2, 1280, 720, w, h, NULL) < 0)
+        return;
+
+    for (int n = 0; n < 10; n++) {
+        int changed = 0;
+
+        changed |= ff_ni_compose_update(&c, 0, 1, 7);
+        changed |= ff_ni_compose_update(&c, 1, 2, 100 + n / 4);
+        if (n == 6)
+            ff_ni_compose_invalidate(&c);
+        ff_ni_compose_count(&c, 1 + changed, changed);
+        printf("frame %d: %s\n", n, changed ? "build" : "cached");
+    }
+    printf("%"PRIu64" frames, %"PRIu64" jobs, %"PRIu64" sheets\n",
+           c.frames, c.jobs, c.sheet_builds);
+}
+
+int main(void)
+{
+    av_log_set_level(AV_LOG_QUIET);
+
+    test_layout();
+    test_cache();
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/crc.h"
+#include "libavutil/imgutils.h"
+#include "libavfilter/ni_pipeline.c"
+
+#define NB_FRAMES 24
+
+/* a device running every inference for a fixed time, in order */
+typedef struct FakeDevice {
+    int64_t ready[NB_FRAMES];
+    int head, tail;
+    int fail_submit, fail_collect;
+    int busy_polls;
+} FakeDevice;
+
+typedef struct FakeJob {
+    int64_t pts;
+    int64_t result;
+} FakeJob;
+
+static int fake_submit(void *opaque, void *job)
+{
+    FakeDevice *dev = opaque;
+    FakeJob *j = job;
+
+    if (j->pts == dev->fail_submit)
+        return AVERROR(EIO);
+    dev->ready[dev->tail++ % NB_FRAMES] = av_gettime_relative() + 2000;
+    return 0;
+}
+
+static int fake_collect(void *opaque, void *job)
+{
+    FakeDevice *dev = opaque;
+    FakeJob *j = job;
+
+    if (av_gettime_relative() < dev->ready[dev->head % NB_FRAMES]) {
+        dev->busy_polls++;
+        return 0;
+    }
+    dev->head++;
+    if (j->pts == dev->fail_collect)
+        return AVERROR(EIO);
+    j->result = j->pts * 2;
+    return 1;
+}
+
+static const NIPipelineOps fake_ops = {
+    .submit  = fake_submit,
+    .collect = fake_collect,
+};
+
+/* check and release a popped job, failed ones included */
+static int output(NIPipeline *p, int depth, AVFrame *frame, FakeJob *job,
+                  int ret, int64_t *next_pts)
+{
+    int err = 0;
+
+    if (!frame || !job || frame->pts != *next_pts) {
+        printf("frame %"PRId64" out of order\n", *next_pts);
+        err = 1;
+    } else if (ret < 0) {
+        printf("frame %"PRId64": error\n", frame->pts);
+        // the slot of the failed job is only free once released
+        if (ff_ni_pipeline_pending(p) + 1 >= depth && ff_ni_pipeline_next_job(p)) {
+            printf("frame %"PRId64": slot reused before release\n", frame->pts);
+            err = 1;
+        }
+    } else if (job->result != frame->pts * 2) {
+        printf("frame %"PRId64": wrong result\n", frame->pts);
+        err = 1;
+    }
+    if (ret)
+        ff_ni_pipeline_release(p);
+    (*next_pts)++;
+    av_frame_free(&frame);
+    return err;
+}
+
+static int run(int depth, int fail_submit, int fail_collect)
+{
+    FakeDevice dev = { .fail_submit = fail_submit, .fail_collect = fail_collect };
+    NIPipeline *p;
+    int64_t next_pts = 0;
+    int max_pending = 0;
+    int err = 0, ret;
+
+    ret = ff_ni_pipeline_alloc(&p, &fake_ops, &dev, NULL, depth,
+                               sizeof(FakeJob));
+    if (ret < 0)
+        return 1;
+
+    for (int i = 0; i < NB_FRAMES && !err; i++) {
+        AVFrame *frame;
+        FakeJob *job;
+
+        /* make room the way the filters do, by outputting the oldest */
+        while (!(job = ff_ni_pipeline_next_job(p)) && !err) {
+            ret = ff_ni_pipeline_pop(p, &frame, (void **)&job, 1);
+            err = output(p, depth, frame, job, ret, &next_pts);
+        }
+
+        frame = av_frame_alloc();
+        if (!frame)
+            return 1;
+        frame->pts = job->pts = i;
+        job->result = -1;
+        if (ff_ni_pipeline_push(p, frame) < 0)
+            return 1;
+        max_pending = FFMAX(max_pending, ff_ni_pipeline_pending(p));
+    }
+
+    while (!err && ff_ni_pipeline_pending(p)) {
+        AVFrame *frame;
+        FakeJob *job;
+
+        ret = ff_ni_pipeline_pop(p, &frame, (void **)&job, 1);
+        err = output(p, depth, frame, job, ret, &next_pts);
+    }
+
+    if (!err && next_pts != NB_FRAMES) {
+        printf("%"PRId64" frames out of %d\n", next_pts, NB_FRAMES);
+        err = 1;
+    }
+
+    printf("depth %d: %d frames, at most %d in flight%s\n", depth,
+           (int)next_pts, max_pending, err ? ", FAILED" : "");
+
+    ff_ni_pipeline_free(&p);
+    return err;
+}
+
+/*
+ * Uploads of a raw video file the way ni_quadra_hwupload queues them: the
+ * frames are read on the main thread while a device that takes 1 ms per
+ * write checksums what it receives on the worker.
+ */
+#define UP_W 64
+#define UP_H 36
+
+typedef struct UploadJob {
+    AVFrame *in;
+    uint32_t crc;
+} UploadJob;
+
+static int mock_upload(void *opaque, void *job)
+{
+    UploadJob *j = job;
+    uint8_t buf[UP_W * UP_H * 3 / 2];
+
+    av_image_copy_to_buffer(buf, sizeof(buf),
+                            (const uint8_t * const *)j->in->data,
+                            j->in->linesize, j->in->format, UP_W, UP_H, 1);
+    av_usleep(1000);
+    j->crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0, buf, sizeof(buf));
+    return 0;
+}
+
+static int mock_written(void *opaque, void *job)
+{
+    return 1;
+}
+
+static const NIPipelineOps upload_ops = {
+    .submit   = mock_upload,
+    .collect  = mock_written,
+    .job_name = "upload",
+};
+
+static int read_frame(FILE *f, AVFrame **pframe)
+{
+    uint8_t buf[UP_W * UP_H * 3 / 2];
+    uint8_t *src[4];
+    int src_linesize[4];
+    AVFrame *frame;
+
+    *pframe = NULL;
+    if (fread(buf, 1, sizeof(buf), f) != sizeof(buf))
+        return AVERROR_EOF;
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return AVERROR(ENOMEM);
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width  = UP_W;
+    frame->height = UP_H;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return AVERROR(ENOMEM);
+    }
+    av_image_fill_arrays(src, src_linesize, buf, frame->format, UP_W, UP_H, 1);
+    av_image_copy(frame->data, frame->linesize, (const uint8_t **)src,
+                  src_linesize, frame->format, UP_W, UP_H);
+
+    *pframe = frame;
+    return 0;
+}
+
+static int run_upload(int depth)
+{
+    int size = UP_W * UP_H * 3 / 2;
+    uint32_t expected[NB_FRAMES];
+    NIPipeline *p;
+    int read = 0, written = 0, err = 0, eof = 0;
+    FILE *f = tmpfile();
+
+    if (!f)
+        return 1;
+    for (int i = 0; i < NB_FRAMES; i++) {
+        uint8_t buf[UP_W * UP_H * 3 / 2];
+
+        for (int j = 0; j < size; j++)
+            buf[j] = i * 7 + j;
+        expected[i] = av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0, buf, size);
+        fwrite(buf, 1, size, f);
+    }
+    rewind(f);
+
+    if (ff_ni_pipeline_alloc(&p, &upload_ops, NULL, NULL, depth,
+                             sizeof(UploadJob)) < 0) {
+        fclose(f);
+        return 1;
+    }
+
+    while (!err && (!eof || ff_ni_pipeline_pending(p))) {
+        UploadJob *job = eof ? NULL : ff_ni_pipeline_next_job(p);
+        AVFrame *frame;
+        int ret;
+
+        if (job) {
+            ret = read_frame(f, &frame);
+            if (ret == AVERROR_EOF) {
+                eof = 1;
+                continue;
+            }
+            if (ret < 0)
+                break;
+            frame->pts = read++;
+            job->in = frame;
+            if (ff_ni_pipeline_push(p, frame) < 0)
+                break;
+            continue;
+        }
+
+        ret = ff_ni_pipeline_pop(p, &frame, (void **)&job, 1);
+        if (ret <= 0 || frame->pts != written || job->crc != expected[written]) {
+            printf("upload %d: %s\n", written, ret <= 0 ? "error" : "mismatch");
+            err = 1;
+        }
+        written++;
+        av_frame_free(&frame);
+        if (ret)
+            ff_ni_pipeline_release(p);
+    }
+
+    printf("upload depth %d: %d frames read, %d written%s\n", depth, read,
+           written, err || written != NB_FRAMES ? ", FAILED" : "");
+
+    ff_ni_pipeline_free(&p);
+    fclose(f);
+    return err || written != NB_FRAMES;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    ret |= run(1, -1, -1);
+    ret |= run(3, -1, -1);
+    ret |= run(1, 5, 9);
+    ret |= run(4, 5, 9);
+    ret |= run_upload(1);
+    ret |= run_upload(3);
+
+    return ret;
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavfilter/ni_pool_plan.c"
+
+#define SRC "buffer=video_size=64x64:pix_fmt=yuv420p:time_base=1/25"
+
+/*
+ * Software frames follow the same forwarding rules as the hardware ones,
+ * so the walk is checked on graphs of lavfi filters fed by a buffer source.
+ */
+static const struct {
+    const char *graph;
+    int min_size;
+} tests[] = {
+    { SRC ",buffersink",                                            4 },
+    { SRC ",null,setpts=PTS,buffersink",                            4 },
+    { SRC ",split=3[a][b][c];[a]buffersink;[b]setpts=PTS-STARTPTS,buffersink;"
+      "[c]null,buffersink",                                         1 },
+    { SRC ",split[a][b];[a]split=3[c][d][e];[b]buffersink;"
+      "[c]buffersink;[d]buffersink;[e]buffersink",                  1 },
+    { SRC ",split[a][b];[a]format=gray,buffersink;[b]buffersink",   4 },
+    { SRC ",format=gray,buffersink",                                1 },
+    { SRC ":extra_hw_frames=0,buffersink",                          4 },
+    { SRC ":extra_hw_frames=6,buffersink",                          1 },
+    { SRC ":extra_hw_frames=64,buffersink",                         1 },
+};
+
+static int run(const char *desc, int min_size)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVFilterContext *src;
+    int ret;
+
+    if (!graph)
+        return AVERROR(ENOMEM);
+    ret = avfilter_graph_parse_ptr(graph, desc, &inputs, &outputs, NULL);
+    if (ret >= 0)
+        ret = avfilter_graph_config(graph, NULL);
+    if (ret < 0)
+        goto end;
+
+    src = avfilter_graph_get_filter(graph, "Parsed_buffer_0");
+    if (!src) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+    printf("%s: demand %d, pool %d\n", desc, ff_ni_pool_plan_demand(src),
+           ff_ni_pool_plan(src, min_size));
+
+end:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+static int test_usage(void)
+{
+    NIPoolUsage *u = ff_ni_pool_usage_alloc(4), *held = u;
+    int err;
+
+    if (!u)
+        return 1;
+
+    ff_ni_pool_usage_acquire(u);
+    ff_ni_pool_usage_acquire(u);
+    ff_ni_pool_usage_release(u);
+    ff_ni_pool_usage_acquire(u);
+    ff_ni_pool_usage_acquire(u);
+    ff_ni_pool_usage_acquire(NULL);
+
+    // the frames outlive the filter
+    ff_ni_pool_usage_unref(&held);
+    err = atomic_load(&u->in_use) != 3 || atomic_load(&u->peak) != 3;
+    printf("usage: %d in use, peak %d\n", atomic_load(&u->in_use), atomic_load(&u->peak));
+    for (int i = 0; i < 3; i++)
+        ff_ni_pool_usage_release(u);
+
+    return err;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        if (run(tests[i].graph, tests[i].min_size) < 0) {
+            printf("%s: failed\n", tests[i].graph);
+            ret = 1;
+        }
+    }
+    ret |= test_usage();
+
+    return ret;
+}
@@ -0,0 +1,117 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavfilter/ni_scale_cache.c"
+
+/* software frames stand for the surfaces, only their references matter */
+static AVFrame *make_frame(int64_t pts)
+{
+    AVFrame *f = av_frame_alloc();
+
+    if (!f)
+        return NULL;
+    f->format = AV_PIX_FMT_GRAY8;
+    f->width  = 16;
+    f->height = 16;
+    f->pts    = pts;
+    if (av_frame_get_buffer(f, 0) < 0)
+        av_frame_free(&f);
+    return f;
+}
+
+static NIScaleKey key(uint16_t frame_idx, int w)
+{
+    NIScaleKey k = { .device = 3, .session_id = 1, .frame_idx = frame_idx,
+                     .w = w, .h = w * 9 / 16, .format = AV_PIX_FMT_YUV420P };
+    return k;
+}
+
+static void lookup(NIScaleCache *c, const char *what, NIScaleKey k)
+{
+    AVFrame *dst = av_frame_alloc();
+    int ret = ff_ni_scale_cache_get(c, &k, dst);
+
+    printf("%s: %s", what, ret > 0 ? "hit" : ret ? "error" : "miss");
+    if (ret > 0)
+        printf(" pts %"PRId64, dst->pts);
+    printf("\n");
+    av_frame_free(&dst);
+}
+
+int main(void)
+{
+    static int owner_a, owner_b;
+    AVFrame *in = make_frame(0), *next = make_frame(1);
+    // the other scaler has another timebase, its pts are smaller
+    AVFrame *out = make_frame(1000), *out2 = make_frame(40);
+    AVBufferRef *buf = ff_ni_scale_cache_alloc();
+    AVBufferRef *other = ff_ni_scale_cache_alloc();
+    NIScaleCache *c;
+    NIScaleKey k;
+
+    if (!in || !next || !out || !out2 || !buf || !other)
+        return 1;
+    c = (NIScaleCache *)buf->data;
+
+    k = key(5, 1280);
+    ff_ni_scale_cache_put(c, &owner_a, &k, in->buf[0], out);
+    printf("input refs %d\n", av_buffer_get_ref_count(in->buf[0]));
+    lookup(c, "same picture", key(5, 1280));
+    lookup((NIScaleCache *)other->data, "other graph", key(5, 1280));
+    lookup(c, "other size", key(5, 640));
+    lookup(c, "other surface", key(6, 1280));
+    k.params = 1;
+    lookup(c, "other settings", k);
+
+    // the next picture of the decoder session ends the frame interval
+    k = key(6, 1280);
+    ff_ni_scale_cache_put(c, &owner_b, &k, next->buf[0], out2);
+    printf("input refs %d\n", av_buffer_get_ref_count(in->buf[0]));
+    lookup(c, "older picture", key(5, 1280));
+    lookup(c, "newer picture", key(6, 1280));
+
+    ff_ni_scale_cache_purge(c, &owner_a);
+    lookup(c, "after purge of the other owner", key(6, 1280));
+    ff_ni_scale_cache_purge(c, &owner_b);
+    lookup(c, "after purge", key(6, 1280));
+
+    // the oldest entry makes room
+    for (int i = 0; i <= NI_SCALE_CACHE_SIZE; i++) {
+        k = key(5, 64 + 2 * i);
+        ff_ni_scale_cache_put(c, &owner_a, &k, in->buf[0], out);
+    }
+    lookup(c, "evicted", key(5, 64));
+    lookup(c, "kept", key(5, 66));
+    ff_ni_scale_cache_purge(c, &owner_a);
+    printf("input refs %d\n", av_buffer_get_ref_count(in->buf[0]));
+
+    // the last reference to the cache drops what is left
+    k = key(5, 1280);
+    ff_ni_scale_cache_put(c, &owner_a, &k, in->buf[0], out);
+    av_buffer_unref(&buf);
+    printf("input refs %d\n", av_buffer_get_ref_count(in->buf[0]));
+
+    av_buffer_unref(&other);
+    av_frame_free(&in);
+    av_frame_free(&next);
+    av_frame_free(&out);
+    av_frame_free(&out2);
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavfilter/ni_yolo.c"
+
+static const int   masks[2][3] = {{3, 4, 5}, {0, 1, 2}};
+static const float biases[]    = {10, 16, 25, 37, 49, 71, 85, 118, 143, 190, 274, 283};
+
+/*
+ * Per cell decoding and pairwise suppression as ni_quadra_roi did before,
+ * with the decoding order as sort tie break so the results are comparable.
+ */
+static int ref_detect(NIYoloDetection **pdets, const NIYoloLayer *layers,
+                      int nb_layers, int netw, int neth,
+                      float thresh, float nms_thresh)
+{
+    NIYoloDetection *dets = NULL;
+    int nb = 0, index = 0;
+
+    for (int l = 0; l < nb_layers; l++) {
+        const NIYoloLayer *ly = &layers[l];
+        const int plane   = ly->width * ly->height;
+        const int entries = 4 + 1 + ly->classes;
+
+        for (int i = 0; i < plane; i++) {
+            for (int n = 0; n < ly->component; n++, index++) {
+                const float *x = ly->output + n * plane * entries;
+                float objectness = sigmoid(x[4 * plane + i]);
+                float max_prob = thresh;
+                int prob_class = -1;
+
+                for (int k = 0; k < ly->classes; k++) {
+                    double prob = objectness * sigmoid(x[(5 + k) * plane + i]);
+                    if (prob >= max_prob) {
+                        prob_class = k;
+                        max_prob   = (float)prob;
+                    }
+                }
+                if (prob_class < 0)
+                    continue;
+
+                dets = av_realloc_f(dets, nb + 1, sizeof(*dets));
+                if (!dets)
+                    return AVERROR(ENOMEM);
+                dets[nb].x = (float)((float)(i % ly->width) + sigmoid(x[i])) / (float)ly->width;
+                dets[nb].y = (float)((float)(i / ly->width) + sigmoid(x[plane + i])) / (float)ly->height;
+                dets[nb].w = (float)exp((double)x[2 * plane + i]) * ly->biases[2 * ly->mask[n]] / (float)netw;
+                dets[nb].h = (float)exp((double)x[3 * plane + i]) * ly->biases[2 * ly->mask[n] + 1] / (float)neth;
+                dets[nb].x -= (float)(dets[nb].w / 2.0);
+                dets[nb].y -= (float)(dets[nb].h / 2.0);
+                dets[nb].objectness = objectness;
+                dets[nb].prob       = max_prob;
+                dets[nb].cls        = prob_class;
+                dets[nb].anchor     = n;
+                dets[nb].index      = index;
+                nb++;
+            }
+        }
+    }
+
+    if (nb)
+        qsort(dets, nb, sizeof(*dets), detection_cmp);
+
+    for (int i = 0; i < nb - 1; i++) {
+        if (dets[i].prob == 0)
+            continue;
+        for (int j = i + 1; j < nb && dets[j].cls == dets[i].cls; j++) {
+            if (dets[j].prob == 0)
+                continue;
+            if (box_iou(&dets[i], &dets[j]) > nms_thresh)
+                dets[j].prob = 0;
+        }
+    }
+
+    *pdets = dets;
+    return nb;
+}
+
+static float lfg_float(AVLFG *lfg, float lo, float hi)
+{
+    return lo + (hi - lo) * (av_lfg_get(lfg) / 4294967296.0);
+}
+
+/* mostly empty cells, with clusters of confident ones around a few objects */
+static void fill_layer(AVLFG *lfg, float *out, int w, int h, int classes)
+{
+    const int plane = w * h;
+    int objs[4][2];
+
+    for (int o = 0; o < 4; o++) {
+        objs[o][0] = av_lfg_get(lfg) % w;
+        objs[o][1] = av_lfg_get(lfg) % h;
+    }
+
+    for (int n = 0; n < 3; n++) {
+        float *x = out + n * plane * (5 + classes);
+
+        for (int i = 0; i < plane; i++) {
+            int hot = 0;
+
+            for (int o = 0; o < 4; o++)
+                hot |= FFABS(i % w - objs[o][0]) <= 2 && FFABS(i / w - objs[o][1]) <= 2;
+
+            x[i]             = lfg_float(lfg, -3, 3);
+            x[plane + i]     = lfg_float(lfg, -3, 3);
+            x[2 * plane + i] = lfg_float(lfg, -1, 1);
+            x[3 * plane + i] = lfg_float(lfg, -1, 1);
+            x[4 * plane + i] = hot ? lfg_float(lfg, -2, 6) : lfg_float(lfg, -12, -1);
+            for (int k = 0; k < classes; k++)
+                x[(5 + k) * plane + i] = lfg_float(lfg, -4, 4);
+        }
+    }
+}
+
+static int same(const NIYoloDetection *a, const NIYoloDetection *b)
+{
+    return a->x == b->x && a->y == b->y && a->w == b->w && a->h == b->h &&
+           a->prob == b->prob && a->objectness == b->objectness &&
+           a->cls == b->cls && a->anchor == b->anchor && a->index == b->index;
+}
+
+int main(void)
+{
+    static const struct {
+        float obj_thresh, nms_thresh;
+        int classes;
+    } tests[] = {
+        { 0.25, 0.45, 1 },
+        { 0.25, 0.45, 3 },
+        { 0.05, 0.30, 1 },
+        { 0.50, 0.00, 2 },
+        { 0.25, -1.0, 1 },
+        { 0.00, 0.45, 1 },
+    };
+    NIYoloContext yc = { 0 };
+    NIYoloLayer layers[2];
+    float *out[2] = { NULL };
+    AVLFG lfg;
+    int ret = 0;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    for (int t = 0; t < FF_ARRAY_ELEMS(tests) && !ret; t++) {
+        NIYoloDetection *ref = NULL;
+        int nb, nb_ref, kept = 0;
+
+        for (int l = 0; l < 2; l++) {
+            layers[l].width     = 13 << l;
+            layers[l].height    = 13 << l;
+            layers[l].classes   = tests[t].classes;
+            layers[l].component = 3;
+            layers[l].biases    = biases;
+            memcpy(layers[l].mask, masks[l], sizeof(layers[l].mask));
+
+            av_freep(&out[l]);
+            out[l] = av_malloc_array(layers[l].width * layers[l].height * 3 *
+                                     (5 + tests[t].classes), sizeof(float));
+            if (!out[l])
+                return 1;
+            fill_layer(&lfg, out[l], layers[l].width, layers[l].height,
+                       tests[t].classes);
+            layers[l].output = out[l];
+        }
+
+        nb     = ff_ni_yolo_detect(&yc, layers, 2, 416, 416,
+                                   tests[t].obj_thresh, tests[t].nms_thresh);
+        nb_ref = ref_detect(&ref, layers, 2, 416, 416,
+                            tests[t].obj_thresh, tests[t].nms_thresh);
+        if (nb < 0 || nb_ref < 0)
+            return 1;
+
+        for (int i = 0; i < nb_ref; i++) {
+            if (ref[i].prob == 0)
+                continue;
+            if (kept >= nb || !same(&ref[i], &yc.dets[kept])) {
+                printf("test %d: detection %d differs\n", t, kept);
+                ret = 1;
+                break;
+            }
+            kept++;
+        }
+        if (!ret && kept != nb) {
+            printf("test %d: %d detections, expected %d\n", t, nb, kept);
+            ret = 1;
+        }
+
+        printf("test %d: obj %.2f nms %.2f classes %d: %d candidates, %d kept\n",
+               t, tests[t].obj_thresh, tests[t].nms_thresh, tests[t].classes,
+               nb_ref, nb);
+        for (int i = 0; i < FFMIN(nb, 8) && t == 0; i++)
+            printf("  cls %d prob %.3f box %.3f %.3f %.3f %.3f\n",
+                   yc.dets[i].cls, yc.dets[i].prob, yc.dets[i].x,
+                   yc.dets[i].y, yc.dets[i].w, yc.dets[i].h);
+
+        av_free(ref);
+    }
+
+    ff_ni_yolo_uninit(&yc);
+    av_free(out[0]);
+    av_free(out[1]);
+
+    return ret;
+}
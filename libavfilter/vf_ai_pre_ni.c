@@ -542,386 +542,6 @@ static int output_config_props(AVFilterLink * outlink)
     return 0;
 }
 
-static int av_to_niframe_copy(ni_frame_t * dst, const AVFrame * src,
-                              int nb_planes)
-{
-    int dst_stride[4], src_height[4], hpad[4], vpad[4];
-    int i, j, h;
-    uint8_t *src_line, *dst_line, YUVsample, *sample, *dest;
-    uint16_t lastidx;
-    bool tenBit;
-    uint32_t src_size = 0;
-
-    switch (src->format) {
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUVJ420P:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = FFALIGN((src->width / 2), 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = FFALIGN(src_height[2], 2) - src_height[2];
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = FFALIGN(src->width, 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = FFALIGN(src_height[2], 2) - src_height[2];
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-    case AV_PIX_FMT_NV12:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_NV16:
-        dst_stride[0] = FFALIGN(src->width, 64);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = 0;
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_P010LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_BGRP:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = src->height;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        dst_stride[0] = FFALIGN(src->width, 16) * 2;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    default:
-        av_log(NULL, AV_LOG_ERROR, "Pixel format %s not supported\n",
-               av_get_pix_fmt_name(src->format));
-        return AVERROR(EINVAL);
-    }
-
-    for (i = 0; i < nb_planes; i++) {
-        src_size += (dst_stride[i] + vpad[i]) * src_height[i];
-    }
-    if (dst->buffer_size < src_size) {
-        av_log(NULL, AV_LOG_ERROR, "av_to_niframe_copy failed, "
-               "please check the input/output frame reslotion "
-               "and the module reslotion\n");
-        return -1;
-    }
-    dst_line = dst->p_buffer;
-    for (i = 0; i < nb_planes; i++) {
-        src_line = src->data[i];
-        for (h = 0; h < src_height[i]; h++) {
-             memcpy(dst_line, src_line,
-                   FFMIN(src->linesize[i], dst_stride[i]));
-
-            if (hpad[i]) {
-                lastidx = src->linesize[i];
-
-                if (tenBit) {
-                    sample = &src_line[lastidx - 2];
-                    dest = &dst_line[lastidx];
-
-                    /* two bytes per sample */
-                    for (j = 0; j < hpad[i] / 2; j++) {
-                        memcpy(dest, sample, 2);
-                        dest += 2;
-                    }
-                } else {
-                    YUVsample = dst_line[lastidx - 1];
-                    memset(&dst_line[lastidx], YUVsample, hpad[i]);
-                }
-            }
-
-            src_line += src->linesize[i];
-            dst_line += dst_stride[i];
-        }
-
-        /* Extend the height by cloning the last line */
-        src_line = dst_line - dst_stride[i];
-        for (h = 0; h < vpad[i]; h++) {
-            memcpy(dst_line, src_line, dst_stride[i]);
-            dst_line += dst_stride[i];
-        }
-    }
-
-    return 0;
-}
-
-static int ni_to_avframe_copy(AVFrame * dst, const ni_packet_t * src,
-                              int nb_planes)
-{
-    int src_linesize[4], src_height[4];
-    int i, h;
-    uint8_t *src_line, *dst_line;
-    uint32_t dst_size = 0;
-    switch (dst->format) {
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUVJ420P:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width / 2, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_NV12:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_NV16:
-        src_linesize[0] = FFALIGN(dst->width, 64);
-        src_linesize[1] = FFALIGN(dst->width, 64);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 2;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_P010LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width * 2, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 4;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_BGRP:
-        src_linesize[0] = FFALIGN(dst->width, 32);
-        src_linesize[1] = FFALIGN(dst->width, 32);
-        src_linesize[2] = FFALIGN(dst->width, 32);
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = dst->height;
-        src_height[3] = 0;
-        break;
-    default:
-        av_log(NULL, AV_LOG_ERROR, "Unsupported pixel format %s\n",
-               av_get_pix_fmt_name(dst->format));
-        return AVERROR(EINVAL);
-    }
-    for (i = 0; i < nb_planes; i++) {
-        dst_size +=
-            FFMIN(src_linesize[i], dst->linesize[i]) * src_height[i];
-    }
-    if (dst_size > src->data_len) {
-        av_log(NULL, AV_LOG_ERROR, "ni_to_avframe_copy failed, "
-               "please check the input/output frame reslotion "
-               "and the module reslotion\n");
-        return -1;
-    }
-    src_line = src->p_data;
-    for (i = 0; i < nb_planes; i++) {
-        dst_line = dst->data[i];
-
-        for (h = 0; h < src_height[i]; h++) {
-            memcpy(dst_line, src_line,
-                   FFMIN(src_linesize[i], dst->linesize[i]));
-            dst_line += FFMIN(src_linesize[i], dst->linesize[i]);
-            src_line += src_linesize[i];
-        }
-    }
-
-    return 0;
-}
-
 static int filter_frame(AVFilterLink * link, AVFrame * in)
 {
     AVFilterContext *ctx = link->dst;
@@ -932,6 +552,8 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
     int ret;
     AiContext *ai_ctx;
     ni_ai_pre_network_t *network = &s->network;
+    NIDeviceLayout layout;
+    NIHostFrameMap map = { 0 };
     int nb_planes;
     int hwframe;
     int64_t start_t;
@@ -1203,9 +825,15 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
             }
             nb_planes = 1;      // only copy Y data
         }
-        retval =
-            av_to_niframe_copy(&ai_ctx->api_src_frame.data.frame, in,
-                               nb_planes);
+        ret = ff_ni_get_device_layout(&layout, in->format, in->width,
+                                      in->height, nb_planes);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Pixel format %s not supported\n",
+                   av_get_pix_fmt_name(in->format));
+            goto failed_out;
+        }
+        retval = ff_ni_map_host_frame(&ai_ctx->api_src_frame.data.frame,
+                                      &map, in, &layout);
         if (retval < 0) {
             av_log(ctx, AV_LOG_ERROR, "ai_pre cannot copy frame\n");
             ret = AVERROR(EIO);
@@ -1235,6 +863,7 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
                 goto failed_out;
             }
         } while (retval == 0);
+        ff_ni_unmap_host_frame(&ai_ctx->api_src_frame.data.frame, &map);
         retval =
             ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_frame.data.packet,
                                       &network->raw);
@@ -1279,9 +908,18 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
             }
             nb_planes = 1;      // only copy Y data
         }
+        ret = ff_ni_get_device_layout(&layout, out->format, out->width,
+                                      out->height, nb_planes);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported pixel format %s\n",
+                   av_get_pix_fmt_name(out->format));
+            goto failed_out;
+        }
         retval =
-            ni_to_avframe_copy(out, &ai_ctx->api_dst_frame.data.packet,
-                               nb_planes);
+            ff_ni_copy_device_to_host_frame(out,
+                                            ai_ctx->api_dst_frame.data.packet.p_data,
+                                            ai_ctx->api_dst_frame.data.packet.data_len,
+                                            &layout);
         if (retval < 0) {
             av_log(ctx, AV_LOG_ERROR,
                    "ai_pre cannot copy ai frame to avframe\n");
@@ -1290,10 +928,14 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
         }
         if (s->channel_mode) {
             // copy U/V data from the input sw frame
-            memcpy(out->data[1], in->data[1],
-                   in->height * in->linesize[1] / 2);
-            memcpy(out->data[2], in->data[2],
-                   in->height * in->linesize[2] / 2);
+            ff_ni_copy_plane(out->data[1], out->linesize[1],
+                             in->data[1], in->linesize[1],
+                             FFMIN(out->linesize[1], in->linesize[1]),
+                             AV_CEIL_RSHIFT(in->height, 1));
+            ff_ni_copy_plane(out->data[2], out->linesize[2],
+                             in->data[2], in->linesize[2],
+                             FFMIN(out->linesize[2], in->linesize[2]),
+                             AV_CEIL_RSHIFT(in->height, 1));
         }
     }
 
@@ -1301,6 +943,8 @@ static int filter_frame(AVFilterLink * link, AVFrame * in)
     return ff_filter_frame(link->dst->outputs[0], out);
 
 failed_out:
+    if (map.mapped)
+        ff_ni_unmap_host_frame(&s->ai_ctx->api_src_frame.data.frame, &map);
     if (out)
         av_frame_free(&out);
 
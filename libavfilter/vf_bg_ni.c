@@ -28,6 +28,7 @@
 #include "libswscale/swscale.h"
 
 #include "nifilter.h"
+#include "ni_pipeline.h"
 #include "filters.h"
 #include "formats.h"
 #if !IS_FFMPEG_71_AND_ABOVE
@@ -95,6 +96,13 @@ typedef struct OverlayContext {
     ni_session_data_io_t api_dst_frame;
 } OverlayContext;
 
+/* one frame in flight on the AI session */
+typedef struct BgJob {
+    ni_session_data_io_t pkt;  /* inference output */
+    niFrameSurface1_t surface; /* scaled input, recycled once read */
+    int infer;                 /* 0 when the frame reuses the last mask */
+} BgJob;
+
 typedef struct NetIntBgContext {
     const AVClass *class;
 
@@ -132,6 +140,9 @@ typedef struct NetIntBgContext {
     int keep_alive_timeout; /* keep alive timeout setting */
     bool is_p2p;
     int buffer_limit;
+
+    int ai_depth;
+    NIPipeline *pipeline;
 } NetIntBgContext;
 
 static int query_formats(AVFilterContext *ctx)
@@ -556,7 +567,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     /* roi */
     av_buffer_unref(&s->out_frames_ref);
 
-    /* ai */
+    /* ai, the pipeline worker still uses the session */
+    ff_ni_pipeline_report(s->pipeline, ctx);
+    ff_ni_pipeline_free(&s->pipeline);
     cleanup_ai_context(ctx, s);
     ni_destroy_network(network);
 
@@ -690,73 +703,45 @@ static AVFrame *create_bg_frame(AVFilterContext *ctx, int src_w, int src_h,
 
     NetIntBgContext *s   = ctx->priv;
 
+    static const uint8_t bg_values[4] = { 149, 43, 21, 21 };
+    const AVPixFmtDescriptor *desc;
     int dst_w = src_w;
     int dst_h = src_h;
-    int size_Y, size_UV;
-    uint8_t *Y_value, *U_value, *V_value, *A_value;
 
     /*create bg frame*/
     AVFrame *dst = av_frame_alloc();
+    if (!dst)
+        return NULL;
 
     dst->format = (int)src_pixfmt;
     dst->width  = dst_w;
     dst->height = dst_h;
 
-    av_frame_get_buffer(dst, 4);
+    if (av_frame_get_buffer(dst, 4) < 0) {
+        av_frame_free(&dst);
+        return NULL;
+    }
 
     av_log(ctx, AV_LOG_DEBUG, "create_frame function: dst_linesize: %d \n",
            dst->linesize[0]);
 
     s->bg_frame_size = s->network.netw * s->network.neth;
 
-    /*copy value to dst(bg_frame) frame*/
-    size_Y  = dst->width * dst->height;
-    size_UV = dst->width * dst->height / 4;
-
-    Y_value = av_mallocz(size_Y * sizeof(uint8_t));
-    U_value = av_mallocz(size_UV * sizeof(uint8_t));
-    V_value = av_mallocz(size_UV * sizeof(uint8_t));
-    A_value = av_mallocz(s->bg_frame_size * sizeof(uint8_t));
-
     av_log(ctx, AV_LOG_DEBUG,
            "create_bg_frame dst->linesize[0] %d dst->linesize[1] %d "
            "dst->linesize[2] %d dst->linesize[3] %d\n",
            dst->linesize[0], dst->linesize[1], dst->linesize[2],
            dst->linesize[3]);
 
-    for (int i = 0; i < size_Y; i++) {
-        Y_value[i] = 149;
-    }
-
-    for (int i = 0; i < size_UV; i++) {
-        U_value[i] = 43;
-    }
-
-    for (int i = 0; i < size_UV; i++) {
-        V_value[i] = 21;
-    }
+    /* fill each plane with its constant value, padding included */
+    desc = av_pix_fmt_desc_get(dst->format);
+    for (int i = 0; i < 4 && dst->data[i]; i++) {
+        int h = (i == 1 || i == 2) ?
+                AV_CEIL_RSHIFT(dst->height, desc->log2_chroma_h) : dst->height;
 
-    for (int i = 0; i < s->bg_frame_size; i++) {
-        A_value[i] = 21;
+        memset(dst->data[i], bg_values[i], (size_t)dst->linesize[i] * h);
     }
 
-    // copy the mask_data to the alpha_mask_frame
-    av_image_copy_plane(dst->data[0], dst->linesize[0], Y_value,
-                        dst->linesize[0], dst->linesize[0], dst->height);
-
-    av_image_copy_plane(dst->data[1], dst->linesize[1], U_value,
-                        dst->linesize[1], dst->linesize[1], (dst->height) / 2);
-
-    av_image_copy_plane(dst->data[2], dst->linesize[2], V_value,
-                        dst->linesize[2], dst->linesize[2], (dst->height) / 2);
-
-    av_image_copy_plane(dst->data[3], dst->linesize[3], A_value,
-                        dst->linesize[3], dst->linesize[3], dst->height);
-
-    av_free(Y_value);
-    av_free(U_value);
-    av_free(V_value);
-    av_free(A_value);
     return dst;
 }
 
@@ -832,10 +817,10 @@ static int get_alpha_mask_frame(AVFilterContext *ctx, uint8_t *mask_data)
     struct SwsContext *convert_ctx = NULL;
 
     /* Copy the alpha plane from mask_data */
-    av_image_copy_plane(
+    ff_ni_copy_plane(
         s->alpha_mask_frame->data[3], s->alpha_mask_frame->linesize[3],
-        mask_data, s->alpha_mask_frame->linesize[3],
-        s->alpha_mask_frame->linesize[3], s->alpha_mask_frame->height);
+        mask_data, s->alpha_mask_frame->width,
+        s->alpha_mask_frame->width, s->alpha_mask_frame->height);
 
     av_log(ctx, AV_LOG_DEBUG,
            "get_alpha_mask_frame function: alpha_mask_frame->width: %d "
@@ -1338,17 +1323,76 @@ static int ni_bg_process(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt,
     return 0;
 }
 
-static int filter_frame(AVFilterLink *link, AVFrame *in)
+static int bg_submit(void *opaque, void *job)
+{
+    AVFilterContext *ctx = opaque;
+    NetIntBgContext *s = ctx->priv;
+    BgJob *j = job;
+    ni_retcode_t retval;
+
+    if (!j->infer)
+        return 0;
+
+    /* allocate output buffer */
+    retval = ni_device_alloc_frame(&s->ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
+                                   j->surface.ui32nodeAddress,
+                                   j->surface.ui16FrameIdx, NI_DEVICE_TYPE_AI);
+    if (retval != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
+        ni_hwframe_buffer_recycle(&j->surface, j->surface.device_handle);
+        return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static int bg_collect(void *opaque, void *job)
+{
+    AVFilterContext *ctx = opaque;
+    NetIntBgContext *s = ctx->priv;
+    BgJob *j = job;
+    ni_retcode_t retval;
+
+    if (!j->infer)
+        return 1;
+
+    retval = ni_device_session_read(&s->ai_ctx->api_ctx, &j->pkt,
+                                    NI_DEVICE_TYPE_AI);
+    if (retval == 0)
+        return 0;
+
+    ni_hwframe_buffer_recycle(&j->surface, j->surface.device_handle);
+    if (retval < 0) {
+        av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
+        return AVERROR(EIO);
+    }
+
+    return 1;
+}
+
+static void bg_uninit_job(void *opaque, void *job)
+{
+    BgJob *j = job;
+
+    ni_packet_buffer_free(&j->pkt.data.packet);
+}
+
+static const NIPipelineOps bg_pipeline_ops = {
+    .submit     = bg_submit,
+    .collect    = bg_collect,
+    .uninit_job = bg_uninit_job,
+    .job_name   = "inference",
+};
+
+/* scale the frame and queue it for inference */
+static int bg_queue_frame(AVFilterContext *ctx, AVFrame *in)
 {
-    AVFilterContext *ctx = link->dst;
     NetIntBgContext *s = ctx->priv;
     int ret;
     /* ai roi */
     ni_roi_network_t *network;
     ni_retcode_t retval;
-    AiContext *ai_ctx;
-    /* overlay */
-    AVFrame *realout;
+    BgJob *job;
 
     av_log(ctx, AV_LOG_INFO, "entering %s\n", __func__);
 
@@ -1375,14 +1419,25 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         ni_cpy_hwframe_ctx(in_frames_ctx, out_frames_ctx);
         ni_device_session_copy(&s->ai_ctx->api_ctx, &out_ni_ctx->api_ctx);
 
+        ret = ff_ni_pipeline_alloc(&s->pipeline, &bg_pipeline_ops, ctx, ctx,
+                                   s->ai_depth, sizeof(BgJob));
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "failed to create ai pipeline\n");
+            goto fail;
+        }
+
         s->initialized = 1;
     }
 
-    ai_ctx  = s->ai_ctx;
     network = &s->network;
 
-    retval  = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
-                                       &network->raw);
+    job = ff_ni_pipeline_next_job(s->pipeline);
+    if (!job) {
+        ret = AVERROR_BUG;
+        goto fail;
+    }
+
+    retval  = ni_ai_packet_buffer_alloc(&job->pkt.data.packet, &network->raw);
     if (retval != NI_RETCODE_SUCCESS) {
         av_log(ctx, AV_LOG_ERROR, "failed to allocate packet\n");
         ret = AVERROR(EAGAIN);
@@ -1393,53 +1448,47 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     ff_ni_update_benchmark(NULL);
 #endif
 
-    if (in->format == AV_PIX_FMT_NI_QUAD) {
+    job->infer = in->format == AV_PIX_FMT_NI_QUAD &&
+                 ((s->skip == 0) || ((s->framecount-1) % (s->skip + 1) == 0));
+    if (job->infer) {
         niFrameSurface1_t *filt_frame_surface;
 
-        if ((s->skip == 0) || ((s->framecount-1) % (s->skip + 1) == 0)) {
-            ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
-                                   &filt_frame_surface);
-            if (ret < 0) {
-                av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
-                goto fail;
-            }
+        ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
+                               &filt_frame_surface);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
+            goto fail;
+        }
 
-            av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
-                   filt_frame_surface->ui16FrameIdx);
-
-            /* allocate output buffer */
-            retval = ni_device_alloc_frame(&ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
-                                           filt_frame_surface->ui32nodeAddress,
-                                           filt_frame_surface->ui16FrameIdx,
-                                           NI_DEVICE_TYPE_AI);
-            if (retval != NI_RETCODE_SUCCESS) {
-                av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
-                ret = AVERROR(ENOMEM);
-                goto fail;
-            }
+        av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
+               filt_frame_surface->ui16FrameIdx);
 
-            do {
-                retval = ni_device_session_read(
-                    &ai_ctx->api_ctx, &ai_ctx->api_dst_pkt, NI_DEVICE_TYPE_AI);
-                if (retval < 0) {
-                    av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
-                    ret = AVERROR(EIO);
-                    goto fail;
-                } else if (retval > 0) {
-                    ret = ni_bg_process(ctx, &ai_ctx->api_dst_pkt, in);
-                    if (ret != 0) {
-                        av_log(ctx, AV_LOG_ERROR,
-                               "failed to read roi from packet\n");
-                        goto fail;
-                    }
-                }
-                ni_usleep(100); //prevent spamming HW
-            } while (retval == 0);
+        /* the scaler reuses its descriptor for the next frame */
+        job->surface = *filt_frame_surface;
+    }
 
-           ni_hwframe_buffer_recycle(filt_frame_surface,
-                                     filt_frame_surface->device_handle);
-        }
+    return ff_ni_pipeline_push(s->pipeline, in);
+fail:
+    av_frame_free(&in);
+    return ret;
+}
+
+/* apply the mask of a finished job and send the frame out */
+static int bg_output_frame(AVFilterContext *ctx, AVFrame *in, BgJob *job)
+{
+    NetIntBgContext *s = ctx->priv;
+    int ret = 0;
+    /* overlay */
+    AVFrame *realout;
+
+    if (job->infer) {
+        ret = ni_bg_process(ctx, &job->pkt, in);
+        if (ret != 0)
+            av_log(ctx, AV_LOG_ERROR, "failed to read roi from packet\n");
     }
+    ff_ni_pipeline_release(s->pipeline);
+    if (ret < 0)
+        goto fail;
 
     /* {
         char alpha_pic[512];
@@ -1508,6 +1557,45 @@ fail:
     return ret;
 }
 
+/**
+ * Output the oldest frame if its inference is done.
+ *
+ * @return 1 if a frame was sent, 0 if none was ready, a negative AVERROR
+ */
+static int bg_output_done(AVFilterContext *ctx, int block)
+{
+    NetIntBgContext *s = ctx->priv;
+    AVFrame *in;
+    BgJob *job;
+    int ret;
+
+    ret = ff_ni_pipeline_pop(s->pipeline, &in, (void **)&job, block);
+    if (ret < 0) {
+        ff_ni_pipeline_release(s->pipeline);
+        av_frame_free(&in);
+    }
+    if (ret <= 0)
+        return ret;
+
+    ret = bg_output_frame(ctx, in, job);
+    return ret < 0 ? ret : 1;
+}
+
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx = link->dst;
+    NetIntBgContext *s = ctx->priv;
+    int ret;
+
+    ret = bg_queue_frame(ctx, in);
+
+    /* nothing calls back for the result without activate(), wait for it */
+    while (ret >= 0 && ff_ni_pipeline_pending(s->pipeline))
+        ret = bg_output_done(ctx, 1);
+
+    return ret < 0 ? ret : 0;
+}
+
 #if IS_FFMPEG_61_AND_ABOVE
 static int activate(AVFilterContext *ctx)
 {
@@ -1520,6 +1608,23 @@ static int activate(AVFilterContext *ctx)
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
+    // Send out finished frames first. Wait for the oldest one only when
+    // nothing else can be done: the pipeline is full or the input ended
+    if (s->pipeline && ff_ni_pipeline_pending(s->pipeline)) {
+        int64_t pts;
+        int status;
+        int block = !ff_ni_pipeline_next_job(s->pipeline) ||
+                    ff_inlink_acknowledge_status(inlink, &status, &pts);
+
+        ret = bg_output_done(ctx, block);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            ff_filter_set_ready(ctx, 300);
+            return 0;
+        }
+    }
+
     if (ff_inlink_check_available_frame(inlink)) {
         // Consume from inlink framequeue only when outlink framequeue is empty
         // to prevent filter from exhausting all pre-allocated device buffers
@@ -1540,7 +1645,7 @@ static int activate(AVFilterContext *ctx)
         if (ret < 0)
             return ret;
 
-        ret = filter_frame(inlink, frame);
+        ret = bg_queue_frame(ctx, frame);
         if (ret >= 0) {
             ff_filter_set_ready(ctx, 300);
         }
@@ -1567,6 +1672,7 @@ static const AVOption ni_bg_options[] = {
     NI_FILT_OPTION_IS_P2P,
     NI_FILT_OPTION_KEEPALIVE,
     NI_FILT_OPTION_BUFFER_LIMIT,
+    NI_FILT_OPTION_AI_DEPTH,
     { NULL },
 };
 
@@ -29,6 +29,7 @@
 #include "libswscale/swscale.h"
 
 #include "nifilter.h"
+#include "ni_pipeline.h"
 #include "filters.h"
 #include "formats.h"
 #if !IS_FFMPEG_71_AND_ABOVE
@@ -96,6 +97,13 @@ typedef struct HwFormatContext {
     ni_session_data_io_t api_dst_frame;
 } HwFormatContext;
 
+/* one frame in flight on the AI session */
+typedef struct BgrJob {
+    ni_session_data_io_t pkt;  /* inference output */
+    niFrameSurface1_t surface; /* downscaled input, recycled once read */
+    int infer;                 /* 0 when the frame reuses the last mask */
+} BgrJob;
+
 typedef struct NetIntBgrContext {
     const AVClass *class;
 
@@ -126,12 +134,14 @@ typedef struct NetIntBgrContext {
     //ni_frame_t *p_dl_frame;
     ni_session_data_io_t p_dl_frame;
     uint8_t aui8SmallMask[256 * 144];
-    bool skipInference;
     int framecount;
     int skip;
     int skip_random_offset;
     int keep_alive_timeout; /* keep alive timeout setting */
     int buffer_limit;
+
+    int ai_depth;
+    NIPipeline *pipeline;
 } NetIntBgrContext;
 
 static int query_formats(AVFilterContext *ctx)
@@ -593,7 +603,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     /* roi */
     av_buffer_unref(&s->out_frames_ref);
 
-    /* ai */
+    /* ai, the pipeline worker still uses the session */
+    ff_ni_pipeline_report(s->pipeline, ctx);
+    ff_ni_pipeline_free(&s->pipeline);
     cleanup_ai_context(ctx, s);
     ni_destroy_network(ctx, network);
 
@@ -889,8 +901,8 @@ static int ni_bgr_process(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt)
     NetIntBgrContext *s = ctx->priv;
     int ret;
 
-    //aui8SmallMask
-    if (!s->skipInference) {
+    //aui8SmallMask, kept from the last inference for skipped frames
+    if (p_dst_pkt) {
         ni_get_mask2(ctx, p_dst_pkt);
     }
 
@@ -1054,28 +1066,82 @@ static int ni_bgr_create_output(AVFilterContext* ctx, AVFrame* in, AVFrame** rea
 }
 
 
-static int filter_frame(AVFilterLink *link, AVFrame *in)
+static int bgr_submit(void *opaque, void *job)
+{
+    AVFilterContext *ctx = opaque;
+    NetIntBgrContext *s = ctx->priv;
+    BgrJob *j = job;
+    ni_retcode_t retval;
+
+    if (!j->infer)
+        return 0;
+
+    /* allocate output buffer */
+    retval = ni_device_alloc_frame(&s->ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
+                                   j->surface.ui32nodeAddress,
+                                   j->surface.ui16FrameIdx, NI_DEVICE_TYPE_AI);
+    if (retval != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
+        ni_hwframe_buffer_recycle(&j->surface, j->surface.device_handle);
+        return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static int bgr_collect(void *opaque, void *job)
+{
+    AVFilterContext *ctx = opaque;
+    NetIntBgrContext *s = ctx->priv;
+    BgrJob *j = job;
+    ni_retcode_t retval;
+
+    if (!j->infer)
+        return 1;
+
+    retval = ni_device_session_read(&s->ai_ctx->api_ctx, &j->pkt,
+                                    NI_DEVICE_TYPE_AI);
+    if (retval == 0)
+        return 0;
+
+    ni_hwframe_buffer_recycle(&j->surface, j->surface.device_handle);
+    if (retval < 0) {
+        av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
+        return AVERROR(EIO);
+    }
+
+    return 1;
+}
+
+static void bgr_uninit_job(void *opaque, void *job)
+{
+    BgrJob *j = job;
+
+    ni_packet_buffer_free(&j->pkt.data.packet);
+}
+
+static const NIPipelineOps bgr_pipeline_ops = {
+    .submit     = bgr_submit,
+    .collect    = bgr_collect,
+    .uninit_job = bgr_uninit_job,
+    .job_name   = "inference",
+};
+
+/* downscale the frame and queue it for inference */
+static int bgr_queue_frame(AVFilterContext *ctx, AVFrame *in)
 {
-    AVFilterContext *ctx = link->dst;
     NetIntBgrContext *s = ctx->priv;
     int ret;
-    int clean_scale_format = 0;
 
     /* ai roi */
     ni_roi_network_t *network;
     ni_retcode_t retval;
     AiContext *ai_ctx;
     niFrameSurface1_t *downscale_bgr_surface;
-    niFrameSurface1_t *rgba_frame_surface;
-    niFrameSurface1_t *logging_surface;
-    niFrameSurface1_t *logging_surface_out;
-    AVFrame *realout;
+    BgrJob *job;
 
     s->framecount++;
 
-#define CLEAN_SCALE 1
-#define CLEAN_FORMAT 2
-
     av_log(ctx, AV_LOG_DEBUG, "entering %s\n", __func__);
 
     if (!s->initialized) {
@@ -1094,6 +1160,13 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         }
 #endif
 
+        ret = ff_ni_pipeline_alloc(&s->pipeline, &bgr_pipeline_ops, ctx, ctx,
+                                   s->ai_depth, sizeof(BgrJob));
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "failed to create ai pipeline\n");
+            goto fail;
+        }
+
         s->initialized = 1;
     }
 
@@ -1104,11 +1177,17 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     ff_ni_update_benchmark(NULL);
 #endif
 
-    retval  = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_pkt.data.packet,
-                                        &network->raw);
+    job = ff_ni_pipeline_next_job(s->pipeline);
+    if (!job) {
+        ret = AVERROR_BUG;
+        goto fail;
+    }
+
+    retval  = ni_ai_packet_buffer_alloc(&job->pkt.data.packet, &network->raw);
     if (retval != NI_RETCODE_SUCCESS) {
         av_log(ctx, AV_LOG_ERROR, "failed to allocate packet\n");
-        return AVERROR(EAGAIN);
+        ret = AVERROR(EAGAIN);
+        goto fail;
     }
 
     if ((s->skip == 0) || ((s->framecount - 1) % (s->skip + 1) == 0)) {
@@ -1118,83 +1197,64 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                    ai_ctx->api_ctx.session_id, s->framecount);
             s->skip_random_offset = 0;
         }
-        s->skipInference = false;
+        job->infer = 1;
     } else {
-        s->skipInference = true;
+        job->infer = 0;
         av_log(ctx, AV_LOG_DEBUG, "Inference skip, framecount %d\n", s->framecount);
     }
-    //Main Job
-    {
-        if (!s->skipInference) {
-            ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
-                                    &downscale_bgr_surface);
-            if (ret < 0) {
-                av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
-                goto fail;
-            }
-            av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
-                downscale_bgr_surface->ui16FrameIdx);
-        }
 
-        if (!s->skipInference) {
-            /* allocate output buffer */
-            retval = ni_device_alloc_frame(&ai_ctx->api_ctx, 0, 0, 0, 0, 0, 0, 0, 0,
-                                            downscale_bgr_surface->ui32nodeAddress,
-                                            downscale_bgr_surface->ui16FrameIdx,
-                                            NI_DEVICE_TYPE_AI);
-            if (retval != NI_RETCODE_SUCCESS) {
-                av_log(ctx, AV_LOG_ERROR, "failed to alloc hw input frame\n");
-                ret =  AVERROR(ENOMEM);
-                clean_scale_format |= CLEAN_SCALE;
-                goto fail;
-            }
-        }
-        ret = ni_hwframe_convert_format(ctx, s, in, &rgba_frame_surface);
+    if (job->infer) {
+        ret = ni_hwframe_scale(ctx, s, in, network->netw, network->neth,
+                               &downscale_bgr_surface);
         if (ret < 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                    "Error in runnig hwframe for format conversion\n");
-            goto fail;
-        }
-        ret = ni_hwframe_converted_download(ctx, s, rgba_frame_surface);
-        if (ret <= 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                    "Error in downloading hwframe for format conversion\n");
-            clean_scale_format |= CLEAN_FORMAT;
+            av_log(ctx, AV_LOG_ERROR, "Error run hwframe scale\n");
             goto fail;
         }
-        ni_hwframe_buffer_recycle(rgba_frame_surface,
-                                    rgba_frame_surface->device_handle);
-        if (!s->skipInference) {
-            do {
-                retval = ni_device_session_read(
-                    &ai_ctx->api_ctx, &ai_ctx->api_dst_pkt, NI_DEVICE_TYPE_AI);
-                if (retval < 0) {
-                    av_log(ctx, AV_LOG_ERROR, "read hwdesc retval %d\n", retval);
-                    ret = AVERROR(EIO);
-                    clean_scale_format |= CLEAN_SCALE;
-                    goto fail;
-                } else if (retval > 0) {
-                    ret = ni_bgr_process(ctx, &ai_ctx->api_dst_pkt);
-                    if (ret != 0) {
-                        av_log(ctx, AV_LOG_ERROR,
-                                "failed to process tensor\n");
-                        clean_scale_format |= CLEAN_SCALE;
-                        goto fail;
-                    }
-                }
-                ni_usleep(100); //this loop should be in libxcoder side ideally
-            } while (retval == 0);
-            ni_hwframe_buffer_recycle(downscale_bgr_surface,
-                                        downscale_bgr_surface->device_handle);
-        } else { // use the last frame background shape if current frame is skipped
-            ret = ni_bgr_process(ctx, &ai_ctx->api_dst_pkt);
-            if (ret != 0) {
-                av_log(ctx, AV_LOG_ERROR, "failed to process tensor\n");
-                goto fail;
-            }
-        }
+        av_log(ctx, AV_LOG_DEBUG, "filt frame surface frameIdx %d\n",
+               downscale_bgr_surface->ui16FrameIdx);
+
+        /* the scaler reuses its descriptor for the next frame */
+        job->surface = *downscale_bgr_surface;
+    }
+
+    return ff_ni_pipeline_push(s->pipeline, in);
+fail:
+    av_frame_free(&in);
+    return ret;
+}
+
+/* download the frame, apply the mask of a finished job and send it out */
+static int bgr_output_frame(AVFilterContext *ctx, AVFrame *in, BgrJob *job)
+{
+    NetIntBgrContext *s = ctx->priv;
+    int ret;
+    niFrameSurface1_t *rgba_frame_surface;
+    niFrameSurface1_t *logging_surface;
+    niFrameSurface1_t *logging_surface_out;
+    AVFrame *realout;
+
+    ret = ni_hwframe_convert_format(ctx, s, in, &rgba_frame_surface);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR,
+               "Error in runnig hwframe for format conversion\n");
+        goto fail;
+    }
+    ret = ni_hwframe_converted_download(ctx, s, rgba_frame_surface);
+    ni_hwframe_buffer_recycle(rgba_frame_surface,
+                              rgba_frame_surface->device_handle);
+    if (ret <= 0) {
+        av_log(ctx, AV_LOG_ERROR,
+               "Error in downloading hwframe for format conversion\n");
+        goto fail;
+    }
 
+    // use the last frame background shape if current frame is skipped
+    ret = ni_bgr_process(ctx, job->infer ? &job->pkt : NULL);
+    if (ret != 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to process tensor\n");
+        goto fail;
     }
+    ff_ni_pipeline_release(s->pipeline);
 
     //output AVframe created
     ni_bgr_create_output(ctx, in, &realout);
@@ -1206,25 +1266,57 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     //Logging for hwframe tracking
     logging_surface = (niFrameSurface1_t*)in->data[3];
     logging_surface_out = (niFrameSurface1_t*)realout->data[3];
-    av_log(link->dst, AV_LOG_DEBUG,
+    av_log(ctx, AV_LOG_DEBUG,
         "vf_bgr_ni.c:IN trace ui16FrameIdx = [%d] --> out [%d]\n",
         logging_surface->ui16FrameIdx, logging_surface_out->ui16FrameIdx);
 
     av_frame_free(&in);
     return ff_filter_frame(ctx->outputs[0], realout);
 fail:
+    ff_ni_pipeline_release(s->pipeline);
     av_frame_free(&in);
-    if (clean_scale_format & CLEAN_SCALE) {
-        ni_hwframe_buffer_recycle(downscale_bgr_surface,
-                                  downscale_bgr_surface->device_handle);
-    }
-    if (clean_scale_format & CLEAN_FORMAT) {
-        ni_hwframe_buffer_recycle(rgba_frame_surface,
-                                  rgba_frame_surface->device_handle);
-    }
     return ret;
 }
 
+/**
+ * Output the oldest frame if its inference is done.
+ *
+ * @return 1 if a frame was sent, 0 if none was ready, a negative AVERROR
+ */
+static int bgr_output_done(AVFilterContext *ctx, int block)
+{
+    NetIntBgrContext *s = ctx->priv;
+    AVFrame *in;
+    BgrJob *job;
+    int ret;
+
+    ret = ff_ni_pipeline_pop(s->pipeline, &in, (void **)&job, block);
+    if (ret < 0) {
+        ff_ni_pipeline_release(s->pipeline);
+        av_frame_free(&in);
+    }
+    if (ret <= 0)
+        return ret;
+
+    ret = bgr_output_frame(ctx, in, job);
+    return ret < 0 ? ret : 1;
+}
+
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx = link->dst;
+    NetIntBgrContext *s = ctx->priv;
+    int ret;
+
+    ret = bgr_queue_frame(ctx, in);
+
+    /* nothing calls back for the result without activate(), wait for it */
+    while (ret >= 0 && ff_ni_pipeline_pending(s->pipeline))
+        ret = bgr_output_done(ctx, 1);
+
+    return ret < 0 ? ret : 0;
+}
+
 #if IS_FFMPEG_61_AND_ABOVE
 static int activate(AVFilterContext *ctx)
 {
@@ -1239,6 +1331,23 @@ static int activate(AVFilterContext *ctx)
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
+    // Send out finished frames first. Wait for the oldest one only when
+    // nothing else can be done: the pipeline is full or the input ended
+    if (s->pipeline && ff_ni_pipeline_pending(s->pipeline)) {
+        int64_t pts;
+        int status;
+        int block = !ff_ni_pipeline_next_job(s->pipeline) ||
+                    ff_inlink_acknowledge_status(inlink, &status, &pts);
+
+        ret = bgr_output_done(ctx, block);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            ff_filter_set_ready(ctx, 300);
+            return 0;
+        }
+    }
+
     if (ff_inlink_check_available_frame(inlink)) {
         if (s->initialized) {
             hwfc = (AVHWFramesContext *) s->hw_frames_ctx->data;
@@ -1259,7 +1368,7 @@ static int activate(AVFilterContext *ctx)
         if (ret < 0)
             return ret;
 
-        ret = filter_frame(inlink, frame);
+        ret = bgr_queue_frame(ctx, frame);
         if (ret >= 0) {
             ff_filter_set_ready(ctx, 300);
         }
@@ -1283,6 +1392,7 @@ static const AVOption ni_bgr_options[] = {
     { "skip", "frames to skip between inference", OFFSET(skip),    AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
     NI_FILT_OPTION_KEEPALIVE,
     NI_FILT_OPTION_BUFFER_LIMIT,
+    NI_FILT_OPTION_AI_DEPTH,
     { NULL },
 };
 
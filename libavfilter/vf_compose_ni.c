@@ -0,0 +1,861 @@
+/*
+ * Copyright (c) 2023 NETINT
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Composes several layers over a main video in one scaler pass instead of
+ * a chain of ni_quadra_overlay filters, each making its own job and output
+ * frame.
+ *
+ * Opaque layers are stacked together with the main picture by a single
+ * multi-input job. Layers with alpha are first gathered on a transparent
+ * sheet by a multi-input job, and the sheet is overlaid on the main picture.
+ * The sheet stays on the device and is only built again when a layer
+ * changes, so static logos cost one job per frame whatever their number.
+ * Layers are drawn in input order. The sheet cannot blend layers with each
+ * other, so layers with alpha must not overlap; use overlay filters for
+ * those.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "nifilter.h"
+#include "filters.h"
+#include "formats.h"
+#if !IS_FFMPEG_71_AND_ABOVE
+#include "internal.h"
+#else
+#include "libavutil/mem.h"
+#endif
+#include "framesync.h"
+#include "ni_compose.h"
+#include "video.h"
+
+#define MAIN 0
+
+typedef struct NetIntComposeContext {
+    const AVClass *class;
+    int nb_layers;
+    char *layout;
+    int alpha_format;
+    int cache;
+    int shortest;
+
+    NICompose compose;
+    /* the layers the sheet was built from, held so that their surfaces are
+     * not reused while the sheet is compared against them */
+    AVFrame *sheet_layers[NI_COMPOSE_MAX_LAYERS];
+    FFFrameSync fs;
+
+    // The rest of this structure is NETINT HW specific
+
+    enum AVPixelFormat out_format;
+    enum AVPixelFormat layer_format;
+    int layers_have_alpha;
+    AVBufferRef *out_frames_ref;
+    NIPoolUsage *pool_usage;
+
+    /* stacks the main picture and the layers, or overlays the sheet */
+    ni_session_context_t api_ctx;
+    ni_session_data_io_t api_dst_frame;
+
+    ni_session_context_t sheet_api_ctx;
+    ni_session_data_io_t sheet_dst_frame;
+    int sheet_valid;
+
+    int initialized;
+    int session_opened;
+    int sheet_session_opened;
+    int keep_alive_timeout;
+    int buffer_limit;
+
+    ni_frame_config_t frame_in[NI_COMPOSE_MAX_LAYERS + 1];
+    ni_frame_config_t frame_out;
+} NetIntComposeContext;
+
+static const enum AVPixelFormat alpha_pix_fmts[] = {
+    AV_PIX_FMT_ARGB, AV_PIX_FMT_ABGR, AV_PIX_FMT_RGBA,
+    AV_PIX_FMT_BGRA, AV_PIX_FMT_NONE
+};
+
+static int process_frame(FFFrameSync *fs);
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] =
+        {AV_PIX_FMT_NI_QUAD, AV_PIX_FMT_NONE};
+    AVFilterFormats *formats;
+
+    formats = ff_make_format_list(pix_fmts);
+
+    if (!formats)
+        return AVERROR(ENOMEM);
+
+    return ff_set_common_formats(ctx, formats);
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    NetIntComposeContext *s = ctx->priv;
+    int i, ret;
+
+    if (!s->layout) {
+        if (s->nb_layers > 1) {
+            av_log(ctx, AV_LOG_ERROR, "No layout specified.\n");
+            return AVERROR(EINVAL);
+        }
+        s->layout = av_strdup("0_0");
+        if (!s->layout)
+            return AVERROR(ENOMEM);
+    }
+
+    if (s->cache) {
+        for (i = 0; i < s->nb_layers; i++) {
+            s->sheet_layers[i] = av_frame_alloc();
+            if (!s->sheet_layers[i])
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    for (i = 0; i <= s->nb_layers; i++) {
+        AVFilterPad pad = { 0 };
+
+        pad.type = AVMEDIA_TYPE_VIDEO;
+        pad.name = i == MAIN ? av_strdup("main") : av_asprintf("layer%d", i - 1);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+#if (LIBAVFILTER_VERSION_MAJOR >= 8)
+        if ((ret = ff_append_inpad(ctx, &pad)) < 0) {
+#else
+        if ((ret = ff_insert_inpad(ctx, i, &pad)) < 0) {
+#endif
+            av_freep(&pad.name);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    NetIntComposeContext *s = ctx->priv;
+    int i;
+
+    ff_ni_compose_report(&s->compose, ctx);
+
+    ff_framesync_uninit(&s->fs);
+
+    for (i = 0; i < ctx->nb_inputs; i++)
+        av_freep(&ctx->input_pads[i].name);
+
+    for (i = 0; i < NI_COMPOSE_MAX_LAYERS; i++)
+        av_frame_free(&s->sheet_layers[i]);
+
+    if (s->api_dst_frame.data.frame.p_buffer)
+        ni_frame_buffer_free(&s->api_dst_frame.data.frame);
+
+    if (s->sheet_dst_frame.data.frame.p_buffer)
+        ni_frame_buffer_free(&s->sheet_dst_frame.data.frame);
+
+    if (s->session_opened) {
+        /* Close operation will free the device frames */
+        ni_device_session_close(&s->api_ctx, 1, NI_DEVICE_TYPE_SCALER);
+        ni_device_session_context_clear(&s->api_ctx);
+    }
+
+    if (s->sheet_session_opened) {
+        ni_device_session_close(&s->sheet_api_ctx, 1, NI_DEVICE_TYPE_SCALER);
+        ni_device_session_context_clear(&s->sheet_api_ctx);
+    }
+
+    av_buffer_unref(&s->out_frames_ref);
+
+    ff_ni_pool_usage_report(s->pool_usage, ctx);
+    ff_ni_pool_usage_unref(&s->pool_usage);
+}
+
+static AVHWFramesContext *input_frames_ctx(AVFilterContext *ctx, int i)
+{
+#if IS_FFMPEG_71_AND_ABOVE
+    FilterLink *li = ff_filter_link(ctx->inputs[i]);
+    if (li->hw_frames_ctx == NULL) {
+        av_log(ctx, AV_LOG_ERROR, "No hw context provided on input\n");
+        return NULL;
+    }
+    return (AVHWFramesContext *)li->hw_frames_ctx->data;
+#else
+    if (ctx->inputs[i]->hw_frames_ctx == NULL) {
+        av_log(ctx, AV_LOG_ERROR, "No hw context provided on input\n");
+        return NULL;
+    }
+    return (AVHWFramesContext *)ctx->inputs[i]->hw_frames_ctx->data;
+#endif
+}
+
+static int check_format(AVFilterContext *ctx, enum AVPixelFormat format)
+{
+    if (format == AV_PIX_FMT_BGRP) {
+        av_log(ctx, AV_LOG_ERROR, "bgrp not supported\n");
+        return AVERROR(EINVAL);
+    }
+    if (format == AV_PIX_FMT_NI_QUAD_8_TILE_4X4 ||
+        format == AV_PIX_FMT_NI_QUAD_10_TILE_4X4) {
+        av_log(ctx, AV_LOG_ERROR, "tile4x4 not supported\n");
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    NetIntComposeContext *s = ctx->priv;
+    AVHWFramesContext *main_frames_ctx, *in_frames_ctx, *out_frames_ctx;
+    int w[NI_COMPOSE_MAX_LAYERS], h[NI_COMPOSE_MAX_LAYERS];
+    FFFrameSyncIn *in;
+    int i, ret;
+
+    main_frames_ctx = input_frames_ctx(ctx, MAIN);
+    if (!main_frames_ctx)
+        return AVERROR(EINVAL);
+    if ((ret = check_format(ctx, main_frames_ctx->sw_format)) < 0)
+        return ret;
+
+    for (i = 0; i < s->nb_layers; i++) {
+        in_frames_ctx = input_frames_ctx(ctx, i + 1);
+        if (!in_frames_ctx)
+            return AVERROR(EINVAL);
+        if ((ret = check_format(ctx, in_frames_ctx->sw_format)) < 0)
+            return ret;
+
+        if (i && in_frames_ctx->sw_format != s->layer_format) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "All layers must have the same pixel format!!!\n");
+            return AVERROR(EINVAL);
+        }
+        s->layer_format = in_frames_ctx->sw_format;
+
+        w[i] = ctx->inputs[i + 1]->w;
+        h[i] = ctx->inputs[i + 1]->h;
+    }
+
+    s->layers_have_alpha = ff_fmt_is_in(s->layer_format, alpha_pix_fmts);
+    if (!s->layers_have_alpha && s->layer_format != main_frames_ctx->sw_format) {
+        av_log(ctx, AV_LOG_ERROR,
+               "Layers without alpha must have the pixel format of the main input\n");
+        return AVERROR(EINVAL);
+    }
+
+    ret = ff_ni_compose_layout(&s->compose, s->layout, s->nb_layers,
+                               ctx->inputs[MAIN]->w, ctx->inputs[MAIN]->h,
+                               w, h, ctx);
+    if (ret < 0)
+        return ret;
+
+    if (s->layers_have_alpha && s->compose.overlap) {
+        av_log(ctx, AV_LOG_ERROR,
+               "Layer %d overlaps an earlier one, layers with alpha cannot be "
+               "blended with each other\n", s->compose.overlap);
+        return AVERROR(EINVAL);
+    }
+
+    av_log(ctx, AV_LOG_VERBOSE, "%d %s layers, %s\n", s->nb_layers,
+           av_get_pix_fmt_name(s->layer_format),
+           s->layers_have_alpha ? "gathered on a sheet" : "stacked with the main picture");
+
+    outlink->w = ctx->inputs[MAIN]->w;
+    outlink->h = ctx->inputs[MAIN]->h;
+    outlink->sample_aspect_ratio = ctx->inputs[MAIN]->sample_aspect_ratio;
+#if IS_FFMPEG_71_AND_ABOVE
+    FilterLink *li = ff_filter_link(ctx->inputs[MAIN]);
+    FilterLink *lo = ff_filter_link(outlink);
+    lo->frame_rate = li->frame_rate;
+#else
+    outlink->frame_rate = ctx->inputs[MAIN]->frame_rate;
+#endif
+
+    if ((ret = ff_framesync_init(&s->fs, ctx, ctx->nb_inputs)) < 0)
+        return ret;
+
+    in = s->fs.in;
+    s->fs.opaque = s;
+    s->fs.on_event = process_frame;
+
+    /* The output follows the main input, the layers repeat their last frame */
+    for (i = 0; i < ctx->nb_inputs; i++) {
+        in[i].time_base = ctx->inputs[i]->time_base;
+        in[i].sync      = i == MAIN ? 2 : 1;
+        in[i].before    = EXT_STOP;
+        in[i].after     = (i == MAIN || s->shortest) ? EXT_STOP : EXT_INFINITY;
+    }
+
+    ret = ff_framesync_configure(&s->fs);
+    if (ret < 0)
+        return ret;
+    outlink->time_base = s->fs.time_base;
+
+    s->out_frames_ref = av_hwframe_ctx_alloc(main_frames_ctx->device_ref);
+    if (!s->out_frames_ref)
+        return AVERROR(ENOMEM);
+
+    out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref->data;
+
+    out_frames_ctx->format    = AV_PIX_FMT_NI_QUAD;
+    out_frames_ctx->width     = outlink->w;
+    out_frames_ctx->height    = outlink->h;
+    out_frames_ctx->sw_format = main_frames_ctx->sw_format;
+    out_frames_ctx->initial_pool_size =
+        NI_OVERLAY_ID; // Repurposed as identity code
+
+    s->out_format = out_frames_ctx->sw_format;
+
+    av_hwframe_ctx_init(s->out_frames_ref);
+
+#if IS_FFMPEG_71_AND_ABOVE
+    av_buffer_unref(&lo->hw_frames_ctx);
+    lo->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+
+    if (!lo->hw_frames_ctx)
+        return AVERROR(ENOMEM);
+#else
+    av_buffer_unref(&outlink->hw_frames_ctx);
+    outlink->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+
+    if (!outlink->hw_frames_ctx)
+        return AVERROR(ENOMEM);
+#endif
+    return 0;
+}
+
+static int init_out_pool(AVFilterContext *ctx)
+{
+    NetIntComposeContext *s = ctx->priv;
+    AVHWFramesContext *out_frames_ctx;
+    int pool_size = DEFAULT_NI_FILTER_POOL_SIZE;
+
+    out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref->data;
+
+    pool_size = ff_ni_pool_plan(ctx, pool_size);
+
+    ff_ni_pool_usage_unref(&s->pool_usage);
+    s->pool_usage = ff_ni_pool_usage_alloc(pool_size);
+    if (!s->pool_usage) {
+        return AVERROR(ENOMEM);
+    }
+
+#if IS_FFMPEG_61_AND_ABOVE
+    s->buffer_limit = 1;
+#endif
+    /* Create frame pool on device */
+    return ff_ni_build_frame_pool(&s->api_ctx, out_frames_ctx->width,
+                                  out_frames_ctx->height,
+                                  s->out_format, pool_size,
+                                  s->buffer_limit);
+}
+
+static int open_session(AVFilterContext *ctx, ni_session_context_t *api_ctx,
+                        AVHWFramesContext *frames_ctx, int cardno,
+                        int opcode, int nb_inputs)
+{
+    NetIntComposeContext *s = ctx->priv;
+    AVNIDeviceContext *pAVNIDevCtx = frames_ctx->device_ctx->hwctx;
+    ni_retcode_t retcode;
+
+    retcode = ni_device_session_context_init(api_ctx);
+    if (retcode < 0) {
+        av_log(ctx, AV_LOG_ERROR,
+               "ni compose filter session context init failure\n");
+        return AVERROR_EXTERNAL;
+    }
+
+    api_ctx->device_handle      = pAVNIDevCtx->cards[cardno];
+    api_ctx->blk_io_handle      = pAVNIDevCtx->cards[cardno];
+    api_ctx->hw_id              = cardno;
+    api_ctx->device_type        = NI_DEVICE_TYPE_SCALER;
+    api_ctx->scaler_operation   = opcode;
+    api_ctx->keep_alive_timeout = s->keep_alive_timeout;
+
+    retcode = ni_device_session_open(api_ctx, NI_DEVICE_TYPE_SCALER);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "Can't open device session on card %d\n",
+               cardno);
+        ni_device_session_close(api_ctx, 1, NI_DEVICE_TYPE_SCALER);
+        ni_device_session_context_clear(api_ctx);
+        return AVERROR_EXTERNAL;
+    }
+
+    if (opcode == NI_SCALER_OPCODE_STACK) {
+        ni_scaler_params_t params = { 0 };
+
+        params.nb_inputs = nb_inputs;
+        retcode = ni_scaler_set_params(api_ctx, &params);
+        if (retcode < 0) {
+            ni_device_session_close(api_ctx, 1, NI_DEVICE_TYPE_SCALER);
+            ni_device_session_context_clear(api_ctx);
+            return AVERROR_EXTERNAL;
+        }
+    }
+
+    return 0;
+}
+
+static int init_sessions(AVFilterContext *ctx, AVFrame **in)
+{
+    NetIntComposeContext *s = ctx->priv;
+    AVHWFramesContext *main_frames_ctx, *out_frames_ctx;
+    AVNIFramesContext *out_ni_ctx;
+    int i, cardno, ret;
+
+    cardno = ni_get_cardno(in[MAIN]);
+    for (i = 1; i < ctx->nb_inputs; i++) {
+        if (ni_get_cardno(in[i]) != cardno) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "All inputs must be on the same Quadra device\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
+    main_frames_ctx = (AVHWFramesContext *)in[MAIN]->hw_frames_ctx->data;
+
+    ret = open_session(ctx, &s->api_ctx, main_frames_ctx, cardno,
+                       s->layers_have_alpha ? NI_SCALER_OPCODE_OVERLAY :
+                                              NI_SCALER_OPCODE_STACK,
+                       ctx->nb_inputs);
+    if (ret < 0)
+        return ret;
+    s->session_opened = 1;
+
+    ret = init_out_pool(ctx);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR,
+               "Internal output allocation failed rc = %d\n", ret);
+        return ret;
+    }
+
+    out_frames_ctx = (AVHWFramesContext *)s->out_frames_ref->data;
+    out_ni_ctx = (AVNIFramesContext *)out_frames_ctx->hwctx;
+    ni_cpy_hwframe_ctx(main_frames_ctx, out_frames_ctx);
+    ni_device_session_copy(&s->api_ctx, &out_ni_ctx->api_ctx);
+
+    if (s->layers_have_alpha) {
+        ret = open_session(ctx, &s->sheet_api_ctx, main_frames_ctx, cardno,
+                           NI_SCALER_OPCODE_STACK, s->nb_layers);
+        if (ret < 0)
+            return ret;
+        s->sheet_session_opened = 1;
+
+        /* A single sheet, the previous one is given back before a rebuild */
+        ret = ff_ni_build_frame_pool(&s->sheet_api_ctx, s->compose.sheet_w,
+                                     s->compose.sheet_h, s->layer_format, 1, 0);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "Sheet allocation failed rc = %d\n", ret);
+            return ret;
+        }
+    }
+
+    s->initialized = 1;
+    return 0;
+}
+
+static void set_layer_config(ni_frame_config_t *cfg, AVFrame *frame,
+                             int scaler_format,
+                             int x, int y, int w, int h)
+{
+    niFrameSurface1_t *surface = (niFrameSurface1_t *)frame->data[3];
+
+    cfg->picture_width    = FFALIGN(frame->width, 2);
+    cfg->picture_height   = FFALIGN(frame->height, 2);
+    cfg->picture_format   = scaler_format;
+    cfg->session_id       = surface->ui16session_ID;
+    cfg->output_index     = surface->output_idx;
+    cfg->frame_index      = surface->ui16FrameIdx;
+
+    // Where to place the input into the output
+    cfg->rectangle_x      = x;
+    cfg->rectangle_y      = y;
+    cfg->rectangle_width  = w;
+    cfg->rectangle_height = h;
+}
+
+static void recycle_sheet(NetIntComposeContext *s)
+{
+    if (!s->sheet_valid)
+        return;
+
+    ni_hwframe_buffer_recycle((niFrameSurface1_t *)
+                              s->sheet_dst_frame.data.frame.p_data[3],
+                              (int32_t)s->sheet_api_ctx.device_handle);
+    s->sheet_valid = 0;
+}
+
+/* Gather the layers on a transparent sheet with one multi-input job */
+static int build_sheet(AVFilterContext *ctx, AVFrame **layers)
+{
+    NetIntComposeContext *s = ctx->priv;
+    NICompose *c = &s->compose;
+    niFrameSurface1_t *sheet_surface;
+    ni_retcode_t retcode;
+    int i, ret, scaler_format;
+
+    recycle_sheet(s);
+
+    retcode = ni_frame_buffer_alloc_hwenc(&s->sheet_dst_frame.data.frame,
+                                          c->sheet_w, c->sheet_h, 0);
+    if (retcode != NI_RETCODE_SUCCESS)
+        return AVERROR(ENOMEM);
+
+    retcode = ni_device_session_read_hwdesc(&s->sheet_api_ctx,
+                                            &s->sheet_dst_frame,
+                                            NI_DEVICE_TYPE_SCALER);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "Can't acquire sheet frame %d\n", retcode);
+        return AVERROR(ENOMEM);
+    }
+    s->sheet_valid = 1;
+    sheet_surface = (niFrameSurface1_t *)s->sheet_dst_frame.data.frame.p_data[3];
+
+    scaler_format = ff_ni_ffmpeg_to_gc620_pix_fmt(s->layer_format);
+
+    for (i = 0; i < c->nb_layers; i++) {
+        const NIComposeLayer *l = &c->layers[i];
+
+        set_layer_config(&s->frame_in[i], layers[i], scaler_format,
+                         l->x - c->sheet_x, l->y - c->sheet_y, l->w, l->h);
+    }
+
+    s->frame_out.picture_width  = c->sheet_w;
+    s->frame_out.picture_height = c->sheet_h;
+    s->frame_out.picture_format = scaler_format;
+    s->frame_out.frame_index    = sheet_surface->ui16FrameIdx;
+    s->frame_out.options        = NI_SCALER_FLAG_IO | NI_SCALER_FLAG_FCE;
+    s->frame_out.rgba_color     = 0; // transparent between the layers
+
+    retcode = ni_device_multi_config_frame(&s->sheet_api_ctx, s->frame_in,
+                                           c->nb_layers, &s->frame_out);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "Can't build the sheet %d\n", retcode);
+        recycle_sheet(s);
+        ff_ni_compose_invalidate(c);
+        return AVERROR(EIO);
+    }
+
+    if (s->cache) {
+        for (i = 0; i < c->nb_layers; i++) {
+            av_frame_unref(s->sheet_layers[i]);
+            ret = av_frame_ref(s->sheet_layers[i], layers[i]);
+            if (ret < 0) {
+                ff_ni_compose_invalidate(c);
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Overlay the sheet on the main picture into a new output frame */
+static int overlay_sheet(AVFilterContext *ctx, AVFrame *frame)
+{
+    NetIntComposeContext *s = ctx->priv;
+    NICompose *c = &s->compose;
+    niFrameSurface1_t *main_surface, *sheet_surface;
+    ni_retcode_t retcode;
+    int flags;
+
+    main_surface  = (niFrameSurface1_t *)frame->data[3];
+    sheet_surface = (niFrameSurface1_t *)s->sheet_dst_frame.data.frame.p_data[3];
+
+    retcode = ni_device_alloc_frame(&s->api_ctx,
+                                    c->sheet_w,
+                                    c->sheet_h,
+                                    ff_ni_ffmpeg_to_gc620_pix_fmt(s->layer_format),
+                                    0,
+                                    c->sheet_w,
+                                    c->sheet_h,
+                                    c->sheet_x,
+                                    c->sheet_y,
+                                    0,
+                                    sheet_surface->ui16FrameIdx,
+                                    NI_DEVICE_TYPE_SCALER);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_DEBUG, "Can't assign frame for sheet input %d\n",
+               retcode);
+        return AVERROR(ENOMEM);
+    }
+
+    flags = (s->alpha_format ? NI_SCALER_FLAG_PA : 0) | NI_SCALER_FLAG_IO;
+    flags |= main_surface->encoding_type == 2 ? NI_SCALER_FLAG_CMP : 0;
+    retcode = ni_device_alloc_frame(&s->api_ctx,
+                                    FFALIGN(frame->width, 2),
+                                    FFALIGN(frame->height, 2),
+                                    ff_ni_ffmpeg_to_gc620_pix_fmt(s->out_format),
+                                    flags,
+                                    FFALIGN(frame->width, 2),
+                                    FFALIGN(frame->height, 2),
+                                    0,                              // x
+                                    0,                              // y
+                                    main_surface->ui32nodeAddress,
+                                    main_surface->ui16FrameIdx,
+                                    NI_DEVICE_TYPE_SCALER);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_DEBUG, "Can't allocate frame for output %d\n",
+               retcode);
+        return AVERROR(ENOMEM);
+    }
+
+    retcode = ni_device_session_read_hwdesc(&s->api_ctx, &s->api_dst_frame,
+                                            NI_DEVICE_TYPE_SCALER);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "Can't acquire output frame %d\n", retcode);
+        return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+/* Stack the opaque layers over the main picture with one multi-input job */
+static int stack_layers(AVFilterContext *ctx, AVFrame **in)
+{
+    NetIntComposeContext *s = ctx->priv;
+    NICompose *c = &s->compose;
+    AVFilterLink *outlink = ctx->outputs[0];
+    niFrameSurface1_t *out_surface;
+    ni_retcode_t retcode;
+    int i, scaler_format = ff_ni_ffmpeg_to_gc620_pix_fmt(s->out_format);
+
+    /* Acquire the output frame from the pool first, the job writes into it */
+    retcode = ni_device_session_read_hwdesc(&s->api_ctx, &s->api_dst_frame,
+                                            NI_DEVICE_TYPE_SCALER);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "Can't acquire output frame %d\n", retcode);
+        return AVERROR(ENOMEM);
+    }
+    out_surface = (niFrameSurface1_t *)s->api_dst_frame.data.frame.p_data[3];
+
+    set_layer_config(&s->frame_in[0], in[MAIN], scaler_format, 0, 0,
+                     FFALIGN(in[MAIN]->width, 2), FFALIGN(in[MAIN]->height, 2));
+    for (i = 0; i < c->nb_layers; i++) {
+        const NIComposeLayer *l = &c->layers[i];
+
+        set_layer_config(&s->frame_in[i + 1], in[i + 1], scaler_format,
+                         l->x, l->y, l->w, l->h);
+    }
+
+    s->frame_out.picture_width  = FFALIGN(outlink->w, 2);
+    s->frame_out.picture_height = FFALIGN(outlink->h, 2);
+    s->frame_out.picture_format = scaler_format;
+    s->frame_out.frame_index    = out_surface->ui16FrameIdx;
+    s->frame_out.options        = NI_SCALER_FLAG_IO;
+    s->frame_out.rgba_color     = 0;
+
+    retcode = ni_device_multi_config_frame(&s->api_ctx, s->frame_in,
+                                           c->nb_layers + 1, &s->frame_out);
+    if (retcode != NI_RETCODE_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "Can't compose the layers %d\n", retcode);
+        ni_hwframe_buffer_recycle(out_surface, (int32_t)s->api_ctx.device_handle);
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+static int process_frame(FFFrameSync *fs)
+{
+    AVFilterContext *ctx = fs->parent;
+    AVFilterLink *outlink = ctx->outputs[0];
+    NetIntComposeContext *s = fs->opaque;
+    NICompose *c = &s->compose;
+    AVFrame *in[NI_COMPOSE_MAX_LAYERS + 1];
+    AVFrame *out = NULL;
+    niFrameSurface1_t *frame_surface, *new_frame_surface;
+    int i, ret, stale = 0;
+
+    for (i = 0; i < ctx->nb_inputs; i++) {
+        if ((ret = ff_framesync_get_frame(fs, i, &in[i], 0)) < 0)
+            return ret;
+        if (!in[i] || !in[i]->data[3])
+            return AVERROR(EINVAL);
+    }
+
+    if (!s->initialized) {
+        ret = init_sessions(ctx, in);
+        if (ret < 0)
+            return ret;
+    }
+
+    out = av_frame_alloc();
+    if (!out)
+        return AVERROR(ENOMEM);
+
+    av_frame_copy_props(out, in[MAIN]);
+
+    out->width  = outlink->w;
+    out->height = outlink->h;
+    out->format = AV_PIX_FMT_NI_QUAD;
+
+    /* Quadra 2D engine always outputs limited color range */
+    out->color_range = AVCOL_RANGE_MPEG;
+
+    /* Reference the new hw frames context */
+    out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref);
+
+    out->data[3] = av_malloc(sizeof(niFrameSurface1_t));
+    if (!out->hw_frames_ctx || !out->data[3]) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* Copy the frame surface from the incoming frame */
+    memcpy(out->data[3], in[MAIN]->data[3], sizeof(niFrameSurface1_t));
+
+#ifdef NI_MEASURE_LATENCY
+    ff_ni_update_benchmark(NULL);
+#endif
+
+    ret = ni_frame_buffer_alloc_hwenc(&s->api_dst_frame.data.frame,
+                                      outlink->w, outlink->h, 0);
+    if (ret != NI_RETCODE_SUCCESS) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if (s->layers_have_alpha) {
+        for (i = 0; i < c->nb_layers; i++) {
+            frame_surface = (niFrameSurface1_t *)in[i + 1]->data[3];
+            stale |= ff_ni_compose_update(c, i, frame_surface->ui16session_ID,
+                                          frame_surface->ui16FrameIdx);
+        }
+        stale |= !s->cache || !s->sheet_valid;
+
+        if (stale && (ret = build_sheet(ctx, in + 1)) < 0)
+            goto fail;
+        ret = overlay_sheet(ctx, in[MAIN]);
+    } else {
+        ret = stack_layers(ctx, in);
+    }
+    if (ret < 0)
+        goto fail;
+
+    ff_ni_compose_count(c, 1 + stale, stale);
+    av_log(ctx, AV_LOG_DEBUG, "frame %"PRIu64": %d scaler jobs%s\n",
+           c->frames, 1 + stale,
+           s->layers_have_alpha && !stale ? ", sheet reused" : "");
+
+#ifdef NI_MEASURE_LATENCY
+    ff_ni_update_benchmark("ni_quadra_compose");
+#endif
+
+    frame_surface = (niFrameSurface1_t *)out->data[3];
+    new_frame_surface = (niFrameSurface1_t *)s->api_dst_frame.data.frame.p_data[3];
+    frame_surface->ui16FrameIdx   = new_frame_surface->ui16FrameIdx;
+    frame_surface->ui16session_ID = new_frame_surface->ui16session_ID;
+    frame_surface->device_handle  = new_frame_surface->device_handle;
+    frame_surface->output_idx     = new_frame_surface->output_idx;
+    frame_surface->src_cpu        = new_frame_surface->src_cpu;
+    frame_surface->dma_buf_fd     = 0;
+
+    ff_ni_set_bit_depth_and_encoding_type(&frame_surface->bit_depth,
+                                          &frame_surface->encoding_type,
+                                          s->out_format);
+
+    /* Remove ni-split specific assets */
+    frame_surface->ui32nodeAddress = 0;
+
+    frame_surface->ui16width  = out->width;
+    frame_surface->ui16height = out->height;
+
+    out->pts = av_rescale_q(fs->pts, fs->time_base, outlink->time_base);
+
+    out->buf[0] = av_buffer_create(out->data[3], sizeof(niFrameSurface1_t),
+                                   ff_ni_frame_free, s->pool_usage, 0);
+    if (!out->buf[0]) {
+        ni_hwframe_buffer_recycle(frame_surface, frame_surface->device_handle);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    ff_ni_pool_usage_acquire(s->pool_usage);
+
+    return ff_filter_frame(outlink, out);
+
+fail:
+    if (out && !out->buf[0])
+        av_freep(&out->data[3]);
+    av_frame_free(&out);
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    NetIntComposeContext *s = ctx->priv;
+    return ff_framesync_activate(&s->fs);
+}
+
+#define OFFSET(x) offsetof(NetIntComposeContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM)
+
+static const AVOption ni_compose_options[] = {
+    { "layers",   "set number of layers",            OFFSET(nb_layers),     AV_OPT_TYPE_INT,    {.i64=1},    1, NI_COMPOSE_MAX_LAYERS, .flags = FLAGS },
+    { "layout",   "set the layer positions, x_y|x_y...", OFFSET(layout),    AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, .flags = FLAGS },
+    { "alpha",    "alpha format",                    OFFSET(alpha_format),  AV_OPT_TYPE_INT,    {.i64=0},    0, 1, .flags = FLAGS, .unit = "alpha_format" },
+        { "straight",      "", 0, AV_OPT_TYPE_CONST, {.i64 = 0}, .flags = FLAGS, .unit = "alpha_format" },
+        { "premultiplied", "", 0, AV_OPT_TYPE_CONST, {.i64 = 1}, .flags = FLAGS, .unit = "alpha_format" },
+    { "cache",    "reuse the sheet while the layers do not change", OFFSET(cache), AV_OPT_TYPE_BOOL, {.i64=1}, 0, 1, .flags = FLAGS },
+    { "shortest", "force termination when the shortest input terminates", OFFSET(shortest), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, .flags = FLAGS },
+    NI_FILT_OPTION_KEEPALIVE,
+    NI_FILT_OPTION_BUFFER_LIMIT,
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(ni_compose);
+
+static const AVFilterPad outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_output,
+    },
+#if (LIBAVFILTER_VERSION_MAJOR < 8)
+    { NULL }
+#endif
+};
+
+AVFilter ff_vf_compose_ni_quadra = {
+    .name          = "ni_quadra_compose",
+    .description   = NULL_IF_CONFIG_SMALL("NETINT Quadra compose layers over a video in one scaler pass v" NI_XCODER_REVISION),
+    .priv_size     = sizeof(NetIntComposeContext),
+    .priv_class    = &ni_compose_class,
+    .init          = init,
+    .uninit        = uninit,
+    .activate      = activate,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags_internal= FF_FILTER_FLAG_HWFRAME_AWARE,
+#if (LIBAVFILTER_VERSION_MAJOR >= 8)
+    FILTER_OUTPUTS(outputs),
+    FILTER_QUERY_FUNC(query_formats),
+#else
+    .outputs       = outputs,
+    .query_formats = query_formats,
+#endif
+};
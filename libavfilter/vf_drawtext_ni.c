@@ -153,6 +153,30 @@ enum expansion_mode {
     EXP_STRFTIME,
 };
 
+/**
+ * Area of the canvas touched by a text, as [x0, x1) x [y0, y1).
+ */
+typedef struct TextRect {
+    int x0, y0;
+    int x1, y1;
+} TextRect;
+
+/**
+ * Everything besides the expanded string that decides how one text is
+ * rendered. Compared bytewise against the previous frame, so it must be
+ * zeroed before it is filled in.
+ */
+typedef struct TextRenderKey {
+    unsigned int fontsize;
+    int x, y;
+    int box_w, box_h;
+    int bb_top, bb_right, bb_bottom, bb_left;
+    FFDrawColor fontcolor;
+    FFDrawColor shadowcolor;
+    FFDrawColor bordercolor;
+    FFDrawColor boxcolor;
+} TextRenderKey;
+
 typedef struct NetIntDrawTextContext {
     const AVClass *class;
     int exp_mode;                   ///< expansion mode to use for the text
@@ -163,18 +187,22 @@ typedef struct NetIntDrawTextContext {
 #endif
     uint8_t *fontfile[MAX_TEXT_NUM];///< font to be used
     uint8_t *text[MAX_TEXT_NUM];    ///< text to be drawn
-    uint8_t *text_last_updated[MAX_TEXT_NUM];
+    uint8_t *text_last_updated[MAX_TEXT_NUM]; ///< expanded text currently drawn on the canvas
+    TextRenderKey text_key[MAX_TEXT_NUM];     ///< render parameters of the drawn text
+    TextRect text_rect[MAX_TEXT_NUM];         ///< canvas area covered by the drawn text
+    int text_drawn[MAX_TEXT_NUM];             ///< text_last_updated/key/rect are valid
+    int canvas_w, canvas_h;         ///< size the cached canvas content was drawn for
     AVBPrint expanded_text;         ///< used to contain the expanded text
     uint8_t *fontcolor_expr[MAX_TEXT_NUM];        ///< fontcolor expression to evaluate
     AVBPrint expanded_fontcolor;    ///< used to contain the expanded fontcolor spec
     int ft_load_flags;              ///< flags used for loading fonts, see FT_LOAD_*
-    FT_Vector *positions;           ///< positions for each element in the text
-    size_t nb_positions;            ///< number of elements of positions array
+    FT_Vector *positions[MAX_TEXT_NUM];       ///< positions for each element in the text
+    struct Glyph **layout[MAX_TEXT_NUM];      ///< glyph drawn for each element, NULL if none
+    size_t nb_positions[MAX_TEXT_NUM];        ///< number of elements allocated in positions/layout
+    int text_len[MAX_TEXT_NUM];               ///< number of elements laid out in positions/layout
     char *textfile;                 ///< file with text to be drawn
     int x[MAX_TEXT_NUM];            ///< x position to start drawing one text
     int y[MAX_TEXT_NUM];            ///< y position to start drawing one text
-    int x_bak[MAX_TEXT_NUM];        ///< x position of last uploaded overlay frame
-    int y_bak[MAX_TEXT_NUM];        ///< y position of last uploaded overlay frame
     int x_start;                    ///< x position for text canvas start in one frame
     int y_start;                    ///< y position for text canvas start in one frame
     int x_end;                      ///< x position for text canvas end in one frame
@@ -209,7 +237,7 @@ typedef struct NetIntDrawTextContext {
     FT_Library library;             ///< freetype font library handle
     FT_Face face[MAX_TEXT_NUM];     ///< freetype font face handle
     FT_Stroker stroker;             ///< freetype stroker handle
-    struct AVTreeNode *glyphs;      ///< rendered glyphs, stored using the UTF-32 char code
+    struct AVTreeNode *glyphs;      ///< rendered glyphs, stored using the text index, size and UTF-32 char code
     char *x_expr[MAX_TEXT_NUM];     ///< expression for x position
     char *y_expr[MAX_TEXT_NUM];     ///< expression for y position
     AVExpr *x_pexpr[MAX_TEXT_NUM];  //< parsed expressions for x
@@ -695,6 +723,7 @@ typedef struct Glyph {
     FT_Glyph border_glyph;
     uint32_t code;
     unsigned int fontsize;
+    int font;                ///< index of the text whose face rendered the glyph
     FT_Bitmap bitmap; ///< array holding bitmaps of font
     FT_Bitmap border_bitmap; ///< array holding bitmaps of font border
     FT_BBox bbox;
@@ -710,8 +739,9 @@ static int glyph_cmp(const void *key, const void *b)
 
     if (diff != 0)
         return diff > 0 ? 1 : -1;
-    else
+    if (a->fontsize != bb->fontsize)
         return FFDIFFSIGN((int64_t)a->fontsize, (int64_t)bb->fontsize);
+    return FFDIFFSIGN(a->font, bb->font);
 }
 
 /**
@@ -725,13 +755,10 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code, in
     struct AVTreeNode *node = NULL;
     int ret;
 
-    /* load glyph into s->face->glyph */
-    if (FT_Load_Char(s->face[index], code, s->ft_load_flags))
-        return AVERROR(EINVAL);
-
     /* if glyph has already insert into s->glyphs, return directly */
     dummy.code = code;
     dummy.fontsize = s->fontsize[index];
+    dummy.font = index;
     glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
     if (glyph) {
         if (glyph_ptr)
@@ -739,6 +766,10 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code, in
         return 0;
     }
 
+    /* load glyph into s->face->glyph */
+    if (FT_Load_Char(s->face[index], code, s->ft_load_flags))
+        return AVERROR(EINVAL);
+
     glyph = av_mallocz(sizeof(*glyph));
     if (!glyph) {
         ret = AVERROR(ENOMEM);
@@ -746,6 +777,7 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code, in
     }
     glyph->code  = code;
     glyph->fontsize = s->fontsize[index];
+    glyph->font = index;
 
     if (FT_Get_Glyph(s->face[index]->glyph, &glyph->glyph)) {
         ret = AVERROR(EINVAL);
@@ -1300,11 +1332,9 @@ static av_cold int init(AVFilterContext *ctx)
 
         s->fontsize[i] = 0;
     }
-    for (i = 0; i < MAX_TEXT_NUM; i++) {
-        s->text_last_updated[0] = NULL;
-        s->x_bak[i] = 0;
-        s->y_bak[i] = 0;
-    }
+    for (i = 0; i < MAX_TEXT_NUM; i++)
+        s->text_drawn[i] = 0;
+    s->canvas_w = s->canvas_h = 0;
     s->default_fontsize = 16;
     s->upload_drawtext_frame = 1;
     s->keep_overlay = NULL;
@@ -1450,15 +1480,17 @@ static av_cold void uninit(AVFilterContext *ctx)
         av_expr_free(s->fontsize_pexpr[i]);
         av_free(s->text_last_updated[i]);
         s->text_last_updated[i] = NULL;
+        s->text_drawn[i] = 0;
+
+        av_freep(&s->positions[i]);
+        av_freep(&s->layout[i]);
+        s->nb_positions[i] = 0;
 
         s->x_pexpr[i] = s->y_pexpr[i] = s->fontsize_pexpr[i] = NULL;
     }
     av_expr_free(s->a_pexpr);
     s->a_pexpr = NULL;
 
-    av_freep(&s->positions);
-    s->nb_positions = 0;
-
     av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
     av_tree_destroy(s->glyphs);
     s->glyphs = NULL;
@@ -1958,50 +1990,98 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(NetIntDrawTextContext *s, ni_frame_t *frame,
-                       int width, int height,
+static void text_rect_union(TextRect *r, int x, int y, int w, int h)
+{
+    if (w <= 0 || h <= 0)
+        return;
+    if (r->x1 <= r->x0 || r->y1 <= r->y0) {
+        r->x0 = x;
+        r->y0 = y;
+        r->x1 = x + w;
+        r->y1 = y + h;
+        return;
+    }
+    r->x0 = FFMIN(r->x0, x);
+    r->y0 = FFMIN(r->y0, y);
+    r->x1 = FFMAX(r->x1, x + w);
+    r->y1 = FFMAX(r->y1, y + h);
+}
+
+static int text_rect_intersects(const TextRect *a, const TextRect *b)
+{
+    return a->x0 < b->x1 && b->x0 < a->x1 &&
+           a->y0 < b->y1 && b->y0 < a->y1;
+}
+
+/**
+ * Compute the canvas area the box, shadow, border and glyphs of one laid
+ * out text are blended into.
+ */
+static void text_footprint(NetIntDrawTextContext *s, int index, TextRect *r)
+{
+    const TextRenderKey *key = &s->text_key[index];
+    int i;
+
+    memset(r, 0, sizeof(*r));
+
+    if (s->draw_box)
+        text_rect_union(r, key->x - key->bb_left, key->y - key->bb_top,
+                        key->box_w + key->bb_left + key->bb_right,
+                        key->box_h + key->bb_top + key->bb_bottom);
+
+    for (i = 0; i < s->text_len[index]; i++) {
+        const Glyph *glyph = s->layout[index][i];
+        int x1, y1;
+
+        if (!glyph)
+            continue;
+
+        x1 = s->positions[index][i].x + key->x;
+        y1 = s->positions[index][i].y + key->y;
+
+        text_rect_union(r, x1, y1, glyph->bitmap.width, glyph->bitmap.rows);
+        if (s->shadowx || s->shadowy)
+            text_rect_union(r, x1 + s->shadowx, y1 + s->shadowy,
+                            glyph->bitmap.width, glyph->bitmap.rows);
+        if (s->borderw)
+            text_rect_union(r, x1 - s->borderw, y1 - s->borderw,
+                            glyph->border_bitmap.width,
+                            glyph->border_bitmap.rows);
+    }
+}
+
+/**
+ * Blend the glyphs of one text into dst, which points at the top left
+ * corner of the clip rectangle.
+ */
+static int draw_glyphs(NetIntDrawTextContext *s, uint8_t *dst[],
+                       int dst_linesize[], const TextRect *clip,
                        FFDrawColor *color,
                        int x, int y, int borderw, int index)
 {
-    char *text = s->expanded_text.str;
-    uint32_t code = 0;
+    const TextRenderKey *key = &s->text_key[index];
     int i, x1, y1;
-    uint8_t *p;
-    Glyph *glyph = NULL;
-    int dst_linesize[NI_MAX_NUM_DATA_POINTERS] = {0};
-
-    dst_linesize[0] = frame->data_len[0] / height;
-    dst_linesize[1] = dst_linesize[2] = frame->data_len[1] / (height / 2);
 
-    for (i = 0, p = text; *p; i++) {
+    for (i = 0; i < s->text_len[index]; i++) {
+        const Glyph *glyph = s->layout[index][i];
         FT_Bitmap bitmap;
-        Glyph dummy = { 0 };
-#if IS_FFMPEG_43_AND_ABOVE
-        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
-continue_on_invalid:
-#else
-        GET_UTF8(code, *p++, continue;);
-#endif
 
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
+        /* new line chars and tabs have no glyph to draw */
+        if (!glyph)
             continue;
 
-        dummy.code = code;
-        dummy.fontsize = s->fontsize[index];
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
         bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
 
         if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
             glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
             return AVERROR(EINVAL);
 
-        x1 = s->positions[i].x + s->x[index] + x - borderw;
-        y1 = s->positions[i].y + s->y[index] + y - borderw;
+        x1 = s->positions[index][i].x + key->x + x - borderw - clip->x0;
+        y1 = s->positions[index][i].y + key->y + y - borderw - clip->y0;
 
         ff_blend_mask(&s->dc, color,
-                      frame->p_data, dst_linesize, width, height,
+                      dst, dst_linesize,
+                      clip->x1 - clip->x0, clip->y1 - clip->y0,
                       bitmap.buffer, bitmap.pitch,
                       bitmap.width, bitmap.rows,
                       bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
@@ -2011,6 +2091,60 @@ continue_on_invalid:
     return 0;
 }
 
+/**
+ * Draw box, shadow, border and glyphs of one text, restricted to the clip
+ * rectangle so that a text only partially inside a redrawn area is not
+ * blended a second time over the pixels outside of it.
+ */
+static int render_text(NetIntDrawTextContext *s, ni_frame_t *frame,
+                       int height, const TextRect *clip, int index)
+{
+    TextRenderKey *key = &s->text_key[index];
+    uint8_t *dst[NI_MAX_NUM_DATA_POINTERS] = { NULL };
+    int dst_linesize[NI_MAX_NUM_DATA_POINTERS] = { 0 };
+    int ret;
+
+    dst_linesize[0] = frame->data_len[0] / height;
+    dst[0] = frame->p_data[0] + clip->y0 * dst_linesize[0] +
+             clip->x0 * s->dc.pixelstep[0];
+
+    /* draw box */
+    if (s->draw_box)
+        ff_blend_rectangle(&s->dc, &key->boxcolor,
+                           dst, dst_linesize,
+                           clip->x1 - clip->x0, clip->y1 - clip->y0,
+                           key->x - key->bb_left - clip->x0,
+                           key->y - key->bb_top - clip->y0,
+                           key->box_w + key->bb_left + key->bb_right,
+                           key->box_h + key->bb_top + key->bb_bottom);
+
+    if (s->shadowx || s->shadowy) {
+        if ((ret = draw_glyphs(s, dst, dst_linesize, clip, &key->shadowcolor,
+                               s->shadowx, s->shadowy, 0, index)) < 0)
+            return ret;
+    }
+
+    if (s->borderw) {
+        if ((ret = draw_glyphs(s, dst, dst_linesize, clip, &key->bordercolor,
+                               0, 0, s->borderw, index)) < 0)
+            return ret;
+    }
+
+    return draw_glyphs(s, dst, dst_linesize, clip, &key->fontcolor,
+                       0, 0, 0, index);
+}
+
+static void clear_canvas(NetIntDrawTextContext *s, ni_frame_t *frame,
+                         int height, const TextRect *r)
+{
+    int linesize = frame->data_len[0] / height;
+    uint8_t *p = frame->p_data[0] + r->y0 * linesize +
+                 r->x0 * s->dc.pixelstep[0];
+    int y;
+
+    for (y = r->y0; y < r->y1; y++, p += linesize)
+        memset(p, 0, (r->x1 - r->x0) * s->dc.pixelstep[0]);
+}
 
 static void update_color_with_alpha(NetIntDrawTextContext *s, FFDrawColor *color, const FFDrawColor incolor)
 {
@@ -2170,49 +2304,43 @@ static int draw_text(AVFilterContext *ctx, ni_frame_t *frame,
     FT_Vector delta;
     Glyph *glyph = NULL, *prev_glyph = NULL;
     Glyph dummy = { 0 };
+    TextRenderKey key;
+    TextRect dirty = { 0 };
 
     time_t now = time(0);
     struct tm ltime;
     AVBPrint *bp = &s->expanded_text;
 
-    FFDrawColor fontcolor;
-    FFDrawColor shadowcolor;
-    FFDrawColor bordercolor;
-    FFDrawColor boxcolor;
-    unsigned int dst_linesize[NI_MAX_NUM_DATA_POINTERS] = {0};
-    dst_linesize[0] = frame->data_len[0] / height;
-    dst_linesize[1] = dst_linesize[2] = frame->data_len[1] / height / 2;
-
-    av_bprint_clear(bp);
-
     if (s->basetime != AV_NOPTS_VALUE)
         now = pts * av_q2d(ctx->inputs[0]->time_base) + s->basetime/1000000;
 
     s->upload_drawtext_frame = 0;
 
+    /* the canvas persists across frames, only a resize invalidates it */
+    if (s->canvas_w != width || s->canvas_h != height) {
+        for (i = 0; i < s->text_num; i++)
+            s->text_drawn[i] = 0;
+        dirty.x1 = width;
+        dirty.y1 = height;
+        s->canvas_w = width;
+        s->canvas_h = height;
+    }
+
     for (i = 0; i < s->text_num; i++) {
+        av_bprint_clear(bp);
         switch (s->exp_mode) {
         case EXP_NONE:
             av_bprintf(bp, "%s", s->text[i]);
             break;
         case EXP_NORMAL:
             if ((ret = expand_text(ctx, s->text[i], &s->expanded_text)) < 0)
-                return ret;
+                goto fail;
             break;
         case EXP_STRFTIME:
             localtime_r(&now, &ltime);
             av_bprint_strftime(bp, s->text[i], &ltime);
             break;
         }
-        if (s->text_last_updated[i] == NULL) {
-            s->upload_drawtext_frame = 1;
-        } else {
-            if (strcmp(s->text_last_updated[i], bp->str))
-                s->upload_drawtext_frame = 1;
-        }
-        s->text_last_updated[i] = av_realloc(s->text_last_updated[i], bp->len+1);
-        strcpy(s->text_last_updated[i], bp->str);
-
         if (s->tc_opt_string) {
             char tcbuf[AV_TIMECODE_STR_SIZE];
 #if IS_FFMPEG_71_AND_ABOVE
@@ -2227,27 +2355,35 @@ static int draw_text(AVFilterContext *ctx, ni_frame_t *frame,
             av_bprintf(bp, "%s%s", s->text[i], tcbuf);
         }
 
-        if (!av_bprint_is_complete(bp))
-            return AVERROR(ENOMEM);
+        if (!av_bprint_is_complete(bp)) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
         text = s->expanded_text.str;
-        if ((len = s->expanded_text.len) > s->nb_positions) {
-            if (!(s->positions =
-                av_realloc(s->positions, len*sizeof(*s->positions))))
-                return AVERROR(ENOMEM);
-            s->nb_positions = len;
+        if ((len = s->expanded_text.len) > s->nb_positions[i]) {
+            if ((ret = av_reallocp_array(&s->positions[i], len,
+                                         sizeof(*s->positions[i]))) < 0 ||
+                (ret = av_reallocp_array(&s->layout[i], len,
+                                         sizeof(*s->layout[i]))) < 0) {
+                s->nb_positions[i] = 0;
+                goto fail;
+            }
+            s->nb_positions[i] = len;
         }
 
         if (s->fontcolor_expr[i]) {
             /* If expression is set, evaluate and replace the static value */
             av_bprint_clear(&s->expanded_fontcolor);
             if ((ret = expand_text(ctx, s->fontcolor_expr[i], &s->expanded_fontcolor)) < 0)
-                return ret;
-            if (!av_bprint_is_complete(&s->expanded_fontcolor))
-                return AVERROR(ENOMEM);
+                goto fail;
+            if (!av_bprint_is_complete(&s->expanded_fontcolor)) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
             av_log(s, AV_LOG_DEBUG, "Evaluated fontcolor is '%s'\n", s->expanded_fontcolor.str);
             ret = av_parse_color(s->fontcolor[i].rgba, s->expanded_fontcolor.str, -1, s);
             if (ret)
-                return ret;
+                goto fail;
             ff_draw_color(&s->dc, &s->fontcolor[i], s->fontcolor[i].rgba);
         }
 
@@ -2256,7 +2392,7 @@ static int draw_text(AVFilterContext *ctx, ni_frame_t *frame,
         max_text_line_w = 0;
 
         if ((ret = update_fontsize(ctx, i)) < 0)
-            return ret;
+            goto fail;
 
         /* load and cache glyphs */
         for (j = 0, p = text; *p; j++) {
@@ -2270,12 +2406,14 @@ continue_on_invalid:
             /* get glyph */
             dummy.code = code;
             dummy.fontsize = s->fontsize[i];
+            dummy.font = i;
             glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
             if (!glyph) {
                 ret = load_glyph(ctx, &glyph, code, i);
                 if (ret < 0)
-                    return ret;
+                    goto fail;
             }
+            s->layout[i][j] = glyph;
 
             y_min = FFMIN(glyph->bbox.yMin, y_min);
             y_max = FFMAX(glyph->bbox.yMax, y_max);
@@ -2296,12 +2434,14 @@ continue_on_invalid2:
 #endif
 
             /* skip the \n in the sequence \r\n */
-            if (prev_code == '\r' && code == '\n')
+            if (prev_code == '\r' && code == '\n') {
+                s->layout[i][j] = NULL;
                 continue;
+            }
 
             prev_code = code;
             if (is_newline(code)) {
-
+                s->layout[i][j] = NULL;
                 max_text_line_w = FFMAX(max_text_line_w, x);
                 y += s->max_glyph_h + s->line_spacing;
                 x = 0;
@@ -2310,9 +2450,7 @@ continue_on_invalid2:
 
             /* get glyph */
             prev_glyph = glyph;
-            dummy.code = code;
-            dummy.fontsize = s->fontsize[i];
-            glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+            glyph = s->layout[i][j];
 
             /* kerning */
             if (s->use_kerning[i] && prev_glyph && glyph->code) {
@@ -2322,13 +2460,15 @@ continue_on_invalid2:
             }
 
             /* save position */
-            s->positions[j].x = x + glyph->bitmap_left;
-            s->positions[j].y = y - glyph->bitmap_top + y_max;
-            if (code == '\t')
+            s->positions[i][j].x = x + glyph->bitmap_left;
+            s->positions[i][j].y = y - glyph->bitmap_top + y_max;
+            if (code == '\t') {
                 x  = (x / s->tabsize[i] + 1)*s->tabsize[i];
-            else
+                s->layout[i][j] = NULL;
+            } else
                 x += glyph->advance;
         }
+        s->text_len[i] = j;
 
         max_text_line_w = FFMAX(x, max_text_line_w);
 
@@ -2347,11 +2487,12 @@ continue_on_invalid2:
         /* It is necessary if x is expressed from y  */
         s->x[i] = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr[i], s->var_values, &s->prng);
 
+        memset(&key, 0, sizeof(key));
         update_alpha(s);
-        update_color_with_alpha(s, &fontcolor  , s->fontcolor[i]);
-        update_color_with_alpha(s, &shadowcolor, s->shadowcolor);
-        update_color_with_alpha(s, &bordercolor, s->bordercolor);
-        update_color_with_alpha(s, &boxcolor   , s->boxcolor[i]);
+        update_color_with_alpha(s, &key.fontcolor  , s->fontcolor[i]);
+        update_color_with_alpha(s, &key.shadowcolor, s->shadowcolor);
+        update_color_with_alpha(s, &key.bordercolor, s->bordercolor);
+        update_color_with_alpha(s, &key.boxcolor   , s->boxcolor[i]);
 
         box_w = max_text_line_w;
         box_h = y + s->max_glyph_h;
@@ -2402,39 +2543,73 @@ continue_on_invalid2:
             if (s->y[i] + box_h + offsetbottom > height)
                 s->y[i] = FFMAX(height - box_h - offsetbottom, 0);
         }
-        if (s->x[i] != s->x_bak[i] || s->y[i] != s->y_bak[i]) {
-            s->x_bak[i] = s->x[i];
-            s->y_bak[i] = s->y[i];
-            s->upload_drawtext_frame = 1;
-        }
-        /* draw box */
-        if (s->draw_box)
-            ff_blend_rectangle(&s->dc, &boxcolor,
-                               frame->p_data, dst_linesize, width, height,
-                               s->x[i] - s->bb_left[i], s->y[i] - s->bb_top[i],
-                               box_w + s->bb_left[i] + s->bb_right[i], box_h + s->bb_top[i] + s->bb_bottom[i]);
-
-        if (s->shadowx || s->shadowy) {
-            if ((ret = draw_glyphs(s, frame, width, height,
-                                   &shadowcolor, s->shadowx, s->shadowy, 0, i)) < 0)
-                return ret;
-        }
 
-        if (s->borderw) {
-            if ((ret = draw_glyphs(s, frame, width, height,
-                                &bordercolor, 0, 0, s->borderw, i)) < 0)
-                return ret;
+        key.fontsize  = s->fontsize[i];
+        key.x         = s->x[i];
+        key.y         = s->y[i];
+        key.box_w     = box_w;
+        key.box_h     = box_h;
+        key.bb_top    = s->bb_top[i];
+        key.bb_right  = s->bb_right[i];
+        key.bb_bottom = s->bb_bottom[i];
+        key.bb_left   = s->bb_left[i];
+
+        /* an unchanged text keeps its pixels from the previous frame,
+         * a changed one dirties both the area it covered and covers now */
+        if (!s->text_drawn[i] || strcmp(s->text_last_updated[i], text) ||
+            memcmp(&s->text_key[i], &key, sizeof(key))) {
+            uint8_t *last = av_realloc(s->text_last_updated[i], len + 1);
+            if (!last) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            memcpy(last, text, len + 1);
+            s->text_last_updated[i] = last;
+
+            if (s->text_drawn[i])
+                text_rect_union(&dirty, s->text_rect[i].x0, s->text_rect[i].y0,
+                                s->text_rect[i].x1 - s->text_rect[i].x0,
+                                s->text_rect[i].y1 - s->text_rect[i].y0);
+            s->text_key[i] = key;
+            text_footprint(s, i, &s->text_rect[i]);
+            text_rect_union(&dirty, s->text_rect[i].x0, s->text_rect[i].y0,
+                            s->text_rect[i].x1 - s->text_rect[i].x0,
+                            s->text_rect[i].y1 - s->text_rect[i].y0);
+            s->text_drawn[i] = 1;
         }
-        if ((ret = draw_glyphs(s, frame, width, height,
-                            &fontcolor, 0, 0, 0, i)) < 0)
-            return ret;
 
         update_canvas_size(s, s->x[i] - s->bb_left[i], s->y[i] - s->bb_top[i],
                            box_w + s->bb_left[i] + s->bb_right[i],  box_h + s->bb_top[i] + s->bb_bottom[i]);
         update_watermark(s, s->x[i] - s->bb_left[i], s->y[i] - s->bb_top[i],
                          box_w + s->bb_left[i] + s->bb_right[i], box_h + s->bb_top[i] + s->bb_bottom[i]);
     }
+
+    /* clear and redraw only what changed, clipped to the frame */
+    dirty.x0 = FFMAX(dirty.x0, 0);
+    dirty.y0 = FFMAX(dirty.y0, 0);
+    dirty.x1 = FFMIN(dirty.x1, width);
+    dirty.y1 = FFMIN(dirty.y1, height);
+    if (dirty.x1 <= dirty.x0 || dirty.y1 <= dirty.y0)
+        return 0;
+
+    av_log(ctx, AV_LOG_DEBUG, "redraw %dx%d at %d,%d\n",
+           dirty.x1 - dirty.x0, dirty.y1 - dirty.y0, dirty.x0, dirty.y0);
+
+    clear_canvas(s, frame, height, &dirty);
+    for (i = 0; i < s->text_num; i++) {
+        if (!text_rect_intersects(&s->text_rect[i], &dirty))
+            continue;
+        if ((ret = render_text(s, frame, height, &dirty, i)) < 0)
+            goto fail;
+    }
+    s->upload_drawtext_frame = 1;
+
     return 0;
+
+fail:
+    /* the canvas may be half drawn, repaint everything next time */
+    s->canvas_w = s->canvas_h = 0;
+    return ret;
 }
 
 static int init_hwframe_uploader(AVFilterContext *ctx, NetIntDrawTextContext *s,
@@ -2888,14 +3063,104 @@ static int do_intermediate_crop_and_overlay(
     return NI_RETCODE_SUCCESS;
 }
 
+/**
+ * Wrap the text canvas into up_frame for uploading. With watermarks the
+ * whole canvas is uploaded, otherwise the text area is first copied out of
+ * it into txt_frame.
+ */
+static int prepare_upload_frame(AVFilterContext *ctx, AVFrame *frame,
+                                int ovly_width, int ovly_height)
+{
+    NetIntDrawTextContext *s = ctx->priv;
+    uint8_t *p_dst, *p_src;
+    int start_row, stop_row, start_col, stop_col;
+    int dl_frame_linesize0, text_frame_linesize0;
+
+    // Clear the contents of up_frame to avoid accumulating old data
+    av_frame_free(&s->up_frame);
+    s->up_frame = av_frame_alloc();
+    if (!s->up_frame)
+        return AVERROR(ENOMEM);
+
+    if (s->use_watermark) {
+        // wrap the dl_frame ni_frame into AVFrame up_frame
+        // for RGBA format, only need to copy the first data
+        // in some situation, like linesize[0] == align64(width*4)
+        // it will use zero copy, and it need to keep data[1] and data[2] be null
+        // for watermark, it uploads the whole frame
+        s->up_frame->data[0] = s->dl_frame.data.frame.p_data[0];
+        s->up_frame->linesize[0] = FFALIGN(ovly_width, 16) * 4;
+        return 0;
+    }
+
+    av_log(ctx, AV_LOG_DEBUG, "%s alloc txt_frame %dx%d\n", __func__,
+           ovly_width, ovly_height);
+    if (ni_frame_buffer_alloc_dl(&(s->txt_frame.data.frame),
+                                 ovly_width, ovly_height,
+                                 NI_PIX_FMT_RGBA))
+        return AVERROR(ENOMEM);
+
+    p_dst = s->txt_frame.data.frame.p_buffer;
+
+    start_row = s->y_start;
+    stop_row  = start_row + ovly_height;
+    start_col = s->x_start;
+    stop_col  = start_col + ovly_width;
+    dl_frame_linesize0 = FFALIGN(frame->width, 16);
+    text_frame_linesize0 = FFALIGN(ovly_width, 16);
+
+    // the copy below covers the whole text frame unless the overlay sticks
+    // out of the main frame, only then the rest needs to be transparent
+    if (start_row < 0 || stop_row > frame->height ||
+        start_col < 0 || stop_col > frame->width)
+        memset(p_dst, 0, s->txt_frame.data.frame.buffer_size);
+
+    // if overlay intersects at the main top/bottom, only copy the overlaying
+    // portion
+    if (start_row < 0) {
+        p_dst += -1 * start_row * text_frame_linesize0 * 4;
+        start_row = 0;
+    }
+    if (stop_row > frame->height) {
+        stop_row = frame->height;
+    }
+
+    // if overlay intersects at the main left/right, only copy the overlaying
+    // portion
+    if (start_col < 0) {
+        p_dst += (-4 * start_col);
+        start_col = 0;
+    }
+    if (stop_col > frame->width) {
+        stop_col = frame->width;
+    }
+
+    if (stop_row > start_row && stop_col > start_col) {
+        p_src = s->dl_frame.data.frame.p_buffer +
+            (start_row * dl_frame_linesize0 + start_col) * 4;
+
+        ff_ni_copy_plane(p_dst, text_frame_linesize0 * 4,
+                         p_src, dl_frame_linesize0 * 4,
+                         (stop_col - start_col) * 4, stop_row - start_row);
+    }
+    // wrap the txt ni_frame into AVFrame up_frame
+    // for RGBA format, only need to copy the first data
+    // in some situation, like linesize[0] == align64(width*4)
+    // it will use zero copy, and it need to keep data[1] and data[2] be null
+    // for inplace overlay, it updates the clip include text
+    s->up_frame->data[0] = s->txt_frame.data.frame.p_data[0];
+    s->up_frame->linesize[0] = text_frame_linesize0 * 4;
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     NetIntDrawTextContext *s = ctx->priv;
     niFrameSurface1_t *logging_surface, *logging_surface_out;
-    uint8_t *p_dst, *p_src;
-    int y, txt_img_width, txt_img_height;
+    int txt_img_width, txt_img_height;
     int ret;
 
     AVHWFramesContext *main_frame_ctx, *ovly_frame_ctx;
@@ -2908,8 +3173,6 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     int flags;
     int src_x, src_y, src_w, src_h;
     int dst_x, dst_y, dst_w, dst_h;
-    int start_row, stop_row, start_col, stop_col;
-    int dl_frame_linesize0, text_frame_linesize0;
     int ovly_width, ovly_height;
 
     av_log(ctx, AV_LOG_DEBUG, "ni_drawtext %s %dx%d is_hw_frame %d\n",
@@ -2977,11 +3240,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
            av_get_pix_fmt_name(main_frame_ctx->sw_format),
            (int)s->var_values[VAR_TEXT_W], (int)s->var_values[VAR_TEXT_H]);
 
-    memset(s->dl_frame.data.frame.p_buffer, 0,
-           s->dl_frame.data.frame.buffer_size);
-
-    draw_text(ctx, &(s->dl_frame.data.frame), frame->width, frame->height,
-              frame->pts);
+    /* dl_frame keeps the text drawn for the previous frame, draw_text only
+     * clears and repaints the parts of it that changed */
+    ret = draw_text(ctx, &(s->dl_frame.data.frame), frame->width, frame->height,
+                    frame->pts);
+    if (ret < 0) {
+        av_frame_free(&frame);
+        return ret;
+    }
     check_and_expand_canvas_size(s, NI_MIN_RESOLUTION_WIDTH_SCALER, NI_MIN_RESOLUTION_HEIGHT_SCALER);
 
     av_log(ctx, AV_LOG_DEBUG, "n:%d t:%f text_w:%d text_h:%d x:%d y:%d "
@@ -3045,80 +3311,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
     txt_img_width = ovly_width = s->initiated_upload_width;
     txt_img_height = ovly_height = s->initiated_upload_height;
 
-    // Clear the contents of up_frame to avoid accumulating old data
-    av_frame_free(&s->up_frame);
-    s->up_frame = av_frame_alloc();
-    if (!s->up_frame) {
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
-
     if (s->use_watermark) {
         if (ni_scaler_set_watermark_params(&s->api_ctx,
                                            &s->scaler_watermark_paras.multi_watermark_params[0])) {
             av_log(ctx, AV_LOG_ERROR, "failed ni_drawtext set_watermark_params\n");
             goto fail;
         }
-        // wrap the dl_frame ni_frame into AVFrame up_frame
-        // for RGBA format, only need to copy the first data
-        // in some situation, like linesize[0] == align64(width*4)
-        // it will use zero copy, and it need to keep data[1] and data[2] be null
-        // for watermark, it uploads the whole frame
-        s->up_frame->data[0] = s->dl_frame.data.frame.p_data[0];
-        s->up_frame->linesize[0] = FFALIGN(ovly_width, 16) * 4;
-    } else {
-        av_log(ctx, AV_LOG_DEBUG, "%s alloc txt_frame %dx%d\n", __func__,
-            txt_img_width, txt_img_height);
-        if (ni_frame_buffer_alloc_dl(&(s->txt_frame.data.frame),
-                                    txt_img_width, txt_img_height,
-                                    NI_PIX_FMT_RGBA)) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
-        }
-
-        p_dst = s->txt_frame.data.frame.p_buffer;
-        memset(p_dst, 0, s->txt_frame.data.frame.buffer_size);
-
-        start_row = s->y_start;
-        stop_row  = start_row + txt_img_height;
-        dl_frame_linesize0 = FFALIGN(frame->width, 16);
-        text_frame_linesize0 = FFALIGN(txt_img_width, 16);
-        // if overlay intersects at the main top/bottom, only copy the overlaying
-        // portion
-        if (start_row < 0) {
-            p_dst += -1 * start_row * text_frame_linesize0 * 4;
-            start_row = 0;
-        }
-        if (stop_row > frame->height) {
-            stop_row = frame->height;
-        }
-
-        // if overlay intersects at the main left/right, only copy the overlaying
-        // portion
-        start_col = s->x_start;
-        stop_col  = start_col + txt_img_width;
-        if (start_col < 0) {
-            p_dst += (-4 * start_col);
-            start_col = 0;
-        }
-        if (stop_col > frame->width) {
-            stop_col = frame->width;
-        }
-
-        for (y = start_row; y < stop_row; y++) {
-            p_src = s->dl_frame.data.frame.p_buffer +
-                (y * dl_frame_linesize0 + start_col) * 4;
-
-            memcpy(p_dst, p_src, (stop_col - start_col) * 4);
-            p_dst += text_frame_linesize0 * 4;
-        }
-        // wrap the txt ni_frame into AVFrame up_frame
-        // for RGBA format, only need to copy the first data
-        // in some situation, like linesize[0] == align64(width*4)
-        // it will use zero copy, and it need to keep data[1] and data[2] be null
-        // for inplace overlay, it updates the clip include text
-        s->up_frame->data[0] = s->txt_frame.data.frame.p_data[0];
-        s->up_frame->linesize[0] = text_frame_linesize0 * 4;
     }
 
     if (s->optimize_upload == 0) //Force uploading drawtext frame by every frame
@@ -3130,7 +3328,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         s->filtered_frame_count = 0;
     }
 
+    // Only an upload needs the staging frame, an unchanged text reuses the
+    // overlay frame uploaded before
     if (s->upload_drawtext_frame) {
+        ret = prepare_upload_frame(ctx, frame, ovly_width, ovly_height);
+        if (ret < 0)
+            goto fail;
+
         av_frame_free(&s->keep_overlay);
         s->keep_overlay = NULL;
         s->keep_overlay = overlay = av_frame_alloc();
@@ -43,6 +43,8 @@ typedef struct NetIntFlipContext {
 
     AVBufferRef *out_frames_ref;
 
+    NIPoolUsage *pool_usage;
+
     ni_session_context_t api_ctx;
     ni_session_data_io_t api_dst_frame;
 
@@ -90,6 +92,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     av_buffer_unref(&flip->out_frames_ref);
 
+    ff_ni_pool_usage_report(flip->pool_usage, ctx);
+    ff_ni_pool_usage_unref(&flip->pool_usage);
 }
 
 #if IS_FFMPEG_342_AND_ABOVE
@@ -199,6 +203,14 @@ static int init_out_pool(AVFilterContext *ctx)
 
     if (flip->api_ctx.isP2P) {
         pool_size = 1;
+    } else {
+        pool_size = ff_ni_pool_plan(ctx, pool_size);
+    }
+
+    ff_ni_pool_usage_unref(&flip->pool_usage);
+    flip->pool_usage = ff_ni_pool_usage_alloc(pool_size);
+    if (!flip->pool_usage) {
+        return AVERROR(ENOMEM);
     }
 #if IS_FFMPEG_61_AND_ABOVE
     flip->buffer_limit = 1;
@@ -411,13 +423,14 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     out->buf[0] = av_buffer_create(out->data[3],
                                    sizeof(niFrameSurface1_t),
                                    ff_ni_frame_free,
-                                   NULL,
+                                   flip->pool_usage,
                                    0);
     if (!out->buf[0]) {
         av_log(ctx, AV_LOG_ERROR, "ni flip filter av_buffer_create returned NULL\n");
         retcode = AVERROR(ENOMEM);
         goto FAIL;
     }
+    ff_ni_pool_usage_acquire(flip->pool_usage);
 
     av_frame_free(&in);
     return ff_filter_frame(inlink->dst->outputs[0], out);
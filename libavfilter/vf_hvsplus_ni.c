@@ -790,419 +790,6 @@ static int output_config_props(AVFilterLink *outlink)
     return ret;
 }
 
-static int av_to_niframe_copy(NetIntHvsplusContext *s, ni_frame_t *dst, const AVFrame *src, int nb_planes)
-{
-    int dst_stride[4],src_height[4], hpad[4], vpad[4], linesize[4];
-    int i, j, h;
-    uint8_t *src_line, *dst_line, YUVsample, *sample, *dest;
-    uint16_t lastidx;
-    bool tenBit;
-
-    av_log(NULL, AV_LOG_DEBUG, "%s: src width %d height %d nb w %d nb h %d format %s linesize %d %d %d nb_planes %d\n", __func__,
-           src->width, src->height, s->nb_width, s->nb_height, av_get_pix_fmt_name(src->format),
-           src->linesize[0], src->linesize[1], src->linesize[2], nb_planes);
-
-    linesize[0] = src->linesize[0];
-    linesize[1] = src->linesize[1];
-    linesize[2] = src->linesize[2];
-    linesize[3] = 0;
-
-    switch (src->format) {
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUVJ420P:
-        dst_stride[0] = FFALIGN(s->nb_width, 128);
-        dst_stride[1] = FFALIGN((s->nb_width / 2), 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
-        linesize[0] = FFALIGN(src->width, 2);
-        linesize[1] = FFALIGN(src->width, 2) / 2;
-        linesize[2] = linesize[1];
-
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(s->nb_height, 2) - src->height;
-        vpad[1] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[2] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        dst_stride[0] = FFALIGN(s->nb_width * 2, 128);
-        dst_stride[1] = FFALIGN(s->nb_width, 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
-        linesize[0] = src->width * 2;
-        linesize[1] = src->width;
-        linesize[2] = linesize[1];
-
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(s->nb_height, 2) - src->height;
-        vpad[1] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[2] = (FFALIGN(s->nb_height, 2) / 2) - (FFALIGN(src->height, 2) / 2);
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-    case AV_PIX_FMT_NV12:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_NV16:
-        dst_stride[0] = FFALIGN(src->width, 64);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = 0;
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_P010LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_BGRP:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = src->height;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        dst_stride[0] = FFALIGN(src->width, 16) * 2;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-        hpad[0] = FFMAX(dst_stride[0] - linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    default:
-        av_log(NULL, AV_LOG_ERROR, "Error: Pixel format %s not supported\n",
-               av_get_pix_fmt_name(src->format));
-        return AVERROR(EINVAL);
-    }
-    av_log(NULL, AV_LOG_DEBUG, "%s: dst_stride %d %d %d linesize %d %d %d hpad %d %d %d\n", __func__,
-           dst_stride[0], dst_stride[1], dst_stride[2],
-           src->linesize[0], src->linesize[1], src->linesize[2],
-           hpad[0], hpad[1], hpad[2]);
-    av_log(NULL, AV_LOG_DEBUG, "%s: src_height %d %d %d vpad %d %d %d tenBit %d\n", __func__,
-           src_height[0], src_height[1], src_height[2],
-           vpad[0], vpad[1], vpad[2], tenBit);
-
-    dst_line = dst->p_buffer;
-    for (i = 0; i < nb_planes; i++) {
-        src_line = src->data[i];
-        for (h = 0; h < src_height[i]; h++) {
-            memcpy(dst_line, src_line, FFMIN(linesize[i], dst_stride[i]));
-
-            if (h == 0)
-                av_log(NULL, AV_LOG_DEBUG, "%s: i %d h %d to %d memcpy size %d\n", __func__, i, h, src_height[i]-1, FFMIN(linesize[i], dst_stride[i]));
-
-            if (hpad[i]) {
-                lastidx = linesize[i];
-
-                if (tenBit) {
-                    sample = &src_line[lastidx - 2];
-                    dest   = &dst_line[lastidx];
-
-                    /* two bytes per sample */
-                    for (j = 0; j < hpad[i] / 2; j++) {
-                        memcpy(dest, sample, 2);
-                        dest += 2;
-                    }
-                    if (h == 0)
-                        av_log(NULL, AV_LOG_DEBUG, "%s: i %d hpad %d to %d memset size %d value %d %d tenBit\n", __func__, i, h, src_height[i]-1, hpad[i], sample[0], sample[1]);
-
-                } else {
-                    YUVsample = dst_line[lastidx - 1];
-                    memset(&dst_line[lastidx], YUVsample, hpad[i]);
-
-                    if (h == 0)
-                        av_log(NULL, AV_LOG_DEBUG, "%s: i %d hpad %d to %d memset size %d value %d\n", __func__, i, h, src_height[i]-1, hpad[i], YUVsample);
-                }
-            }
-
-            src_line += src->linesize[i];
-            dst_line += dst_stride[i];
-        }
-
-        /* Extend the height by cloning the last line */
-        src_line = dst_line - dst_stride[i];
-        for (h = 0; h < vpad[i]; h++) {
-            memcpy(dst_line, src_line, dst_stride[i]);
-
-            av_log(NULL, AV_LOG_DEBUG, "%s: h %d memcpy vpad size %d\n", __func__, h, dst_stride[i]);
-
-            dst_line += dst_stride[i];
-        }
-    }
-
-    return 0;
-}
-
-static int ni_to_avframe_copy(NetIntHvsplusContext *s, AVFrame *dst, const ni_packet_t *src, int nb_planes)
-{
-    int src_linesize[4], src_height[4], dst_height[4];
-    int i, h;
-    uint8_t *src_line, *dst_line;
-
-    av_log(NULL, AV_LOG_DEBUG, "%s: dst width %d height %d nb w %d nb h %d format %s nb_planes %d\n", __func__,
-           dst->width, dst->height, s->nb_width, s->nb_height, av_get_pix_fmt_name(dst->format), nb_planes);
-
-    dst_height[0] = dst->height;
-    dst_height[1] = dst->height / 2;
-    dst_height[2] = dst_height[1];
-    dst_height[3] = 0;
-
-    switch (dst->format) {
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUVJ420P:
-        src_linesize[0] = FFALIGN(s->nb_width, 128);
-        src_linesize[1] = FFALIGN(s->nb_width / 2, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = s->nb_height;
-        src_height[1] = FFALIGN(s->nb_height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        src_linesize[0] = FFALIGN(s->nb_width * 2, 128);
-        src_linesize[1] = FFALIGN(s->nb_width, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = s->nb_height;
-        src_height[1] = FFALIGN(s->nb_height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_NV12:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_NV16:
-        src_linesize[0] = FFALIGN(dst->width, 64);
-        src_linesize[1] = FFALIGN(dst->width, 64);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 2;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_P010LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width * 2, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 4;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-    case AV_PIX_FMT_BGRP:
-        src_linesize[0] = FFALIGN(dst->width, 32);
-        src_linesize[1] = FFALIGN(dst->width, 32);
-        src_linesize[2] = FFALIGN(dst->width, 32);
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = dst->height;
-        src_height[3] = 0;
-        break;
-    default:
-        av_log(NULL, AV_LOG_ERROR, "Error: Unsupported pixel format %s\n",
-               av_get_pix_fmt_name(dst->format));
-        return AVERROR(EINVAL);
-    }
-    av_log(NULL, AV_LOG_DEBUG, "%s: src_linesize %d %d %d src_height %d %d %d dst linesize %d %d %d dst_height %d %d %d\n", __func__,
-           src_linesize[0], src_linesize[1], src_linesize[2],
-           src_height[0], src_height[1], src_height[2],
-           dst->linesize[0], dst->linesize[1], dst->linesize[2],
-           dst_height[0], dst_height[1], dst_height[2]);
-
-    src_line = src->p_data;
-    for (i = 0; i < nb_planes; i++) {
-        dst_line = dst->data[i];
-
-        for (h = 0; h < src_height[i]; h++) {
-            if (h < dst_height[i]) {
-                memcpy(dst_line, src_line,
-                       FFMIN(src_linesize[i], dst->linesize[i]));
-                if (h == 0)
-                    av_log(NULL, AV_LOG_DEBUG, "%s: i %d h %d to %d memcpy size %d\n", __func__, i, h, src_height[i]-1,  FFMIN(src_linesize[i], dst->linesize[i]));
-                dst_line += FFMIN(src_linesize[i], dst->linesize[i]);
-            }
-            src_line += src_linesize[i];
-        }
-    }
-
-    return 0;
-}
-
 static int ni_hwframe_pad(AVFilterContext *ctx, NetIntHvsplusContext *s, AVFrame *in,
                           int w, int h,
                           niFrameSurface1_t **filt_frame_surface)
@@ -1403,6 +990,8 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
     int ret;
     AiContext *ai_ctx;
     ni_hvsplus_network_t *network = &s->network;
+    NIDeviceLayout layout;
+    NIHostFrameMap map = { 0 };
     int nb_planes;
     int64_t start_t;
     int hwframe = in->format == AV_PIX_FMT_NI_QUAD ? 1 : 0;
@@ -1695,7 +1284,15 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
             nb_planes = 1; // only copy Y data
         }
         // sw frame: step 2: pad and setup frame
-        retval = av_to_niframe_copy(s, &ai_ctx->api_src_frame.data.frame, in, nb_planes);
+        ret = ff_ni_get_device_layout(&layout, in->format, s->nb_width,
+                                      s->nb_height, nb_planes);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Error: Pixel format %s not supported\n",
+                   av_get_pix_fmt_name(in->format));
+            goto failed_out;
+        }
+        retval = ff_ni_map_host_frame(&ai_ctx->api_src_frame.data.frame, &map,
+                                      in, &layout);
         if (retval < 0) {
             av_log(ctx, AV_LOG_ERROR, "Error: hvsplus cannot copy frame\n");
             ret = AVERROR(EIO);
@@ -1724,6 +1321,7 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
                 goto failed_out;
             }
         } while (retval == 0);
+        ff_ni_unmap_host_frame(&ai_ctx->api_src_frame.data.frame, &map);
         // sw frame: step 4: alloc frame for read
         retval = ni_ai_packet_buffer_alloc(&ai_ctx->api_dst_frame.data.packet,
                                         &network->raw);
@@ -1762,11 +1360,27 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
             }
             nb_planes = 1; // only copy Y data
             // copy U/V data from the input sw frame
-            memcpy(out->data[1], in->data[1], in->height * in->linesize[1] / 2);
-            memcpy(out->data[2], in->data[2], in->height * in->linesize[2] / 2);
+            ff_ni_copy_plane(out->data[1], out->linesize[1],
+                             in->data[1], in->linesize[1],
+                             FFMIN(out->linesize[1], in->linesize[1]),
+                             AV_CEIL_RSHIFT(FFMIN(out->height, in->height), 1));
+            ff_ni_copy_plane(out->data[2], out->linesize[2],
+                             in->data[2], in->linesize[2],
+                             FFMIN(out->linesize[2], in->linesize[2]),
+                             AV_CEIL_RSHIFT(FFMIN(out->height, in->height), 1));
         }
         // sw frame: step 6: crop
-        retval = ni_to_avframe_copy(s, out, &ai_ctx->api_dst_frame.data.packet, nb_planes);
+        ret = ff_ni_get_device_layout(&layout, out->format, s->nb_width,
+                                      s->nb_height, nb_planes);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Error: Unsupported pixel format %s\n",
+                   av_get_pix_fmt_name(out->format));
+            goto failed_out;
+        }
+        retval = ff_ni_copy_device_to_host_frame(out,
+                                                 ai_ctx->api_dst_frame.data.packet.p_data,
+                                                 ai_ctx->api_dst_frame.data.packet.data_len,
+                                                 &layout);
         if (retval < 0) {
             av_log(ctx, AV_LOG_ERROR, "Error: hvsplus cannot copy ai frame to avframe\n");
             ret = AVERROR(EIO);
@@ -1778,6 +1392,8 @@ static int filter_frame_internal(AVFilterLink *link, AVFrame *in)
     return ff_filter_frame(link->dst->outputs[0], out);
 
 failed_out:
+    if (map.mapped)
+        ff_ni_unmap_host_frame(&s->ai_ctx->api_src_frame.data.frame, &map);
     if (out)
         av_frame_free(&out);
 
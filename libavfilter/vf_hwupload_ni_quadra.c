@@ -21,6 +21,7 @@
 #include "libavutil/opt.h"
 
 #include "nifilter.h"
+#include "ni_pipeline.h"
 #include "filters.h"
 #include "formats.h"
 #if !IS_FFMPEG_71_AND_ABOVE
@@ -40,8 +41,18 @@ typedef struct NetIntUploadContext {
     AVBufferRef *hwdevice;
     AVBufferRef *hwframe;
     int keep_alive_timeout; /* keep alive timeout setting */
+
+    /* uploads done on a worker thread, 0 to upload on the filter thread */
+    int depth;
+    NIPipeline *pipeline;
 } NetIntUploadContext;
 
+typedef struct UploadJob {
+    AVFilterContext *ctx;
+    AVFrame *in;                ///< owned by the pipeline
+    AVFrame *out;
+} UploadJob;
+
 static int query_formats(AVFilterContext *ctx)
 {
     NetIntUploadContext *nictx = ctx->priv;
@@ -123,6 +134,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     NetIntUploadContext *s = ctx->priv;
 
+    ff_ni_pipeline_report(s->pipeline, ctx);
+    ff_ni_pipeline_free(&s->pipeline);
     av_buffer_unref(&s->hwframe);
     av_buffer_unref(&s->hwdevice);
 }
@@ -182,6 +195,10 @@ static int config_output(AVFilterLink *outlink, AVFrame *in)
     hwframe_ctx->sw_format = inlink->format;
     hwframe_ctx->width     = inlink->w;
     hwframe_ctx->height    = inlink->h;
+    // the default of the device is 3 frames, only ever grow it; each
+    // upload in flight past the first holds one more
+    hwframe_ctx->initial_pool_size = ff_ni_pool_plan(ctx, 3) +
+                                     FFMAX(s->depth - 1, 0);
     pub_ctx = (AVNIFramesContext*)hwframe_ctx->hwctx;
     pub_ctx->keep_alive_timeout = s->keep_alive_timeout;
 #if IS_FFMPEG_71_AND_ABOVE
@@ -209,23 +226,12 @@ static int config_output(AVFilterLink *outlink, AVFrame *in)
     return 0;
 }
 
-static int filter_frame(AVFilterLink *link, AVFrame *in)
+/* Copy in to a new device frame */
+static int upload(AVFilterContext *ctx, AVFrame *in, AVFrame **pout)
 {
-    AVFilterContext   *ctx = link->dst;
     AVFilterLink  *outlink = ctx->outputs[0];
     AVFrame *out = NULL;
     int ret;
-#if !IS_FFMPEG_342_AND_ABOVE
-    NetIntUploadContext *s     = ctx->priv;
-
-    if (!s->initialized) {
-        config_output(outlink, in);
-        s->initialized = 1;
-    }
-#endif
-
-    if (in->format == outlink->format)
-        return ff_filter_frame(outlink, in);
 
 #if IS_FFMPEG_342_AND_ABOVE
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
@@ -258,16 +264,127 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     if (ret < 0)
         goto fail;
 
-    av_frame_free(&in);
-
-    return ff_filter_frame(ctx->outputs[0], out);
+    *pout = out;
+    return 0;
 
 fail:
-    av_frame_free(&in);
     av_frame_free(&out);
     return ret;
 }
 
+static int upload_submit(void *opaque, void *job)
+{
+    UploadJob *j = job;
+
+    return upload(j->ctx, j->in, &j->out);
+}
+
+static int upload_collect(void *opaque, void *job)
+{
+    return 1;
+}
+
+static void upload_uninit_job(void *opaque, void *job)
+{
+    UploadJob *j = job;
+
+    av_frame_free(&j->out);
+}
+
+static const NIPipelineOps upload_pipeline_ops = {
+    .submit     = upload_submit,
+    .collect    = upload_collect,
+    .uninit_job = upload_uninit_job,
+    .job_name   = "upload",
+};
+
+/* hand in to the worker, the filter thread goes on with the next frame */
+static int upload_queue_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    NetIntUploadContext *s = ctx->priv;
+    UploadJob *job;
+    int ret;
+
+    if (!s->pipeline) {
+        ret = ff_ni_pipeline_alloc(&s->pipeline, &upload_pipeline_ops, ctx,
+                                   ctx, s->depth, sizeof(UploadJob));
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "failed to create upload pipeline\n");
+            av_frame_free(&in);
+            return ret;
+        }
+    }
+
+    job = ff_ni_pipeline_next_job(s->pipeline);
+    if (!job) {
+        av_frame_free(&in);
+        return AVERROR_BUG;
+    }
+    job->ctx = ctx;
+    job->in  = in;
+    job->out = NULL;
+
+    ret = ff_ni_pipeline_push(s->pipeline, in);
+    if (ret < 0)
+        av_frame_free(&in);
+    return ret;
+}
+
+/**
+ * Output the oldest frame if its upload is done.
+ *
+ * @return 1 if a frame was sent, 0 if none was ready, a negative AVERROR
+ */
+static int upload_output_done(AVFilterContext *ctx, int block)
+{
+    NetIntUploadContext *s = ctx->priv;
+    AVFrame *in, *out;
+    UploadJob *job;
+    int ret;
+
+    ret = ff_ni_pipeline_pop(s->pipeline, &in, (void **)&job, block);
+    av_frame_free(&in);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Error transferring data to the Quadra\n");
+        ff_ni_pipeline_release(s->pipeline);
+    }
+    if (ret <= 0)
+        return ret;
+
+    out = job->out;
+    job->out = NULL;
+    ff_ni_pipeline_release(s->pipeline);
+
+    ret = ff_filter_frame(ctx->outputs[0], out);
+    return ret < 0 ? ret : 1;
+}
+
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext   *ctx = link->dst;
+    AVFilterLink  *outlink = ctx->outputs[0];
+    AVFrame *out = NULL;
+    int ret;
+#if !IS_FFMPEG_342_AND_ABOVE
+    NetIntUploadContext *s     = ctx->priv;
+
+    if (!s->initialized) {
+        config_output(outlink, in);
+        s->initialized = 1;
+    }
+#endif
+
+    if (in->format == outlink->format)
+        return ff_filter_frame(outlink, in);
+
+    ret = upload(ctx, in, &out);
+    av_frame_free(&in);
+    if (ret < 0)
+        return ret;
+
+    return ff_filter_frame(outlink, out);
+}
+
 #if IS_FFMPEG_61_AND_ABOVE
 static int activate(AVFilterContext *ctx)
 {
@@ -282,15 +399,35 @@ static int activate(AVFilterContext *ctx)
     AVHWFramesContext *hwfc = (AVHWFramesContext *) outlink->hw_frames_ctx->data;
 #endif
     AVNIFramesContext *f_hwctx = (AVNIFramesContext*) hwfc->hwctx;
+    NetIntUploadContext *s = ctx->priv;
 
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
+    // Send out finished uploads first. Wait for the oldest one only when
+    // nothing else can be done: the pipeline is full or the input ended
+    if (s->pipeline && ff_ni_pipeline_pending(s->pipeline)) {
+        int64_t pts;
+        int status;
+        int block = !ff_ni_pipeline_next_job(s->pipeline) ||
+                    ff_inlink_acknowledge_status(inlink, &status, &pts);
+
+        ret = upload_output_done(ctx, block);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            ff_filter_set_ready(ctx, 300);
+            return 0;
+        }
+    }
+
     av_log(ctx, AV_LOG_TRACE, "%s: ready %u inlink framequeue %u available_frame %d outlink framequeue %u frame_wanted %d\n",
         __func__, ctx->ready, ff_inlink_queued_frames(inlink), ff_inlink_check_available_frame(inlink), ff_inlink_queued_frames(outlink), ff_outlink_frame_wanted(outlink));
 
     if (ff_inlink_check_available_frame(inlink)) {
-        if (inlink->format != outlink->format) {
+        // the worker owns the upload session, the pipeline depth is the
+        // backpressure then
+        if (inlink->format != outlink->format && !s->depth) {
             ret = ni_device_session_query_buffer_avail(&f_hwctx->api_ctx, NI_DEVICE_TYPE_UPLOAD);
 
             if (ret == NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION) {
@@ -306,7 +443,10 @@ static int activate(AVFilterContext *ctx)
         if (ret < 0)
             return ret;
 
-        ret = filter_frame(inlink, frame);
+        if (s->depth && frame->format != outlink->format)
+            ret = upload_queue_frame(ctx, frame);
+        else
+            ret = filter_frame(inlink, frame);
         if (ret >= 0) {
             ff_filter_set_ready(ctx, 300);
         }
@@ -330,6 +470,7 @@ static const AVOption ni_upload_options[] = {
     { "device",  "Number of the device to use", OFFSET(device_idx),  AV_OPT_TYPE_INT,    {.i64 = -1},  -1,        INT_MAX,  FLAGS},
     { "devname", "Name of the device to use",   OFFSET(device_name), AV_OPT_TYPE_STRING, {.str = NULL}, CHAR_MIN, CHAR_MAX, FLAGS},
     NI_FILT_OPTION_KEEPALIVE,
+    { "depth",   "Uploads kept in flight on a worker thread, 0 to upload synchronously", OFFSET(depth), AV_OPT_TYPE_INT, {.i64 = 0}, 0, DEFAULT_NI_FILTER_POOL_SIZE - 1, FLAGS},
     { NULL }
 };
 
@@ -98,6 +98,8 @@ typedef struct NetIntOverlayContext {
 
     AVBufferRef* out_frames_ref;
 
+    NIPoolUsage *pool_usage;
+
     int initialized;
     int session_opened;
     int crop_session_opened;
@@ -226,6 +228,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     }
 
     av_buffer_unref(&s->out_frames_ref);
+
+    ff_ni_pool_usage_report(s->pool_usage, ctx);
+    ff_ni_pool_usage_unref(&s->pool_usage);
 }
 
 static inline int normalize_xy(double d, int chroma_sub)
@@ -419,6 +424,14 @@ static int init_out_pool(AVFilterContext *ctx)
 
     if (s->api_ctx.isP2P) {
         pool_size = 1;
+    } else {
+        pool_size = ff_ni_pool_plan(ctx, pool_size);
+    }
+
+    ff_ni_pool_usage_unref(&s->pool_usage);
+    s->pool_usage = ff_ni_pool_usage_alloc(pool_size);
+    if (!s->pool_usage) {
+        return AVERROR(ENOMEM);
     }
 #if IS_FFMPEG_61_AND_ABOVE
     s->buffer_limit = 1;
@@ -999,7 +1012,9 @@ static int process_frame(FFFrameSync *fs)
            "%s:IN trace ui16FrameIdx = [%d] and [%d] --> out [%d] \n", __FILE__,
            tempFIDFrame, tempFIDOverlay, frame_surface->ui16FrameIdx);
 
-    out->buf[0] = av_buffer_create(out->data[3], sizeof(niFrameSurface1_t), ff_ni_frame_free, NULL, 0);
+    out->buf[0] = av_buffer_create(out->data[3], sizeof(niFrameSurface1_t), ff_ni_frame_free, s->pool_usage, 0);
+    if (out->buf[0])
+        ff_ni_pool_usage_acquire(s->pool_usage);
 
     return ff_filter_frame(ctx->outputs[0], out);
 }
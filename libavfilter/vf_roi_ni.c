@@ -43,14 +43,19 @@
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "libswscale/swscale.h"
 #include "ni_device_api.h"
 #include "ni_util.h"
+#include "ni_yolo.h"
 #include "nifilter.h"
 #include "video.h"
 
 #define NI_NUM_FRAMES_IN_QUEUE 8
 
+/* decoding on a worker thread needs activate() to flush the last frame */
+#define ROI_ASYNC (HAVE_THREADS && IS_FFMPEG_61_AND_ABOVE)
+
 typedef struct _ni_roi_network_layer {
     int32_t width;
     int32_t height;
@@ -60,7 +65,7 @@ typedef struct _ni_roi_network_layer {
     int32_t mask[3];
     float biases[12];
     int32_t output_number;
-    float *output;
+    float *output[2]; /* second set only used by the async decode */
 } ni_roi_network_layer_t;
 
 typedef struct _ni_roi_network {
@@ -70,26 +75,6 @@ typedef struct _ni_roi_network {
     ni_roi_network_layer_t *layers;
 } ni_roi_network_t;
 
-typedef struct box {
-    float x, y, w, h;
-} box;
-
-typedef struct detection {
-    box bbox;
-    float objectness;
-    int classes;
-    int color;
-    float *prob;
-    int prob_class;
-    float max_prob;
-} detection;
-
-typedef struct detetion_cache {
-    detection *dets;
-    int capacity;
-    int dets_num;
-} detection_cache;
-
 struct roi_box {
     int left;
     int right;
@@ -126,13 +111,31 @@ typedef struct NetIntRoiContext {
     AVBufferRef *out_frames_ref;
 
     ni_roi_network_t network;
-    detection_cache det_cache;
+    NIYoloContext yolo;
+    NIYoloLayer *yolo_layers;
     struct SwsContext *img_cvt_ctx;
     AVFrame rgb_picture;
 
     HwScaleContext *hws_ctx;
     int keep_alive_timeout; /* keep alive timeout setting */
     int buffer_limit;
+
+    const char *dump_file; /* path to dump the raw layer outputs to */
+    FILE *dump_fp;
+
+    int async;      /* decode detections on the worker thread */
+    int cur_buf;    /* layer output set the next inference is read into */
+#if ROI_ASYNC
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int worker_started;
+    int worker_quit;
+    AVFrame *job_frame; /* frame waiting for its detections */
+    int job_buf;
+    int job_done;
+    int job_ret;
+#endif
 } NetIntRoiContext;
 
 /* class */
@@ -143,230 +146,7 @@ typedef struct NetIntRoiContext {
 static int g_masks[2][3] = {{3, 4, 5}, {0, 1, 2}};
 static float g_biases[] = {10, 16, 25, 37, 49, 71, 85, 118, 143, 190, 274, 283};
 
-static int entry_index(ni_roi_network_layer_t *l, int batch, int location,
-                       int entry)
-{
-    int n   = location / (l->width * l->height);
-    int loc = location % (l->width * l->height);
-    return batch * l->output_number +
-           n * l->width * l->height * (4 + l->classes + 1) +
-           entry * l->width * l->height + loc;
-}
-
-static inline float sigmoid(float x)
-{
-    return (float)(1.0 / (1.0 + (float)exp((double)(-x))));
-}
-
-/*
- * nw: network input width
- * nh: network input height
- * lw: layer width
- * lh: layer height
- */
-static box get_yolo_box(float *x, float *biases, int n, int index, int col,
-                        int row, int lw, int lh, int nw, int nh, int stride)
-{
-    box b;
-
-    b.x = (float)((float)col + sigmoid(x[index + 0 * stride])) / (float)lw;
-    b.y = (float)((float)row + sigmoid(x[index + 1 * stride])) / (float)lh;
-    b.w = (float)exp((double)x[index + 2 * stride]) * biases[2 * n] / (float)nw;
-    b.h = (float)exp((double)x[index + 3 * stride]) * biases[2 * n + 1] /
-          (float)nh;
-
-    b.x -= (float)(b.w / 2.0);
-    b.y -= (float)(b.h / 2.0);
-
-    return b;
-}
-
-static int get_yolo_detections(void *ctx, ni_roi_network_layer_t *l, int netw,
-                               int neth, float thresh,
-                               detection_cache *det_cache, int *dets_num)
-{
-    int i, n, k;
-    float *predictions = l->output;
-    float max_prob;
-    int prob_class;
-    // This snippet below is not necessary
-    // Need to comment it in order to batch processing >= 2 images
-    // if (l.batch == 2) avg_flipped_yolo(l);
-    int count       = 0;
-    detection *dets = det_cache->dets;
-    int row;
-    int col;
-    int obj_index;
-    float objectness;
-    int class_index;
-    double prob;
-    int box_index;
-    box bbox;
-
-    *dets_num = 0;
-
-    av_log(ctx, AV_LOG_TRACE,
-           "pic %dx%d, comp=%d, class=%d, net %dx%d, thresh=%f\n", l->width,
-           l->height, l->component, l->classes, netw, neth, thresh);
-    for (i = 0; i < l->width * l->height; ++i) {
-        row = i / l->width;
-        col = i % l->width;
-        for (n = 0; n < l->component; ++n) {
-            obj_index = entry_index(l, 0, n * l->width * l->height + i, 4);
-            objectness = predictions[obj_index];
-            objectness       = sigmoid(objectness);
-
-            prob_class = -1;
-            max_prob   = thresh;
-            for (k = 0; k < l->classes; k++) {
-                class_index =
-                    entry_index(l, 0, n * l->width * l->height + i, 4 + 1 + k);
-                prob = objectness * sigmoid(predictions[class_index]);
-                if (prob >= max_prob) {
-                    prob_class = k;
-                    max_prob   = (float)prob;
-                }
-            }
-
-            if (prob_class >= 0) {
-                box_index =
-                    entry_index(l, 0, n * l->width * l->height + i, 0);
-
-                if (det_cache->dets_num >= det_cache->capacity) {
-                    dets =
-                        realloc(det_cache->dets,
-                                sizeof(detection) * (det_cache->capacity + 10));
-                    if (!dets) {
-                        av_log(ctx, AV_LOG_ERROR,
-                               "failed to realloc detections capacity %d\n",
-                               det_cache->capacity);
-                        return AVERROR(ENOMEM);
-                    }
-                    det_cache->dets = dets;
-                    det_cache->capacity += 10;
-                    if (det_cache->capacity >= 100) {
-                        av_log(ctx, AV_LOG_WARNING, "too many detections %d\n",
-                               det_cache->dets_num);
-                    }
-                }
-
-                av_log(ctx, AV_LOG_TRACE, "max_prob %f, class %d\n", max_prob,
-                       prob_class);
-                bbox = get_yolo_box(predictions, l->biases, l->mask[n],
-                                    box_index, col, row, l->width, l->height,
-                                    netw, neth, l->width * l->height);
-
-                dets[det_cache->dets_num].max_prob   = max_prob;
-                dets[det_cache->dets_num].prob_class = prob_class;
-                dets[det_cache->dets_num].bbox       = bbox;
-                dets[det_cache->dets_num].objectness = objectness;
-                dets[det_cache->dets_num].classes    = l->classes;
-                dets[det_cache->dets_num].color      = n;
-
-                av_log(ctx, AV_LOG_TRACE, "%d, x %f, y %f, w %f, h %f\n",
-                       det_cache->dets_num, dets[det_cache->dets_num].bbox.x,
-                       dets[det_cache->dets_num].bbox.y,
-                       dets[det_cache->dets_num].bbox.w,
-                       dets[det_cache->dets_num].bbox.h);
-                det_cache->dets_num++;
-                count++;
-            }
-        }
-    }
-    *dets_num = count;
-    return 0;
-}
-
-static int nms_comparator(const void *pa, const void *pb)
-{
-    detection *a = (detection *)pa;
-    detection *b = (detection *)pb;
-
-    if (a->prob_class > b->prob_class)
-        return 1;
-    else if (a->prob_class < b->prob_class)
-        return -1;
-    else {
-        if (a->max_prob < b->max_prob)
-            return 1;
-        else if (a->max_prob > b->max_prob)
-            return -1;
-    }
-    return 0;
-}
-
-static float overlap(float x1, float w1, float x2, float w2)
-{
-    float l1    = x1 - w1 / 2;
-    float l2    = x2 - w2 / 2;
-    float left  = l1 > l2 ? l1 : l2;
-    float r1    = x1 + w1 / 2;
-    float r2    = x2 + w2 / 2;
-    float right = r1 < r2 ? r1 : r2;
-    return right - left;
-}
-
-static float box_intersection(box a, box b)
-{
-    float w = overlap(a.x, a.w, b.x, b.w);
-    float h = overlap(a.y, a.h, b.y, b.h);
-    float area;
-
-    if (w < 0 || h < 0)
-        return 0;
-
-    area = w * h;
-    return area;
-}
-
-static float box_union(box a, box b)
-{
-    float i = box_intersection(a, b);
-    float u = a.w * a.h + b.w * b.h - i;
-    return u;
-}
-
-static float box_iou(box a, box b)
-{
-    // return box_intersection(a, b)/box_union(a, b);
-
-    float I = box_intersection(a, b);
-    float U = box_union(a, b);
-    if (I == 0 || U == 0)
-        return 0;
-
-    return I / U;
-}
-
-static int nms_sort(void *ctx, detection *dets, int dets_num, float nms_thresh)
-{
-    int i, j;
-    box boxa, boxb;
-    int class;
-
-    for (i = 0; i < (dets_num - 1); i++) {
-        class = dets[i].prob_class;
-        if (dets[i].max_prob == 0)
-            continue;
-
-        if (dets[i].prob_class != dets[i + 1].prob_class)
-            continue;
-
-        boxa = dets[i].bbox;
-        for (j = i + 1; j < dets_num && dets[j].prob_class == class; j++) {
-            if (dets[j].max_prob == 0)
-                continue;
-
-            boxb = dets[j].bbox;
-            if (box_iou(boxa, boxb) > nms_thresh)
-                dets[j].max_prob = 0;
-        }
-    }
-
-    return 0;
-}
-
-static int resize_coords(void *ctx, detection *dets, int dets_num,
+static int resize_coords(void *ctx, const NIYoloDetection *dets, int dets_num,
                          uint32_t img_width, uint32_t img_height,
                          struct roi_box **roi_box, int *roi_num)
 {
@@ -385,14 +165,14 @@ static int resize_coords(void *ctx, detection *dets, int dets_num,
 
     for (i = 0; i < dets_num; i++) {
         av_log(ctx, AV_LOG_TRACE, "index %d, max_prob %f, class %d\n", i,
-               dets[i].max_prob, dets[i].prob_class);
-        if (dets[i].max_prob == 0)
+               dets[i].prob, dets[i].cls);
+        if (dets[i].prob == 0)
             continue;
 
-        top   = (int)floor(dets[i].bbox.y * img_height + 0.5);
-        left  = (int)floor(dets[i].bbox.x * img_width + 0.5);
-        right = (int)floor((dets[i].bbox.x + dets[i].bbox.w) * img_width + 0.5);
-        bot = (int)floor((dets[i].bbox.y + dets[i].bbox.h) * img_height + 0.5);
+        top   = (int)floor(dets[i].y * img_height + 0.5);
+        left  = (int)floor(dets[i].x * img_width + 0.5);
+        right = (int)floor((dets[i].x + dets[i].w) * img_width + 0.5);
+        bot   = (int)floor((dets[i].y + dets[i].h) * img_height + 0.5);
 
         if (top < 0)
             top = 0;
@@ -413,10 +193,10 @@ static int resize_coords(void *ctx, detection *dets, int dets_num,
         rbox[rbox_num].right      = right;
         rbox[rbox_num].top        = top;
         rbox[rbox_num].bottom     = bot;
-        rbox[rbox_num].cls        = dets[i].prob_class;
+        rbox[rbox_num].cls        = dets[i].cls;
         rbox[rbox_num].objectness = dets[i].objectness;
-        rbox[rbox_num].color      = dets[i].color;
-        rbox[rbox_num].prob       = dets[i].max_prob;
+        rbox[rbox_num].color      = dets[i].anchor;
+        rbox[rbox_num].prob       = dets[i].prob;
         rbox_num++;
     }
 
@@ -432,54 +212,39 @@ static int resize_coords(void *ctx, detection *dets, int dets_num,
     return 0;
 }
 
-static int ni_get_detections(void *ctx, ni_roi_network_t *network,
-                             detection_cache *det_cache, uint32_t img_width,
-                             uint32_t img_height, float obj_thresh,
-                             float nms_thresh, struct roi_box **roi_box,
-                             int *roi_num)
+/* decode the layer outputs of buffer set buf */
+static int ni_get_detections(void *ctx, NetIntRoiContext *s, int buf,
+                             uint32_t img_width, uint32_t img_height,
+                             struct roi_box **roi_box, int *roi_num)
 {
+    ni_roi_network_t *network = &s->network;
+    const NIYoloDetection *dets;
+    int dets_num;
     int i;
     int ret;
-    int dets_num    = 0;
-    detection *dets = NULL;
 
     *roi_box = NULL;
     *roi_num = 0;
 
-    for (i = 0; i < network->raw.output_num; i++) {
-        ret = get_yolo_detections(ctx, &network->layers[i], network->netw,
-                                  network->neth, obj_thresh, det_cache,
-                                  &dets_num);
-        if (ret != 0) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "failed to get yolo detection at layer %d\n", i);
-            return ret;
-        }
-        av_log(ctx, AV_LOG_TRACE, "layer %d, yolo detections: %d\n", i,
-               dets_num);
-    }
+    for (i = 0; i < network->raw.output_num; i++)
+        s->yolo_layers[i].output = network->layers[i].output[buf];
 
-    if (det_cache->dets_num == 0)
-        return 0;
-
-    dets     = det_cache->dets;
-    dets_num = det_cache->dets_num;
-    for (i = 0; i < dets_num; i++) {
-        av_log(ctx, AV_LOG_TRACE,
-               "orig dets %d: x %f,y %f,w %f,h %f,c %d,p %f\n", i,
-               dets[i].bbox.x, dets[i].bbox.y, dets[i].bbox.w, dets[i].bbox.h,
-               dets[i].prob_class, dets[i].max_prob);
+    dets_num = ff_ni_yolo_detect(&s->yolo, s->yolo_layers,
+                                 network->raw.output_num, network->netw,
+                                 network->neth, s->obj_thresh, s->nms_thresh);
+    if (dets_num < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to get yolo detections\n");
+        return dets_num;
     }
 
-    qsort(dets, dets_num, sizeof(detection), nms_comparator);
+    dets = s->yolo.dets;
     for (i = 0; i < dets_num; i++) {
         av_log(ctx, AV_LOG_TRACE,
-               "sorted dets %d: x %f,y %f,w %f,h %f,c %d,p %f\n", i,
-               dets[i].bbox.x, dets[i].bbox.y, dets[i].bbox.w, dets[i].bbox.h,
-               dets[i].prob_class, dets[i].max_prob);
+               "dets %d: x %f,y %f,w %f,h %f,c %d,p %f\n", i,
+               dets[i].x, dets[i].y, dets[i].w, dets[i].h,
+               dets[i].cls, dets[i].prob);
     }
 
-    nms_sort(ctx, dets, dets_num, nms_thresh);
     ret = resize_coords(ctx, dets, dets_num, img_width, img_height, roi_box,
                         roi_num);
     if (ret != 0) {
@@ -643,10 +408,10 @@ static void ni_destroy_network(AVFilterContext *ctx, ni_roi_network_t *network)
 
         if (network->layers) {
             for (i = 0; i < network->raw.output_num; i++) {
-                if (network->layers[i].output) {
-                    free(network->layers[i].output);
-                    network->layers[i].output = NULL;
-                }
+                free(network->layers[i].output[0]);
+                free(network->layers[i].output[1]);
+                network->layers[i].output[0] = NULL;
+                network->layers[i].output[1] = NULL;
             }
 
             free(network->layers);
@@ -655,10 +420,11 @@ static void ni_destroy_network(AVFilterContext *ctx, ni_roi_network_t *network)
     }
 }
 
-static int ni_create_network(AVFilterContext *ctx, ni_roi_network_t *network)
+static int ni_create_network(AVFilterContext *ctx, NetIntRoiContext *s)
 {
+    ni_roi_network_t *network = &s->network;
     int ret;
-    int i;
+    int i, j;
     ni_network_data_t *ni_network = &network->raw;
 
     av_log(ctx, AV_LOG_VERBOSE, "network input number %d, output number %d\n",
@@ -686,6 +452,13 @@ static int ni_create_network(AVFilterContext *ctx, ni_roi_network_t *network)
     memset(network->layers, 0,
            sizeof(ni_roi_network_layer_t) * ni_network->output_num);
 
+    s->yolo_layers = av_calloc(ni_network->output_num, sizeof(*s->yolo_layers));
+    if (!s->yolo_layers) {
+        av_log(ctx, AV_LOG_ERROR, "cannot allocate yolo layers\n");
+        ret = AVERROR(ENOMEM);
+        goto out;
+    }
+
     for (i = 0; i < ni_network->output_num; i++) {
         network->layers[i].width     = ni_network->linfo.out_param[i].sizes[0];
         network->layers[i].height    = ni_network->linfo.out_param[i].sizes[1];
@@ -700,13 +473,15 @@ static int ni_create_network(AVFilterContext *ctx, ni_roi_network_t *network)
                    network->layers[i].width * network->layers[i].height *
                        network->layers[i].channel);
 
-        network->layers[i].output =
-            malloc(network->layers[i].output_number * sizeof(float));
-        if (!network->layers[i].output) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "failed to allocate network layer %d output buffer\n", i);
-            ret = AVERROR(ENOMEM);
-            goto out;
+        for (j = 0; j < (s->async ? 2 : 1); j++) {
+            network->layers[i].output[j] =
+                malloc(network->layers[i].output_number * sizeof(float));
+            if (!network->layers[i].output[j]) {
+                av_log(ctx, AV_LOG_ERROR,
+                       "failed to allocate network layer %d output buffer\n", i);
+                ret = AVERROR(ENOMEM);
+                goto out;
+            }
         }
         memcpy(network->layers[i].mask, &g_masks[i][0],
                sizeof(network->layers[i].mask));
@@ -718,6 +493,14 @@ static int ni_create_network(AVFilterContext *ctx, ni_roi_network_t *network)
                network->layers[i].width, network->layers[i].height,
                network->layers[i].channel, network->layers[i].component,
                network->layers[i].classes);
+
+        s->yolo_layers[i].width     = network->layers[i].width;
+        s->yolo_layers[i].height    = network->layers[i].height;
+        s->yolo_layers[i].classes   = network->layers[i].classes;
+        s->yolo_layers[i].component = network->layers[i].component;
+        s->yolo_layers[i].biases    = network->layers[i].biases;
+        memcpy(s->yolo_layers[i].mask, network->layers[i].mask,
+               sizeof(s->yolo_layers[i].mask));
     }
 
     network->netw = ni_network->linfo.in_param[0].sizes[0];
@@ -726,6 +509,7 @@ static int ni_create_network(AVFilterContext *ctx, ni_roi_network_t *network)
     return 0;
 out:
     ni_destroy_network(ctx, network);
+    av_freep(&s->yolo_layers);
     return ret;
 }
 
@@ -809,15 +593,33 @@ static void cleanup_hwframe_scale(AVFilterContext *ctx, NetIntRoiContext *s)
 static av_cold int init(AVFilterContext *ctx)
 {
     NetIntRoiContext *s = ctx->priv;
+    int ret;
 
-    s->det_cache.dets_num = 0;
-    s->det_cache.capacity = 20;
-    s->det_cache.dets     = malloc(sizeof(detection) * s->det_cache.capacity);
-    if (!s->det_cache.dets) {
-        av_log(ctx, AV_LOG_ERROR, "failed to allocate detection cache\n");
-        return AVERROR(ENOMEM);
+    if (s->dump_file) {
+        s->dump_fp = fopen(s->dump_file, "wb");
+        if (!s->dump_fp) {
+            ret = AVERROR(errno);
+            av_log(ctx, AV_LOG_ERROR, "cannot open %s\n", s->dump_file);
+            return ret;
+        }
     }
 
+#if ROI_ASYNC
+    if (s->async) {
+        if ((ret = pthread_mutex_init(&s->lock, NULL))) {
+            s->async = 0;
+            return AVERROR(ret);
+        }
+        if ((ret = pthread_cond_init(&s->cond, NULL))) {
+            pthread_mutex_destroy(&s->lock);
+            s->async = 0;
+            return AVERROR(ret);
+        }
+    }
+#else
+    s->async = 0;
+#endif
+
     return 0;
 }
 
@@ -826,13 +628,31 @@ static av_cold void uninit(AVFilterContext *ctx)
     NetIntRoiContext *s       = ctx->priv;
     ni_roi_network_t *network = &s->network;
 
+#if ROI_ASYNC
+    if (s->async) {
+        if (s->worker_started) {
+            pthread_mutex_lock(&s->lock);
+            s->worker_quit = 1;
+            pthread_cond_broadcast(&s->cond);
+            pthread_mutex_unlock(&s->lock);
+            pthread_join(s->worker, NULL);
+        }
+        av_frame_free(&s->job_frame);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+    }
+#endif
+
     cleanup_ai_context(ctx, s);
 
     ni_destroy_network(ctx, network);
 
-    if (s->det_cache.dets) {
-        free(s->det_cache.dets);
-        s->det_cache.dets = NULL;
+    ff_ni_yolo_uninit(&s->yolo);
+    av_freep(&s->yolo_layers);
+
+    if (s->dump_fp) {
+        fclose(s->dump_fp);
+        s->dump_fp = NULL;
     }
 
     av_buffer_unref(&s->out_frames_ref);
@@ -862,7 +682,7 @@ static int config_input(AVFilterContext *ctx, AVFrame *frame)
         return ret;
     }
 
-    ret = ni_create_network(ctx, &s->network);
+    ret = ni_create_network(ctx, s);
     if (ret != 0) {
         goto fail_out;
     }
@@ -1000,12 +820,10 @@ static int output_config_props(AVFilterLink *outlink)
     return 0;
 }
 
-static int ni_read_roi(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt,
-                       AVFrame *out, int pic_width, int pic_height)
+/* attach the detections decoded from layer output set buf to out */
+static int ni_attach_roi(AVFilterContext *ctx, AVFrame *out, int buf)
 {
     NetIntRoiContext *s = ctx->priv;
-    ni_retcode_t retval;
-    ni_roi_network_t *network = &s->network;
     AVFrameSideData *sd;
     AVFrameSideData *sd_roi_extra;
     AVRegionOfInterest *roi;
@@ -1014,26 +832,9 @@ static int ni_read_roi(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt,
     int roi_num = 0;
     int ret;
     int i;
-    int width, height;
 
-    for (i = 0; i < network->raw.output_num; i++) {
-        retval = ni_network_layer_convert_output(
-            network->layers[i].output,
-            network->layers[i].output_number * sizeof(float),
-            &p_dst_pkt->data.packet, &network->raw, i);
-        if (retval != NI_RETCODE_SUCCESS) {
-            av_log(ctx, AV_LOG_ERROR,
-                   "failed to read layer %d output. retval %d\n", i, retval);
-            return AVERROR(EIO);
-        }
-    }
-
-    width  = pic_width;
-    height = pic_height;
-
-    s->det_cache.dets_num = 0;
-    ret = ni_get_detections(ctx, network, &s->det_cache, width, height,
-                            s->obj_thresh, s->nms_thresh, &roi_box, &roi_num);
+    ret = ni_get_detections(ctx, s, buf, out->width, out->height, &roi_box,
+                            &roi_num);
     if (ret < 0) {
         av_log(ctx, AV_LOG_ERROR, "failed to get roi.\n");
         return ret;
@@ -1077,6 +878,139 @@ static int ni_read_roi(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt,
     return 0;
 }
 
+static int ni_read_roi(AVFilterContext *ctx, ni_session_data_io_t *p_dst_pkt,
+                       AVFrame *out)
+{
+    NetIntRoiContext *s = ctx->priv;
+    ni_retcode_t retval;
+    ni_roi_network_t *network = &s->network;
+    int i;
+
+    for (i = 0; i < network->raw.output_num; i++) {
+        retval = ni_network_layer_convert_output(
+            network->layers[i].output[s->cur_buf],
+            network->layers[i].output_number * sizeof(float),
+            &p_dst_pkt->data.packet, &network->raw, i);
+        if (retval != NI_RETCODE_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "failed to read layer %d output. retval %d\n", i, retval);
+            return AVERROR(EIO);
+        }
+    }
+
+    /* recorded outputs can be replayed by tools/ni_yolo_bench */
+    if (s->dump_fp) {
+        for (i = 0; i < network->raw.output_num; i++) {
+            if (fwrite(network->layers[i].output[s->cur_buf], sizeof(float),
+                       network->layers[i].output_number, s->dump_fp) !=
+                network->layers[i].output_number) {
+                av_log(ctx, AV_LOG_WARNING, "failed to dump layer outputs\n");
+                fclose(s->dump_fp);
+                s->dump_fp = NULL;
+                break;
+            }
+        }
+    }
+
+    /* the worker decodes the detections once the frame is submitted */
+    if (s->async)
+        return 0;
+
+    return ni_attach_roi(ctx, out, s->cur_buf);
+}
+
+#if ROI_ASYNC
+static void *roi_worker(void *arg)
+{
+    AVFilterContext *ctx = arg;
+    NetIntRoiContext *s  = ctx->priv;
+    AVFrame *frame;
+    int buf, ret;
+
+    pthread_mutex_lock(&s->lock);
+    while (1) {
+        while (!s->worker_quit && (!s->job_frame || s->job_done))
+            pthread_cond_wait(&s->cond, &s->lock);
+        if (s->worker_quit)
+            break;
+
+        frame = s->job_frame;
+        buf   = s->job_buf;
+        pthread_mutex_unlock(&s->lock);
+
+        ret = ni_attach_roi(ctx, frame, buf);
+
+        pthread_mutex_lock(&s->lock);
+        s->job_ret  = ret;
+        s->job_done = 1;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+
+/* wait for the worker and take back the frame it was decoding, if any */
+static int roi_wait_job(AVFilterContext *ctx, AVFrame **frame)
+{
+    NetIntRoiContext *s = ctx->priv;
+    int ret;
+
+    pthread_mutex_lock(&s->lock);
+    while (s->job_frame && !s->job_done)
+        pthread_cond_wait(&s->cond, &s->lock);
+    *frame       = s->job_frame;
+    ret          = s->job_ret;
+    s->job_frame = NULL;
+    s->job_done  = 0;
+    s->job_ret   = 0;
+    pthread_mutex_unlock(&s->lock);
+
+    if (ret < 0)
+        av_frame_free(frame);
+    return ret;
+}
+
+/*
+ * Hand the frame whose layer outputs were just read to the worker and send
+ * out the previous one, so the decode of a frame overlaps the inference of
+ * the next.
+ */
+static int roi_submit_job(AVFilterContext *ctx, AVFrame *out)
+{
+    NetIntRoiContext *s = ctx->priv;
+    AVFrame *prev;
+    int ret;
+
+    if (!s->worker_started) {
+        ret = pthread_create(&s->worker, NULL, roi_worker, ctx);
+        if (ret) {
+            av_log(ctx, AV_LOG_ERROR, "failed to create worker thread\n");
+            av_frame_free(&out);
+            return AVERROR(ret);
+        }
+        s->worker_started = 1;
+    }
+
+    ret = roi_wait_job(ctx, &prev);
+    if (ret < 0) {
+        av_frame_free(&out);
+        return ret;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->job_frame = out;
+    s->job_buf   = s->cur_buf;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    s->cur_buf ^= 1;
+
+    if (!prev)
+        return 0;
+    return ff_filter_frame(ctx->outputs[0], prev);
+}
+#endif
+
 static int ni_recreate_frame(ni_frame_t *ni_frame, AVFrame *frame)
 {
     uint8_t *p_data = ni_frame->p_data[0];
@@ -1282,8 +1216,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                 ret = AVERROR(EIO);
                 goto failed_out;
             } else if (retval > 0) {
-                ret = ni_read_roi(ctx, &ai_ctx->api_dst_pkt, out, out->width,
-                                  out->height);
+                ret = ni_read_roi(ctx, &ai_ctx->api_dst_pkt, out);
                 if (ret != 0) {
                     av_log(ctx, AV_LOG_ERROR,
                            "failed to read roi from packet\n");
@@ -1343,8 +1276,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                 ret = AVERROR(EIO);
                 goto failed_out;
             } else if (retval > 0) {
-                ret = ni_read_roi(ctx, &ai_ctx->api_dst_pkt, out, out->width,
-                                  out->height);
+                ret = ni_read_roi(ctx, &ai_ctx->api_dst_pkt, out);
                 if (ret != 0) {
                     av_log(ctx, AV_LOG_ERROR,
                            "failed to read roi from packet\n");
@@ -1359,6 +1291,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
 #endif
 
     av_frame_free(&in);
+#if ROI_ASYNC
+    if (s->async)
+        return roi_submit_job(ctx, out);
+#endif
     return ff_filter_frame(link->dst->outputs[0], out);
 
 failed_out:
@@ -1377,6 +1313,10 @@ static int activate(AVFilterContext *ctx)
     AVFrame *frame = NULL;
     int ret = 0;
     NetIntRoiContext *s = inlink->dst->priv;
+#if ROI_ASYNC
+    int64_t pts;
+    int status;
+#endif
 
     // Forward the status on output link to input link, if the status is set, discard all queued frames
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
@@ -1407,6 +1347,19 @@ static int activate(AVFilterContext *ctx)
         return ret;
     }
 
+#if ROI_ASYNC
+    // Send the frame still being decoded before forwarding EOF
+    if (s->async && ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        ret = roi_wait_job(ctx, &frame);
+        if (ret >= 0 && frame)
+            ret = ff_filter_frame(outlink, frame);
+        if (ret < 0)
+            return ret;
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
+#endif
+
     // We did not get a frame from input link, check its status
     FF_FILTER_FORWARD_STATUS(inlink, outlink);
 
@@ -1426,6 +1379,10 @@ static const AVOption ni_roi_options[] = {
     { "devid",      "device to operate in swframe mode",        OFFSET(devid),      AV_OPT_TYPE_INT,      {.i64 = 0},    -1,       INT_MAX,  FLAGS, "range" },
     { "obj_thresh", "objectness threshold",                     OFFSET(obj_thresh), AV_OPT_TYPE_FLOAT,    {.dbl = 0.25}, -FLT_MAX, FLT_MAX,  FLAGS, "range" },
     { "nms_thresh", "yolov4 non-maximum suppression threshold", OFFSET(nms_thresh), AV_OPT_TYPE_FLOAT,    {.dbl = 0.45}, -FLT_MAX, FLT_MAX,  FLAGS, "range" },
+    { "dump",       "file to write the raw layer outputs to",   OFFSET(dump_file),  AV_OPT_TYPE_STRING,   {.str = NULL}, 0,        0,        FLAGS },
+#if ROI_ASYNC
+    { "async",      "decode detections on a worker thread, delays output by one frame", OFFSET(async), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
+#endif
     NI_FILT_OPTION_KEEPALIVE,
     NI_FILT_OPTION_BUFFER_LIMIT,
 {NULL}};
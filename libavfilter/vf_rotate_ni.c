@@ -79,6 +79,8 @@ typedef struct NetIntRotContext {
 
     AVBufferRef *out_frames_ref;
 
+    NIPoolUsage *pool_usage;
+
     ni_session_context_t api_ctx;
     ni_session_data_io_t api_dst_frame;
 
@@ -141,6 +143,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     av_buffer_unref(&rot->out_frames_ref);
 
+    ff_ni_pool_usage_report(rot->pool_usage, ctx);
+    ff_ni_pool_usage_unref(&rot->pool_usage);
 }
 
 static double get_rotated_w(void *opaque, double angle)
@@ -405,6 +409,14 @@ static int init_out_pool(AVFilterContext *ctx)
 
     if (rot->api_ctx.isP2P) {
         pool_size = 1;
+    } else {
+        pool_size = ff_ni_pool_plan(ctx, pool_size);
+    }
+
+    ff_ni_pool_usage_unref(&rot->pool_usage);
+    rot->pool_usage = ff_ni_pool_usage_alloc(pool_size);
+    if (!rot->pool_usage) {
+        return AVERROR(ENOMEM);
     }
 #if IS_FFMPEG_61_AND_ABOVE
     rot->buffer_limit = 1;
@@ -715,13 +727,14 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     out->buf[0] = av_buffer_create(out->data[3],
                                    sizeof(niFrameSurface1_t),
                                    ff_ni_frame_free,
-                                   NULL,
+                                   rot->pool_usage,
                                    0);
     if (!out->buf[0]) {
         av_log(ctx, AV_LOG_ERROR, "ni rotate filter av_buffer_create returned NULL\n");
         retcode = AVERROR(ENOMEM);
         goto FAIL;
     }
+    ff_ni_pool_usage_acquire(rot->pool_usage);
 
     av_frame_free(&in);
     return ff_filter_frame(inlink->dst->outputs[0], out);
@@ -24,10 +24,12 @@
  * scale video filter
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "nifilter.h"
+#include "ni_scale_cache.h"
 #include "filters.h"
 #include "formats.h"
 #if !IS_FFMPEG_71_AND_ABOVE
@@ -44,6 +46,7 @@
 #endif
 #include "video.h"
 #include "libavutil/avstring.h"
+#include "libavutil/crc.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
@@ -150,6 +153,7 @@ typedef struct NetIntScaleContext {
 
     enum AVPixelFormat out_format;
     AVBufferRef *out_frames_ref;
+    NIPoolUsage *pool_usage;
     AVBufferRef *out_frames_ref_1;
 
     ni_session_context_t api_ctx;
@@ -169,6 +173,12 @@ typedef struct NetIntScaleContext {
     AVExpr *w_pexpr;
     AVExpr *h_pexpr;
     double var_values[VARS_NB];
+
+    int cache;
+    AVBufferRef *cache_ref;     ///< NIScaleCache shared in the graph
+    uint32_t cache_params;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
 } NetIntScaleContext;
 
 AVFilter ff_vf_scale_ni;
@@ -366,6 +376,55 @@ static int query_formats(AVFilterContext *ctx)
     return ff_set_common_formats(ctx, formats);
 }
 
+/* Share the cache of the other scalers of the graph, or start it */
+static int cache_attach(AVFilterContext *ctx)
+{
+    NetIntScaleContext *scale = ctx->priv;
+
+    for (unsigned i = 0; i < ctx->graph->nb_filters; i++) {
+        AVFilterContext *f = ctx->graph->filters[i];
+        NetIntScaleContext *other;
+
+        if (f == ctx || f->filter != ctx->filter)
+            continue;
+        other = f->priv;
+        if (other->cache_ref) {
+            scale->cache_ref = av_buffer_ref(other->cache_ref);
+            return scale->cache_ref ? 0 : AVERROR(ENOMEM);
+        }
+    }
+
+    scale->cache_ref = ff_ni_scale_cache_alloc();
+    return scale->cache_ref ? 0 : AVERROR(ENOMEM);
+}
+
+/*
+ * Frames of our pool the other scalers of the graph may pass on to their
+ * branches, when they make the same picture and take it from the cache:
+ * as many as the pool of each of them would hold, less the frame written.
+ */
+static int cache_sharers_demand(AVFilterContext *ctx)
+{
+    NetIntScaleContext *scale = ctx->priv;
+    int demand = 0;
+
+    for (unsigned i = 0; i < ctx->graph->nb_filters; i++) {
+        AVFilterContext *f = ctx->graph->filters[i];
+        NetIntScaleContext *other;
+
+        if (f == ctx || f->filter != ctx->filter)
+            continue;
+        other = f->priv;
+        if (!other->cache || other->out_format != scale->out_format ||
+            f->outputs[0]->w != ctx->outputs[0]->w ||
+            f->outputs[0]->h != ctx->outputs[0]->h)
+            continue;
+        demand += FFMAX(ff_ni_pool_plan_demand(f) + FFMAX(f->extra_hw_frames, 0),
+                        DEFAULT_NI_FILTER_POOL_SIZE - 1);
+    }
+    return demand;
+}
+
 #if (LIBAVFILTER_VERSION_MAJOR > 9 || (LIBAVFILTER_VERSION_MAJOR == 9 && LIBAVFILTER_VERSION_MINOR >= 3))
 static av_cold int init(AVFilterContext *ctx)
 #else
@@ -375,6 +434,12 @@ static av_cold int init_dict(AVFilterContext *ctx, AVDictionary **opts)
     NetIntScaleContext *scale = ctx->priv;
     int ret;
 
+    if (scale->cache) {
+        ret = cache_attach(ctx);
+        if (ret < 0)
+            return ret;
+    }
+
     if (scale->size_str && (scale->w_expr || scale->h_expr)) {
         av_log(ctx, AV_LOG_ERROR,
                "Size and width/height expressions cannot be set at the same time.\n");
@@ -427,6 +492,13 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     NetIntScaleContext *scale = ctx->priv;
 
+    if (scale->cache_ref) {
+        ff_ni_scale_cache_purge((NIScaleCache *)scale->cache_ref->data, scale);
+        av_buffer_unref(&scale->cache_ref);
+        av_log(ctx, AV_LOG_VERBOSE, "cache: %"PRIu64" hits, %"PRIu64" misses\n",
+               scale->cache_hits, scale->cache_misses);
+    }
+
     av_expr_free(scale->w_pexpr);
     av_expr_free(scale->h_pexpr);
     scale->w_pexpr = scale->h_pexpr = NULL;
@@ -443,6 +515,9 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     av_buffer_unref(&scale->out_frames_ref);
     av_buffer_unref(&scale->out_frames_ref_1);
+
+    ff_ni_pool_usage_report(scale->pool_usage, ctx);
+    ff_ni_pool_usage_unref(&scale->pool_usage);
 }
 
 static int init_out_pool(AVFilterContext *ctx)
@@ -458,6 +533,18 @@ static int init_out_pool(AVFilterContext *ctx)
 
     if (s->api_ctx.isP2P) {
         pool_size = 1;
+    } else {
+        pool_size = ff_ni_pool_plan(ctx, pool_size);
+        // the shared picture is held until the next one is made, and the
+        // other scalers taking it from the cache hold it on their branches
+        if (s->cache)
+            pool_size += 1 + cache_sharers_demand(ctx);
+    }
+
+    ff_ni_pool_usage_unref(&s->pool_usage);
+    s->pool_usage = ff_ni_pool_usage_alloc(pool_size);
+    if (!s->pool_usage) {
+        return AVERROR(ENOMEM);
     }
 
 #if IS_FFMPEG_61_AND_ABOVE
@@ -731,6 +818,63 @@ static int request_frame_ref(AVFilterLink *outlink)
     return ff_request_frame(outlink->src->inputs[1]);
 }
 
+/* Settings besides the geometry and format that change the output picture */
+static uint32_t cache_params(NetIntScaleContext *scale)
+{
+    char buf[128];
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "%s:%s:%d:%d:%g:%g",
+                   scale->in_color_matrix  ? scale->in_color_matrix  : "",
+                   scale->out_color_matrix ? scale->out_color_matrix : "",
+                   scale->output_compressed, scale->params.filterblit,
+#if ((LIBXCODER_API_VERSION_MAJOR > 2) ||                                        \
+      (LIBXCODER_API_VERSION_MAJOR == 2 && LIBXCODER_API_VERSION_MINOR>= 76))
+                   scale->params.scaler_param_b, scale->params.scaler_param_c
+#else
+                   0.0, 0.0
+#endif
+                   );
+    return av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0, buf,
+                  FFMIN(len, sizeof(buf) - 1));
+}
+
+static void cache_key(NetIntScaleContext *scale, AVFilterLink *outlink,
+                      niFrameSurface1_t *surface, NIScaleKey *key)
+{
+    memset(key, 0, sizeof(*key));
+    key->device     = surface->device_handle;
+    key->session_id = surface->ui16session_ID;
+    key->frame_idx  = surface->ui16FrameIdx;
+    key->node       = surface->ui32nodeAddress;
+    key->w          = outlink->w;
+    key->h          = outlink->h;
+    key->format     = scale->out_format;
+    key->params     = scale->cache_params;
+}
+
+/*
+ * A cached output stays in the frames context of the scaler that made it;
+ * it can only be passed on if that context matches the one of our link.
+ */
+static int cache_frames_match(NetIntScaleContext *scale, const AVFrame *out)
+{
+    AVHWFramesContext *ours, *theirs;
+
+    if (!out->hw_frames_ctx)
+        return 0;
+    if (out->hw_frames_ctx->data == scale->out_frames_ref->data)
+        return 1;
+
+    ours   = (AVHWFramesContext *)scale->out_frames_ref->data;
+    theirs = (AVHWFramesContext *)out->hw_frames_ctx->data;
+    return ours->device_ref->data == theirs->device_ref->data &&
+           ours->format    == theirs->format &&
+           ours->sw_format == theirs->sw_format &&
+           ours->width     == theirs->width &&
+           ours->height    == theirs->height;
+}
+
 /* Process a received frame */
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
@@ -744,6 +888,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     int scaler_format, cardno;
     uint16_t tempFID;
     uint16_t options;
+    NIScaleKey key;
 
     frame_surface = (niFrameSurface1_t *) in->data[3];
     if (frame_surface == NULL) {
@@ -844,9 +989,48 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                    "WARNING: Full color range input, limited color range output\n");
         }
 
+        scale->cache_params = cache_params(scale);
         scale->initialized = 1;
     }
 
+    if (scale->cache) {
+        cache_key(scale, outlink, frame_surface, &key);
+
+        out = av_frame_alloc();
+        if (!out) {
+            retcode = AVERROR(ENOMEM);
+            goto fail;
+        }
+        retcode = ff_ni_scale_cache_get((NIScaleCache *)scale->cache_ref->data,
+                                        &key, out);
+        if (retcode < 0)
+            goto fail;
+        if (retcode > 0 && !cache_frames_match(scale, out)) {
+            av_frame_unref(out);
+            retcode = 0;
+        }
+        if (retcode > 0) {
+            /* the surface is shared, the properties are those of our input */
+            retcode = av_frame_copy_props(out, in);
+            if (retcode < 0)
+                goto fail;
+            out->color_range = AVCOL_RANGE_MPEG;
+#if !IS_FFMPEG_342_AND_ABOVE
+            out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+#endif
+
+            scale->cache_hits++;
+            av_log(link->dst, AV_LOG_DEBUG,
+                   "vf_scale_ni.c:IN trace ui16FrameIdx = [%d] --> shared out [%d]\n",
+                   frame_surface->ui16FrameIdx,
+                   ((niFrameSurface1_t *)out->data[3])->ui16FrameIdx);
+            av_frame_free(&in);
+            return ff_filter_frame(outlink, out);
+        }
+        av_frame_free(&out);
+        scale->cache_misses++;
+    }
+
     scaler_format = ff_ni_ffmpeg_to_gc620_pix_fmt(pAVHFWCtx->sw_format);
 
     retcode = ni_frame_buffer_alloc_hwenc(&scale->api_dst_frame.data.frame,
@@ -993,7 +1177,16 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
            tempFID, frame_surface->ui16FrameIdx);
 
     out->buf[0] = av_buffer_create(out->data[3], sizeof(niFrameSurface1_t),
-                                   ff_ni_frame_free, NULL, 0);
+                                   ff_ni_frame_free, scale->pool_usage, 0);
+    if (out->buf[0])
+        ff_ni_pool_usage_acquire(scale->pool_usage);
+
+    if (scale->cache && out->buf[0]) {
+        // a failure only costs the other scalers a scaling
+        if (ff_ni_scale_cache_put((NIScaleCache *)scale->cache_ref->data,
+                                  scale, &key, in->buf[0], out) < 0)
+            av_log(link->dst, AV_LOG_WARNING, "Can't share output frame\n");
+    }
 
     av_frame_free(&in);
 
@@ -1006,6 +1199,23 @@ fail:
     return retcode;
 }
 
+static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
+                           char *res, int res_len, int flags)
+{
+    NetIntScaleContext *scale = ctx->priv;
+
+    if (!strcmp(cmd, "cache_stats")) {
+        av_log(ctx, AV_LOG_INFO, "cache: %"PRIu64" hits, %"PRIu64" misses\n",
+               scale->cache_hits, scale->cache_misses);
+        if (res)
+            snprintf(res, res_len, "hits=%"PRIu64" misses=%"PRIu64"\n",
+                     scale->cache_hits, scale->cache_misses);
+        return 0;
+    }
+
+    return AVERROR(ENOSYS);
+}
+
 static int filter_frame_ref(AVFilterLink *link, AVFrame *in)
 {
     AVFilterLink *outlink = link->dst->outputs[1];
@@ -1101,6 +1311,7 @@ static const AVOption ni_scale_options[] = {
     { "param_c", "Parameter C for bicubic", OFFSET(params.scaler_param_c), AV_OPT_TYPE_DOUBLE, {.dbl=0.75}, 0, 1, FLAGS },
 #endif
     { "autoselect", "auto select filterblit mode according to resolution", OFFSET(autoselect), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
+    { "cache", "share the output with the other scalers of the graph making the same picture", OFFSET(cache), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     NI_FILT_OPTION_AUTO_SKIP,
     NI_FILT_OPTION_IS_P2P,
     NI_FILT_OPTION_KEEPALIVE,
@@ -1147,6 +1358,7 @@ AVFilter ff_vf_scale_ni_quadra = {
 #if IS_FFMPEG_61_AND_ABOVE
     .activate       = activate,
 #endif
+    .process_command = process_command,
     .priv_size      = sizeof(NetIntScaleContext),
     .priv_class     = &ni_scale_class,
 // only FFmpeg 3.4.2 and above have .flags_internal
@@ -1210,6 +1422,7 @@ AVFilter ff_vf_scale2ref_ni_quadra = {
     .init_dict       = init_dict,
 #endif
     .uninit          = uninit,
+    .process_command = process_command,
     .priv_size       = sizeof(NetIntScaleContext),
     .priv_class      = &ni_scale2ref_class,
     // only FFmpeg 3.4.2 and above have .flags_internal
@@ -24,9 +24,11 @@
  * audio and video splitter
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 
 #include "libavutil/attributes.h"
+#include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
@@ -44,11 +46,10 @@
 
 #include "avfilter.h"
 #include "audio.h"
+#include "filters.h"
 #include "formats.h"
 #if !IS_FFMPEG_71_AND_ABOVE
 #include "internal.h"
-#else
-#include "filters.h"
 #endif
 #include "video.h"
 
@@ -62,8 +63,37 @@ typedef struct NetIntSplitContext {
     int frame_contexts_applied;
     ni_split_context_t src_ctx;
     AVBufferRef *out_frames_ref[3];
+
+    /* software outputs, after the hardware ones */
+    char *download;
+    int nb_downloads;
+    int *download_ppu;              ///< PPU output fed to each of them
+    int download_format[3];
+    AVFrame *sw_frames[3];          ///< download of each PPU output, per frame
+    uint64_t nb_transfers;
 } NetIntSplitContext;
 
+/* PPU output (0, 1 or 2) an output pad carries */
+static int output_ppu(const NetIntSplitContext *s, int i)
+{
+    if (i >= s->total_outputs)
+        return s->download_ppu[i - s->total_outputs];
+    if (i < s->nb_output0)
+        return 0;
+    return i < s->nb_output0 + s->nb_output1 ? 1 : 2;
+}
+
+static int output_closed(AVFilterLink *outlink)
+{
+#if IS_FFMPEG_70_AND_ABOVE
+    return !!ff_link_internal(outlink)->status_in;
+#elif IS_FFMPEG_342_AND_ABOVE
+    return !!outlink->status_in;
+#else
+    return !!outlink->status;
+#endif
+}
+
 #if IS_FFMPEG_342_AND_ABOVE
 static int config_output(AVFilterLink *link);
 #endif
@@ -88,8 +118,17 @@ static int query_formats(AVFilterContext *ctx)
         AV_PIX_FMT_NI_QUAD,
         AV_PIX_FMT_NONE,
     };
+    static const enum AVPixelFormat download_pix_fmts[] = {
+        AV_PIX_FMT_YUV420P,
+        AV_PIX_FMT_YUV420P10LE,
+        AV_PIX_FMT_NV12,
+        AV_PIX_FMT_P010LE,
+        AV_PIX_FMT_NONE,
+    };
+    NetIntSplitContext *s = ctx->priv;
     AVFilterFormats *in_fmts = ff_make_format_list(input_pix_fmts);
     AVFilterFormats *out_fmts = ff_make_format_list(output_pix_fmts);
+    int i;
 
     // Needed for FFmpeg-n4.4+
 #if (LIBAVFILTER_VERSION_MAJOR >= 8 || LIBAVFILTER_VERSION_MAJOR >= 7 && LIBAVFILTER_VERSION_MINOR >= 110)
@@ -97,21 +136,65 @@ static int query_formats(AVFilterContext *ctx)
     ff_formats_ref(in_fmts, &ctx->inputs[0]->outcfg.formats);
     // NOLINTNEXTLINE(clang-diagnostic-unused-result)
     ff_formats_ref(out_fmts, &ctx->outputs[0]->incfg.formats);
+    for (i = s->total_outputs; i < ctx->nb_outputs; i++)
+        // NOLINTNEXTLINE(clang-diagnostic-unused-result)
+        ff_formats_ref(ff_make_format_list(download_pix_fmts),
+                       &ctx->outputs[i]->incfg.formats);
 #else
     // NOLINTNEXTLINE(clang-diagnostic-unused-result)
     ff_formats_ref(in_fmts, &ctx->inputs[0]->out_formats);
     // NOLINTNEXTLINE(clang-diagnostic-unused-result)
     ff_formats_ref(out_fmts, &ctx->outputs[0]->in_formats);
+    for (i = s->total_outputs; i < ctx->nb_outputs; i++)
+        // NOLINTNEXTLINE(clang-diagnostic-unused-result)
+        ff_formats_ref(ff_make_format_list(download_pix_fmts),
+                       &ctx->outputs[i]->in_formats);
 #endif
 
     return 0;
 }
 
+/* "download" lists the PPU output each software output takes, e.g. "0|2" */
+static int parse_download(AVFilterContext *ctx)
+{
+    NetIntSplitContext *s = ctx->priv;
+    const char *p = s->download;
+    char *arg;
+    int ppu;
+
+    while (p && *p) {
+        arg = av_get_token(&p, "|");
+        if (!arg)
+            return AVERROR(ENOMEM);
+        if (sscanf(arg, "%d", &ppu) != 1 || ppu < 0 || ppu > 2) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid PPU output '%s' in download\n", arg);
+            av_free(arg);
+            return AVERROR(EINVAL);
+        }
+        av_free(arg);
+        if (*p)
+            p++;
+
+        if (av_reallocp_array(&s->download_ppu, s->nb_downloads + 1,
+                              sizeof(*s->download_ppu)) < 0) {
+            s->nb_downloads = 0;
+            return AVERROR(ENOMEM);
+        }
+        s->download_ppu[s->nb_downloads++] = ppu;
+    }
+    return 0;
+}
+
 static av_cold int split_init(AVFilterContext *ctx)
 {
     NetIntSplitContext *s = ctx->priv;
     int i, ret;
 
+    for (i = 0; i < 3; i++)
+        s->download_format[i] = AV_PIX_FMT_NONE;
+    if ((ret = parse_download(ctx)) < 0)
+        return ret;
+
     av_log(ctx, AV_LOG_DEBUG, "ni_quadra_split INIT out0,1,2 = %d %d %d ctx->nb_outputs = %d\n",
         s->nb_output0, s->nb_output1, s->nb_output2,
         ctx->nb_outputs);
@@ -124,7 +207,7 @@ static av_cold int split_init(AVFilterContext *ctx)
 
     s->total_outputs = s->nb_output0 + s->nb_output1 + s->nb_output2;
     //ctx->nb_outputs = s->total_outputs;
-    for (i = 0; i < s->total_outputs; i++) {
+    for (i = 0; i < s->total_outputs + s->nb_downloads; i++) {
         char name[32];
         AVFilterPad pad = { 0 };
 
@@ -164,7 +247,13 @@ static av_cold void split_uninit(AVFilterContext *ctx)
     for (i = 0; i < 3; i++) {
         if (s->out_frames_ref[i])
             av_buffer_unref(&s->out_frames_ref[i]);
+        av_frame_free(&s->sw_frames[i]);
     }
+
+    if (s->nb_downloads)
+        av_log(ctx, AV_LOG_VERBOSE, "%"PRIu64" downloads for %d software "
+               "outputs\n", s->nb_transfers, s->nb_downloads);
+    av_freep(&s->download_ppu);
 }
 
 #if IS_FFMPEG_342_AND_ABOVE
@@ -308,17 +397,11 @@ static int init_out_hwctxs(AVFilterContext *ctx, AVFrame *in)
             ((AVNIFramesContext *) out_frames_ctx[i]->hwctx)->split_ctx.enabled = 0;
         }
 
-        for (i = 0; i < ctx->nb_outputs; i++) {
+        for (i = 0; i < s->total_outputs; i++) {
 #if IS_FFMPEG_71_AND_ABOVE
             FilterLink *lo = ff_filter_link(ctx->outputs[i]);
             av_buffer_unref(&lo->hw_frames_ctx);
-            if (i < s->nb_output0) {
-                j = 0;
-            } else if (i < s->nb_output0 + s->nb_output1) {
-                j = 1;
-            } else {
-                j = 2;
-            }
+            j = output_ppu(s, i);
             lo->hw_frames_ctx =
                 av_buffer_ref(s->out_frames_ref[j]);
 
@@ -334,13 +417,7 @@ static int init_out_hwctxs(AVFilterContext *ctx, AVFrame *in)
                    lo->hw_frames_ctx);
 #else
             av_buffer_unref(&ctx->outputs[i]->hw_frames_ctx);
-            if (i < s->nb_output0) {
-                j = 0;
-            } else if (i < s->nb_output0 + s->nb_output1) {
-                j = 1;
-            } else {
-                j = 2;
-            }
+            j = output_ppu(s, i);
             ctx->outputs[i]->hw_frames_ctx =
                 av_buffer_ref(s->out_frames_ref[j]);
 
@@ -357,7 +434,7 @@ static int init_out_hwctxs(AVFilterContext *ctx, AVFrame *in)
 #endif
         }
     } else { // no possibility of using extra outputs
-        for (i = 0; i < ctx->nb_outputs; i++) {
+        for (i = 0; i < s->total_outputs; i++) {
 #if IS_FFMPEG_71_AND_ABOVE
             FilterLink *lo = ff_filter_link(ctx->outputs[i]);
             av_buffer_unref(&lo->hw_frames_ctx);
@@ -400,19 +477,35 @@ static int config_output(AVFilterLink *link, AVFrame *in)
     // fairly trivial assignments here so no performance worries
     AVFilterContext *ctx = link->src;
     NetIntSplitContext *s = ctx->priv;
-    int i, ret;
+    int i, j, ret;
+
+    for (i = s->total_outputs; i < ctx->nb_outputs; i++) {
+        // one download per PPU output is shared by its software outputs
+        j = output_ppu(s, i);
+        if (s->download_format[j] == AV_PIX_FMT_NONE)
+            s->download_format[j] = ctx->outputs[i]->format;
+        if (ctx->outputs[i]->format != s->download_format[j]) {
+            av_log(ctx, AV_LOG_ERROR, "Software outputs of PPU output %d "
+                   "must have the same pixel format\n", j);
+            return AVERROR(EINVAL);
+        }
+        if (ctx->inputs[0]->format != AV_PIX_FMT_NI_QUAD &&
+            ctx->outputs[i]->format != ctx->inputs[0]->format) {
+            av_log(ctx, AV_LOG_ERROR, "Software outputs of a software input "
+                   "must have its pixel format\n");
+            return AVERROR(EINVAL);
+        }
+        if (s->src_ctx.enabled != 1 && j != 0) {
+            av_log(ctx, AV_LOG_ERROR, "PPU output %d is not enabled on the "
+                   "decoder\n", j);
+            return AVERROR(EINVAL);
+        }
+    }
 
     for (i = 0; i < ctx->nb_outputs; i++) {
-        if (i < s->nb_output0) {
-            ctx->outputs[i]->w = s->src_ctx.w[0];
-            ctx->outputs[i]->h = s->src_ctx.h[0];
-        } else if (i < s->nb_output0 + s->nb_output1) {
-            ctx->outputs[i]->w = s->src_ctx.w[1];
-            ctx->outputs[i]->h = s->src_ctx.h[1];
-        } else {
-            ctx->outputs[i]->w = s->src_ctx.w[2];
-            ctx->outputs[i]->h = s->src_ctx.h[2];
-        }
+        j = output_ppu(s, i);
+        ctx->outputs[i]->w = s->src_ctx.w[j];
+        ctx->outputs[i]->h = s->src_ctx.h[j];
         av_log(ctx, AV_LOG_DEBUG,
                "ni_split config_output[%d] w x h = %d x %d\n", i,
                ctx->outputs[i]->w, ctx->outputs[i]->h);
@@ -430,12 +523,131 @@ static int config_output(AVFilterLink *link, AVFrame *in)
     return 0;
 }
 
+/* Wrap the surface of one PPU output of a decoded frame in a frame of its own. */
+static int ppu_frame(AVFilterContext *ctx, AVFrame *frame, int ppu, AVFrame **out)
+{
+    NetIntSplitContext *s = ctx->priv;
+    niFrameSurface1_t *p_data3;
+    AVFrame *buf_out;
+
+    if (!frame->buf[ppu])
+        return AVERROR(ENOMEM);
+
+    buf_out = av_frame_alloc();
+    if (!buf_out)
+        return AVERROR(ENOMEM);
+    av_frame_copy_props(buf_out, frame);
+
+    buf_out->format        = frame->format;
+    buf_out->buf[0]        = av_buffer_ref(frame->buf[ppu]);
+    buf_out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref[ppu]);
+    if (!buf_out->buf[0] || !buf_out->hw_frames_ctx) {
+        av_frame_free(&buf_out);
+        return AVERROR(ENOMEM);
+    }
+    buf_out->data[3] = buf_out->buf[0]->data;
+    p_data3 = (niFrameSurface1_t*)((uint8_t*)buf_out->data[3]);
+
+    buf_out->width  = p_data3->ui16width;
+    buf_out->height = p_data3->ui16height;
+
+    *out = buf_out;
+    return 0;
+}
+
+/*
+ * Download a PPU output of the frame once, all the software outputs taking
+ * it get a reference to the same copy.
+ */
+static int download_ppu(AVFilterContext *ctx, AVFrame *frame, int ppu)
+{
+    NetIntSplitContext *s = ctx->priv;
+    AVFrame *hw_frame = frame, *sw_frame;
+    int ret;
+
+    if (s->src_ctx.enabled == 1) {
+        ret = ppu_frame(ctx, frame, ppu, &hw_frame);
+        if (ret < 0)
+            return ret;
+    }
+
+    sw_frame = av_frame_alloc();
+    if (!sw_frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    sw_frame->format = s->download_format[ppu];
+
+    ret = av_hwframe_transfer_data(sw_frame, hw_frame, 0);
+    if (ret >= 0)
+        ret = av_frame_copy_props(sw_frame, frame);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to download PPU output %d\n", ppu);
+        av_frame_free(&sw_frame);
+        goto end;
+    }
+
+    s->sw_frames[ppu] = sw_frame;
+    s->nb_transfers++;
+
+end:
+    if (hw_frame != frame)
+        av_frame_free(&hw_frame);
+    return ret;
+}
+
+/* Send a software output its copy of the frame, downloading it if needed. */
+static int send_sw_output(AVFilterContext *ctx, int i, AVFrame *frame)
+{
+    NetIntSplitContext *s = ctx->priv;
+    int ppu = output_ppu(s, i);
+    AVFrame *buf_out;
+    int ret;
+
+    if (frame->format == AV_PIX_FMT_NI_QUAD) {
+        if (!s->sw_frames[ppu]) {
+            ret = download_ppu(ctx, frame, ppu);
+            if (ret < 0)
+                return ret;
+        }
+        buf_out = av_frame_clone(s->sw_frames[ppu]);
+    } else {
+        buf_out = av_frame_clone(frame);
+    }
+    if (!buf_out)
+        return AVERROR(ENOMEM);
+
+    return ff_filter_frame(ctx->outputs[i], buf_out);
+}
+
+/*
+ * Feed the software outputs. A PPU output is only downloaded if an open
+ * software output takes it, and only once for all of them.
+ */
+static int filter_sw_outputs(AVFilterContext *ctx, AVFrame *frame)
+{
+    NetIntSplitContext *s = ctx->priv;
+    int i, ret = 0;
+
+    for (i = s->total_outputs; i < ctx->nb_outputs; i++) {
+        if (output_closed(ctx->outputs[i]))
+            continue;
+
+        ret = send_sw_output(ctx, i, frame);
+        if (ret < 0)
+            break;
+    }
+
+    for (i = 0; i < 3; i++)
+        av_frame_free(&s->sw_frames[i]);
+    return ret;
+}
+
 static int filter_ni_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     NetIntSplitContext *s = ctx->priv;
     int i, ret = AVERROR_EOF;
-    int output_index;
     niFrameSurface1_t *p_data3;
 
     if (!s->initialized) {
@@ -449,51 +661,19 @@ static int filter_ni_frame(AVFilterLink *inlink, AVFrame *frame)
         s->initialized = 1;
     }
 
-    for (i = 0; i < ctx->nb_outputs; i++) {
+    for (i = 0; i < s->total_outputs; i++) {
         AVFrame *buf_out;
-#if IS_FFMPEG_70_AND_ABOVE
-        FilterLinkInternal* const li = ff_link_internal(ctx->outputs[i]);
-        if (li->status_in)
-#elif IS_FFMPEG_342_AND_ABOVE
-        if (ctx->outputs[i]->status_in)
-#else
-        if (ctx->outputs[i]->status)
-#endif
+
+        if (output_closed(ctx->outputs[i]))
             continue;
 
-        buf_out = av_frame_alloc();
-        if (!buf_out) {
-            ret = AVERROR(ENOMEM);
+        ret = ppu_frame(ctx, frame, output_ppu(s, i), &buf_out);
+        if (ret < 0)
             break;
-        }
-        av_frame_copy_props(buf_out, frame);
-
-        buf_out->format = frame->format;
-
-        if (i < s->nb_output0) {
-            output_index = 0;
-        } else if (i < s->nb_output0 + s->nb_output1) {
-            if (!frame->buf[1]) {
-                ret = AVERROR(ENOMEM);
-                av_frame_free(&buf_out);
-                break;
-            }
-            output_index = 1;
-        } else {
-            if (!frame->buf[2]) {
-                ret = AVERROR(ENOMEM);
-                av_frame_free(&buf_out);
-                break;
-            }
-            output_index = 2;
-        }
-        buf_out->buf[0]        = av_buffer_ref(frame->buf[output_index]);
-        buf_out->hw_frames_ctx = av_buffer_ref(s->out_frames_ref[output_index]);
-        buf_out->data[3] = buf_out->buf[0]->data;
         p_data3 = (niFrameSurface1_t*)((uint8_t*)buf_out->data[3]);
 
-        buf_out->width = ctx->outputs[i]->w = p_data3->ui16width;
-        buf_out->height = ctx->outputs[i]->h = p_data3->ui16height;
+        ctx->outputs[i]->w = buf_out->width;
+        ctx->outputs[i]->h = buf_out->height;
 
         av_log(ctx, AV_LOG_DEBUG, "output %d supplied WxH = %d x %d FID %d offset %d\n",
                i, buf_out->width, buf_out->height,
@@ -503,6 +683,8 @@ static int filter_ni_frame(AVFilterLink *inlink, AVFrame *frame)
         if (ret < 0)
             break;
     }
+    if (s->nb_downloads && (ret >= 0 || ret == AVERROR_EOF))
+        ret = filter_sw_outputs(ctx, frame);
     return ret;
 }
 
@@ -511,7 +693,7 @@ static int filter_std_frame(AVFilterLink *inlink, AVFrame *frame)
     AVFilterContext *ctx = inlink->dst;
     NetIntSplitContext *s = ctx->priv;
     int i, ret = AVERROR_EOF;
-    if (s->nb_output0 < 2) {
+    if (ctx->nb_outputs < 2) {
         av_log(ctx, AV_LOG_ERROR, "ni_split must have at least 2 outputs for Standard split!\n");
         ret = AVERROR(EINVAL);
         return ret;
@@ -522,16 +704,9 @@ static int filter_std_frame(AVFilterLink *inlink, AVFrame *frame)
         return ret;
     }
 
-    for (i = 0; i < ctx->nb_outputs; i++) {
+    for (i = 0; i < s->total_outputs; i++) {
         AVFrame *buf_out;
-#if IS_FFMPEG_70_AND_ABOVE
-        FilterLinkInternal* const li = ff_link_internal(ctx->outputs[i]);
-        if (li->status_in)
-#elif IS_FFMPEG_342_AND_ABOVE
-        if (ctx->outputs[i]->status_in)
-#else
-        if (ctx->outputs[i]->status)
-#endif
+        if (output_closed(ctx->outputs[i]))
             continue;
         buf_out = av_frame_clone(frame);
         if (!buf_out) {
@@ -543,6 +718,8 @@ static int filter_std_frame(AVFilterLink *inlink, AVFrame *frame)
         if (ret < 0)
             break;
     }
+    if (s->nb_downloads && (ret >= 0 || ret == AVERROR_EOF))
+        ret = filter_sw_outputs(ctx, frame);
     return ret;
 }
 
@@ -670,6 +847,7 @@ static const AVOption ni_split_options[] = {
     { "output0", "Copies of output0", OFFSET(nb_output0), AV_OPT_TYPE_INT, {.i64 = 2}, 0, INT_MAX, FLAGS },
     { "output1", "Copies of output1", OFFSET(nb_output1), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS },
     { "output2", "Copies of output2", OFFSET(nb_output2), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS },
+    { "download", "Software outputs, the PPU output each downloads separated by '|'", OFFSET(download), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS },
     { NULL }
 };
 
@@ -66,6 +66,7 @@ typedef struct NetIntStackContext {
 
     enum AVPixelFormat out_format;
     AVBufferRef *out_frames_ref;
+    NIPoolUsage *pool_usage;
 
     ni_session_context_t api_ctx;
     ni_session_data_io_t api_dst_frame;
@@ -171,6 +172,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     }
 
     av_buffer_unref(&s->out_frames_ref);
+
+    ff_ni_pool_usage_report(s->pool_usage, ctx);
+    ff_ni_pool_usage_unref(&s->pool_usage);
 }
 
 static int init_out_pool(AVFilterContext *ctx)
@@ -199,6 +203,14 @@ static int init_out_pool(AVFilterContext *ctx)
 
     if (s->api_ctx.isP2P) {
         pool_size = 1;
+    } else {
+        pool_size = ff_ni_pool_plan(ctx, pool_size);
+    }
+
+    ff_ni_pool_usage_unref(&s->pool_usage);
+    s->pool_usage = ff_ni_pool_usage_alloc(pool_size);
+    if (!s->pool_usage) {
+        return AVERROR(ENOMEM);
     }
 
 #if IS_FFMPEG_61_AND_ABOVE
@@ -763,7 +775,9 @@ static int process_frame(FFFrameSync *fs)
 #endif
 
     out->buf[0] = av_buffer_create(out->data[3], sizeof(niFrameSurface1_t),
-                                   ff_ni_frame_free, NULL, 0);
+                                   ff_ni_frame_free, s->pool_usage, 0);
+    if (out->buf[0])
+        ff_ni_pool_usage_acquire(s->pool_usage);
 
     return ff_filter_frame(outlink, out);
 
@@ -24,6 +24,7 @@
 #include "libavutil/common.h"
 #include "libavutil/eval.h"
 #include "libavutil/avstring.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
@@ -34,9 +35,11 @@
 #include "internal.h"
 #endif
 #include "drawutils.h"
+#include "filters.h"
 #include "formats.h"
 #include "framesync.h"
 #include "video.h"
+#include "vf_yuvsplit_ni_init.h"
 
 
 #define IS_FFMPEG_342_AND_ABOVE                                                \
@@ -47,6 +50,9 @@ typedef struct NetIntYUV420to444Context {
     const AVClass *class;
     FFFrameSync fs;
     int mode;
+
+    NIYUVSplitDSPContext dsp;
+    int bps; ///< bytes per sample
 #if !IS_FFMPEG_342_AND_ABOVE
     int opt_repeatlast;
     int opt_shortest;
@@ -54,19 +60,30 @@ typedef struct NetIntYUV420to444Context {
 #endif
 } NetIntYUV420to444Context;
 
+typedef struct ThreadData {
+    const AVFrame *mainpic, *second;
+    AVFrame *out;
+} ThreadData;
+
+static const enum AVPixelFormat input_pix_fmts[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P10, AV_PIX_FMT_NONE,
+};
+
+static const enum AVPixelFormat output_pix_fmts[] = {
+    AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV444P10, AV_PIX_FMT_NONE,
+};
+
 static int do_blend(FFFrameSync *fs);
 
 static int query_formats(AVFilterContext *ctx)
 {
     AVFilterFormats *formats;
     int ret;
-    enum AVPixelFormat input_pix_fmt = AV_PIX_FMT_YUV420P;
-    enum AVPixelFormat output_pix_fmt = AV_PIX_FMT_YUV444P;
 
     if (ctx->inputs[0]) {
-        formats = NULL;
-        if ((ret = ff_add_format(&formats, input_pix_fmt)) < 0)
-            return ret;
+        formats = ff_make_format_list(input_pix_fmts);
+        if (!formats)
+            return AVERROR(ENOMEM);
 #if (LIBAVFILTER_VERSION_MAJOR >= 8 || LIBAVFILTER_VERSION_MAJOR >= 7 && LIBAVFILTER_VERSION_MINOR >= 110)
         if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->outcfg.formats)) < 0)
 #else
@@ -75,9 +92,9 @@ static int query_formats(AVFilterContext *ctx)
             return ret;
     }
     if (ctx->inputs[1]) {
-        formats = NULL;
-        if ((ret = ff_add_format(&formats, input_pix_fmt)) < 0)
-            return ret;
+        formats = ff_make_format_list(input_pix_fmts);
+        if (!formats)
+            return AVERROR(ENOMEM);
 #if (LIBAVFILTER_VERSION_MAJOR >= 8 || LIBAVFILTER_VERSION_MAJOR >= 7 && LIBAVFILTER_VERSION_MINOR >= 110)
         if ((ret = ff_formats_ref(formats, &ctx->inputs[1]->outcfg.formats)) < 0)
 #else
@@ -86,10 +103,9 @@ static int query_formats(AVFilterContext *ctx)
             return ret;
     }
     if (ctx->outputs[0]) {
-        formats = NULL;
-
-        if ((ret = ff_add_format(&formats, output_pix_fmt)) < 0)
-            return ret;
+        formats = ff_make_format_list(output_pix_fmts);
+        if (!formats)
+            return AVERROR(ENOMEM);
 #if (LIBAVFILTER_VERSION_MAJOR >= 8 || LIBAVFILTER_VERSION_MAJOR >= 7 && LIBAVFILTER_VERSION_MINOR >= 110)
         if ((ret = ff_formats_ref(formats, &ctx->outputs[0]->incfg.formats)) < 0)
 #else
@@ -122,8 +138,21 @@ static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     NetIntYUV420to444Context *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(outlink->format);
     int i, ret;
 
+    for (i = 0; i < ctx->nb_inputs; i++) {
+        const AVPixFmtDescriptor *idesc = av_pix_fmt_desc_get(ctx->inputs[i]->format);
+        if (idesc->comp[0].depth != desc->comp[0].depth) {
+            av_log(ctx, AV_LOG_ERROR, "input%d is %s, bit depth differs from output %s\n",
+                   i, idesc->name, desc->name);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    s->bps = desc->comp[0].depth > 8 ? 2 : 1;
+    ff_yuvsplit_ni_init(&s->dsp, desc->comp[0].depth);
+
     ret = ff_framesync_init(&s->fs, ctx, ctx->nb_inputs);
     if (ret < 0)
         return ret;
@@ -138,7 +167,6 @@ static int config_output(AVFilterLink *outlink)
 
     outlink->w = ctx->inputs[0]->w;
     outlink->h = ctx->inputs[0]->h;
-    outlink->format = AV_PIX_FMT_YUV444P;
     outlink->time_base = ctx->inputs[0]->time_base;
     av_log(ctx, AV_LOG_INFO, "output w:%d h:%d fmt:%s\n",
            outlink->w, outlink->h, av_get_pix_fmt_name(outlink->format));
@@ -167,100 +195,92 @@ static int config_output(AVFilterLink *outlink)
     return ff_framesync_configure(&s->fs);
 }
 
+/* every job handles a range of chroma row pairs and the luma rows along */
+static int merge_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    NetIntYUV420to444Context *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *mainpic = td->mainpic, *second = td->second;
+    AVFrame *out = td->out;
+    const int pairs = out->height / 2;
+    const int start = pairs * jobnr / nb_jobs;
+    const int end   = pairs * (jobnr + 1) / nb_jobs;
+    /* the last job also takes the odd luma row */
+    const int y_end = jobnr == nb_jobs - 1 ? out->height : 2 * end;
+    const int row   = out->width * s->bps;
+    const int half  = out->width / 2;
+    int i;
+
+#define LINE(f, p, y) ((f)->data[p] + (y) * (f)->linesize[p])
+
+    //y component
+    av_image_copy_plane(LINE(out, 0, 2 * start), out->linesize[0],
+                        LINE(mainpic, 0, 2 * start), mainpic->linesize[0],
+                        row, y_end - 2 * start);
+
+    if (s->mode == 0) {
+        //u component
+        av_image_copy_plane(LINE(out, 1, 2 * start), out->linesize[1],
+                            LINE(second, 0, 2 * start), second->linesize[0],
+                            row, y_end - 2 * start);
+
+        //v component, even line from mainpic and odd line from second
+        for (i = start; i < end; i++) {
+            s->dsp.interleave(LINE(out, 2, 2 * i), LINE(mainpic, 1, i),
+                              LINE(mainpic, 2, i), half);
+            s->dsp.interleave(LINE(out, 2, 2 * i + 1), LINE(second, 1, i),
+                              LINE(second, 2, i), half);
+        }
+    } else if (s->mode == 1) {
+        // uv component, even line from both, odd line from second luma
+        for (i = start; i < end; i++) {
+            s->dsp.interleave(LINE(out, 1, 2 * i), LINE(mainpic, 1, i),
+                              LINE(second, 1, i), half);
+            memcpy(LINE(out, 1, 2 * i + 1), LINE(second, 0, 2 * i),
+                   2 * half * s->bps);
+
+            s->dsp.interleave(LINE(out, 2, 2 * i), LINE(mainpic, 2, i),
+                              LINE(second, 2, i), half);
+            memcpy(LINE(out, 2, 2 * i + 1), LINE(second, 0, 2 * i + 1),
+                   2 * half * s->bps);
+        }
+    }
+
+#undef LINE
+
+    return 0;
+}
+
 static int do_blend(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
-    NetIntYUV420to444Context *s = ctx->priv;
     AVFrame *mainpic, *second, *out;
-    int uv_420_linesize, uv_444_linesize;
-    int i, j;
+    ThreadData td;
+    int nb_jobs;
 
     ff_framesync_get_frame(fs, 0, &mainpic, 0);
     ff_framesync_get_frame(fs, 1, &second, 0);
 
     mainpic->pts =
         av_rescale_q(fs->pts, fs->time_base, ctx->outputs[0]->time_base);
-    {
-        //allocate a new buffer, data is null
-        out = ff_get_video_buffer(ctx->outputs[0], ctx->outputs[0]->w, ctx->outputs[0]->h);
-        if (!out) {
-            return AVERROR(ENOMEM);
-        }
-
-        av_frame_copy_props(out, mainpic);
-        out->format = ctx->outputs[0]->format;
 
-        uv_420_linesize = mainpic->linesize[1];
-        uv_444_linesize = out->linesize[1];
+    //allocate a new buffer, data is null
+    out = ff_get_video_buffer(ctx->outputs[0], ctx->outputs[0]->w, ctx->outputs[0]->h);
+    if (!out) {
+        return AVERROR(ENOMEM);
+    }
 
-        //y component
-        for (i = 0; i < out->height; i++) {
-            memcpy(out->data[0] + i * out->linesize[0],
-                   mainpic->data[0] + i * mainpic->linesize[0],
-                   out->linesize[0]);
-        }
+    av_frame_copy_props(out, mainpic);
 
-        if (s->mode == 0) {
-            //u component
-            for (i = 0; i < out->height; i++) {
-                memcpy(out->data[1] + i * out->linesize[0],
-                       second->data[0] + i * second->linesize[0],
-                       out->linesize[0]);
-            }
-
-            //v component
-            for (i = 0; i < out->height / 2; i++) {
-                for (j = 0; j < out->width / 2; j++) {
-                    memcpy(out->data[2] + (2 * i * uv_444_linesize) + 2 * j,
-                           mainpic->data[1] + i * uv_420_linesize + j,
-                           sizeof(char));
-                    memcpy(out->data[2] + 2 * (i * uv_444_linesize) +
-                           (2 * j + 1),
-                           mainpic->data[2] + i * uv_420_linesize + j,
-                           sizeof(char));
-                    memcpy(out->data[2] + ((2 * i + 1) * uv_444_linesize) +
-                           2 * j,
-                           second->data[1] + i * uv_420_linesize + j,
-                           sizeof(char));
-                    memcpy(out->data[2] + ((2 * i + 1) * uv_444_linesize) +
-                           (2 * j + 1),
-                           second->data[2] + i * uv_420_linesize + j,
-                           sizeof(char));
-                }
-            }
-        } else if (s->mode == 1) {
-            // uv component
-            for (i = 0; i < out->height / 2; i++) {
-                for (j = 0; j < out->width / 2; j++) {
-                    memcpy(out->data[1] + (2 * i * uv_444_linesize) + 2 * j,
-                           mainpic->data[1] + i * uv_420_linesize + j,
-                           sizeof(char));
-                    memcpy(out->data[1] + (2 * i * uv_444_linesize) +
-                           (2 * j + 1),
-                           second->data[1] + i * uv_420_linesize + j,
-                           sizeof(char));
-                    memcpy(out->data[1] + ((2 * i + 1) * uv_444_linesize) +
-                           2 * j,
-                           second->data[0] + 2 * i * uv_444_linesize +
-                           2 * j,
-                           sizeof(char) * 2);
-
-                    memcpy(out->data[2] + (2 * i * uv_444_linesize) + 2 * j,
-                           mainpic->data[2] + i * uv_420_linesize + j,
-                           sizeof(char));
-                    memcpy(out->data[2] + 2 * (i * uv_444_linesize) +
-                           (2 * j + 1),
-                           second->data[2] + i * uv_420_linesize + j,
-                           sizeof(char));
-                    memcpy(out->data[2] + ((2 * i + 1) * uv_444_linesize) +
-                           2 * j,
-                           second->data[0] + (2 * i + 1) * uv_444_linesize +
-                           2 * j,
-                           sizeof(char) * 2);
-                }
-            }
-        }
-    }
+    td.mainpic = mainpic;
+    td.second  = second;
+    td.out     = out;
+    nb_jobs = FFMAX(1, FFMIN(out->height / 2, ff_filter_get_nb_threads(ctx)));
+#if (LIBAVFILTER_VERSION_MAJOR >= 8)
+    ff_filter_execute(ctx, merge_slice, &td, NULL, nb_jobs);
+#else
+    ctx->internal->execute(ctx, merge_slice, &td, NULL, nb_jobs);
+#endif
 
     return ff_filter_frame(ctx->outputs[0], out);
 }
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include "libavutil/attributes.h"
 #include "libavutil/avstring.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
@@ -32,31 +33,46 @@
 
 #include "avfilter.h"
 #include "audio.h"
+#include "filters.h"
 #include "formats.h"
 #include "version.h"
 #if !(LIBAVFILTER_VERSION_MAJOR > 10 || (LIBAVFILTER_VERSION_MAJOR == 10 && LIBAVFILTER_VERSION_MINOR >= 4))
 #include "internal.h"
 #endif
 #include "video.h"
+#include "vf_yuvsplit_ni_init.h"
 
 typedef struct NetIntYUV444to420Context {
     const AVClass *class;
     int nb_output0;
     int nb_output1;
     int mode;
+
+    NIYUVSplitDSPContext dsp;
+    int bps; ///< bytes per sample
 } NetIntYUV444to420Context;
 
+typedef struct ThreadData {
+    AVFrame *in, *out0, *out1;
+} ThreadData;
+
+static const enum AVPixelFormat input_pix_fmts[] = {
+    AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV444P10, AV_PIX_FMT_NONE,
+};
+
+static const enum AVPixelFormat output_pix_fmts[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P10, AV_PIX_FMT_NONE,
+};
+
 static int query_formats(AVFilterContext *ctx)
 {
     AVFilterFormats *formats;
     int ret;
-    enum AVPixelFormat input_pix_fmt = AV_PIX_FMT_YUV444P;
-    enum AVPixelFormat output_pix_fmt = AV_PIX_FMT_YUV420P;
 
     if (ctx->inputs[0]) {
-        formats = NULL;
-        if ((ret = ff_add_format(&formats, input_pix_fmt)) < 0)
-            return ret;
+        formats = ff_make_format_list(input_pix_fmts);
+        if (!formats)
+            return AVERROR(ENOMEM);
 #if (LIBAVFILTER_VERSION_MAJOR >= 8 || LIBAVFILTER_VERSION_MAJOR >= 7 && LIBAVFILTER_VERSION_MINOR >= 110)
         if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->outcfg.formats)) < 0) {
 #else
@@ -66,24 +82,22 @@ static int query_formats(AVFilterContext *ctx)
         }
     }
     if (ctx->outputs[0]) {
-        formats = NULL;
-
-        if ((ret = ff_add_format(&formats, output_pix_fmt)) < 0)
-            return ret;
+        formats = ff_make_format_list(output_pix_fmts);
+        if (!formats)
+            return AVERROR(ENOMEM);
 #if (LIBAVFILTER_VERSION_MAJOR >= 8 || LIBAVFILTER_VERSION_MAJOR >= 7 && LIBAVFILTER_VERSION_MINOR >= 110)
-        if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->incfg.formats)) < 0)
+        if ((ret = ff_formats_ref(formats, &ctx->outputs[0]->incfg.formats)) < 0)
 #else
         if ((ret = ff_formats_ref(formats, &ctx->outputs[0]->in_formats)) < 0)
 #endif
             return ret;
     }
     if (ctx->outputs[1]) {
-        formats = NULL;
-
-        if ((ret = ff_add_format(&formats, output_pix_fmt)) < 0)
-            return ret;
+        formats = ff_make_format_list(output_pix_fmts);
+        if (!formats)
+            return AVERROR(ENOMEM);
 #if (LIBAVFILTER_VERSION_MAJOR >= 8 || LIBAVFILTER_VERSION_MAJOR >= 7 && LIBAVFILTER_VERSION_MINOR >= 110)
-        if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->incfg.formats)) < 0)
+        if ((ret = ff_formats_ref(formats, &ctx->outputs[1]->incfg.formats)) < 0)
 #else
         if ((ret = ff_formats_ref(formats, &ctx->outputs[1]->in_formats)) < 0)
 #endif
@@ -128,16 +142,94 @@ static av_cold void uninit(AVFilterContext *ctx)
     }
 }
 
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    NetIntYUV444to420Context *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(ctx->outputs[i]->format);
+        if (odesc->comp[0].depth != desc->comp[0].depth) {
+            av_log(ctx, AV_LOG_ERROR, "output%d is %s, bit depth differs from input %s\n",
+                   i, odesc->name, desc->name);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    s->bps = desc->comp[0].depth > 8 ? 2 : 1;
+    ff_yuvsplit_ni_init(&s->dsp, desc->comp[0].depth);
+
+    return 0;
+}
+
+/* every job handles a range of chroma row pairs and the luma rows along */
+static int split_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    NetIntYUV444to420Context *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *in = td->in;
+    AVFrame *out0 = td->out0, *out1 = td->out1;
+    const int pairs = in->height / 2;
+    const int start = pairs * jobnr / nb_jobs;
+    const int end   = pairs * (jobnr + 1) / nb_jobs;
+    /* the last job also takes the odd luma row */
+    const int y_end = jobnr == nb_jobs - 1 ? in->height : 2 * end;
+    const int row   = in->width * s->bps;
+    const int half  = in->width / 2;
+    int i;
+
+#define LINE(f, p, y) ((f)->data[p] + (y) * (f)->linesize[p])
+
+    // Y component
+    av_image_copy_plane(LINE(out0, 0, 2 * start), out0->linesize[0],
+                        LINE(in, 0, 2 * start), in->linesize[0],
+                        row, y_end - 2 * start);
+
+    if (s->mode == 0) {
+        // out0 data[0]: Y  data[1]: 0.25V  data[2]: 0.25V
+        // out1 data[0]: U  data[1]: 0.25V  data[2]: 0.25V
+        av_image_copy_plane(LINE(out1, 0, 2 * start), out1->linesize[0],
+                            LINE(in, 1, 2 * start), in->linesize[1],
+                            row, y_end - 2 * start);
+
+        for (i = start; i < end; i++) {
+            // V component, even line to out0 and odd line to out1
+            s->dsp.deinterleave(LINE(out0, 1, i), LINE(out0, 2, i),
+                                LINE(in, 2, 2 * i), half);
+            s->dsp.deinterleave(LINE(out1, 1, i), LINE(out1, 2, i),
+                                LINE(in, 2, 2 * i + 1), half);
+        }
+    } else {
+        // out0 data[0]:  Y           data[1]: 0.25U  data[2]: 0.25V
+        // out1 data[0]:  0.5U + 0.5V data[1]: 0.25U  data[2]: 0.25V
+        for (i = start; i < end; i++) {
+            // U component, even line 0.25U to each, odd line 0.5U
+            s->dsp.deinterleave(LINE(out0, 1, i), LINE(out1, 1, i),
+                                LINE(in, 1, 2 * i), half);
+            memcpy(LINE(out1, 0, 2 * i), LINE(in, 1, 2 * i + 1),
+                   2 * half * s->bps);
+
+            // V component, even line 0.25V to each, odd line 0.5V
+            s->dsp.deinterleave(LINE(out0, 2, i), LINE(out1, 2, i),
+                                LINE(in, 2, 2 * i), half);
+            memcpy(LINE(out1, 0, 2 * i + 1), LINE(in, 2, 2 * i + 1),
+                   2 * half * s->bps);
+        }
+    }
+
+#undef LINE
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
-    NetIntYUV444to420Context *s = inlink->dst->priv;
     AVFrame *out0, *out1;
-    int i, j, ret;
-    int uv_420_linesize, uv_444_linesize;
-
-    ctx->outputs[0]->format = AV_PIX_FMT_YUV420P;
-    ctx->outputs[1]->format = AV_PIX_FMT_YUV420P;
+    ThreadData td;
+    int nb_jobs, ret;
 
     out0 = ff_get_video_buffer(ctx->outputs[0], ctx->outputs[0]->w, ctx->outputs[0]->h);
     if (!out0) {
@@ -154,81 +246,16 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 
     av_frame_copy_props(out0, frame);
     av_frame_copy_props(out1, frame);
-    out0->format = ctx->outputs[0]->format;
-    out1->format = ctx->outputs[1]->format;
-
-    uv_420_linesize = out0->linesize[1];
-    uv_444_linesize = frame->linesize[1];
-
-    // Y component
-    for (i = 0; i < frame->height; i++) {
-        memcpy(out0->data[0] + i * out0->linesize[0],
-               frame->data[0] + i * frame->linesize[0], out0->linesize[0]);
-    }
-
-    if (s->mode == 0) {
-        // out0 data[0]: Y  data[1]: 0.25V  data[2]: 0.25V
-        // out1 data[0]: U  data[1]: 0.25V  data[2]: 0.25V
-        // U component
-        for (i = 0; i < frame->height; i++) {
-            memcpy(out1->data[0] + i * uv_444_linesize,
-                   frame->data[1] + i * uv_444_linesize, uv_444_linesize);
-        }
 
-        for (i = 0; i < frame->height / 2; i++) {
-            for (j = 0; j < frame->width / 2; j += sizeof(char)) {
-                // V component
-                // even line
-                memcpy(&out0->data[1][i * uv_420_linesize + j],
-                       &frame->data[2][2 * i * uv_444_linesize + 2 * j],
-                       sizeof(char));
-                memcpy(&out0->data[2][i * uv_420_linesize + j],
-                       &frame->data[2][2 * i * uv_444_linesize + (2 * j + sizeof(char))],
-                       sizeof(char));
-                // odd line
-                memcpy(&out1->data[1][i * uv_420_linesize + j],
-                       &frame->data[2][(2 * i + 1) * uv_444_linesize + 2 * j],
-                       sizeof(char));
-                memcpy(&out1->data[2][i * uv_420_linesize + j],
-                       &frame->data[2][(2 * i + 1) * uv_444_linesize + (2 * j + sizeof(char))],
-                       sizeof(char));
-            }
-        }
-    } else {
-        // out0 data[0]:  Y           data[1]: 0.25U  data[2]: 0.25V
-        // out1 data[0]:  0.5U + 0.5V data[1]: 0.25U  data[2]: 0.25V
-        for (i = 0; i < frame->height / 2; i++) {
-            for (j = 0; j < frame->width / 2; j += sizeof(char)) {
-                // U component
-                // even line 0.25U
-                memcpy(&out1->data[1][i * uv_420_linesize + j],
-                       &frame->data[1][2 * i * uv_444_linesize + (2 * j + sizeof(char))],
-                       sizeof(char));
-                // odd line 0.5U
-                memcpy(&out1->data[0][2 * i * uv_444_linesize + 2 * j],
-                       &frame->data[1][(2 * i + 1) * uv_444_linesize + 2 * j],
-                       sizeof(char) * 2);
-                // even line 0.25U
-                memcpy(&out0->data[1][i * uv_420_linesize + j],
-                       &frame->data[1][2 * i * uv_444_linesize + 2 * j],
-                       sizeof(char));
-
-                // V component
-                // even line 0.25V
-                memcpy(&out1->data[2][i * uv_420_linesize + j],
-                       &frame->data[2][2 * i * uv_444_linesize + (2 * j + sizeof(char))],
-                       sizeof(char));
-                // odd line 0.5V
-                memcpy(&out1->data[0][(2 * i + 1) * uv_444_linesize + 2 * j],
-                       &frame->data[2][(2 * i + 1) * uv_444_linesize + 2 * j],
-                       sizeof(char) * 2);
-                // even line 0.25V
-                memcpy(&out0->data[2][i * uv_420_linesize + j],
-                       &frame->data[2][2 * i * uv_444_linesize + 2 * j],
-                       sizeof(char));
-            }
-        }
-    }
+    td.in   = frame;
+    td.out0 = out0;
+    td.out1 = out1;
+    nb_jobs = FFMAX(1, FFMIN(frame->height / 2, ff_filter_get_nb_threads(ctx)));
+#if (LIBAVFILTER_VERSION_MAJOR >= 8)
+    ff_filter_execute(ctx, split_slice, &td, NULL, nb_jobs);
+#else
+    ctx->internal->execute(ctx, split_slice, &td, NULL, nb_jobs);
+#endif
 
     av_frame_free(&frame);
 
@@ -258,6 +285,7 @@ static const AVFilterPad inputs[] = {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
         .filter_frame = filter_frame,
+        .config_props = config_input,
     },
 #if (LIBAVFILTER_VERSION_MAJOR < 8)
     { NULL }
@@ -278,5 +306,6 @@ AVFilter ff_vf_yuv444to420_ni_quadra = {
     .query_formats = query_formats,
     .inputs        = inputs,
 #endif
-    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
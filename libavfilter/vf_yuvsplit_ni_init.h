@@ -0,0 +1,87 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_YUVSPLIT_NI_INIT_H
+#define AVFILTER_YUVSPLIT_NI_INIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "yuvsplit_ni.h"
+
+static void deinterleave_byte_c(uint8_t *dst0, uint8_t *dst1,
+                                const uint8_t *src, ptrdiff_t w)
+{
+    for (ptrdiff_t i = 0; i < w; i++) {
+        dst0[i] = src[2 * i];
+        dst1[i] = src[2 * i + 1];
+    }
+}
+
+static void deinterleave_word_c(uint8_t *ddst0, uint8_t *ddst1,
+                                const uint8_t *ssrc, ptrdiff_t w)
+{
+    const uint16_t *src = (const uint16_t *)ssrc;
+    uint16_t *dst0 = (uint16_t *)ddst0;
+    uint16_t *dst1 = (uint16_t *)ddst1;
+
+    for (ptrdiff_t i = 0; i < w; i++) {
+        dst0[i] = src[2 * i];
+        dst1[i] = src[2 * i + 1];
+    }
+}
+
+static void interleave_byte_c(uint8_t *dst, const uint8_t *src0,
+                              const uint8_t *src1, ptrdiff_t w)
+{
+    for (ptrdiff_t i = 0; i < w; i++) {
+        dst[2 * i]     = src0[i];
+        dst[2 * i + 1] = src1[i];
+    }
+}
+
+static void interleave_word_c(uint8_t *ddst, const uint8_t *ssrc0,
+                              const uint8_t *ssrc1, ptrdiff_t w)
+{
+    const uint16_t *src0 = (const uint16_t *)ssrc0;
+    const uint16_t *src1 = (const uint16_t *)ssrc1;
+    uint16_t *dst = (uint16_t *)ddst;
+
+    for (ptrdiff_t i = 0; i < w; i++) {
+        dst[2 * i]     = src0[i];
+        dst[2 * i + 1] = src1[i];
+    }
+}
+
+static av_unused void ff_yuvsplit_ni_init(NIYUVSplitDSPContext *dsp, int depth)
+{
+    if (depth > 8) {
+        dsp->deinterleave = deinterleave_word_c;
+        dsp->interleave   = interleave_word_c;
+    } else {
+        dsp->deinterleave = deinterleave_byte_c;
+        dsp->interleave   = interleave_byte_c;
+    }
+#if ARCH_X86
+    ff_yuvsplit_ni_init_x86(dsp, depth);
+#endif
+}
+
+#endif /* AVFILTER_YUVSPLIT_NI_INIT_H */
@@ -0,0 +1,142 @@
+;*****************************************************************************
+;* x86-optimized chroma shuffles for ni_quadra_yuv444to420/yuv420to444
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;*****************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA
+
+pb_deint_byte: db 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15
+pb_deint_word: db 0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15
+
+SECTION .text
+
+%if ARCH_X86_64
+
+; void ff_yuvsplit_ni_deinterleave_<type>(uint8_t *dst0, uint8_t *dst1,
+;                                         const uint8_t *src, ptrdiff_t w)
+; %1 byte or word, %2 b or w, %3 sample size in bytes
+%macro DEINTERLEAVE 3
+cglobal yuvsplit_ni_deinterleave_%1, 4, 6, 4, dst0, dst1, src, w, x, tmp
+    VBROADCASTI128   m0, [pb_deint_%1]
+%if %3 == 2
+    add              wq, wq
+%endif
+    xor              xq, xq
+    mov            tmpq, wq
+    and            tmpq, -mmsize
+    jz .bulk_end
+
+.loop:
+    movu             m1, [srcq + 2 * xq]
+    movu             m2, [srcq + 2 * xq + mmsize]
+    pshufb           m1, m0
+    pshufb           m2, m0
+    punpckhqdq       m3, m1, m2
+    punpcklqdq       m1, m2
+%if mmsize == 32
+    vpermq           m1, m1, q3120
+    vpermq           m3, m3, q3120
+%endif
+    movu  [dst0q + xq], m1
+    movu  [dst1q + xq], m3
+    add              xq, mmsize
+    cmp              xq, tmpq
+    jl .loop
+
+.bulk_end:
+    ; the rest of the row, one sample at a time
+    cmp              xq, wq
+    jge .end
+.tail:
+    movzx          tmpd, %1 [srcq + 2 * xq]
+    mov   [dst0q + xq], tmp%2
+    movzx          tmpd, %1 [srcq + 2 * xq + %3]
+    mov   [dst1q + xq], tmp%2
+    add              xq, %3
+    cmp              xq, wq
+    jl .tail
+.end:
+    RET
+%endmacro
+
+; void ff_yuvsplit_ni_interleave_<type>(uint8_t *dst, const uint8_t *src0,
+;                                       const uint8_t *src1, ptrdiff_t w)
+; %1 byte or word, %2 b or w, %3 sample size in bytes, %4 bw or wd
+%macro INTERLEAVE 4
+cglobal yuvsplit_ni_interleave_%1, 4, 6, 3, dst, src0, src1, w, x, tmp
+%if %3 == 2
+    add              wq, wq
+%endif
+    xor              xq, xq
+    mov            tmpq, wq
+    and            tmpq, -mmsize
+    jz .bulk_end
+
+.loop:
+    movu             m0, [src0q + xq]
+    movu             m1, [src1q + xq]
+    punpckh%4        m2, m0, m1
+    punpckl%4        m0, m1
+%if mmsize == 32
+    ; each lane holds a quarter of the output, put them back in order
+    vperm2i128       m1, m0, m2, 0x31
+    vinserti128      m0, m0, xm2, 1
+    movu [dstq + 2 * xq         ], m0
+    movu [dstq + 2 * xq + mmsize], m1
+%else
+    movu [dstq + 2 * xq         ], m0
+    movu [dstq + 2 * xq + mmsize], m2
+%endif
+    add              xq, mmsize
+    cmp              xq, tmpq
+    jl .loop
+
+.bulk_end:
+    cmp              xq, wq
+    jge .end
+.tail:
+    movzx          tmpd, %1 [src0q + xq]
+    mov [dstq + 2 * xq], tmp%2
+    movzx          tmpd, %1 [src1q + xq]
+    mov [dstq + 2 * xq + %3], tmp%2
+    add              xq, %3
+    cmp              xq, wq
+    jl .tail
+.end:
+    RET
+%endmacro
+
+INIT_XMM sse2
+INTERLEAVE byte, b, 1, bw
+INTERLEAVE word, w, 2, wd
+
+INIT_XMM ssse3
+DEINTERLEAVE byte, b, 1
+DEINTERLEAVE word, w, 2
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+DEINTERLEAVE byte, b, 1
+DEINTERLEAVE word, w, 2
+INTERLEAVE byte, b, 1, bw
+INTERLEAVE word, w, 2, wd
+%endif
+
+%endif ; ARCH_X86_64
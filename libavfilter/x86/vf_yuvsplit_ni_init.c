@@ -0,0 +1,58 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/yuvsplit_ni.h"
+
+void ff_yuvsplit_ni_deinterleave_byte_ssse3(uint8_t *dst0, uint8_t *dst1, const uint8_t *src, ptrdiff_t w);
+void ff_yuvsplit_ni_deinterleave_byte_avx2(uint8_t *dst0, uint8_t *dst1, const uint8_t *src, ptrdiff_t w);
+void ff_yuvsplit_ni_deinterleave_word_ssse3(uint8_t *dst0, uint8_t *dst1, const uint8_t *src, ptrdiff_t w);
+void ff_yuvsplit_ni_deinterleave_word_avx2(uint8_t *dst0, uint8_t *dst1, const uint8_t *src, ptrdiff_t w);
+void ff_yuvsplit_ni_interleave_byte_sse2(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, ptrdiff_t w);
+void ff_yuvsplit_ni_interleave_byte_avx2(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, ptrdiff_t w);
+void ff_yuvsplit_ni_interleave_word_sse2(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, ptrdiff_t w);
+void ff_yuvsplit_ni_interleave_word_avx2(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, ptrdiff_t w);
+
+av_cold void ff_yuvsplit_ni_init_x86(NIYUVSplitDSPContext *dsp, int depth)
+{
+#if ARCH_X86_64
+    int cpu_flags = av_get_cpu_flags();
+
+    if (depth > 8) {
+        if (EXTERNAL_SSE2(cpu_flags))
+            dsp->interleave   = ff_yuvsplit_ni_interleave_word_sse2;
+        if (EXTERNAL_SSSE3(cpu_flags))
+            dsp->deinterleave = ff_yuvsplit_ni_deinterleave_word_ssse3;
+        if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+            dsp->interleave   = ff_yuvsplit_ni_interleave_word_avx2;
+            dsp->deinterleave = ff_yuvsplit_ni_deinterleave_word_avx2;
+        }
+    } else {
+        if (EXTERNAL_SSE2(cpu_flags))
+            dsp->interleave   = ff_yuvsplit_ni_interleave_byte_sse2;
+        if (EXTERNAL_SSSE3(cpu_flags))
+            dsp->deinterleave = ff_yuvsplit_ni_deinterleave_byte_ssse3;
+        if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+            dsp->interleave   = ff_yuvsplit_ni_interleave_byte_avx2;
+            dsp->deinterleave = ff_yuvsplit_ni_deinterleave_byte_avx2;
+        }
+    }
+#endif
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_YUVSPLIT_NI_H
+#define AVFILTER_YUVSPLIT_NI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Chroma row shuffles of ni_quadra_yuv444to420 and ni_quadra_yuv420to444.
+ * Samples are bytes, or native endian words for depths above 8 bits.
+ */
+typedef struct NIYUVSplitDSPContext {
+    /**
+     * Put the even samples of src in dst0 and the odd ones in dst1.
+     *
+     * @param w number of samples written to each of dst0 and dst1
+     */
+    void (*deinterleave)(uint8_t *dst0, uint8_t *dst1, const uint8_t *src,
+                         ptrdiff_t w);
+
+    /**
+     * Inverse of deinterleave, dst gets 2 * w samples.
+     */
+    void (*interleave)(uint8_t *dst, const uint8_t *src0, const uint8_t *src1,
+                       ptrdiff_t w);
+} NIYUVSplitDSPContext;
+
+void ff_yuvsplit_ni_init_x86(NIYUVSplitDSPContext *dsp, int depth);
+
+#endif /* AVFILTER_YUVSPLIT_NI_H */
@@ -3093,6 +3093,7 @@ static int hls_init(AVFormatContext *s)
                 vs->scte35_decoder = ff_alloc_ni_scte35_decoder();
                 if (!vs->scte35_decoder)
                     return AVERROR(ENOMEM);
+                ff_bind_ni_scte35_consumer(vs->scte35_decoder);
             }
         }
 
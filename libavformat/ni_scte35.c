@@ -18,13 +18,16 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "inttypes.h"
 
+#include "libavutil/avstring.h"
 #include "libavutil/base64.h"
 #include "libavutil/bprint.h"
+#include "libavutil/error.h"
 #include "libavutil/log.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
@@ -32,9 +35,49 @@
 #include "ni_scte35.h"
 
 #define BASE64_MAX_CHARS 256 /* Adjust as needed. */
+/* splice_info_section up to and including splice_command_type */
+#define SPLICE_INFO_HEADER_SIZE 14
+
+/* Splice points in flight between producer and consumer, power of 2 */
+#define NI_SCTE35_RING_SIZE     64
+/* Splice times remembered for duplicate detection. A cue repeated after
+ * this many other splice points is scheduled again. */
+#define NI_SCTE35_RECENT_SIZE   64
+#define NI_SCTE35_HASH_BITS     7
+#define NI_SCTE35_HASH_SIZE     (1 << NI_SCTE35_HASH_BITS)
 
 const AVRational scte35_timebase = {1, 90000};
 
+typedef struct ni_scte35_cue {
+    uint64_t pts;
+    char tag[NI_HLS_TAG_MAX_CHARS];
+} ni_scte35_cue;
+
+struct ni_scte35_decoder {
+    /* single producer, single consumer hand-over ring */
+    ni_scte35_cue ring[NI_SCTE35_RING_SIZE];
+    atomic_uint ring_head; /* advanced by the producer */
+    atomic_uint ring_tail; /* advanced by the consumer */
+
+    /* set before the threads start, nothing is queued without a consumer */
+    int has_consumer;
+
+    /* producer state */
+    int ignore_next_cue_in;
+    uint64_t recent[NI_SCTE35_RECENT_SIZE]; /* FIFO of scheduled splice times */
+    int nb_recent;
+    int recent_pos;
+    uint64_t recent_set[NI_SCTE35_HASH_SIZE]; /* pts + 1, 0 marks an empty slot */
+
+    /* consumer state: min-heap on pts of pool-allocated cues */
+    ni_scte35_cue **heap;
+    int nb_heap;
+    unsigned heap_size;
+    ni_scte35_cue **pool;
+    int nb_pool;
+    unsigned pool_size;
+};
+
 ni_scte35_decoder *ff_alloc_ni_scte35_decoder(void) {
     ni_scte35_decoder *p;
 
@@ -43,38 +86,88 @@ ni_scte35_decoder *ff_alloc_ni_scte35_decoder(void) {
         return NULL;
     }
 
-    if (pthread_mutex_init(&p->lock, NULL)) {
-        av_free(p);
-        return NULL;
-    }
+    atomic_init(&p->ring_head, 0);
+    atomic_init(&p->ring_tail, 0);
 
     return p;
 }
 
 void ff_free_ni_scte35_decoder(ni_scte35_decoder *d) {
-    struct ni_scte35_queue_node *node, *temp;
+    int i;
 
     if (!d) {
         return;
     }
 
-    pthread_mutex_lock(&d->lock);
+    for (i = 0; i < d->nb_heap; i++) {
+        av_free(d->heap[i]);
+    }
+    for (i = 0; i < d->nb_pool; i++) {
+        av_free(d->pool[i]);
+    }
+    av_free(d->heap);
+    av_free(d->pool);
+    av_free(d);
+}
+
+void ff_bind_ni_scte35_consumer(ni_scte35_decoder *d) {
+    d->has_consumer = 1;
+}
+
+static unsigned recent_hash(uint64_t pts) {
+    return (unsigned)((pts * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - NI_SCTE35_HASH_BITS));
+}
+
+// returns 1 if pts is in the set, slot is where it is or would be stored
+static int recent_find(const ni_scte35_decoder *d, uint64_t pts, unsigned *slot) {
+    unsigned i = recent_hash(pts);
 
-    node = d->queue_head;
-    while (node && node->next) {
-        temp = node;
-        node = node->next;
-        av_free(temp);
+    while (d->recent_set[i]) {
+        if (d->recent_set[i] == pts + 1) {
+            *slot = i;
+            return 1;
+        }
+        i = (i + 1) & (NI_SCTE35_HASH_SIZE - 1);
+    }
+
+    *slot = i;
+    return 0;
+}
+
+static void recent_remove(ni_scte35_decoder *d, uint64_t pts) {
+    unsigned i, j, home;
+
+    if (!recent_find(d, pts, &i)) {
+        return;
     }
-    if (node) {
-        av_free(node);
-        d->queue_head = NULL;
+
+    // Shift the following entries of the probe sequence back into the gap.
+    d->recent_set[i] = 0;
+    for (j = (i + 1) & (NI_SCTE35_HASH_SIZE - 1); d->recent_set[j];
+         j = (j + 1) & (NI_SCTE35_HASH_SIZE - 1)) {
+        home = recent_hash(d->recent_set[j] - 1);
+        if (((j - home) & (NI_SCTE35_HASH_SIZE - 1)) >=
+            ((j - i) & (NI_SCTE35_HASH_SIZE - 1))) {
+            d->recent_set[i] = d->recent_set[j];
+            d->recent_set[j] = 0;
+            i = j;
+        }
     }
+}
 
-    pthread_mutex_unlock(&d->lock);
-    pthread_mutex_destroy(&d->lock);
+static void recent_add(ni_scte35_decoder *d, uint64_t pts) {
+    unsigned slot;
 
-    av_free(d);
+    if (d->nb_recent == NI_SCTE35_RECENT_SIZE) {
+        recent_remove(d, d->recent[d->recent_pos]);
+    } else {
+        d->nb_recent++;
+    }
+    d->recent[d->recent_pos] = pts;
+    d->recent_pos = (d->recent_pos + 1) % NI_SCTE35_RECENT_SIZE;
+
+    recent_find(d, pts, &slot);
+    d->recent_set[slot] = pts + 1;
 }
 
 static int cue_in_to_ext_x_scte35(const AVPacket *pkt, char *tag) {
@@ -103,48 +196,37 @@ static int cue_out_to_ext_x_scte35(const AVPacket *pkt, char *tag) {
 
 // added is set to 1 if pts_time is added to queue else 0
 static int try_enqueue(ni_scte35_decoder *d, const uint64_t pts_time, const char *tag, int *added) {
-    int ret = 0;
-    struct ni_scte35_queue_node *node;
+    unsigned slot, head, tail;
+    ni_scte35_cue *cue;
 
     *added = 0;
 
-    pthread_mutex_lock(&d->lock);
+    if (!d->has_consumer)
+        return 0;
 
-    if (d->queue_head) {
-        node = d->queue_head;
-        while (node->next) {
-            if (node->pts == pts_time) {
-                // Duplicate detected. Do not add to queue.
-                goto unlock;
-            }
-            node = node->next;
-        }
-        if (node->pts == pts_time) {
-            // Duplicate detected. Do not add to queue.
-            goto unlock;
-        }
-        node->next = (struct ni_scte35_queue_node *)av_mallocz(sizeof(struct ni_scte35_queue_node));
-        if (!node->next) {
-            ret = AVERROR(ENOMEM);
-            goto unlock;
-        }
-        node->next->pts = pts_time;
-        strcpy(node->next->tag, tag);
-        *added = 1;
-    } else {
-        d->queue_head = (struct ni_scte35_queue_node *)av_mallocz(sizeof(struct ni_scte35_queue_node));
-        if (!d->queue_head) {
-            ret = AVERROR(ENOMEM);
-            goto unlock;
-        }
-        d->queue_head->pts = pts_time;
-        strcpy(d->queue_head->tag, tag);
-        *added = 1;
+    if (recent_find(d, pts_time, &slot)) {
+        // Duplicate detected. Do not add to queue.
+        return 0;
     }
 
-unlock:
-    pthread_mutex_unlock(&d->lock);
-    return ret;
+    head = atomic_load_explicit(&d->ring_head, memory_order_relaxed);
+    tail = atomic_load_explicit(&d->ring_tail, memory_order_acquire);
+    if (head - tail >= NI_SCTE35_RING_SIZE) {
+        // only the consumer may advance the tail, so the new cue is dropped
+        av_log(NULL, AV_LOG_WARNING, "%s: splice queue full, dropping pts_time %" PRIu64 "\n",
+               __func__, pts_time);
+        return 0;
+    }
+
+    cue = &d->ring[head & (NI_SCTE35_RING_SIZE - 1)];
+    cue->pts = pts_time;
+    av_strlcpy(cue->tag, tag, sizeof(cue->tag));
+    atomic_store_explicit(&d->ring_head, head + 1, memory_order_release);
+
+    recent_add(d, pts_time);
+    *added = 1;
+
+    return 0;
 }
 
 static int splice_time(uint8_t *data, uint64_t *pts_time) {
@@ -214,9 +296,7 @@ static int break_duration(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *da
 
     av_log(NULL, AV_LOG_VERBOSE, "%s: duration %" PRIu64 "\n", __func__, duration);
 
-    pthread_mutex_lock(&d->lock);
     d->ignore_next_cue_in = 1;
-    pthread_mutex_unlock(&d->lock);
 
     ret = cue_in_to_ext_x_scte35(pkt, tag);
     if (ret) {
@@ -226,7 +306,9 @@ static int break_duration(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *da
     return try_enqueue(d, *pts_time + duration, tag, &i); // don't care whether added or not
 }
 
-static int splice_insert(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *data, const uint64_t pts_adjustment) {
+// size is the number of bytes from the start of the command to the end of the packet
+static int splice_insert(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *data, int size,
+                         const uint64_t pts_adjustment) {
     uint64_t pts_time;
     int out_of_network_indicator_set;
     int program_splice_flag_set;
@@ -237,6 +319,10 @@ static int splice_insert(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *dat
 
     av_log(NULL, AV_LOG_TRACE, "%s\n", __func__);
 
+    if (size < 5) { /* splice_event_id + splice_event_cancel_indicator */
+        return AVERROR_INVALIDDATA;
+    }
+
     data += 4;
 
     if (((*data >> 7) & 0x1) == 1) { /* splice_event_cancel_indicator */
@@ -245,12 +331,22 @@ static int splice_insert(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *dat
 
     av_log(NULL, AV_LOG_VERBOSE, "%s: splice_event_cancel_indicator 0\n", __func__);
 
+    if (size < 6) {
+        return AVERROR_INVALIDDATA;
+    }
+
     data++;
     out_of_network_indicator_set = (((*data >> 7) & 0x1) == 1);
     program_splice_flag_set = (((*data >> 6) & 0x1) == 1);
     duration_flag_set = (((*data >> 5) & 0x1) == 1);
     splice_immediate_flag_set = (((*data >> 4) & 0x1) == 1);
 
+    /* splice_time, then break_duration */
+    if (program_splice_flag_set && !splice_immediate_flag_set &&
+        size < 11 + (duration_flag_set ? 5 : 0)) {
+        return AVERROR_INVALIDDATA;
+    }
+
     av_log(NULL, AV_LOG_VERBOSE, "%s: out_of_network_indicator_set %d\n", __func__, out_of_network_indicator_set);
     if (out_of_network_indicator_set) {
         if (program_splice_flag_set && !splice_immediate_flag_set) {
@@ -265,11 +361,7 @@ static int splice_insert(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *dat
             if (ret < 0 || !added) {
                 return ret;
             }
-            pthread_mutex_lock(&d->lock);
-            if (d->ignore_next_cue_in) {
-                d->ignore_next_cue_in = 0;
-            }
-            pthread_mutex_unlock(&d->lock);
+            d->ignore_next_cue_in = 0;
             if (duration_flag_set) {
                 data += 5;
                 ret = break_duration(d, pkt, data, &pts_time);
@@ -277,12 +369,10 @@ static int splice_insert(ni_scte35_decoder *d, const AVPacket *pkt, uint8_t *dat
         }
     } else {
         if (program_splice_flag_set && !splice_immediate_flag_set) {
-            pthread_mutex_lock(&d->lock);
             if (d->ignore_next_cue_in) {
                 ignore_next_cue_in = 1;
                 d->ignore_next_cue_in = 0;
             }
-            pthread_mutex_unlock(&d->lock);
             if (!ignore_next_cue_in) {
                 data++;
                 ret = splice_insert_program_splice_flag_set_splice_immediate_flag_clear(d,
@@ -321,7 +411,7 @@ int decode_scte35(ni_scte35_decoder *d, const AVPacket *pkt) {
         return 0;
 
     data = pkt->data;
-    if (*data != 0xFC) /* table_id */
+    if (pkt->size < SPLICE_INFO_HEADER_SIZE || *data != 0xFC) /* table_id */
         return AVERROR_INVALIDDATA;
 
     dump_hex(data, pkt->size);
@@ -337,109 +427,172 @@ int decode_scte35(ni_scte35_decoder *d, const AVPacket *pkt) {
     switch (*data) { /* splice_command_type */
     case 0x05:
         data++;
-        ret = splice_insert(d, pkt, data, pts_adjustment);
+        ret = splice_insert(d, pkt, data, pkt->size - SPLICE_INFO_HEADER_SIZE,
+                            pts_adjustment);
         break;
     default:
+        // splice_null heartbeats, time_signal and the others are ignored
         break;
     }
 
     return ret;
 }
 
-int is_scte35_keyframe(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase) {
-    int ret = 0;
-    struct ni_scte35_queue_node *node;
+static void heap_sift_up(ni_scte35_cue **heap, int i) {
+    ni_scte35_cue *cue = heap[i];
 
-    pthread_mutex_lock(&d->lock);
+    while (i > 0 && heap[(i - 1) / 2]->pts > cue->pts) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = cue;
+}
 
-    if (!d->queue_head) {
-        goto unlock;
+static void heap_sift_down(ni_scte35_cue **heap, int nb, int i) {
+    ni_scte35_cue *cue = heap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < nb) {
+        if (child + 1 < nb && heap[child + 1]->pts < heap[child]->pts) {
+            child++;
+        }
+        if (heap[child]->pts >= cue->pts) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
     }
+    heap[i] = cue;
+}
 
-    if (av_compare_ts(pts, *pts_timebase, d->queue_head->pts, scte35_timebase) >= 0) {
-        av_log(NULL,
-               AV_LOG_DEBUG,
-               "%s: in pts %" PRId64 " tb %d/%d v.s. head pts %" PRId64" tb %d/%d\n",
-               __func__,
-               pts,
-               pts_timebase->num,
-               pts_timebase->den,
-               d->queue_head->pts,
-               scte35_timebase.num,
-               scte35_timebase.den);
+// Move the splice points published by the producer into the heap.
+static int drain_ring(ni_scte35_decoder *d) {
+    unsigned tail = atomic_load_explicit(&d->ring_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&d->ring_head, memory_order_acquire);
+    ni_scte35_cue *cue;
+    void *tmp;
+
+    for (; tail != head; tail++) {
+        if (d->nb_pool) {
+            cue = d->pool[--d->nb_pool];
+        } else {
+            cue = av_malloc(sizeof(*cue));
+            if (!cue) {
+                break;
+            }
+        }
 
-        node = d->queue_head;
-        // Remove node from queue.
-        d->queue_head = d->queue_head->next;
-        av_free(node);
+        tmp = av_fast_realloc(d->heap, &d->heap_size, (d->nb_heap + 1) * sizeof(*d->heap));
+        if (!tmp) {
+            av_free(cue);
+            break;
+        }
+        d->heap = tmp;
 
-        ret = 1;
+        *cue = d->ring[tail & (NI_SCTE35_RING_SIZE - 1)];
+        d->heap[d->nb_heap] = cue;
+        heap_sift_up(d->heap, d->nb_heap++);
     }
 
-unlock:
-    pthread_mutex_unlock(&d->lock);
-    return ret;
+    atomic_store_explicit(&d->ring_tail, tail, memory_order_release);
+
+    return tail == head ? 0 : AVERROR(ENOMEM);
 }
 
-int is_at_splice_point(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase) {
-    int ret = 0;
+static int splice_point_reached(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase) {
+    // Fast path: nothing pending and nothing published.
+    if (!d->nb_heap &&
+        atomic_load_explicit(&d->ring_head, memory_order_acquire) ==
+        atomic_load_explicit(&d->ring_tail, memory_order_relaxed)) {
+        return 0;
+    }
 
-    pthread_mutex_lock(&d->lock);
+    drain_ring(d);
 
-    if (!d->queue_head) {
-        goto unlock;
+    return d->nb_heap &&
+           av_compare_ts(pts, *pts_timebase, d->heap[0]->pts, scte35_timebase) >= 0;
+}
+
+static void heap_pop(ni_scte35_decoder *d) {
+    ni_scte35_cue *cue = d->heap[0];
+    void *tmp;
+
+    d->heap[0] = d->heap[--d->nb_heap];
+    if (d->nb_heap) {
+        heap_sift_down(d->heap, d->nb_heap, 0);
     }
 
-    if (av_compare_ts(pts, *pts_timebase, d->queue_head->pts, scte35_timebase) >= 0) {
+    // Keep the node for reuse, the pool never holds more than the heap did.
+    tmp = av_fast_realloc(d->pool, &d->pool_size, (d->nb_pool + 1) * sizeof(*d->pool));
+    if (!tmp) {
+        av_free(cue);
+        return;
+    }
+    d->pool = tmp;
+    d->pool[d->nb_pool++] = cue;
+}
+
+int is_scte35_keyframe(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase) {
+    int ret = 0;
+
+    // One keyframe serves every splice point it has reached.
+    while (splice_point_reached(d, pts, pts_timebase)) {
         av_log(NULL,
-               AV_LOG_VERBOSE,
+               AV_LOG_DEBUG,
                "%s: in pts %" PRId64 " tb %d/%d v.s. head pts %" PRId64" tb %d/%d\n",
                __func__,
                pts,
                pts_timebase->num,
                pts_timebase->den,
-               d->queue_head->pts,
+               d->heap[0]->pts,
                scte35_timebase.num,
                scte35_timebase.den);
 
+        heap_pop(d);
         ret = 1;
     }
 
-unlock:
-    pthread_mutex_unlock(&d->lock);
     return ret;
 }
 
-void try_get_scte35_tag(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase, char *s) {
-    struct ni_scte35_queue_node *node;
-
-    pthread_mutex_lock(&d->lock);
-
-    if (!d->queue_head) {
-        goto unlock;
+int is_at_splice_point(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase) {
+    if (!splice_point_reached(d, pts, pts_timebase)) {
+        return 0;
     }
 
-    node = d->queue_head;
-    if (av_compare_ts(pts, *pts_timebase, node->pts, scte35_timebase) >= 0) {
-        av_log(NULL,
-               AV_LOG_DEBUG,
-               "%s: in pts %" PRId64 " tb %d/%d v.s. head pts %" PRId64" tb %d/%d: tag %s\n",
-               __func__,
-               pts,
-               pts_timebase->num,
-               pts_timebase->den,
-               node->pts,
-               scte35_timebase.num,
-               scte35_timebase.den,
-               node->tag);
+    av_log(NULL,
+           AV_LOG_VERBOSE,
+           "%s: in pts %" PRId64 " tb %d/%d v.s. head pts %" PRId64" tb %d/%d\n",
+           __func__,
+           pts,
+           pts_timebase->num,
+           pts_timebase->den,
+           d->heap[0]->pts,
+           scte35_timebase.num,
+           scte35_timebase.den);
 
-        strcpy(s, node->tag);
+    return 1;
+}
 
-        // Remove node from queue.
-        d->queue_head = d->queue_head->next;
-        av_free(node);
+void try_get_scte35_tag(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase, char *s) {
+    if (!splice_point_reached(d, pts, pts_timebase)) {
+        return;
     }
 
-unlock:
-    pthread_mutex_unlock(&d->lock);
+    av_log(NULL,
+           AV_LOG_DEBUG,
+           "%s: in pts %" PRId64 " tb %d/%d v.s. head pts %" PRId64" tb %d/%d: tag %s\n",
+           __func__,
+           pts,
+           pts_timebase->num,
+           pts_timebase->den,
+           d->heap[0]->pts,
+           scte35_timebase.num,
+           scte35_timebase.den,
+           d->heap[0]->tag);
+
+    strcpy(s, d->heap[0]->tag);
+
+    // Remove node from queue.
+    heap_pop(d);
 }
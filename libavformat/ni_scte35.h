@@ -24,24 +24,32 @@
 #include "libavcodec/packet.h"
 
 #include "libavutil/rational.h"
-#include "libavutil/thread.h"
 
 #define NI_HLS_TAG_MAX_CHARS 1024 /* Adjust as needed. */
 
-struct ni_scte35_queue_node {
-    uint64_t pts;
-    char tag[NI_HLS_TAG_MAX_CHARS];
-    struct ni_scte35_queue_node *next;
-};
-
-typedef struct {
-    pthread_mutex_t lock;
-    struct ni_scte35_queue_node *queue_head;
-    int ignore_next_cue_in;
-} ni_scte35_decoder;
+/*
+ * Splice point scheduler fed by one SCTE-35 stream.
+ *
+ * decode_scte35() is the producer and may run on a different thread than
+ * the single consumer calling is_scte35_keyframe(), is_at_splice_point()
+ * and try_get_scte35_tag(). Pending splice points are handed over through
+ * a lock-free ring and kept ordered by pts on the consumer side, so the
+ * per-frame lookups never block on the producer.
+ *
+ * Repeated cues are recognized by their splice time among the last 64
+ * splice points scheduled; a cue repeated after more than that is
+ * scheduled again.
+ *
+ * Cues are only scheduled once a consumer was bound with
+ * ff_bind_ni_scte35_consumer(), which has to happen before the producer
+ * and consumer threads start. Without one decode_scte35() only
+ * validates the sections.
+ */
+typedef struct ni_scte35_decoder ni_scte35_decoder;
 
 ni_scte35_decoder *ff_alloc_ni_scte35_decoder(void);
 void ff_free_ni_scte35_decoder(ni_scte35_decoder *d);
+void ff_bind_ni_scte35_consumer(ni_scte35_decoder *d);
 
 int decode_scte35(ni_scte35_decoder *d, const AVPacket *pkt);
 int is_scte35_keyframe(ni_scte35_decoder *d, const int64_t pts, const AVRational *pts_timebase);
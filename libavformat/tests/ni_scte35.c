@@ -0,0 +1,278 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Replay a synthetic SCTE-35 cue stream against 30 fps video and check
+ * which frames are forced to be keyframes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavformat/ni_scte35.h"
+
+#define FRAME_DURATION 3000 /* 30 fps in 90 kHz */
+#define NB_FRAMES      300
+
+typedef struct Cue {
+    int      frame;          /* cue is received before this frame is decoded */
+    int      out;            /* out_of_network_indicator */
+    uint64_t pts_time;
+    uint64_t pts_adjustment;
+    uint64_t duration;       /* break_duration with auto_return, 0 for none */
+} Cue;
+
+static const Cue cues[] = {
+    /* cue-out at 2.0167s with a 3s break, repeated as encoders do */
+    {  30, 1, 181500,    0, 270000 },
+    {  40, 1, 181500,    0, 270000 },
+    {  50, 1, 181500,    0, 270000 },
+    /* explicit cue-in at the end of the auto-returning break, ignored */
+    { 100, 0, 451500,    0,      0 },
+    /* delivered out of order: the later splice arrives first */
+    { 120, 1, 720000, 9000,      0 },
+    { 125, 1, 600000,    0,      0 },
+    { 130, 0, 660000,    0,      0 },
+    /* already passed when it arrives, fires on the next frame */
+    { 250, 1, 740000,    0,      0 },
+};
+
+static const int expected[] = { 61, 151, 200, 220, 243, 250 };
+
+static void put_bits33(uint8_t *p, int flag, uint64_t v)
+{
+    p[0] = (flag << 7) | 0x7e | ((v >> 32) & 1);
+    p[1] = v >> 24;
+    p[2] = v >> 16;
+    p[3] = v >> 8;
+    p[4] = v;
+}
+
+static int make_splice_insert(uint8_t *buf, const Cue *c)
+{
+    uint8_t *p = buf;
+
+    memset(buf, 0, 64);
+    *p++ = 0xFC;                            /* table_id */
+    p   += 2;                               /* section_length */
+    *p++ = 0;                               /* protocol_version */
+    put_bits33(p, 0, c->pts_adjustment);    /* encrypted_packet + pts_adjustment */
+    p   += 5;
+    *p++ = 0;                               /* cw_index */
+    p   += 3;                               /* tier + splice_command_length */
+    *p++ = 0x05;                            /* splice_insert */
+    p   += 4;                               /* splice_event_id */
+    *p++ = 0x7f;                            /* splice_event_cancel_indicator */
+    *p++ = (c->out << 7) | (1 << 6) | (!!c->duration << 5) | 0x0f;
+    put_bits33(p, 1, c->pts_time);          /* splice_time */
+    p   += 5;
+    if (c->duration) {
+        put_bits33(p, 1, c->duration);      /* break_duration */
+        p += 5;
+    }
+    p   += 8;                               /* program id, avails, CRC */
+    buf[1] = 0x30 | ((p - buf - 3) >> 8);
+    buf[2] = p - buf - 3;
+
+    return p - buf;
+}
+
+static int feed(ni_scte35_decoder *d, const Cue *c)
+{
+    uint8_t buf[64];
+    AVPacket pkt = { .data = buf };
+
+    pkt.size = make_splice_insert(buf, c);
+    return decode_scte35(d, &pkt);
+}
+
+static int test_keyframes(void)
+{
+    const AVRational tb = { 1, 90000 };
+    ni_scte35_decoder *d = ff_alloc_ni_scte35_decoder();
+    ni_scte35_decoder *other = ff_alloc_ni_scte35_decoder();
+    int next_cue = 0, nb_found = 0, ret = 0;
+
+    if (!d || !other) {
+        ret = 1;
+        goto end;
+    }
+    ff_bind_ni_scte35_consumer(d);
+
+    for (int n = 0; n < NB_FRAMES; n++) {
+        int64_t pts = (int64_t)n * FRAME_DURATION;
+
+        for (; next_cue < FF_ARRAY_ELEMS(cues) && cues[next_cue].frame == n; next_cue++) {
+            if (feed(d, &cues[next_cue]) < 0) {
+                printf("cue %d rejected\n", next_cue);
+                ret = 1;
+            }
+        }
+
+        if (is_scte35_keyframe(other, pts, &tb)) {
+            printf("frame %d: splice leaked into another input\n", n);
+            ret = 1;
+        }
+
+        if (!is_scte35_keyframe(d, pts, &tb))
+            continue;
+
+        printf("keyframe at frame %d\n", n);
+        if (nb_found >= FF_ARRAY_ELEMS(expected) || expected[nb_found] != n) {
+            printf("unexpected keyframe at frame %d\n", n);
+            ret = 1;
+        }
+        nb_found++;
+    }
+
+    if (nb_found != FF_ARRAY_ELEMS(expected)) {
+        printf("found %d keyframes, expected %d\n", nb_found,
+               (int)FF_ARRAY_ELEMS(expected));
+        ret = 1;
+    }
+
+end:
+    ff_free_ni_scte35_decoder(d);
+    ff_free_ni_scte35_decoder(other);
+    return ret;
+}
+
+static int test_tags(void)
+{
+    const AVRational tb = { 1, 1000 };
+    const Cue out = { 0, 1, 90000, 0, 180000 };
+    ni_scte35_decoder *d = ff_alloc_ni_scte35_decoder();
+    char tag[NI_HLS_TAG_MAX_CHARS] = "";
+    int ret = 0;
+
+    if (d)
+        ff_bind_ni_scte35_consumer(d);
+    if (!d || feed(d, &out) < 0)
+        ret = 1;
+
+    if (!ret && is_at_splice_point(d, 999, &tb)) {
+        printf("splice point reported early\n");
+        ret = 1;
+    }
+    if (!ret) {
+        try_get_scte35_tag(d, 1000, &tb, tag);
+        if (!strstr(tag, "CUE-OUT=YES")) {
+            printf("missing cue-out tag: '%s'\n", tag);
+            ret = 1;
+        }
+    }
+    if (!ret && is_at_splice_point(d, 2999, &tb)) {
+        printf("cue-in reported early\n");
+        ret = 1;
+    }
+    if (!ret) {
+        tag[0] = '\0';
+        try_get_scte35_tag(d, 3000, &tb, tag);
+        if (!strstr(tag, "CUE-IN=YES")) {
+            printf("missing cue-in tag: '%s'\n", tag);
+            ret = 1;
+        }
+    }
+
+    ff_free_ni_scte35_decoder(d);
+    return ret;
+}
+
+static int test_short_sections(void)
+{
+    static const struct {
+        const char *name;
+        uint8_t     command_type;
+        int         size;
+        int         ret;
+    } sections[] = {
+        { "splice_null",             0x00, 20, 0 },
+        { "time_signal",             0x06, 25, 0 },
+        { "truncated header",        0x00, 13, AVERROR_INVALIDDATA },
+        { "splice_insert, no flags", 0x05, 18, AVERROR_INVALIDDATA },
+        { "splice_insert, no time",  0x05, 24, AVERROR_INVALIDDATA },
+        { "splice_insert, no break", 0x05, 29, AVERROR_INVALIDDATA },
+    };
+    const Cue c = { 0, 1, 90000, 0, 180000 };
+    ni_scte35_decoder *d = ff_alloc_ni_scte35_decoder();
+    uint8_t buf[64];
+    AVPacket pkt = { .data = buf };
+    int ret = !d;
+
+    for (int i = 0; d && i < FF_ARRAY_ELEMS(sections); i++) {
+        int err;
+
+        make_splice_insert(buf, &c);
+        buf[13]  = sections[i].command_type;
+        pkt.size = sections[i].size;
+
+        err = decode_scte35(d, &pkt);
+        if (err != sections[i].ret) {
+            printf("%s: returned %d, expected %d\n", sections[i].name, err,
+                   sections[i].ret);
+            ret = 1;
+        }
+    }
+
+    ff_free_ni_scte35_decoder(d);
+    return ret;
+}
+
+/* More cues than the queue holds must not fail, consumed or not. */
+static int test_queue_full(void)
+{
+    int ret = 0;
+
+    for (int bound = 0; bound < 2; bound++) {
+        ni_scte35_decoder *d = ff_alloc_ni_scte35_decoder();
+
+        if (!d)
+            return 1;
+        if (bound)
+            ff_bind_ni_scte35_consumer(d);
+
+        for (int i = 0; i < 200; i++) {
+            const Cue c = { 0, 1, 90000 * (uint64_t)(i + 1), 0, 0 };
+
+            if (feed(d, &c) < 0) {
+                printf("cue %d rejected %s a consumer\n", i,
+                       bound ? "with" : "without");
+                ret = 1;
+                break;
+            }
+        }
+
+        ff_free_ni_scte35_decoder(d);
+    }
+
+    return ret;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    ret |= test_keyframes();
+    ret |= test_tags();
+    ret |= test_short_sections();
+    ret |= test_queue_full();
+
+    return ret;
+}
@@ -19,6 +19,7 @@
 #include "config.h"
 
 #include <fcntl.h>
+#include <stdatomic.h>
 #include <string.h>
 #if HAVE_UNISTD_H
 #include <unistd.h>
@@ -30,10 +31,51 @@
 #include "hwcontext.h"
 #include "hwcontext_internal.h"
 #include "hwcontext_ni_quad.h"
+#include "hwcontext_ni_quad_internal.h"
 #include "libavutil/imgutils.h"
 #include "mem.h"
 #include "pixdesc.h"
 #include "pixfmt.h"
+#include "planecopy.h"
+
+typedef struct NIFramesContext {
+    AVNIFramesContext p;
+
+    /* PlaneCopyContext *, created by the first CPU transfer since most
+     * frames contexts (decoder, scaler and filter pools) never do one */
+    atomic_uintptr_t copy_ctx;
+} NIFramesContext;
+
+static const NIFrameLayout ni_frame_layouts[] = {
+    { AV_PIX_FMT_YUV420P,     NI_PIX_FMT_YUV420P,     0, 1, 1, 1,
+      { { 1, 1, 128, 0 }, { 1, 2, 128, 1 }, { 1, 2, 128, 1 } } },
+    { AV_PIX_FMT_YUVJ420P,    NI_PIX_FMT_YUV420P,     0, 1, 1, 1,
+      { { 1, 1, 128, 0 }, { 1, 2, 128, 1 }, { 1, 2, 128, 1 } } },
+    { AV_PIX_FMT_YUV420P10LE, NI_PIX_FMT_YUV420P10LE, 0, 2, 1, 1,
+      { { 2, 1, 128, 0 }, { 2, 2, 128, 1 }, { 2, 2, 128, 1 } } },
+    { AV_PIX_FMT_NV12,        NI_PIX_FMT_NV12,        1, 1, 1, 1,
+      { { 1, 1, 128, 0 }, { 1, 1, 128, 1 } } },
+    { AV_PIX_FMT_NV16,        NI_PIX_FMT_NV16,        0, 1, 0, 0,
+      { { 1, 1,  64, 0 }, { 1, 1,  64, 0 } } },
+    { AV_PIX_FMT_YUYV422,     NI_PIX_FMT_YUYV422,     0, 1, 1, 0,
+      { { 2, 1,  32, 0 } } },
+    { AV_PIX_FMT_UYVY422,     NI_PIX_FMT_UYVY422,     0, 1, 1, 0,
+      { { 2, 1,  32, 0 } } },
+    { AV_PIX_FMT_P010LE,      NI_PIX_FMT_P010LE,      1, 2, 1, 1,
+      { { 2, 1, 128, 0 }, { 2, 1, 128, 1 } } },
+    { AV_PIX_FMT_RGBA,        NI_PIX_FMT_RGBA,        0, 1, 1, 0,
+      { { 4, 1,  64, 0 } } },
+    { AV_PIX_FMT_BGRA,        NI_PIX_FMT_BGRA,        0, 1, 1, 0,
+      { { 4, 1,  64, 0 } } },
+    { AV_PIX_FMT_ABGR,        NI_PIX_FMT_ABGR,        0, 1, 1, 0,
+      { { 4, 1,  64, 0 } } },
+    { AV_PIX_FMT_ARGB,        NI_PIX_FMT_ARGB,        0, 1, 1, 0,
+      { { 4, 1,  64, 0 } } },
+    { AV_PIX_FMT_BGR0,        NI_PIX_FMT_BGR0,        0, 1, 1, 0,
+      { { 4, 1,  64, 0 } } },
+    { AV_PIX_FMT_BGRP,        NI_PIX_FMT_BGRP,        0, 1, 1, 0,
+      { { 1, 1,  32, 0 }, { 1, 1,  32, 0 }, { 1, 1,  32, 0 } } },
+};
 
 static enum AVPixelFormat supported_pixel_formats[] = {
     AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUYV422, AV_PIX_FMT_UYVY422,
@@ -238,6 +280,12 @@ static void ni_frames_uninit(AVHWFramesContext *ctx)
     AVNIFramesContext *f_hwctx = (AVNIFramesContext*) ctx->hwctx;
     int dev_dec_idx = f_hwctx->uploader_device_id; //Supplied by init_hw_device ni=<name>:<id> or ni_hwupload=<id>
 
+    {
+        PlaneCopyContext *copy_ctx = (PlaneCopyContext *)
+            atomic_load(&((NIFramesContext *)ctx->hwctx)->copy_ctx);
+        avpriv_plane_copy_free(&copy_ctx);
+    }
+
     av_log(ctx, AV_LOG_DEBUG, "%s: only close if upload instance, poolsize=%d "
                               "devid=%d\n",
                               __func__, ctx->initial_pool_size, dev_dec_idx);
@@ -387,6 +435,8 @@ static int ni_frames_init(AVHWFramesContext *ctx) //hwupload runs this on hwuplo
     f_hwctx->uploader_device_id = -2; // -1 is load balance by pixel rate,
                                       // default -2 invalid
     pool_size = ctx->initial_pool_size;
+    atomic_init(&((NIFramesContext *)ctx->hwctx)->copy_ctx, 0);
+
     if (device_hwctx->uploader_ID < -1) {
         if (pool_size > -1) { // ffmpeg does not specify init_hw_device for decoder
                               // - so decoder device_hwctx->uploader_ID is always -1
@@ -583,344 +633,161 @@ static int ni_frames_init(AVHWFramesContext *ctx) //hwupload runs this on hwuplo
     return 0;
 }
 
+const NIFrameLayout *avpriv_ni_frame_layout(enum AVPixelFormat pix_fmt)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(ni_frame_layouts); i++) {
+        if (ni_frame_layouts[i].pix_fmt == pix_fmt) {
+            return &ni_frame_layouts[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Device stride and row count of each plane for a width x height frame */
+static void ni_layout_planes(const NIFrameLayout *layout, int width, int height,
+                             int stride[4], int plane_height[4])
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        const NIPlaneLayout *p = &layout->plane[i];
+
+        if (stride) {
+            stride[i] = p->align ? FFALIGN(width * p->num / p->den, p->align) : 0;
+        }
+        if (plane_height) {
+            plane_height[i] = !p->align ? 0 :
+                              p->log2_h ? FFALIGN(height, 2) >> p->log2_h : height;
+        }
+    }
+}
+
+/*
+ * Plane copy context shared by all the transfers on this frames context.
+ * Concurrent first transfers may both create one, only one is kept. If it
+ * cannot be created the copy runs on the calling thread.
+ */
+static PlaneCopyContext *ni_frames_copy_ctx(AVHWFramesContext *hwfc)
+{
+    NIFramesContext *f = hwfc->hwctx;
+    PlaneCopyContext *copy_ctx;
+    uintptr_t expected = 0;
+
+    copy_ctx = (PlaneCopyContext *)atomic_load_explicit(&f->copy_ctx,
+                                                        memory_order_acquire);
+    if (copy_ctx)
+        return copy_ctx;
+
+    if (avpriv_plane_copy_alloc(&copy_ctx, 0) < 0)
+        return NULL;
+
+    if (!atomic_compare_exchange_strong_explicit(&f->copy_ctx, &expected,
+                                                 (uintptr_t)copy_ctx,
+                                                 memory_order_acq_rel,
+                                                 memory_order_acquire)) {
+        avpriv_plane_copy_free(&copy_ctx);
+        copy_ctx = (PlaneCopyContext *)expected;
+    }
+
+    return copy_ctx;
+}
+
 static int ni_to_avframe_copy(AVHWFramesContext *hwfc, AVFrame *dst,
                               const ni_frame_t *src)
 {
+    const NIFrameLayout *layout;
+    PlaneCopyDesc planes[4];
     int src_linesize[4], src_height[4];
-    int i, h, nb_planes;
-    uint8_t *src_line, *dst_line;
+    int i, nb_planes;
 
-    nb_planes = av_pix_fmt_count_planes(hwfc->sw_format);
-
-    switch (hwfc->sw_format) {
-    case AV_PIX_FMT_YUV420P:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width / 2, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_YUV420P10LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = src_linesize[1];
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = src_height[1];
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_NV12:
-        src_linesize[0] = FFALIGN(dst->width, 128);
-        src_linesize[1] = FFALIGN(dst->width, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_NV16:
-        src_linesize[0] = FFALIGN(dst->width, 64);
-        src_linesize[1] = FFALIGN(dst->width, 64);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 2;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_P010LE:
-        src_linesize[0] = FFALIGN(dst->width * 2, 128);
-        src_linesize[1] = FFALIGN(dst->width * 2, 128);
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = FFALIGN(dst->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        src_linesize[0] = FFALIGN(dst->width, 16) * 4;
-        src_linesize[1] = 0;
-        src_linesize[2] = 0;
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-        break;
-
-    case AV_PIX_FMT_BGRP:
-        src_linesize[0] = FFALIGN(dst->width, 32);
-        src_linesize[1] = FFALIGN(dst->width, 32);
-        src_linesize[2] = FFALIGN(dst->width, 32);
-        src_linesize[3] = 0;
-
-        src_height[0] = dst->height;
-        src_height[1] = dst->height;
-        src_height[2] = dst->height;
-        src_height[3] = 0;
-        break;
-
-    default:
+    layout = avpriv_ni_frame_layout(hwfc->sw_format);
+    if (!layout) {
         av_log(hwfc, AV_LOG_ERROR, "Unsupported pixel format %s\n",
                av_get_pix_fmt_name(hwfc->sw_format));
         return AVERROR(EINVAL);
     }
 
+    nb_planes = av_pix_fmt_count_planes(hwfc->sw_format);
+    ni_layout_planes(layout, dst->width, dst->height, src_linesize, src_height);
+
     for (i = 0; i < nb_planes; i++) {
-        dst_line = dst->data[i];
-        src_line = src->p_data[i];
-
-        for (h = 0; h < src_height[i]; h++) {
-            memcpy(dst_line, src_line,
-                   FFMIN(src_linesize[i], dst->linesize[i]));
-            dst_line += dst->linesize[i];
-            src_line += src_linesize[i];
-        }
+        planes[i].dst          = dst->data[i];
+        planes[i].dst_linesize = dst->linesize[i];
+        planes[i].src          = src->p_data[i];
+        planes[i].src_linesize = src_linesize[i];
+        planes[i].bytewidth    = FFMIN(src_linesize[i], dst->linesize[i]);
+        planes[i].height       = src_height[i];
     }
 
+    avpriv_plane_copy(ni_frames_copy_ctx(hwfc), planes, nb_planes);
+
     return 0;
 }
 
 static int av_to_niframe_copy(AVHWFramesContext *hwfc, const int dst_stride[4],
                               ni_frame_t *dst, const AVFrame *src) {
+    const NIFrameLayout *layout;
+    PlaneCopyDesc planes[4];
     int src_height[4], hpad[4], vpad[4];
     int i, j, h, nb_planes;
-    uint8_t *src_line, *dst_line, YUVsample, *sample, *dest;
-    uint16_t lastidx;
-    bool tenBit;
+    uint8_t *dst_line, *sample, *dest;
+    int lastidx;
 
-    nb_planes = av_pix_fmt_count_planes(hwfc->sw_format);
-
-    switch (src->format) {
-    case AV_PIX_FMT_YUV420P:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = FFALIGN(src_height[2], 2) - src_height[2];
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
-    case AV_PIX_FMT_YUV420P10LE:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = FFALIGN(src->height, 2) / 2;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = FFALIGN(src_height[2], 2) - src_height[2];
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-
-    case AV_PIX_FMT_NV12:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-    case AV_PIX_FMT_NV16:
-        hpad[0] = 0;
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
-    case AV_PIX_FMT_P010LE:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = FFALIGN(src->height, 2) / 2;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = FFALIGN(src_height[0], 2) - src_height[0];
-        vpad[1] = FFALIGN(src_height[1], 2) - src_height[1];
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = true;
-        break;
-
-    case AV_PIX_FMT_RGBA:
-    case AV_PIX_FMT_BGRA:
-    case AV_PIX_FMT_ABGR:
-    case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_BGR0:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
-    case AV_PIX_FMT_BGRP:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = FFMAX(dst_stride[1] - src->linesize[1], 0);
-        hpad[2] = FFMAX(dst_stride[2] - src->linesize[2], 0);
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = src->height;
-        src_height[2] = src->height;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
-    case AV_PIX_FMT_YUYV422:
-    case AV_PIX_FMT_UYVY422:
-        hpad[0] = FFMAX(dst_stride[0] - src->linesize[0], 0);
-        hpad[1] = 0;
-        hpad[2] = 0;
-        hpad[3] = 0;
-
-        src_height[0] = src->height;
-        src_height[1] = 0;
-        src_height[2] = 0;
-        src_height[3] = 0;
-
-        vpad[0] = 0;
-        vpad[1] = 0;
-        vpad[2] = 0;
-        vpad[3] = 0;
-
-        tenBit = false;
-        break;
-
-    default:
+    layout = avpriv_ni_frame_layout(src->format);
+    if (!layout) {
         av_log(hwfc, AV_LOG_ERROR, "Pixel format %s not supported\n",
                av_get_pix_fmt_name(src->format));
-        break;
+        return AVERROR(EINVAL);
     }
 
+    nb_planes = av_pix_fmt_count_planes(hwfc->sw_format);
+    ni_layout_planes(layout, src->width, src->height, NULL, src_height);
+
     for (i = 0; i < nb_planes; i++) {
-        dst_line = dst->p_data[i];
-        src_line = src->data[i];
+        hpad[i] = layout->hpad ? FFMAX(dst_stride[i] - src->linesize[i], 0) : 0;
+        vpad[i] = layout->vpad ? FFALIGN(src_height[i], 2) - src_height[i] : 0;
+
+        planes[i].dst          = dst->p_data[i];
+        planes[i].dst_linesize = dst_stride[i];
+        planes[i].src          = src->data[i];
+        planes[i].src_linesize = src->linesize[i];
+        planes[i].bytewidth    = FFMIN(src->linesize[i], dst_stride[i]);
+        planes[i].height       = src_height[i];
+    }
+
+    avpriv_plane_copy(ni_frames_copy_ctx(hwfc), planes, nb_planes);
 
-        for (h = 0; h < src_height[i]; h++) {
-            memcpy(dst_line, src_line, FFMIN(src->linesize[i], dst_stride[i]));
+    for (i = 0; i < nb_planes; i++) {
+        dst_line = dst->p_data[i];
 
-            if (hpad[i]) {
-                lastidx = src->linesize[i];
+        /* Extend the width by cloning the last sample of each line */
+        if (hpad[i]) {
+            lastidx = src->linesize[i];
 
-                if (tenBit) {
-                    sample = &src_line[lastidx - 2];
+            for (h = 0; h < src_height[i]; h++) {
+                if (layout->sample_size > 1) {
+                    sample = &dst_line[lastidx - layout->sample_size];
                     dest   = &dst_line[lastidx];
 
-                    /* two bytes per sample */
-                    for (j = 0; j < hpad[i] / 2; j++) {
-                        memcpy(dest, sample, 2);
-                        dest += 2;
+                    for (j = 0; j < hpad[i] / layout->sample_size; j++) {
+                        memcpy(dest, sample, layout->sample_size);
+                        dest += layout->sample_size;
                     }
                 } else {
-                    YUVsample = dst_line[lastidx - 1];
-                    memset(&dst_line[lastidx], YUVsample, hpad[i]);
+                    memset(&dst_line[lastidx], dst_line[lastidx - 1], hpad[i]);
                 }
+                dst_line += dst_stride[i];
             }
-
-            src_line += src->linesize[i];
-            dst_line += dst_stride[i];
+        } else {
+            dst_line += (ptrdiff_t)src_height[i] * dst_stride[i];
         }
 
         /* Extend the height by cloning the last line */
-        src_line = dst_line - dst_stride[i];
         for (h = 0; h < vpad[i]; h++) {
-            memcpy(dst_line, src_line, dst_stride[i]);
+            memcpy(dst_line, dst_line - dst_stride[i], dst_stride[i]);
             dst_line += dst_stride[i];
         }
     }
@@ -935,6 +802,7 @@ static int ni_hwdl_frame(AVHWFramesContext *hwfc, AVFrame *dst,
     ni_session_data_io_t session_io_data;
     ni_session_data_io_t *p_session_data = &session_io_data;
     niFrameSurface1_t *src_surf = (niFrameSurface1_t *)src->data[3];
+    const NIFrameLayout *layout;
     int ret;
     int pixel_format;
 
@@ -948,51 +816,13 @@ static int ni_hwdl_frame(AVHWFramesContext *hwfc, AVFrame *dst,
     av_log(hwfc, AV_LOG_DEBUG, "%s hwdl processed h/w = %d/%d\n", __func__,
            src->height, src->width);
 
-    switch (hwfc->sw_format) {
-    case AV_PIX_FMT_YUV420P:
-        pixel_format = NI_PIX_FMT_YUV420P;
-        break;
-    case AV_PIX_FMT_YUV420P10LE:
-        pixel_format = NI_PIX_FMT_YUV420P10LE;
-        break;
-    case AV_PIX_FMT_NV12:
-        pixel_format = NI_PIX_FMT_NV12;
-        break;
-    case AV_PIX_FMT_NV16:
-        pixel_format = NI_PIX_FMT_NV16;
-        break;
-    case AV_PIX_FMT_YUYV422:
-        pixel_format = NI_PIX_FMT_YUYV422;
-        break;
-    case AV_PIX_FMT_UYVY422:
-        pixel_format = NI_PIX_FMT_UYVY422;
-        break;
-    case AV_PIX_FMT_P010LE:
-        pixel_format = NI_PIX_FMT_P010LE;
-        break;
-    case AV_PIX_FMT_RGBA:
-        pixel_format = NI_PIX_FMT_RGBA;
-        break;
-    case AV_PIX_FMT_BGRA:
-        pixel_format = NI_PIX_FMT_BGRA;
-        break;
-    case AV_PIX_FMT_ABGR:
-        pixel_format = NI_PIX_FMT_ABGR;
-        break;
-    case AV_PIX_FMT_ARGB:
-        pixel_format = NI_PIX_FMT_ARGB;
-        break;
-    case AV_PIX_FMT_BGR0:
-        pixel_format = NI_PIX_FMT_BGR0;
-        break;
-    case AV_PIX_FMT_BGRP:
-        pixel_format = NI_PIX_FMT_BGRP;
-        break;
-    default:
+    layout = avpriv_ni_frame_layout(hwfc->sw_format);
+    if (!layout) {
         av_log(hwfc, AV_LOG_ERROR, "Pixel format %s not supported\n",
                av_get_pix_fmt_name(hwfc->sw_format));
         return AVERROR(EINVAL);
     }
+    pixel_format = layout->ni_pix_fmt;
 
     ret = ni_frame_buffer_alloc_dl(&(p_session_data->data.frame), src->width,
                                    src->height, pixel_format);
@@ -1029,6 +859,7 @@ static int ni_hwup_frame(AVHWFramesContext *hwfc, AVFrame *dst, const AVFrame *s
     AVNIFramesContext *f_hwctx = (AVNIFramesContext*) hwfc->hwctx;
     ni_session_data_io_t *p_src_session_data;
     niFrameSurface1_t *dst_surf;
+    const NIFrameLayout *layout;
     int ret = 0;
     int dst_stride[4];
     int pixel_format;
@@ -1045,148 +876,9 @@ static int ni_hwup_frame(AVHWFramesContext *hwfc, AVFrame *dst, const AVFrame *s
 
     p_src_session_data = &f_hwctx->src_session_io_data;
 
-    switch (src->format) {
-    /* 8-bit YUV420 planar */
-    case AV_PIX_FMT_YUV420P:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = FFALIGN((src->width / 2), 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_YUV420P;
-        isSemiPlanar = false;
-        break;
-
-    /* 10-bit YUV420 planar, little-endian, least significant bits */
-    case AV_PIX_FMT_YUV420P10LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = FFALIGN(src->width, 128);
-        dst_stride[2] = dst_stride[1];
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_YUV420P10LE;
-        isSemiPlanar = false;
-        break;
-
-    /* 8-bit YUV420 semi-planar */
-    case AV_PIX_FMT_NV12:
-        dst_stride[0] = FFALIGN(src->width, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_NV12;
-        isSemiPlanar = true;
-        break;
-
-    /* 8-bit yuv422 semi-planar */
-    case AV_PIX_FMT_NV16:
-        dst_stride[0] = FFALIGN(src->width, 64);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_NV16;
-        isSemiPlanar = false;
-        break;
-
-    /*8-bit yuv422 planar */
-    case AV_PIX_FMT_YUYV422:
-        dst_stride[0] = FFALIGN(src->width, 16) * 2;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_YUYV422;
-        isSemiPlanar = false;
-        break;
-
-    case AV_PIX_FMT_UYVY422:
-        dst_stride[0] = FFALIGN(src->width, 16) * 2;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_UYVY422;
-        isSemiPlanar = false;
-        break;
-
-    /* 10-bit YUV420 semi-planar, little endian, most significant bits */
-    case AV_PIX_FMT_P010LE:
-        dst_stride[0] = FFALIGN(src->width * 2, 128);
-        dst_stride[1] = dst_stride[0];
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_P010LE;
-        isSemiPlanar = true;
-        break;
-
-    /* 32-bit RGBA packed */
-    case AV_PIX_FMT_RGBA:
-        /* RGBA for the scaler has a 16-byte width/64-byte stride alignment */
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_RGBA;
-        isSemiPlanar = false;
-        break;
-
-    case AV_PIX_FMT_BGRA:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_BGRA;
-        isSemiPlanar = false;
-        break;
-
-    case AV_PIX_FMT_ABGR:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_ABGR;
-        isSemiPlanar = false;
-        break;
-
-    case AV_PIX_FMT_ARGB:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_ARGB;
-        isSemiPlanar = false;
-        break;
-
-    case AV_PIX_FMT_BGR0:
-        dst_stride[0] = FFALIGN(src->width, 16) * 4;
-        dst_stride[1] = 0;
-        dst_stride[2] = 0;
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_BGR0;
-        isSemiPlanar = false;
-        break;
-
     /* 24-bit BGR planar not supported for hwupload */
-    /*
-    case AV_PIX_FMT_BGRP:
-        dst_stride[0] = FFALIGN(src->width, 32);
-        dst_stride[1] = FFALIGN(src->width, 32);
-        dst_stride[2] = FFALIGN(src->width, 32);
-        dst_stride[3] = 0;
-
-        pixel_format = NI_PIX_FMT_BGRP;
-        isSemiPlanar = false;
-        break;
-    */
-    default:
+    layout = avpriv_ni_frame_layout(src->format);
+    if (!layout || layout->pix_fmt == AV_PIX_FMT_BGRP) {
         av_log(hwfc, AV_LOG_ERROR, "Pixel format %s not supported by device %s\n",
 #if IS_FFMPEG_70_AND_ABOVE_FOR_LIBAVUTIL
                av_get_pix_fmt_name(src->format), ffhwframesctx(hwfc)->hw_type->name);
@@ -1196,6 +888,10 @@ static int ni_hwup_frame(AVHWFramesContext *hwfc, AVFrame *dst, const AVFrame *s
         return AVERROR(EINVAL);
     }
 
+    ni_layout_planes(layout, src->width, src->height, dst_stride, NULL);
+    pixel_format = layout->ni_pix_fmt;
+    isSemiPlanar = layout->semi_planar;
+
     // check input resolution zero copy compatible or not
     if (ni_uploader_frame_zerocopy_check(&f_hwctx->api_ctx,
         src->width, src->height,
@@ -1314,7 +1010,7 @@ const HWContextType ff_hwcontext_type_ni_quadra = {
     .name = "NI_QUADRA",
 
     .device_hwctx_size = sizeof(AVNIDeviceContext),
-    .frames_hwctx_size = sizeof(AVNIFramesContext),
+    .frames_hwctx_size = sizeof(NIFramesContext),
 
     .device_create = ni_device_create,
     .device_uninit = ni_device_uninit,
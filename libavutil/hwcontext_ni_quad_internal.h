@@ -0,0 +1,50 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_HWCONTEXT_NI_QUAD_INTERNAL_H
+#define AVUTIL_HWCONTEXT_NI_QUAD_INTERNAL_H
+
+#include "pixfmt.h"
+
+typedef struct NIPlaneLayout {
+    int num, den; /* row size in bytes is width * num / den */
+    int align;    /* device stride alignment, 0 for an absent plane */
+    int log2_h;   /* vertical chroma subsampling */
+} NIPlaneLayout;
+
+/* Device frame layout of each supported sw_format */
+typedef struct NIFrameLayout {
+    enum AVPixelFormat pix_fmt;
+    int ni_pix_fmt;
+    int semi_planar;  /* reported as semi-planar to the device on upload */
+    int sample_size;  /* bytes replicated into the right padding on upload */
+    int hpad;         /* replicate the last sample up to the device stride */
+    int vpad;         /* replicate the last line up to an even plane height */
+    NIPlaneLayout plane[4];
+} NIFrameLayout;
+
+/**
+ * Look up the device frame layout of a pixel format. The same table is used
+ * by the hwcontext transfers and by the filters exchanging raw frames with
+ * the device.
+ *
+ * @return the layout, or NULL if the device does not support pix_fmt
+ */
+const NIFrameLayout *avpriv_ni_frame_layout(enum AVPixelFormat pix_fmt);
+
+#endif /* AVUTIL_HWCONTEXT_NI_QUAD_INTERNAL_H */
@@ -0,0 +1,228 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+#include "attributes.h"
+#include "cpu.h"
+#include "error.h"
+#include "macros.h"
+#include "mem.h"
+#include "planecopy.h"
+#include "slicethread.h"
+#include "thread.h"
+
+/* Copies at least this large are unlikely to be read back from cache. */
+#define PLANE_COPY_NT_THRESHOLD     (1 << 20)
+/* Copies at least this large are split across the worker threads. */
+#define PLANE_COPY_SLICE_THRESHOLD  (1 << 22)
+/* Copying is memory bound, more threads than this do not help. */
+#define PLANE_COPY_MAX_THREADS      4
+
+/* state of a single copy, owned by the calling thread */
+typedef struct PlaneCopyJob {
+    const PlaneCopyDSPContext *dsp;
+    const PlaneCopyDesc       *planes;
+    int                        nb_planes;
+    int                        nt;
+} PlaneCopyJob;
+
+struct PlaneCopyContext {
+    PlaneCopyDSPContext dsp;
+    AVSliceThread      *slicethread;
+    int                 nb_threads;
+
+    /* serializes the copies run on the slice threads */
+    AVMutex             lock;
+    const PlaneCopyJob *job;
+};
+
+static void copy_plane_c(uint8_t *dst, ptrdiff_t dst_linesize,
+                         const uint8_t *src, ptrdiff_t src_linesize,
+                         ptrdiff_t bytewidth, int height)
+{
+    for (; height > 0; height--) {
+        memcpy(dst, src, bytewidth);
+        dst += dst_linesize;
+        src += src_linesize;
+    }
+}
+
+av_cold void ff_plane_copy_dsp_init(PlaneCopyDSPContext *c)
+{
+    c->copy_plane_nt = copy_plane_c;
+    c->nt_align      = 1;
+    c->nt_width      = 1;
+
+#if ARCH_X86
+    ff_plane_copy_dsp_init_x86(c);
+#endif
+}
+
+static int nt_usable(const PlaneCopyDSPContext *dsp, const uint8_t *dst,
+                     ptrdiff_t dst_linesize, ptrdiff_t src_linesize,
+                     ptrdiff_t bytewidth)
+{
+    ptrdiff_t bw_aligned = FFALIGN(bytewidth, dsp->nt_width);
+
+    return !((uintptr_t)dst & (dsp->nt_align - 1)) &&
+           !(dst_linesize & (dsp->nt_align - 1)) &&
+           bw_aligned <= dst_linesize && bw_aligned <= src_linesize;
+}
+
+static void copy_rows(const PlaneCopyDSPContext *dsp, const PlaneCopyDesc *p,
+                      int y0, int y1, int nt)
+{
+    uint8_t       *dst = p->dst + y0 * p->dst_linesize;
+    const uint8_t *src = p->src + y0 * p->src_linesize;
+    int h = y1 - y0;
+
+    if (h <= 0 || p->bytewidth <= 0)
+        return;
+
+    if (p->dst_linesize == p->src_linesize && p->dst_linesize >= p->bytewidth) {
+        /* identical layouts, copy the rows and the padding between them
+         * as one block */
+        size_t size = (size_t)(h - 1) * p->dst_linesize + p->bytewidth;
+        size_t body = size & ~(size_t)(dsp->nt_width - 1);
+
+        if (nt && body && !((uintptr_t)dst & (dsp->nt_align - 1))) {
+            dsp->copy_plane_nt(dst, body, src, body, body, 1);
+            memcpy(dst + body, src + body, size - body);
+        } else {
+            memcpy(dst, src, size);
+        }
+        return;
+    }
+
+    /* The SIMD kernels may read past bytewidth, which is only safe while
+     * another row follows, so the last row is always copied with memcpy. */
+    if (nt && h > 1 &&
+        nt_usable(dsp, dst, p->dst_linesize, p->src_linesize, p->bytewidth)) {
+        dsp->copy_plane_nt(dst, p->dst_linesize, src, p->src_linesize,
+                           p->bytewidth, h - 1);
+        dst += (h - 1) * p->dst_linesize;
+        src += (h - 1) * p->src_linesize;
+        h    = 1;
+    }
+    copy_plane_c(dst, p->dst_linesize, src, p->src_linesize, p->bytewidth, h);
+}
+
+static void copy_job(const PlaneCopyJob *job, int jobnr, int nb_jobs)
+{
+    for (int i = 0; i < job->nb_planes; i++) {
+        const PlaneCopyDesc *p = &job->planes[i];
+        int y0 = (int)((int64_t)p->height *  jobnr      / nb_jobs);
+        int y1 = (int)((int64_t)p->height * (jobnr + 1) / nb_jobs);
+
+        copy_rows(job->dsp, p, y0, y1, job->nt);
+    }
+}
+
+static void copy_slice(void *priv, int jobnr, int threadnr,
+                       int nb_jobs, int nb_threads)
+{
+    PlaneCopyContext *ctx = priv;
+
+    copy_job(ctx->job, jobnr, nb_jobs);
+}
+
+int avpriv_plane_copy_alloc(PlaneCopyContext **pctx, int nb_threads)
+{
+    PlaneCopyContext *ctx;
+    int ret;
+
+    ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx)
+        return AVERROR(ENOMEM);
+
+    ff_plane_copy_dsp_init(&ctx->dsp);
+
+    ret = ff_mutex_init(&ctx->lock, NULL);
+    if (ret) {
+        av_free(ctx);
+        return AVERROR(ret);
+    }
+
+    if (!nb_threads)
+        nb_threads = FFMIN(av_cpu_count(), PLANE_COPY_MAX_THREADS);
+
+    ctx->nb_threads = 1;
+    if (nb_threads > 1) {
+        ret = avpriv_slicethread_create(&ctx->slicethread, ctx, copy_slice,
+                                        NULL, nb_threads);
+        /* without thread support copy on the calling thread */
+        if (ret > 1)
+            ctx->nb_threads = ret;
+        else if (ret >= 0)
+            avpriv_slicethread_free(&ctx->slicethread);
+        else if (ret != AVERROR(ENOSYS)) {
+            ff_mutex_destroy(&ctx->lock);
+            av_free(ctx);
+            return ret;
+        }
+    }
+
+    *pctx = ctx;
+    return 0;
+}
+
+void avpriv_plane_copy(PlaneCopyContext *ctx,
+                       const PlaneCopyDesc *planes, int nb_planes)
+{
+    PlaneCopyDSPContext dsp;
+    PlaneCopyJob job = { .planes = planes, .nb_planes = nb_planes };
+    size_t total = 0;
+
+    for (int i = 0; i < nb_planes; i++)
+        total += (size_t)FFMAX(planes[i].bytewidth, 0) *
+                 FFMAX(planes[i].height, 0);
+
+    job.nt = total >= PLANE_COPY_NT_THRESHOLD;
+
+    if (!ctx) {
+        ff_plane_copy_dsp_init(&dsp);
+        job.dsp = &dsp;
+        copy_job(&job, 0, 1);
+        return;
+    }
+
+    job.dsp = &ctx->dsp;
+
+    if (!ctx->slicethread || total < PLANE_COPY_SLICE_THRESHOLD) {
+        copy_job(&job, 0, 1);
+        return;
+    }
+
+    ff_mutex_lock(&ctx->lock);
+    ctx->job = &job;
+    avpriv_slicethread_execute(ctx->slicethread, ctx->nb_threads, 0);
+    ctx->job = NULL;
+    ff_mutex_unlock(&ctx->lock);
+}
+
+void avpriv_plane_copy_free(PlaneCopyContext **pctx)
+{
+    if (!*pctx)
+        return;
+
+    avpriv_slicethread_free(&(*pctx)->slicethread);
+    ff_mutex_destroy(&(*pctx)->lock);
+    av_freep(pctx);
+}
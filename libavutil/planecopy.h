@@ -0,0 +1,86 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Stride-aware plane copy engine used for host <-> device frame transfers.
+ */
+
+#ifndef AVUTIL_PLANECOPY_H
+#define AVUTIL_PLANECOPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct PlaneCopyDSPContext {
+    /**
+     * Copy height rows of bytewidth bytes, bypassing the cache on store
+     * where the implementation supports it.
+     *
+     * dst must be aligned to nt_align and dst_linesize must be a multiple
+     * of nt_align. The implementation may copy up to
+     * FFALIGN(bytewidth, nt_width) bytes per row, so both linesizes must be
+     * at least that large.
+     */
+    void (*copy_plane_nt)(uint8_t *dst, ptrdiff_t dst_linesize,
+                          const uint8_t *src, ptrdiff_t src_linesize,
+                          ptrdiff_t bytewidth, int height);
+    int nt_align;
+    int nt_width;
+} PlaneCopyDSPContext;
+
+void ff_plane_copy_dsp_init(PlaneCopyDSPContext *c);
+void ff_plane_copy_dsp_init_x86(PlaneCopyDSPContext *c);
+
+/**
+ * Description of a single plane to be copied.
+ */
+typedef struct PlaneCopyDesc {
+    uint8_t       *dst;
+    ptrdiff_t      dst_linesize;
+    const uint8_t *src;
+    ptrdiff_t      src_linesize;
+    ptrdiff_t      bytewidth;
+    int            height;
+} PlaneCopyDesc;
+
+typedef struct PlaneCopyContext PlaneCopyContext;
+
+/**
+ * Allocate a plane copy context.
+ *
+ * @param nb_threads number of threads used for large copies, 0 for automatic
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int avpriv_plane_copy_alloc(PlaneCopyContext **pctx, int nb_threads);
+
+/**
+ * Copy nb_planes planes. Planes with identical source and destination
+ * linesizes are copied as one contiguous block, large planes use
+ * streaming stores and are split across the context's threads.
+ * A context may be used by several threads at once; the copies that use
+ * its threads then run one after the other.
+ *
+ * @param ctx copy context, or NULL to copy on the calling thread only
+ */
+void avpriv_plane_copy(PlaneCopyContext *ctx,
+                       const PlaneCopyDesc *planes, int nb_planes);
+
+void avpriv_plane_copy_free(PlaneCopyContext **pctx);
+
+#endif /* AVUTIL_PLANECOPY_H */
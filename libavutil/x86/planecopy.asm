@@ -0,0 +1,72 @@
+;*****************************************************************************
+;* x86-optimized plane copy with non-temporal stores
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION .text
+
+;-----------------------------------------------------------------------------
+; void ff_copy_plane_nt(uint8_t *dst, ptrdiff_t dst_linesize,
+;                       const uint8_t *src, ptrdiff_t src_linesize,
+;                       ptrdiff_t bytewidth, int height)
+;
+; bytewidth is rounded up to 4 * mmsize, dst must be mmsize aligned.
+;-----------------------------------------------------------------------------
+%macro COPY_PLANE_NT 0
+cglobal copy_plane_nt, 6, 7, 4, dst, dst_linesize, src, src_linesize, bw, height, rowpos
+    add bwq, 4 * mmsize - 1
+    and bwq, ~(4 * mmsize - 1)
+    add dstq, bwq
+    add srcq, bwq
+    neg bwq
+
+.row_start:
+    mov rowposq, bwq
+
+.loop:
+    movu  m0, [srcq + rowposq + 0 * mmsize]
+    movu  m1, [srcq + rowposq + 1 * mmsize]
+    movu  m2, [srcq + rowposq + 2 * mmsize]
+    movu  m3, [srcq + rowposq + 3 * mmsize]
+
+    movnta [dstq + rowposq + 0 * mmsize], m0
+    movnta [dstq + rowposq + 1 * mmsize], m1
+    movnta [dstq + rowposq + 2 * mmsize], m2
+    movnta [dstq + rowposq + 3 * mmsize], m3
+
+    add rowposq, 4 * mmsize
+    jnz .loop
+
+    add srcq, src_linesizeq
+    add dstq, dst_linesizeq
+    dec heightd
+    jnz .row_start
+
+    sfence
+    RET
+%endmacro
+
+INIT_XMM sse2
+COPY_PLANE_NT
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+COPY_PLANE_NT
+%endif
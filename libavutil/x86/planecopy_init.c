@@ -0,0 +1,47 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavutil/attributes.h"
+#include "libavutil/planecopy.h"
+#include "libavutil/x86/cpu.h"
+
+void ff_copy_plane_nt_sse2(uint8_t *dst, ptrdiff_t dst_linesize,
+                           const uint8_t *src, ptrdiff_t src_linesize,
+                           ptrdiff_t bytewidth, int height);
+void ff_copy_plane_nt_avx2(uint8_t *dst, ptrdiff_t dst_linesize,
+                           const uint8_t *src, ptrdiff_t src_linesize,
+                           ptrdiff_t bytewidth, int height);
+
+av_cold void ff_plane_copy_dsp_init_x86(PlaneCopyDSPContext *c)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        c->copy_plane_nt = ff_copy_plane_nt_sse2;
+        c->nt_align      = 16;
+        c->nt_width      = 64;
+    }
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        c->copy_plane_nt = ff_copy_plane_nt_avx2;
+        c->nt_align      = 32;
+        c->nt_width      = 128;
+    }
+}
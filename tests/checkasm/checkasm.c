@@ -276,6 +276,9 @@ static const struct {
     #if CONFIG_SOBEL_FILTER
         { "vf_sobel", checkasm_check_vf_sobel },
     #endif
+    #if CONFIG_YUV420TO444_NI_QUADRA_FILTER || CONFIG_YUV444TO420_NI_QUADRA_FILTER
+        { "vf_yuvsplit_ni", checkasm_check_vf_yuvsplit_ni },
+    #endif
 #endif
 #if CONFIG_SWSCALE
     { "sw_gbrp", checkasm_check_sw_gbrp },
@@ -289,6 +292,7 @@ static const struct {
         { "fixed_dsp", checkasm_check_fixed_dsp },
         { "float_dsp", checkasm_check_float_dsp },
         { "lls",       checkasm_check_lls },
+        { "planecopy", checkasm_check_planecopy },
         { "av_tx",     checkasm_check_av_tx },
 #endif
     { NULL }
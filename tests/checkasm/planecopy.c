@@ -0,0 +1,81 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+#include "libavutil/planecopy.h"
+
+#include "checkasm.h"
+
+#define MAX_STRIDE 2048
+#define HEIGHT     8
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        for (int j = 0; j < size; j += 4) \
+            AV_WN32(buf + j, rnd());      \
+    } while (0)
+
+static void check_copy_plane_nt(const PlaneCopyDSPContext *c)
+{
+    /* device strides used by the NI frame layouts */
+    static const int widths[] = { 64, 128, 720, 1280, 1920 };
+    LOCAL_ALIGNED_32(uint8_t, src,  [MAX_STRIDE * HEIGHT]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [MAX_STRIDE * HEIGHT]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [MAX_STRIDE * HEIGHT]);
+
+    declare_func(void, uint8_t *dst, ptrdiff_t dst_linesize,
+                 const uint8_t *src, ptrdiff_t src_linesize,
+                 ptrdiff_t bytewidth, int height);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+        int w = widths[i];
+        ptrdiff_t src_linesize = FFALIGN(w, 128) + 128;
+        ptrdiff_t dst_linesize = FFALIGN(w, 128);
+
+        if (check_func(c->copy_plane_nt, "copy_plane_nt_%d", w)) {
+            randomize_buffers(src, MAX_STRIDE * HEIGHT);
+            memset(dst0, 0, MAX_STRIDE * HEIGHT);
+            memset(dst1, 0, MAX_STRIDE * HEIGHT);
+
+            call_ref(dst0, dst_linesize, src, src_linesize, w, HEIGHT);
+            call_new(dst1, dst_linesize, src, src_linesize, w, HEIGHT);
+
+            for (int y = 0; y < HEIGHT; y++) {
+                if (memcmp(dst0 + y * dst_linesize, dst1 + y * dst_linesize, w)) {
+                    fail();
+                    break;
+                }
+            }
+
+            bench_new(dst1, dst_linesize, src, src_linesize, w, HEIGHT);
+        }
+    }
+}
+
+void checkasm_check_planecopy(void)
+{
+    PlaneCopyDSPContext c;
+
+    ff_plane_copy_dsp_init(&c);
+
+    check_copy_plane_nt(&c);
+    report("copy_plane_nt");
+}
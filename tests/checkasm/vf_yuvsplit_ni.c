@@ -0,0 +1,114 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_yuvsplit_ni_init.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 512
+#define WIDTH_PADDED 512 + 64
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        int j;                            \
+        uint8_t *tmp_buf = (uint8_t *)buf;\
+        for (j = 0; j < size; j++)        \
+            tmp_buf[j] = rnd() & 0xFF;    \
+    } while (0)
+
+/* widths off the vector size run the scalar tail after the vector loop */
+static const int widths[] = { 1, 7, 16, 33, 64, 127, WIDTH / 2 };
+
+static void check_deinterleave(int depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,      [2 * WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst0_ref, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst1_ref, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst0_new, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst1_new, [WIDTH_PADDED]);
+    const int bps = depth > 8 ? 2 : 1;
+    NIYUVSplitDSPContext dsp;
+
+    declare_func(void, uint8_t *dst0, uint8_t *dst1, const uint8_t *src,
+                 ptrdiff_t w);
+
+    ff_yuvsplit_ni_init(&dsp, depth);
+
+    if (check_func(dsp.deinterleave, "yuvsplit_ni_deinterleave_%d", depth)) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            int w = widths[i];
+
+            randomize_buffers(src, 2 * WIDTH_PADDED);
+            memset(dst0_ref, 0, WIDTH_PADDED);
+            memset(dst1_ref, 0, WIDTH_PADDED);
+            memset(dst0_new, 0, WIDTH_PADDED);
+            memset(dst1_new, 0, WIDTH_PADDED);
+
+            call_ref(dst0_ref, dst1_ref, src, w);
+            call_new(dst0_new, dst1_new, src, w);
+            if (memcmp(dst0_ref, dst0_new, WIDTH_PADDED) ||
+                memcmp(dst1_ref, dst1_new, WIDTH_PADDED))
+                fail();
+        }
+        bench_new(dst0_new, dst1_new, src, WIDTH / bps);
+    }
+}
+
+static void check_interleave(int depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, src0,    [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, src1,    [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [2 * WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [2 * WIDTH_PADDED]);
+    const int bps = depth > 8 ? 2 : 1;
+    NIYUVSplitDSPContext dsp;
+
+    declare_func(void, uint8_t *dst, const uint8_t *src0, const uint8_t *src1,
+                 ptrdiff_t w);
+
+    ff_yuvsplit_ni_init(&dsp, depth);
+
+    if (check_func(dsp.interleave, "yuvsplit_ni_interleave_%d", depth)) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            int w = widths[i];
+
+            randomize_buffers(src0, WIDTH_PADDED);
+            randomize_buffers(src1, WIDTH_PADDED);
+            memset(dst_ref, 0, 2 * WIDTH_PADDED);
+            memset(dst_new, 0, 2 * WIDTH_PADDED);
+
+            call_ref(dst_ref, src0, src1, w);
+            call_new(dst_new, src0, src1, w);
+            if (memcmp(dst_ref, dst_new, 2 * WIDTH_PADDED))
+                fail();
+        }
+        bench_new(dst_new, src0, src1, WIDTH / bps);
+    }
+}
+
+void checkasm_check_vf_yuvsplit_ni(void)
+{
+    check_deinterleave(8);
+    check_deinterleave(10);
+    report("deinterleave");
+
+    check_interleave(8);
+    check_interleave(10);
+    report("interleave");
+}
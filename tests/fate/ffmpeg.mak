@@ -96,6 +96,16 @@ FATE_FFMPEG-$(call FILTERDEMDEC, AMIX ARESAMPLE SINE, RAWVIDEO, \
 fate-shortest: tests/data/vsynth1.yuv
 fate-shortest: CMD = framecrc -auto_conversion_filters -f lavfi -i "sine=3000:d=10" -f lavfi -i "sine=1000:d=1" -sws_flags +accurate_rnd+bitexact -fflags +bitexact -flags +bitexact -idct simple -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -filter_complex "[0:a:0][1:a:0]amix=inputs=2[audio]" -map 2:v:0 -map "[audio]" -sws_flags +accurate_rnd+bitexact -fflags +bitexact -flags +bitexact -idct simple -dct fastint -qscale 10 -threads 1 -c:v mpeg4 -c:a ac3_fixed -shortest
 
+# -shortest with enough streams for the sync queue to keep its timestamp heaps
+FATE_FFMPEG-$(call FILTERFRAMECRC, TESTSRC SINE) += fate-shortest-many-streams
+fate-shortest-many-streams: CMD = framecrc                                                         \
+    -filter_complex "testsrc=d=2:s=32x24:r=10[v0];testsrc=d=2:s=32x24:r=15[v1]"                     \
+    -filter_complex "testsrc=d=2:s=32x24:r=25[v2];testsrc=d=2:s=32x24:r=6[v3]"                      \
+    -filter_complex "sine=d=2:samples_per_frame=1024[a0];sine=d=2:samples_per_frame=441[a1]"        \
+    -filter_complex "sine=d=1:samples_per_frame=2000[a2];sine=d=2:samples_per_frame=4410[a3]"       \
+    -map "[v0]" -map "[a0]" -map "[v1]" -map "[a1]" -map "[v2]" -map "[a2]" -map "[v3]" -map "[a3]" \
+    -shortest
+
 # test interleaving video with a sparse subtitle stream
 FATE_SAMPLES_FFMPEG-$(call ALLYES, COLOR_FILTER, VOBSUB_DEMUXER, MATROSKA_DEMUXER,, \
                            RAWVIDEO_ENCODER, MATROSKA_MUXER, FRAMECRC_MUXER) += fate-shortest-sub
@@ -267,3 +277,9 @@ FATE_FFMPEG-$(call ENCDEC2, MPEG2VIDEO, FFV1, NUT, HSTACK_FILTER PIPE_PROTOCOL F
 # test matching by stream disposition
 fate-ffmpeg-spec-disposition: CMD = framecrc -i $(TARGET_SAMPLES)/mpegts/pmtchange.ts -map '0:disp:visual_impaired+descriptions:1' -c copy
 FATE_FFMPEG-$(call FRAMECRC, MPEGTS,,) += fate-ffmpeg-spec-disposition
+
+# run the tasks on a pool of 2 threads, the output is the same as with a thread per task
+FATE_FFMPEG-$(call FILTERFRAMECRC, TESTSRC SINE SPLIT ASPLIT) += fate-ffmpeg-sched-pool
+fate-ffmpeg-sched-pool: CMD = framecrc -sched_pool 2                                         \
+    -filter_complex "testsrc=d=1:s=64x48:r=10,split=3[v0][v1][v2];sine=d=1,asplit=2[a0][a1]" \
+    -map "[v0]" -map "[a0]" -map "[v1]" -map "[a1]" -map "[v2]"
@@ -763,6 +763,27 @@ FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SPLIT_FILTER AVGBLUR_FILTER        \
                            METADATA_FILTER WRAPPED_AVFRAME_ENCODER NULL_MUXER \
                            PIPE_PROTOCOL) += $(FATE_FILTER_REFCMP_METADATA-yes)
 
+FATE_FILTER-yes += fate-filter-ni-compose
+fate-filter-ni-compose: libavfilter/tests/ni_compose$(EXESUF)
+fate-filter-ni-compose: CMD = run libavfilter/tests/ni_compose$(EXESUF)
+
+FATE_FILTER-yes += fate-filter-ni-pipeline
+fate-filter-ni-pipeline: libavfilter/tests/ni_pipeline$(EXESUF)
+fate-filter-ni-pipeline: CMD = run libavfilter/tests/ni_pipeline$(EXESUF)
+
+FATE_FILTER-$(call ALLYES, SPLIT_FILTER NULL_FILTER SETPTS_FILTER \
+                           FORMAT_FILTER SCALE_FILTER) += fate-filter-ni-pool-plan
+fate-filter-ni-pool-plan: libavfilter/tests/ni_pool_plan$(EXESUF)
+fate-filter-ni-pool-plan: CMD = run libavfilter/tests/ni_pool_plan$(EXESUF)
+
+FATE_FILTER-yes += fate-filter-ni-scale-cache
+fate-filter-ni-scale-cache: libavfilter/tests/ni_scale_cache$(EXESUF)
+fate-filter-ni-scale-cache: CMD = run libavfilter/tests/ni_scale_cache$(EXESUF)
+
+FATE_FILTER-yes += fate-filter-ni-yolo
+fate-filter-ni-yolo: libavfilter/tests/ni_yolo$(EXESUF)
+fate-filter-ni-yolo: CMD = run libavfilter/tests/ni_yolo$(EXESUF)
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
@@ -3,6 +3,10 @@ fate-av1-levels: libavcodec/tests/av1_levels$(EXESUF)
 fate-av1-levels: CMD = run libavcodec/tests/av1_levels$(EXESUF)
 fate-av1-levels: REF = /dev/null
 
+FATE_LIBAVCODEC-$(call ALLYES, AV1_RAWTOTILE_BSF AV1_TILE_REPACK_BSF) += fate-av1-tile-repack
+fate-av1-tile-repack: libavcodec/tests/av1_tile_repack$(EXESUF)
+fate-av1-tile-repack: CMD = run libavcodec/tests/av1_tile_repack$(EXESUF)
+
 FATE_LIBAVCODEC-yes += fate-avpacket
 fate-avpacket: libavcodec/tests/avpacket$(EXESUF)
 fate-avpacket: CMD = run libavcodec/tests/avpacket$(EXESUF)
@@ -71,6 +75,10 @@ fate-h265-levels: libavcodec/tests/h265_levels$(EXESUF)
 fate-h265-levels: CMD = run libavcodec/tests/h265_levels$(EXESUF)
 fate-h265-levels: REF = /dev/null
 
+FATE_LIBAVCODEC-$(call ALLYES, HEVC_FRAME_SPLIT_BSF HEVC_TILE_REPACK_BSF) += fate-hevc-tile-repack
+fate-hevc-tile-repack: libavcodec/tests/hevc_tile_repack$(EXESUF)
+fate-hevc-tile-repack: CMD = run libavcodec/tests/hevc_tile_repack$(EXESUF)
+
 FATE_LIBAVCODEC-$(CONFIG_IIRFILTER) += fate-iirfilter
 fate-iirfilter: libavcodec/tests/iirfilter$(EXESUF)
 fate-iirfilter: CMD = run libavcodec/tests/iirfilter$(EXESUF)
@@ -90,6 +98,22 @@ fate-mathops: libavcodec/tests/mathops$(EXESUF)
 fate-mathops: CMD = run libavcodec/tests/mathops$(EXESUF)
 fate-mathops: CMP = null
 
+FATE_LIBAVCODEC-yes += fate-ni-frame-ring
+fate-ni-frame-ring: libavcodec/tests/ni_frame_ring$(EXESUF)
+fate-ni-frame-ring: CMD = run libavcodec/tests/ni_frame_ring$(EXESUF)
+
+FATE_LIBAVCODEC-$(HAVE_THREADS) += fate-ni-dec-prefetch
+fate-ni-dec-prefetch: libavcodec/tests/ni_dec_prefetch$(EXESUF)
+fate-ni-dec-prefetch: CMD = run libavcodec/tests/ni_dec_prefetch$(EXESUF)
+
+FATE_LIBAVCODEC-$(HAVE_THREADS) += fate-ni-recycle-ring
+fate-ni-recycle-ring: libavcodec/tests/ni_recycle_ring$(EXESUF)
+fate-ni-recycle-ring: CMD = run libavcodec/tests/ni_recycle_ring$(EXESUF)
+
+FATE_LIBAVCODEC-$(CONFIG_NI_QUADRA_MOCK) += fate-ni-enc
+fate-ni-enc: libavcodec/tests/nienc$(EXESUF)
+fate-ni-enc: CMD = run libavcodec/tests/nienc$(EXESUF)
+
 FATE_LIBAVCODEC-$(CONFIG_JPEG2000_ENCODER) += fate-j2k-dwt
 fate-j2k-dwt: libavcodec/tests/jpeg2000dwt$(EXESUF)
 fate-j2k-dwt: CMD = run libavcodec/tests/jpeg2000dwt$(EXESUF)
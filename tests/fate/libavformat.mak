@@ -26,6 +26,11 @@ FATE_LIBAVFORMAT-$(CONFIG_IMF_DEMUXER) += fate-imf
 fate-imf: libavformat/tests/imf$(EXESUF)
 fate-imf: CMD = run libavformat/tests/imf$(EXESUF)
 
+FATE_LIBAVFORMAT-$(CONFIG_HLS_MUXER) += fate-ni-scte35
+fate-ni-scte35: libavformat/tests/ni_scte35$(EXESUF)
+fate-ni-scte35: CMD = run libavformat/tests/ni_scte35$(EXESUF)
+fate-ni-scte35: CMP = null
+
 FATE_LIBAVFORMAT += fate-seek_utils
 fate-seek_utils: libavformat/tests/seek_utils$(EXESUF)
 fate-seek_utils: CMD = run libavformat/tests/seek_utils$(EXESUF)
@@ -0,0 +1,372 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the hevc_frame_split throughput in tiles per second on a
+ * synthetic tiled HEVC stream, with one thread and with the worker pool.
+ *
+ * Usage: hevc_tile_split_bench [-s WxH] [-g COLSxROWS] [-n frames]
+ *                              [-b slice bytes] [-t threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavcodec/bsf.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+
+#define CTB_LOG2 6
+#define NAL_IDR_W_RADL 19
+#define NAL_VPS 32
+#define NAL_SPS 33
+#define NAL_PPS 34
+
+typedef struct BitWriter {
+    uint8_t buf[256];
+    int bits;
+} BitWriter;
+
+static void put(BitWriter *bw, int n, uint32_t v)
+{
+    while (n--) {
+        if (v >> n & 1)
+            bw->buf[bw->bits >> 3] |= 0x80 >> (bw->bits & 7);
+        bw->bits++;
+    }
+}
+
+static void put_ue(BitWriter *bw, uint32_t v)
+{
+    int len = av_log2(v + 1);
+
+    put(bw, len, 0);
+    put(bw, len + 1, v + 1);
+}
+
+static void put_trailing_bits(BitWriter *bw)
+{
+    put(bw, 1, 1);
+    while (bw->bits & 7)
+        put(bw, 1, 0);
+}
+
+/* Append a NAL unit with start code and emulation prevention. */
+static uint8_t *put_nal(uint8_t *dst, int type, const uint8_t *rbsp,
+                        size_t size)
+{
+    int zeros = 0;
+
+    *dst++ = 0; *dst++ = 0; *dst++ = 0; *dst++ = 1;
+    *dst++ = type << 1;
+    *dst++ = 1;
+    for (size_t i = 0; i < size; i++) {
+        if (zeros == 2 && rbsp[i] < 4) {
+            *dst++ = 3;
+            zeros  = 0;
+        }
+        zeros  = rbsp[i] ? 0 : zeros + 1;
+        *dst++ = rbsp[i];
+    }
+    return dst;
+}
+
+static void put_ptl(BitWriter *bw)
+{
+    put(bw, 8, 0x01);           /* profile space, tier, Main */
+    put(bw, 32, 0x60000000);    /* compatible with Main and Main 10 */
+    put(bw, 4, 0x9);            /* progressive, frame only */
+    put(bw, 32, 0);             /* 43 reserved bits and inbld */
+    put(bw, 12, 0);
+    put(bw, 8, 153);            /* level 5.1 */
+}
+
+static uint8_t *put_parameter_sets(uint8_t *dst, int w, int h,
+                                   int cols, int rows)
+{
+    BitWriter bw = { 0 };
+
+    put(&bw, 4, 0);             /* vps_video_parameter_set_id */
+    put(&bw, 2, 3);             /* base layer internal, available */
+    put(&bw, 6, 0);             /* vps_max_layers_minus1 */
+    put(&bw, 3, 0);             /* vps_max_sub_layers_minus1 */
+    put(&bw, 1, 1);             /* vps_temporal_id_nesting_flag */
+    put(&bw, 16, 0xffff);
+    put_ptl(&bw);
+    put(&bw, 1, 1);             /* sub layer ordering info present */
+    put_ue(&bw, 0); put_ue(&bw, 0); put_ue(&bw, 0);
+    put(&bw, 6, 0);             /* vps_max_layer_id */
+    put_ue(&bw, 0);             /* vps_num_layer_sets_minus1 */
+    put(&bw, 2, 0);             /* no timing info, no extension */
+    put_trailing_bits(&bw);
+    dst = put_nal(dst, NAL_VPS, bw.buf, bw.bits >> 3);
+
+    memset(&bw, 0, sizeof(bw));
+    put(&bw, 4, 0);             /* sps_video_parameter_set_id */
+    put(&bw, 3, 0);             /* sps_max_sub_layers_minus1 */
+    put(&bw, 1, 1);             /* sps_temporal_id_nesting_flag */
+    put_ptl(&bw);
+    put_ue(&bw, 0);             /* sps_seq_parameter_set_id */
+    put_ue(&bw, 1);             /* chroma_format_idc */
+    put_ue(&bw, w);
+    put_ue(&bw, h);
+    put(&bw, 1, 0);             /* conformance_window_flag */
+    put_ue(&bw, 0); put_ue(&bw, 0);     /* bit depths */
+    put_ue(&bw, 4);             /* log2_max_pic_order_cnt_lsb_minus4 */
+    put(&bw, 1, 1);             /* sub layer ordering info present */
+    put_ue(&bw, 0); put_ue(&bw, 0); put_ue(&bw, 0);
+    put_ue(&bw, 0);             /* log2_min_luma_coding_block_size_minus3 */
+    put_ue(&bw, CTB_LOG2 - 3);
+    put_ue(&bw, 0);             /* log2_min_luma_transform_block_size_minus2 */
+    put_ue(&bw, 3);
+    put_ue(&bw, 0); put_ue(&bw, 0);     /* transform hierarchy depths */
+    put(&bw, 4, 0);             /* scaling list, amp, sao, pcm */
+    put_ue(&bw, 0);             /* num_short_term_ref_pic_sets */
+    put(&bw, 5, 0);             /* lt refs, tmvp, smoothing, vui, ext */
+    put_trailing_bits(&bw);
+    dst = put_nal(dst, NAL_SPS, bw.buf, bw.bits >> 3);
+
+    memset(&bw, 0, sizeof(bw));
+    put_ue(&bw, 0);             /* pps_pic_parameter_set_id */
+    put_ue(&bw, 0);             /* pps_seq_parameter_set_id */
+    put(&bw, 7, 0);             /* dependent slices, output flag, extra bits,
+                                 * sign hiding, cabac init */
+    put_ue(&bw, 0); put_ue(&bw, 0);     /* default ref idx */
+    put_ue(&bw, 0);             /* init_qp_minus26 */
+    put(&bw, 3, 0);             /* constrained intra, transform skip, cu qp */
+    put_ue(&bw, 0); put_ue(&bw, 0);     /* cb/cr qp offsets */
+    put(&bw, 4, 0);             /* slice chroma qp, weighted, transquant */
+    put(&bw, 2, 2);             /* tiles_enabled_flag */
+    put_ue(&bw, cols - 1);
+    put_ue(&bw, rows - 1);
+    put(&bw, 1, 1);             /* uniform_spacing_flag */
+    put(&bw, 5, 0);             /* loop filters, deblocking, scaling, lists */
+    put_ue(&bw, 0);             /* log2_parallel_merge_level_minus2 */
+    put(&bw, 2, 0);             /* header extension, pps extension */
+    put_trailing_bits(&bw);
+    return put_nal(dst, NAL_PPS, bw.buf, bw.bits >> 3);
+}
+
+static uint8_t *put_slice(uint8_t *dst, int addr, int addr_bits,
+                          const uint8_t *payload, int payload_size)
+{
+    BitWriter bw = { 0 };
+    uint8_t *p;
+
+    put(&bw, 1, !addr);         /* first_slice_segment_in_pic_flag */
+    put(&bw, 1, 0);             /* no_output_of_prior_pics_flag */
+    put_ue(&bw, 0);             /* slice_pic_parameter_set_id */
+    if (addr)
+        put(&bw, addr_bits, addr);
+    put_ue(&bw, 2);             /* I slice */
+    put_ue(&bw, 0);             /* slice_qp_delta, se(0) */
+    put_ue(&bw, 0);             /* num_entry_point_offsets */
+    put_trailing_bits(&bw);     /* byte_alignment() */
+
+    p = put_nal(dst, NAL_IDR_W_RADL, bw.buf, bw.bits >> 3);
+    /* the payload contains no zero bytes and needs no escaping */
+    memcpy(p, payload, payload_size);
+    return p + payload_size;
+}
+
+static int make_stream(AVPacket **pkts, int nb_frames, int w, int h,
+                       int cols, int rows, int slice_bytes,
+                       AVCodecParameters *par)
+{
+    int ctb_w = (w + (1 << CTB_LOG2) - 1) >> CTB_LOG2;
+    int ctb_h = (h + (1 << CTB_LOG2) - 1) >> CTB_LOG2;
+    int addr_bits = av_log2(ctb_w * ctb_h - 1) + 1;
+    size_t max_size = 1024 + (size_t)cols * rows * (slice_bytes + 64);
+    uint8_t *payload = av_malloc(slice_bytes);
+    uint8_t *p;
+    int ret = 0;
+
+    if (!payload)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < slice_bytes - 1; i++)
+        payload[i] = 0x10 + (i * 7 & 0xef);
+    payload[slice_bytes - 1] = 0x80;
+
+    par->extradata = av_mallocz(1024 + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!par->extradata) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    par->extradata_size = put_parameter_sets(par->extradata, w, h, cols, rows) -
+                          par->extradata;
+
+    for (int f = 0; f < nb_frames; f++) {
+        if (!(pkts[f] = av_packet_alloc()) ||
+            (ret = av_new_packet(pkts[f], max_size)) < 0) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+
+        p = pkts[f]->data;
+        if (!f)
+            p = put_parameter_sets(p, w, h, cols, rows);
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) {
+                int x = c * ctb_w / cols, y = r * ctb_h / rows;
+                p = put_slice(p, y * ctb_w + x, addr_bits, payload, slice_bytes);
+            }
+        }
+        av_shrink_packet(pkts[f], p - pkts[f]->data);
+        pkts[f]->pts = pkts[f]->dts = f;
+    }
+
+end:
+    av_free(payload);
+    return ret;
+}
+
+static double bench(AVPacket **pkts, int nb_frames, int threads,
+                    const AVCodecParameters *par, int *nb_tiles)
+{
+    AVBSFContext *bsf = NULL;
+    AVPacket *out = av_packet_alloc();
+    int64_t t0;
+    double ret = -1;
+
+    if (!out || av_bsf_alloc(av_bsf_get_by_name("hevc_frame_split"), &bsf) < 0 ||
+        avcodec_parameters_copy(bsf->par_in, par) < 0 ||
+        av_opt_set_int(bsf->priv_data, "threads", threads, 0) < 0 ||
+        av_bsf_init(bsf) < 0)
+        goto end;
+
+    *nb_tiles = 0;
+    t0 = av_gettime_relative();
+    for (int f = 0; f <= nb_frames; f++) {
+        AVPacket *in = NULL;
+
+        if (f < nb_frames && !(in = av_packet_clone(pkts[f])))
+            goto end;
+        if (av_bsf_send_packet(bsf, in) < 0) {
+            av_packet_free(&in);
+            goto end;
+        }
+        av_packet_free(&in);
+        while (av_bsf_receive_packet(bsf, out) >= 0) {
+            (*nb_tiles)++;
+            av_packet_unref(out);
+        }
+    }
+    ret = (av_gettime_relative() - t0) / 1e6;
+
+end:
+    av_packet_free(&out);
+    av_bsf_free(&bsf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    AVPacket **pkts = NULL;
+    int width = 7680, height = 4320, cols = 4, rows = 4;
+    int nb_frames = 60, slice_bytes = 64 * 1024, threads = 0;
+    int opt, ret = 1;
+
+    while ((opt = getopt(argc, argv, "hs:g:n:b:t:")) != -1) {
+        switch (opt) {
+        case 's':
+            if (av_parse_video_size(&width, &height, optarg) < 0) {
+                fprintf(stderr, "Invalid size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'g':
+            if (sscanf(optarg, "%dx%d", &cols, &rows) != 2 ||
+                cols < 1 || rows < 1) {
+                fprintf(stderr, "Invalid tile grid '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            nb_frames = FFMAX(atoi(optarg), 1);
+            break;
+        case 'b':
+            slice_bytes = FFMAX(atoi(optarg), 1);
+            break;
+        case 't':
+            threads = FFMAX(atoi(optarg), 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s WxH] [-g COLSxROWS] [-n frames] "
+                    "[-b slice bytes] [-t threads]\n", argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    if (!threads)
+        threads = av_cpu_count();
+    if (cols << CTB_LOG2 > width || rows << CTB_LOG2 > height) {
+        fprintf(stderr, "Too many tiles for the picture size\n");
+        return 1;
+    }
+
+    pkts = av_calloc(nb_frames, sizeof(*pkts));
+    if (!par || !pkts)
+        goto end;
+    par->codec_type = AVMEDIA_TYPE_VIDEO;
+    par->codec_id   = AV_CODEC_ID_HEVC;
+    par->width      = width;
+    par->height     = height;
+
+    if (make_stream(pkts, nb_frames, width, height, cols, rows, slice_bytes,
+                    par) < 0) {
+        fprintf(stderr, "Failed to create the input stream\n");
+        goto end;
+    }
+
+    printf("%dx%d, %dx%d tiles, %d bytes per tile, %d frames\n",
+           width, height, cols, rows, slice_bytes, nb_frames);
+    printf("%-8s %10s %12s %10s\n", "threads", "seconds", "tiles/s", "MB/s");
+
+    for (int t = 1; t <= threads; t = t < threads ? FFMIN(t * 2, threads) : t + 1) {
+        int nb_tiles;
+        double secs = bench(pkts, nb_frames, t, par, &nb_tiles);
+
+        if (secs < 0 || nb_tiles != nb_frames * cols * rows) {
+            fprintf(stderr, "hevc_frame_split failed\n");
+            goto end;
+        }
+        printf("%-8d %10.3f %12.0f %10.1f\n", t, secs, nb_tiles / secs,
+               (double)nb_tiles * slice_bytes / secs / 1e6);
+    }
+    ret = 0;
+
+end:
+    for (int f = 0; pkts && f < nb_frames; f++)
+        av_packet_free(&pkts[f]);
+    av_free(pkts);
+    avcodec_parameters_free(&par);
+    return ret;
+}
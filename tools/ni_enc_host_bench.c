@@ -0,0 +1,227 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the host side per frame work of the h264_ni_quadra encoder,
+ * avcodec_send_frame() and avcodec_receive_packet() through
+ * xcoder_send_frame() and xcoder_receive_packet(), on the emulated session
+ * of compat/ni_mock. Each frame carries custom SEI and HDR static metadata;
+ * the metadata is either the same on all frames, so that the session is
+ * only handed it once, or changes on every frame.
+ *
+ * Usage: ni_enc_host_bench [-n frames] [-s WxH] [-c sei_count] [-l sei_size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mastering_display_metadata.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "libavcodec/nienc.c"
+#include "libavcodec/nienc_h264.c"
+#include "libavcodec/ni_enc_pool.c"
+#include "libavcodec/ni_frame_ring.c"
+#include "libavcodec/ni_recycle_ring.c"
+#include "compat/ni_mock/ni_mock.c"
+
+static int add_side_data(AVFrame *frame, const ni_custom_sei_set_t *sei,
+                         int n, int hdr_changes)
+{
+    AVFrameSideData *sd;
+    AVContentLightMetadata *cll;
+    AVMasteringDisplayMetadata *mdcv;
+
+    if (sei->count) {
+        sd = av_frame_new_side_data(frame, AV_FRAME_DATA_NETINT_CUSTOM_SEI,
+                                    sizeof(*sei));
+        if (!sd)
+            return AVERROR(ENOMEM);
+        memcpy(sd->data, sei, sizeof(*sei));
+    }
+
+    cll  = av_content_light_metadata_create_side_data(frame);
+    mdcv = av_mastering_display_metadata_create_side_data(frame);
+    if (!cll || !mdcv)
+        return AVERROR(ENOMEM);
+    cll->MaxCLL  = 1000;
+    cll->MaxFALL = hdr_changes ? 100 + n % 300 : 400;
+    for (int i = 0; i < 3; i++) {
+        mdcv->display_primaries[i][0] = av_make_q(13250 + 1000 * i, 50000);
+        mdcv->display_primaries[i][1] = av_make_q(34500 - 1000 * i, 50000);
+    }
+    mdcv->white_point[0] = av_make_q(15635, 50000);
+    mdcv->white_point[1] = av_make_q(16450, 50000);
+    mdcv->min_luminance  = av_make_q(50, 10000);
+    mdcv->max_luminance  = av_make_q(1000, 1);
+    mdcv->has_primaries  = mdcv->has_luminance = 1;
+    return 0;
+}
+
+static int run(int width, int height, int nb_frames,
+               const ni_custom_sei_set_t *sei, int hdr_changes, double *us)
+{
+    AVCodecContext *avctx = avcodec_alloc_context3(&ff_h264_ni_quadra_encoder.p);
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *pkt = av_packet_alloc();
+    int64_t t = 0, t0;
+    int ret;
+
+    if (!avctx || !frame || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    avctx->width     = width;
+    avctx->height    = height;
+    avctx->pix_fmt   = AV_PIX_FMT_YUV420P;
+    avctx->time_base = (AVRational){ 1, 25 };
+    avctx->framerate = (AVRational){ 25, 1 };
+    av_opt_set(avctx->priv_data, "xcoder-params", "intraPeriod=60", 0);
+    ret = avcodec_open2(avctx, NULL, NULL);
+    if (ret < 0)
+        goto end;
+
+    for (int n = 0; n <= nb_frames; n++) {
+        AVFrame *in = NULL;
+
+        if (n < nb_frames) {
+            frame->format = avctx->pix_fmt;
+            frame->width  = width;
+            frame->height = height;
+            ret = av_frame_get_buffer(frame, 0);
+            if (ret < 0)
+                goto end;
+            for (int p = 0; p < 3; p++)
+                memset(frame->data[p], n + 64 * p,
+                       frame->linesize[p] * AV_CEIL_RSHIFT(height, !!p));
+            frame->pts = n;
+            ret = add_side_data(frame, sei, n, hdr_changes);
+            if (ret < 0)
+                goto end;
+            in = frame;
+        }
+
+        t0 = av_gettime_relative();
+        while ((ret = avcodec_send_frame(avctx, in)) == AVERROR(EAGAIN)) {
+            while ((ret = avcodec_receive_packet(avctx, pkt)) >= 0)
+                av_packet_unref(pkt);
+            if (ret != AVERROR(EAGAIN))
+                break;
+        }
+        if (ret < 0)
+            goto end;
+        while ((ret = avcodec_receive_packet(avctx, pkt)) >= 0)
+            av_packet_unref(pkt);
+        t += av_gettime_relative() - t0;
+        av_frame_unref(frame);
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto end;
+    }
+
+    t0 = av_gettime_relative();
+    while ((ret = avcodec_receive_packet(avctx, pkt)) >= 0 || ret == AVERROR(EAGAIN))
+        av_packet_unref(pkt);
+    t += av_gettime_relative() - t0;
+    ret = ret == AVERROR_EOF ? 0 : ret;
+    *us = (double)t / nb_frames;
+
+end:
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    avcodec_free_context(&avctx);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    ni_custom_sei_set_t *sei;
+    int nb_frames = 2000, width = 1280, height = 720, sei_count = 2, sei_size = 256;
+    double us_static, us_changing;
+    AVLFG lfg;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "hn:s:c:l:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nb_frames = FFMAX(atoi(optarg), 1);
+            break;
+        case 's':
+            if (av_parse_video_size(&width, &height, optarg) < 0) {
+                fprintf(stderr, "Invalid size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'c':
+            sei_count = FFMAX(atoi(optarg), 0);
+            break;
+        case 'l':
+            sei_size = av_clip(atoi(optarg), 0, NI_MAX_CUSTOM_SEI_DATA / 2);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n frames] [-s WxH] [-c sei_count] "
+                    "[-l sei_size]\n", argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    ni_mock_checksum = 0;
+    av_lfg_init(&lfg, 0x5e1);
+    sei = av_mallocz(sizeof(*sei));
+    if (!sei)
+        return 1;
+    sei_count  = FFMIN(sei_count, FF_ARRAY_ELEMS(sei->custom_sei));
+    sei->count = sei_count;
+    for (int i = 0; i < sei_count; i++) {
+        sei->custom_sei[i].type = 5;
+        sei->custom_sei[i].size = sei_size;
+        for (int j = 0; j < sei_size; j++)
+            sei->custom_sei[i].data[j] = av_lfg_get(&lfg) & 0x7;
+    }
+
+    // the first run warms the caches and the allocator up
+    ret = run(width, height, nb_frames, sei, 0, &us_static);
+    if (ret >= 0)
+        ret = run(width, height, nb_frames, sei, 0, &us_static);
+    if (ret >= 0)
+        ret = run(width, height, nb_frames, sei, 1, &us_changing);
+    av_free(sei);
+    if (ret < 0) {
+        fprintf(stderr, "Encoding failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    printf("%d frames %dx%d, %d SEIs of %d bytes\n",
+           nb_frames, width, height, sei_count, sei_size);
+    printf("HDR metadata static   %8.2f us/frame\n", us_static);
+    printf("HDR metadata changing %8.2f us/frame\n", us_changing);
+    return 0;
+}
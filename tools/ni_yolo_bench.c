@@ -0,0 +1,291 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare the per cell YOLO decoding and pairwise NMS ni_quadra_roi used
+ * with the culling decoder and grid NMS, on layer outputs recorded with
+ * the filter's dump option or on synthetic ones.
+ *
+ * Usage: ni_yolo_bench [-f dump] [-l WxHxC]... [-s netWxnetH] [-n runs]
+ *                      [-o obj_thresh] [-m nms_thresh]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "libavfilter/ni_yolo.c"
+
+#define MAX_LAYERS 2
+
+static const int   masks[MAX_LAYERS][3] = {{3, 4, 5}, {0, 1, 2}};
+static const float biases[] = {10, 16, 25, 37, 49, 71, 85, 118, 143, 190, 274, 283};
+
+static int legacy_detect(NIYoloDetection **pdets, unsigned int *size,
+                         const NIYoloLayer *layers, int nb_layers,
+                         int netw, int neth, float thresh, float nms_thresh)
+{
+    NIYoloDetection *dets = *pdets;
+    int nb = 0, kept = 0;
+
+    for (int l = 0; l < nb_layers; l++) {
+        const NIYoloLayer *ly = &layers[l];
+        const int plane   = ly->width * ly->height;
+        const int entries = 4 + 1 + ly->classes;
+
+        for (int i = 0; i < plane; i++) {
+            for (int n = 0; n < ly->component; n++) {
+                const float *x = ly->output + n * plane * entries;
+                float objectness = sigmoid(x[4 * plane + i]);
+                float max_prob = thresh;
+                int prob_class = -1;
+
+                for (int k = 0; k < ly->classes; k++) {
+                    double prob = objectness * sigmoid(x[(5 + k) * plane + i]);
+                    if (prob >= max_prob) {
+                        prob_class = k;
+                        max_prob   = (float)prob;
+                    }
+                }
+                if (prob_class < 0)
+                    continue;
+
+                dets = av_fast_realloc(*pdets, size, (nb + 1) * sizeof(*dets));
+                if (!dets)
+                    return AVERROR(ENOMEM);
+                *pdets = dets;
+                dets[nb].x = (float)((float)(i % ly->width) + sigmoid(x[i])) / (float)ly->width;
+                dets[nb].y = (float)((float)(i / ly->width) + sigmoid(x[plane + i])) / (float)ly->height;
+                dets[nb].w = (float)exp((double)x[2 * plane + i]) * ly->biases[2 * ly->mask[n]] / (float)netw;
+                dets[nb].h = (float)exp((double)x[3 * plane + i]) * ly->biases[2 * ly->mask[n] + 1] / (float)neth;
+                dets[nb].x -= (float)(dets[nb].w / 2.0);
+                dets[nb].y -= (float)(dets[nb].h / 2.0);
+                dets[nb].prob  = max_prob;
+                dets[nb].cls   = prob_class;
+                dets[nb].index = nb;
+                nb++;
+            }
+        }
+    }
+
+    if (nb)
+        qsort(dets, nb, sizeof(*dets), detection_cmp);
+
+    for (int i = 0; i < nb; i++) {
+        if (dets[i].prob == 0)
+            continue;
+        kept++;
+        for (int j = i + 1; j < nb && dets[j].cls == dets[i].cls; j++) {
+            if (dets[j].prob == 0)
+                continue;
+            if (box_iou(&dets[i], &dets[j]) > nms_thresh)
+                dets[j].prob = 0;
+        }
+    }
+
+    return kept;
+}
+
+static void fill_synthetic(AVLFG *lfg, float *out, const NIYoloLayer *l)
+{
+    const int plane = l->width * l->height;
+
+    for (int n = 0; n < l->component; n++) {
+        float *x = out + n * plane * (5 + l->classes);
+
+        for (int e = 0; e < 5 + l->classes; e++) {
+            for (int i = 0; i < plane; i++) {
+                float v = av_lfg_get(lfg) / 4294967296.0;
+                /* a few percent of confident cells, like a real scene */
+                if (e == 4)
+                    v = av_lfg_get(lfg) % 32 ? -12 + 10 * v : -1 + 7 * v;
+                else
+                    v = -3 + 6 * v;
+                x[e * plane + i] = v;
+            }
+        }
+    }
+}
+
+static int parse_layer(NIYoloLayer *l, const char *arg)
+{
+    int channels;
+
+    if (sscanf(arg, "%dx%dx%d", &l->width, &l->height, &channels) != 3 ||
+        l->width <= 0 || l->height <= 0 || channels % 3 || channels / 3 <= 5)
+        return AVERROR(EINVAL);
+
+    l->component = 3;
+    l->classes   = channels / 3 - 5;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    NIYoloLayer layers[MAX_LAYERS];
+    NIYoloContext yc = { 0 };
+    NIYoloDetection *legacy_dets = NULL;
+    unsigned int legacy_size = 0;
+    float *frames = NULL;
+    const char *dump = NULL;
+    int nb_layers = 0, nb_frames, frame_floats = 0;
+    int netw = 416, neth = 416, runs = 100;
+    float obj_thresh = 0.25, nms_thresh = 0.45;
+    int64_t t_legacy = 0, t_new = 0;
+    int64_t nb_legacy = 0, nb_new = 0;
+    int opt, ret = 1;
+
+    while ((opt = getopt(argc, argv, "hf:l:s:n:o:m:")) != -1) {
+        switch (opt) {
+        case 'f':
+            dump = optarg;
+            break;
+        case 'l':
+            if (nb_layers == MAX_LAYERS || parse_layer(&layers[nb_layers], optarg) < 0) {
+                fprintf(stderr, "Invalid layer '%s'\n", optarg);
+                return 1;
+            }
+            nb_layers++;
+            break;
+        case 's':
+            if (av_parse_video_size(&netw, &neth, optarg) < 0) {
+                fprintf(stderr, "Invalid size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            runs = FFMAX(atoi(optarg), 1);
+            break;
+        case 'o':
+            obj_thresh = atof(optarg);
+            break;
+        case 'm':
+            nms_thresh = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-f dump] [-l WxHxC]... [-s netWxnetH] "
+                    "[-n runs] [-o obj_thresh] [-m nms_thresh]\n", argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    /* the face detection network ni_quadra_roi ships with */
+    if (!nb_layers) {
+        parse_layer(&layers[0], "13x13x18");
+        parse_layer(&layers[1], "26x26x18");
+        nb_layers = 2;
+    }
+
+    for (int i = 0; i < nb_layers; i++) {
+        layers[i].biases = biases;
+        memcpy(layers[i].mask, masks[i], sizeof(layers[i].mask));
+        frame_floats += layers[i].width * layers[i].height * 3 * (5 + layers[i].classes);
+    }
+
+    if (dump) {
+        FILE *f = fopen(dump, "rb");
+        long bytes;
+
+        if (!f) {
+            fprintf(stderr, "Cannot open %s\n", dump);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        bytes = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        nb_frames = bytes / (frame_floats * sizeof(float));
+        if (nb_frames <= 0 || !(frames = av_malloc_array(nb_frames, frame_floats * sizeof(float))) ||
+            fread(frames, frame_floats * sizeof(float), nb_frames, f) != nb_frames) {
+            fprintf(stderr, "Cannot read %s, does the layer geometry match?\n", dump);
+            fclose(f);
+            goto end;
+        }
+        fclose(f);
+    } else {
+        AVLFG lfg;
+
+        av_lfg_init(&lfg, 0x59a1);
+        nb_frames = 16;
+        frames = av_malloc_array(nb_frames, frame_floats * sizeof(float));
+        if (!frames)
+            goto end;
+        for (int f = 0; f < nb_frames; f++) {
+            float *out = frames + f * frame_floats;
+            for (int i = 0; i < nb_layers; i++) {
+                fill_synthetic(&lfg, out, &layers[i]);
+                out += layers[i].width * layers[i].height * 3 * (5 + layers[i].classes);
+            }
+        }
+    }
+
+    for (int r = 0; r < runs; r++) {
+        for (int f = 0; f < nb_frames; f++) {
+            float *out = frames + f * frame_floats;
+            int64_t t0;
+            int nb;
+
+            for (int i = 0; i < nb_layers; i++) {
+                layers[i].output = out;
+                out += layers[i].width * layers[i].height * 3 * (5 + layers[i].classes);
+            }
+
+            t0 = av_gettime_relative();
+            nb = legacy_detect(&legacy_dets, &legacy_size, layers, nb_layers,
+                               netw, neth, obj_thresh, nms_thresh);
+            t_legacy += av_gettime_relative() - t0;
+            if (nb < 0)
+                goto end;
+            nb_legacy += nb;
+
+            t0 = av_gettime_relative();
+            nb = ff_ni_yolo_detect(&yc, layers, nb_layers, netw, neth,
+                                   obj_thresh, nms_thresh);
+            t_new += av_gettime_relative() - t0;
+            if (nb < 0)
+                goto end;
+            nb_new += nb;
+        }
+    }
+
+    printf("%d frames x %d runs, %.1f detections/frame\n", nb_frames, runs,
+           (double)nb_new / (nb_frames * runs));
+    printf("legacy %8.2f us/frame\n", (double)t_legacy / (nb_frames * runs));
+    printf("new    %8.2f us/frame\n", (double)t_new / (nb_frames * runs));
+    if (nb_legacy != nb_new)
+        printf("detection count mismatch: %"PRId64" vs %"PRId64"\n", nb_legacy, nb_new);
+    else
+        ret = 0;
+
+end:
+    ff_ni_yolo_uninit(&yc);
+    av_free(legacy_dets);
+    av_free(frames);
+    return ret;
+}
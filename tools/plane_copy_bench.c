@@ -0,0 +1,184 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare the row-by-row memcpy loop that hwcontext_ni_quad used for
+ * hwupload/hwdownload with the plane copy engine.
+ *
+ * Usage: plane_copy_bench [-s WxH] [-n runs] [-t threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/planecopy.h"
+#include "libavutil/time.h"
+
+/* device strides as laid out by hwcontext_ni_quad */
+static const struct {
+    enum AVPixelFormat pix_fmt;
+    int num[4], den[4], align[4];
+} layouts[] = {
+    { AV_PIX_FMT_YUV420P, { 1, 1, 1 }, { 1, 2, 2 }, { 128, 128, 128 } },
+    { AV_PIX_FMT_NV12,    { 1, 1 },    { 1, 1 },    { 128, 128 } },
+    { AV_PIX_FMT_P010LE,  { 2, 2 },    { 1, 1 },    { 128, 128 } },
+    { AV_PIX_FMT_RGBA,    { 4 },       { 1 },       { 64 } },
+};
+
+static void copy_rows_legacy(const PlaneCopyDesc *planes, int nb_planes)
+{
+    for (int i = 0; i < nb_planes; i++) {
+        const PlaneCopyDesc *p = &planes[i];
+        uint8_t *dst = p->dst;
+        const uint8_t *src = p->src;
+
+        for (int h = 0; h < p->height; h++) {
+            memcpy(dst, src, p->bytewidth);
+            dst += p->dst_linesize;
+            src += p->src_linesize;
+        }
+    }
+}
+
+static double bench(PlaneCopyContext *ctx, int legacy,
+                    const PlaneCopyDesc *planes, int nb_planes, int runs)
+{
+    int64_t t0 = av_gettime_relative();
+
+    for (int r = 0; r < runs; r++) {
+        if (legacy)
+            copy_rows_legacy(planes, nb_planes);
+        else
+            avpriv_plane_copy(ctx, planes, nb_planes);
+    }
+
+    return (av_gettime_relative() - t0) / 1000.0 / runs;
+}
+
+int main(int argc, char **argv)
+{
+    PlaneCopyContext *ctx = NULL;
+    int width = 3840, height = 2160, runs = 100, threads = 0;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "hs:n:t:")) != -1) {
+        switch (opt) {
+        case 's':
+            if (av_parse_video_size(&width, &height, optarg) < 0) {
+                fprintf(stderr, "Invalid size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            runs = FFMAX(atoi(optarg), 1);
+            break;
+        case 't':
+            threads = FFMAX(atoi(optarg), 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s WxH] [-n runs] [-t threads]\n",
+                    argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    ret = avpriv_plane_copy_alloc(&ctx, threads);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to allocate copy context\n");
+        return 1;
+    }
+
+    printf("%-10s %-8s %10s %10s %10s %10s\n", "format", "dir",
+           "legacy ms", "engine ms", "threaded", "GB/s");
+
+    for (int l = 0; l < FF_ARRAY_ELEMS(layouts); l++) {
+        enum AVPixelFormat pix_fmt = layouts[l].pix_fmt;
+        int nb_planes = av_pix_fmt_count_planes(pix_fmt);
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+        uint8_t *dev[4] = { NULL };
+        PlaneCopyDesc up[4], down[4];
+        AVFrame *frame = av_frame_alloc();
+        size_t total = 0;
+
+        if (!frame)
+            goto fail;
+        frame->format = pix_fmt;
+        frame->width  = width;
+        frame->height = height;
+        if (av_frame_get_buffer(frame, 0) < 0)
+            goto fail;
+
+        for (int i = 0; i < nb_planes; i++) {
+            int stride = FFALIGN(width * layouts[l].num[i] / layouts[l].den[i],
+                                 layouts[l].align[i]);
+            int h = (i == 1 || i == 2) ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h)
+                                       : height;
+
+            dev[i] = av_malloc((size_t)stride * h);
+            if (!dev[i])
+                goto fail;
+            memset(dev[i], 0x80, (size_t)stride * h);
+            memset(frame->data[i], 0x10, (size_t)frame->linesize[i] * h);
+
+            up[i] = (PlaneCopyDesc) {
+                .dst = dev[i],         .dst_linesize = stride,
+                .src = frame->data[i], .src_linesize = frame->linesize[i],
+                .bytewidth = FFMIN(stride, frame->linesize[i]), .height = h,
+            };
+            down[i] = (PlaneCopyDesc) {
+                .dst = frame->data[i], .dst_linesize = frame->linesize[i],
+                .src = dev[i],         .src_linesize = stride,
+                .bytewidth = up[i].bytewidth, .height = h,
+            };
+            total += (size_t)up[i].bytewidth * h;
+        }
+
+        for (int dir = 0; dir < 2; dir++) {
+            const PlaneCopyDesc *planes = dir ? down : up;
+            double legacy   = bench(NULL, 1, planes, nb_planes, runs);
+            double single   = bench(NULL, 0, planes, nb_planes, runs);
+            double threaded = bench(ctx,  0, planes, nb_planes, runs);
+
+            printf("%-10s %-8s %10.3f %10.3f %10.3f %10.2f\n",
+                   desc->name, dir ? "download" : "upload",
+                   legacy, single, threaded,
+                   total / (FFMIN(single, threaded) * 1e6));
+        }
+
+fail:
+        for (int i = 0; i < 4; i++)
+            av_free(dev[i]);
+        av_frame_free(&frame);
+    }
+
+    avpriv_plane_copy_free(&ctx);
+    return 0;
+}
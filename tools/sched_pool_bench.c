@@ -0,0 +1,250 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare the ffmpeg scheduler running a thread per task with the job pool
+ * (-sched_pool) on a software ABR ladder: one synthetic video input split
+ * and scaled to many outputs, each with its own audio encoder and muxer.
+ * Every mode runs the ffmpeg binary in a child process, the frame rate comes
+ * from the wall time and the context switches from the child rusage.
+ *
+ * Usage: sched_pool_bench [-f ffmpeg] [-o outputs] [-d seconds] [-s WxH]
+ *                         [-p pool_threads] [-r runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/common.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+
+#define RATE        25
+#define MAX_ARGS    256
+
+typedef struct Result {
+    double   wall;
+    double   cpu;
+    uint64_t voluntary;
+    uint64_t involuntary;
+} Result;
+
+static int build_args(const char **args, AVBPrint *graph, const char *ffmpeg,
+                      int pool, int outputs, int seconds, int w, int h)
+{
+    static char pool_str[16], video[128], audio[64];
+    int n = 0;
+
+    snprintf(pool_str, sizeof(pool_str), "%d", pool);
+    snprintf(video, sizeof(video), "testsrc2=size=%dx%d:rate=%d:duration=%d",
+             w, h, RATE, seconds);
+    snprintf(audio, sizeof(audio), "sine=duration=%d", seconds);
+
+    av_bprintf(graph, "[0:v]split=%d", outputs);
+    for (int i = 0; i < outputs; i++)
+        av_bprintf(graph, "[s%d]", i);
+    for (int i = 0; i < outputs; i++)
+        av_bprintf(graph, ";[s%d]scale=%d:-2[v%d]", i,
+                   FFMAX(w * (outputs - i) / outputs & ~1, 16), i);
+    if (!av_bprint_is_complete(graph))
+        return -1;
+
+    args[n++] = ffmpeg;
+    args[n++] = "-hide_banner";
+    args[n++] = "-nostdin";
+    args[n++] = "-nostats";
+    args[n++] = "-loglevel";
+    args[n++] = "error";
+    args[n++] = "-sched_pool";
+    args[n++] = pool_str;
+    args[n++] = "-f";
+    args[n++] = "lavfi";
+    args[n++] = "-i";
+    args[n++] = video;
+    args[n++] = "-f";
+    args[n++] = "lavfi";
+    args[n++] = "-i";
+    args[n++] = audio;
+    args[n++] = "-filter_complex";
+    args[n++] = graph->str;
+
+    for (int i = 0; i < outputs; i++) {
+        static char labels[MAX_ARGS][16];
+
+        if (n + 14 >= MAX_ARGS)
+            return -1;
+        snprintf(labels[i], sizeof(labels[i]), "[v%d]", i);
+        args[n++] = "-map";
+        args[n++] = labels[i];
+        args[n++] = "-map";
+        args[n++] = "1:a";
+        args[n++] = "-c:v";
+        args[n++] = "rawvideo";
+        args[n++] = "-c:a";
+        args[n++] = "pcm_s16le";
+        args[n++] = "-af";
+        args[n++] = "aresample=48000";
+        args[n++] = "-f";
+        args[n++] = "null";
+        args[n++] = "-";
+    }
+    args[n] = NULL;
+
+    return 0;
+}
+
+static double cpu_time(const struct rusage *ru)
+{
+    return ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6 +
+           ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+}
+
+static int run(Result *res, const char *ffmpeg, int pool, int outputs,
+               int seconds, int w, int h)
+{
+    const char *args[MAX_ARGS];
+    AVBPrint graph;
+    struct rusage ru0, ru;
+    int64_t t0;
+    pid_t pid;
+    int status;
+
+    av_bprint_init(&graph, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (build_args(args, &graph, ffmpeg, pool, outputs, seconds, w, h) < 0) {
+        fprintf(stderr, "Too many outputs\n");
+        av_bprint_finalize(&graph, NULL);
+        return -1;
+    }
+
+    // the usage of all the waited for children, only one runs at a time
+    getrusage(RUSAGE_CHILDREN, &ru0);
+
+    t0  = av_gettime_relative();
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        av_bprint_finalize(&graph, NULL);
+        return -1;
+    }
+    if (!pid) {
+        execvp(ffmpeg, (char * const *)args);
+        perror(ffmpeg);
+        _exit(127);
+    }
+
+    av_bprint_finalize(&graph, NULL);
+
+    if (waitpid(pid, &status, 0) != pid) {
+        perror("waitpid");
+        return -1;
+    }
+    getrusage(RUSAGE_CHILDREN, &ru);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+        fprintf(stderr, "%s failed with status %d\n", ffmpeg, status);
+        return -1;
+    }
+
+    res->wall        = (av_gettime_relative() - t0) / 1e6;
+    res->cpu         = cpu_time(&ru) - cpu_time(&ru0);
+    res->voluntary   = ru.ru_nvcsw  - ru0.ru_nvcsw;
+    res->involuntary = ru.ru_nivcsw - ru0.ru_nivcsw;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *ffmpeg = "./ffmpeg";
+    int outputs = 12, seconds = 10, runs = 3, pool = -1;
+    int width = 1280, height = 720;
+    int frames, opt;
+
+    while ((opt = getopt(argc, argv, "hf:o:d:s:p:r:")) != -1) {
+        switch (opt) {
+        case 'f':
+            ffmpeg = optarg;
+            break;
+        case 'o':
+            outputs = av_clip(atoi(optarg), 1, 16);
+            break;
+        case 'd':
+            seconds = FFMAX(atoi(optarg), 1);
+            break;
+        case 's':
+            if (av_parse_video_size(&width, &height, optarg) < 0) {
+                fprintf(stderr, "Invalid size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            pool = atoi(optarg);
+            break;
+        case 'r':
+            runs = FFMAX(atoi(optarg), 1);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-f ffmpeg] [-o outputs] [-d seconds] "
+                    "[-s WxH] [-p pool_threads] [-r runs]\n", argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    frames = seconds * RATE;
+    printf("%d outputs, %d frames of %dx%d, best of %d runs\n",
+           outputs, frames, width, height, runs);
+    printf("%-14s %8s %8s %8s %12s %12s\n", "scheduler", "wall s", "fps",
+           "cpu s", "voluntary", "involuntary");
+
+    for (int mode = 0; mode < 2; mode++) {
+        Result best = { 0 };
+        char name[32];
+
+        if (mode)
+            snprintf(name, sizeof(name), pool < 0 ? "pool (cpus)" : "pool %d", pool);
+        else
+            av_strlcpy(name, "thread/task", sizeof(name));
+
+        for (int i = 0; i < runs; i++) {
+            Result res;
+
+            if (run(&res, ffmpeg, mode ? pool : 0, outputs, seconds,
+                    width, height) < 0)
+                return 1;
+            if (!i || res.wall < best.wall)
+                best = res;
+        }
+
+        printf("%-14s %8.2f %8.1f %8.2f %12"PRIu64" %12"PRIu64"\n", name,
+               best.wall, frames / best.wall, best.cpu,
+               best.voluntary, best.involuntary);
+    }
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the ffmpeg sync queue with many synthetic packet streams, as
+ * interleaved by a demuxer: video streams of 40 ms packets in a 1/90000
+ * timebase and audio streams of 960 samples at 48 kHz, with every other video
+ * stream not limiting. All the streams end together, so that nothing is cut
+ * at the end of the shortest limiting stream. The queue is drained after each
+ * packet sent; the packets are checked to come out complete and in order for
+ * each stream.
+ *
+ * Usage: sync_queue_bench [-s max_streams] [-d seconds] [-r runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "fftools/objpool.c"
+#include "fftools/sync_queue.c"
+#include "fftools/ts_heap.c"
+
+#define MAX_STREAMS 1024
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+}
+
+static AVRational stream_tb(int idx)
+{
+    return (idx & 1) ? (AVRational){ 1, 48000 } : (AVRational){ 1, 90000 };
+}
+
+static int64_t stream_duration(int idx)
+{
+    return (idx & 1) ? 960 : 3600;
+}
+
+static int drain(SyncQueue *sq, AVPacket *pkt, int64_t *next, int64_t *nb)
+{
+    int ret;
+
+    while ((ret = sq_receive(sq, -1, SQPKT(pkt))) >= 0) {
+        if (pkt->pts != next[ret]) {
+            fprintf(stderr, "Packet %"PRId64" of stream %d out of order\n",
+                    pkt->pts, ret);
+            return AVERROR_BUG;
+        }
+        next[ret] += stream_duration(ret);
+        (*nb)++;
+        av_packet_unref(pkt);
+    }
+
+    return ret;
+}
+
+static int run(int nb_streams, int seconds, double *pkts_per_s)
+{
+    int64_t   pts[MAX_STREAMS] = { 0 }, next[MAX_STREAMS] = { 0 };
+    int64_t   nb_sent = 0, nb_received = 0, t0;
+    SyncQueue *sq;
+    AVPacket  *pkt;
+    int ret = 0;
+
+    sq  = sq_alloc(SYNC_QUEUE_PACKETS, 10 * AV_TIME_BASE, NULL);
+    pkt = av_packet_alloc();
+    if (!sq || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (int i = 0; i < nb_streams; i++) {
+        ret = sq_add_stream(sq, (i & 3) != 2);
+        if (ret < 0)
+            goto finish;
+    }
+
+    t0 = now_ns();
+
+    // send the packets starting within each 40 ms slice, stream by stream
+    for (int64_t slice = 1; slice <= seconds * 25; slice++) {
+        for (int i = 0; i < nb_streams; i++) {
+            AVRational tb = stream_tb(i);
+
+            while (av_compare_ts(pts[i], tb, slice, (AVRational){ 1, 25 }) < 0) {
+                ret = av_new_packet(pkt, 16);
+                if (ret < 0)
+                    goto finish;
+                pkt->pts       = pts[i];
+                pkt->dts       = pts[i];
+                pkt->duration  = stream_duration(i);
+                pkt->time_base = tb;
+                pts[i]        += pkt->duration;
+
+                ret = sq_send(sq, i, SQPKT(pkt));
+                if (ret < 0)
+                    goto finish;
+                nb_sent++;
+
+                ret = drain(sq, pkt, next, &nb_received);
+                if (ret != AVERROR(EAGAIN))
+                    goto finish;
+            }
+        }
+    }
+
+    for (int i = 0; i < nb_streams; i++) {
+        sq_send(sq, i, SQPKT(NULL));
+
+        ret = drain(sq, pkt, next, &nb_received);
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto finish;
+    }
+
+    *pkts_per_s = nb_received / ((now_ns() - t0) / 1e9);
+
+    if (ret != AVERROR_EOF || nb_received != nb_sent) {
+        fprintf(stderr, "%"PRId64" packets sent, %"PRId64" received\n",
+                nb_sent, nb_received);
+        ret = AVERROR_BUG;
+        goto finish;
+    }
+    ret = 0;
+
+finish:
+    av_packet_free(&pkt);
+    sq_free(&sq);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int max_streams = 256, seconds = 20, runs = 3, opt;
+
+    while ((opt = getopt(argc, argv, "hs:d:r:")) != -1) {
+        switch (opt) {
+        case 's':
+            max_streams = av_clip(atoi(optarg), 1, MAX_STREAMS);
+            break;
+        case 'd':
+            seconds = FFMAX(atoi(optarg), 1);
+            break;
+        case 'r':
+            runs = FFMAX(atoi(optarg), 1);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s max_streams] [-d seconds] [-r runs]\n",
+                    argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    printf("%d s of packets per stream, best of %d runs\n", seconds, runs);
+    printf("%8s %12s %10s\n", "streams", "packets/s", "ns/packet");
+
+    for (int nb_streams = FFMIN(4, max_streams); ;
+         nb_streams = FFMIN(nb_streams * 4, max_streams)) {
+        double best = 0;
+
+        for (int i = 0; i < runs; i++) {
+            double pkts_per_s;
+            int ret = run(nb_streams, seconds, &pkts_per_s);
+
+            if (ret < 0) {
+                fprintf(stderr, "Error with %d streams: %s\n", nb_streams,
+                        av_err2str(ret));
+                return 1;
+            }
+            best = FFMAX(best, pkts_per_s);
+        }
+
+        printf("%8d %12.0f %10.0f\n", nb_streams, best, 1e9 / best);
+
+        if (nb_streams == max_streams)
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,379 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Stress the ffmpeg thread queue with small packets sent by several producer
+ * threads to one consumer, and compare it with a queue taking a mutex and
+ * broadcasting for every packet like the queue it replaced. Each packet
+ * carries its send time, the consumer records the handoff latency; the
+ * streams are checked to arrive complete and in order.
+ *
+ * Usage: thread_queue_bench [-p producers] [-n packets] [-q queue_size]
+ *                           [-b batch] [-r runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavutil/fifo.h"
+#include "libavutil/qsort.h"
+
+#include "fftools/job_pool.c"
+#include "fftools/objpool.c"
+#include "fftools/thread_queue.c"
+
+#define MAX_PRODUCERS 64
+#define MAX_BATCH     64
+
+/* the previous queue: one lock and one condition for everything */
+typedef struct MutexQueue {
+    AVFifo         *fifo;
+    ObjPool        *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} MutexQueue;
+
+typedef struct Bench {
+    int          mode;
+    int          nb_producers;
+    int          nb_packets;
+    int          batch;
+    size_t       queue_size;
+
+    ThreadQueue *tq;
+    MutexQueue   mq;
+} Bench;
+
+typedef struct Producer {
+    Bench     *b;
+    int        idx;
+    pthread_t  thread;
+} Producer;
+
+enum {
+    MODE_MUTEX,
+    MODE_RING,
+    MODE_RING_BATCH,
+    NB_MODES,
+};
+
+static const char *const mode_names[NB_MODES] = {
+    "mutex", "ring", "ring batch",
+};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+}
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+static int mq_send(MutexQueue *mq, AVPacket *pkt)
+{
+    void *obj;
+    int ret;
+
+    pthread_mutex_lock(&mq->lock);
+    while (!av_fifo_can_write(mq->fifo))
+        pthread_cond_wait(&mq->cond, &mq->lock);
+    ret = objpool_get(mq->pool, &obj);
+    if (ret >= 0) {
+        av_packet_move_ref(obj, pkt);
+        av_fifo_write(mq->fifo, &obj, 1);
+        pthread_cond_broadcast(&mq->cond);
+    }
+    pthread_mutex_unlock(&mq->lock);
+
+    return ret;
+}
+
+static void mq_receive(MutexQueue *mq, AVPacket *pkt)
+{
+    void *obj;
+
+    pthread_mutex_lock(&mq->lock);
+    while (av_fifo_read(mq->fifo, &obj, 1) < 0)
+        pthread_cond_wait(&mq->cond, &mq->lock);
+    pthread_cond_broadcast(&mq->cond);
+    av_packet_move_ref(pkt, obj);
+    objpool_release(mq->pool, &obj);
+    pthread_mutex_unlock(&mq->lock);
+}
+
+static void *producer(void *arg)
+{
+    Producer *p = arg;
+    Bench    *b = p->b;
+    AVPacket *pkts[MAX_BATCH];
+    int batch = b->mode == MODE_RING_BATCH ? b->batch : 1;
+    intptr_t ret = 0;
+
+    for (int i = 0; i < batch; i++) {
+        pkts[i] = av_packet_alloc();
+        if (!pkts[i] || av_new_packet(pkts[i], 16) < 0)
+            return (void*)(intptr_t)AVERROR(ENOMEM);
+    }
+
+    for (int i = 0; i < b->nb_packets && ret >= 0; i += batch) {
+        int n = FFMIN(batch, b->nb_packets - i);
+
+        for (int j = 0; j < n; j++) {
+            // the packet data is released by the consumer
+            if (!pkts[j]->buf && av_new_packet(pkts[j], 16) < 0)
+                return (void*)(intptr_t)AVERROR(ENOMEM);
+            pkts[j]->stream_index = p->idx;
+            pkts[j]->pos          = i + j;
+            pkts[j]->pts          = now_ns();
+        }
+
+        if (b->mode == MODE_MUTEX)
+            ret = mq_send(&b->mq, pkts[0]);
+        else if (b->mode == MODE_RING)
+            ret = tq_send(b->tq, p->idx, pkts[0]);
+        else
+            ret = tq_send_batch(b->tq, p->idx, (void**)pkts, n);
+    }
+
+    if (b->mode != MODE_MUTEX)
+        tq_send_finish(b->tq, p->idx);
+
+    for (int i = 0; i < batch; i++)
+        av_packet_free(&pkts[i]);
+
+    return (void*)ret;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    return FFDIFFSIGN(*(const int64_t*)a, *(const int64_t*)b);
+}
+
+static int run(Bench *b, int64_t *lat, double *handoffs)
+{
+    Producer  prod[MAX_PRODUCERS];
+    AVPacket *pkts[MAX_BATCH] = { NULL };
+    int       stream_idx[MAX_BATCH];
+    int64_t   next[MAX_PRODUCERS] = { 0 };
+    int64_t   total = (int64_t)b->nb_producers * b->nb_packets, nb = 0;
+    int       nb_eof = 0;
+    int       batch = b->mode == MODE_RING_BATCH ? b->batch : 1;
+    int64_t   t0;
+    int       ret = 0;
+
+    if (b->mode == MODE_MUTEX) {
+        b->mq.fifo = av_fifo_alloc2(b->queue_size, sizeof(void*), 0);
+        b->mq.pool = objpool_alloc_packets();
+        if (!b->mq.fifo || !b->mq.pool)
+            return AVERROR(ENOMEM);
+        pthread_mutex_init(&b->mq.lock, NULL);
+        pthread_cond_init(&b->mq.cond, NULL);
+    } else {
+        ObjPool *op = objpool_alloc_packets();
+        if (!op)
+            return AVERROR(ENOMEM);
+        b->tq = tq_alloc(b->nb_producers, b->queue_size, op, pkt_move);
+        if (!b->tq) {
+            objpool_free(&op);
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    for (int i = 0; i < batch; i++) {
+        pkts[i] = av_packet_alloc();
+        if (!pkts[i])
+            return AVERROR(ENOMEM);
+    }
+
+    t0 = now_ns();
+    for (int i = 0; i < b->nb_producers; i++) {
+        prod[i].b   = b;
+        prod[i].idx = i;
+        if (pthread_create(&prod[i].thread, NULL, producer, &prod[i]))
+            return AVERROR(EAGAIN);
+    }
+
+    while (nb < total) {
+        int n = 1;
+
+        if (b->mode == MODE_MUTEX) {
+            mq_receive(&b->mq, pkts[0]);
+            stream_idx[0] = pkts[0]->stream_index;
+        } else {
+            if (b->mode == MODE_RING) {
+                n = tq_receive(b->tq, stream_idx, pkts[0]);
+                n = n < 0 ? n : 1;
+            } else
+                n = tq_receive_batch(b->tq, stream_idx, (void**)pkts, batch);
+            if (n == AVERROR_EOF && stream_idx[0] >= 0 &&
+                next[stream_idx[0]] == b->nb_packets) {
+                nb_eof++;
+                continue;
+            } else if (n < 0) {
+                fprintf(stderr, "Unexpected end of stream %d\n", stream_idx[0]);
+                for (int i = 0; i < b->nb_producers; i++)
+                    tq_receive_finish(b->tq, i);
+                ret = n;
+                break;
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            int64_t t = now_ns();
+            int     s = stream_idx[i];
+
+            if (s != pkts[i]->stream_index || pkts[i]->pos != next[s]++) {
+                fprintf(stderr, "Packet %"PRId64" of stream %d out of order\n",
+                        pkts[i]->pos, s);
+                ret = AVERROR_BUG;
+            }
+            lat[nb++] = t - pkts[i]->pts;
+            av_packet_unref(pkts[i]);
+        }
+    }
+
+    *handoffs = nb / ((now_ns() - t0) / 1e9);
+
+    for (int i = 0; i < b->nb_producers; i++) {
+        void *res;
+        pthread_join(prod[i].thread, &res);
+        if ((intptr_t)res < 0 && ret >= 0)
+            ret = (intptr_t)res;
+    }
+
+    if (b->mode == MODE_MUTEX) {
+        void *obj;
+        while (av_fifo_read(b->mq.fifo, &obj, 1) >= 0)
+            objpool_release(b->mq.pool, &obj);
+        av_fifo_freep2(&b->mq.fifo);
+        objpool_free(&b->mq.pool);
+        pthread_cond_destroy(&b->mq.cond);
+        pthread_mutex_destroy(&b->mq.lock);
+    } else {
+        // every stream must end with EOF once all its packets were received
+        while (ret >= 0 && nb_eof < b->nb_producers) {
+            if (tq_receive(b->tq, stream_idx, pkts[0]) != AVERROR_EOF ||
+                stream_idx[0] < 0) {
+                fprintf(stderr, "Missing end of stream\n");
+                ret = AVERROR_BUG;
+            }
+            nb_eof++;
+        }
+        if (ret >= 0 && (tq_receive(b->tq, stream_idx, pkts[0]) != AVERROR_EOF ||
+                         stream_idx[0] >= 0)) {
+            fprintf(stderr, "Missing end of all streams\n");
+            ret = AVERROR_BUG;
+        }
+        tq_free(&b->tq);
+    }
+
+    for (int i = 0; i < batch; i++)
+        av_packet_free(&pkts[i]);
+
+    AV_QSORT(lat, nb, int64_t, cmp_int64);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    Bench b = {
+        .nb_producers = 1,
+        .nb_packets   = 200000,
+        .batch        = 8,
+        .queue_size   = 8,
+    };
+    int runs = 3, opt;
+    int64_t *lat;
+
+    while ((opt = getopt(argc, argv, "hp:n:q:b:r:")) != -1) {
+        switch (opt) {
+        case 'p':
+            b.nb_producers = av_clip(atoi(optarg), 1, MAX_PRODUCERS);
+            break;
+        case 'n':
+            b.nb_packets = FFMAX(atoi(optarg), 1);
+            break;
+        case 'q':
+            b.queue_size = FFMAX(atoi(optarg), 1);
+            break;
+        case 'b':
+            b.batch = av_clip(atoi(optarg), 1, MAX_BATCH);
+            break;
+        case 'r':
+            runs = FFMAX(atoi(optarg), 1);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p producers] [-n packets] "
+                    "[-q queue_size] [-b batch] [-r runs]\n", argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    lat = av_malloc_array((size_t)b.nb_producers * b.nb_packets, sizeof(*lat));
+    if (!lat)
+        return 1;
+
+    printf("%d producers, %d packets each, queue size %zu, batch %d, "
+           "best of %d runs\n", b.nb_producers, b.nb_packets, b.queue_size,
+           b.batch, runs);
+    printf("%-12s %12s %10s %10s %10s %10s\n", "queue", "handoffs/s",
+           "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+
+    for (b.mode = 0; b.mode < NB_MODES; b.mode++) {
+        int64_t total = (int64_t)b.nb_producers * b.nb_packets;
+        int64_t p50 = 0, p99 = 0, p999 = 0, max = 0;
+        double best = 0;
+
+        for (int i = 0; i < runs; i++) {
+            double handoffs;
+
+            if (run(&b, lat, &handoffs) < 0) {
+                av_free(lat);
+                return 1;
+            }
+            if (handoffs > best) {
+                best = handoffs;
+                p50  = lat[total / 2];
+                p99  = lat[total * 99 / 100];
+                p999 = lat[total * 999 / 1000];
+                max  = lat[total - 1];
+            }
+        }
+
+        printf("%-12s %12.0f %10"PRId64" %10"PRId64" %10"PRId64" %10"PRId64"\n",
+               mode_names[b.mode], best, p50, p99, p999, max);
+    }
+
+    av_free(lat);
+    return 0;
+}